@@ -0,0 +1,121 @@
+/*
+* Read only view of an asset file
+*
+* Assets are parsed straight from the memory backing them instead of being read into a copy first
+* Desktop files are memory mapped, on Android the apk's asset buffer is used, which maps entries that are stored
+* uncompressed in the apk and only decompresses the other ones
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <assert.h>
+
+#include "mappedfile.hpp"
+
+#if defined(__ANDROID__)
+#include <android/asset_manager.h>
+#endif
+
+namespace vkTools
+{
+	class AssetFile
+	{
+	private:
+#if defined(__ANDROID__)
+		AAsset *asset = nullptr;
+#else
+		MappedFile file;
+#endif
+		// Only used if the asset's memory can't be accessed directly
+		std::vector<uint8_t> copy;
+		const void *mapped = nullptr;
+		size_t size = 0;
+
+	public:
+#if defined(__ANDROID__)
+		AAssetManager* assetManager = nullptr;
+
+		AssetFile(AAssetManager* assetManager = nullptr) : assetManager(assetManager) {}
+#else
+		AssetFile() {}
+#endif
+		AssetFile(const AssetFile&) = delete;
+		AssetFile& operator=(const AssetFile&) = delete;
+
+		~AssetFile()
+		{
+			close();
+		}
+
+		// Make the whole asset accessible, returns false if it doesn't exist or is empty
+		bool open(const std::string &filename)
+		{
+			close();
+#if defined(__ANDROID__)
+			assert(assetManager != nullptr);
+			asset = AAssetManager_open(assetManager, filename.c_str(), AASSET_MODE_BUFFER);
+			if (!asset)
+			{
+				return false;
+			}
+			size = AAsset_getLength(asset);
+			mapped = AAsset_getBuffer(asset);
+			if (!mapped && (size > 0))
+			{
+				// Read into a copy as a fallback if the asset manager couldn't provide a buffer
+				copy.resize(size);
+				if (AAsset_read(asset, copy.data(), size) == static_cast<int>(size))
+				{
+					mapped = copy.data();
+				}
+			}
+#else
+			if (file.open(filename))
+			{
+				mapped = file.data();
+				size = file.getSize();
+			}
+#endif
+			if (!mapped || (size == 0))
+			{
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void close()
+		{
+#if defined(__ANDROID__)
+			if (asset)
+			{
+				AAsset_close(asset);
+				asset = nullptr;
+			}
+#else
+			file.close();
+#endif
+			copy.clear();
+			copy.shrink_to_fit();
+			mapped = nullptr;
+			size = 0;
+		}
+
+		const void* data() const
+		{
+			return mapped;
+		}
+
+		size_t getSize() const
+		{
+			return size;
+		}
+	};
+}
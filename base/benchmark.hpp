@@ -0,0 +1,386 @@
+/*
+* Helpers for reproducible benchmark runs
+*
+* Camera paths are Catmull-Rom splines through keyframes loaded from a text file
+* Frame times are collected over a run and summarized as min/avg/percentiles
+* Results of repeated runs are compared to a stored baseline of the same device and driver to find regressions
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <ctype.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <glm/glm.hpp>
+
+namespace vkTools
+{
+	/**
+	* @brief Camera path through a list of keyframes
+	*
+	* The file contains one keyframe per line: time (in seconds) followed by position and rotation (in degrees) as stored in Camera
+	* Empty lines and lines starting with # are ignored, keyframes must be sorted by time
+	*/
+	class CameraPath
+	{
+	private:
+		struct Keyframe
+		{
+			float time;
+			glm::vec3 position;
+			glm::vec3 rotation;
+		};
+		std::vector<Keyframe> keyframes;
+
+		static glm::vec3 catmullRom(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3, float t)
+		{
+			const float t2 = t * t;
+			const float t3 = t2 * t;
+			return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+		}
+
+	public:
+		/**
+		* Load the keyframes from a file
+		*
+		* @param filename Name of the camera path file
+		*
+		* @return True if the file could be read and contains at least two keyframes
+		*/
+		bool load(const std::string &filename)
+		{
+			std::ifstream file(filename);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			keyframes.clear();
+			std::string line;
+			while (std::getline(file, line))
+			{
+				if (line.empty() || (line[0] == '#'))
+				{
+					continue;
+				}
+				std::istringstream ss(line);
+				Keyframe keyframe;
+				if (ss >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z)
+				{
+					keyframes.push_back(keyframe);
+				}
+			}
+			return keyframes.size() >= 2;
+		}
+
+		/** @brief Time of the last keyframe in seconds */
+		float getDuration()
+		{
+			return keyframes.empty() ? 0.0f : keyframes.back().time;
+		}
+
+		/**
+		* Sample the camera position and rotation at a point in time
+		*
+		* @param time Time in seconds, clamped to the time of the first and last keyframe
+		* @param position Interpolated camera position
+		* @param rotation Interpolated camera rotation
+		*/
+		void sample(float time, glm::vec3 &position, glm::vec3 &rotation)
+		{
+			assert(keyframes.size() >= 2);
+			time = glm::clamp(time, keyframes.front().time, keyframes.back().time);
+			size_t segment = 0;
+			while ((segment + 2 < keyframes.size()) && (keyframes[segment + 1].time < time))
+			{
+				segment++;
+			}
+			// The end points are repeated for the outer segments
+			const Keyframe &k0 = keyframes[(segment > 0) ? segment - 1 : 0];
+			const Keyframe &k1 = keyframes[segment];
+			const Keyframe &k2 = keyframes[segment + 1];
+			const Keyframe &k3 = keyframes[std::min(segment + 2, keyframes.size() - 1)];
+			const float length = k2.time - k1.time;
+			const float t = (length > 0.0f) ? (time - k1.time) / length : 0.0f;
+			position = catmullRom(k0.position, k1.position, k2.position, k3.position, t);
+			rotation = catmullRom(k0.rotation, k1.rotation, k2.rotation, k3.rotation, t);
+		}
+	};
+
+	/**
+	* @brief Collects the frame times of a benchmark run
+	*/
+	class FrameTimeStats
+	{
+	private:
+		std::vector<float> frameTimes;
+		std::vector<float> sorted;
+
+	public:
+		/** @brief Add the time of a frame in milliseconds */
+		void add(float milliseconds)
+		{
+			frameTimes.push_back(milliseconds);
+			sorted.clear();
+		}
+
+		size_t getCount()
+		{
+			return frameTimes.size();
+		}
+
+		float getMin()
+		{
+			return frameTimes.empty() ? 0.0f : *std::min_element(frameTimes.begin(), frameTimes.end());
+		}
+
+		float getMax()
+		{
+			return frameTimes.empty() ? 0.0f : *std::max_element(frameTimes.begin(), frameTimes.end());
+		}
+
+		float getAverage()
+		{
+			double sum = 0.0;
+			for (auto frameTime : frameTimes)
+			{
+				sum += frameTime;
+			}
+			return frameTimes.empty() ? 0.0f : static_cast<float>(sum / frameTimes.size());
+		}
+
+		/**
+		* Get a percentile of the frame times (nearest rank)
+		*
+		* @param percentile Percentile in the range [0, 100]
+		*/
+		float getPercentile(float percentile)
+		{
+			if (frameTimes.empty())
+			{
+				return 0.0f;
+			}
+			if (sorted.empty())
+			{
+				sorted = frameTimes;
+				std::sort(sorted.begin(), sorted.end());
+			}
+			size_t rank = static_cast<size_t>(ceilf(percentile / 100.0f * sorted.size()));
+			rank = std::max(rank, (size_t)1);
+			return sorted[std::min(rank, sorted.size()) - 1];
+		}
+	};
+
+	/**
+	* @brief Results of the runs of a benchmark on one device and driver
+	*
+	* The file contains one metric per line: its name, a tab and the metric's value of each run separated by spaces
+	* Empty lines and lines starting with # are ignored
+	*/
+	class BenchmarkBaseline
+	{
+	public:
+		// Values of each run by metric name, sorted by name
+		std::map<std::string, std::vector<float>> metrics;
+
+		/** @brief Name of the baseline file of a device and driver, characters other than letters and digits are replaced */
+		static std::string getFileName(const std::string &deviceName, uint32_t driverVersion)
+		{
+			std::stringstream ss;
+			for (auto c : deviceName)
+			{
+				ss << (isalnum(static_cast<unsigned char>(c)) ? c : '_');
+			}
+			ss << "_" << std::hex << std::setw(8) << std::setfill('0') << driverVersion << ".txt";
+			return ss.str();
+		}
+
+		/** @brief Returns true if the file could be read and contains at least one metric */
+		bool load(const std::string &filename)
+		{
+			std::ifstream file(filename);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			metrics.clear();
+			std::string line;
+			while (std::getline(file, line))
+			{
+				const size_t separator = line.find('\t');
+				if (line.empty() || (line[0] == '#') || (separator == std::string::npos))
+				{
+					continue;
+				}
+				std::istringstream ss(line.substr(separator + 1));
+				std::vector<float> &values = metrics[line.substr(0, separator)];
+				float value;
+				while (ss >> value)
+				{
+					values.push_back(value);
+				}
+			}
+			return !metrics.empty();
+		}
+
+		/** @brief Returns false if the file can't be written */
+		bool save(const std::string &filename, const std::string &comment) const
+		{
+			std::ofstream file(filename, std::ios::out | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			file << "# " << comment << std::endl;
+			file << std::fixed << std::setprecision(4);
+			for (auto& metric : metrics)
+			{
+				file << metric.first << "\t";
+				for (size_t i = 0; i < metric.second.size(); i++)
+				{
+					file << ((i > 0) ? " " : "") << metric.second[i];
+				}
+				file << std::endl;
+			}
+			return file.good();
+		}
+	};
+
+	/**
+	* @brief Test of a metric's values for a slowdown against those of a baseline
+	*
+	* Outliers are rejected from both sets by their distance to their median, then the means are compared with Welch's t-test
+	* A metric has regressed if it's significantly larger (one-sided, 99% confidence) and by more than the threshold
+	* With fewer than two values in either set there's no variance to test against, so only the threshold is checked
+	*/
+	struct RegressionTest
+	{
+		float baseline = 0.0f;
+		float current = 0.0f;
+		// Relative change of the mean, positive if the metric got larger (slower)
+		float change = 0.0f;
+		// Values left after rejecting outliers
+		uint32_t baselineCount = 0;
+		uint32_t currentCount = 0;
+		bool significant = false;
+		bool regressed = false;
+
+		static float getMedian(std::vector<float> values)
+		{
+			assert(!values.empty());
+			std::sort(values.begin(), values.end());
+			const size_t middle = values.size() / 2;
+			return (values.size() % 2 == 1) ? values[middle] : 0.5f * (values[middle - 1] + values[middle]);
+		}
+
+		/** @brief Drop values more than three (normal consistent) median absolute deviations off the median, at least three values are needed */
+		static std::vector<float> rejectOutliers(const std::vector<float> &values)
+		{
+			if (values.size() < 3)
+			{
+				return values;
+			}
+			const float median = getMedian(values);
+			std::vector<float> deviations;
+			for (auto value : values)
+			{
+				deviations.push_back(fabsf(value - median));
+			}
+			const float limit = 3.0f * 1.4826f * getMedian(deviations);
+			std::vector<float> kept;
+			for (auto value : values)
+			{
+				// All values are kept if most of them are the same
+				if ((limit == 0.0f) || (fabsf(value - median) <= limit))
+				{
+					kept.push_back(value);
+				}
+			}
+			return kept;
+		}
+
+		/**
+		* Compare the values of a metric
+		*
+		* @param baselineValues Values of the baseline's runs
+		* @param currentValues Values of the current runs
+		* @param threshold Smallest relative slowdown reported as a regression, e.g. 0.03 for 3%
+		*/
+		RegressionTest(const std::vector<float> &baselineValues, const std::vector<float> &currentValues, float threshold)
+		{
+			const std::vector<float> b = rejectOutliers(baselineValues);
+			const std::vector<float> c = rejectOutliers(currentValues);
+			baselineCount = static_cast<uint32_t>(b.size());
+			currentCount = static_cast<uint32_t>(c.size());
+			if (b.empty() || c.empty())
+			{
+				return;
+			}
+			double varianceB, varianceC;
+			baseline = getMean(b, varianceB);
+			current = getMean(c, varianceC);
+			change = (baseline > 0.0f) ? (current - baseline) / baseline : 0.0f;
+
+			if ((b.size() < 2) || (c.size() < 2))
+			{
+				regressed = change > threshold;
+				return;
+			}
+			const double errorB = varianceB / b.size();
+			const double errorC = varianceC / c.size();
+			const double standardError = sqrt(errorB + errorC);
+			if (standardError == 0.0)
+			{
+				significant = current > baseline;
+			}
+			else
+			{
+				// Welch-Satterthwaite degrees of freedom
+				const double dof = (errorB + errorC) * (errorB + errorC) / (errorB * errorB / (b.size() - 1) + errorC * errorC / (c.size() - 1));
+				significant = (current - baseline) / standardError > getCriticalValue(dof);
+			}
+			regressed = significant && (change > threshold);
+		}
+
+	private:
+		// Mean and unbiased variance
+		static float getMean(const std::vector<float> &values, double &variance)
+		{
+			double sum = 0.0;
+			for (auto value : values)
+			{
+				sum += value;
+			}
+			const double mean = sum / values.size();
+			variance = 0.0;
+			for (auto value : values)
+			{
+				variance += (value - mean) * (value - mean);
+			}
+			variance = (values.size() > 1) ? variance / (values.size() - 1) : 0.0;
+			return static_cast<float>(mean);
+		}
+
+		// One-sided 99% quantile of Student's t distribution, Cornish-Fisher expansion around the normal quantile
+		static double getCriticalValue(double dof)
+		{
+			const double z = 2.3263;
+			const double z3 = z * z * z;
+			const double z5 = z3 * z * z;
+			const double z7 = z5 * z * z;
+			return z + (z3 + z) / (4.0 * dof) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * dof * dof) + (3.0 * z7 + 19.0 * z5 + 17.0 * z3 - 15.0 * z) / (384.0 * dof * dof * dof);
+		}
+	};
+}
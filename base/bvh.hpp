@@ -0,0 +1,301 @@
+/*
+* Bounding volume hierarchy over bounding spheres
+*
+* Built top down with binned surface area heuristic splits
+* Nodes are stored depth first in a flat array, each node's subtree covers a contiguous range of the sorted primitives
+* Traversal is stackless, a node stores the index of the node following its subtree
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <float.h>
+#include <assert.h>
+
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+namespace vkTools
+{
+	class BoundingVolumeHierarchy
+	{
+	public:
+		struct Node
+		{
+			glm::vec3 min;
+			// Range of the sorted primitives covered by the node's subtree
+			uint32_t firstPrimitive;
+			glm::vec3 max;
+			uint32_t primitiveCount;
+			// Index of the node following the node's subtree, the node is a leaf if that is the next node
+			uint32_t skip;
+		};
+
+		/** @brief Bins the primitives' centers are sorted into along the split axis */
+		static const uint32_t SPLIT_BINS = 16;
+
+	private:
+		std::vector<Node> nodes;
+		// Primitive indices in the order of the nodes' ranges
+		std::vector<uint32_t> primitives;
+
+		struct Bounds
+		{
+			glm::vec3 min = glm::vec3(FLT_MAX);
+			glm::vec3 max = glm::vec3(-FLT_MAX);
+
+			void grow(const glm::vec3 &pMin, const glm::vec3 &pMax)
+			{
+				min = glm::min(min, pMin);
+				max = glm::max(max, pMax);
+			}
+
+			float getArea() const
+			{
+				const glm::vec3 extent = glm::max(max - min, glm::vec3(0.0f));
+				return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+			}
+		};
+
+		void buildNode(const std::vector<glm::vec4> &spheres, uint32_t first, uint32_t count, uint32_t maxLeafSize)
+		{
+			const uint32_t nodeIndex = static_cast<uint32_t>(nodes.size());
+			nodes.push_back(Node());
+
+			Bounds bounds;
+			Bounds centerBounds;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				const glm::vec4 &sphere = spheres[primitives[i]];
+				bounds.grow(glm::vec3(sphere) - sphere.w, glm::vec3(sphere) + sphere.w);
+				centerBounds.grow(glm::vec3(sphere), glm::vec3(sphere));
+			}
+
+			// Split along the longest axis of the centers at the bin boundary with the lowest cost
+			uint32_t split = 0;
+			if (count > maxLeafSize)
+			{
+				const glm::vec3 extent = centerBounds.max - centerBounds.min;
+				const uint32_t axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+				if (extent[axis] > 0.0f)
+				{
+					Bounds bins[SPLIT_BINS];
+					uint32_t binCounts[SPLIT_BINS] = {};
+					const float binScale = SPLIT_BINS / extent[axis];
+					auto getBin = [&](uint32_t primitive)
+					{
+						const uint32_t bin = static_cast<uint32_t>((spheres[primitive][axis] - centerBounds.min[axis]) * binScale);
+						return std::min(bin, SPLIT_BINS - 1);
+					};
+					for (uint32_t i = first; i < first + count; i++)
+					{
+						const glm::vec4 &sphere = spheres[primitives[i]];
+						const uint32_t bin = getBin(primitives[i]);
+						bins[bin].grow(glm::vec3(sphere) - sphere.w, glm::vec3(sphere) + sphere.w);
+						binCounts[bin]++;
+					}
+
+					// Accumulated from the right for each boundary
+					float rightCosts[SPLIT_BINS];
+					Bounds right;
+					uint32_t rightCount = 0;
+					for (uint32_t b = SPLIT_BINS - 1; b > 0; b--)
+					{
+						right.grow(bins[b].min, bins[b].max);
+						rightCount += binCounts[b];
+						rightCosts[b] = right.getArea() * rightCount;
+					}
+
+					// Splitting has to be cheaper than testing all primitives of a leaf
+					float bestCost = bounds.getArea() * count;
+					uint32_t bestBin = 0;
+					Bounds left;
+					uint32_t leftCount = 0;
+					for (uint32_t b = 1; b < SPLIT_BINS; b++)
+					{
+						left.grow(bins[b - 1].min, bins[b - 1].max);
+						leftCount += binCounts[b - 1];
+						const float cost = left.getArea() * leftCount + rightCosts[b];
+						if ((leftCount > 0) && (leftCount < count) && (cost < bestCost))
+						{
+							bestCost = cost;
+							bestBin = b;
+						}
+					}
+
+					if (bestBin > 0)
+					{
+						uint32_t *middle = std::partition(&primitives[first], &primitives[first] + count, [&](uint32_t primitive) { return getBin(primitive) < bestBin; });
+						split = static_cast<uint32_t>(middle - &primitives[first]);
+					}
+				}
+			}
+
+			if (split > 0)
+			{
+				buildNode(spheres, first, split, maxLeafSize);
+				buildNode(spheres, first + split, count - split, maxLeafSize);
+			}
+
+			Node &node = nodes[nodeIndex];
+			node.min = bounds.min;
+			node.max = bounds.max;
+			node.firstPrimitive = first;
+			node.primitiveCount = count;
+			node.skip = static_cast<uint32_t>(nodes.size());
+		}
+
+		static bool isLeaf(const std::vector<Node> &nodes, uint32_t index)
+		{
+			return nodes[index].skip == index + 1;
+		}
+
+	public:
+		/**
+		* Build the hierarchy over a list of bounding spheres
+		*
+		* @param spheres Bounding spheres (center, radius), primitives are identified by their index in this list
+		* @param maxLeafSize Number of primitives leaves are split at, larger leaves are only created if their primitives can't be separated
+		*/
+		void build(const std::vector<glm::vec4> &spheres, uint32_t maxLeafSize = 4)
+		{
+			nodes.clear();
+			primitives.resize(spheres.size());
+			for (uint32_t i = 0; i < primitives.size(); i++)
+			{
+				primitives[i] = i;
+			}
+			if (!spheres.empty())
+			{
+				nodes.reserve(2 * spheres.size() / std::max(maxLeafSize, 1u) + 1);
+				buildNode(spheres, 0, static_cast<uint32_t>(spheres.size()), std::max(maxLeafSize, 1u));
+			}
+		}
+
+		const std::vector<Node>& getNodes() const
+		{
+			return nodes;
+		}
+
+		/** @brief Primitive indices in the order of the nodes' ranges */
+		const std::vector<uint32_t>& getPrimitives() const
+		{
+			return primitives;
+		}
+
+		/**
+		* Call visit(primitive, inside) for all primitives in leaves touching the frustum
+		* Inside is set if the primitive's node is completely inside the frustum and the primitive doesn't need to be tested
+		*/
+		template <typename Visitor>
+		void queryFrustum(const Frustum &frustum, Visitor visit) const
+		{
+			uint32_t index = 0;
+			while (index < nodes.size())
+			{
+				const Node &node = nodes[index];
+				const Frustum::Intersection intersection = frustum.checkBox(node.min, node.max);
+				if ((intersection == Frustum::INSIDE) || ((intersection == Frustum::INTERSECTING) && isLeaf(nodes, index)))
+				{
+					for (uint32_t i = node.firstPrimitive; i < node.firstPrimitive + node.primitiveCount; i++)
+					{
+						visit(primitives[i], intersection == Frustum::INSIDE);
+					}
+					index = node.skip;
+				}
+				else
+				{
+					index = (intersection == Frustum::OUTSIDE) ? node.skip : index + 1;
+				}
+			}
+		}
+
+		/** @brief Call visit(primitive) for all primitives in leaves touching the sphere */
+		template <typename Visitor>
+		void querySphere(const glm::vec3 &center, float radius, Visitor visit) const
+		{
+			uint32_t index = 0;
+			while (index < nodes.size())
+			{
+				const Node &node = nodes[index];
+				const glm::vec3 closest = glm::clamp(center, node.min, node.max);
+				if (glm::dot(closest - center, closest - center) > radius * radius)
+				{
+					index = node.skip;
+					continue;
+				}
+				if (isLeaf(nodes, index))
+				{
+					for (uint32_t i = node.firstPrimitive; i < node.firstPrimitive + node.primitiveCount; i++)
+					{
+						visit(primitives[i]);
+					}
+					index = node.skip;
+				}
+				else
+				{
+					index++;
+				}
+			}
+		}
+
+		/**
+		* Find the closest primitive hit by a ray
+		*
+		* @param origin Origin of the ray
+		* @param direction Direction of the ray, doesn't need to be normalized
+		* @param intersect Called as intersect(primitive, maxDistance) for primitives in leaves hit by the ray, returns the distance along the ray to the primitive (in units of direction) or a negative value if it's missed
+		* @param distance Distance of the closest hit
+		*
+		* @return Index of the closest primitive hit, UINT32_MAX if none is hit
+		*/
+		template <typename Intersector>
+		uint32_t intersectRay(const glm::vec3 &origin, const glm::vec3 &direction, Intersector intersect, float &distance) const
+		{
+			const glm::vec3 invDirection = 1.0f / direction;
+			uint32_t hit = UINT32_MAX;
+			distance = FLT_MAX;
+			uint32_t index = 0;
+			while (index < nodes.size())
+			{
+				const Node &node = nodes[index];
+				// Slab test, nodes farther away than the closest hit are skipped
+				const glm::vec3 t0 = (node.min - origin) * invDirection;
+				const glm::vec3 t1 = (node.max - origin) * invDirection;
+				const glm::vec3 tMin = glm::min(t0, t1);
+				const glm::vec3 tMax = glm::max(t0, t1);
+				const float tNear = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+				const float tFar = std::min(std::min(tMax.x, tMax.y), tMax.z);
+				if ((tNear > tFar) || (tNear >= distance))
+				{
+					index = node.skip;
+					continue;
+				}
+				if (isLeaf(nodes, index))
+				{
+					for (uint32_t i = node.firstPrimitive; i < node.firstPrimitive + node.primitiveCount; i++)
+					{
+						const float t = intersect(primitives[i], distance);
+						if ((t >= 0.0f) && (t < distance))
+						{
+							distance = t;
+							hit = primitives[i];
+						}
+					}
+					index = node.skip;
+				}
+				else
+				{
+					index++;
+				}
+			}
+			return hit;
+		}
+	};
+}
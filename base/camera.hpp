@@ -1,6 +1,9 @@
 /*
 * Basic camera class
 *
+* Setters only flag the matrices as changed, they are rebuilt on the first getMatrices call after a change
+* The versions count the rebuilds, so consumers can skip work for matrices they have already seen
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -12,10 +15,42 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#include "frustum.hpp"
+
 class Camera
 {
+public:
+	struct Matrices
+	{
+		glm::mat4 perspective;
+		glm::mat4 view;
+		// Perspective without the jitter
+		glm::mat4 unjitteredPerspective;
+		// Left (0) and right (1) eye, see stereo
+		glm::mat4 eyeView[2];
+		glm::mat4 eyePerspective[2];
+		// View projection of a frustum containing both eyes' frustums, for culling once for both views
+		glm::mat4 cullingViewProjection;
+		glm::mat4 viewProjection;
+		glm::mat4 unjitteredViewProjection;
+		glm::mat4 inverseView;
+		glm::mat4 inverseUnjitteredViewProjection;
+		// World space planes of cullingViewProjection
+		vkTools::Frustum frustum;
+	};
+
 private:
-	void updateViewMatrix()
+	// Projection before the pre-rotation and the jitter
+	mutable glm::mat4 unrotatedPerspective;
+	mutable Matrices matrices;
+	// Parts of the matrices changed since the last rebuild, the jitter only changes the jittered projections
+	mutable bool viewChanged = true;
+	mutable bool projectionChanged = true;
+	mutable bool jitterChanged = true;
+	mutable uint32_t version = 0;
+	mutable uint32_t viewVersion = 0;
+
+	void updateViewMatrix() const
 	{
 		glm::mat4 rotM = glm::mat4();
 		glm::mat4 transM;
@@ -24,7 +59,7 @@ private:
 		rotM = glm::rotate(rotM, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
 		rotM = glm::rotate(rotM, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
 
-		transM = glm::translate(glm::mat4(), position);
+		transM = glm::translate(glm::mat4(), getInterpolatedPosition());
 
 		if (type == CameraType::firstperson)
 		{
@@ -35,24 +70,150 @@ private:
 			matrices.view = transM * rotM;
 		}
 	};
+
+	void updatePerspectiveMatrix() const
+	{
+		unrotatedPerspective = glm::perspective(glm::radians(fov), aspect, znear, zfar);
+		if (reversedDepth)
+		{
+			// Infinite far plane with the depth mapped from 1 at the near plane to 0 at infinity, the far plane only bounds the culling
+			unrotatedPerspective[2][2] = 0.0f;
+			unrotatedPerspective[3][2] = znear;
+		}
+		matrices.unjitteredPerspective = preRotation * unrotatedPerspective;
+	}
+
+	void updateJitteredMatrices() const
+	{
+		// Scaled by -z (= w) through the third column, so the image is shifted by the jitter after the perspective divide
+		matrices.perspective = matrices.unjitteredPerspective;
+		matrices.perspective[2][0] -= jitter.x;
+		matrices.perspective[2][1] -= jitter.y;
+		matrices.viewProjection = matrices.perspective * matrices.view;
+	}
+
+	void updateStereoMatrices() const
+	{
+		// Off-axis projections converging at the focal distance, so there's no parallax at that depth
+		const float halfSeparation = stereo.eyeSeparation * 0.5f;
+		for (uint32_t eye = 0; eye < 2; eye++)
+		{
+			const float side = (eye == 0) ? -1.0f : 1.0f;
+			matrices.eyeView[eye] = glm::translate(glm::mat4(), glm::vec3(-side * halfSeparation, 0.0f, 0.0f)) * matrices.view;
+			// The eyes are offset along the view's x axis, which the pre-rotation may have turned
+			const float shift = side * unrotatedPerspective[0][0] * halfSeparation / stereo.focalDistance;
+			matrices.eyePerspective[eye] = matrices.perspective;
+			matrices.eyePerspective[eye][2][0] -= preRotation[0][0] * shift;
+			matrices.eyePerspective[eye][2][1] -= preRotation[0][1] * shift;
+		}
+
+		// The outer edges of both eyes' frustums meet behind the camera, a frustum from there contains both
+		const float tanX = 1.0f / unrotatedPerspective[0][0];
+		const float tanY = 1.0f / fabsf(unrotatedPerspective[1][1]);
+		const float edgeTanX = tanX - halfSeparation / stereo.focalDistance;
+		const float pullBack = halfSeparation / edgeTanX;
+		glm::mat4 cullingPerspective = glm::perspective(2.0f * atanf(tanY), edgeTanX / tanY, znear + pullBack, zfar + pullBack);
+		cullingPerspective[1][1] = copysignf(cullingPerspective[1][1], unrotatedPerspective[1][1]);
+		matrices.cullingViewProjection = preRotation * cullingPerspective * glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, -pullBack)) * matrices.view;
+	}
+
+	void updateMatrices() const
+	{
+		const bool viewOrProjection = viewChanged || projectionChanged;
+		if (viewChanged)
+		{
+			updateViewMatrix();
+			matrices.inverseView = glm::inverse(matrices.view);
+		}
+		if (projectionChanged)
+		{
+			updatePerspectiveMatrix();
+		}
+		if (viewOrProjection)
+		{
+			matrices.unjitteredViewProjection = matrices.unjitteredPerspective * matrices.view;
+			matrices.inverseUnjitteredViewProjection = glm::inverse(matrices.unjitteredViewProjection);
+		}
+		updateJitteredMatrices();
+		updateStereoMatrices();
+		if (viewOrProjection)
+		{
+			matrices.frustum.update(matrices.cullingViewProjection);
+			viewVersion++;
+		}
+		version++;
+		viewChanged = projectionChanged = jitterChanged = false;
+	}
+
+	void invalidateView()
+	{
+		viewChanged = true;
+	}
+
+	void invalidateProjection()
+	{
+		projectionChanged = true;
+	}
+
 public:
 	enum CameraType { lookat, firstperson };
 	CameraType type = CameraType::lookat;
 
 	float fov;
 	float znear, zfar;
+	float aspect;
+	// Reversed depth with an infinite far plane, see setReversedDepth
+	bool reversedDepth = false;
+
+	// Subpixel offset of the projection in normalized device coordinates, for temporal anti-aliasing
+	glm::vec2 jitter = glm::vec2(0.0f);
+
+	// Rotation of the image in normalized device coordinates applied after the projection, for pre-rotated swap chains
+	// The aspect ratio stays the one of the unrotated view, the jitter is applied in the rotated space
+	glm::mat4 preRotation = glm::mat4();
+
+	// Stereo eyes for head mounted displays, the eye matrices equal the mono ones with an eye separation of zero
+	struct
+	{
+		// Distance between the eyes in world units
+		float eyeSeparation = 0.0f;
+		// Distance of the plane both eyes converge on
+		float focalDistance = 1.0f;
+	} stereo;
 
 	glm::vec3 rotation = glm::vec3();
 	glm::vec3 position = glm::vec3();
+	// Position before the last update, the view is placed between it and the position by the interpolation factor
+	// Lets a fixed step simulation render between its last two states, a factor of 1 always uses the current position
+	glm::vec3 previousPosition = glm::vec3();
+	float interpolation = 1.0f;
 
 	float rotationSpeed = 1.0f;
 	float movementSpeed = 1.0f;
 
-	struct
+	/** @brief Current matrices, rebuilt if anything they depend on has changed since the last call */
+	const Matrices &getMatrices() const
 	{
-		glm::mat4 perspective;
-		glm::mat4 view;
-	} matrices;
+		if (viewChanged || projectionChanged || jitterChanged)
+		{
+			updateMatrices();
+		}
+		return matrices;
+	}
+
+	/** @brief Changes whenever the matrices have been rebuilt */
+	uint32_t getVersion() const
+	{
+		getMatrices();
+		return version;
+	}
+
+	/** @brief Changes with the view and the unjittered projection, but not with the jitter, e.g. for culling results */
+	uint32_t getViewVersion() const
+	{
+		getMatrices();
+		return viewVersion;
+	}
 
 	struct
 	{
@@ -72,40 +233,102 @@ public:
 		this->fov = fov;
 		this->znear = znear;
 		this->zfar = zfar;
-		matrices.perspective = glm::perspective(glm::radians(fov), aspect, znear, zfar);
+		this->aspect = aspect;
+		invalidateProjection();
 	};
 
 	void updateAspectRatio(float aspect)
 	{
-		matrices.perspective = glm::perspective(glm::radians(fov), aspect, znear, zfar);
+		this->aspect = aspect;
+		invalidateProjection();
+	}
+
+	// The culling frustum depends on the separation, so it's handled like a change of the projection
+	void setStereo(float eyeSeparation, float focalDistance)
+	{
+		stereo.eyeSeparation = eyeSeparation;
+		stereo.focalDistance = focalDistance;
+		invalidateProjection();
+	}
+
+	void setPreRotation(const glm::mat4 &preRotation)
+	{
+		this->preRotation = preRotation;
+		invalidateProjection();
+	}
+
+	// With a floating point depth buffer the reversed depth spreads its precision evenly over the view distance
+	void setReversedDepth(bool reversedDepth)
+	{
+		this->reversedDepth = reversedDepth;
+		invalidateProjection();
+	}
+
+	void setJitter(glm::vec2 jitter)
+	{
+		if (jitter != this->jitter)
+		{
+			this->jitter = jitter;
+			jitterChanged = true;
+		}
 	}
 
 	void setRotation(glm::vec3 rotation)
 	{
 		this->rotation = rotation;
-		updateViewMatrix();
+		invalidateView();
 	};
 
 	void rotate(glm::vec3 delta)
 	{
 		this->rotation += delta;
-		updateViewMatrix();
+		invalidateView();
 	}
 
 	void setTranslation(glm::vec3 translation)
 	{
 		this->position = translation;
-		updateViewMatrix();
+		this->previousPosition = translation;
+		invalidateView();
 	};
 
+	// Direct input isn't part of the simulation, so both states are moved to apply it right away
 	void translate(glm::vec3 delta)
 	{
 		this->position += delta;
-		updateViewMatrix();
+		this->previousPosition += delta;
+		invalidateView();
 	}
 
+	glm::vec3 getInterpolatedPosition() const
+	{
+		return glm::mix(previousPosition, position, interpolation);
+	}
+
+	// Set the interpolation factor between the previous and the current position (see previousPosition)
+	void interpolate(float alpha)
+	{
+		if (alpha != interpolation)
+		{
+			interpolation = alpha;
+			invalidateView();
+		}
+	}
+
+	// True if the interpolated view still changes with the interpolation factor
+	bool interpolating()
+	{
+		return previousPosition != position;
+	}
+
+	// Advance the camera by a step, the current position becomes the previous one
 	void update(float deltaTime)
 	{
+		if (previousPosition != position)
+		{
+			previousPosition = position;
+			invalidateView();
+		}
 		if (type == CameraType::firstperson)
 		{
 			if (moving())
@@ -127,7 +350,7 @@ public:
 				if (keys.right)
 					position += glm::normalize(glm::cross(camFront, glm::vec3(0.0f, 1.0f, 0.0f))) * moveSpeed;
 
-				updateViewMatrix();
+				invalidateView();
 			}
 		}
 	};
@@ -137,6 +360,7 @@ public:
 	bool updatePad(glm::vec2 axisLeft, glm::vec2 axisRight, float deltaTime)
 	{
 		bool retVal = false;
+		const glm::vec3 lastPosition = position;
 
 		if (type == CameraType::firstperson)
 		{
@@ -190,7 +414,9 @@ public:
 
 		if (retVal)
 		{
-			updateViewMatrix();
+			// Pad input is applied per frame like translate
+			previousPosition += position - lastPosition;
+			invalidateView();
 		}
 
 		return retVal;
@@ -0,0 +1,244 @@
+/*
+* CPU core topology and thread roles
+*
+* Tells faster cores from slower ones (e.g. the big and little cores of mobile SoCs) by their capacity or maximum frequency,
+* Windows reports the efficiency class of each core instead
+* Cores within FAST_CLUSTER_PERCENT of the fastest one form the fast cluster, so the few percent the favored turbo cores of
+* desktop processors are ahead of the others don't count as a difference
+* Threads are pinned by their role, latency critical work (recording, submission) to the faster cores and background work
+* (streaming, encoding, publishing) to the slowest ones, and get a matching priority per platform
+* If all cores perform the same, threads are only given their role's priority
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <utility>
+#include <stdio.h>
+#include <stdint.h>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+// Share of the fastest core's performance the cores of its cluster have at least
+#define FAST_CLUSTER_PERCENT 80
+
+namespace vkTools
+{
+	class CpuTopology
+	{
+	public:
+		enum ThreadRole
+		{
+			// Frame recording and submission, the main thread and the job system's workers
+			THREAD_ROLE_LATENCY,
+			// Work that only has to keep up over several frames, e.g. streaming and encoding
+			THREAD_ROLE_BACKGROUND,
+		};
+
+		/** @brief Cleared with "-nothreadaffinity", threads keep the default affinity and priority and the workers use all cores */
+		bool enabled = true;
+
+	private:
+		// Logical cores, the fast cluster and the cores below it, both hold all cores if their performance doesn't differ
+		std::vector<uint32_t> fastCores;
+		std::vector<uint32_t> slowCores;
+
+		CpuTopology()
+		{
+			detect();
+		}
+
+#if defined(__linux__)
+		static bool readValue(const std::string &fileName, uint64_t &value)
+		{
+			FILE *file = fopen(fileName.c_str(), "r");
+			if (!file)
+			{
+				return false;
+			}
+			unsigned long long fileValue = 0;
+			const bool read = (fscanf(file, "%llu", &fileValue) == 1);
+			fclose(file);
+			value = static_cast<uint64_t>(fileValue);
+			return read;
+		}
+#endif
+
+		void detect()
+		{
+			// Performance of each logical core, only comparable within a platform's source
+			std::vector<std::pair<uint32_t, uint64_t>> performance;
+#if defined(__linux__)
+			// The capacity is the scheduler's relative performance of the cores, kernels without it only report the frequency
+			// One source is used for all cores, the values of both can't be compared
+			const long coreCount = sysconf(_SC_NPROCESSORS_CONF);
+			for (const char *source : { "/cpu_capacity", "/cpufreq/cpuinfo_max_freq" })
+			{
+				for (long i = 0; i < coreCount; i++)
+				{
+					const std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(i);
+					uint64_t value = 0;
+					if (!readValue(path + source, value))
+					{
+						performance.clear();
+						break;
+					}
+					performance.push_back(std::make_pair(static_cast<uint32_t>(i), value));
+				}
+				if (!performance.empty())
+				{
+					break;
+				}
+			}
+#elif defined(_WIN32)
+			DWORD length = 0;
+			GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+			std::vector<uint8_t> buffer(length);
+			if ((length > 0) && GetLogicalProcessorInformationEx(RelationProcessorCore, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length))
+			{
+				for (DWORD offset = 0; offset < length;)
+				{
+					const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *info = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(&buffer[offset]);
+					// Cores of other processor groups can't be selected by a thread's affinity mask
+					if (info->Processor.GroupMask[0].Group == 0)
+					{
+						for (uint32_t i = 0; i < sizeof(KAFFINITY) * 8; i++)
+						{
+							if (info->Processor.GroupMask[0].Mask & (static_cast<KAFFINITY>(1) << i))
+							{
+								performance.push_back(std::make_pair(i, static_cast<uint64_t>(info->Processor.EfficiencyClass)));
+							}
+						}
+					}
+					offset += info->Size;
+				}
+			}
+#endif
+			if (performance.empty())
+			{
+				for (uint32_t i = 0; i < std::max(std::thread::hardware_concurrency(), 1u); i++)
+				{
+					performance.push_back(std::make_pair(i, 0));
+				}
+			}
+			uint64_t fastest = performance[0].second;
+			for (auto& core : performance)
+			{
+				fastest = std::max(fastest, core.second);
+			}
+			for (auto& core : performance)
+			{
+				((core.second * 100 >= fastest * FAST_CLUSTER_PERCENT) ? fastCores : slowCores).push_back(core.first);
+			}
+			// No clear gap below the fast cluster, all cores are treated the same
+			if (slowCores.empty())
+			{
+				slowCores = fastCores;
+			}
+		}
+
+	public:
+		static CpuTopology& get()
+		{
+			static CpuTopology topology;
+			return topology;
+		}
+
+		/** @brief True if the cores differ in performance, threads are only pinned then */
+		bool isHeterogeneous() const
+		{
+			return fastCores != slowCores;
+		}
+
+		uint32_t getFastCoreCount() const
+		{
+			return static_cast<uint32_t>(fastCores.size());
+		}
+
+		uint32_t getSlowCoreCount() const
+		{
+			return static_cast<uint32_t>(slowCores.size());
+		}
+
+		/** @brief Cores the job system's workers should be sized for, only the faster ones if threads are pinned */
+		uint32_t getLatencyCoreCount() const
+		{
+			return (enabled && isHeterogeneous()) ? getFastCoreCount() : std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		std::string getDescription() const
+		{
+			std::stringstream ss;
+			if (isHeterogeneous())
+			{
+				ss << fastCores.size() << " fast and " << slowCores.size() << " slow cores";
+			}
+			else
+			{
+				ss << fastCores.size() << " cores of the same performance";
+			}
+			return ss.str();
+		}
+
+		/**
+		* Pin the calling thread to the cores of its role and set the role's priority
+		* Failures are ignored, e.g. if the process' cpuset excludes the cores or raising the priority isn't permitted
+		*/
+		void setThreadRole(ThreadRole role)
+		{
+			if (!enabled)
+			{
+				return;
+			}
+			const std::vector<uint32_t> &cores = (role == THREAD_ROLE_LATENCY) ? fastCores : slowCores;
+#if defined(__linux__)
+			if (isHeterogeneous())
+			{
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				for (auto core : cores)
+				{
+					if (core < CPU_SETSIZE)
+					{
+						CPU_SET(core, &set);
+					}
+				}
+				sched_setaffinity(0, sizeof(set), &set);
+			}
+			// Nice values apply per thread on Linux, Android apps may raise theirs up to the display priority
+			// Raising the priority needs privileges on desktop Linux, so latency critical threads keep the default there
+#if defined(__ANDROID__)
+			const int niceValue = (role == THREAD_ROLE_LATENCY) ? -4 : 10;
+#else
+			const int niceValue = (role == THREAD_ROLE_LATENCY) ? 0 : 10;
+#endif
+			setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), niceValue);
+#elif defined(_WIN32)
+			if (isHeterogeneous())
+			{
+				DWORD_PTR mask = 0;
+				for (auto core : cores)
+				{
+					mask |= static_cast<DWORD_PTR>(1) << core;
+				}
+				SetThreadAffinityMask(GetCurrentThread(), mask);
+			}
+			SetThreadPriority(GetCurrentThread(), (role == THREAD_ROLE_LATENCY) ? THREAD_PRIORITY_ABOVE_NORMAL : THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+		}
+	};
+}
@@ -0,0 +1,222 @@
+/*
+* CPU trace zones written as Chrome trace event JSON
+*
+* The trace can be loaded into chrome://tracing or Perfetto, every thread (and the GPU) gets its own track
+* Zones are only recorded while a trace is open, otherwise a zone costs a single atomic load
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <algorithm>
+#include <stdint.h>
+
+namespace vkTools
+{
+	class CpuTrace
+	{
+	public:
+		/** @brief Number of zones kept in memory, zones beyond this are dropped */
+		static const uint32_t MAX_EVENTS = 1 << 20;
+
+	private:
+		struct Event
+		{
+			std::string name;
+			// Microseconds since the trace was opened
+			double start;
+			double duration;
+			uint32_t track;
+		};
+		std::vector<Event> events;
+		// Track names in the order of their ids
+		std::vector<std::string> tracks;
+		std::unordered_map<std::thread::id, uint32_t> threadTracks;
+		std::mutex mutex;
+		std::atomic<bool> active;
+		std::string fileName;
+		std::chrono::high_resolution_clock::time_point origin;
+
+		CpuTrace() : active(false) {}
+
+		static std::string jsonString(const std::string &str)
+		{
+			std::string escaped = "\"";
+			for (auto c : str)
+			{
+				if ((c == '"') || (c == '\\'))
+				{
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped + "\"";
+		}
+
+		// Must be called with the mutex held
+		uint32_t getThreadTrackLocked()
+		{
+			auto track = threadTracks.find(std::this_thread::get_id());
+			if (track != threadTracks.end())
+			{
+				return track->second;
+			}
+			const uint32_t id = static_cast<uint32_t>(tracks.size());
+			tracks.push_back("Thread " + std::to_string(id));
+			threadTracks[std::this_thread::get_id()] = id;
+			return id;
+		}
+
+	public:
+		CpuTrace(const CpuTrace&) = delete;
+		CpuTrace& operator=(const CpuTrace&) = delete;
+
+		/** @brief The trace shared by all threads */
+		static CpuTrace& get()
+		{
+			static CpuTrace trace;
+			return trace;
+		}
+
+		/**
+		* Start recording zones, they are written to the file by close
+		*
+		* @param fileName Name of the JSON file the trace is written to
+		*/
+		void open(const std::string &fileName)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			this->fileName = fileName;
+			origin = std::chrono::high_resolution_clock::now();
+			events.clear();
+			events.reserve(4096);
+			active = true;
+		}
+
+		/**
+		* Stop recording and write the recorded zones
+		*
+		* @return False if the file couldn't be written, true if it has been written or no trace was open
+		*/
+		bool close()
+		{
+			if (!active.exchange(false))
+			{
+				return true;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			std::ofstream file(fileName, std::ios::out | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			file << std::fixed << std::setprecision(3);
+			file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+			for (uint32_t i = 0; i < tracks.size(); i++)
+			{
+				file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << i << ", \"args\": {\"name\": " << jsonString(tracks[i]) << "}}," << std::endl;
+			}
+			for (size_t i = 0; i < events.size(); i++)
+			{
+				const Event &event = events[i];
+				file << "{\"name\": " << jsonString(event.name) << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.track
+					<< ", \"ts\": " << event.start << ", \"dur\": " << event.duration << "}" << ((i + 1 < events.size()) ? "," : "") << std::endl;
+			}
+			file << "]}" << std::endl;
+			events.clear();
+			return file.good();
+		}
+
+		bool isActive() const
+		{
+			return active.load(std::memory_order_relaxed);
+		}
+
+		/** @brief Microseconds since the trace was opened */
+		double now() const
+		{
+			return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - origin).count();
+		}
+
+		/** @brief Name the calling thread's track */
+		void setThreadName(const std::string &name)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tracks[getThreadTrackLocked()] = name;
+		}
+
+		/** @brief Add a track that isn't bound to a thread, e.g. for GPU work, zones are added to it with addZone */
+		uint32_t addTrack(const std::string &name)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tracks.push_back(name);
+			return static_cast<uint32_t>(tracks.size() - 1);
+		}
+
+		/**
+		* Record a zone on a track
+		*
+		* @param name Name of the zone
+		* @param start Start of the zone as returned by now
+		* @param end End of the zone as returned by now
+		* @param (Optional) track Track of the zone, defaults to the calling thread's track
+		*/
+		void addZone(const std::string &name, double start, double end, uint32_t track = UINT32_MAX)
+		{
+			if (!isActive())
+			{
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			if (events.size() >= MAX_EVENTS)
+			{
+				return;
+			}
+			events.push_back({ name, start, std::max(end - start, 0.0), (track == UINT32_MAX) ? getThreadTrackLocked() : track });
+		}
+	};
+
+	/**
+	* @brief Records a CPU trace zone covering its lifetime
+	* @note The name must outlive the zone
+	*/
+	class TraceZone
+	{
+	private:
+		const char *name;
+		double start = 0.0;
+		bool active;
+
+	public:
+		explicit TraceZone(const char *name) : name(name), active(CpuTrace::get().isActive())
+		{
+			if (active)
+			{
+				start = CpuTrace::get().now();
+			}
+		}
+
+		~TraceZone()
+		{
+			if (active)
+			{
+				CpuTrace::get().addZone(name, start, CpuTrace::get().now());
+			}
+		}
+
+		TraceZone(const TraceZone&) = delete;
+		TraceZone& operator=(const TraceZone&) = delete;
+	};
+}
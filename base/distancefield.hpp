@@ -0,0 +1,227 @@
+/*
+* Coarse unsigned distance field of a triangle soup on a regular grid
+*
+* Voxels close to a triangle get their exact distance to it, the distances are then propagated to the rest of the grid
+* with a two pass chamfer transform over the 26 neighbors, which slightly overestimates the distance far from the surfaces
+* Without a sign the field can't tell inside from outside, it's meant for things that approach the surfaces from the open space
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <float.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <glm/glm.hpp>
+
+namespace vkTools
+{
+	class DistanceField
+	{
+	public:
+		/** @brief Voxels around the triangles' bounds that get the exact distance */
+		static const uint32_t NARROW_BAND = 1;
+		/** @brief Empty voxels around the triangles' bounds, so the field doesn't end at the outermost surfaces */
+		static const uint32_t BORDER = 2;
+
+	private:
+		glm::uvec3 size = glm::uvec3(0);
+		glm::vec3 origin = glm::vec3(0.0f);
+		float voxelSize = 1.0f;
+		std::vector<float> distances;
+
+		uint32_t index(uint32_t x, uint32_t y, uint32_t z) const
+		{
+			return (z * size.y + y) * size.x + x;
+		}
+
+		// Distance of a point to the closest point on a triangle (Ericson, Real-Time Collision Detection 5.1.5)
+		static float pointTriangleDistance(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+		{
+			const glm::vec3 ab = b - a;
+			const glm::vec3 ac = c - a;
+			const glm::vec3 ap = p - a;
+			const float d1 = glm::dot(ab, ap);
+			const float d2 = glm::dot(ac, ap);
+			if ((d1 <= 0.0f) && (d2 <= 0.0f))
+			{
+				return glm::length(ap);
+			}
+			const glm::vec3 bp = p - b;
+			const float d3 = glm::dot(ab, bp);
+			const float d4 = glm::dot(ac, bp);
+			if ((d3 >= 0.0f) && (d4 <= d3))
+			{
+				return glm::length(bp);
+			}
+			const float vc = d1 * d4 - d3 * d2;
+			if ((vc <= 0.0f) && (d1 >= 0.0f) && (d3 <= 0.0f))
+			{
+				return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+			}
+			const glm::vec3 cp = p - c;
+			const float d5 = glm::dot(ab, cp);
+			const float d6 = glm::dot(ac, cp);
+			if ((d6 >= 0.0f) && (d5 <= d6))
+			{
+				return glm::length(cp);
+			}
+			const float vb = d5 * d2 - d1 * d6;
+			if ((vb <= 0.0f) && (d2 >= 0.0f) && (d6 <= 0.0f))
+			{
+				return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+			}
+			const float va = d3 * d6 - d5 * d4;
+			if ((va <= 0.0f) && ((d4 - d3) >= 0.0f) && ((d5 - d6) >= 0.0f))
+			{
+				return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+			}
+			const float denom = 1.0f / (va + vb + vc);
+			return glm::length(p - (a + ab * (vb * denom) + ac * (vc * denom)));
+		}
+
+		// Forward pass over the 13 neighbors visited before a voxel, backward pass over the other 13
+		void propagate()
+		{
+			struct Neighbor
+			{
+				glm::ivec3 offset;
+				float distance;
+			};
+			std::vector<Neighbor> neighbors;
+			for (int32_t z = -1; z <= 0; z++)
+			{
+				for (int32_t y = -1; y <= 1; y++)
+				{
+					for (int32_t x = -1; x <= 1; x++)
+					{
+						if ((z < 0) || (y < 0) || ((y == 0) && (x < 0)))
+						{
+							neighbors.push_back({ glm::ivec3(x, y, z), voxelSize * std::sqrt(static_cast<float>(x * x + y * y + z * z)) });
+						}
+					}
+				}
+			}
+			const glm::ivec3 extent = glm::ivec3(size);
+			for (const int32_t direction : { 1, -1 })
+			{
+				for (int32_t i = 0; i < extent.z; i++)
+				{
+					const int32_t z = (direction > 0) ? i : extent.z - 1 - i;
+					for (int32_t j = 0; j < extent.y; j++)
+					{
+						const int32_t y = (direction > 0) ? j : extent.y - 1 - j;
+						for (int32_t k = 0; k < extent.x; k++)
+						{
+							const int32_t x = (direction > 0) ? k : extent.x - 1 - k;
+							float &distance = distances[index(x, y, z)];
+							for (const Neighbor &neighbor : neighbors)
+							{
+								const glm::ivec3 n = glm::ivec3(x, y, z) + neighbor.offset * direction;
+								if (glm::any(glm::lessThan(n, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(n, extent)))
+								{
+									continue;
+								}
+								distance = std::min(distance, distances[index(n.x, n.y, n.z)] + neighbor.distance);
+							}
+						}
+					}
+				}
+			}
+		}
+
+	public:
+		/**
+		* Build the field over the bounds of the triangles
+		*
+		* @param triangles Three vertices per triangle
+		* @param maxSize Voxels along the longest axis of the bounds, including the border
+		*
+		* @note Without triangles the field is a single voxel at FLT_MAX
+		*/
+		void build(const std::vector<glm::vec3> &triangles, uint32_t maxSize)
+		{
+			assert((triangles.size() % 3 == 0) && (maxSize > 2 * BORDER));
+			glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+			glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+			for (const glm::vec3 &v : triangles)
+			{
+				boundsMin = glm::min(boundsMin, v);
+				boundsMax = glm::max(boundsMax, v);
+			}
+			if (triangles.empty())
+			{
+				size = glm::uvec3(1);
+				origin = glm::vec3(0.0f);
+				voxelSize = 1.0f;
+				distances.assign(1, FLT_MAX);
+				return;
+			}
+
+			const glm::vec3 extent = boundsMax - boundsMin;
+			voxelSize = std::max(std::max(extent.x, extent.y), std::max(extent.z, FLT_MIN)) / static_cast<float>(maxSize - 2 * BORDER);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				size[axis] = std::min(static_cast<uint32_t>(std::ceil(extent[axis] / voxelSize)), maxSize - 2 * BORDER) + 2 * BORDER;
+			}
+			origin = boundsMin - glm::vec3(static_cast<float>(BORDER) * voxelSize);
+			distances.assign(static_cast<size_t>(size.x) * size.y * size.z, FLT_MAX);
+
+			// Voxel centers are at half voxel offsets from the origin
+			for (size_t t = 0; t < triangles.size(); t += 3)
+			{
+				const glm::vec3 &a = triangles[t];
+				const glm::vec3 &b = triangles[t + 1];
+				const glm::vec3 &c = triangles[t + 2];
+				const glm::vec3 triangleMin = (glm::min(a, glm::min(b, c)) - origin) / voxelSize - 0.5f;
+				const glm::vec3 triangleMax = (glm::max(a, glm::max(b, c)) - origin) / voxelSize - 0.5f;
+				const glm::ivec3 first = glm::max(glm::ivec3(glm::floor(triangleMin)) - static_cast<int32_t>(NARROW_BAND), glm::ivec3(0));
+				const glm::ivec3 last = glm::min(glm::ivec3(glm::ceil(triangleMax)) + static_cast<int32_t>(NARROW_BAND), glm::ivec3(size) - 1);
+				for (int32_t z = first.z; z <= last.z; z++)
+				{
+					for (int32_t y = first.y; y <= last.y; y++)
+					{
+						for (int32_t x = first.x; x <= last.x; x++)
+						{
+							const glm::vec3 center = origin + (glm::vec3(x, y, z) + 0.5f) * voxelSize;
+							float &distance = distances[index(x, y, z)];
+							distance = std::min(distance, pointTriangleDistance(center, a, b, c));
+						}
+					}
+				}
+			}
+
+			propagate();
+		}
+
+		/** @brief Voxels along each axis */
+		glm::uvec3 getSize() const
+		{
+			return size;
+		}
+
+		/** @brief Corner of the first voxel */
+		glm::vec3 getOrigin() const
+		{
+			return origin;
+		}
+
+		float getVoxelSize() const
+		{
+			return voxelSize;
+		}
+
+		/** @brief Distances from the voxels' centers to the closest triangle, x first, then y and z */
+		const std::vector<float> &getDistances() const
+		{
+			return distances;
+		}
+	};
+}
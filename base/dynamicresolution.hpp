@@ -0,0 +1,134 @@
+/*
+* Dynamic resolution controller
+*
+* Picks the resolution scale of the next frames from measured GPU frame times, to hold a target frame time
+* The frame time is assumed to grow with the number of pixels, i.e. with the square of the scale
+* Scales are quantized and only changed after a number of frames, as every change rebuilds the affected command buffers
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+
+namespace vkTools
+{
+	/**
+	* @brief Controls the resolution scale from GPU frame times
+	*
+	* The scale is lowered as soon as the smoothed frame time exceeds the target, and raised again once it drops below headroom * target
+	*/
+	class DynamicResolution
+	{
+	private:
+		float targetFrameTime;
+		float minScale;
+		float maxScale;
+		// Scales are multiples of scaleStep
+		float scaleStep;
+		// Minimum number of frames between two changes, so the smoothed time can settle at the new scale
+		uint32_t settleFrames;
+		// Weight of a new frame time in the exponential moving average
+		float smoothing = 0.1f;
+		// Fraction of the target the frame time has to fall below before the scale is raised
+		float headroom = 0.85f;
+
+		float scale;
+		float smoothedFrameTime = 0.0f;
+		uint32_t framesSinceChange = 0;
+
+		float quantize(float value)
+		{
+			return floorf(value / scaleStep + 0.001f) * scaleStep;
+		}
+
+	public:
+		/**
+		* Create a controller
+		*
+		* @param targetFrameTime GPU frame time to hold in milliseconds
+		* @param minScale Lowest resolution scale
+		* @param maxScale Highest resolution scale, also the initial one
+		* @param scaleStep Scales are multiples of this step
+		* @param settleFrames Minimum number of frames between two changes of the scale
+		*/
+		DynamicResolution(float targetFrameTime, float minScale = 0.5f, float maxScale = 1.0f, float scaleStep = 0.05f, uint32_t settleFrames = 30) :
+			targetFrameTime(targetFrameTime), minScale(minScale), maxScale(maxScale), scaleStep(scaleStep), settleFrames(settleFrames), scale(maxScale)
+		{
+			assert((minScale > 0.0f) && (minScale <= maxScale) && (scaleStep > 0.0f));
+		}
+
+		/** @brief Current resolution scale (fraction of the full resolution per axis) */
+		float getScale()
+		{
+			return scale;
+		}
+
+		/** @brief Exponential moving average of the GPU frame times in milliseconds */
+		float getSmoothedFrameTime()
+		{
+			return smoothedFrameTime;
+		}
+
+		void setTargetFrameTime(float milliseconds)
+		{
+			targetFrameTime = milliseconds;
+		}
+
+		/** @brief Go back to the highest scale, e.g. if the measurements don't apply anymore */
+		void reset()
+		{
+			scale = maxScale;
+			smoothedFrameTime = 0.0f;
+			framesSinceChange = 0;
+		}
+
+		/**
+		* Add the GPU time of a frame and update the scale
+		*
+		* @param frameTime GPU time of a frame rendered at the current scale in milliseconds, ignored if not positive
+		*
+		* @return True if the scale has changed
+		*/
+		bool update(float frameTime)
+		{
+			if (frameTime <= 0.0f)
+			{
+				return false;
+			}
+			smoothedFrameTime = (smoothedFrameTime > 0.0f) ? smoothedFrameTime + (frameTime - smoothedFrameTime) * smoothing : frameTime;
+			if (++framesSinceChange < settleFrames)
+			{
+				return false;
+			}
+
+			float newScale = scale;
+			if (smoothedFrameTime > targetFrameTime)
+			{
+				// Drop by at least one step
+				newScale = std::min(quantize(scale * sqrtf(targetFrameTime / smoothedFrameTime)), scale - scaleStep);
+			}
+			else if (smoothedFrameTime < targetFrameTime * headroom)
+			{
+				// Aim for the lower end of the band, so the raised scale doesn't immediately exceed the target
+				newScale = quantize(scale * sqrtf(targetFrameTime * headroom / smoothedFrameTime));
+			}
+			newScale = std::max(std::min(newScale, maxScale), minScale);
+			if (fabsf(newScale - scale) < scaleStep * 0.5f)
+			{
+				return false;
+			}
+
+			// Predict the frame time at the new scale until it has been measured
+			smoothedFrameTime *= (newScale * newScale) / (scale * scale);
+			scale = newScale;
+			framesSinceChange = 0;
+			return true;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+/*
+* Polls files for changes of their modification time or size
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace vkTools
+{
+	class FileWatcher
+	{
+	private:
+		struct FileState
+		{
+			// Zero if the file doesn't exist
+			int64_t modified = 0;
+			int64_t size = 0;
+
+			bool operator!=(const FileState &other) const
+			{
+				return (modified != other.modified) || (size != other.size);
+			}
+		};
+		std::unordered_map<std::string, FileState> files;
+
+		static FileState getState(const std::string &fileName)
+		{
+			FileState state;
+			struct stat fileStat;
+			if (stat(fileName.c_str(), &fileStat) == 0)
+			{
+				state.modified = static_cast<int64_t>(fileStat.st_mtime);
+				state.size = static_cast<int64_t>(fileStat.st_size);
+			}
+			return state;
+		}
+
+	public:
+		/** @brief Start watching a file, files that are already watched keep their state */
+		void add(const std::string &fileName)
+		{
+			if (files.find(fileName) == files.end())
+			{
+				files[fileName] = getState(fileName);
+			}
+		}
+
+		/** @brief Take over the current state of a watched file, e.g. after rewriting it, so the change isn't reported */
+		void refresh(const std::string &fileName)
+		{
+			auto file = files.find(fileName);
+			if (file != files.end())
+			{
+				file->second = getState(fileName);
+			}
+		}
+
+		/**
+		* Check all watched files for changes since they were added or last reported
+		*
+		* @param changed Receives the files that have changed, files that have been deleted are reported once they exist again
+		*/
+		void check(std::vector<std::string> &changed)
+		{
+			changed.clear();
+			for (auto& file : files)
+			{
+				const FileState state = getState(file.first);
+				if ((state.modified != 0) && (state != file.second))
+				{
+					changed.push_back(file.first);
+				}
+				file.second = state;
+			}
+		}
+	};
+}
@@ -0,0 +1,249 @@
+/*
+* Recording of the per frame state for deterministic replays
+*
+* Stores the camera, the global timer and an example defined state blob (e.g. the uniform buffer contents) of every frame,
+* together with the sequence of passes it submitted, so a replay can render the same frames and check it did
+* The state blobs are stored as the 32 bit words that changed since the previous frame, most of a frame's uniforms stay the same
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <glm/glm.hpp>
+
+namespace vkTools
+{
+	class FrameRecording
+	{
+	public:
+		struct Frame
+		{
+			// Global timer and the time step the frame was rendered with
+			float timer = 0.0f;
+			float frameTime = 0.0f;
+			glm::vec3 cameraPosition = glm::vec3(0.0f);
+			glm::vec3 cameraRotation = glm::vec3(0.0f);
+			// Example defined, e.g. the uniform buffer contents
+			std::vector<uint8_t> state;
+			// Passes submitted by the frame in their order, indices into the pass names
+			std::vector<uint16_t> passes;
+		};
+
+	private:
+		static const uint32_t MAGIC = 0x52464B56; // "VKFR"
+		static const uint32_t VERSION = 1;
+
+		std::vector<Frame> frames;
+		std::vector<std::string> passNames;
+
+		template <typename T> static void writeValue(std::ofstream &file, const T &value)
+		{
+			file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		template <typename T> static bool readValue(std::ifstream &file, T &value)
+		{
+			return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+		}
+
+		// Bit mask of the words that differ from the previous state followed by these words, a partial last word is compared as a whole
+		static void writeState(std::ofstream &file, const std::vector<uint8_t> &state, const std::vector<uint8_t> &previous)
+		{
+			const size_t wordCount = (state.size() + 3) / 4;
+			std::vector<uint8_t> mask((wordCount + 7) / 8, 0);
+			std::vector<uint32_t> changed;
+			for (size_t i = 0; i < wordCount; i++)
+			{
+				uint32_t word = 0;
+				uint32_t previousWord = 0;
+				const size_t size = std::min<size_t>(4, state.size() - i * 4);
+				memcpy(&word, &state[i * 4], size);
+				if (previous.size() == state.size())
+				{
+					memcpy(&previousWord, &previous[i * 4], size);
+				}
+				if ((previous.size() != state.size()) || (word != previousWord))
+				{
+					mask[i / 8] |= 1 << (i % 8);
+					changed.push_back(word);
+				}
+			}
+			file.write(reinterpret_cast<const char*>(mask.data()), mask.size());
+			file.write(reinterpret_cast<const char*>(changed.data()), changed.size() * sizeof(uint32_t));
+		}
+
+		static bool readState(std::ifstream &file, std::vector<uint8_t> &state, const std::vector<uint8_t> &previous)
+		{
+			const size_t wordCount = (state.size() + 3) / 4;
+			std::vector<uint8_t> mask((wordCount + 7) / 8);
+			if (!file.read(reinterpret_cast<char*>(mask.data()), mask.size()))
+			{
+				return false;
+			}
+			if (previous.size() == state.size())
+			{
+				state = previous;
+			}
+			for (size_t i = 0; i < wordCount; i++)
+			{
+				if ((mask[i / 8] & (1 << (i % 8))) == 0)
+				{
+					continue;
+				}
+				uint32_t word;
+				if (!readValue(file, word))
+				{
+					return false;
+				}
+				memcpy(&state[i * 4], &word, std::min<size_t>(4, state.size() - i * 4));
+			}
+			return true;
+		}
+
+	public:
+		/** @brief Append a frame, to be filled in by the caller */
+		Frame &addFrame()
+		{
+			frames.push_back(Frame());
+			return frames.back();
+		}
+
+		/** @brief Index of a pass name, added if it hasn't been used before */
+		uint16_t getPassIndex(const std::string &name)
+		{
+			for (size_t i = 0; i < passNames.size(); i++)
+			{
+				if (passNames[i] == name)
+				{
+					return static_cast<uint16_t>(i);
+				}
+			}
+			assert(passNames.size() < UINT16_MAX);
+			passNames.push_back(name);
+			return static_cast<uint16_t>(passNames.size() - 1);
+		}
+
+		const std::string &getPassName(uint16_t index) const
+		{
+			return passNames[index];
+		}
+
+		const Frame &getFrame(uint32_t index) const
+		{
+			return frames[index];
+		}
+
+		uint32_t getFrameCount() const
+		{
+			return static_cast<uint32_t>(frames.size());
+		}
+
+		/** @brief Write all frames to a file, returns false if it can't be written */
+		bool save(const std::string &filename) const
+		{
+			std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			writeValue(file, static_cast<uint32_t>(MAGIC));
+			writeValue(file, static_cast<uint32_t>(VERSION));
+			writeValue(file, static_cast<uint32_t>(passNames.size()));
+			for (auto& name : passNames)
+			{
+				writeValue(file, static_cast<uint32_t>(name.size()));
+				file.write(name.data(), name.size());
+			}
+			writeValue(file, static_cast<uint32_t>(frames.size()));
+			const std::vector<uint8_t> empty;
+			for (size_t i = 0; i < frames.size(); i++)
+			{
+				const Frame &frame = frames[i];
+				writeValue(file, frame.timer);
+				writeValue(file, frame.frameTime);
+				writeValue(file, frame.cameraPosition);
+				writeValue(file, frame.cameraRotation);
+				writeValue(file, static_cast<uint32_t>(frame.passes.size()));
+				file.write(reinterpret_cast<const char*>(frame.passes.data()), frame.passes.size() * sizeof(uint16_t));
+				writeValue(file, static_cast<uint32_t>(frame.state.size()));
+				writeState(file, frame.state, (i > 0) ? frames[i - 1].state : empty);
+			}
+			return file.good();
+		}
+
+		/** @brief Read the frames of a file written by save, returns false if it can't be read or is of another version */
+		bool load(const std::string &filename)
+		{
+			std::ifstream file(filename, std::ios::in | std::ios::binary);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			frames.clear();
+			passNames.clear();
+			uint32_t magic, version, count;
+			if (!readValue(file, magic) || (magic != MAGIC) || !readValue(file, version) || (version != VERSION) || !readValue(file, count))
+			{
+				return false;
+			}
+			passNames.resize(count);
+			for (auto& name : passNames)
+			{
+				uint32_t length;
+				if (!readValue(file, length))
+				{
+					return false;
+				}
+				name.resize(length);
+				if ((length > 0) && !file.read(&name[0], length))
+				{
+					return false;
+				}
+			}
+			if (!readValue(file, count))
+			{
+				return false;
+			}
+			frames.resize(count);
+			const std::vector<uint8_t> empty;
+			for (size_t i = 0; i < frames.size(); i++)
+			{
+				Frame &frame = frames[i];
+				uint32_t size;
+				if (!readValue(file, frame.timer) || !readValue(file, frame.frameTime) || !readValue(file, frame.cameraPosition) || !readValue(file, frame.cameraRotation) || !readValue(file, size))
+				{
+					return false;
+				}
+				frame.passes.resize(size);
+				if (!file.read(reinterpret_cast<char*>(frame.passes.data()), size * sizeof(uint16_t)) || !readValue(file, size))
+				{
+					return false;
+				}
+				for (auto pass : frame.passes)
+				{
+					if (pass >= passNames.size())
+					{
+						return false;
+					}
+				}
+				frame.state.resize(size);
+				if (!readState(file, frame.state, (i > 0) ? frames[i - 1].state : empty))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+}
@@ -1,21 +1,102 @@
 /*
 * View frustum culling class
 *
+* Batches of spheres stored as structure of arrays are culled four at a time with SSE2 or NEON (scalar otherwise)
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <array>
+#include <algorithm>
+#include <vector>
 #include <math.h>
+#include <float.h>
+#include <stdint.h>
+#include <assert.h>
 #include <glm/glm.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FRUSTUM_SIMD_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FRUSTUM_SIMD_NEON
+#endif
+
+// Four wide float operations used by the batched culling
+namespace frustumSimd
+{
+#if defined(FRUSTUM_SIMD_SSE)
+	typedef __m128 float4;
+	inline float4 load(const float *p) { return _mm_loadu_ps(p); }
+	inline float4 set1(float f) { return _mm_set1_ps(f); }
+	// a * b + c
+	inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	inline float4 add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+	inline float4 min(float4 a, float4 b) { return _mm_min_ps(a, b); }
+	// Bit i is set if lane i is greater than zero
+	inline uint32_t positiveMask(float4 v) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpgt_ps(v, _mm_setzero_ps()))); }
+#elif defined(FRUSTUM_SIMD_NEON)
+	typedef float32x4_t float4;
+	inline float4 load(const float *p) { return vld1q_f32(p); }
+	inline float4 set1(float f) { return vdupq_n_f32(f); }
+	inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+	inline float4 add(float4 a, float4 b) { return vaddq_f32(a, b); }
+	inline float4 min(float4 a, float4 b) { return vminq_f32(a, b); }
+	inline uint32_t positiveMask(float4 v)
+	{
+		static const uint32_t bits[4] = { 1, 2, 4, 8 };
+		uint32x4_t mask = vandq_u32(vcgtq_f32(v, vdupq_n_f32(0.0f)), vld1q_u32(bits));
+		uint32x2_t lanes = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+		return vget_lane_u32(vpadd_u32(lanes, lanes), 0);
+	}
+#else
+	struct float4 { float v[4]; };
+	inline float4 load(const float *p) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+	inline float4 set1(float f) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = f; return r; }
+	inline float4 madd(float4 a, float4 b, float4 c) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * b.v[i] + c.v[i]; return r; }
+	inline float4 add(float4 a, float4 b) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] + b.v[i]; return r; }
+	inline float4 min(float4 a, float4 b) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = (a.v[i] < b.v[i]) ? a.v[i] : b.v[i]; return r; }
+	inline uint32_t positiveMask(float4 v) { uint32_t m = 0; for (int i = 0; i < 4; i++) m |= (v.v[i] > 0.0f) ? (1u << i) : 0u; return m; }
+#endif
+}
+
 namespace vkTools
 {
+	// Bounding spheres as structure of arrays for batched culling
+	// The arrays are padded to a multiple of four with spheres that are never visible
+	struct SphereBatch
+	{
+		std::vector<float> x, y, z, radius;
+		uint32_t count = 0;
+
+		void assign(const std::vector<glm::vec4> &spheres)
+		{
+			count = static_cast<uint32_t>(spheres.size());
+			const size_t padded = (spheres.size() + 3) & ~size_t(3);
+			x.assign(padded, 0.0f);
+			y.assign(padded, 0.0f);
+			z.assign(padded, 0.0f);
+			radius.assign(padded, -FLT_MAX);
+			for (size_t i = 0; i < spheres.size(); i++)
+			{
+				x[i] = spheres[i].x;
+				y[i] = spheres[i].y;
+				z[i] = spheres[i].z;
+				radius[i] = spheres[i].w;
+			}
+		}
+	};
+
 	class Frustum
 	{
 	public:
 		enum side { LEFT = 0, RIGHT = 1, TOP = 2, BOTTOM = 3, BACK = 4, FRONT = 5 };
+		enum Intersection { OUTSIDE = 0, INTERSECTING = 1, INSIDE = 2 };
 		std::array<glm::vec4, 6> planes;
 
 		void update(glm::mat4 matrix)
@@ -50,16 +131,67 @@ namespace vkTools
 			planes[FRONT].z = matrix[2].w - matrix[2].z;
 			planes[FRONT].w = matrix[3].w - matrix[3].z;
 
-			for (auto i = 0; i < planes.size(); i++)
+			for (size_t i = 0; i < planes.size(); i++)
 			{
 				float length = sqrtf(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
 				planes[i] /= length;
 			}
 		}
 		
+		/**
+		* Cull a range of spheres, same test as checkSphere
+		*
+		* @param first Index of the first sphere, must be a multiple of four
+		* @param last Index after the last sphere
+		* @param visible Receives the indices of the visible spheres in ascending order, needs room for last - first indices
+		*
+		* @return Number of visible spheres written
+		*/
+		uint32_t cullSpheres(const SphereBatch &spheres, uint32_t first, uint32_t last, uint32_t *visible) const
+		{
+			using namespace frustumSimd;
+			assert(((first & 3) == 0) && (last <= spheres.count));
+			// Planes are broadcast to all lanes, so each lane tests its own sphere against them
+			float4 planeX[6], planeY[6], planeZ[6], planeW[6];
+			for (uint32_t p = 0; p < 6; p++)
+			{
+				planeX[p] = set1(planes[p].x);
+				planeY[p] = set1(planes[p].y);
+				planeZ[p] = set1(planes[p].z);
+				planeW[p] = set1(planes[p].w);
+			}
+			uint32_t visibleCount = 0;
+			for (uint32_t i = first; i < last; i += 4)
+			{
+				const float4 x = load(&spheres.x[i]);
+				const float4 y = load(&spheres.y[i]);
+				const float4 z = load(&spheres.z[i]);
+				const float4 r = load(&spheres.radius[i]);
+				// Smallest signed distance of the spheres' surface to the planes, without early exit to stay branch free
+				float4 distance = add(madd(planeX[0], x, madd(planeY[0], y, madd(planeZ[0], z, planeW[0]))), r);
+				for (uint32_t p = 1; p < 6; p++)
+				{
+					distance = min(distance, add(madd(planeX[p], x, madd(planeY[p], y, madd(planeZ[p], z, planeW[p]))), r));
+				}
+				uint32_t mask = positiveMask(distance);
+				if (last - i < 4)
+				{
+					mask &= (1u << (last - i)) - 1;
+				}
+				// Compact the visible lanes' indices
+				while (mask != 0)
+				{
+					const uint32_t lane = (mask & 1) ? 0 : (mask & 2) ? 1 : (mask & 4) ? 2 : 3;
+					visible[visibleCount++] = i + lane;
+					mask &= mask - 1;
+				}
+			}
+			return visibleCount;
+		}
+
 		bool checkSphere(glm::vec3 pos, float radius)
 		{
-			for (auto i = 0; i < planes.size(); i++)
+			for (size_t i = 0; i < planes.size(); i++)
 			{
 				if ((planes[i].x * pos.x) + (planes[i].y * pos.y) + (planes[i].z * pos.z) + planes[i].w <= -radius)
 				{
@@ -68,5 +200,51 @@ namespace vkTools
 			}
 			return true;
 		}
+
+		// Check if a cone may reach into the frustum, cones outside of a single plane are culled
+		// The cone starts at apex and extends along the normalized axis to the given length, cosAngle is the cosine of its half angle
+		bool checkCone(const glm::vec3 &apex, const glm::vec3 &axis, float length, float cosAngle) const
+		{
+			const glm::vec3 baseCenter = apex + axis * length;
+			const float baseRadius = length * sqrtf(std::max(1.0f - cosAngle * cosAngle, 0.0f)) / std::max(cosAngle, 1e-4f);
+			for (size_t i = 0; i < planes.size(); i++)
+			{
+				const glm::vec3 normal(planes[i]);
+				if (glm::dot(normal, apex) + planes[i].w > 0.0f)
+				{
+					continue;
+				}
+				// Point of the base's rim farthest along the plane's normal
+				const float axisDot = glm::dot(normal, axis);
+				const float rim = baseRadius * sqrtf(std::max(1.0f - axisDot * axisDot, 0.0f));
+				if (glm::dot(normal, baseCenter) + planes[i].w + rim <= 0.0f)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Classify an axis aligned box against the frustum
+		// Boxes close to the frustum's corners may be reported as intersecting although they are outside
+		Intersection checkBox(const glm::vec3 &min, const glm::vec3 &max) const
+		{
+			Intersection result = INSIDE;
+			for (size_t i = 0; i < planes.size(); i++)
+			{
+				// Corners farthest along and against the plane's normal
+				const glm::vec3 positive(planes[i].x >= 0.0f ? max.x : min.x, planes[i].y >= 0.0f ? max.y : min.y, planes[i].z >= 0.0f ? max.z : min.z);
+				const glm::vec3 negative(planes[i].x >= 0.0f ? min.x : max.x, planes[i].y >= 0.0f ? min.y : max.y, planes[i].z >= 0.0f ? min.z : max.z);
+				if (glm::dot(glm::vec3(planes[i]), positive) + planes[i].w <= 0.0f)
+				{
+					return OUTSIDE;
+				}
+				if (glm::dot(glm::vec3(planes[i]), negative) + planes[i].w <= 0.0f)
+				{
+					result = INTERSECTING;
+				}
+			}
+			return result;
+		}
 	};
 }
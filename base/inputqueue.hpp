@@ -0,0 +1,72 @@
+/*
+* Lock-free queue of timestamped input events
+*
+* Filled by the platform's event thread as the events arrive and drained by the render thread before it samples the frame's input
+* Only one thread may push and only one other thread may pop
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+namespace vkTools
+{
+	template <typename T, uint32_t Capacity>
+	class InputQueue
+	{
+		static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	public:
+		struct Event
+		{
+			// Time the event has been received by the event thread
+			std::chrono::high_resolution_clock::time_point timestamp;
+			T event;
+		};
+
+	private:
+		std::array<Event, Capacity> events;
+		// Only written by the producer, the counters wrap around and are masked on access
+		std::atomic<uint32_t> tail;
+		// Only written by the consumer
+		std::atomic<uint32_t> head;
+
+	public:
+		InputQueue() : tail(0), head(0)
+		{
+		}
+
+		/** @brief Append an event, returns false if the queue is full */
+		bool push(const T &event, std::chrono::high_resolution_clock::time_point timestamp)
+		{
+			const uint32_t t = tail.load(std::memory_order_relaxed);
+			if (t - head.load(std::memory_order_acquire) >= Capacity)
+			{
+				return false;
+			}
+			events[t & (Capacity - 1)] = { timestamp, event };
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+		/** @brief Remove the oldest event, returns false if the queue is empty */
+		bool pop(Event &event)
+		{
+			const uint32_t h = head.load(std::memory_order_relaxed);
+			if (h == tail.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			event = events[h & (Capacity - 1)];
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+	};
+}
@@ -0,0 +1,404 @@
+/*
+* Work stealing job system
+*
+* Every thread owns a fixed size lock-free job queue (Chase-Lev deque)
+* Threads push and pop jobs at the bottom of their own queue, idle threads steal from the top of other queues
+* The thread that created the job system takes part in execution while waiting for jobs to finish
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+#include "cputrace.hpp"
+#include "cputopology.hpp"
+
+namespace vkTools
+{
+	class JobSystem
+	{
+	public:
+		// Jobs decrement their counter after they have been executed
+		typedef std::atomic<uint32_t> Counter;
+
+		// Maximum number of jobs in flight submitted by a single thread
+		static const uint32_t JOB_CAPACITY = 4096;
+
+	private:
+		struct Job
+		{
+			std::function<void()> function;
+			Counter *counter = nullptr;
+			// Set from allocation until a thread has taken the job out of its slot
+			std::atomic<bool> pending{ false };
+		};
+
+		// Fixed size Chase-Lev work stealing deque
+		// push and pop may only be called by the owning thread, steal may be called by any thread
+		class JobQueue
+		{
+		private:
+			std::atomic<int64_t> top;
+			std::atomic<int64_t> bottom;
+			std::array<std::atomic<Job*>, JOB_CAPACITY> jobs;
+
+		public:
+			JobQueue() : top(0), bottom(0)
+			{
+				for (auto& job : jobs)
+				{
+					job.store(nullptr, std::memory_order_relaxed);
+				}
+			}
+
+			// Returns false if the queue is full
+			bool push(Job *job)
+			{
+				int64_t b = bottom.load(std::memory_order_relaxed);
+				int64_t t = top.load(std::memory_order_acquire);
+				if (b - t >= static_cast<int64_t>(JOB_CAPACITY))
+				{
+					return false;
+				}
+				jobs[b & (JOB_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return true;
+			}
+
+			Job* pop()
+			{
+				int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+				bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t t = top.load(std::memory_order_relaxed);
+				if (t > b)
+				{
+					// Queue is empty
+					bottom.store(b + 1, std::memory_order_relaxed);
+					return nullptr;
+				}
+				Job *job = jobs[b & (JOB_CAPACITY - 1)].load(std::memory_order_relaxed);
+				if (t == b)
+				{
+					// Last job in the queue, race against thieves
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					{
+						job = nullptr;
+					}
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return job;
+			}
+
+			Job* steal()
+			{
+				int64_t t = top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t b = bottom.load(std::memory_order_acquire);
+				if (t >= b)
+				{
+					return nullptr;
+				}
+				Job *job = jobs[t & (JOB_CAPACITY - 1)].load(std::memory_order_relaxed);
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					// Lost the race against another thief or the owner
+					return nullptr;
+				}
+				return job;
+			}
+		};
+
+		struct Worker
+		{
+			JobQueue queue;
+			// Ring buffer the jobs submitted by this thread are allocated from
+			std::array<Job, JOB_CAPACITY> jobs;
+			uint32_t allocatedJobs = 0;
+			std::thread thread;
+		};
+
+		// Index 0 belongs to the thread that created the job system
+		std::vector<std::unique_ptr<Worker>> workers;
+
+		// Number of jobs that have been queued but not yet picked up by a thread
+		std::atomic<uint32_t> queuedJobs;
+		std::atomic<uint32_t> sleepingWorkers;
+		std::atomic<bool> destroying;
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+
+		struct ThreadContext
+		{
+			const JobSystem *jobSystem;
+			uint32_t index;
+		};
+
+		static ThreadContext& threadContext()
+		{
+			static thread_local ThreadContext context = { nullptr, 0 };
+			return context;
+		}
+
+		// Returns nullptr if the next slot of the ring buffer still holds a job that hasn't been picked up
+		// Jobs are popped in reverse order and stolen in submission order, so slots aren't freed in allocation order
+		Job* allocateJob(Worker& worker)
+		{
+			Job *job = &worker.jobs[worker.allocatedJobs & (JOB_CAPACITY - 1)];
+			if (job->pending.load(std::memory_order_acquire))
+			{
+				return nullptr;
+			}
+			worker.allocatedJobs++;
+			job->pending.store(true, std::memory_order_relaxed);
+			return job;
+		}
+
+		static void invoke(const std::function<void()> &function, Counter *counter)
+		{
+			function();
+			if (counter)
+			{
+				counter->fetch_sub(1, std::memory_order_release);
+			}
+		}
+
+		void execute(Job *job)
+		{
+			// Move the function out, so the job's slot can be reused as soon as possible
+			std::function<void()> function = std::move(job->function);
+			Counter *counter = job->counter;
+			job->pending.store(false, std::memory_order_release);
+			invoke(function, counter);
+		}
+
+		// Queue a job on the current thread's queue, or run it directly if the queue or the job ring buffer is full
+		// Returns true if the job has been queued
+		bool submit(Worker& worker, std::function<void()> function, Counter *counter)
+		{
+			Job *job = allocateJob(worker);
+			if (!job)
+			{
+				invoke(function, counter);
+				return false;
+			}
+			job->function = std::move(function);
+			job->counter = counter;
+			if (!worker.queue.push(job))
+			{
+				execute(job);
+				return false;
+			}
+			return true;
+		}
+
+		// Wake up sleeping workers after jobs have been queued
+		void notify(uint32_t count)
+		{
+			if (count == 0)
+			{
+				return;
+			}
+			queuedJobs.fetch_add(count);
+			if (sleepingWorkers.load() > 0)
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				if (count == 1)
+				{
+					sleepCondition.notify_one();
+				}
+				else
+				{
+					sleepCondition.notify_all();
+				}
+			}
+		}
+
+		// Pop a job from the thread's own queue or steal one from another thread
+		Job* fetchJob(uint32_t index)
+		{
+			Job *job = workers[index]->queue.pop();
+			const uint32_t workerCount = static_cast<uint32_t>(workers.size());
+			for (uint32_t i = 1; !job && i < workerCount; i++)
+			{
+				job = workers[(index + i) % workerCount]->queue.steal();
+			}
+			if (job)
+			{
+				queuedJobs.fetch_sub(1);
+			}
+			return job;
+		}
+
+		bool runJob(uint32_t index)
+		{
+			Job *job = fetchJob(index);
+			if (job)
+			{
+				execute(job);
+				return true;
+			}
+			return false;
+		}
+
+		void workerLoop(uint32_t index)
+		{
+			threadContext() = { this, index };
+			CpuTrace::get().setThreadName("Worker " + std::to_string(index));
+			// The frame waits for the recording jobs, so they mustn't land on slow cores
+			CpuTopology::get().setThreadRole(CpuTopology::THREAD_ROLE_LATENCY);
+			while (!destroying.load())
+			{
+				if (runJob(index))
+				{
+					continue;
+				}
+				// Spin for a short while before going to sleep, jobs are often submitted in quick succession
+				bool found = false;
+				for (uint32_t i = 0; i < 64 && !found; i++)
+				{
+					std::this_thread::yield();
+					found = queuedJobs.load() > 0;
+				}
+				if (found)
+				{
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepingWorkers.fetch_add(1);
+				sleepCondition.wait(lock, [this] { return queuedJobs.load() > 0 || destroying.load(); });
+				sleepingWorkers.fetch_sub(1);
+			}
+		}
+
+	public:
+		// Index of the current thread, 0 for the thread that created the job system (and threads not owned by it)
+		// Jobs may only be submitted from threads owned by this job system
+		uint32_t getThreadIndex()
+		{
+			const ThreadContext& context = threadContext();
+			return (context.jobSystem == this) ? context.index : 0;
+		}
+
+		// Creates the given number of worker threads in addition to the calling thread
+		explicit JobSystem(uint32_t workerCount) : queuedJobs(0), sleepingWorkers(0), destroying(false)
+		{
+			workers.resize(workerCount + 1);
+			for (auto& worker : workers)
+			{
+				worker.reset(new Worker());
+			}
+			threadContext() = { this, 0 };
+			for (uint32_t i = 1; i < workers.size(); i++)
+			{
+				workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+			}
+		}
+
+		~JobSystem()
+		{
+			// Finish all outstanding work before shutting down
+			while (runJob(0)) {}
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				destroying.store(true);
+				sleepCondition.notify_all();
+			}
+			for (auto& worker : workers)
+			{
+				if (worker->thread.joinable())
+				{
+					worker->thread.join();
+				}
+			}
+			if (threadContext().jobSystem == this)
+			{
+				threadContext() = { nullptr, 0 };
+			}
+		}
+
+		// Number of threads executing jobs, including the thread that created the job system
+		uint32_t getThreadCount()
+		{
+			return static_cast<uint32_t>(workers.size());
+		}
+
+		// Queue a single job
+		// Can be called from the thread that created the job system and from within jobs
+		void run(std::function<void()> function, Counter *counter = nullptr)
+		{
+			if (counter)
+			{
+				counter->fetch_add(1, std::memory_order_relaxed);
+			}
+			notify(submit(*workers[getThreadIndex()], std::move(function), counter) ? 1 : 0);
+		}
+
+		// Queue a batch of jobs, sleeping workers are only woken up once for the whole batch
+		// The functions are moved into the jobs
+		void run(std::vector<std::function<void()>>& functions, Counter *counter = nullptr)
+		{
+			if (counter)
+			{
+				counter->fetch_add(static_cast<uint32_t>(functions.size()), std::memory_order_relaxed);
+			}
+			Worker& worker = *workers[getThreadIndex()];
+			uint32_t queued = 0;
+			for (auto& function : functions)
+			{
+				if (submit(worker, std::move(function), counter))
+				{
+					queued++;
+				}
+			}
+			notify(queued);
+		}
+
+		// Wait until the counter has reached zero, the calling thread executes jobs in the meantime
+		void wait(Counter& counter)
+		{
+			const uint32_t index = getThreadIndex();
+			while (counter.load(std::memory_order_acquire) > 0)
+			{
+				if (!runJob(index))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		// Call function(first, last) for all ranges of batchSize indices in [0, count) and wait for them to finish
+		void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t first, uint32_t last)>& function)
+		{
+			if (count == 0)
+			{
+				return;
+			}
+			batchSize = std::max(batchSize, 1u);
+			std::vector<std::function<void()>> functions;
+			functions.reserve((count + batchSize - 1) / batchSize);
+			for (uint32_t first = 0; first < count; first += batchSize)
+			{
+				const uint32_t last = std::min(first + batchSize, count);
+				const std::function<void(uint32_t, uint32_t)> *f = &function;
+				functions.push_back([f, first, last] { (*f)(first, last); });
+			}
+			Counter counter(0);
+			run(functions, &counter);
+			wait(counter);
+		}
+	};
+}
@@ -14,6 +14,7 @@
 #define KEY_F2 VK_F2
 #define KEY_F3 VK_F3
 #define KEY_F4 VK_F4
+#define KEY_F12 VK_F12
 #define KEY_W 0x57
 #define KEY_A 0x41
 #define KEY_S 0x53
@@ -28,6 +29,7 @@
 #define KEY_N 0x4E
 #define KEY_O 0x4F
 #define KEY_T 0x54
+#define KEY_Q 0x51
 #elif defined(__ANDROID__)
 // Dummy key codes 
 #define KEY_ESCAPE 0x0
@@ -37,6 +39,7 @@
 #define KEY_F2 0x12
 #define KEY_F3 0x13
 #define KEY_F4 0x14
+#define KEY_F12 0x15
 #define KEY_W 0x3
 #define KEY_A 0x4
 #define KEY_S 0x5
@@ -51,12 +54,14 @@
 #define KEY_N 0xE
 #define KEY_O 0xF
 #define KEY_T 0x10
+#define KEY_Q 0x16
 #elif defined(__linux__)
 #define KEY_ESCAPE 0x9
 #define KEY_F1 0x43
 #define KEY_F2 0x44
 #define KEY_F3 0x45
 #define KEY_F4 0x46
+#define KEY_F12 0x60
 #define KEY_W 0x19
 #define KEY_A 0x26
 #define KEY_S 0x27
@@ -71,6 +76,7 @@
 #define KEY_N 0x39
 #define KEY_O 0x20
 #define KEY_T 0x1C
+#define KEY_Q 0x18
 #endif
 
 // todo: Android gamepad keycodes outside of define for now
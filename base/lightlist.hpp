@@ -0,0 +1,109 @@
+/*
+* Scene lights loaded from a text file
+*
+* The lights that used to be set up in code are listed in a file, so adding or moving one is a data change
+* The example copies them into its fixed number of light slots, lights beyond them are ignored and unused slots are disabled
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+namespace vkTools
+{
+	/**
+	* @brief List of spot lights
+	*
+	* One light per line: "spot", position x y z, direction x y z and color r g b, optionally followed by
+	* the range and the inner and outer cone angle in degrees
+	* Empty lines and lines starting with # are ignored
+	*/
+	class LightList
+	{
+	public:
+		struct Light
+		{
+			glm::vec3 position = glm::vec3(0.0f);
+			glm::vec3 direction = glm::vec3(0.0f, 0.0f, 1.0f);
+			glm::vec3 color = glm::vec3(1.0f);
+			float range = 10000.0f;
+			// Cone angles in degrees, the light fades out between them
+			float innerAngle = 15.0f;
+			float outerAngle = 25.0f;
+		};
+
+		std::vector<Light> lights;
+
+		/**
+		* Load the lights from a file, malformed lines are reported and skipped
+		*
+		* @param filename Name of the light file
+		*
+		* @return True if the file could be read
+		*/
+		bool load(const std::string &filename)
+		{
+			std::ifstream file(filename);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			lights.clear();
+			std::string line;
+			uint32_t lineNumber = 0;
+			while (std::getline(file, line))
+			{
+				lineNumber++;
+				const size_t first = line.find_first_not_of(" \t\r");
+				if ((first == std::string::npos) || (line[first] == '#'))
+				{
+					continue;
+				}
+				std::istringstream ss(line);
+				std::string type;
+				Light light;
+				ss >> type;
+				if (type != "spot")
+				{
+					std::cout << filename << ":" << lineNumber << ": Unknown light type \"" << type << "\"" << std::endl;
+					continue;
+				}
+				if (!(ss >> light.position.x >> light.position.y >> light.position.z >> light.direction.x >> light.direction.y >> light.direction.z >> light.color.r >> light.color.g >> light.color.b))
+				{
+					std::cout << filename << ":" << lineNumber << ": Expected position, direction and color" << std::endl;
+					continue;
+				}
+				// The optional values keep their defaults if missing
+				float range, innerAngle, outerAngle;
+				if (ss >> range)
+				{
+					light.range = range;
+					if (ss >> innerAngle >> outerAngle)
+					{
+						light.innerAngle = innerAngle;
+						light.outerAngle = outerAngle;
+					}
+				}
+				if ((glm::length(light.direction) == 0.0f) || (light.range <= 0.0f) || (light.innerAngle > light.outerAngle))
+				{
+					std::cout << filename << ":" << lineNumber << ": Invalid direction, range or cone angles" << std::endl;
+					continue;
+				}
+				light.direction = glm::normalize(light.direction);
+				lights.push_back(light);
+			}
+			return true;
+		}
+	};
+}
@@ -0,0 +1,224 @@
+/*
+* Linear arena allocator for transient CPU data
+*
+* Allocations bump a pointer through a block of memory and are only freed all at once by reset, typically at the end of a frame
+* When a frame needed more than one block, reset replaces them by a single block of their combined size, so after a few frames
+* the arena serves all allocations of a frame from one block without touching the heap
+* ArenaAllocator adapts an arena to the standard containers, deallocation is a no-op
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <stdint.h>
+#include <cstddef>
+#include <assert.h>
+
+namespace vkTools
+{
+	/**
+	* Number of heap allocations done through the global operator new
+	* Only counted if built with COUNT_ALLOCATIONS, which replaces the global operator new (see vulkanexamplebase.cpp)
+	*/
+	inline std::atomic<uint64_t>& heapAllocationCount()
+	{
+		static std::atomic<uint64_t> count(0);
+		return count;
+	}
+
+	class LinearArena
+	{
+	private:
+		struct Block
+		{
+			uint8_t *data;
+			size_t size;
+		};
+		std::vector<Block> blocks;
+		size_t blockSize;
+		// Offset into the last block
+		size_t offset = 0;
+		// Bytes handed out since the last reset, including the alignment padding
+		size_t used = 0;
+		size_t peak = 0;
+
+		void addBlock(size_t minSize)
+		{
+			Block block;
+			block.size = std::max(blockSize, minSize);
+			block.data = static_cast<uint8_t*>(::operator new(block.size));
+			blocks.push_back(block);
+			offset = 0;
+		}
+
+		void freeBlocks()
+		{
+			for (auto& block : blocks)
+			{
+				::operator delete(block.data);
+			}
+			blocks.clear();
+		}
+
+	public:
+		/** @param blockSize Size of the first block, later blocks are at least this large */
+		explicit LinearArena(size_t blockSize = 64 * 1024) : blockSize(blockSize)
+		{
+			// Never reallocates, so only the blocks themselves are allocated on the heap after the first frames
+			blocks.reserve(32);
+		}
+
+		LinearArena(const LinearArena&) = delete;
+		LinearArena& operator=(const LinearArena&) = delete;
+
+		~LinearArena()
+		{
+			freeBlocks();
+		}
+
+		/** @brief Allocate size bytes, valid until the next reset */
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+		{
+			assert((alignment & (alignment - 1)) == 0);
+			if (!blocks.empty())
+			{
+				const Block &block = blocks.back();
+				const uintptr_t address = reinterpret_cast<uintptr_t>(block.data) + offset;
+				const size_t padding = static_cast<size_t>(((address + alignment - 1) & ~(uintptr_t)(alignment - 1)) - address);
+				if (offset + padding + size <= block.size)
+				{
+					offset += padding + size;
+					used += padding + size;
+					return block.data + offset - size;
+				}
+			}
+			// Block data is aligned for any fundamental type, larger alignments get room for the padding
+			const size_t padding = (alignment > alignof(std::max_align_t)) ? alignment : 0;
+			addBlock(size + padding);
+			return allocate(size, alignment);
+		}
+
+		/** @brief Free all allocations at once */
+		void reset()
+		{
+			peak = std::max(peak, used);
+			if (blocks.size() > 1)
+			{
+				// Merge into a single block that fits everything allocated since the last reset
+				blockSize = std::max(blockSize, peak);
+				freeBlocks();
+				addBlock(blockSize);
+			}
+			offset = 0;
+			used = 0;
+		}
+
+		/** @brief Bytes allocated since the last reset */
+		size_t getUsed() const
+		{
+			return used;
+		}
+
+		/** @brief Largest number of bytes allocated between two resets */
+		size_t getPeak() const
+		{
+			return std::max(peak, used);
+		}
+	};
+
+	/** @brief Standard allocator handing out memory of a linear arena */
+	template <typename T>
+	class ArenaAllocator
+	{
+	public:
+		typedef T value_type;
+
+		LinearArena *arena;
+
+		ArenaAllocator(LinearArena *arena) : arena(arena) {}
+
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+		T* allocate(size_t n)
+		{
+			return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		// Memory is only freed by resetting the arena
+		void deallocate(T*, size_t) {}
+
+		template <typename U>
+		bool operator==(const ArenaAllocator<U> &other) const
+		{
+			return arena == other.arena;
+		}
+
+		template <typename U>
+		bool operator!=(const ArenaAllocator<U> &other) const
+		{
+			return arena != other.arena;
+		}
+	};
+
+	template <typename T>
+	using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+	/**
+	* One arena per thread of a job system, reset together at the end of a frame
+	* Arenas are indexed by the job system's thread index, so each thread allocates from its own arena without locking
+	*/
+	class FrameArenas
+	{
+	private:
+		std::vector<std::unique_ptr<LinearArena>> arenas;
+
+	public:
+		FrameArenas(uint32_t threadCount = 1, size_t blockSize = 64 * 1024)
+		{
+			resize(threadCount, blockSize);
+		}
+
+		void resize(uint32_t threadCount, size_t blockSize = 64 * 1024)
+		{
+			arenas.clear();
+			for (uint32_t i = 0; i < std::max(threadCount, 1u); i++)
+			{
+				arenas.push_back(std::unique_ptr<LinearArena>(new LinearArena(blockSize)));
+			}
+		}
+
+		LinearArena& get(uint32_t threadIndex)
+		{
+			assert(threadIndex < arenas.size());
+			return *arenas[threadIndex];
+		}
+
+		/** @brief Free the allocations of all threads, no thread may still be using its arena's memory */
+		void reset()
+		{
+			for (auto& arena : arenas)
+			{
+				arena->reset();
+			}
+		}
+
+		/** @brief Peak usage of all arenas in bytes */
+		size_t getPeak() const
+		{
+			size_t peak = 0;
+			for (auto& arena : arenas)
+			{
+				peak += arena->getPeak();
+			}
+			return peak;
+		}
+	};
+}
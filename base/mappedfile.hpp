@@ -0,0 +1,140 @@
+/*
+* Read only memory mapped file
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vkTools
+{
+	class MappedFile
+	{
+	private:
+#if defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+#else
+		int file = -1;
+#endif
+		void *mapped = nullptr;
+		size_t size = 0;
+
+	public:
+		MappedFile() {}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			close();
+		}
+
+		// Map the whole file into memory, returns false if the file doesn't exist or can't be mapped
+		bool open(const std::string &filename)
+		{
+			close();
+#if defined(_WIN32)
+			file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0))
+			{
+				close();
+				return false;
+			}
+			size = static_cast<size_t>(fileSize.QuadPart);
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping == NULL)
+			{
+				close();
+				return false;
+			}
+			mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+			file = ::open(filename.c_str(), O_RDONLY);
+			if (file < 0)
+			{
+				return false;
+			}
+			struct stat fileStat;
+			if ((fstat(file, &fileStat) != 0) || (fileStat.st_size == 0))
+			{
+				close();
+				return false;
+			}
+			size = static_cast<size_t>(fileStat.st_size);
+			mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (mapped == MAP_FAILED)
+			{
+				mapped = nullptr;
+			}
+#endif
+			if (!mapped)
+			{
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void close()
+		{
+#if defined(_WIN32)
+			if (mapped)
+			{
+				UnmapViewOfFile(mapped);
+			}
+			if (mapping != NULL)
+			{
+				CloseHandle(mapping);
+				mapping = NULL;
+			}
+			if (file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(file);
+				file = INVALID_HANDLE_VALUE;
+			}
+#else
+			if (mapped)
+			{
+				munmap(mapped, size);
+			}
+			if (file >= 0)
+			{
+				::close(file);
+				file = -1;
+			}
+#endif
+			mapped = nullptr;
+			size = 0;
+		}
+
+		const void* data() const
+		{
+			return mapped;
+		}
+
+		size_t getSize() const
+		{
+			return size;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,797 @@
+/*
+* Load time mesh optimization
+*
+* Post-transform vertex cache reordering (Tipsify, Sander et al. 2007)
+* Overdraw reduction by sorting the Tipsify clusters outside-in
+* Vertex fetch remapping so vertices are stored in the order they are first referenced
+* Vertex cache analysis (ACMR and ATVR) for a FIFO cache
+* Cluster (meshlet) building with bounding spheres and normal cones for culling
+* Simplification by quadric error driven edge collapses for LOD generation
+*
+* All functions work on the indices of a single mesh in the range [0, vertexCount)
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+#include <assert.h>
+
+#include <glm/glm.hpp>
+
+namespace vkTools
+{
+	namespace meshOptimizer
+	{
+		/** @brief Size of the simulated post-transform vertex cache */
+		static const uint32_t VERTEX_CACHE_SIZE = 16;
+
+		/** @brief Vertex cache statistics of an index buffer */
+		struct VertexCacheStatistics
+		{
+			/** @brief Number of vertex shader invocations */
+			uint32_t transformedVertices = 0;
+			uint32_t triangleCount = 0;
+			/** @brief Number of distinct vertices referenced by the indices */
+			uint32_t vertexCount = 0;
+
+			/** @brief Average cache miss ratio, transformed vertices per triangle (0.5 is optimal for large regular meshes, 3 is worst) */
+			float getACMR() const
+			{
+				return (triangleCount > 0) ? (float)transformedVertices / triangleCount : 0.0f;
+			}
+
+			/** @brief Average transform to vertex ratio, transformed vertices per referenced vertex (1 is optimal) */
+			float getATVR() const
+			{
+				return (vertexCount > 0) ? (float)transformedVertices / vertexCount : 0.0f;
+			}
+
+			void add(const VertexCacheStatistics &other)
+			{
+				transformedVertices += other.transformedVertices;
+				triangleCount += other.triangleCount;
+				vertexCount += other.vertexCount;
+			}
+		};
+
+		// FIFO cache using time stamps, a vertex is cached if it has been transformed within the last cacheSize misses
+		class FifoCache
+		{
+		private:
+			std::vector<uint32_t> timeStamps;
+			uint32_t cacheSize;
+			uint32_t time;
+
+		public:
+			FifoCache(uint32_t vertexCount, uint32_t cacheSize) : timeStamps(vertexCount, 0), cacheSize(cacheSize), time(cacheSize + 1) {}
+
+			bool cached(uint32_t vertex) const
+			{
+				return time - timeStamps[vertex] <= cacheSize;
+			}
+
+			// Returns true on a cache miss
+			bool access(uint32_t vertex)
+			{
+				if (cached(vertex))
+				{
+					return false;
+				}
+				timeStamps[vertex] = time++;
+				return true;
+			}
+
+			uint32_t getTime() const
+			{
+				return time;
+			}
+
+			uint32_t getTimeStamp(uint32_t vertex) const
+			{
+				return timeStamps[vertex];
+			}
+		};
+
+		/**
+		* Simulate a FIFO post-transform cache for a triangle list
+		*
+		* @param indices Triangle list indices
+		* @param indexCount Number of indices
+		* @param vertexCount Number of vertices the indices refer to
+		* @param cacheSize Number of cache entries
+		*/
+		inline VertexCacheStatistics analyzeVertexCache(const uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE)
+		{
+			assert(indexCount % 3 == 0);
+			VertexCacheStatistics stats;
+			stats.triangleCount = static_cast<uint32_t>(indexCount / 3);
+			FifoCache cache(vertexCount, cacheSize);
+			std::vector<bool> referenced(vertexCount, false);
+			for (size_t i = 0; i < indexCount; i++)
+			{
+				assert(indices[i] < vertexCount);
+				if (cache.access(indices[i]))
+				{
+					stats.transformedVertices++;
+				}
+				if (!referenced[indices[i]])
+				{
+					referenced[indices[i]] = true;
+					stats.vertexCount++;
+				}
+			}
+			return stats;
+		}
+
+		/**
+		* Reorder the triangles for the post-transform vertex cache using Tipsify
+		*
+		* @param indices Triangle list indices, reordered in place
+		* @param indexCount Number of indices
+		* @param vertexCount Number of vertices the indices refer to
+		* @param cacheSize Number of cache entries the order is optimized for
+		* @param clusters (Optional) Receives the index of the first triangle of each cluster, a new cluster starts where the traversal had to jump
+		*/
+		inline void optimizeVertexCache(uint32_t *indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE, std::vector<uint32_t> *clusters = nullptr)
+		{
+			assert(indexCount % 3 == 0);
+			const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+			if (clusters)
+			{
+				clusters->clear();
+			}
+			if (triangleCount == 0)
+			{
+				return;
+			}
+
+			// Vertex to triangle adjacency
+			std::vector<uint32_t> liveTriangles(vertexCount, 0);
+			for (size_t i = 0; i < indexCount; i++)
+			{
+				liveTriangles[indices[i]]++;
+			}
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (uint32_t v = 0; v < vertexCount; v++)
+			{
+				adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+			}
+			std::vector<uint32_t> adjacency(indexCount);
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t t = 0; t < triangleCount; t++)
+			{
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					adjacency[fill[indices[t * 3 + c]]++] = t;
+				}
+			}
+
+			std::vector<uint32_t> output;
+			output.reserve(indexCount);
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> deadEnd;
+			std::vector<uint32_t> candidates;
+			FifoCache cache(vertexCount, cacheSize);
+
+			int64_t fanningVertex = indices[0];
+			uint32_t cursor = 0;
+			bool jumped = true;
+			while (fanningVertex >= 0)
+			{
+				const uint32_t f = static_cast<uint32_t>(fanningVertex);
+				if (jumped && clusters)
+				{
+					clusters->push_back(static_cast<uint32_t>(output.size() / 3));
+				}
+
+				// Emit all remaining triangles around the fanning vertex
+				candidates.clear();
+				for (uint32_t a = adjacencyOffsets[f]; a < adjacencyOffsets[f + 1]; a++)
+				{
+					const uint32_t t = adjacency[a];
+					if (emitted[t])
+					{
+						continue;
+					}
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						const uint32_t v = indices[t * 3 + c];
+						output.push_back(v);
+						deadEnd.push_back(v);
+						candidates.push_back(v);
+						liveTriangles[v]--;
+						cache.access(v);
+					}
+					emitted[t] = true;
+				}
+
+				// Pick the next fanning vertex among the candidates that will still be in the cache after fanning it
+				int64_t best = -1;
+				int64_t bestPriority = -1;
+				for (auto v : candidates)
+				{
+					if (liveTriangles[v] == 0)
+					{
+						continue;
+					}
+					int64_t priority = 0;
+					const uint32_t age = cache.getTime() - cache.getTimeStamp(v);
+					if (age + 2 * liveTriangles[v] <= cacheSize)
+					{
+						priority = age;
+					}
+					if (priority > bestPriority)
+					{
+						best = v;
+						bestPriority = priority;
+					}
+				}
+				jumped = false;
+
+				// Dead end, continue with the most recently used vertex with live triangles or the next one in input order
+				while ((best < 0) && !deadEnd.empty())
+				{
+					const uint32_t v = deadEnd.back();
+					deadEnd.pop_back();
+					if (liveTriangles[v] > 0)
+					{
+						best = v;
+					}
+				}
+				while ((best < 0) && (cursor < indexCount))
+				{
+					const uint32_t v = indices[cursor++];
+					if (liveTriangles[v] > 0)
+					{
+						best = v;
+						jumped = true;
+					}
+				}
+				fanningVertex = best;
+			}
+
+			assert(output.size() == indexCount);
+			std::copy(output.begin(), output.end(), indices);
+		}
+
+		/**
+		* Reorder the clusters of a vertex cache optimized triangle list to reduce overdraw
+		*
+		* Clusters whose triangles face away from the mesh center are drawn first, as they are more likely to occlude the rest of the mesh
+		* Clusters are split further where this doesn't raise their cache miss ratio above threshold times the mesh's ratio
+		*
+		* @param indices Triangle list indices as ordered by optimizeVertexCache, reordered in place
+		* @param indexCount Number of indices
+		* @param positions Vertex positions
+		* @param vertexCount Number of vertices the indices refer to
+		* @param clusters First triangle of each cluster as returned by optimizeVertexCache
+		* @param threshold Maximum increase of the cache miss ratio that is accepted for additional cluster splits
+		* @param cacheSize Number of cache entries the order has been optimized for
+		*/
+		inline void optimizeOverdraw(uint32_t *indices, size_t indexCount, const glm::vec3 *positions, uint32_t vertexCount, std::vector<uint32_t> clusters, float threshold = 1.05f, uint32_t cacheSize = VERTEX_CACHE_SIZE)
+		{
+			assert(indexCount % 3 == 0);
+			const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+			if (triangleCount == 0)
+			{
+				return;
+			}
+			if (clusters.empty() || (clusters[0] != 0))
+			{
+				clusters.insert(clusters.begin(), 0);
+			}
+
+			// Split the clusters where the cache has been flushed anyway (all three vertices of a triangle miss)
+			const float targetACMR = analyzeVertexCache(indices, indexCount, vertexCount, cacheSize).getACMR() * threshold;
+			std::vector<uint32_t> splitClusters;
+			FifoCache cache(vertexCount, cacheSize);
+			size_t next = 0;
+			uint32_t clusterStart = 0;
+			uint32_t clusterMisses = 0;
+			for (uint32_t t = 0; t < triangleCount; t++)
+			{
+				uint32_t misses = 0;
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					misses += cache.access(indices[t * 3 + c]) ? 1 : 0;
+				}
+				const bool hardBoundary = (next < clusters.size()) && (clusters[next] == t);
+				const bool softBoundary = (misses == 3) && (t > clusterStart) && ((float)clusterMisses / (t - clusterStart) <= targetACMR);
+				if (hardBoundary || softBoundary)
+				{
+					splitClusters.push_back(t);
+					clusterStart = t;
+					clusterMisses = 0;
+				}
+				if (hardBoundary)
+				{
+					next++;
+				}
+				clusterMisses += misses;
+			}
+
+			// Sort key is the distance of the cluster's centroid from the mesh centroid along the cluster's average normal
+			struct Cluster
+			{
+				uint32_t firstTriangle;
+				uint32_t triangleCount;
+				float sortKey;
+			};
+			std::vector<Cluster> sortedClusters(splitClusters.size());
+			std::vector<glm::vec3> centroids(splitClusters.size(), glm::vec3(0.0f));
+			std::vector<glm::vec3> normals(splitClusters.size(), glm::vec3(0.0f));
+			glm::vec3 meshCentroid(0.0f);
+			float meshArea = 0.0f;
+			for (size_t i = 0; i < splitClusters.size(); i++)
+			{
+				Cluster &cluster = sortedClusters[i];
+				cluster.firstTriangle = splitClusters[i];
+				cluster.triangleCount = ((i + 1 < splitClusters.size()) ? splitClusters[i + 1] : triangleCount) - cluster.firstTriangle;
+				float clusterArea = 0.0f;
+				for (uint32_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++)
+				{
+					const glm::vec3 &p0 = positions[indices[t * 3]];
+					const glm::vec3 &p1 = positions[indices[t * 3 + 1]];
+					const glm::vec3 &p2 = positions[indices[t * 3 + 2]];
+					// Length of the cross product is twice the area, so the normals are area weighted
+					const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+					const float area = glm::length(normal);
+					centroids[i] += (p0 + p1 + p2) * (area / 3.0f);
+					normals[i] += normal;
+					clusterArea += area;
+				}
+				meshCentroid += centroids[i];
+				meshArea += clusterArea;
+				centroids[i] = (clusterArea > 0.0f) ? centroids[i] / clusterArea : positions[indices[cluster.firstTriangle * 3]];
+			}
+			meshCentroid = (meshArea > 0.0f) ? meshCentroid / meshArea : meshCentroid;
+			for (size_t i = 0; i < sortedClusters.size(); i++)
+			{
+				const float length = glm::length(normals[i]);
+				sortedClusters[i].sortKey = (length > 0.0f) ? glm::dot(centroids[i] - meshCentroid, normals[i] / length) : 0.0f;
+			}
+			std::stable_sort(sortedClusters.begin(), sortedClusters.end(), [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+			std::vector<uint32_t> output;
+			output.reserve(indexCount);
+			for (auto &cluster : sortedClusters)
+			{
+				output.insert(output.end(), indices + cluster.firstTriangle * 3, indices + (cluster.firstTriangle + cluster.triangleCount) * 3);
+			}
+			std::copy(output.begin(), output.end(), indices);
+		}
+
+		/**
+		* Build a vertex remap table that stores the vertices in the order they are first referenced by the indices
+		*
+		* The indices are rewritten to the new vertex order, unreferenced vertices are moved to the end
+		*
+		* @param indices Triangle list indices, remapped in place
+		* @param indexCount Number of indices
+		* @param vertexCount Number of vertices the indices refer to
+		*
+		* @return Remap table, the vertex at index i has to be moved to remap[i]
+		*/
+		inline std::vector<uint32_t> optimizeVertexFetch(uint32_t *indices, size_t indexCount, uint32_t vertexCount)
+		{
+			const uint32_t unused = ~0u;
+			std::vector<uint32_t> remap(vertexCount, unused);
+			uint32_t nextVertex = 0;
+			for (size_t i = 0; i < indexCount; i++)
+			{
+				uint32_t &target = remap[indices[i]];
+				if (target == unused)
+				{
+					target = nextVertex++;
+				}
+				indices[i] = target;
+			}
+			for (auto &target : remap)
+			{
+				if (target == unused)
+				{
+					target = nextVertex++;
+				}
+			}
+			return remap;
+		}
+
+		/**
+		* @brief Cluster of consecutive triangles of a mesh (meshlet)
+		*
+		* The cluster is backfacing for all points p with dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius
+		*/
+		struct Cluster
+		{
+			/** @brief Range of the mesh's indices */
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			/** @brief Bounding sphere */
+			glm::vec3 center;
+			float radius;
+			/** @brief Average normal of the cluster's triangles */
+			glm::vec3 coneAxis;
+			/** @brief Sine of the cone's half angle, 1 if the triangles' normals are spread too wide for culling */
+			float coneCutoff;
+		};
+
+		/**
+		* Split a triangle list into clusters of consecutive triangles
+		*
+		* The triangles are not reordered, so the index order of optimizeVertexCache also keeps the clusters spatially coherent
+		*
+		* @param indices Triangle list indices
+		* @param indexCount Number of indices
+		* @param positions Vertex positions
+		* @param vertexCount Number of vertices the indices refer to
+		* @param maxVertices Maximum number of distinct vertices per cluster
+		* @param maxTriangles Maximum number of triangles per cluster
+		* @param flipWinding True if front faces are wound clockwise (in a right handed coordinate system)
+		*/
+		inline std::vector<Cluster> buildClusters(const uint32_t *indices, size_t indexCount, const glm::vec3 *positions, uint32_t vertexCount, uint32_t maxVertices = 64, uint32_t maxTriangles = 124, bool flipWinding = false)
+		{
+			assert(indexCount % 3 == 0);
+			assert(maxVertices >= 3);
+			const uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+			std::vector<Cluster> clusters;
+
+			// Cluster each vertex has last been added to
+			std::vector<uint32_t> vertexCluster(vertexCount, ~0u);
+			uint32_t clusterVertices = 0;
+			uint32_t firstTriangle = 0;
+			for (uint32_t t = 0; t <= triangleCount; t++)
+			{
+				uint32_t newVertices = 0;
+				if (t < triangleCount)
+				{
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						newVertices += (vertexCluster[indices[t * 3 + c]] != clusters.size()) ? 1 : 0;
+					}
+				}
+				const bool full = (t - firstTriangle >= maxTriangles) || (clusterVertices + newVertices > maxVertices);
+				if ((t == triangleCount) || full)
+				{
+					if (t == firstTriangle)
+					{
+						break;
+					}
+					Cluster cluster;
+					cluster.firstIndex = firstTriangle * 3;
+					cluster.indexCount = (t - firstTriangle) * 3;
+
+					// Sphere around the center of the cluster's bounding box
+					glm::vec3 boundsMin(FLT_MAX);
+					glm::vec3 boundsMax(-FLT_MAX);
+					for (uint32_t i = cluster.firstIndex; i < cluster.firstIndex + cluster.indexCount; i++)
+					{
+						boundsMin = glm::min(boundsMin, positions[indices[i]]);
+						boundsMax = glm::max(boundsMax, positions[indices[i]]);
+					}
+					cluster.center = (boundsMin + boundsMax) * 0.5f;
+					cluster.radius = 0.0f;
+					for (uint32_t i = cluster.firstIndex; i < cluster.firstIndex + cluster.indexCount; i++)
+					{
+						cluster.radius = std::max(cluster.radius, glm::length(positions[indices[i]] - cluster.center));
+					}
+
+					// Normal cone around the average of the triangles' unit normals
+					std::vector<glm::vec3> normals;
+					normals.reserve(t - firstTriangle);
+					glm::vec3 axis(0.0f);
+					for (uint32_t i = firstTriangle; i < t; i++)
+					{
+						const glm::vec3 &p0 = positions[indices[i * 3]];
+						const glm::vec3 &p1 = positions[indices[i * 3 + 1]];
+						const glm::vec3 &p2 = positions[indices[i * 3 + 2]];
+						glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+						const float length = glm::length(normal);
+						if (length > 0.0f)
+						{
+							normal *= (flipWinding ? -1.0f : 1.0f) / length;
+							normals.push_back(normal);
+							axis += normal;
+						}
+					}
+					const float axisLength = glm::length(axis);
+					cluster.coneAxis = (axisLength > 0.0f) ? axis / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+					float minDot = (axisLength > 0.0f) ? 1.0f : -1.0f;
+					for (auto &normal : normals)
+					{
+						minDot = std::min(minDot, glm::dot(normal, cluster.coneAxis));
+					}
+					// Cones wider than ~85 degrees are close to never being backfacing as a whole
+					cluster.coneCutoff = (minDot <= 0.1f) ? 1.0f : sqrtf(1.0f - minDot * minDot);
+
+					clusters.push_back(cluster);
+					firstTriangle = t;
+					clusterVertices = 0;
+					if (t == triangleCount)
+					{
+						break;
+					}
+					newVertices = 3;
+				}
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					vertexCluster[indices[t * 3 + c]] = static_cast<uint32_t>(clusters.size());
+				}
+				clusterVertices += newVertices;
+			}
+			return clusters;
+		}
+
+		// Symmetric 4x4 matrix of a quadric error metric (Garland and Heckbert), the error of a point is its summed squared distance to a set of planes
+		struct Quadric
+		{
+			double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+			double a11 = 0, a12 = 0, a13 = 0;
+			double a22 = 0, a23 = 0;
+			double a33 = 0;
+
+			void addPlane(const glm::dvec3 &n, double d)
+			{
+				a00 += n.x * n.x; a01 += n.x * n.y; a02 += n.x * n.z; a03 += n.x * d;
+				a11 += n.y * n.y; a12 += n.y * n.z; a13 += n.y * d;
+				a22 += n.z * n.z; a23 += n.z * d;
+				a33 += d * d;
+			}
+
+			void add(const Quadric &q)
+			{
+				a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+				a11 += q.a11; a12 += q.a12; a13 += q.a13;
+				a22 += q.a22; a23 += q.a23;
+				a33 += q.a33;
+			}
+
+			double error(const glm::vec3 &p) const
+			{
+				const double x = p.x, y = p.y, z = p.z;
+				const double e =
+					a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x +
+					a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y +
+					a22 * z * z + 2.0 * a23 * z +
+					a33;
+				return std::max(e, 0.0);
+			}
+		};
+
+		/**
+		* Reduce the triangle count of a mesh by half edge collapses ordered by their quadric error
+		*
+		* Vertices are only moved onto other existing vertices, so the result references the same vertex data and can share its vertex buffer
+		* Vertices on open borders (including texture and normal seams, which are split vertices) are never moved
+		*
+		* @param indices Triangle list indices
+		* @param indexCount Number of indices
+		* @param positions Vertex positions
+		* @param vertexCount Number of vertices the indices refer to
+		* @param targetIndexCount Number of indices to stop at
+		* @param targetError Largest distance a collapse may move the surface
+		* @param error (Optional) Receives the largest distance a collapse has moved the surface, in the units of the positions
+		*
+		* @return Indices of the simplified triangle list, may have more than targetIndexCount indices if no further collapse is possible within targetError
+		*/
+		inline std::vector<uint32_t> simplify(const uint32_t *indices, size_t indexCount, const glm::vec3 *positions, uint32_t vertexCount, size_t targetIndexCount, float targetError = FLT_MAX, float *error = nullptr)
+		{
+			assert(indexCount % 3 == 0);
+			std::vector<uint32_t> result(indices, indices + indexCount);
+			double maxError = 0.0;
+			const double errorLimit = (double)targetError * targetError;
+
+			// Plane quadrics of the input triangles, not area weighted, so errors are distances
+			std::vector<Quadric> quadrics(vertexCount);
+			for (size_t t = 0; t < indexCount; t += 3)
+			{
+				const glm::dvec3 p0(positions[indices[t]]);
+				const glm::dvec3 p1(positions[indices[t + 1]]);
+				const glm::dvec3 p2(positions[indices[t + 2]]);
+				glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+				const double length = glm::length(n);
+				if (length == 0.0)
+				{
+					continue;
+				}
+				n /= length;
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					quadrics[indices[t + c]].addPlane(n, -glm::dot(n, p0));
+				}
+			}
+
+			struct Collapse
+			{
+				uint32_t from;
+				uint32_t to;
+				double error;
+			};
+			std::vector<Collapse> collapses;
+			std::vector<uint32_t> remap(vertexCount);
+			std::vector<bool> locked(vertexCount);
+			std::vector<bool> touched(vertexCount);
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+			std::vector<uint32_t> adjacency;
+			std::vector<std::pair<uint32_t, uint32_t>> edges;
+
+			// Each pass collapses a set of independent edges, so the adjacency only has to be rebuilt once per pass
+			while (result.size() > targetIndexCount)
+			{
+				const uint32_t triangleCount = static_cast<uint32_t>(result.size() / 3);
+
+				std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+				for (auto v : result)
+				{
+					adjacencyOffsets[v + 1]++;
+				}
+				for (uint32_t v = 0; v < vertexCount; v++)
+				{
+					adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+				}
+				adjacency.resize(result.size());
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (uint32_t t = 0; t < triangleCount; t++)
+				{
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						adjacency[fill[result[t * 3 + c]]++] = t;
+					}
+				}
+
+				// Edges used by exactly one triangle are open borders
+				edges.clear();
+				for (uint32_t t = 0; t < triangleCount; t++)
+				{
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						const uint32_t a = result[t * 3 + c];
+						const uint32_t b = result[t * 3 + (c + 1) % 3];
+						edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+					}
+				}
+				std::sort(edges.begin(), edges.end());
+				std::fill(locked.begin(), locked.end(), false);
+				for (size_t i = 0; i < edges.size();)
+				{
+					size_t j = i + 1;
+					while ((j < edges.size()) && (edges[j] == edges[i]))
+					{
+						j++;
+					}
+					if (j - i == 1)
+					{
+						locked[edges[i].first] = true;
+						locked[edges[i].second] = true;
+					}
+					i = j;
+				}
+
+				// Candidate collapses in both directions of each unique edge
+				collapses.clear();
+				edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+				for (auto &edge : edges)
+				{
+					Quadric q = quadrics[edge.first];
+					q.add(quadrics[edge.second]);
+					if (!locked[edge.first])
+					{
+						collapses.push_back({ edge.first, edge.second, q.error(positions[edge.second]) });
+					}
+					if (!locked[edge.second])
+					{
+						collapses.push_back({ edge.second, edge.first, q.error(positions[edge.first]) });
+					}
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+				for (uint32_t v = 0; v < vertexCount; v++)
+				{
+					remap[v] = v;
+				}
+				std::fill(touched.begin(), touched.end(), false);
+				size_t removedIndices = 0;
+				const size_t passTarget = result.size() - targetIndexCount;
+				for (auto &collapse : collapses)
+				{
+					if ((removedIndices >= passTarget) || (collapse.error > errorLimit))
+					{
+						break;
+					}
+					if (touched[collapse.from] || touched[collapse.to])
+					{
+						continue;
+					}
+
+					// Reject collapses that flip a remaining triangle
+					bool flipped = false;
+					uint32_t removedTriangles = 0;
+					for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flipped; a++)
+					{
+						const uint32_t *triangle = &result[adjacency[a] * 3];
+						if ((triangle[0] == collapse.to) || (triangle[1] == collapse.to) || (triangle[2] == collapse.to))
+						{
+							removedTriangles++;
+							continue;
+						}
+						glm::vec3 p[3], q[3];
+						for (uint32_t c = 0; c < 3; c++)
+						{
+							p[c] = positions[triangle[c]];
+							q[c] = positions[(triangle[c] == collapse.from) ? collapse.to : triangle[c]];
+						}
+						const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+						const glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+						flipped = glm::dot(before, after) <= 0.0f;
+					}
+					if (flipped)
+					{
+						continue;
+					}
+
+					remap[collapse.from] = collapse.to;
+					quadrics[collapse.to].add(quadrics[collapse.from]);
+					maxError = std::max(maxError, collapse.error);
+					removedIndices += removedTriangles * 3;
+					// Triangles around the collapsed vertex have changed, so their vertices are not collapsed again in this pass
+					for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++)
+					{
+						for (uint32_t c = 0; c < 3; c++)
+						{
+							touched[result[adjacency[a] * 3 + c]] = true;
+						}
+					}
+				}
+				if (removedIndices == 0)
+				{
+					break;
+				}
+
+				// Apply the collapses and drop the triangles that have become degenerate
+				size_t writeIndex = 0;
+				for (size_t t = 0; t < result.size(); t += 3)
+				{
+					const uint32_t a = remap[result[t]];
+					const uint32_t b = remap[result[t + 1]];
+					const uint32_t c = remap[result[t + 2]];
+					if ((a != b) && (b != c) && (a != c))
+					{
+						result[writeIndex++] = a;
+						result[writeIndex++] = b;
+						result[writeIndex++] = c;
+					}
+				}
+				result.resize(writeIndex);
+			}
+
+			if (error)
+			{
+				*error = static_cast<float>(sqrt(maxError));
+			}
+			return result;
+		}
+
+		/**
+		* Move vertices to their new position given by a remap table
+		*
+		* @param vertices Vertices, reordered in place
+		* @param remap Remap table as returned by optimizeVertexFetch
+		*/
+		template <typename T>
+		void remapVertices(T *vertices, const std::vector<uint32_t> &remap)
+		{
+			std::vector<T> source(vertices, vertices + remap.size());
+			for (size_t i = 0; i < remap.size(); i++)
+			{
+				vertices[remap[i]] = source[i];
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,184 @@
+/*
+* Adaptive quality governor
+*
+* Steps through a list of quality levels (0 = full quality) to keep the GPU frame time at a target over long sessions
+* Quality is lowered quickly once the smoothed frame time exceeds the target, and only raised again after it has stayed well below it
+* for a longer stretch, so the device isn't driven back into throttling right away
+* The device's thermal status additionally sets a lowest level that is used regardless of the frame times
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <assert.h>
+
+namespace vkTools
+{
+	class QualityGovernor
+	{
+	public:
+		// Same values as Android's AThermalStatus
+		enum ThermalStatus
+		{
+			THERMAL_STATUS_UNKNOWN = -1,
+			THERMAL_STATUS_NONE = 0,
+			THERMAL_STATUS_LIGHT = 1,
+			THERMAL_STATUS_MODERATE = 2,
+			THERMAL_STATUS_SEVERE = 3,
+			THERMAL_STATUS_CRITICAL = 4,
+		};
+
+	private:
+		float targetFrameTime;
+		uint32_t levelCount;
+		// Minimum number of frames between two changes, so the smoothed time can settle at the new level
+		uint32_t settleFrames;
+		// Frames below the headroom required before quality is raised, doubled whenever a raise had to be undone
+		uint32_t raiseFrames;
+		uint32_t raiseDelay;
+		// Weight of a new frame time in the exponential moving average
+		float smoothing = 0.05f;
+		// Fraction of the target the frame time has to fall below before quality is raised
+		float headroom = 0.7f;
+
+		uint32_t level = 0;
+		// Lowest quality required by the thermal status
+		uint32_t thermalLevel = 0;
+		float smoothedFrameTime = 0.0f;
+		uint32_t framesSinceChange = 0;
+		uint32_t framesBelowHeadroom = 0;
+		bool lastChangeRaised = false;
+
+		void setLevel(uint32_t newLevel)
+		{
+			lastChangeRaised = newLevel < level;
+			level = newLevel;
+			framesSinceChange = 0;
+			framesBelowHeadroom = 0;
+		}
+
+	public:
+		/**
+		* Create a governor
+		*
+		* @param targetFrameTime GPU frame time to hold in milliseconds
+		* @param levelCount Number of quality levels, level 0 is the full quality and the initial one
+		* @param settleFrames Minimum number of frames between two changes of the level
+		* @param raiseFrames Number of frames the frame time has to stay below the headroom before the quality is raised
+		*/
+		QualityGovernor(float targetFrameTime, uint32_t levelCount, uint32_t settleFrames = 60, uint32_t raiseFrames = 600) :
+			targetFrameTime(targetFrameTime), levelCount(levelCount), settleFrames(settleFrames), raiseFrames(raiseFrames), raiseDelay(raiseFrames)
+		{
+			assert((levelCount > 0) && (raiseFrames >= settleFrames));
+		}
+
+		/** @brief Current quality level, higher levels trade more quality for speed */
+		uint32_t getLevel()
+		{
+			return level;
+		}
+
+		/** @brief Exponential moving average of the GPU frame times in milliseconds */
+		float getSmoothedFrameTime()
+		{
+			return smoothedFrameTime;
+		}
+
+		void setTargetFrameTime(float milliseconds)
+		{
+			targetFrameTime = milliseconds;
+		}
+
+		/** @brief Go back to full quality, e.g. if the measurements don't apply anymore */
+		void reset()
+		{
+			level = thermalLevel;
+			smoothedFrameTime = 0.0f;
+			framesSinceChange = 0;
+			framesBelowHeadroom = 0;
+			raiseDelay = raiseFrames;
+			lastChangeRaised = false;
+		}
+
+		/**
+		* Set the device's thermal status, moderate and severe temperatures force the lower half and the lower third of the levels,
+		* critical ones the lowest level
+		*
+		* @return True if the level has changed
+		*/
+		bool setThermalStatus(int32_t status)
+		{
+			if (status >= THERMAL_STATUS_CRITICAL)
+			{
+				thermalLevel = levelCount - 1;
+			}
+			else if (status == THERMAL_STATUS_SEVERE)
+			{
+				thermalLevel = (levelCount * 2) / 3;
+			}
+			else if (status == THERMAL_STATUS_MODERATE)
+			{
+				thermalLevel = levelCount / 2;
+			}
+			else
+			{
+				thermalLevel = 0;
+			}
+			if (level < thermalLevel)
+			{
+				setLevel(thermalLevel);
+				return true;
+			}
+			// Cooling down doesn't raise the quality by itself, that's left to the frame times
+			return false;
+		}
+
+		/**
+		* Add the GPU time of a frame and update the level
+		*
+		* @param frameTime GPU time of a frame rendered at the current level in milliseconds, ignored if not positive
+		*
+		* @return True if the level has changed
+		*/
+		bool update(float frameTime)
+		{
+			if (frameTime <= 0.0f)
+			{
+				return false;
+			}
+			smoothedFrameTime = (smoothedFrameTime > 0.0f) ? smoothedFrameTime + (frameTime - smoothedFrameTime) * smoothing : frameTime;
+			if (++framesSinceChange < settleFrames)
+			{
+				return false;
+			}
+
+			if ((smoothedFrameTime > targetFrameTime) && (level + 1 < levelCount))
+			{
+				// The last raise didn't hold, so wait longer before trying again
+				if (lastChangeRaised && (framesSinceChange < raiseDelay * 2))
+				{
+					raiseDelay = std::min(raiseDelay * 2, raiseFrames * 8);
+				}
+				setLevel(level + 1);
+				return true;
+			}
+
+			framesBelowHeadroom = (smoothedFrameTime < targetFrameTime * headroom) ? framesBelowHeadroom + 1 : 0;
+			if ((framesBelowHeadroom >= raiseDelay) && (level > thermalLevel))
+			{
+				setLevel(level - 1);
+				return true;
+			}
+			// A long stable stretch at the current level forgets earlier failed raises
+			if (framesSinceChange >= raiseFrames * 8)
+			{
+				raiseDelay = raiseFrames;
+			}
+			return false;
+		}
+	};
+}
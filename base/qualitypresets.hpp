@@ -0,0 +1,243 @@
+/*
+* Quality presets loaded from a text file
+*
+* The file lists named presets as sections of key value pairs, followed by overrides for devices whose name contains a given string
+* Settings missing from a preset keep the values passed to load, so a preset only needs to list what it changes
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <stdlib.h>
+#include <ctype.h>
+#include <stdint.h>
+
+namespace vkTools
+{
+	/**
+	* @brief List of quality presets
+	*
+	* "[name]" starts a preset, "[name device]" overrides the settings of a preset on devices whose name contains "device"
+	* and "[* device]" those of all presets, followed by one "key = value" per line
+	* A "default = name" line outside of a preset selects the initial preset, later lines (e.g. of a device section) win
+	* Empty lines and lines starting with # are ignored
+	*/
+	class QualityPresets
+	{
+	public:
+		struct Preset
+		{
+			std::string name;
+			// Largest scale of the rendered resolution, lowered further by dynamic resolution
+			float renderScale = 1.0f;
+			bool ssao = true;
+			uint32_t ssaoKernelSize = 32;
+			// Radius of the shadow filter in texels
+			int32_t shadowPCFSize = 2;
+			bool lowShadowQuality = false;
+			// Largest shadow map tile of a spot light in texels, 0 for the whole atlas
+			uint32_t shadowResolution = 0;
+			// Upper limit of the point lights, 0 for all of them
+			uint32_t pointLights = 0;
+			bool vsync = false;
+		};
+
+	private:
+		std::vector<Preset> presets;
+		std::string defaultPreset;
+
+		static std::string trim(const std::string &s)
+		{
+			const size_t first = s.find_first_not_of(" \t\r");
+			if (first == std::string::npos)
+			{
+				return "";
+			}
+			return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+		}
+
+		// Returns false for unknown keys
+		static bool applySetting(Preset &preset, const std::string &key, const std::string &value)
+		{
+			if (key == "renderscale")
+			{
+				preset.renderScale = std::max(0.25f, std::min(static_cast<float>(atof(value.c_str())), 1.0f));
+			}
+			else if (key == "ssao")
+			{
+				preset.ssao = atoi(value.c_str()) != 0;
+			}
+			else if (key == "ssaokernel")
+			{
+				preset.ssaoKernelSize = static_cast<uint32_t>(std::max(8, std::min(atoi(value.c_str()), 256)));
+			}
+			else if (key == "shadowpcf")
+			{
+				preset.shadowPCFSize = std::max(1, std::min(atoi(value.c_str()), 4));
+			}
+			else if (key == "lowshadowquality")
+			{
+				preset.lowShadowQuality = atoi(value.c_str()) != 0;
+			}
+			else if (key == "shadowresolution")
+			{
+				preset.shadowResolution = static_cast<uint32_t>(std::max(0, atoi(value.c_str())));
+			}
+			else if (key == "pointlights")
+			{
+				preset.pointLights = static_cast<uint32_t>(std::max(0, atoi(value.c_str())));
+			}
+			else if (key == "vsync")
+			{
+				preset.vsync = atoi(value.c_str()) != 0;
+			}
+			else
+			{
+				return false;
+			}
+			return true;
+		}
+
+	public:
+		/**
+		* Load the presets from a file
+		*
+		* @param filename Name of the preset file
+		* @param deviceName Name of the physical device, selects the device overrides
+		* @param defaults Settings of a preset that doesn't list them
+		*
+		* @return True if the file could be read and contains at least one preset
+		*/
+		bool load(const std::string &filename, const std::string &deviceName, const Preset &defaults)
+		{
+			std::ifstream file(filename);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			presets.clear();
+			defaultPreset.clear();
+
+			// Lines of the device sections are applied after all presets have been read, so they may come first
+			struct Override
+			{
+				std::string preset;
+				std::string key;
+				std::string value;
+				uint32_t lineNumber;
+			};
+			std::vector<Override> overrides;
+			std::string section;
+			bool deviceSection = false;
+			bool skipSection = false;
+			std::string line;
+			uint32_t lineNumber = 0;
+			while (std::getline(file, line))
+			{
+				lineNumber++;
+				line = trim(line);
+				if (line.empty() || (line[0] == '#'))
+				{
+					continue;
+				}
+				if (line[0] == '[')
+				{
+					std::istringstream ss(line.substr(1, line.find(']') - 1));
+					std::string device;
+					ss >> section;
+					std::getline(ss, device);
+					device = trim(device);
+					deviceSection = !device.empty();
+					skipSection = deviceSection && (deviceName.find(device) == std::string::npos);
+					if (!deviceSection)
+					{
+						presets.push_back(defaults);
+						presets.back().name = section;
+					}
+					continue;
+				}
+				const size_t separator = line.find('=');
+				if (separator == std::string::npos)
+				{
+					std::cout << filename << ":" << lineNumber << ": Expected \"key = value\"" << std::endl;
+					continue;
+				}
+				std::string key = trim(line.substr(0, separator));
+				const std::string value = trim(line.substr(separator + 1));
+				std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+				if (skipSection)
+				{
+					continue;
+				}
+				if (key == "default")
+				{
+					if (section.empty() || deviceSection)
+					{
+						defaultPreset = value;
+					}
+					continue;
+				}
+				if (deviceSection)
+				{
+					overrides.push_back({ section, key, value, lineNumber });
+					continue;
+				}
+				if (section.empty() || !applySetting(presets.back(), key, value))
+				{
+					std::cout << filename << ":" << lineNumber << ": Unknown setting \"" << key << "\"" << std::endl;
+				}
+			}
+
+			for (auto& entry : overrides)
+			{
+				for (auto& preset : presets)
+				{
+					if (((entry.preset == "*") || (entry.preset == preset.name)) && !applySetting(preset, entry.key, entry.value))
+					{
+						std::cout << filename << ":" << entry.lineNumber << ": Unknown setting \"" << entry.key << "\"" << std::endl;
+						break;
+					}
+				}
+			}
+			return !presets.empty();
+		}
+
+		/** @brief Index of a preset by its name, -1 if there's none */
+		int32_t find(const std::string &name) const
+		{
+			for (size_t i = 0; i < presets.size(); i++)
+			{
+				if (presets[i].name == name)
+				{
+					return static_cast<int32_t>(i);
+				}
+			}
+			return -1;
+		}
+
+		/** @brief Index of the preset selected by the file for the device, -1 if it doesn't select any */
+		int32_t getDefault() const
+		{
+			return defaultPreset.empty() ? -1 : find(defaultPreset);
+		}
+
+		const Preset &get(uint32_t index) const
+		{
+			return presets[index];
+		}
+
+		uint32_t getCount() const
+		{
+			return static_cast<uint32_t>(presets.size());
+		}
+	};
+}
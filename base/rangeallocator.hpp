@@ -0,0 +1,116 @@
+/*
+* First fit allocator for ranges of a fixed size pool, e.g. the elements of a buffer shared by many users
+*
+* Only does the bookkeeping, the pool itself is owned by the caller
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <assert.h>
+
+namespace vkTools
+{
+	class RangeAllocator
+	{
+	public:
+		/** @brief Returned by allocate if no free range is large enough */
+		static const uint32_t INVALID_OFFSET = UINT32_MAX;
+
+	private:
+		struct Range
+		{
+			uint32_t offset;
+			uint32_t size;
+		};
+		// Free ranges sorted by offset, neighbouring ranges are always merged
+		std::vector<Range> freeRanges;
+		uint32_t capacity = 0;
+		uint32_t allocatedSize = 0;
+
+	public:
+		/** @brief Free all ranges and set the size of the pool */
+		void reset(uint32_t capacity)
+		{
+			this->capacity = capacity;
+			allocatedSize = 0;
+			freeRanges.clear();
+			if (capacity > 0)
+			{
+				freeRanges.push_back({ 0, capacity });
+			}
+		}
+
+		/**
+		* Allocate a range from the first free range it fits into
+		*
+		* @return Offset of the range, INVALID_OFFSET if the pool is too fragmented or full
+		*/
+		uint32_t allocate(uint32_t size)
+		{
+			if (size == 0)
+			{
+				return 0;
+			}
+			for (size_t i = 0; i < freeRanges.size(); i++)
+			{
+				Range &range = freeRanges[i];
+				if (range.size < size)
+				{
+					continue;
+				}
+				const uint32_t offset = range.offset;
+				range.offset += size;
+				range.size -= size;
+				if (range.size == 0)
+				{
+					freeRanges.erase(freeRanges.begin() + i);
+				}
+				allocatedSize += size;
+				return offset;
+			}
+			return INVALID_OFFSET;
+		}
+
+		/** @brief Return a range to the pool, it must have been allocated with the same size */
+		void free(uint32_t offset, uint32_t size)
+		{
+			if (size == 0)
+			{
+				return;
+			}
+			assert(offset + size <= capacity);
+			assert(allocatedSize >= size);
+			allocatedSize -= size;
+			// Insert the range sorted by offset and merge it with its neighbours
+			auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset, [](const Range &range, uint32_t offset) { return range.offset < offset; });
+			auto range = freeRanges.insert(next, { offset, size });
+			if ((range + 1) != freeRanges.end() && range->offset + range->size == (range + 1)->offset)
+			{
+				range->size += (range + 1)->size;
+				freeRanges.erase(range + 1);
+			}
+			if (range != freeRanges.begin() && (range - 1)->offset + (range - 1)->size == range->offset)
+			{
+				(range - 1)->size += range->size;
+				freeRanges.erase(range);
+			}
+		}
+
+		uint32_t getCapacity() const
+		{
+			return capacity;
+		}
+
+		uint32_t getAllocatedSize() const
+		{
+			return allocatedSize;
+		}
+	};
+}
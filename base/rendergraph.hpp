@@ -0,0 +1,513 @@
+/*
+* Frame graph for scheduling passes
+*
+* Passes declare the resources they read and write, in the order they are executed in a frame
+* From these declarations the graph
+* - culls passes that don't contribute to an output (or have no side effects)
+* - derives the external subpass dependencies of render passes, only for accesses that form a hazard
+* - packs the memory of transient attachments whose lifetimes don't overlap into one shared range
+* - merges all passes on a queue into as few submissions as possible
+* - optionally surrounds the passes' command buffers with breadcrumb markers for diagnosing device losses
+*
+* Resources read in the frame after the one writing them (e.g. history buffers) are outputs of the graph
+* Accesses wrap around frames, so a pass also depends on accesses of later passes from the previous frame
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <initializer_list>
+#include <string>
+#include <algorithm>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "vulkantools.h"
+#include "vulkanbreadcrumbs.hpp"
+
+namespace vkTools
+{
+	class RenderGraph
+	{
+	public:
+		typedef uint32_t Resource;
+		typedef uint32_t Pass;
+
+		static const Resource NO_RESOURCE = UINT32_MAX;
+
+	private:
+		struct Access
+		{
+			Resource resource;
+			VkPipelineStageFlags stageMask;
+			VkAccessFlags accessMask;
+			bool write;
+		};
+
+		struct ResourceInfo
+		{
+			std::string name;
+			// Contents don't need to survive the frame, memory may be shared with other transient resources
+			bool transient;
+			// Read outside of the graph (presented, read back or used by the next frame)
+			bool output = false;
+			VkMemoryRequirements memoryRequirements = {};
+			bool hasMemoryRequirements = false;
+			// Offset into the shared transient memory, valid after planTransientMemory
+			VkDeviceSize memoryOffset = 0;
+		};
+
+		struct PassInfo
+		{
+			std::string name;
+			VkQueue queue;
+			// Always executed, even if nothing reads its results
+			bool sideEffect;
+			std::vector<Access> accesses;
+			// Per frame state, reset by beginFrame
+			bool enabled = true;
+			bool live = false;
+			std::vector<VkCommandBuffer> commandBuffers;
+			std::vector<VkSemaphore> waitSemaphores;
+			std::vector<VkPipelineStageFlags> waitStages;
+		};
+
+		std::vector<ResourceInfo> resources;
+		std::vector<PassInfo> passes;
+
+		bool transientMemoryPlanned = false;
+		VkMemoryRequirements transientMemoryRequirements = {};
+
+		VulkanBreadcrumbs *breadcrumbs = nullptr;
+		VkQueue breadcrumbQueue = VK_NULL_HANDLE;
+
+		// Scratch storage of compile and submit, kept across frames so submitting doesn't allocate once it has grown to fit
+		struct Batch
+		{
+			VkQueue queue;
+			std::vector<VkCommandBuffer> commandBuffers;
+			std::vector<VkSemaphore> waitSemaphores;
+			std::vector<VkPipelineStageFlags> waitStages;
+		};
+		std::vector<Batch> batches;
+		std::vector<VkSubmitInfo> submitInfos;
+		std::vector<bool> neededResources;
+
+		// True if both resources are the same or are transient resources sharing memory
+		bool overlaps(Resource a, Resource b)
+		{
+			if (a == b)
+			{
+				return true;
+			}
+			const ResourceInfo &ra = resources[a];
+			const ResourceInfo &rb = resources[b];
+			if (!transientMemoryPlanned || !ra.transient || !rb.transient || !ra.hasMemoryRequirements || !rb.hasMemoryRequirements)
+			{
+				return false;
+			}
+			return (ra.memoryOffset < rb.memoryOffset + rb.memoryRequirements.size) && (rb.memoryOffset < ra.memoryOffset + ra.memoryRequirements.size);
+		}
+
+		// First and last pass (in declaration order) accessing a resource
+		void getLifetime(Resource resource, uint32_t &first, uint32_t &last)
+		{
+			first = UINT32_MAX;
+			last = 0;
+			for (uint32_t i = 0; i < passes.size(); i++)
+			{
+				for (auto& access : passes[i].accesses)
+				{
+					if (access.resource == resource)
+					{
+						first = std::min(first, i);
+						last = std::max(last, i);
+					}
+				}
+			}
+		}
+
+	public:
+		/**
+		* Add a resource
+		*
+		* @param name Name of the resource, only used for debugging
+		* @param (Optional) transient Contents are only used within one frame, so its memory may be aliased (defaults to false)
+		*/
+		Resource addResource(const std::string &name, bool transient = false)
+		{
+			ResourceInfo resource;
+			resource.name = name;
+			resource.transient = transient;
+			resources.push_back(resource);
+			return static_cast<Resource>(resources.size() - 1);
+		}
+
+		/** @brief Mark a resource as being used outside of the graph, its writers are never culled */
+		void setOutput(Resource resource)
+		{
+			resources[resource].output = true;
+			assert(!resources[resource].transient);
+		}
+
+		/**
+		* Add a pass, passes are executed in the order they are added
+		*
+		* @param name Name of the pass, only used for debugging
+		* @param queue Queue the pass' command buffers are submitted to
+		* @param (Optional) sideEffect Never cull the pass (defaults to false)
+		*/
+		Pass addPass(const std::string &name, VkQueue queue, bool sideEffect = false)
+		{
+			PassInfo pass;
+			pass.name = name;
+			pass.queue = queue;
+			pass.sideEffect = sideEffect;
+			passes.push_back(pass);
+			return static_cast<Pass>(passes.size() - 1);
+		}
+
+		/** @brief Declare that a pass reads a resource in the given stages */
+		void read(Pass pass, Resource resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask)
+		{
+			passes[pass].accesses.push_back({ resource, stageMask, accessMask, false });
+		}
+
+		/** @brief Declare that a pass writes a resource in the given stages */
+		void write(Pass pass, Resource resource, VkPipelineStageFlags stageMask, VkAccessFlags accessMask)
+		{
+			passes[pass].accesses.push_back({ resource, stageMask, accessMask, true });
+		}
+
+		/**
+		* Get the external dependencies for a render pass implementing a pass of the graph
+		* Dependencies are only added for accesses of other passes that form a hazard with this pass (not for read after read)
+		*
+		* @param pass Pass of the graph
+		* @param (Optional) lastSubpass Index of the render pass' last subpass (defaults to 0)
+		*
+		* @return Zero to two dependencies, one from external to the first subpass and one from the last subpass to external
+		*
+		* @note The pass' own accesses must only use graphics stages, as they become the subpass side of the dependencies
+		*/
+		std::vector<VkSubpassDependency> getExternalDependencies(Pass pass, uint32_t lastSubpass = 0)
+		{
+			VkSubpassDependency begin = {};
+			begin.srcSubpass = VK_SUBPASS_EXTERNAL;
+			begin.dstSubpass = 0;
+			VkSubpassDependency end = {};
+			end.srcSubpass = lastSubpass;
+			end.dstSubpass = VK_SUBPASS_EXTERNAL;
+
+			for (auto& access : passes[pass].accesses)
+			{
+				for (uint32_t i = 0; i < passes.size(); i++)
+				{
+					if (i == pass)
+					{
+						continue;
+					}
+					for (auto& other : passes[i].accesses)
+					{
+						if ((!access.write && !other.write) || !overlaps(access.resource, other.resource))
+						{
+							continue;
+						}
+						// The other access may have happened before this pass (earlier in the frame or in the previous frame)
+						begin.srcStageMask |= other.stageMask;
+						begin.srcAccessMask |= other.write ? other.accessMask : 0;
+						begin.dstStageMask |= access.stageMask;
+						begin.dstAccessMask |= other.write ? access.accessMask : 0;
+						// ...or happens after it
+						end.srcStageMask |= access.stageMask;
+						end.srcAccessMask |= access.write ? access.accessMask : 0;
+						end.dstStageMask |= other.stageMask;
+						end.dstAccessMask |= access.write ? other.accessMask : 0;
+					}
+				}
+			}
+
+			std::vector<VkSubpassDependency> dependencies;
+			if (begin.srcStageMask != 0)
+			{
+				dependencies.push_back(begin);
+			}
+			if (end.srcStageMask != 0)
+			{
+				dependencies.push_back(end);
+			}
+			return dependencies;
+		}
+
+		/** @brief Set the memory requirements of a transient resource before planning the shared memory */
+		void setMemoryRequirements(Resource resource, const VkMemoryRequirements &memoryRequirements)
+		{
+			assert(resources[resource].transient);
+			resources[resource].memoryRequirements = memoryRequirements;
+			resources[resource].hasMemoryRequirements = true;
+		}
+
+		/**
+		* Assign memory offsets to all transient resources with memory requirements
+		* Resources whose lifetimes (first to last pass accessing them) don't overlap share memory
+		*
+		* @note Must be called after all passes have been added, memory is planned for all passes being executed
+		*/
+		void planTransientMemory()
+		{
+			std::vector<Resource> transientResources;
+			for (Resource i = 0; i < resources.size(); i++)
+			{
+				if (resources[i].transient && resources[i].hasMemoryRequirements)
+				{
+					transientResources.push_back(i);
+				}
+			}
+			// Largest resources are placed first
+			std::sort(transientResources.begin(), transientResources.end(), [this](Resource a, Resource b) {
+				return resources[a].memoryRequirements.size > resources[b].memoryRequirements.size;
+			});
+
+			transientMemoryRequirements = {};
+			transientMemoryRequirements.alignment = 1;
+			transientMemoryRequirements.memoryTypeBits = ~0u;
+			std::vector<Resource> placed;
+			for (auto resource : transientResources)
+			{
+				ResourceInfo &info = resources[resource];
+				uint32_t first, last;
+				getLifetime(resource, first, last);
+				// Ranges of already placed resources that are alive at the same time, sorted by offset
+				std::vector<std::pair<VkDeviceSize, VkDeviceSize>> occupied;
+				for (auto other : placed)
+				{
+					uint32_t otherFirst, otherLast;
+					getLifetime(other, otherFirst, otherLast);
+					if ((first <= otherLast) && (otherFirst <= last))
+					{
+						occupied.push_back({ resources[other].memoryOffset, resources[other].memoryOffset + resources[other].memoryRequirements.size });
+					}
+				}
+				std::sort(occupied.begin(), occupied.end());
+				// Lowest aligned offset that fits in between the occupied ranges
+				const VkDeviceSize alignment = info.memoryRequirements.alignment;
+				VkDeviceSize offset = 0;
+				for (auto& range : occupied)
+				{
+					if (offset + info.memoryRequirements.size <= range.first)
+					{
+						break;
+					}
+					offset = std::max(offset, (range.second + alignment - 1) / alignment * alignment);
+				}
+				info.memoryOffset = offset;
+				placed.push_back(resource);
+
+				transientMemoryRequirements.size = std::max(transientMemoryRequirements.size, offset + info.memoryRequirements.size);
+				transientMemoryRequirements.alignment = std::max(transientMemoryRequirements.alignment, alignment);
+				transientMemoryRequirements.memoryTypeBits &= info.memoryRequirements.memoryTypeBits;
+			}
+			transientMemoryPlanned = true;
+		}
+
+		/** @brief Size, alignment and memory types of the memory shared by all transient resources */
+		VkMemoryRequirements getTransientMemoryRequirements()
+		{
+			assert(transientMemoryPlanned);
+			return transientMemoryRequirements;
+		}
+
+		/** @brief Offset of a transient resource into the shared memory */
+		VkDeviceSize getMemoryOffset(Resource resource)
+		{
+			assert(transientMemoryPlanned && resources[resource].transient);
+			return resources[resource].memoryOffset;
+		}
+
+		uint32_t getPassCount()
+		{
+			return static_cast<uint32_t>(passes.size());
+		}
+
+		const std::string& getPassName(Pass pass)
+		{
+			return passes[pass].name;
+		}
+
+		/**
+		* Surround the command buffers of passes on a queue with breadcrumb markers, the breadcrumbs' passes are the graph's passes
+		* The breadcrumbs' current frame must be set before the graph is submitted
+		*
+		* @param breadcrumbs Breadcrumbs created with the names of the graph's passes, null to stop writing markers
+		* @param queue Queue of the breadcrumbs' queue family, passes on other queues get no markers
+		*/
+		void setBreadcrumbs(VulkanBreadcrumbs *breadcrumbs, VkQueue queue)
+		{
+			assert(!breadcrumbs || (breadcrumbs->getPassCount() == passes.size()));
+			this->breadcrumbs = breadcrumbs;
+			breadcrumbQueue = queue;
+		}
+
+		/** @brief Reset the per frame state, all passes are enabled and have no command buffers */
+		void beginFrame()
+		{
+			for (auto& pass : passes)
+			{
+				pass.enabled = true;
+				pass.live = false;
+				pass.commandBuffers.clear();
+				pass.waitSemaphores.clear();
+				pass.waitStages.clear();
+			}
+		}
+
+		/** @brief Disabled passes are skipped for this frame, passes only reading their results are culled with them */
+		void setEnabled(Pass pass, bool enabled)
+		{
+			passes[pass].enabled = enabled;
+		}
+
+		/** @brief Command buffers submitted for the pass this frame, passes recorded into another pass' command buffers have none */
+		template <typename Container>
+		void setCommandBuffers(Pass pass, const Container &commandBuffers)
+		{
+			passes[pass].commandBuffers.assign(commandBuffers.begin(), commandBuffers.end());
+		}
+
+		void setCommandBuffers(Pass pass, std::initializer_list<VkCommandBuffer> commandBuffers)
+		{
+			passes[pass].commandBuffers.assign(commandBuffers.begin(), commandBuffers.end());
+		}
+
+		/** @brief Wait for a semaphore before the pass' command buffers are executed */
+		void addWaitSemaphore(Pass pass, VkSemaphore semaphore, VkPipelineStageFlags stageMask)
+		{
+			passes[pass].waitSemaphores.push_back(semaphore);
+			passes[pass].waitStages.push_back(stageMask);
+		}
+
+		/**
+		* Determine the passes executed this frame
+		* Walks the passes back to front, a pass is live if it's enabled and has side effects, writes an output
+		* or writes a resource read by a later live pass
+		*/
+		void compile()
+		{
+			std::vector<bool> &needed = neededResources;
+			needed.assign(resources.size(), false);
+			for (Resource i = 0; i < resources.size(); i++)
+			{
+				needed[i] = resources[i].output;
+			}
+			for (size_t i = passes.size(); i-- > 0;)
+			{
+				PassInfo &pass = passes[i];
+				pass.live = false;
+				if (!pass.enabled)
+				{
+					continue;
+				}
+				pass.live = pass.sideEffect;
+				for (auto& access : pass.accesses)
+				{
+					pass.live = pass.live || (access.write && needed[access.resource]);
+				}
+				if (pass.live)
+				{
+					for (auto& access : pass.accesses)
+					{
+						if (!access.write)
+						{
+							needed[access.resource] = true;
+						}
+					}
+				}
+			}
+		}
+
+		/** @brief True if the pass is executed this frame, valid after compile */
+		bool isLive(Pass pass)
+		{
+			return passes[pass].live;
+		}
+
+		/**
+		* Submit the command buffers of all live passes
+		* Consecutive passes on the same queue are merged into one submission, a new one is only started by a pass waiting for semaphores
+		* All submissions to a queue are done with a single vkQueueSubmit
+		*
+		* @param signalSemaphores Semaphores signaled by the last submission
+		* @param (Optional) fence Fence signaled by the last submission (defaults to none)
+		*
+		* @note Dependencies between passes on different queues must be synchronized with semaphores by the caller
+		*/
+		template <typename Container>
+		void submit(const Container &signalSemaphores, VkFence fence = VK_NULL_HANDLE)
+		{
+			// Batches are only cleared, so their vectors keep their capacity
+			size_t batchCount = 0;
+			for (Pass p = 0; p < passes.size(); p++)
+			{
+				PassInfo &pass = passes[p];
+				if (!pass.live || pass.commandBuffers.empty())
+				{
+					continue;
+				}
+				if ((batchCount == 0) || (batches[batchCount - 1].queue != pass.queue) || !pass.waitSemaphores.empty())
+				{
+					if (batchCount == batches.size())
+					{
+						batches.push_back(Batch());
+					}
+					Batch &batch = batches[batchCount++];
+					batch.queue = pass.queue;
+					batch.commandBuffers.clear();
+					batch.waitSemaphores.clear();
+					batch.waitStages.clear();
+				}
+				Batch &batch = batches[batchCount - 1];
+				const bool markers = breadcrumbs && (pass.queue == breadcrumbQueue);
+				if (markers)
+				{
+					batch.commandBuffers.push_back(breadcrumbs->getMarkerCmdBuffer(p, VulkanBreadcrumbs::MARKER_BEGIN));
+				}
+				batch.commandBuffers.insert(batch.commandBuffers.end(), pass.commandBuffers.begin(), pass.commandBuffers.end());
+				if (markers)
+				{
+					batch.commandBuffers.push_back(breadcrumbs->getMarkerCmdBuffer(p, VulkanBreadcrumbs::MARKER_END));
+				}
+				batch.waitSemaphores.insert(batch.waitSemaphores.end(), pass.waitSemaphores.begin(), pass.waitSemaphores.end());
+				batch.waitStages.insert(batch.waitStages.end(), pass.waitStages.begin(), pass.waitStages.end());
+			}
+			assert(batchCount > 0);
+
+			submitInfos.clear();
+			for (size_t i = 0; i < batchCount; i++)
+			{
+				VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
+				submitInfo.waitSemaphoreCount = static_cast<uint32_t>(batches[i].waitSemaphores.size());
+				submitInfo.pWaitSemaphores = batches[i].waitSemaphores.data();
+				submitInfo.pWaitDstStageMask = batches[i].waitStages.data();
+				submitInfo.commandBufferCount = static_cast<uint32_t>(batches[i].commandBuffers.size());
+				submitInfo.pCommandBuffers = batches[i].commandBuffers.data();
+				if (i == batchCount - 1)
+				{
+					submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+					submitInfo.pSignalSemaphores = signalSemaphores.data();
+				}
+				submitInfos.push_back(submitInfo);
+				// Flush when the queue changes or all batches have been added
+				if ((i == batchCount - 1) || (batches[i + 1].queue != batches[i].queue))
+				{
+					const bool last = (i == batchCount - 1);
+					VK_CHECK_RESULT(vkQueueSubmit(batches[i].queue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), last ? fence : VK_NULL_HANDLE));
+					submitInfos.clear();
+				}
+			}
+		}
+	};
+}
@@ -0,0 +1,130 @@
+/*
+* Render queue with packed 64 bit draw sort keys
+*
+* Keys are ordered by pass, pipeline, material and quantized depth (most to least significant)
+* Items are sorted with a stable LSD radix sort over the key's bytes, bytes that are equal for all items are skipped
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+
+namespace vkTools
+{
+	class RenderQueue
+	{
+	public:
+		/** @brief Bits of the key fields, from the least significant one */
+		static const uint32_t DEPTH_BITS = 24;
+		static const uint32_t MATERIAL_BITS = 16;
+		static const uint32_t PIPELINE_BITS = 8;
+		static const uint32_t PASS_BITS = 8;
+
+		struct Item
+		{
+			uint64_t key;
+			// Caller defined, e.g. an index into a list of draws
+			uint32_t value;
+		};
+
+	private:
+		std::vector<Item> items;
+		std::vector<Item> scratch;
+
+	public:
+		/**
+		* Pack a sort key
+		*
+		* @param pass Pass or layer the draw belongs to, e.g. opaque before alpha tested
+		* @param pipeline Index of the draw's pipeline
+		* @param material Index of the draw's material (descriptor set)
+		* @param depth Normalized distance to the camera in [0, 1], clamped, quantized to DEPTH_BITS
+		* @param backToFront Invert the depth, so far draws come first
+		*/
+		static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, bool backToFront = false)
+		{
+			assert(pass < (1u << PASS_BITS));
+			assert(pipeline < (1u << PIPELINE_BITS));
+			assert(material < (1u << MATERIAL_BITS));
+			const uint32_t depthMax = (1u << DEPTH_BITS) - 1;
+			depth = std::min(std::max(depth, 0.0f), 1.0f);
+			uint64_t quantizedDepth = static_cast<uint64_t>(depth * depthMax);
+			if (backToFront)
+			{
+				quantizedDepth = depthMax - quantizedDepth;
+			}
+			return
+				(static_cast<uint64_t>(pass) << (DEPTH_BITS + MATERIAL_BITS + PIPELINE_BITS)) |
+				(static_cast<uint64_t>(pipeline) << (DEPTH_BITS + MATERIAL_BITS)) |
+				(static_cast<uint64_t>(material) << DEPTH_BITS) |
+				quantizedDepth;
+		}
+
+		void clear()
+		{
+			items.clear();
+		}
+
+		void reserve(size_t count)
+		{
+			items.reserve(count);
+			scratch.reserve(count);
+		}
+
+		void add(uint64_t key, uint32_t value)
+		{
+			items.push_back({ key, value });
+		}
+
+		/** @brief Sort the items by their keys, items with equal keys keep the order they have been added in */
+		void sort()
+		{
+			if (items.size() < 2)
+			{
+				return;
+			}
+			scratch.resize(items.size());
+			// Bits that differ between any two keys
+			uint64_t varyingBits = 0;
+			for (auto &item : items)
+			{
+				varyingBits |= item.key ^ items[0].key;
+			}
+			for (uint32_t shift = 0; shift < 64; shift += 8)
+			{
+				if (((varyingBits >> shift) & 0xFF) == 0)
+				{
+					continue;
+				}
+				size_t offsets[256] = {};
+				for (auto &item : items)
+				{
+					offsets[(item.key >> shift) & 0xFF]++;
+				}
+				size_t sum = 0;
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					const size_t count = offsets[i];
+					offsets[i] = sum;
+					sum += count;
+				}
+				for (auto &item : items)
+				{
+					scratch[offsets[(item.key >> shift) & 0xFF]++] = item;
+				}
+				items.swap(scratch);
+			}
+		}
+
+		const std::vector<Item>& getItems() const
+		{
+			return items;
+		}
+	};
+}
\ No newline at end of file
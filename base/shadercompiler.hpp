@@ -0,0 +1,446 @@
+/*
+* Compiles GLSL shader permutations to SPIR-V with an external glslangValidator
+*
+* Compiled permutations are kept in a disk cache keyed on the source (including its includes), the defines and the compiler version
+* Only thread safe functions are used for compiling, so permutations can be compiled in parallel on a job system
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
+#include "jobsystem.hpp"
+
+namespace vkTools
+{
+	class ShaderCompiler
+	{
+	public:
+		// A single GLSL source compiled with a set of defines, e.g. one line of generate-spirv.bat
+		struct Permutation
+		{
+			std::string source;
+			// Stage given with -S, e.g. to compile a fragment shader's source as a compute shader, otherwise selected by the source's extension
+			std::string stage;
+			std::vector<std::string> defines;
+			std::string output;
+		};
+
+		enum Result
+		{
+			FAILED,
+			// The output already contained the compiled SPIR-V
+			UNCHANGED,
+			WRITTEN
+		};
+
+		/** @brief Maximum nesting depth of #include directives */
+		static const uint32_t MAX_INCLUDE_DEPTH = 16;
+
+	private:
+		std::string compilerPath;
+		std::string cacheDirectory;
+		// Output of "glslangValidator --version", empty if the compiler couldn't be run
+		std::string compilerVersion;
+
+		// 64 bit FNV-1a
+		static uint64_t hashData(const void *data, size_t size, uint64_t hash = 14695981039346656037ULL)
+		{
+			const uint8_t *bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+		static bool readFile(const std::string &fileName, std::string &data)
+		{
+			std::ifstream file(fileName, std::ios::binary);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			std::stringstream stream;
+			stream << file.rdbuf();
+			data = stream.str();
+			return true;
+		}
+
+		// Written to a temporary file first so readers never see a partially written file
+		static bool writeFile(const std::string &fileName, const std::string &data)
+		{
+			const std::string tempFileName = fileName + ".tmp";
+			{
+				std::ofstream file(tempFileName, std::ios::binary | std::ios::trunc);
+				if (!file.is_open())
+				{
+					return false;
+				}
+				file.write(data.data(), data.size());
+				if (!file.good())
+				{
+					return false;
+				}
+			}
+			return replaceFile(tempFileName, fileName);
+		}
+
+		static bool replaceFile(const std::string &from, const std::string &to)
+		{
+#if defined(_WIN32)
+			// rename doesn't overwrite existing files on Windows
+			remove(to.c_str());
+#endif
+			if (rename(from.c_str(), to.c_str()) != 0)
+			{
+				remove(from.c_str());
+				return false;
+			}
+			return true;
+		}
+
+		static std::string getDirectory(const std::string &fileName)
+		{
+			const size_t separator = fileName.find_last_of("/\\");
+			return (separator == std::string::npos) ? "" : fileName.substr(0, separator + 1);
+		}
+
+		static bool isSpirv(const std::string &data)
+		{
+			return (data.size() >= sizeof(uint32_t)) && (data.size() % sizeof(uint32_t) == 0) && (*reinterpret_cast<const uint32_t*>(data.data()) == 0x07230203);
+		}
+
+		static std::string quote(const std::string &argument)
+		{
+			return "\"" + argument + "\"";
+		}
+
+		// Run a command and capture its output (stdout and stderr), returns false if it couldn't be run or failed
+		static bool runCommand(std::string command, std::string &output)
+		{
+			output.clear();
+			command += " 2>&1";
+#if defined(_WIN32)
+			// cmd strips the outer quotes of a command line that starts with a quote
+			FILE *pipe = _popen(quote(command).c_str(), "r");
+#else
+			FILE *pipe = popen(command.c_str(), "r");
+#endif
+			if (!pipe)
+			{
+				return false;
+			}
+			char buffer[256];
+			size_t size;
+			while ((size = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+			{
+				output.append(buffer, size);
+			}
+#if defined(_WIN32)
+			return _pclose(pipe) == 0;
+#else
+			return pclose(pipe) == 0;
+#endif
+		}
+
+		// Append the source and the sources of its quoted includes (in order of appearance) to the key data
+		// Included files are hashed but not resolved, the compiler takes care of those
+		static bool collectSources(const std::string &fileName, std::string &data, std::vector<std::string> *files, uint32_t depth)
+		{
+			std::string source;
+			if ((depth > MAX_INCLUDE_DEPTH) || !readFile(fileName, source))
+			{
+				return false;
+			}
+			if (files)
+			{
+				files->push_back(fileName);
+			}
+			data += source;
+			data.push_back('\0');
+
+			std::istringstream lines(source);
+			std::string line;
+			while (std::getline(lines, line))
+			{
+				const size_t directive = line.find_first_not_of(" \t");
+				if ((directive == std::string::npos) || (line.compare(directive, 8, "#include") != 0))
+				{
+					continue;
+				}
+				const size_t first = line.find('"', directive + 8);
+				const size_t last = (first != std::string::npos) ? line.find('"', first + 1) : std::string::npos;
+				if (last == std::string::npos)
+				{
+					continue;
+				}
+				if (!collectSources(getDirectory(fileName) + line.substr(first + 1, last - first - 1), data, files, depth + 1))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Returns 0 if the source or one of its includes can't be read
+		uint64_t getKey(const Permutation &permutation, std::vector<std::string> *files) const
+		{
+			// The file extension selects the shader stage unless it's given explicitly
+			std::string data = compilerVersion;
+			data.push_back('\0');
+			data += permutation.stage.empty() ? permutation.source.substr(permutation.source.find_last_of('.') + 1) : permutation.stage;
+			data.push_back('\0');
+			for (auto& define : permutation.defines)
+			{
+				data += define;
+				data.push_back('\0');
+			}
+			if (!collectSources(permutation.source, data, files, 0))
+			{
+				return 0;
+			}
+			return hashData(data.data(), data.size());
+		}
+
+	public:
+		/**
+		* Default path of glslangValidator, the Vulkan SDK's binary if VULKAN_SDK is set, otherwise it's searched in the path
+		*/
+		static std::string findCompiler()
+		{
+			const char *sdkPath = getenv("VULKAN_SDK");
+#if defined(_WIN32)
+			return sdkPath ? std::string(sdkPath) + "\\Bin\\glslangValidator.exe" : "glslangValidator.exe";
+#else
+			return sdkPath ? std::string(sdkPath) + "/bin/glslangValidator" : "glslangValidator";
+#endif
+		}
+
+		/**
+		* Parse the glslangValidator lines of a batch file like generate-spirv.bat into permutations
+		* Sources and outputs are relative to the batch file's directory
+		*
+		* @return False if the file can't be read
+		*/
+		static bool readPermutations(const std::string &fileName, std::vector<Permutation> &permutations)
+		{
+			std::string data;
+			if (!readFile(fileName, data))
+			{
+				return false;
+			}
+			const std::string directory = getDirectory(fileName);
+			std::istringstream lines(data);
+			std::string line;
+			while (std::getline(lines, line))
+			{
+				std::istringstream tokens(line);
+				std::string token;
+				if (!(tokens >> token))
+				{
+					continue;
+				}
+				std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+				if (token != "glslangvalidator")
+				{
+					continue;
+				}
+				Permutation permutation;
+				while (tokens >> token)
+				{
+					if (token.compare(0, 2, "-D") == 0)
+					{
+						permutation.defines.push_back(token.substr(2));
+					}
+					else if (token == "-o")
+					{
+						if (tokens >> token)
+						{
+							permutation.output = directory + token;
+						}
+					}
+					else if (token == "-S")
+					{
+						tokens >> permutation.stage;
+					}
+					else if (token[0] != '-')
+					{
+						permutation.source = directory + token;
+					}
+				}
+				if (!permutation.source.empty() && !permutation.output.empty())
+				{
+					permutations.push_back(permutation);
+				}
+			}
+			return true;
+		}
+
+		/**
+		* @param compilerPath Path of the glslangValidator executable
+		* @param cacheDirectory Directory the compiled permutations are stored in, created if it doesn't exist
+		*/
+		ShaderCompiler(const std::string &compilerPath, const std::string &cacheDirectory) : compilerPath(compilerPath), cacheDirectory(cacheDirectory)
+		{
+			if (!this->cacheDirectory.empty() && (this->cacheDirectory.back() != '/') && (this->cacheDirectory.back() != '\\'))
+			{
+				this->cacheDirectory += "/";
+			}
+#if defined(_WIN32)
+			_mkdir(this->cacheDirectory.c_str());
+#else
+			mkdir(this->cacheDirectory.c_str(), 0755);
+#endif
+			std::string version;
+			if (runCommand(quote(compilerPath) + " --version", version))
+			{
+				compilerVersion = version;
+			}
+		}
+
+		/** @brief False if the compiler couldn't be run, compiling always fails in that case */
+		bool isAvailable() const
+		{
+			return !compilerVersion.empty();
+		}
+
+		/** @brief Source files (including includes) the permutation is compiled from */
+		void getSourceFiles(const Permutation &permutation, std::vector<std::string> &files) const
+		{
+			getKey(permutation, &files);
+		}
+
+		/**
+		* Compile a single permutation, or take it from the cache, and write it to its output if the output's contents differ
+		* Thread safe as long as no two threads compile the same permutation
+		*
+		* @param cached Set if the permutation was taken from the cache
+		*/
+		Result compile(const Permutation &permutation, bool &cached) const
+		{
+			cached = false;
+			if (!isAvailable())
+			{
+				return FAILED;
+			}
+			const uint64_t key = getKey(permutation, nullptr);
+			if (key == 0)
+			{
+				std::cout << "Could not read shader source \"" << permutation.source << "\"" << std::endl;
+				return FAILED;
+			}
+
+			std::stringstream keyName;
+			keyName << std::hex << key;
+			const std::string cacheFile = cacheDirectory + keyName.str() + ".spv";
+			std::string code;
+			cached = readFile(cacheFile, code) && isSpirv(code);
+			if (!cached)
+			{
+				std::string command = quote(compilerPath) + " -V";
+				if (!permutation.stage.empty())
+				{
+					command += " -S " + permutation.stage;
+				}
+				for (auto& define : permutation.defines)
+				{
+					command += " " + quote("-D" + define);
+				}
+				const std::string tempFile = cacheFile + ".tmp";
+				command += " -o " + quote(tempFile) + " " + quote(permutation.source);
+				std::string log;
+				const bool compiled = runCommand(command, log);
+				if (!compiled || !readFile(tempFile, code) || !isSpirv(code))
+				{
+					remove(tempFile.c_str());
+					std::cout << "Could not compile shader \"" << permutation.output << "\"" << std::endl << log;
+					return FAILED;
+				}
+				// Failing to cache the permutation still leaves it usable
+				replaceFile(tempFile, cacheFile);
+			}
+
+			std::string output;
+			if (readFile(permutation.output, output) && (output == code))
+			{
+				return UNCHANGED;
+			}
+			if (!writeFile(permutation.output, code))
+			{
+				std::cout << "Could not write shader \"" << permutation.output << "\"" << std::endl;
+				return FAILED;
+			}
+			return WRITTEN;
+		}
+
+		/**
+		* Compile permutations in parallel on a job system's threads
+		*
+		* @param written Receives the outputs that have been written
+		*
+		* @return Number of permutations that failed to compile
+		*/
+		uint32_t compile(const std::vector<Permutation> &permutations, JobSystem *jobSystem, std::vector<std::string> &written, uint32_t *cachedCount = nullptr) const
+		{
+			std::vector<Result> results(permutations.size());
+			std::atomic<uint32_t> cached(0);
+			auto compileRange = [&](uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++)
+				{
+					bool fromCache;
+					results[i] = compile(permutations[i], fromCache);
+					if (fromCache)
+					{
+						cached++;
+					}
+				}
+			};
+			if (jobSystem)
+			{
+				// The jobs mostly wait for the compiler processes, so each permutation gets its own job
+				jobSystem->parallelFor(static_cast<uint32_t>(permutations.size()), 1, compileRange);
+			}
+			else
+			{
+				compileRange(0, static_cast<uint32_t>(permutations.size()));
+			}
+
+			written.clear();
+			uint32_t failed = 0;
+			for (size_t i = 0; i < permutations.size(); i++)
+			{
+				if (results[i] == WRITTEN)
+				{
+					written.push_back(permutations[i].output);
+				}
+				failed += (results[i] == FAILED) ? 1 : 0;
+			}
+			if (cachedCount)
+			{
+				*cachedCount = cached;
+			}
+			return failed;
+		}
+	};
+}
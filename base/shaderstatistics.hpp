@@ -0,0 +1,232 @@
+/*
+* Static statistics of SPIR-V shaders
+*
+* Counts the instructions of a module's functions and estimates its register pressure from the lifetimes of their results,
+* so changes to a shader's cost show up without driver support for querying the compiled shader's registers and occupancy
+* The estimate is taken before the driver's optimizations and only compares versions of the same shader, it's no register count
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <unordered_map>
+#include <algorithm>
+#include <stdint.h>
+
+namespace vkTools
+{
+	struct ShaderStatistics
+	{
+		// Instructions in the bodies of all functions
+		uint32_t instructions = 0;
+		uint32_t functions = 0;
+		// Reads, writes and samples of images
+		uint32_t imageInstructions = 0;
+		// Conditional branches and switches
+		uint32_t branches = 0;
+		uint32_t loops = 0;
+		uint32_t barriers = 0;
+		// Function scope variables, their 32 bit components are live for the whole function
+		uint32_t localVariables = 0;
+		// Largest number of 32 bit components held by function scope variables and live results at any instruction of a function
+		uint32_t estimatedRegisters = 0;
+
+		/** @brief Analyze a SPIR-V module, returns false if code isn't one */
+		bool analyze(const std::vector<uint32_t> &code)
+		{
+			*this = ShaderStatistics();
+			// Magic number and header
+			if ((code.size() < 5) || (code[0] != 0x07230203))
+			{
+				return false;
+			}
+
+			// 32 bit components of the values of each type, results of other types (void, pointers, images, samplers) take none
+			std::unordered_map<uint32_t, uint32_t> typeComponents;
+			// Function scope pointers and the components they point to
+			std::unordered_map<uint32_t, uint32_t> localPointers;
+
+			// Results of the current function by their id
+			std::unordered_map<uint32_t, Result> results;
+			// Instructions of the current function so far
+			size_t bodySize = 0;
+			uint32_t variableComponents = 0;
+
+			size_t offset = 5;
+			while (offset < code.size())
+			{
+				const uint32_t opCode = code[offset] & 0xFFFF;
+				const uint32_t wordCount = code[offset] >> 16;
+				if ((wordCount == 0) || (offset + wordCount > code.size()))
+				{
+					return false;
+				}
+				const uint32_t *operands = &code[offset + 1];
+
+				switch (opCode)
+				{
+				case 20: // OpTypeBool
+					typeComponents[operands[0]] = 1;
+					break;
+				case 21: // OpTypeInt
+				case 22: // OpTypeFloat
+					typeComponents[operands[0]] = (operands[1] > 32) ? 2 : 1;
+					break;
+				case 23: // OpTypeVector
+				case 24: // OpTypeMatrix
+				case 28: // OpTypeArray, the length is the id of a constant and arrays are usually kept in memory, counted as one element
+					typeComponents[operands[0]] = typeComponents[operands[1]] * ((opCode == 28) ? 1 : operands[2]);
+					break;
+				case 30: // OpTypeStruct
+				{
+					uint32_t components = 0;
+					for (uint32_t i = 1; i < wordCount - 1; i++)
+					{
+						components += typeComponents[operands[i]];
+					}
+					typeComponents[operands[0]] = components;
+					break;
+				}
+				case 32: // OpTypePointer
+					// Storage class Function
+					if (operands[1] == 7)
+					{
+						localPointers[operands[0]] = typeComponents[operands[2]];
+					}
+					break;
+				case 54: // OpFunction
+					functions++;
+					results.clear();
+					bodySize = 0;
+					variableComponents = 0;
+					break;
+				case 56: // OpFunctionEnd
+					estimatedRegisters = std::max(estimatedRegisters, variableComponents + getPeakLiveComponents(results, bodySize));
+					break;
+				default:
+					if (functions == 0)
+					{
+						break;
+					}
+					analyzeInstruction(opCode, operands, wordCount - 1, bodySize, typeComponents, localPointers, results, variableComponents);
+					bodySize++;
+					break;
+				}
+				offset += wordCount;
+			}
+			return true;
+		}
+
+		/** @brief Read and analyze a SPIR-V file, returns false if it can't be read or isn't one */
+		bool analyze(const std::string &fileName)
+		{
+			std::vector<uint32_t> code;
+			std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			const size_t size = static_cast<size_t>(file.tellg());
+			code.resize(size / sizeof(uint32_t));
+			file.seekg(0, std::ios::beg);
+			file.read(reinterpret_cast<char*>(code.data()), code.size() * sizeof(uint32_t));
+			return analyze(code);
+		}
+
+	private:
+		// Result of an instruction, with the indices of the instructions defining it and using it last
+		struct Result
+		{
+			uint32_t components;
+			size_t first;
+			size_t last;
+		};
+
+		void analyzeInstruction(uint32_t opCode, const uint32_t *operands, uint32_t operandCount, size_t index,
+			std::unordered_map<uint32_t, uint32_t> &typeComponents, std::unordered_map<uint32_t, uint32_t> &localPointers,
+			std::unordered_map<uint32_t, Result> &results, uint32_t &variableComponents)
+		{
+			// Debug information and labels aren't executed
+			if ((opCode == 8) || (opCode == 317) || (opCode == 248))
+			{
+				return;
+			}
+			instructions++;
+			if ((opCode >= 87) && (opCode <= 99))
+			{
+				imageInstructions++;
+			}
+			if ((opCode == 250) || (opCode == 251))
+			{
+				branches++;
+			}
+			if (opCode == 246)
+			{
+				loops++;
+			}
+			if ((opCode == 224) || (opCode == 225))
+			{
+				barriers++;
+			}
+
+			// Function scope variable
+			if (opCode == 59)
+			{
+				auto pointer = localPointers.find(operands[0]);
+				if (pointer != localPointers.end())
+				{
+					localVariables++;
+					variableComponents += pointer->second;
+				}
+				return;
+			}
+
+			// Instructions with a result start with its type and id, except for these (stores, branches, merges, barriers, image writes, vertex emission)
+			const bool noResult = (opCode == 62) || (opCode == 63) || (opCode == 99) || ((opCode >= 218) && (opCode <= 219)) || ((opCode >= 224) && (opCode <= 225)) ||
+				(opCode == 228) || ((opCode >= 246) && (opCode <= 255));
+			uint32_t firstOperand = 0;
+			if (!noResult && (operandCount >= 2))
+			{
+				auto type = typeComponents.find(operands[0]);
+				const uint32_t components = (type != typeComponents.end()) ? type->second : 0;
+				results[operands[1]] = { components, index, index };
+				firstOperand = 2;
+			}
+			// Literal operands aren't told apart from ids, they only extend the lifetime of a result if they happen to match its id
+			// Phi operands defined further down a loop aren't known yet and don't extend their lifetime
+			for (uint32_t i = firstOperand; i < operandCount; i++)
+			{
+				auto used = results.find(operands[i]);
+				if (used != results.end())
+				{
+					used->second.last = index;
+				}
+			}
+		}
+
+		// Components of the results live at each instruction, a result is live from its definition to its last use
+		static uint32_t getPeakLiveComponents(const std::unordered_map<uint32_t, Result> &results, size_t instructionCount)
+		{
+			std::vector<int32_t> delta(instructionCount + 1, 0);
+			for (auto& result : results)
+			{
+				delta[result.second.first] += result.second.components;
+				delta[result.second.last + 1] -= result.second.components;
+			}
+			int32_t live = 0;
+			int32_t peak = 0;
+			for (auto d : delta)
+			{
+				live += d;
+				peak = std::max(peak, live);
+			}
+			return static_cast<uint32_t>(peak);
+		}
+	};
+}
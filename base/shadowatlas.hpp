@@ -0,0 +1,196 @@
+/*
+* Shadow map atlas
+*
+* Packs square power of two tiles of varying size into one square shadow map, so the memory used by the shadows stays fixed
+* while the resolution of each light follows how much of it is seen
+* The tiles are placed in order of decreasing size along a Morton curve, which packs power of two squares without gaps
+* as long as their total area fits
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <assert.h>
+
+namespace vkTools
+{
+	class ShadowAtlas
+	{
+	public:
+		struct Tile
+		{
+			uint32_t x = 0;
+			uint32_t y = 0;
+			// Edge length in texels, 0 if the light has no tile
+			uint32_t size = 0;
+
+			bool operator==(const Tile &other) const
+			{
+				return (x == other.x) && (y == other.y) && (size == other.size);
+			}
+		};
+
+	private:
+		uint32_t dim;
+		uint32_t minTileSize;
+		uint32_t maxTileSize;
+		std::vector<Tile> tiles;
+		// Scratch storage of update, kept to not allocate every frame
+		std::vector<uint32_t> sizes;
+		std::vector<uint32_t> order;
+
+		// Extract the even bits of a Morton code
+		static uint32_t compactBits(uint32_t v)
+		{
+			v &= 0x55555555;
+			v = (v | (v >> 1)) & 0x33333333;
+			v = (v | (v >> 2)) & 0x0F0F0F0F;
+			v = (v | (v >> 4)) & 0x00FF00FF;
+			v = (v | (v >> 8)) & 0x0000FFFF;
+			return v;
+		}
+
+		// Power of two size covering the requested texels
+		// The current size is kept until the request has clearly moved away from it, so tiles don't flip between two sizes
+		uint32_t getSize(float texels, uint32_t current) const
+		{
+			if (texels <= 0.0f)
+			{
+				return 0;
+			}
+			if ((current > 0) && (current <= maxTileSize) && (texels <= current * 1.25f) && (texels >= current * 0.35f))
+			{
+				return current;
+			}
+			uint32_t size = minTileSize;
+			while ((size < maxTileSize) && (size < texels))
+			{
+				size *= 2;
+			}
+			return size;
+		}
+
+	public:
+		/**
+		* @param dim Edge length of the atlas in texels, must be a power of two
+		* @param minTileSize Smallest tile handed out, lights that don't fit with it get no tile
+		* @param maxTileSize Largest tile handed out, 0 for the whole atlas
+		*/
+		ShadowAtlas(uint32_t dim, uint32_t minTileSize = 128, uint32_t maxTileSize = 0) :
+			dim(dim), minTileSize(minTileSize), maxTileSize((maxTileSize > 0) ? maxTileSize : dim)
+		{
+			assert(((dim & (dim - 1)) == 0) && ((minTileSize & (minTileSize - 1)) == 0));
+			assert((minTileSize <= this->maxTileSize) && (this->maxTileSize <= dim));
+		}
+
+		/** @brief Change the largest tile handed out, rounded down to a power of two, 0 for the whole atlas, larger tiles are shrunk by the next update */
+		void setMaxTileSize(uint32_t size)
+		{
+			maxTileSize = (size > 0) ? std::max(std::min(size, dim), minTileSize) : dim;
+			while ((maxTileSize & (maxTileSize - 1)) != 0)
+			{
+				maxTileSize &= maxTileSize - 1;
+			}
+		}
+
+		uint32_t getMaxTileSize() const
+		{
+			return maxTileSize;
+		}
+
+		/**
+		* Size and place the tiles of all lights
+		* If the requested tiles don't fit, the largest ones are halved first, of equally sized ones those asking for the fewest texels
+		*
+		* @param texels Edge length in texels wanted by each light, 0 if it doesn't need a tile
+		* @param count Number of lights, at most 32
+		*
+		* @return Bit mask of the lights whose tile has changed, their shadow maps need to be rendered again
+		*/
+		uint32_t update(const float *texels, uint32_t count)
+		{
+			assert(count <= 32);
+			tiles.resize(count);
+			sizes.resize(count);
+
+			uint64_t area = 0;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				sizes[i] = getSize(texels[i], tiles[i].size);
+				area += uint64_t(sizes[i]) * sizes[i];
+			}
+
+			while (area > uint64_t(dim) * dim)
+			{
+				int32_t halved = -1;
+				float halvedWeight = 0.0f;
+				for (uint32_t i = 0; i < count; i++)
+				{
+					if (sizes[i] == 0)
+					{
+						continue;
+					}
+					// Lights that already have a tile of this size hold on to it a little longer
+					const float weight = texels[i] * ((tiles[i].size >= sizes[i]) ? 1.25f : 1.0f);
+					if ((halved < 0) || (sizes[i] > sizes[halved]) || ((sizes[i] == sizes[halved]) && (weight < halvedWeight)))
+					{
+						halved = i;
+						halvedWeight = weight;
+					}
+				}
+				area -= uint64_t(sizes[halved]) * sizes[halved];
+				sizes[halved] = (sizes[halved] > minTileSize) ? sizes[halved] / 2 : 0;
+				area += uint64_t(sizes[halved]) * sizes[halved];
+			}
+
+			// Insertion sort by decreasing size, lights of equal size stay in index order so their tiles keep their place
+			order.resize(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				uint32_t j = i;
+				for (; (j > 0) && (sizes[order[j - 1]] < sizes[i]); j--)
+				{
+					order[j] = order[j - 1];
+				}
+				order[j] = i;
+			}
+
+			// Running offset along the Morton curve in cells of the smallest tile size
+			uint32_t cell = 0;
+			uint32_t changed = 0;
+			for (uint32_t i : order)
+			{
+				Tile tile;
+				tile.size = sizes[i];
+				if (tile.size > 0)
+				{
+					tile.x = compactBits(cell) * minTileSize;
+					tile.y = compactBits(cell >> 1) * minTileSize;
+					cell += (tile.size / minTileSize) * (tile.size / minTileSize);
+				}
+				if (!(tile == tiles[i]))
+				{
+					tiles[i] = tile;
+					changed |= 1 << i;
+				}
+			}
+			return changed;
+		}
+
+		const Tile& getTile(uint32_t index) const
+		{
+			return tiles[index];
+		}
+
+		uint32_t getDim() const
+		{
+			return dim;
+		}
+	};
+}
@@ -0,0 +1,90 @@
+/*
+* Fixed step simulation clock
+*
+* Accumulates the measured frame times and hands out a whole number of fixed simulation steps per frame, so the
+* simulation advances the same way regardless of the frame rate
+* The time left over in the accumulator is returned as an interpolation factor between the state before and after
+* the last step, rendering then lags at most one step behind the simulation
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <assert.h>
+
+namespace vkTools
+{
+	class SimulationClock
+	{
+	private:
+		float step;
+		// Limits the catch up after long frames (e.g. loading or a debugger break), the remaining time is dropped
+		uint32_t maxSteps;
+		float accumulator = 0.0f;
+		uint64_t stepCount = 0;
+
+	public:
+		/**
+		* @param stepsPerSecond Simulation rate
+		* @param maxSteps Maximum number of steps run for a single frame
+		*/
+		SimulationClock(float stepsPerSecond = 60.0f, uint32_t maxSteps = 8) : step(1.0f / stepsPerSecond), maxSteps(maxSteps)
+		{
+			assert((stepsPerSecond > 0.0f) && (maxSteps > 0));
+		}
+
+		/**
+		* Add the time of a frame
+		*
+		* @param elapsed Time since the last call in seconds
+		*
+		* @return Number of fixed steps the simulation has to run for this frame, may be zero at frame rates above the simulation rate
+		*/
+		uint32_t advance(float elapsed)
+		{
+			accumulator += std::max(elapsed, 0.0f);
+			// Tolerates rounding errors, so frame times equal to the step always run one step
+			uint32_t steps = static_cast<uint32_t>(accumulator / step + 1e-3f);
+			if (steps > maxSteps)
+			{
+				steps = maxSteps;
+				accumulator = 0.0f;
+			}
+			else
+			{
+				accumulator = std::max(accumulator - steps * step, 0.0f);
+			}
+			stepCount += steps;
+			return steps;
+		}
+
+		/** @brief Start over from an empty accumulator, e.g. after the simulation has been paused */
+		void reset()
+		{
+			accumulator = 0.0f;
+		}
+
+		/** @brief Interpolation factor between the previous and the current simulation state (0..1) */
+		float getAlpha()
+		{
+			return std::min(accumulator / step, 1.0f);
+		}
+
+		/** @brief Length of a simulation step in seconds */
+		float getStep()
+		{
+			return step;
+		}
+
+		/** @brief Total number of steps run so far */
+		uint64_t getStepCount()
+		{
+			return stepCount;
+		}
+	};
+}
@@ -0,0 +1,237 @@
+/*
+* Live telemetry published as UDP datagrams
+*
+* The render thread fills fixed size samples that are passed to a sender thread through a lock-free queue, so publishing never allocates or blocks
+* The sender thread formats each sample as a single line JSON object and sends it as one datagram, samples beyond the queue's capacity are dropped
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+#include "inputqueue.hpp"
+#include "cputrace.hpp"
+#include "cputopology.hpp"
+
+namespace vkTools
+{
+	class TelemetryPublisher
+	{
+	public:
+		static const uint32_t MAX_PASSES = 32;
+		static const uint32_t MAX_PASS_NAME = 32;
+
+		/** @brief Statistics of one frame, plain data so it can be copied into the queue */
+		struct Sample
+		{
+			uint64_t frame = 0;
+			// CPU frame time in milliseconds
+			float frameTime = 0.0f;
+			uint32_t fps = 0;
+			// GPU times of the profiled passes in milliseconds
+			uint32_t passCount = 0;
+			char passNames[MAX_PASSES][MAX_PASS_NAME];
+			float passTimes[MAX_PASSES];
+			// Device local heaps
+			uint64_t memoryUsed = 0;
+			uint64_t memoryBudget = 0;
+			// Draws and triangles submitted for the camera view, 0 if the example doesn't count them
+			uint32_t draws = 0;
+			uint64_t triangles = 0;
+			uint32_t frustumCulled = 0;
+			uint32_t occlusionCulled = 0;
+			uint32_t backfaceCulled = 0;
+			// Commands drawn by the shadow views and those culled from them
+			uint32_t shadowDraws = 0;
+			uint32_t shadowCulled = 0;
+			// Light clusters with at least one light, the sum of their lights and the lights of the fullest one
+			uint32_t occupiedClusters = 0;
+			uint32_t clusterLights = 0;
+			uint32_t maxClusterLights = 0;
+			// Outstanding texture and geometry streaming requests
+			uint32_t textureStreamingQueue = 0;
+			uint32_t geometryStreamingQueue = 0;
+			// Samples that didn't fit into the queue since the previous published one
+			uint32_t dropped = 0;
+
+			/** @brief Add the GPU time of a pass, names are truncated to MAX_PASS_NAME - 1 characters */
+			void addPass(const std::string &name, float time)
+			{
+				if (passCount == MAX_PASSES)
+				{
+					return;
+				}
+				const size_t length = std::min<size_t>(name.size(), MAX_PASS_NAME - 1);
+				memcpy(passNames[passCount], name.data(), length);
+				passNames[passCount][length] = '\0';
+				passTimes[passCount] = time;
+				passCount++;
+			}
+		};
+
+	private:
+#if defined(_WIN32)
+		SOCKET socket = INVALID_SOCKET;
+#else
+		int socket = -1;
+#endif
+		sockaddr_storage address;
+		socklen_t addressLength = 0;
+		std::chrono::high_resolution_clock::time_point startTime;
+
+		InputQueue<Sample, 16> queue;
+		uint32_t dropped = 0;
+		std::atomic<bool> stopping;
+		std::thread sender;
+
+		void senderLoop()
+		{
+			CpuTrace::get().setThreadName("Telemetry");
+			CpuTopology::get().setThreadRole(CpuTopology::THREAD_ROLE_BACKGROUND);
+			// Large enough for MAX_PASSES passes with names of MAX_PASS_NAME characters
+			char datagram[4096];
+			InputQueue<Sample, 16>::Event event;
+			while (true)
+			{
+				// Stopping is checked before draining, so samples queued before the destructor are still sent
+				const bool stop = stopping;
+				while (queue.pop(event))
+				{
+					const Sample &sample = event.event;
+					const double time = std::chrono::duration<double>(event.timestamp - startTime).count();
+					int length = snprintf(datagram, sizeof(datagram),
+						"{\"time\":%.4f,\"frame\":%llu,\"frameTime\":%.3f,\"fps\":%u,\"memoryUsed\":%llu,\"memoryBudget\":%llu,"
+						"\"draws\":%u,\"triangles\":%llu,\"culled\":{\"frustum\":%u,\"occlusion\":%u,\"backface\":%u},"
+						"\"shadows\":{\"draws\":%u,\"culled\":%u},\"lightClusters\":{\"occupied\":%u,\"lights\":%u,\"max\":%u},"
+						"\"streaming\":{\"textures\":%u,\"geometry\":%u},\"dropped\":%u,\"gpuPasses\":{",
+						time, static_cast<unsigned long long>(sample.frame), sample.frameTime, sample.fps,
+						static_cast<unsigned long long>(sample.memoryUsed), static_cast<unsigned long long>(sample.memoryBudget),
+						sample.draws, static_cast<unsigned long long>(sample.triangles), sample.frustumCulled, sample.occlusionCulled, sample.backfaceCulled,
+						sample.shadowDraws, sample.shadowCulled, sample.occupiedClusters, sample.clusterLights, sample.maxClusterLights,
+						sample.textureStreamingQueue, sample.geometryStreamingQueue, sample.dropped);
+					for (uint32_t i = 0; i < sample.passCount; i++)
+					{
+						length += snprintf(datagram + length, sizeof(datagram) - length, "%s\"%s\":%.4f", (i > 0) ? "," : "", sample.passNames[i], sample.passTimes[i]);
+					}
+					length += snprintf(datagram + length, sizeof(datagram) - length, "}}\n");
+					// Nobody listening isn't an error, the datagrams are just lost
+					sendto(socket, datagram, std::min<int>(length, sizeof(datagram) - 1), 0, reinterpret_cast<const sockaddr*>(&address), addressLength);
+				}
+				if (stop)
+				{
+					return;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+		}
+
+	public:
+		/**
+		* Open the socket and start the sender thread
+		*
+		* @param destination Host and port the datagrams are sent to, e.g. "127.0.0.1:9870"
+		*/
+		TelemetryPublisher(const std::string &destination) : stopping(false)
+		{
+			startTime = std::chrono::high_resolution_clock::now();
+			const size_t separator = destination.rfind(':');
+			const std::string host = (separator != std::string::npos) ? destination.substr(0, separator) : "127.0.0.1";
+			const std::string port = (separator != std::string::npos) ? destination.substr(separator + 1) : destination;
+#if defined(_WIN32)
+			WSADATA wsaData;
+			if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+			{
+				std::cout << "Could not initialize Winsock, telemetry is disabled" << std::endl;
+				return;
+			}
+#endif
+			addrinfo hints = {};
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_DGRAM;
+			addrinfo *result = nullptr;
+			if ((getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) || !result)
+			{
+				std::cout << "Could not resolve telemetry destination \"" << destination << "\", telemetry is disabled" << std::endl;
+				return;
+			}
+			socket = ::socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+			memcpy(&address, result->ai_addr, result->ai_addrlen);
+			addressLength = static_cast<socklen_t>(result->ai_addrlen);
+			freeaddrinfo(result);
+			if (!isActive())
+			{
+				std::cout << "Could not create the telemetry socket, telemetry is disabled" << std::endl;
+				return;
+			}
+			sender = std::thread(&TelemetryPublisher::senderLoop, this);
+		}
+
+		/** @brief Send the queued samples and close the socket */
+		~TelemetryPublisher()
+		{
+			if (sender.joinable())
+			{
+				stopping = true;
+				sender.join();
+			}
+#if defined(_WIN32)
+			if (socket != INVALID_SOCKET)
+			{
+				closesocket(socket);
+			}
+			WSACleanup();
+#else
+			if (socket >= 0)
+			{
+				close(socket);
+			}
+#endif
+		}
+
+		/** @brief False if the destination couldn't be resolved or the socket couldn't be created */
+		bool isActive()
+		{
+#if defined(_WIN32)
+			return socket != INVALID_SOCKET;
+#else
+			return socket >= 0;
+#endif
+		}
+
+		/** @brief Queue a sample for sending, may only be called from one thread */
+		void publish(Sample &sample)
+		{
+			sample.dropped = dropped;
+			if (isActive() && queue.push(sample, std::chrono::high_resolution_clock::now()))
+			{
+				dropped = 0;
+			}
+			else
+			{
+				dropped++;
+			}
+		}
+	};
+}
@@ -0,0 +1,271 @@
+/*
+* Mip levels of a 2D texture file
+*
+* DDS files are memory mapped (or read from the apk's buffer on Android) and their levels are used in place
+* Other files and DDS layouts not handled here (cube maps, arrays, volumes, unknown formats) are decoded with gli
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <assert.h>
+
+#include <gli/gli.hpp>
+
+#include "assetfile.hpp"
+
+namespace vkTools
+{
+	/**
+	* @brief Mip levels of a 2D texture file, pointing into the mapped file if possible
+	*
+	* @note The level data is only valid as long as the object is alive
+	*/
+	class TextureFile
+	{
+	public:
+		struct Level
+		{
+			const uint8_t *data;
+			size_t size;
+			uint32_t width, height;
+		};
+
+	private:
+		struct DdsPixelFormat
+		{
+			uint32_t size;
+			uint32_t flags;
+			uint32_t fourCC;
+			uint32_t rgbBitCount;
+			uint32_t masks[4];
+		};
+
+		struct DdsHeader
+		{
+			uint32_t size;
+			uint32_t flags;
+			uint32_t height;
+			uint32_t width;
+			uint32_t pitchOrLinearSize;
+			uint32_t depth;
+			uint32_t mipMapCount;
+			uint32_t reserved1[11];
+			DdsPixelFormat pixelFormat;
+			uint32_t caps[4];
+			uint32_t reserved2;
+		};
+
+		struct DdsHeaderDx10
+		{
+			uint32_t dxgiFormat;
+			uint32_t resourceDimension;
+			uint32_t miscFlag;
+			uint32_t arraySize;
+			uint32_t miscFlags2;
+		};
+
+		AssetFile file;
+		// Only used if the file couldn't be parsed in place
+		std::unique_ptr<gli::texture2D> tex2D;
+		std::vector<Level> levels;
+		bool mapped = false;
+
+		static uint32_t fourCC(const char *code)
+		{
+			return code[0] | (code[1] << 8) | (code[2] << 16) | (static_cast<uint32_t>(code[3]) << 24);
+		}
+
+		// Bytes per 4 x 4 block of block compressed DXGI formats, bytes per texel of uncompressed ones, 0 if not handled
+		static uint32_t dxgiFormatSize(uint32_t dxgiFormat, bool *compressed)
+		{
+			*compressed = true;
+			// BC1 and BC4
+			if (((dxgiFormat >= 70) && (dxgiFormat <= 72)) || ((dxgiFormat >= 79) && (dxgiFormat <= 81)))
+			{
+				return 8;
+			}
+			// BC2, BC3, BC5, BC6H and BC7
+			if (((dxgiFormat >= 73) && (dxgiFormat <= 78)) || ((dxgiFormat >= 82) && (dxgiFormat <= 84)) || ((dxgiFormat >= 94) && (dxgiFormat <= 99)))
+			{
+				return 16;
+			}
+			*compressed = false;
+			// R8G8B8A8 and B8G8R8A8
+			if (((dxgiFormat >= 27) && (dxgiFormat <= 32)) || ((dxgiFormat >= 87) && (dxgiFormat <= 93)))
+			{
+				return 4;
+			}
+			return 0;
+		}
+
+		// Find the mip levels of a 2D DDS file in place, returns false for layouts that are left to gli
+		bool parseDds(const uint8_t *data, size_t size)
+		{
+			const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+			const uint32_t DDPF_FOURCC = 0x4;
+			const uint32_t DDPF_RGB = 0x40;
+			// Cube map and volume texture flags of caps2
+			const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+			const uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+			if ((size < 4 + sizeof(DdsHeader)) || (memcmp(data, "DDS ", 4) != 0))
+			{
+				return false;
+			}
+			DdsHeader header;
+			memcpy(&header, data + 4, sizeof(DdsHeader));
+			if ((header.size != sizeof(DdsHeader)) || (header.caps[1] & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) || (header.width == 0) || (header.height == 0))
+			{
+				return false;
+			}
+			size_t offset = 4 + sizeof(DdsHeader);
+
+			bool compressed = false;
+			uint32_t formatSize = 0;
+			if ((header.pixelFormat.flags & DDPF_FOURCC) && (header.pixelFormat.fourCC == fourCC("DX10")))
+			{
+				if (size < offset + sizeof(DdsHeaderDx10))
+				{
+					return false;
+				}
+				DdsHeaderDx10 dx10;
+				memcpy(&dx10, data + offset, sizeof(DdsHeaderDx10));
+				offset += sizeof(DdsHeaderDx10);
+				// Only single 2D textures
+				if ((dx10.resourceDimension != 3) || (dx10.arraySize > 1))
+				{
+					return false;
+				}
+				formatSize = dxgiFormatSize(dx10.dxgiFormat, &compressed);
+			}
+			else if (header.pixelFormat.flags & DDPF_FOURCC)
+			{
+				const uint32_t code = header.pixelFormat.fourCC;
+				compressed = true;
+				if ((code == fourCC("DXT1")) || (code == fourCC("ATI1")) || (code == fourCC("BC4U")) || (code == fourCC("BC4S")))
+				{
+					formatSize = 8;
+				}
+				else if ((code == fourCC("DXT2")) || (code == fourCC("DXT3")) || (code == fourCC("DXT4")) || (code == fourCC("DXT5")) || (code == fourCC("ATI2")) || (code == fourCC("BC5U")) || (code == fourCC("BC5S")))
+				{
+					formatSize = 16;
+				}
+			}
+			else if ((header.pixelFormat.flags & DDPF_RGB) && (header.pixelFormat.rgbBitCount % 8 == 0))
+			{
+				formatSize = header.pixelFormat.rgbBitCount / 8;
+			}
+			if (formatSize == 0)
+			{
+				return false;
+			}
+
+			const uint32_t mipLevels = ((header.flags & DDSD_MIPMAPCOUNT) && (header.mipMapCount > 0)) ? header.mipMapCount : 1;
+			std::vector<Level> fileLevels;
+			for (uint32_t i = 0; i < mipLevels; i++)
+			{
+				Level level;
+				level.width = std::max(header.width >> i, 1u);
+				level.height = std::max(header.height >> i, 1u);
+				level.size = compressed ?
+					static_cast<size_t>((level.width + 3) / 4) * ((level.height + 3) / 4) * formatSize :
+					static_cast<size_t>(level.width) * level.height * formatSize;
+				if (offset + level.size > size)
+				{
+					return false;
+				}
+				level.data = data + offset;
+				offset += level.size;
+				fileLevels.push_back(level);
+			}
+			levels.swap(fileLevels);
+			return true;
+		}
+
+	public:
+#if defined(__ANDROID__)
+		AAssetManager* assetManager = nullptr;
+#endif
+
+		TextureFile() {}
+		TextureFile(const TextureFile&) = delete;
+		TextureFile& operator=(const TextureFile&) = delete;
+
+		/**
+		* Load the mip levels of a 2D texture file
+		*
+		* @param filename File to load (.dds are used in place, .ktx and other .dds layouts are decoded with gli)
+		*
+		* @return False if the file couldn't be loaded
+		*/
+		bool load(const std::string &filename)
+		{
+			levels.clear();
+#if defined(__ANDROID__)
+			// Textures are stored inside the apk on Android
+			file.assetManager = assetManager;
+#endif
+			if (!file.open(filename))
+			{
+				return false;
+			}
+			const uint8_t *data = static_cast<const uint8_t*>(file.data());
+			const size_t size = file.getSize();
+			if (parseDds(data, size))
+			{
+				mapped = true;
+				return true;
+			}
+
+			// Decode with gli from the same memory
+			tex2D.reset(new gli::texture2D(gli::load(reinterpret_cast<const char*>(data), size)));
+			file.close();
+			if (!tex2D || tex2D->empty())
+			{
+				return false;
+			}
+			for (size_t i = 0; i < tex2D->levels(); i++)
+			{
+				const gli::image image = (*tex2D)[i];
+				Level level;
+				level.data = static_cast<const uint8_t*>(image.data());
+				level.size = image.size();
+				level.width = static_cast<uint32_t>(image.dimensions().x);
+				level.height = static_cast<uint32_t>(image.dimensions().y);
+				levels.push_back(level);
+			}
+			return true;
+		}
+
+		const std::vector<Level>& getLevels() const
+		{
+			return levels;
+		}
+
+		size_t getSize() const
+		{
+			size_t size = 0;
+			for (auto& level : levels)
+			{
+				size += level.size;
+			}
+			return size;
+		}
+
+		/** @brief True if the levels point into the mapped file instead of a decoded copy */
+		bool isMapped() const
+		{
+			return mapped;
+		}
+	};
+}
@@ -0,0 +1,347 @@
+/*
+* Texture format selection and transcoding
+*
+* Textures are uploaded in the format stored in the file if the device can sample it
+* Otherwise block compressed (BC1 - BC3) data is decoded to RGBA8 on the host, which every device can sample
+* Normal maps only keep their x and y, they are transcoded to BC5 or decoded to RG8 and the shaders reconstruct z
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <assert.h>
+
+#include <vulkan/vulkan.h>
+
+namespace vkTools
+{
+	/**
+	* @brief Picks the upload format of textures and decodes block compressed data the device can't sample
+	*
+	* @note All functions are thread safe, so decoding can be done on the threads loading the files
+	*/
+	class TextureTranscoder
+	{
+	private:
+		static bool isSrgb(VkFormat format)
+		{
+			return (format == VK_FORMAT_BC1_RGB_SRGB_BLOCK) || (format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK) || (format == VK_FORMAT_BC2_SRGB_BLOCK) || (format == VK_FORMAT_BC3_SRGB_BLOCK);
+		}
+
+		// Expand a RGB565 color to 8 bits per channel
+		static void unpack565(uint16_t color, uint8_t *rgba)
+		{
+			rgba[0] = static_cast<uint8_t>(((color >> 11) & 0x1f) * 255 / 31);
+			rgba[1] = static_cast<uint8_t>(((color >> 5) & 0x3f) * 255 / 63);
+			rgba[2] = static_cast<uint8_t>((color & 0x1f) * 255 / 31);
+			rgba[3] = 255;
+		}
+
+		// Color part of a block, shared by BC1 - BC3
+		// BC2 and BC3 always use the four color mode, BC1 switches to three colors and transparent black if color0 <= color1
+		static void decodeColorBlock(const uint8_t *block, bool fourColorMode, uint8_t texels[16][4])
+		{
+			const uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+			const uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+			uint8_t palette[4][4];
+			unpack565(color0, palette[0]);
+			unpack565(color1, palette[1]);
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				if (fourColorMode || (color0 > color1))
+				{
+					palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+					palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+				}
+				else
+				{
+					palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+					palette[3][c] = 0;
+				}
+			}
+			palette[2][3] = 255;
+			palette[3][3] = (fourColorMode || (color0 > color1)) ? 255 : 0;
+			const uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				const uint8_t *color = palette[(indices >> (2 * i)) & 0x3];
+				std::copy(color, color + 4, texels[i]);
+			}
+		}
+
+		// Explicit 4 bit alpha of BC2
+		static void decodeExplicitAlpha(const uint8_t *block, uint8_t texels[16][4])
+		{
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				const uint8_t alpha = (block[i / 2] >> (4 * (i % 2))) & 0xf;
+				texels[i][3] = static_cast<uint8_t>(alpha * 17);
+			}
+		}
+
+		// Interpolated alpha of BC3
+		static void decodeInterpolatedAlpha(const uint8_t *block, uint8_t texels[16][4])
+		{
+			uint8_t palette[8];
+			palette[0] = block[0];
+			palette[1] = block[1];
+			if (palette[0] > palette[1])
+			{
+				for (uint32_t i = 1; i < 7; i++)
+				{
+					palette[i + 1] = static_cast<uint8_t>(((7 - i) * palette[0] + i * palette[1]) / 7);
+				}
+			}
+			else
+			{
+				for (uint32_t i = 1; i < 5; i++)
+				{
+					palette[i + 1] = static_cast<uint8_t>(((5 - i) * palette[0] + i * palette[1]) / 5);
+				}
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+			uint64_t indices = 0;
+			for (uint32_t i = 0; i < 6; i++)
+			{
+				indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+			}
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				texels[i][3] = palette[(indices >> (3 * i)) & 0x7];
+			}
+		}
+
+		// One channel of a block as BC4 in the eight value mode, the endpoints are the channel's extremes in the block
+		static void encodeSingleChannel(const uint8_t texels[16][4], uint32_t channel, uint8_t *block)
+		{
+			uint8_t low = 255;
+			uint8_t high = 0;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				low = std::min(low, texels[i][channel]);
+				high = std::max(high, texels[i][channel]);
+			}
+			// A block of a single value uses index 0 in either mode
+			block[0] = high;
+			block[1] = low;
+			const uint32_t range = high - low;
+			uint64_t indices = 0;
+			for (uint32_t i = 0; (i < 16) && (range > 0); i++)
+			{
+				// Steps from the first endpoint, index 1 is the second endpoint and 2 - 7 lie between them
+				const uint32_t step = ((high - texels[i][channel]) * 7 + range / 2) / range;
+				const uint64_t index = (step == 0) ? 0 : ((step == 7) ? 1 : step + 1);
+				indices |= index << (3 * i);
+			}
+			for (uint32_t i = 0; i < 6; i++)
+			{
+				block[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+			}
+		}
+
+		// Decode a block of the source format, see decode
+		static void decodeBlock(VkFormat format, const uint8_t *block, uint8_t texels[16][4])
+		{
+			if (getBlockSize(format) == 8)
+			{
+				decodeColorBlock(block, false, texels);
+				return;
+			}
+			// The alpha block is followed by the color block
+			decodeColorBlock(block + 8, true, texels);
+			if ((format == VK_FORMAT_BC3_UNORM_BLOCK) || (format == VK_FORMAT_BC3_SRGB_BLOCK))
+			{
+				decodeInterpolatedAlpha(block, texels);
+			}
+			else
+			{
+				decodeExplicitAlpha(block, texels);
+			}
+		}
+
+	public:
+		/** @brief True if the format is a block compressed format that can be decoded on the host */
+		static bool isDecodable(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			case VK_FORMAT_BC2_UNORM_BLOCK:
+			case VK_FORMAT_BC2_SRGB_BLOCK:
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		/** @brief True if images of the format can be sampled with linear filtering and optimal tiling */
+		static bool isSampleable(VkPhysicalDevice physicalDevice, VkFormat format)
+		{
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+			const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+			return (formatProperties.optimalTilingFeatures & required) == required;
+		}
+
+		/**
+		* Select the format a texture stored in the given format is uploaded in
+		*
+		* @param physicalDevice Device the texture is sampled on
+		* @param format Vulkan format of the image data stored in the file
+		* @param (Optional) normalMap Tangent space normals in x and y, stored in a two channel format (defaults to false)
+		*
+		* @return format if the device supports it or it can't be decoded, RGBA8 with the same color space otherwise
+		* Decodable normal maps are BC5 if the device supports it and RG8 otherwise
+		*/
+		static VkFormat selectFormat(VkPhysicalDevice physicalDevice, VkFormat format, bool normalMap = false)
+		{
+			if (normalMap && isDecodable(format) && !isSrgb(format))
+			{
+				return isSampleable(physicalDevice, VK_FORMAT_BC5_UNORM_BLOCK) ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_R8G8_UNORM;
+			}
+			if (!isDecodable(format) || isSampleable(physicalDevice, format))
+			{
+				return format;
+			}
+			return isSrgb(format) ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		}
+
+		/** @brief Size of a 4 x 4 texel block in bytes, used to estimate the memory of a mip chain */
+		static uint32_t getBlockSize(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+				return 8;
+			case VK_FORMAT_BC2_UNORM_BLOCK:
+			case VK_FORMAT_BC2_SRGB_BLOCK:
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+			case VK_FORMAT_BC5_UNORM_BLOCK:
+				return 16;
+			case VK_FORMAT_R8G8_UNORM:
+				return 32;
+			default:
+				// RGBA8
+				return 64;
+			}
+		}
+
+		/** @brief Size of a decoded mip level in bytes */
+		static size_t getDecodedSize(uint32_t width, uint32_t height)
+		{
+			return static_cast<size_t>(width) * height * 4;
+		}
+
+		/** @brief Size of a mip level transcoded to a format returned by selectFormat */
+		static size_t getTranscodedSize(VkFormat format, uint32_t width, uint32_t height)
+		{
+			if (format == VK_FORMAT_BC5_UNORM_BLOCK)
+			{
+				return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * 16;
+			}
+			return (format == VK_FORMAT_R8G8_UNORM) ? static_cast<size_t>(width) * height * 2 : getDecodedSize(width, height);
+		}
+
+		/**
+		* Decode a mip level of block compressed data to RGBA8
+		*
+		* @param format Block compressed format of the source data (see isDecodable)
+		* @param source Blocks of the mip level, rows of blocks from top to bottom
+		* @param width Width of the mip level in texels
+		* @param height Height of the mip level in texels
+		* @param target Receives the decoded texels, must hold getDecodedSize(width, height) bytes
+		*/
+		static void decode(VkFormat format, const void *source, uint32_t width, uint32_t height, void *target)
+		{
+			assert(isDecodable(format));
+			const uint32_t blockSize = getBlockSize(format);
+			const uint32_t blocksX = (width + 3) / 4;
+			const uint32_t blocksY = (height + 3) / 4;
+			const uint8_t *block = static_cast<const uint8_t*>(source);
+			uint8_t *texels = static_cast<uint8_t*>(target);
+			for (uint32_t by = 0; by < blocksY; by++)
+			{
+				for (uint32_t bx = 0; bx < blocksX; bx++, block += blockSize)
+				{
+					uint8_t decoded[16][4];
+					decodeBlock(format, block, decoded);
+					// Blocks of levels smaller than 4 x 4 texels are cropped
+					const uint32_t rows = std::min(4u, height - by * 4);
+					const uint32_t columns = std::min(4u, width - bx * 4);
+					for (uint32_t y = 0; y < rows; y++)
+					{
+						uint8_t *row = texels + ((static_cast<size_t>(by) * 4 + y) * width + bx * 4) * 4;
+						std::copy(&decoded[y * 4][0], &decoded[y * 4][0] + columns * 4, row);
+					}
+				}
+			}
+		}
+
+		/**
+		* Transcode a mip level of block compressed data to the format selectFormat returned for it
+		*
+		* @param format Block compressed format of the source data (see isDecodable)
+		* @param targetFormat Format returned by selectFormat, RGBA8, RG8 or BC5
+		* @param source Blocks of the mip level, rows of blocks from top to bottom
+		* @param width Width of the mip level in texels
+		* @param height Height of the mip level in texels
+		* @param target Receives the transcoded level, must hold getTranscodedSize(targetFormat, width, height) bytes
+		*/
+		static void transcode(VkFormat format, VkFormat targetFormat, const void *source, uint32_t width, uint32_t height, void *target)
+		{
+			if ((targetFormat != VK_FORMAT_BC5_UNORM_BLOCK) && (targetFormat != VK_FORMAT_R8G8_UNORM))
+			{
+				decode(format, source, width, height, target);
+				return;
+			}
+			assert(isDecodable(format));
+			const uint32_t blockSize = getBlockSize(format);
+			const uint32_t blocksX = (width + 3) / 4;
+			const uint32_t blocksY = (height + 3) / 4;
+			const uint8_t *block = static_cast<const uint8_t*>(source);
+			uint8_t *output = static_cast<uint8_t*>(target);
+			for (uint32_t by = 0; by < blocksY; by++)
+			{
+				for (uint32_t bx = 0; bx < blocksX; bx++, block += blockSize)
+				{
+					uint8_t decoded[16][4];
+					decodeBlock(format, block, decoded);
+					if (targetFormat == VK_FORMAT_BC5_UNORM_BLOCK)
+					{
+						// Texels outside of levels smaller than 4 x 4 are encoded too, they are never sampled
+						encodeSingleChannel(decoded, 0, output);
+						encodeSingleChannel(decoded, 1, output + 8);
+						output += 16;
+						continue;
+					}
+					const uint32_t rows = std::min(4u, height - by * 4);
+					const uint32_t columns = std::min(4u, width - bx * 4);
+					for (uint32_t y = 0; y < rows; y++)
+					{
+						uint8_t *row = output + ((static_cast<size_t>(by) * 4 + y) * width + bx * 4) * 2;
+						for (uint32_t x = 0; x < columns; x++)
+						{
+							row[x * 2] = decoded[y * 4 + x][0];
+							row[x * 2 + 1] = decoded[y * 4 + x][1];
+						}
+					}
+				}
+			}
+		}
+	};
+}
@@ -1,16 +1,21 @@
 /*
 * Basic C++11 based thread pool with per-thread job queues
 *
+* Thin wrapper over the work stealing job system (jobsystem.hpp)
+* Jobs added to a thread are executed in order and never concurrently, but not necessarily on the same OS thread
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <vector>
-#include <thread>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include <functional>
+#include <memory>
+
+#include "jobsystem.hpp"
 
 // make_unique is not available in C++11
 // Taken from Herb Sutter's blog (https://herbsutter.com/gotw/_102/)
@@ -25,91 +30,75 @@ namespace vkTools
 	class Thread
 	{
 	private:
-		bool destroying = false;
-		std::thread worker;
-		std::queue<std::function<void()>> jobQueue;
-		std::mutex queueMutex;
-		std::condition_variable condition;
-
-		// Loop through all remaining jobs
-		void queueLoop()
-		{
-			while (true)
-			{
-				std::function<void()> job;
-				{
-					std::unique_lock<std::mutex> lock(queueMutex);
-					condition.wait(lock, [this] { return !jobQueue.empty() || destroying; });
-					if (destroying)
-					{
-						break;
-					}
-					job = jobQueue.front();
-				}
-
-				job();
-
-				{
-					std::lock_guard<std::mutex> lock(queueMutex);
-					jobQueue.pop();
-					condition.notify_one();
-				}
-			}
-		}
+		JobSystem &jobSystem;
+		std::vector<std::function<void()>> jobs;
+		JobSystem::Counter counter;
 
 	public:
-		Thread()
-		{
-			worker = std::thread(&Thread::queueLoop, this);
-		}
+		Thread(JobSystem &jobSystem) : jobSystem(jobSystem), counter(0) {}
 
 		~Thread()
 		{
-			if (worker.joinable())
-			{
-				wait();
-				queueMutex.lock();
-				destroying = true;
-				condition.notify_one();
-				queueMutex.unlock();
-				worker.join();
-			}
+			wait();
 		}
 
 		// Add a new job to the thread's queue
+		// Jobs are collected and submitted to the job system as a single job on flush or wait
 		void addJob(std::function<void()> function)
 		{
-			std::lock_guard<std::mutex> lock(queueMutex);
-			jobQueue.push(std::move(function));
-			condition.notify_one();
+			jobs.push_back(std::move(function));
+		}
+
+		// Submit all jobs added since the last flush
+		void flush()
+		{
+			if (jobs.empty())
+			{
+				return;
+			}
+			std::shared_ptr<std::vector<std::function<void()>>> batch = std::make_shared<std::vector<std::function<void()>>>();
+			batch->swap(jobs);
+			jobSystem.run([batch] {
+				for (auto& job : *batch)
+				{
+					job();
+				}
+			}, &counter);
 		}
 
 		// Wait until all work items have been finished
 		void wait()
 		{
-			std::unique_lock<std::mutex> lock(queueMutex);
-			condition.wait(lock, [this]() { return jobQueue.empty(); });
+			flush();
+			jobSystem.wait(counter);
 		}
 	};
 	
 	class ThreadPool
 	{
 	public:
+		std::unique_ptr<JobSystem> jobSystem;
 		std::vector<std::unique_ptr<Thread>> threads;
 
 		// Sets the number of threads to be allocted in this pool
 		void setThreadCount(uint32_t count)
 		{
 			threads.clear();
-			for (auto i = 0; i < count; i++)
+			jobSystem.reset(new JobSystem(count));
+			for (uint32_t i = 0; i < count; i++)
 			{
-				threads.push_back(make_unique<Thread>());
+				threads.push_back(make_unique<Thread>(*jobSystem));
 			}
 		}
 
 		// Wait until all threads have finished their work items
 		void wait()
 		{
+			// Submit everything first, so all threads' jobs can run in parallel
+			for (auto &thread : threads)
+			{
+				thread->flush();
+			}
 			for (auto &thread : threads)
 			{
 				thread->wait();
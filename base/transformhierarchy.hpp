@@ -0,0 +1,191 @@
+/*
+* Flat hierarchy of node transforms with dirty flag propagation
+*
+* Nodes are stored sorted by their depth in the hierarchy, so every parent comes before its children
+* Local and world matrices are kept in separate arrays, the nodes of a level only read their parents' world matrices
+* and are updated in parallel, one level after the other
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <assert.h>
+
+#include <glm/glm.hpp>
+
+#include "jobsystem.hpp"
+
+namespace vkTools
+{
+	class TransformHierarchy
+	{
+	public:
+		/** @brief Parent of root nodes */
+		static const int32_t NO_PARENT = -1;
+
+	private:
+		std::vector<int32_t> parents;
+		std::vector<uint32_t> depths;
+		std::vector<glm::mat4> locals;
+		std::vector<glm::mat4> worlds;
+		// Set by setLocal, cleared by update
+		std::vector<uint8_t> dirty;
+		// Set by update for nodes whose world matrix has changed, valid until the next update
+		std::vector<uint8_t> changed;
+		// First node of each depth, followed by the node count
+		std::vector<uint32_t> levelStarts;
+		bool anyDirty = false;
+		// Range of the nodes changed by the last update
+		uint32_t firstChanged = 0;
+		uint32_t lastChanged = 0;
+
+	public:
+		/** @brief Remove all nodes */
+		void clear()
+		{
+			parents.clear();
+			depths.clear();
+			locals.clear();
+			worlds.clear();
+			dirty.clear();
+			changed.clear();
+			levelStarts.clear();
+			anyDirty = false;
+			firstChanged = lastChanged = 0;
+		}
+
+		/**
+		* Append a node, its world matrix is computed right away
+		*
+		* @param parent Index of the parent node or NO_PARENT, must have been added before
+		* @param local Transform relative to the parent
+		*
+		* @return Index of the node
+		*
+		* @note Nodes must be added in the order of their depth (breadth first)
+		*/
+		uint32_t add(int32_t parent, const glm::mat4 &local)
+		{
+			assert(parent < static_cast<int32_t>(parents.size()));
+			const uint32_t index = static_cast<uint32_t>(parents.size());
+			const uint32_t depth = (parent == NO_PARENT) ? 0 : depths[parent] + 1;
+			assert(depths.empty() || (depth >= depths.back()));
+			if (depths.empty() || (depth != depths.back()))
+			{
+				levelStarts.push_back(index);
+			}
+			parents.push_back(parent);
+			depths.push_back(depth);
+			locals.push_back(local);
+			worlds.push_back((parent == NO_PARENT) ? local : worlds[parent] * local);
+			dirty.push_back(0);
+			changed.push_back(0);
+			return index;
+		}
+
+		/** @brief Change a node's transform relative to its parent, its world matrix and those of its children are updated by the next update */
+		void setLocal(uint32_t node, const glm::mat4 &local)
+		{
+			assert(node < locals.size());
+			locals[node] = local;
+			dirty[node] = 1;
+			anyDirty = true;
+		}
+
+		/**
+		* Recompute the world matrices of the nodes changed since the last update and of all of their children
+		*
+		* @param jobSystem (Optional) Job system the nodes of each level are spread across
+		*
+		* @return True if any world matrix has changed
+		*/
+		bool update(JobSystem *jobSystem = nullptr)
+		{
+			std::fill(changed.begin() + firstChanged, changed.begin() + lastChanged, 0);
+			firstChanged = lastChanged = 0;
+			if (!anyDirty)
+			{
+				return false;
+			}
+			anyDirty = false;
+
+			// Within a level the nodes only read their parents' state, which the previous level has finished
+			auto updateRange = [&](uint32_t first, uint32_t last)
+			{
+				for (uint32_t i = first; i < last; i++)
+				{
+					const int32_t parent = parents[i];
+					const bool parentChanged = (parent != NO_PARENT) && changed[parent];
+					if (dirty[i] || parentChanged)
+					{
+						worlds[i] = (parent == NO_PARENT) ? locals[i] : worlds[parent] * locals[i];
+						dirty[i] = 0;
+						changed[i] = 1;
+					}
+				}
+			};
+			levelStarts.push_back(static_cast<uint32_t>(parents.size()));
+			for (size_t level = 0; level + 1 < levelStarts.size(); level++)
+			{
+				const uint32_t first = levelStarts[level];
+				const uint32_t count = levelStarts[level + 1] - first;
+				// Small levels aren't worth the jobs' overhead
+				if (jobSystem && (count >= 256))
+				{
+					jobSystem->parallelFor(count, 64, [&](uint32_t begin, uint32_t end) { updateRange(first + begin, first + end); });
+				}
+				else
+				{
+					updateRange(first, first + count);
+				}
+			}
+			levelStarts.pop_back();
+
+			// Changes are usually confined to a few subtrees, so callers only scan the range between the first and the last changed node
+			const auto firstIt = std::find(changed.begin(), changed.end(), 1);
+			firstChanged = static_cast<uint32_t>(firstIt - changed.begin());
+			lastChanged = static_cast<uint32_t>(changed.rend() - std::find(changed.rbegin(), changed.rend(), 1));
+			lastChanged = std::max(lastChanged, firstChanged);
+			return firstChanged < lastChanged;
+		}
+
+		/** @brief True if the node's world matrix has been changed by the last update */
+		bool isChanged(uint32_t node) const
+		{
+			return changed[node] != 0;
+		}
+
+		/** @brief Range of the nodes that may have been changed by the last update, empty if none has */
+		void getChangedRange(uint32_t &first, uint32_t &last) const
+		{
+			first = firstChanged;
+			last = lastChanged;
+		}
+
+		const glm::mat4 &getLocal(uint32_t node) const
+		{
+			return locals[node];
+		}
+
+		const glm::mat4 &getWorld(uint32_t node) const
+		{
+			return worlds[node];
+		}
+
+		int32_t getParent(uint32_t node) const
+		{
+			return parents[node];
+		}
+
+		uint32_t getNodeCount() const
+		{
+			return static_cast<uint32_t>(parents.size());
+		}
+	};
+}
@@ -0,0 +1,214 @@
+/*
+* Streams captured frames to a video encoder process
+*
+* Frames are piped as raw video into ffmpeg, which encodes them with the selected (e.g. hardware) encoder and sends them to the output
+* Frames are queued on their own thread with a bounded number of frames in flight, frames beyond that are dropped instead of delaying rendering
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <stdio.h>
+#include <stdint.h>
+#if !defined(_WIN32)
+#include <signal.h>
+#endif
+
+#include <vulkan/vulkan.h>
+
+#include "cputrace.hpp"
+#include "cputopology.hpp"
+
+namespace vkTools
+{
+	class VideoStream
+	{
+	private:
+		FILE *pipe = nullptr;
+		uint32_t width;
+		uint32_t height;
+		uint32_t maxQueuedFrames;
+
+		// Frames waiting to be written to the encoder, reused once written
+		std::deque<std::vector<uint8_t>> queue;
+		std::vector<std::vector<uint8_t>> freeFrames;
+		std::mutex mutex;
+		std::condition_variable queueCondition;
+		bool stopping = false;
+		std::thread writer;
+
+		std::atomic<uint32_t> streamedCount;
+		std::atomic<uint32_t> droppedCount;
+		std::atomic<bool> failed;
+
+		static const char* getPixelFormat(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_B8G8R8A8_UNORM: case VK_FORMAT_B8G8R8A8_SRGB: return "bgra";
+			case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SRGB: return "rgba";
+			default: return nullptr;
+			}
+		}
+
+		void writerLoop()
+		{
+			CpuTrace::get().setThreadName("Video stream");
+			CpuTopology::get().setThreadRole(CpuTopology::THREAD_ROLE_BACKGROUND);
+			while (true)
+			{
+				std::vector<uint8_t> frame;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					queueCondition.wait(lock, [this] { return stopping || !queue.empty(); });
+					if (queue.empty())
+					{
+						return;
+					}
+					frame.swap(queue.front());
+					queue.pop_front();
+				}
+				// Blocks while the encoder is busy, which only makes later frames get dropped
+				if (!failed && (fwrite(frame.data(), 1, frame.size(), pipe) != frame.size()))
+				{
+					failed = true;
+					std::cout << "Video encoder stopped accepting frames, streaming has been stopped" << std::endl;
+				}
+				streamedCount++;
+				std::lock_guard<std::mutex> lock(mutex);
+				freeFrames.push_back(std::move(frame));
+			}
+		}
+
+	public:
+		/** @brief Check if frames of a format can be streamed */
+		static bool formatSupported(VkFormat format)
+		{
+			return getPixelFormat(format) != nullptr;
+		}
+
+		/**
+		* Start the encoder process
+		*
+		* @param output Output the encoder writes to, a file name or a streaming URL like udp://host:port
+		* @param codec Name of the ffmpeg video encoder, e.g. h264_nvenc, hevc_nvenc, h264_amf, h264_qsv or libx264
+		* @param format Format of the streamed frames, see formatSupported
+		* @param width Width of the streamed frames, frames of other sizes are dropped
+		* @param height Height of the streamed frames
+		* @param frameRate Frame rate the stream is encoded with
+		* @param maxQueuedFrames Frames waiting for the encoder before further frames are dropped, bounds the streaming latency
+		*/
+		VideoStream(const std::string &output, const std::string &codec, VkFormat format, uint32_t width, uint32_t height, uint32_t frameRate, uint32_t maxQueuedFrames)
+			: width(width), height(height), maxQueuedFrames(maxQueuedFrames), streamedCount(0), droppedCount(0), failed(false)
+		{
+			assert(formatSupported(format));
+			// Low latency settings, the output container is derived from the output name (mpegts for streaming URLs)
+			std::stringstream command;
+			command << "ffmpeg -loglevel error -y -f rawvideo -pix_fmt " << getPixelFormat(format) << " -s " << width << "x" << height << " -framerate " << frameRate
+				<< " -i - -c:v " << codec << " -pix_fmt yuv420p -g " << frameRate << " -bf 0";
+			if (output.find("://") != std::string::npos)
+			{
+				command << " -f mpegts";
+			}
+			command << " \"" << output << "\"";
+#if defined(_WIN32)
+			pipe = _popen(command.str().c_str(), "wb");
+#else
+			// Writing to an encoder that has exited must fail instead of terminating the process
+			signal(SIGPIPE, SIG_IGN);
+			pipe = popen(command.str().c_str(), "w");
+#endif
+			if (!pipe)
+			{
+				failed = true;
+				std::cout << "Could not start the video encoder: " << command.str() << std::endl;
+				return;
+			}
+			writer = std::thread(&VideoStream::writerLoop, this);
+		}
+
+		/** @brief Write the queued frames and wait for the encoder to finish the stream */
+		~VideoStream()
+		{
+			if (!pipe)
+			{
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			queueCondition.notify_all();
+			writer.join();
+#if defined(_WIN32)
+			_pclose(pipe);
+#else
+			pclose(pipe);
+#endif
+		}
+
+		/** @brief False if the encoder couldn't be started or has stopped accepting frames */
+		bool isActive()
+		{
+			return !failed;
+		}
+
+		/**
+		* Queue a frame for the encoder, thread safe
+		* Can be used as a VulkanFrameCapture consumer
+		*/
+		void addFrame(const void *data, uint32_t width, uint32_t height)
+		{
+			if (failed || (width != this->width) || (height != this->height))
+			{
+				droppedCount++;
+				return;
+			}
+			std::vector<uint8_t> frame;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (queue.size() >= maxQueuedFrames)
+				{
+					droppedCount++;
+					return;
+				}
+				if (!freeFrames.empty())
+				{
+					frame.swap(freeFrames.back());
+					freeFrames.pop_back();
+				}
+			}
+			const uint8_t *pixels = static_cast<const uint8_t*>(data);
+			frame.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.push_back(std::move(frame));
+			}
+			queueCondition.notify_one();
+		}
+
+		/** @brief Number of frames passed to the encoder */
+		uint32_t getStreamedCount()
+		{
+			return streamedCount;
+		}
+
+		/** @brief Number of frames dropped because the encoder fell behind or the frame size changed */
+		uint32_t getDroppedCount()
+		{
+			return droppedCount;
+		}
+	};
+}
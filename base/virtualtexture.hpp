@@ -0,0 +1,541 @@
+/*
+* Virtual texture pages
+*
+* Textures are split into square pages that are loaded on demand into the slots of a physical page cache of fixed size,
+* so the memory used by the textures stays the same regardless of how many there are
+* Rendering reports the pages it wanted through one feedback bit per page, missing pages are loaded coarsest first into the
+* slots that haven't been used for the longest time
+* The page table maps each page to its slot, or to the slot of its closest resident ancestor until it has been loaded
+* The last level of each texture is kept resident, so every page has a fallback
+*
+* The pages are cooked once into a tiled page file, each surrounded by a border of the neighbouring texels for filtering
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mappedfile.hpp"
+#include "texturefile.hpp"
+
+namespace vkTools
+{
+	class VirtualTexture
+	{
+	public:
+		// Texels along each edge of a page, without the border
+		static const uint32_t PAGE_SIZE = 128;
+		// Texels repeated from the neighbouring pages on each side, one 4 x 4 block of the compressed formats
+		static const uint32_t PAGE_BORDER = 4;
+		// Edge length of a page's slot in the physical cache
+		static const uint32_t SLOT_SIZE = PAGE_SIZE + 2 * PAGE_BORDER;
+
+		// Texture as read by the shaders (std430), its pages are stored level by level starting at firstPage
+		struct TextureInfo
+		{
+			uint32_t firstPage;
+			uint32_t width;
+			uint32_t height;
+			// Number of paged levels, the last one is kept resident
+			uint32_t levelCount;
+		};
+
+		struct Page
+		{
+			uint32_t texture;
+			uint32_t level;
+			uint32_t x, y;
+		};
+
+		// Page to be loaded into a slot of the physical cache
+		struct Request
+		{
+			uint32_t page;
+			uint32_t slot;
+		};
+
+		// Page table entry, the slot in the low 16 bits and the level of the page stored in it above
+		static uint32_t makeEntry(uint32_t slot, uint32_t level)
+		{
+			return slot | (level << 16);
+		}
+
+	private:
+		struct Slot
+		{
+			uint32_t page = UINT32_MAX;
+			uint64_t lastUsed = 0;
+			// Slots of the resident last levels are never replaced
+			bool pinned = false;
+		};
+
+		std::vector<TextureInfo> textures;
+		std::vector<Page> pages;
+		// Slot of each page, UINT32_MAX if it's not resident
+		std::vector<uint32_t> pageSlots;
+		// Pages whose slot has been assigned but whose data hasn't been committed yet
+		std::vector<bool> pageLoading;
+		std::vector<uint32_t> table;
+		bool tableDirty = false;
+
+		std::vector<Slot> slots;
+		std::vector<uint32_t> freeSlots;
+		std::vector<Request> pinnedPages;
+		// Frames a slot stays untouched before it may be replaced, covers the latency of the feedback
+		uint32_t keepFrames;
+		uint64_t frame = 0;
+
+		// Coarsest missing pages wanted by the last feedback, scratch storage kept to not allocate every frame
+		std::vector<uint32_t> wanted;
+
+		static uint32_t levelDim(uint32_t dim, uint32_t level)
+		{
+			return std::max(dim >> level, 1u);
+		}
+
+		static uint32_t pageCount(uint32_t dim, uint32_t level)
+		{
+			return (levelDim(dim, level) + PAGE_SIZE - 1) / PAGE_SIZE;
+		}
+
+		uint32_t getPageIndex(uint32_t texture, uint32_t level, uint32_t x, uint32_t y) const
+		{
+			const TextureInfo &info = textures[texture];
+			uint32_t index = info.firstPage;
+			for (uint32_t i = 0; i < level; i++)
+			{
+				index += pageCount(info.width, i) * pageCount(info.height, i);
+			}
+			return index + y * pageCount(info.width, level) + x;
+		}
+
+		// Page covering the same area one level up, UINT32_MAX for the texture's last level
+		uint32_t getParent(uint32_t index) const
+		{
+			const Page &page = pages[index];
+			if (page.level + 1 >= textures[page.texture].levelCount)
+			{
+				return UINT32_MAX;
+			}
+			return getPageIndex(page.texture, page.level + 1, page.x / 2, page.y / 2);
+		}
+
+		bool isResident(uint32_t index) const
+		{
+			return (pageSlots[index] != UINT32_MAX) && !pageLoading[index];
+		}
+
+		// Point a page and all of its non resident descendants at the page's own slot if it's resident, or at the given fallback
+		void updateEntries(uint32_t index, uint32_t fallback)
+		{
+			const Page page = pages[index];
+			const uint32_t entry = isResident(index) ? makeEntry(pageSlots[index], page.level) : fallback;
+			// The descendants were derived from the same entry
+			if (table[index] == entry)
+			{
+				return;
+			}
+			table[index] = entry;
+			tableDirty = true;
+			if (page.level == 0)
+			{
+				return;
+			}
+			const TextureInfo &info = textures[page.texture];
+			const uint32_t pagesX = pageCount(info.width, page.level - 1);
+			const uint32_t pagesY = pageCount(info.height, page.level - 1);
+			for (uint32_t y = page.y * 2; y < std::min(page.y * 2 + 2, pagesY); y++)
+			{
+				for (uint32_t x = page.x * 2; x < std::min(page.x * 2 + 2, pagesX); x++)
+				{
+					updateEntries(getPageIndex(page.texture, page.level - 1, x, y), entry);
+				}
+			}
+		}
+
+		// Free slot, or the least recently used one that hasn't been needed for keepFrames, UINT32_MAX if none can be replaced
+		uint32_t acquireSlot()
+		{
+			if (!freeSlots.empty())
+			{
+				const uint32_t slot = freeSlots.back();
+				freeSlots.pop_back();
+				return slot;
+			}
+			uint32_t victim = UINT32_MAX;
+			for (uint32_t i = 0; i < slots.size(); i++)
+			{
+				const Slot &slot = slots[i];
+				if (slot.pinned || (slot.page == UINT32_MAX) || pageLoading[slot.page] || (slot.lastUsed + keepFrames >= frame))
+				{
+					continue;
+				}
+				if ((victim == UINT32_MAX) || (slot.lastUsed < slots[victim].lastUsed))
+				{
+					victim = i;
+				}
+			}
+			if (victim != UINT32_MAX)
+			{
+				// Its descendants fall back to the parent's entry, which is resident or falls back further itself
+				const uint32_t page = slots[victim].page;
+				pageSlots[page] = UINT32_MAX;
+				slots[victim].page = UINT32_MAX;
+				updateEntries(page, table[getParent(page)]);
+			}
+			return victim;
+		}
+
+	public:
+		/**
+		* @param slotCount Number of pages the physical cache holds
+		* @param keepFrames Frames a page stays resident after it was last wanted before its slot may be replaced
+		*/
+		VirtualTexture(uint32_t slotCount, uint32_t keepFrames = 8) : keepFrames(keepFrames)
+		{
+			assert(slotCount <= 0xFFFF);
+			slots.resize(slotCount);
+			for (uint32_t i = slotCount; i > 0; i--)
+			{
+				freeSlots.push_back(i - 1);
+			}
+		}
+
+		/**
+		* Add the pages of a texture, the slots of its last level are assigned right away (see getPinnedPages)
+		*
+		* @param width Width of the texture's first level
+		* @param height Height of the texture's first level
+		* @param mipLevels Number of levels available, the levels below the first one fitting into a single page are not paged
+		*
+		* @return Index of the texture, UINT32_MAX if its last level doesn't fit into the free slots
+		*/
+		uint32_t addTexture(uint32_t width, uint32_t height, uint32_t mipLevels)
+		{
+			TextureInfo info;
+			info.firstPage = static_cast<uint32_t>(pages.size());
+			info.width = width;
+			info.height = height;
+			info.levelCount = 1;
+			while ((info.levelCount < mipLevels) && ((levelDim(width, info.levelCount - 1) > PAGE_SIZE) || (levelDim(height, info.levelCount - 1) > PAGE_SIZE)))
+			{
+				info.levelCount++;
+			}
+			const uint32_t lastLevel = info.levelCount - 1;
+			if (pageCount(width, lastLevel) * pageCount(height, lastLevel) > freeSlots.size())
+			{
+				return UINT32_MAX;
+			}
+
+			const uint32_t texture = static_cast<uint32_t>(textures.size());
+			textures.push_back(info);
+			for (uint32_t level = 0; level < info.levelCount; level++)
+			{
+				for (uint32_t y = 0; y < pageCount(height, level); y++)
+				{
+					for (uint32_t x = 0; x < pageCount(width, level); x++)
+					{
+						pages.push_back({ texture, level, x, y });
+					}
+				}
+			}
+			pageSlots.resize(pages.size(), UINT32_MAX);
+			pageLoading.resize(pages.size(), false);
+			table.resize(pages.size(), UINT32_MAX);
+
+			for (uint32_t y = 0; y < pageCount(height, lastLevel); y++)
+			{
+				for (uint32_t x = 0; x < pageCount(width, lastLevel); x++)
+				{
+					const uint32_t page = getPageIndex(texture, lastLevel, x, y);
+					const uint32_t slot = acquireSlot();
+					slots[slot].page = page;
+					slots[slot].pinned = true;
+					pageSlots[page] = slot;
+					pinnedPages.push_back({ page, slot });
+					updateEntries(page, UINT32_MAX);
+				}
+			}
+			return texture;
+		}
+
+		/**
+		* Mark the pages wanted by a frame and its resident ancestors as used and collect the missing ones
+		* Of each missing page the coarsest missing ancestor is loaded first, so the page table is refined one level at a time
+		*
+		* @param feedback One bit per page, set for the pages that were sampled
+		*/
+		void processFeedback(const uint32_t *feedback)
+		{
+			frame++;
+			wanted.clear();
+			const uint32_t wordCount = getFeedbackWords();
+			for (uint32_t word = 0; word < wordCount; word++)
+			{
+				uint32_t bits = feedback[word];
+				while (bits != 0)
+				{
+					uint32_t bit = 0;
+					while (!(bits & (1u << bit)))
+					{
+						bit++;
+					}
+					bits &= ~(1u << bit);
+					const uint32_t index = word * 32 + bit;
+					if (index >= pages.size())
+					{
+						break;
+					}
+					uint32_t missing = UINT32_MAX;
+					for (uint32_t page = index; page != UINT32_MAX; page = getParent(page))
+					{
+						if (pageSlots[page] == UINT32_MAX)
+						{
+							missing = page;
+						}
+						else
+						{
+							slots[pageSlots[page]].lastUsed = frame;
+						}
+					}
+					if (missing != UINT32_MAX)
+					{
+						wanted.push_back(missing);
+					}
+				}
+			}
+			// Coarse levels first
+			std::sort(wanted.begin(), wanted.end(), [this](uint32_t a, uint32_t b) {
+				return (pages[a].level != pages[b].level) ? (pages[a].level > pages[b].level) : (a < b);
+			});
+			wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+		}
+
+		/**
+		* Assign slots to the missing pages of the last feedback, the pages are used once their data is committed
+		*
+		* @param maxCount Maximum number of pages to load
+		* @param requests Pages to load and their slots are appended to this list
+		*/
+		void getRequests(uint32_t maxCount, std::vector<Request> &requests)
+		{
+			for (uint32_t i = 0; (i < wanted.size()) && (maxCount > 0); i++)
+			{
+				const uint32_t page = wanted[i];
+				const uint32_t slot = acquireSlot();
+				if (slot == UINT32_MAX)
+				{
+					break;
+				}
+				slots[slot].page = page;
+				slots[slot].lastUsed = frame;
+				pageSlots[page] = slot;
+				pageLoading[page] = true;
+				requests.push_back({ page, slot });
+				maxCount--;
+			}
+			wanted.clear();
+		}
+
+		/** @brief Use a requested page, its data must be in its slot before the page table is used the next time */
+		void commit(uint32_t page)
+		{
+			assert(pageLoading[page]);
+			pageLoading[page] = false;
+			const uint32_t parent = getParent(page);
+			updateEntries(page, table[parent]);
+		}
+
+		/** @brief Slots of the textures' last levels, their data must be loaded before the page table is used */
+		const std::vector<Request>& getPinnedPages() const
+		{
+			return pinnedPages;
+		}
+
+		const Page& getPage(uint32_t index) const
+		{
+			return pages[index];
+		}
+
+		uint32_t getPageCount() const
+		{
+			return static_cast<uint32_t>(pages.size());
+		}
+
+		/** @brief Number of 32 bit words of the feedback bits */
+		uint32_t getFeedbackWords() const
+		{
+			return (static_cast<uint32_t>(pages.size()) + 31) / 32;
+		}
+
+		const std::vector<TextureInfo>& getTextures() const
+		{
+			return textures;
+		}
+
+		const std::vector<uint32_t>& getTable() const
+		{
+			return table;
+		}
+
+		/** @brief True if the page table has changed since the last call */
+		bool tableChanged()
+		{
+			const bool changed = tableDirty;
+			tableDirty = false;
+			return changed;
+		}
+
+		uint32_t getSlotCount() const
+		{
+			return static_cast<uint32_t>(slots.size());
+		}
+
+		/** @brief Slots holding a page or waiting for one */
+		uint32_t getUsedSlotCount() const
+		{
+			return static_cast<uint32_t>(slots.size() - freeSlots.size());
+		}
+	};
+
+	/**
+	* @brief Tiled page file of a virtual texture, the pages are stored in the order of VirtualTexture's pages
+	*
+	* Pages are stored as 4 x 4 texel blocks of a block compressed format, including their border
+	*/
+	class VirtualTextureFile
+	{
+	private:
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			// Hash of the textures the file has been cooked from
+			uint64_t hash;
+			uint32_t pageSize;
+			uint32_t pageBorder;
+			uint32_t blockSize;
+			uint32_t pageCount;
+		};
+
+		static const uint32_t MAGIC = 0x46505456;
+		static const uint32_t VERSION = 1;
+
+		MappedFile file;
+		const uint8_t *pageData = nullptr;
+		size_t pageBytes = 0;
+
+		// Blocks along each edge of a page including its border
+		static const uint32_t SLOT_BLOCKS = VirtualTexture::SLOT_SIZE / 4;
+
+	public:
+		static size_t getPageBytes(uint32_t blockSize)
+		{
+			return static_cast<size_t>(SLOT_BLOCKS) * SLOT_BLOCKS * blockSize;
+		}
+
+		/**
+		* Map a page file
+		*
+		* @return False if the file doesn't exist or doesn't match the hash and page layout, it needs to be cooked again then
+		*/
+		bool open(const std::string &filename, uint64_t hash, uint32_t pageCount, uint32_t blockSize)
+		{
+			close();
+			if (!file.open(filename))
+			{
+				return false;
+			}
+			Header header;
+			pageBytes = getPageBytes(blockSize);
+			if (file.getSize() < sizeof(Header))
+			{
+				close();
+				return false;
+			}
+			memcpy(&header, file.data(), sizeof(Header));
+			const bool valid = (header.magic == MAGIC) && (header.version == VERSION) && (header.hash == hash) &&
+				(header.pageSize == VirtualTexture::PAGE_SIZE) && (header.pageBorder == VirtualTexture::PAGE_BORDER) && (header.blockSize == blockSize) &&
+				(header.pageCount == pageCount) && (file.getSize() == sizeof(Header) + pageCount * pageBytes);
+			if (!valid)
+			{
+				close();
+				return false;
+			}
+			pageData = static_cast<const uint8_t*>(file.data()) + sizeof(Header);
+			return true;
+		}
+
+		void close()
+		{
+			file.close();
+			pageData = nullptr;
+		}
+
+		/** @brief Blocks of a page in row order, reading them faults the page in from disk */
+		const uint8_t* getPage(uint32_t page) const
+		{
+			assert(pageData);
+			return pageData + page * pageBytes;
+		}
+
+		/**
+		* Cook the pages of all textures into a page file
+		*
+		* @param layout Pages to store
+		* @param textures Levels of each texture of the layout, in the block compressed format
+		* @param blockSize Bytes per 4 x 4 texel block
+		*
+		* @return False if the file couldn't be written
+		*/
+		static bool write(const std::string &filename, uint64_t hash, const VirtualTexture &layout, const std::vector<const TextureFile*> &textures, uint32_t blockSize)
+		{
+			FILE *file = fopen(filename.c_str(), "wb");
+			if (!file)
+			{
+				return false;
+			}
+			Header header = { MAGIC, VERSION, hash, VirtualTexture::PAGE_SIZE, VirtualTexture::PAGE_BORDER, blockSize, layout.getPageCount() };
+			bool written = (fwrite(&header, sizeof(Header), 1, file) == 1);
+
+			std::vector<uint8_t> page(getPageBytes(blockSize));
+			for (uint32_t i = 0; (i < layout.getPageCount()) && written; i++)
+			{
+				const VirtualTexture::Page &info = layout.getPage(i);
+				const TextureFile::Level &level = textures[info.texture]->getLevels()[info.level];
+				const int32_t blocksX = static_cast<int32_t>((level.width + 3) / 4);
+				const int32_t blocksY = static_cast<int32_t>((level.height + 3) / 4);
+				// The border wraps around the level's edges like repeat addressing, levels smaller than a page repeat within it
+				for (int32_t y = 0; y < static_cast<int32_t>(SLOT_BLOCKS); y++)
+				{
+					int32_t srcY = static_cast<int32_t>(info.y * (VirtualTexture::PAGE_SIZE / 4)) + y - static_cast<int32_t>(VirtualTexture::PAGE_BORDER / 4);
+					srcY = ((srcY % blocksY) + blocksY) % blocksY;
+					for (int32_t x = 0; x < static_cast<int32_t>(SLOT_BLOCKS); x++)
+					{
+						int32_t srcX = static_cast<int32_t>(info.x * (VirtualTexture::PAGE_SIZE / 4)) + x - static_cast<int32_t>(VirtualTexture::PAGE_BORDER / 4);
+						srcX = ((srcX % blocksX) + blocksX) % blocksX;
+						memcpy(&page[(y * SLOT_BLOCKS + x) * blockSize], level.data + (srcY * blocksX + srcX) * blockSize, blockSize);
+					}
+				}
+				written = (fwrite(page.data(), page.size(), 1, file) == 1);
+			}
+			written = (fclose(file) == 0) && written;
+			if (!written)
+			{
+				// Don't leave a truncated file behind, it would fail the size check anyway
+				remove(filename.c_str());
+			}
+			return written;
+		}
+	};
+}
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <vector>
 #include <map>
+#include <type_traits>
 #ifdef _WIN32
 #include <windows.h>
 #include <fcntl.h>
@@ -34,6 +35,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "vulkandevice.hpp"
+#include "assetfile.hpp"
 
 #if defined(__ANDROID__)
 #include <android/asset_manager.h>
@@ -56,6 +58,8 @@ namespace vkMeshLoader
 	{
 		VkBuffer buf = VK_NULL_HANDLE;
 		VkDeviceMemory mem = VK_NULL_HANDLE;
+		/** @brief Range of mem used by the buffer if it was sub-allocated */
+		vk::Allocation allocation;
 		size_t size = 0;
 	};
 
@@ -85,6 +89,33 @@ namespace vkMeshLoader
 		glm::vec2 uvscale;
 	};
 
+	/**
+	* Get the number of floats a vertex layout component occupies
+	*/
+	static inline constexpr uint32_t componentSize(VertexLayout component)
+	{
+		// UV only has two components
+		return (component == VERTEX_LAYOUT_UV) ? 2 : (component == VERTEX_LAYOUT_DUMMY_FLOAT) ? 1 : (component == VERTEX_LAYOUT_DUMMY_VEC4) ? 4 : 3;
+	}
+
+	/**
+	* Get the attribute format of a vertex layout component
+	*/
+	static inline VkFormat componentFormat(VertexLayout component)
+	{
+		switch (componentSize(component))
+		{
+		case 1:
+			return VK_FORMAT_R32_SFLOAT;
+		case 2:
+			return VK_FORMAT_R32G32_SFLOAT;
+		case 4:
+			return VK_FORMAT_R32G32B32A32_SFLOAT;
+		default:
+			return VK_FORMAT_R32G32B32_SFLOAT;
+		}
+	}
+
 	/** 
 	* Get the size of a vertex layout	
 	* 
@@ -92,25 +123,16 @@ namespace vkMeshLoader
 	*
 	* @return Size of the vertex layout in bytes
 	*/
-	static uint32_t vertexSize(std::vector<vkMeshLoader::VertexLayout> layout)
+	static uint32_t vertexSize(const std::vector<vkMeshLoader::VertexLayout> &layout)
 	{
 		uint32_t vSize = 0;
 		for (auto& layoutDetail : layout)
 		{
-			switch (layoutDetail)
-			{
-			// UV only has two components
-			case VERTEX_LAYOUT_UV: 
-				vSize += 2 * sizeof(float);
-				break;
-			default:
-				vSize += 3 * sizeof(float);
-			}
+			vSize += componentSize(layoutDetail) * sizeof(float);
 		}
 		return vSize;
 	}
 
-	// Note: Always assumes float formats
 	/**
 	* Generate vertex attribute descriptions for a layout at the given binding point
 	*
@@ -120,7 +142,7 @@ namespace vkMeshLoader
 	*
 	* @note Always assumes float formats
 	*/
-	static void getVertexInputAttributeDescriptions(std::vector<vkMeshLoader::VertexLayout> layout, std::vector<VkVertexInputAttributeDescription> &attributeDescriptions, uint32_t binding)
+	static void getVertexInputAttributeDescriptions(const std::vector<vkMeshLoader::VertexLayout> &layout, std::vector<VkVertexInputAttributeDescription> &attributeDescriptions, uint32_t binding)
 	{
 		uint32_t offset = 0;
 		uint32_t location = 0;
@@ -130,23 +152,47 @@ namespace vkMeshLoader
 			inputAttribDescription.binding = binding;
 			inputAttribDescription.location = location;
 			inputAttribDescription.offset = offset;
-
-			switch (layoutDetail)
-			{
-			// UV only has two components
-			case VERTEX_LAYOUT_UV:
-				offset += 2 * sizeof(float);
-				inputAttribDescription.format = VK_FORMAT_R32G32_SFLOAT;
-				break;
-			default:
-				offset += 3 * sizeof(float);
-				inputAttribDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-			}
+			inputAttribDescription.format = componentFormat(layoutDetail);
+			offset += componentSize(layoutDetail) * sizeof(float);
 			attributeDescriptions.push_back(inputAttribDescription);
 			location++;
 		}
 	}
 
+	template <VertexLayout... Components>
+	struct VertexFormatSize;
+
+	template <>
+	struct VertexFormatSize<>
+	{
+		static const uint32_t value = 0;
+	};
+
+	template <VertexLayout First, VertexLayout... Rest>
+	struct VertexFormatSize<First, Rest...>
+	{
+		static const uint32_t value = componentSize(First) * sizeof(float) + VertexFormatSize<Rest...>::value;
+	};
+
+	/**
+	* @brief Vertex layout known at compile time
+	*
+	* Mesh buffers created with a vertex format are filled by an interleave writer generated for the format,
+	* instead of branching on the layout for every component of every vertex
+	*/
+	template <VertexLayout... Components>
+	struct VertexFormat
+	{
+		/** @brief Size of a vertex in bytes */
+		static const uint32_t size = VertexFormatSize<Components...>::value;
+
+		/** @brief Layout of the format, e.g. to generate the vertex input attribute descriptions */
+		static std::vector<VertexLayout> layout()
+		{
+			return { Components... };
+		}
+	};
+
 	// Stores some additonal info and functions for 
 	// specifying pipelines, vertex bindings, etc.
 	class Mesh
@@ -164,7 +210,7 @@ namespace vkMeshLoader
 		VkVertexInputBindingDescription bindingDescription;
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 
-		void setupVertexInputState(std::vector<vkMeshLoader::VertexLayout> layout)
+		void setupVertexInputState(const std::vector<vkMeshLoader::VertexLayout> &layout)
 		{
 			bindingDescription = vkTools::initializers::vertexInputBindingDescription(
 				vertexBufferBinding,
@@ -172,24 +218,7 @@ namespace vkMeshLoader
 				VK_VERTEX_INPUT_RATE_VERTEX);
 
 			attributeDescriptions.clear();
-			uint32_t offset = 0;
-			uint32_t binding = 0;
-			for (auto& layoutDetail : layout)
-			{
-				// Format (layout)
-				VkFormat format = (layoutDetail == VERTEX_LAYOUT_UV) ? VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R32G32B32_SFLOAT;
-
-				attributeDescriptions.push_back(
-					vkTools::initializers::vertexInputAttributeDescription(
-						vertexBufferBinding,
-						binding,
-						format,
-						offset));
-
-				// Offset
-				offset += (layoutDetail == VERTEX_LAYOUT_UV) ? (2 * sizeof(float)) : (3 * sizeof(float));
-				binding++;
-			}
+			getVertexInputAttributeDescriptions(layout, attributeDescriptions, vertexBufferBinding);
 
 			vertexInputState = vkTools::initializers::pipelineVertexInputStateCreateInfo();
 			vertexInputState.vertexBindingDescriptionCount = 1;
@@ -215,14 +244,25 @@ namespace vkMeshLoader
 		}
 	};
 
+	static void freeMeshBufferInfo(VkDevice device, vkMeshLoader::MeshBufferInfo *bufferInfo)
+	{
+		vkDestroyBuffer(device, bufferInfo->buf, nullptr);
+		if (bufferInfo->allocation.allocator)
+		{
+			bufferInfo->allocation.allocator->free(bufferInfo->allocation);
+		}
+		else
+		{
+			vkFreeMemory(device, bufferInfo->mem, nullptr);
+		}
+	}
+
 	static void freeMeshBufferResources(VkDevice device, vkMeshLoader::MeshBuffer *meshBuffer)
 	{
-		vkDestroyBuffer(device, meshBuffer->vertices.buf, nullptr);
-		vkFreeMemory(device, meshBuffer->vertices.mem, nullptr);
+		freeMeshBufferInfo(device, &meshBuffer->vertices);
 		if (meshBuffer->indices.buf != VK_NULL_HANDLE)
 		{
-			vkDestroyBuffer(device, meshBuffer->indices.buf, nullptr);
-			vkFreeMemory(device, meshBuffer->indices.mem, nullptr);
+			freeMeshBufferInfo(device, &meshBuffer->indices);
 		}
 	}
 }
@@ -265,6 +305,109 @@ private:
 		std::vector<unsigned int> Indices;
 	};
 
+	template <vkMeshLoader::VertexLayout component>
+	using Component = std::integral_constant<vkMeshLoader::VertexLayout, component>;
+
+	// Interleave writers for the vertex layout components, return the position behind the written component
+
+	static float* writeComponent(float *dst, const Vertex &vertex, const vkMeshLoader::MeshCreateInfo &transform, Component<vkMeshLoader::VERTEX_LAYOUT_POSITION>)
+	{
+		dst[0] = vertex.m_pos.x * transform.scale.x + transform.center.x;
+		dst[1] = vertex.m_pos.y * transform.scale.y + transform.center.y;
+		dst[2] = vertex.m_pos.z * transform.scale.z + transform.center.z;
+		return dst + 3;
+	}
+
+	static float* writeComponent(float *dst, const Vertex &vertex, const vkMeshLoader::MeshCreateInfo &, Component<vkMeshLoader::VERTEX_LAYOUT_NORMAL>)
+	{
+		dst[0] = vertex.m_normal.x;
+		dst[1] = -vertex.m_normal.y;
+		dst[2] = vertex.m_normal.z;
+		return dst + 3;
+	}
+
+	static float* writeComponent(float *dst, const Vertex &vertex, const vkMeshLoader::MeshCreateInfo &transform, Component<vkMeshLoader::VERTEX_LAYOUT_UV>)
+	{
+		dst[0] = vertex.m_tex.s * transform.uvscale.s;
+		dst[1] = vertex.m_tex.t * transform.uvscale.t;
+		return dst + 2;
+	}
+
+	static float* writeComponent(float *dst, const Vertex &vertex, const vkMeshLoader::MeshCreateInfo &, Component<vkMeshLoader::VERTEX_LAYOUT_COLOR>)
+	{
+		dst[0] = vertex.m_color.r;
+		dst[1] = vertex.m_color.g;
+		dst[2] = vertex.m_color.b;
+		return dst + 3;
+	}
+
+	static float* writeComponent(float *dst, const Vertex &vertex, const vkMeshLoader::MeshCreateInfo &, Component<vkMeshLoader::VERTEX_LAYOUT_TANGENT>)
+	{
+		dst[0] = vertex.m_tangent.x;
+		dst[1] = vertex.m_tangent.y;
+		dst[2] = vertex.m_tangent.z;
+		return dst + 3;
+	}
+
+	static float* writeComponent(float *dst, const Vertex &vertex, const vkMeshLoader::MeshCreateInfo &, Component<vkMeshLoader::VERTEX_LAYOUT_BITANGENT>)
+	{
+		dst[0] = vertex.m_binormal.x;
+		dst[1] = vertex.m_binormal.y;
+		dst[2] = vertex.m_binormal.z;
+		return dst + 3;
+	}
+
+	// Dummy layout components for padding
+	static float* writeComponent(float *dst, const Vertex &, const vkMeshLoader::MeshCreateInfo &, Component<vkMeshLoader::VERTEX_LAYOUT_DUMMY_FLOAT>)
+	{
+		dst[0] = 0.0f;
+		return dst + 1;
+	}
+
+	static float* writeComponent(float *dst, const Vertex &, const vkMeshLoader::MeshCreateInfo &, Component<vkMeshLoader::VERTEX_LAYOUT_DUMMY_VEC4>)
+	{
+		dst[0] = dst[1] = dst[2] = dst[3] = 0.0f;
+		return dst + 4;
+	}
+
+	// Component only known at runtime
+	static float* writeComponent(float *dst, const Vertex &vertex, const vkMeshLoader::MeshCreateInfo &transform, vkMeshLoader::VertexLayout component)
+	{
+		switch (component)
+		{
+		case vkMeshLoader::VERTEX_LAYOUT_POSITION:
+			return writeComponent(dst, vertex, transform, Component<vkMeshLoader::VERTEX_LAYOUT_POSITION>());
+		case vkMeshLoader::VERTEX_LAYOUT_NORMAL:
+			return writeComponent(dst, vertex, transform, Component<vkMeshLoader::VERTEX_LAYOUT_NORMAL>());
+		case vkMeshLoader::VERTEX_LAYOUT_COLOR:
+			return writeComponent(dst, vertex, transform, Component<vkMeshLoader::VERTEX_LAYOUT_COLOR>());
+		case vkMeshLoader::VERTEX_LAYOUT_UV:
+			return writeComponent(dst, vertex, transform, Component<vkMeshLoader::VERTEX_LAYOUT_UV>());
+		case vkMeshLoader::VERTEX_LAYOUT_TANGENT:
+			return writeComponent(dst, vertex, transform, Component<vkMeshLoader::VERTEX_LAYOUT_TANGENT>());
+		case vkMeshLoader::VERTEX_LAYOUT_BITANGENT:
+			return writeComponent(dst, vertex, transform, Component<vkMeshLoader::VERTEX_LAYOUT_BITANGENT>());
+		case vkMeshLoader::VERTEX_LAYOUT_DUMMY_FLOAT:
+			return writeComponent(dst, vertex, transform, Component<vkMeshLoader::VERTEX_LAYOUT_DUMMY_FLOAT>());
+		case vkMeshLoader::VERTEX_LAYOUT_DUMMY_VEC4:
+			return writeComponent(dst, vertex, transform, Component<vkMeshLoader::VERTEX_LAYOUT_DUMMY_VEC4>());
+		}
+		return dst;
+	}
+
+	// Interleave writer of a compile time vertex format, unrolled over the format's components
+	static float* writeVertex(float *dst, const Vertex &, const vkMeshLoader::MeshCreateInfo &, vkMeshLoader::VertexFormat<>)
+	{
+		return dst;
+	}
+
+	template <vkMeshLoader::VertexLayout First, vkMeshLoader::VertexLayout... Rest>
+	static float* writeVertex(float *dst, const Vertex &vertex, const vkMeshLoader::MeshCreateInfo &transform, vkMeshLoader::VertexFormat<First, Rest...>)
+	{
+		dst = writeComponent(dst, vertex, transform, Component<First>());
+		return writeVertex(dst, vertex, transform, vkMeshLoader::VertexFormat<Rest...>());
+	}
+
 public:
 #if defined(__ANDROID__)
 	AAssetManager* assetManager = nullptr;
@@ -316,22 +459,11 @@ public:
 	bool LoadMesh(const std::string& filename, int flags = defaultFlags)
 	{
 #if defined(__ANDROID__)
-		// Meshes are stored inside the apk on Android (compressed)
-		// So they need to be loaded via the asset manager
-
-		AAsset* asset = AAssetManager_open(assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-		assert(asset);
-		size_t size = AAsset_getLength(asset);
-
-		assert(size > 0);
-		
-		void *meshData = malloc(size);
-		AAsset_read(asset, meshData, size);
-		AAsset_close(asset);
-
-		pScene = Importer.ReadFileFromMemory(meshData, size, flags);
-
-		free(meshData);
+		// Meshes are stored inside the apk on Android and imported from the asset's buffer
+		vkTools::AssetFile file(assetManager);
+		bool opened = file.open(filename);
+		assert(opened);
+		pScene = Importer.ReadFileFromMemory(file.data(), file.getSize(), flags);
 #else
 		pScene = Importer.ReadFile(filename.c_str(), flags);
 #endif
@@ -432,142 +564,142 @@ public:
 	*/
 	void createBuffers(
 		vkMeshLoader::MeshBuffer *meshBuffer,
-		std::vector<vkMeshLoader::VertexLayout> layout,
+		const std::vector<vkMeshLoader::VertexLayout> &layout,
 		vkMeshLoader::MeshCreateInfo *createInfo,
 		bool useStaging,
 		VkCommandBuffer copyCmd,
 		VkQueue copyQueue)
 	{
-		glm::vec3 scale;
-		glm::vec2 uvscale;
-		glm::vec3 center;
+		createBuffers(meshBuffer, vkMeshLoader::vertexSize(layout), [&layout](float *dst, const Vertex &vertex, const vkMeshLoader::MeshCreateInfo &transform) -> float*
+		{
+			for (auto component : layout)
+			{
+				dst = writeComponent(dst, vertex, transform, component);
+			}
+			return dst;
+		}, createInfo, useStaging, copyCmd, copyQueue);
+	}
+
+	/**
+	* Create Vulkan buffers for the index and vertex buffer using a vertex format known at compile time
+	*
+	* @note See above for the parameters, the vertices are written by the format's interleave writer
+	*/
+	template <vkMeshLoader::VertexLayout... Components>
+	void createBuffers(
+		vkMeshLoader::MeshBuffer *meshBuffer,
+		vkMeshLoader::VertexFormat<Components...> format,
+		vkMeshLoader::MeshCreateInfo *createInfo,
+		bool useStaging,
+		VkCommandBuffer copyCmd,
+		VkQueue copyQueue)
+	{
+		createBuffers(meshBuffer, format.size, [](float *dst, const Vertex &vertex, const vkMeshLoader::MeshCreateInfo &transform) -> float*
+		{
+			return writeVertex(dst, vertex, transform, vkMeshLoader::VertexFormat<Components...>());
+		}, createInfo, useStaging, copyCmd, copyQueue);
+	}
+
+private:
+	// Vertices and indices are written straight into the mapped memory of the staging (or host visible target) buffers, which are sized up front
+	template <typename VertexWriter>
+	void createBuffers(
+		vkMeshLoader::MeshBuffer *meshBuffer,
+		uint32_t vertexSize,
+		VertexWriter writeVertex,
+		vkMeshLoader::MeshCreateInfo *createInfo,
+		bool useStaging,
+		VkCommandBuffer copyCmd,
+		VkQueue copyQueue)
+	{
+		vkMeshLoader::MeshCreateInfo transform;
 		if (createInfo == nullptr)
 		{
-			scale = glm::vec3(1.0f);
-			uvscale = glm::vec2(1.0f);
-			center = glm::vec3(0.0f);
+			transform.scale = glm::vec3(1.0f);
+			transform.uvscale = glm::vec2(1.0f);
+			transform.center = glm::vec3(0.0f);
 		}
 		else
 		{
-			scale = createInfo->scale;
-			uvscale = createInfo->uvscale;
-			center = createInfo->center;
+			transform = *createInfo;
 		}
 
-		std::vector<float> vertexBuffer;
-		for (int m = 0; m < m_Entries.size(); m++)
+		size_t vertexCount = 0;
+		size_t indexCount = 0;
+		for (auto& entry : m_Entries)
 		{
-			for (int i = 0; i < m_Entries[m].Vertices.size(); i++)
-			{
-				// Push vertex data depending on layout
-				for (auto& layoutDetail : layout)
-				{
-					// Position
-					if (layoutDetail == vkMeshLoader::VERTEX_LAYOUT_POSITION)
-					{
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_pos.x * scale.x + center.x);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_pos.y * scale.y + center.y);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_pos.z * scale.z + center.z);
-					}
-					// Normal
-					if (layoutDetail == vkMeshLoader::VERTEX_LAYOUT_NORMAL)
-					{
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_normal.x);
-						vertexBuffer.push_back(-m_Entries[m].Vertices[i].m_normal.y);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_normal.z);
-					}
-					// Texture coordinates
-					if (layoutDetail == vkMeshLoader::VERTEX_LAYOUT_UV)
-					{
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_tex.s * uvscale.s);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_tex.t * uvscale.t);
-					}
-					// Color
-					if (layoutDetail == vkMeshLoader::VERTEX_LAYOUT_COLOR)
-					{
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_color.r);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_color.g);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_color.b);
-					}
-					// Tangent
-					if (layoutDetail == vkMeshLoader::VERTEX_LAYOUT_TANGENT)
-					{
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_tangent.x);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_tangent.y);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_tangent.z);
-					}
-					// Bitangent
-					if (layoutDetail == vkMeshLoader::VERTEX_LAYOUT_BITANGENT)
-					{
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_binormal.x);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_binormal.y);
-						vertexBuffer.push_back(m_Entries[m].Vertices[i].m_binormal.z);
-					}
-					// Dummy layout components for padding
-					if (layoutDetail == vkMeshLoader::VERTEX_LAYOUT_DUMMY_FLOAT)
-					{
-						vertexBuffer.push_back(0.0f);
-					}
-					if (layoutDetail == vkMeshLoader::VERTEX_LAYOUT_DUMMY_VEC4)
-					{
-						vertexBuffer.push_back(0.0f);
-						vertexBuffer.push_back(0.0f);
-						vertexBuffer.push_back(0.0f);
-						vertexBuffer.push_back(0.0f);
-					}
-				}
-			}
+			vertexCount += entry.Vertices.size();
+			indexCount += entry.Indices.size();
 		}
-		meshBuffer->vertices.size = vertexBuffer.size() * sizeof(float);
+		meshBuffer->vertices.size = vertexCount * vertexSize;
+		meshBuffer->indices.size = indexCount * sizeof(uint32_t);
+		meshBuffer->indexCount = static_cast<uint32_t>(indexCount);
 
-		dim.min *= scale;
-		dim.max *= scale;
-		dim.size *= scale;
+		dim.min *= transform.scale;
+		dim.max *= transform.scale;
+		dim.size *= transform.scale;
 
-		std::vector<uint32_t> indexBuffer;
-		for (uint32_t m = 0; m < m_Entries.size(); m++)
+		const bool staging = useStaging && copyQueue != VK_NULL_HANDLE && copyCmd != VK_NULL_HANDLE;
+
+		// Vertices and indices share one staging buffer from the device's pool, the vertex size keeps the indices aligned
+		vk::Buffer stagingBuffer;
+		const VkDeviceSize indexStagingOffset = meshBuffer->vertices.size;
+
+		if (staging)
 		{
-			uint32_t indexBase = static_cast<uint32_t>(indexBuffer.size());
-			for (uint32_t i = 0; i < m_Entries[m].Indices.size(); i++)
-			{
-				indexBuffer.push_back(m_Entries[m].Indices[i] + indexBase);
-			}
-			vkMeshLoader::MeshDescriptor descriptor{};
-			descriptor.indexBase = indexBase;
-			descriptor.indexCount = static_cast<uint32_t>(m_Entries[m].Indices.size());
-			descriptor.vertexCount = static_cast<uint32_t>(m_Entries[m].Vertices.size());
-			meshBuffer->meshDescriptors.push_back(descriptor);
+			stagingBuffer = vulkanDevice->stagingPool->acquire(meshBuffer->vertices.size + meshBuffer->indices.size);
 		}
-		meshBuffer->indices.size = indexBuffer.size() * sizeof(uint32_t);
-		meshBuffer->indexCount = static_cast<uint32_t>(indexBuffer.size());
-
-		// Use staging buffer to move vertex and index buffer to device local memory
-		if (useStaging && copyQueue != VK_NULL_HANDLE && copyCmd != VK_NULL_HANDLE)
+		else
 		{
-			// Create staging buffers
-			struct {
-				VkBuffer buffer;
-				VkDeviceMemory memory;
-			} vertexStaging, indexStaging;
-
-			// Vertex buffer
+			// Generate vertex buffer
 			vulkanDevice->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
 				meshBuffer->vertices.size,
-				&vertexStaging.buffer,
-				&vertexStaging.memory,
-				vertexBuffer.data());
+				&meshBuffer->vertices.buf,
+				&meshBuffer->vertices.allocation);
 
-			// Index buffer
+			// Generate index buffer
 			vulkanDevice->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
 				meshBuffer->indices.size,
-				&indexStaging.buffer,
-				&indexStaging.memory,
-				indexBuffer.data());
+				&meshBuffer->indices.buf,
+				&meshBuffer->indices.allocation);
+		}
+
+		float *vertexData = static_cast<float*>(staging ? stagingBuffer.mapped : meshBuffer->vertices.allocation.mapped);
+		uint32_t *indexData = reinterpret_cast<uint32_t*>(staging ? static_cast<uint8_t*>(stagingBuffer.mapped) + indexStagingOffset : static_cast<uint8_t*>(meshBuffer->indices.allocation.mapped));
+		assert(vertexData && indexData);
 
+		const float *vertexEnd = reinterpret_cast<const float*>(reinterpret_cast<uint8_t*>(vertexData) + meshBuffer->vertices.size);
+		for (auto& entry : m_Entries)
+		{
+			for (auto& vertex : entry.Vertices)
+			{
+				vertexData = writeVertex(vertexData, vertex, transform);
+			}
+		}
+		assert(vertexData == vertexEnd);
+
+		uint32_t indexBase = 0;
+		for (auto& entry : m_Entries)
+		{
+			for (auto index : entry.Indices)
+			{
+				*indexData++ = index + indexBase;
+			}
+			vkMeshLoader::MeshDescriptor descriptor{};
+			descriptor.indexBase = indexBase;
+			descriptor.indexCount = static_cast<uint32_t>(entry.Indices.size());
+			descriptor.vertexCount = static_cast<uint32_t>(entry.Vertices.size());
+			meshBuffer->meshDescriptors.push_back(descriptor);
+			indexBase += descriptor.indexCount;
+		}
+
+		// Use staging buffer to move vertex and index buffer to device local memory
+		if (staging)
+		{
 			// Create device local target buffers
 			// Vertex buffer
 			vulkanDevice->createBuffer(
@@ -575,7 +707,7 @@ public:
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 				meshBuffer->vertices.size,
 				&meshBuffer->vertices.buf,
-				&meshBuffer->vertices.mem);
+				&meshBuffer->vertices.allocation);
 
 			// Index buffer
 			vulkanDevice->createBuffer(
@@ -583,9 +715,9 @@ public:
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 				meshBuffer->indices.size,
 				&meshBuffer->indices.buf,
-				&meshBuffer->indices.mem);
+				&meshBuffer->indices.allocation);
 
-			// Copy from staging buffers
+		// Copy from staging buffers
 			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
 			VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
 
@@ -594,15 +726,16 @@ public:
 			copyRegion.size = meshBuffer->vertices.size;
 			vkCmdCopyBuffer(
 				copyCmd,
-				vertexStaging.buffer,
+				stagingBuffer.buffer,
 				meshBuffer->vertices.buf,
 				1,
 				&copyRegion);
 
+			copyRegion.srcOffset = indexStagingOffset;
 			copyRegion.size = meshBuffer->indices.size;
 			vkCmdCopyBuffer(
 				copyCmd,
-				indexStaging.buffer,
+				stagingBuffer.buffer,
 				meshBuffer->indices.buf,
 				1,
 				&copyRegion);
@@ -614,33 +747,13 @@ public:
 			submitInfo.commandBufferCount = 1;
 			submitInfo.pCommandBuffers = &copyCmd;
 
-			VK_CHECK_RESULT(vkQueueSubmit(copyQueue, 1, &submitInfo, VK_NULL_HANDLE));
-			VK_CHECK_RESULT(vkQueueWaitIdle(copyQueue));
+			vk::QueueTimeline *timeline = vulkanDevice->getQueueTimeline(copyQueue);
+			VK_CHECK_RESULT(timeline->wait(timeline->submit(1, &submitInfo)));
 
-			vkDestroyBuffer(vulkanDevice->logicalDevice, vertexStaging.buffer, nullptr);
-			vkFreeMemory(vulkanDevice->logicalDevice, vertexStaging.memory, nullptr);
-			vkDestroyBuffer(vulkanDevice->logicalDevice, indexStaging.buffer, nullptr);
-			vkFreeMemory(vulkanDevice->logicalDevice, indexStaging.memory, nullptr);
+			vulkanDevice->stagingPool->release(stagingBuffer);
 		}
-		else
-		{
-			// Generate vertex buffer
-			vulkanDevice->createBuffer(
-				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				meshBuffer->vertices.size,
-				&meshBuffer->vertices.buf,
-				&meshBuffer->vertices.mem,
-				vertexBuffer.data());
 
-			// Generate index buffer
-			vulkanDevice->createBuffer(
-				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				meshBuffer->indices.size,
-				&meshBuffer->indices.buf,
-				&meshBuffer->indices.mem,
-				indexBuffer.data());
-		}
+		meshBuffer->vertices.mem = meshBuffer->vertices.allocation.memory;
+		meshBuffer->indices.mem = meshBuffer->indices.allocation.memory;
 	}
 };
\ No newline at end of file
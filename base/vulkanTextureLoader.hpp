@@ -12,6 +12,8 @@
 #include <gli/gli.hpp>
 
 #include "vulkandevice.hpp"
+#include "texturetranscoder.hpp"
+#include "texturefile.hpp"
 
 #if defined(__ANDROID__)
 #include <android/asset_manager.h>
@@ -28,6 +30,8 @@ namespace vkTools
 		VkImage image;
 		VkImageLayout imageLayout;
 		VkDeviceMemory deviceMemory;
+		/** @brief Range of deviceMemory used by the image if it was sub-allocated */
+		vk::Allocation allocation;
 		VkImageView view;
 		uint32_t width, height;
 		uint32_t mipLevels;
@@ -88,40 +92,40 @@ namespace vkTools
 		* Load a 2D texture including all mip levels
 		*
 		* @param filename File to load
-		* @param format Vulkan format of the image data stored in the file
+		* @param format Vulkan format of the image data stored in the file, block compressed formats the device doesn't support are decoded to RGBA8
 		* @param texture Pointer to the texture object to load the image into 
 		* @param (Optional) forceLinear Force linear tiling (not advised, defaults to false)
 		* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+		* @param (Optional) normalMap Only keep x and y of the normals, see TextureTranscoder::selectFormat (defaults to false)
 		*
 		* @note Only supports .ktx and .dds
 		*/
-		void loadTexture(std::string filename, VkFormat format, VulkanTexture *texture, bool forceLinear = false, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT)
+		void loadTexture(std::string filename, VkFormat format, VulkanTexture *texture, bool forceLinear = false, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT, bool normalMap = false)
 		{
+			// DDS levels are read from the mapped file without an intermediate copy
+			TextureFile file;
 #if defined(__ANDROID__)
-			assert(assetManager != nullptr);
-
-			// Textures are stored inside the apk on Android (compressed)
-			// So they need to be loaded via the asset manager
-			AAsset* asset = AAssetManager_open(assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-
-			void *textureData = malloc(size);
-			AAsset_read(asset, textureData, size);
-			AAsset_close(asset);
-
-			gli::texture2D tex2D(gli::load((const char*)textureData, size));
-
-			free(textureData);
-#else
-			gli::texture2D tex2D(gli::load(filename.c_str()));
-#endif		
-			assert(!tex2D.empty());
-
-			texture->width = static_cast<uint32_t>(tex2D[0].dimensions().x);
-			texture->height = static_cast<uint32_t>(tex2D[0].dimensions().y);
-			texture->mipLevels = static_cast<uint32_t>(tex2D.levels());
+			file.assetManager = assetManager;
+#endif
+			const bool loaded = file.load(filename);
+			assert(loaded);
+			const std::vector<TextureFile::Level> &levels = file.getLevels();
+
+			texture->width = levels[0].width;
+			texture->height = levels[0].height;
+			texture->mipLevels = static_cast<uint32_t>(levels.size());
+
+			// Block compressed data the device can't sample (and normal maps) is transcoded while it's copied to the staging buffer
+			const VkFormat fileFormat = format;
+			format = TextureTranscoder::selectFormat(vulkanDevice->physicalDevice, fileFormat, normalMap);
+			const bool transcode = (format != fileFormat);
+			std::vector<size_t> levelSizes;
+			size_t uploadSize = 0;
+			for (auto& level : levels)
+			{
+				levelSizes.push_back(transcode ? TextureTranscoder::getTranscodedSize(format, level.width, level.height) : level.size);
+				uploadSize += levelSizes.back();
+			}
 
 			// Get device properites for the requested texture format
 			VkFormatProperties formatProperties;
@@ -132,10 +136,17 @@ namespace vkTools
 			// optimal tiling instead
 			// On most implementations linear tiling will only support a very
 			// limited amount of formats and features (mip maps, cubemaps, arrays, etc.)
-			VkBool32 useStaging = !forceLinear;
-
-			VkMemoryAllocateInfo memAllocInfo = vkTools::initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
+			// Transcoded data is always uploaded via staging
+			VkBool32 useStaging = !forceLinear || transcode;
+
+			// Files that ship without mips get their chain generated with blits after the upload
+			// Block compressed formats don't support blitting into them, so this only applies to uncompressed data
+			const uint32_t fileLevels = static_cast<uint32_t>(levels.size());
+			const bool generateMips = useStaging && (fileLevels == 1) && vkTools::formatSupportsMipmapBlit(vulkanDevice->physicalDevice, format);
+			if (generateMips)
+			{
+				texture->mipLevels = vkTools::getMipLevelCount(texture->width, texture->height);
+			}
 
 			// Use a separate command buffer for texture loading
 			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
@@ -143,53 +154,41 @@ namespace vkTools
 
 			if (useStaging)
 			{
-				// Create a host-visible staging buffer that contains the raw image data
-				VkBuffer stagingBuffer;
-				VkDeviceMemory stagingMemory;
-
-				VkBufferCreateInfo bufferCreateInfo = vkTools::initializers::bufferCreateInfo();
-				bufferCreateInfo.size = tex2D.size();
-				// This buffer is used as a transfer source for the buffer copy
-				bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-				bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-				VK_CHECK_RESULT(vkCreateBuffer(vulkanDevice->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-				// Get memory requirements for the staging buffer (alignment, memory type bits)
-				vkGetBufferMemoryRequirements(vulkanDevice->logicalDevice, stagingBuffer, &memReqs);
-
-				memAllocInfo.allocationSize = memReqs.size;
-				// Get memory type index for a host visible buffer
-				memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-				VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-				VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-				// Copy texture data into staging buffer
-				uint8_t *data;
-				VK_CHECK_RESULT(vkMapMemory(vulkanDevice->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-				memcpy(data, tex2D.data(), tex2D.size());
-				vkUnmapMemory(vulkanDevice->logicalDevice, stagingMemory);
+				// Get a mapped staging buffer from the device's pool and copy (or decode) the levels straight into it
+				vk::Buffer stagingBuffer = vulkanDevice->stagingPool->acquire(uploadSize);
+				uint8_t *stagingData = static_cast<uint8_t*>(stagingBuffer.mapped);
+				for (uint32_t i = 0; i < fileLevels; i++)
+				{
+					if (transcode)
+					{
+						TextureTranscoder::transcode(fileFormat, format, levels[i].data, levels[i].width, levels[i].height, stagingData);
+					}
+					else
+					{
+						memcpy(stagingData, levels[i].data, levels[i].size);
+					}
+					stagingData += levelSizes[i];
+				}
 
 				// Setup buffer copy regions for each mip level
 				std::vector<VkBufferImageCopy> bufferCopyRegions;
 				uint32_t offset = 0;
 
-				for (uint32_t i = 0; i < texture->mipLevels; i++)
+				for (uint32_t i = 0; i < fileLevels; i++)
 				{
 					VkBufferImageCopy bufferCopyRegion = {};
 					bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 					bufferCopyRegion.imageSubresource.mipLevel = i;
 					bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
 					bufferCopyRegion.imageSubresource.layerCount = 1;
-					bufferCopyRegion.imageExtent.width = static_cast<uint32_t>(tex2D[i].dimensions().x);
-					bufferCopyRegion.imageExtent.height = static_cast<uint32_t>(tex2D[i].dimensions().y);
+					bufferCopyRegion.imageExtent.width = levels[i].width;
+					bufferCopyRegion.imageExtent.height = levels[i].height;
 					bufferCopyRegion.imageExtent.depth = 1;
 					bufferCopyRegion.bufferOffset = offset;
 
 					bufferCopyRegions.push_back(bufferCopyRegion);
 
-					offset += static_cast<uint32_t>(tex2D[i].size());
+					offset += static_cast<uint32_t>(levelSizes[i]);
 				}
 
 				// Create optimal tiled target image
@@ -209,20 +208,19 @@ namespace vkTools
 				{
 					imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 				}
+				if (generateMips)
+				{
+					imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+				}
 				VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageCreateInfo, nullptr, &texture->image));
 
-				vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, texture->image, &memReqs);
-
-				memAllocInfo.allocationSize = memReqs.size;
-
-				memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-				VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &texture->deviceMemory));
-				VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, texture->image, texture->deviceMemory, 0));
+				VK_CHECK_RESULT(vulkanDevice->allocateImageMemory(texture->image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->allocation));
+				texture->deviceMemory = texture->allocation.memory;
 
 				VkImageSubresourceRange subresourceRange = {};
 				subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 				subresourceRange.baseMipLevel = 0;
-				subresourceRange.levelCount = texture->mipLevels;
+				subresourceRange.levelCount = fileLevels;
 				subresourceRange.layerCount = 1;
 
 				// Image barrier for optimal image (target)
@@ -238,44 +236,43 @@ namespace vkTools
 				// Copy mip levels from staging buffer
 				vkCmdCopyBufferToImage(
 					cmdBuffer,
-					stagingBuffer,
+					stagingBuffer.buffer,
 					texture->image,
 					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 					static_cast<uint32_t>(bufferCopyRegions.size()),
 					bufferCopyRegions.data()
 					);
 
-				// Change texture image layout to shader read after all mip levels have been copied
+				// Change texture image layout to shader read after all mip levels have been copied (or generated)
 				texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				setImageLayout(
-					cmdBuffer,
-					texture->image,
-					VK_IMAGE_ASPECT_COLOR_BIT,
-					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-					texture->imageLayout,
-					subresourceRange);
+				if (generateMips)
+				{
+					vkTools::generateMipmaps(cmdBuffer, texture->image, texture->width, texture->height, texture->mipLevels, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture->imageLayout);
+				}
+				else
+				{
+					setImageLayout(
+						cmdBuffer,
+						texture->image,
+						VK_IMAGE_ASPECT_COLOR_BIT,
+						VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						texture->imageLayout,
+						subresourceRange);
+				}
 
 				// Submit command buffer containing copy and image layout commands
 				VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 
-				// Create a fence to make sure that the copies have finished before continuing
-				VkFence copyFence;
-				VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-				VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceCreateInfo, nullptr, &copyFence));
-
 				VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
 				submitInfo.commandBufferCount = 1;
 				submitInfo.pCommandBuffers = &cmdBuffer;
 
-				VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, copyFence));
-
-				VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->logicalDevice, 1, &copyFence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
-
-				vkDestroyFence(vulkanDevice->logicalDevice, copyFence, nullptr);
+				// Wait for the copies to finish on the queue's timeline before continuing
+				vk::QueueTimeline *timeline = vulkanDevice->getQueueTimeline(queue);
+				VK_CHECK_RESULT(timeline->wait(timeline->submit(1, &submitInfo), DEFAULT_FENCE_TIMEOUT));
 
-				// Clean up staging resources
-				vkFreeMemory(vulkanDevice->logicalDevice, stagingMemory, nullptr);
-				vkDestroyBuffer(vulkanDevice->logicalDevice, stagingBuffer, nullptr);
+				// The copies have finished, the staging buffer can be reused
+				vulkanDevice->stagingPool->release(stagingBuffer);
 			}
 			else
 			{
@@ -287,7 +284,6 @@ namespace vkTools
 				assert(formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 
 				VkImage mappableImage;
-				VkDeviceMemory mappableMemory;
 
 				VkImageCreateInfo imageCreateInfo = vkTools::initializers::imageCreateInfo();
 				imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -304,20 +300,8 @@ namespace vkTools
 				// Load mip map level 0 to linear tiling image
 				VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageCreateInfo, nullptr, &mappableImage));
 
-				// Get memory requirements for this image 
-				// like size and alignment
-				vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, mappableImage, &memReqs);
-				// Set memory allocation size to required memory size
-				memAllocInfo.allocationSize = memReqs.size;
-
-				// Get memory type that can be mapped to host memory
-				memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-				// Allocate host memory
-				VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &mappableMemory));
-
-				// Bind allocated image for use
-				VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, mappableImage, mappableMemory, 0));
+				// Allocate and bind memory that can be mapped to host memory
+				VK_CHECK_RESULT(vulkanDevice->allocateImageMemory(mappableImage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &texture->allocation, true));
 
 				// Get sub resource layout
 				// Mip map count, array layer, etc.
@@ -326,24 +310,19 @@ namespace vkTools
 				subRes.mipLevel = 0;
 
 				VkSubresourceLayout subResLayout;
-				void *data;
+				void *data = texture->allocation.mapped;
 
 				// Get sub resources layout 
 				// Includes row pitch, size offsets, etc.
 				vkGetImageSubresourceLayout(vulkanDevice->logicalDevice, mappableImage, &subRes, &subResLayout);
 
-				// Map image memory
-				VK_CHECK_RESULT(vkMapMemory(vulkanDevice->logicalDevice, mappableMemory, 0, memReqs.size, 0, &data));
-
-				// Copy image data into memory
-				memcpy(data, tex2D[subRes.mipLevel].data(), tex2D[subRes.mipLevel].size());
-
-				vkUnmapMemory(vulkanDevice->logicalDevice, mappableMemory);
+				// Copy image data into the persistently mapped memory
+				memcpy(data, levels[subRes.mipLevel].data, levels[subRes.mipLevel].size);
 
 				// Linear tiled images don't need to be staged
 				// and can be directly used as textures
 				texture->image = mappableImage;
-				texture->deviceMemory = mappableMemory;
+				texture->deviceMemory = texture->allocation.memory;
 				texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
 				// Setup image memory barrier
@@ -357,36 +336,17 @@ namespace vkTools
 				// Submit command buffer containing copy and image layout commands
 				VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 
-				VkFence nullFence = { VK_NULL_HANDLE };
-
 				VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
 				submitInfo.waitSemaphoreCount = 0;
 				submitInfo.commandBufferCount = 1;
 				submitInfo.pCommandBuffers = &cmdBuffer;
 
-				VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, nullFence));
-				VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+				vk::QueueTimeline *timeline = vulkanDevice->getQueueTimeline(queue);
+				VK_CHECK_RESULT(timeline->wait(timeline->submit(1, &submitInfo), DEFAULT_FENCE_TIMEOUT));
 			}
 
-			// Create sampler
-			VkSamplerCreateInfo sampler = {};
-			sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-			sampler.magFilter = VK_FILTER_LINEAR;
-			sampler.minFilter = VK_FILTER_LINEAR;
-			sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			sampler.mipLodBias = 0.0f;
-			sampler.compareOp = VK_COMPARE_OP_NEVER;
-			sampler.minLod = 0.0f;
-			// Max level-of-detail should match mip level count
-			sampler.maxLod = (useStaging) ? (float)texture->mipLevels : 0.0f;
-			// Enable anisotropic filtering
-			sampler.maxAnisotropy = 8;
-			sampler.anisotropyEnable = VK_TRUE;
-			sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &sampler, nullptr, &texture->sampler));
+			// Samplers are shared through the device's sampler cache, the image view limits the mip range
+			texture->sampler = vulkanDevice->samplerCache->get(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
 			
 			// Create image view
 			// Textures are not directly accessed by the shaders and
@@ -423,62 +383,24 @@ namespace vkTools
 		*/
 		void loadCubemap(std::string filename, VkFormat format, VulkanTexture *texture, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT)
 		{
+			// Decoded straight from the mapped file (or the apk's asset buffer on Android)
+			vkTools::AssetFile file;
 #if defined(__ANDROID__)
-			assert(assetManager != nullptr);
-
-			// Textures are stored inside the apk on Android (compressed)
-			// So they need to be loaded via the asset manager
-			AAsset* asset = AAssetManager_open(assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-
-			void *textureData = malloc(size);
-			AAsset_read(asset, textureData, size);
-			AAsset_close(asset);
-
-			gli::textureCube texCube(gli::load((const char*)textureData, size));
-
-			free(textureData);
-#else
-			gli::textureCube texCube(gli::load(filename));
-#endif	
+			file.assetManager = assetManager;
+#endif
+			bool opened = file.open(filename);
+			assert(opened);
+			gli::textureCube texCube(gli::load(static_cast<const char*>(file.data()), file.getSize()));
+			file.close();
 			assert(!texCube.empty());
 
 			texture->width = static_cast<uint32_t>(texCube.dimensions().x);
 			texture->height = static_cast<uint32_t>(texCube.dimensions().y);
 			texture->mipLevels = static_cast<uint32_t>(texCube.levels());
 
-			VkMemoryAllocateInfo memAllocInfo = vkTools::initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
-
-			// Create a host-visible staging buffer that contains the raw image data
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
-
-			VkBufferCreateInfo bufferCreateInfo = vkTools::initializers::bufferCreateInfo();
-			bufferCreateInfo.size = texCube.size();
-			// This buffer is used as a transfer source for the buffer copy
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-			VK_CHECK_RESULT(vkCreateBuffer(vulkanDevice->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-			// Get memory requirements for the staging buffer (alignment, memory type bits)
-			vkGetBufferMemoryRequirements(vulkanDevice->logicalDevice, stagingBuffer, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			// Get memory type index for a host visible buffer
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-			// Copy texture data into staging buffer
-			uint8_t *data;
-			VK_CHECK_RESULT(vkMapMemory(vulkanDevice->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, texCube.data(), texCube.size());
-			vkUnmapMemory(vulkanDevice->logicalDevice, stagingMemory);
+			// Get a mapped staging buffer from the device's pool and copy the raw image data into it
+			vk::Buffer stagingBuffer = vulkanDevice->stagingPool->acquire(texCube.size());
+			memcpy(stagingBuffer.mapped, texCube.data(), texCube.size());
 
 			// Setup buffer copy regions for each face including all of it's miplevels
 			std::vector<VkBufferImageCopy> bufferCopyRegions;
@@ -529,13 +451,8 @@ namespace vkTools
 
 			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageCreateInfo, nullptr, &texture->image));
 
-			vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, texture->image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &texture->deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, texture->image, texture->deviceMemory, 0));
+			VK_CHECK_RESULT(vulkanDevice->allocateImageMemory(texture->image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->allocation));
+			texture->deviceMemory = texture->allocation.memory;
 
 			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
 			VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
@@ -559,7 +476,7 @@ namespace vkTools
 			// Copy the cube map faces from the staging buffer to the optimal tiled image
 			vkCmdCopyBufferToImage(
 				cmdBuffer,
-				stagingBuffer,
+				stagingBuffer.buffer,
 				texture->image,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 				static_cast<uint32_t>(bufferCopyRegions.size()),
@@ -577,36 +494,16 @@ namespace vkTools
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 
-			// Create a fence to make sure that the copies have finished before continuing
-			VkFence copyFence;
-			VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-			VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceCreateInfo, nullptr, &copyFence));
-
 			VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
 			submitInfo.commandBufferCount = 1;
 			submitInfo.pCommandBuffers = &cmdBuffer;
 
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, copyFence));
-
-			VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->logicalDevice, 1, &copyFence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			// Wait for the copies to finish on the queue's timeline before continuing
+			vk::QueueTimeline *timeline = vulkanDevice->getQueueTimeline(queue);
+			VK_CHECK_RESULT(timeline->wait(timeline->submit(1, &submitInfo), DEFAULT_FENCE_TIMEOUT));
 
-			vkDestroyFence(vulkanDevice->logicalDevice, copyFence, nullptr);
-
-			// Create sampler
-			VkSamplerCreateInfo sampler = vkTools::initializers::samplerCreateInfo();
-			sampler.magFilter = VK_FILTER_LINEAR;
-			sampler.minFilter = VK_FILTER_LINEAR;
-			sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-			sampler.addressModeV = sampler.addressModeU;
-			sampler.addressModeW = sampler.addressModeU;
-			sampler.mipLodBias = 0.0f;
-			sampler.maxAnisotropy = 8;
-			sampler.compareOp = VK_COMPARE_OP_NEVER;
-			sampler.minLod = 0.0f;
-			sampler.maxLod = (float)texture->mipLevels;
-			sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &sampler, nullptr, &texture->sampler));
+			// Samplers are shared through the device's sampler cache
+			texture->sampler = vulkanDevice->samplerCache->get(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_LOD_CLAMP_NONE, false);
 
 			// Create image view
 			VkImageViewCreateInfo view = vkTools::initializers::imageViewCreateInfo();
@@ -619,9 +516,8 @@ namespace vkTools
 			view.image = texture->image;
 			VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &view, nullptr, &texture->view));
 
-			// Clean up staging resources
-			vkFreeMemory(vulkanDevice->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(vulkanDevice->logicalDevice, stagingBuffer, nullptr);
+			// The copies have finished, the staging buffer can be reused
+			vulkanDevice->stagingPool->release(stagingBuffer);
 
 			// Fill descriptor image info that can be used for setting up descriptor sets
 			texture->descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
@@ -640,26 +536,15 @@ namespace vkTools
 		*/
 		void loadTextureArray(std::string filename, VkFormat format, VulkanTexture *texture, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT)
 		{
+			// Decoded straight from the mapped file (or the apk's asset buffer on Android)
+			vkTools::AssetFile file;
 #if defined(__ANDROID__)
-			assert(assetManager != nullptr);
-
-			// Textures are stored inside the apk on Android (compressed)
-			// So they need to be loaded via the asset manager
-			AAsset* asset = AAssetManager_open(assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-
-			void *textureData = malloc(size);
-			AAsset_read(asset, textureData, size);
-			AAsset_close(asset);
-
-			gli::texture2DArray tex2DArray(gli::load((const char*)textureData, size));
-
-			free(textureData);
-#else
-			gli::texture2DArray tex2DArray(gli::load(filename));
-#endif	
+			file.assetManager = assetManager;
+#endif
+			bool opened = file.open(filename);
+			assert(opened);
+			gli::texture2DArray tex2DArray(gli::load(static_cast<const char*>(file.data()), file.getSize()));
+			file.close();
 
 			assert(!tex2DArray.empty());
 
@@ -668,36 +553,9 @@ namespace vkTools
 			texture->layerCount = static_cast<uint32_t>(tex2DArray.layers());
 			texture->mipLevels = static_cast<uint32_t>(tex2DArray.levels());
 
-			VkMemoryAllocateInfo memAllocInfo = vkTools::initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
-
-			// Create a host-visible staging buffer that contains the raw image data
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
-
-			VkBufferCreateInfo bufferCreateInfo = vkTools::initializers::bufferCreateInfo();
-			bufferCreateInfo.size = tex2DArray.size();
-			// This buffer is used as a transfer source for the buffer copy
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-			VK_CHECK_RESULT(vkCreateBuffer(vulkanDevice->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-			// Get memory requirements for the staging buffer (alignment, memory type bits)
-			vkGetBufferMemoryRequirements(vulkanDevice->logicalDevice, stagingBuffer, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			// Get memory type index for a host visible buffer
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-			// Copy texture data into staging buffer
-			uint8_t *data;
-			VK_CHECK_RESULT(vkMapMemory(vulkanDevice->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, tex2DArray.data(), static_cast<size_t>(tex2DArray.size()));
-			vkUnmapMemory(vulkanDevice->logicalDevice, stagingMemory);
+			// Get a mapped staging buffer from the device's pool and copy the raw image data into it
+			vk::Buffer stagingBuffer = vulkanDevice->stagingPool->acquire(static_cast<size_t>(tex2DArray.size()));
+			memcpy(stagingBuffer.mapped, tex2DArray.data(), static_cast<size_t>(tex2DArray.size()));
 
 			// Setup buffer copy regions for each layer including all of it's miplevels
 			std::vector<VkBufferImageCopy> bufferCopyRegions;
@@ -744,13 +602,8 @@ namespace vkTools
 
 			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageCreateInfo, nullptr, &texture->image));
 
-			vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, texture->image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &texture->deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, texture->image, texture->deviceMemory, 0));
+			VK_CHECK_RESULT(vulkanDevice->allocateImageMemory(texture->image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->allocation));
+			texture->deviceMemory = texture->allocation.memory;
 
 			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
 			VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
@@ -774,7 +627,7 @@ namespace vkTools
 			// Copy the layers and mip levels from the staging buffer to the optimal tiled image
 			vkCmdCopyBufferToImage(
 				cmdBuffer,
-				stagingBuffer,
+				stagingBuffer.buffer,
 				texture->image,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 				static_cast<uint32_t>(bufferCopyRegions.size()),
@@ -792,36 +645,16 @@ namespace vkTools
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 
-			// Create a fence to make sure that the copies have finished before continuing
-			VkFence copyFence;
-			VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-			VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceCreateInfo, nullptr, &copyFence));
-
 			VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
 			submitInfo.commandBufferCount = 1;
 			submitInfo.pCommandBuffers = &cmdBuffer;
 
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, copyFence));
-
-			VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->logicalDevice, 1, &copyFence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			// Wait for the copies to finish on the queue's timeline before continuing
+			vk::QueueTimeline *timeline = vulkanDevice->getQueueTimeline(queue);
+			VK_CHECK_RESULT(timeline->wait(timeline->submit(1, &submitInfo), DEFAULT_FENCE_TIMEOUT));
 
-			vkDestroyFence(vulkanDevice->logicalDevice, copyFence, nullptr);
-
-			// Create sampler
-			VkSamplerCreateInfo sampler = vkTools::initializers::samplerCreateInfo();
-			sampler.magFilter = VK_FILTER_LINEAR;
-			sampler.minFilter = VK_FILTER_LINEAR;
-			sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-			sampler.addressModeV = sampler.addressModeU;
-			sampler.addressModeW = sampler.addressModeU;
-			sampler.mipLodBias = 0.0f;
-			sampler.maxAnisotropy = 8;
-			sampler.compareOp = VK_COMPARE_OP_NEVER;
-			sampler.minLod = 0.0f;
-			sampler.maxLod = (float)texture->mipLevels;
-			sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &sampler, nullptr, &texture->sampler));
+			// Samplers are shared through the device's sampler cache
+			texture->sampler = vulkanDevice->samplerCache->get(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_LOD_CLAMP_NONE, false);
 
 			// Create image view
 			VkImageViewCreateInfo view = vkTools::initializers::imageViewCreateInfo();
@@ -834,9 +667,8 @@ namespace vkTools
 			view.image = texture->image;
 			VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &view, nullptr, &texture->view));
 
-			// Clean up staging resources
-			vkFreeMemory(vulkanDevice->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(vulkanDevice->logicalDevice, stagingBuffer, nullptr);
+			// The copies have finished, the staging buffer can be reused
+			vulkanDevice->stagingPool->release(stagingBuffer);
 
 			// Fill descriptor image info that can be used for setting up descriptor sets
 			texture->descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
@@ -855,49 +687,25 @@ namespace vkTools
 		* @param texture Pointer to the texture object to load the image into
 		* @param (Optional) filter Texture filtering for the sampler (defaults to VK_FILTER_LINEAR)
 		* @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+		* @param (Optional) generateMips Generate a full mip chain from the uploaded data if the format supports blitting (defaults to false)
 		*/
-		void createTexture(void* buffer, VkDeviceSize bufferSize, VkFormat format, uint32_t width, uint32_t height, VulkanTexture *texture, VkFilter filter = VK_FILTER_LINEAR, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT)
+		void createTexture(void* buffer, VkDeviceSize bufferSize, VkFormat format, uint32_t width, uint32_t height, VulkanTexture *texture, VkFilter filter = VK_FILTER_LINEAR, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT, bool generateMips = false)
 		{
 			assert(buffer);
 
+			generateMips = generateMips && vkTools::formatSupportsMipmapBlit(vulkanDevice->physicalDevice, format);
+
 			texture->width = width;
 			texture->height = height;
-			texture->mipLevels = 1;
-
-			VkMemoryAllocateInfo memAllocInfo = vkTools::initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
+			texture->mipLevels = generateMips ? vkTools::getMipLevelCount(width, height) : 1;
 
 			// Use a separate command buffer for texture loading
 			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
 			VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
-			// Create a host-visible staging buffer that contains the raw image data
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingMemory;
-
-			VkBufferCreateInfo bufferCreateInfo = vkTools::initializers::bufferCreateInfo();
-			bufferCreateInfo.size = bufferSize;
-			// This buffer is used as a transfer source for the buffer copy
-			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-			VK_CHECK_RESULT(vkCreateBuffer(vulkanDevice->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-			// Get memory requirements for the staging buffer (alignment, memory type bits)
-			vkGetBufferMemoryRequirements(vulkanDevice->logicalDevice, stagingBuffer, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-			// Get memory type index for a host visible buffer
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-			VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-			// Copy texture data into staging buffer
-			uint8_t *data;
-			VK_CHECK_RESULT(vkMapMemory(vulkanDevice->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-			memcpy(data, buffer, bufferSize);
-			vkUnmapMemory(vulkanDevice->logicalDevice, stagingMemory);
+			// Get a mapped staging buffer from the device's pool and copy the raw image data into it
+			vk::Buffer stagingBuffer = vulkanDevice->stagingPool->acquire(bufferSize);
+			memcpy(stagingBuffer.mapped, buffer, bufferSize);
 
 			VkBufferImageCopy bufferCopyRegion = {};
 			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -926,20 +734,19 @@ namespace vkTools
 			{
 				imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 			}
+			if (generateMips)
+			{
+				imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			}
 			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageCreateInfo, nullptr, &texture->image));
 
-			vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, texture->image, &memReqs);
-
-			memAllocInfo.allocationSize = memReqs.size;
-
-			memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAllocInfo, nullptr, &texture->deviceMemory));
-			VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, texture->image, texture->deviceMemory, 0));
+			VK_CHECK_RESULT(vulkanDevice->allocateImageMemory(texture->image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture->allocation));
+			texture->deviceMemory = texture->allocation.memory;
 
 			VkImageSubresourceRange subresourceRange = {};
 			subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			subresourceRange.baseMipLevel = 0;
-			subresourceRange.levelCount = texture->mipLevels;
+			subresourceRange.levelCount = 1;
 			subresourceRange.layerCount = 1;
 
 			// Image barrier for optimal image (target)
@@ -955,59 +762,46 @@ namespace vkTools
 			// Copy mip levels from staging buffer
 			vkCmdCopyBufferToImage(
 				cmdBuffer,
-				stagingBuffer,
+				stagingBuffer.buffer,
 				texture->image,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 				1,
 				&bufferCopyRegion
 			);
 
-			// Change texture image layout to shader read after all mip levels have been copied
+			// Change texture image layout to shader read after the remaining mip levels have been generated
 			texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			setImageLayout(
-				cmdBuffer,
-				texture->image,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				texture->imageLayout,
-				subresourceRange);
+			if (generateMips)
+			{
+				vkTools::generateMipmaps(cmdBuffer, texture->image, width, height, texture->mipLevels, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture->imageLayout);
+			}
+			else
+			{
+				setImageLayout(
+					cmdBuffer,
+					texture->image,
+					VK_IMAGE_ASPECT_COLOR_BIT,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					texture->imageLayout,
+					subresourceRange);
+			}
 
 			// Submit command buffer containing copy and image layout commands
 			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 
-			// Create a fence to make sure that the copies have finished before continuing
-			VkFence copyFence;
-			VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-			VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceCreateInfo, nullptr, &copyFence));
-
 			VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
 			submitInfo.commandBufferCount = 1;
 			submitInfo.pCommandBuffers = &cmdBuffer;
 
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, copyFence));
-
-			VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->logicalDevice, 1, &copyFence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
-
-			vkDestroyFence(vulkanDevice->logicalDevice, copyFence, nullptr);
+			// Wait for the copies to finish on the queue's timeline before continuing
+			vk::QueueTimeline *timeline = vulkanDevice->getQueueTimeline(queue);
+			VK_CHECK_RESULT(timeline->wait(timeline->submit(1, &submitInfo), DEFAULT_FENCE_TIMEOUT));
 
-			// Clean up staging resources
-			vkFreeMemory(vulkanDevice->logicalDevice, stagingMemory, nullptr);
-			vkDestroyBuffer(vulkanDevice->logicalDevice, stagingBuffer, nullptr);
+			// The copies have finished, the staging buffer can be reused
+			vulkanDevice->stagingPool->release(stagingBuffer);
 
-			// Create sampler
-			VkSamplerCreateInfo sampler = {};
-			sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-			sampler.magFilter = filter;
-			sampler.minFilter = filter;
-			sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-			sampler.mipLodBias = 0.0f;
-			sampler.compareOp = VK_COMPARE_OP_NEVER;
-			sampler.minLod = 0.0f;
-			sampler.maxLod = 0.0f;
-			VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &sampler, nullptr, &texture->sampler));
+			// Samplers are shared through the device's sampler cache
+			texture->sampler = vulkanDevice->samplerCache->get(filter, VK_SAMPLER_ADDRESS_MODE_REPEAT);
 
 			// Create image view
 			VkImageViewCreateInfo view = {};
@@ -1018,7 +812,7 @@ namespace vkTools
 			view.format = format;
 			view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
 			view.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-			view.subresourceRange.levelCount = 1;
+			view.subresourceRange.levelCount = texture->mipLevels;
 			view.image = texture->image;
 			VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &view, nullptr, &texture->view));
 
@@ -1032,13 +826,21 @@ namespace vkTools
 		* Free all Vulkan resources used by a texture object
 		*
 		* @param texture Texture object whose resources are to be freed
+		*
+		* @note The sampler is owned by the device's sampler cache and not destroyed
 		*/
 		void destroyTexture(VulkanTexture texture)
 		{
 			vkDestroyImageView(vulkanDevice->logicalDevice, texture.view, nullptr);
 			vkDestroyImage(vulkanDevice->logicalDevice, texture.image, nullptr);
-			vkDestroySampler(vulkanDevice->logicalDevice, texture.sampler, nullptr);
-			vkFreeMemory(vulkanDevice->logicalDevice, texture.deviceMemory, nullptr);
+			if (texture.allocation.allocator)
+			{
+				vulkanDevice->freeMemory(texture.allocation);
+			}
+			else
+			{
+				vkFreeMemory(vulkanDevice->logicalDevice, texture.deviceMemory, nullptr);
+			}
 		}
 	};
 };
@@ -0,0 +1,590 @@
+/*
+* Asynchronous texture streaming for Vulkan
+*
+* Worker threads decode texture files and copy them into a persistently mapped staging ring buffer
+* Block compressed formats the device can't sample are decoded to RGBA8 by the workers (see TextureTranscoder)
+* Staged textures are uploaded in batches on the transfer queue and handed out once their upload has finished
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+#include <vulkan/vulkan.h>
+
+#include "vulkandevice.hpp"
+#include "vulkanbuffer.hpp"
+#include "vulkanTextureLoader.hpp"
+#include "texturetranscoder.hpp"
+#include "texturefile.hpp"
+#include "cputrace.hpp"
+#include "cputopology.hpp"
+
+#if defined(__ANDROID__)
+#include <android/asset_manager.h>
+#endif
+
+namespace vkTools
+{
+	/**
+	* @brief Texture whose upload has finished, ready to be used for rendering
+	*/
+	struct StreamedTexture
+	{
+		std::string name;
+		VulkanTexture texture;
+		/** @brief Level of the file's mip chain the texture's first mip level has been loaded from */
+		uint32_t baseMip;
+		/** @brief Dimensions and mip level count of the full mip chain stored in the file */
+		uint32_t fileWidth, fileHeight, fileMipLevels;
+	};
+
+	/**
+	* @brief Streams 2D textures asynchronously into GPU memory
+	*
+	* @note request may be called from any thread, update must be called from the thread that submits to the graphics queue
+	*/
+	class VulkanTextureStreamer
+	{
+	private:
+		struct Request
+		{
+			std::string name;
+			std::string filename;
+			VkFormat format;
+			uint32_t baseMip;
+			bool normalMap;
+		};
+
+		// Decoded texture whose data has been copied into the staging ring (or a dedicated staging buffer)
+		struct StagedTexture
+		{
+			std::string name;
+			VkFormat format;
+			uint32_t width, height;
+			uint32_t baseMip;
+			uint32_t fileWidth, fileHeight, fileMipLevels;
+			std::vector<VkBufferImageCopy> regions;
+			// Sequence number of the staging ring reservation, UINT64_MAX if the texture didn't fit into the ring
+			uint64_t reservation;
+			// Only used for textures that don't fit into the staging ring
+			vk::Buffer dedicatedStaging;
+		};
+
+		// Upload batch submitted to the queues
+		struct Batch
+		{
+			std::vector<StagedTexture> staged;
+			std::vector<VulkanTexture> textures;
+			VkCommandBuffer transferCmd;
+			VkCommandBuffer acquireCmd;
+			VkSemaphore semaphore;
+			VkFence fence;
+		};
+
+		struct Reservation
+		{
+			VkDeviceSize size;
+			bool retired;
+		};
+
+		vk::VulkanDevice *vulkanDevice;
+		VkQueue transferQueue;
+		VkQueue graphicsQueue;
+		VkCommandPool transferPool;
+		VkCommandPool graphicsPool;
+		// The buffers are exclusive, so image ownership has to be moved to the graphics queue family if the transfer queue is a different family
+		bool ownershipTransfer;
+
+		std::vector<std::thread> workers;
+		bool stopping = false;
+
+		std::mutex requestMutex;
+		std::condition_variable requestCondition;
+		std::deque<Request> requests;
+
+		std::mutex stagedMutex;
+		std::vector<StagedTexture> staged;
+
+		// Staging ring, space is reserved by the workers and released in reservation order once the upload of a batch has finished
+		std::mutex ringMutex;
+		std::condition_variable ringCondition;
+		vk::Buffer ring;
+		VkDeviceSize ringAlignment;
+		VkDeviceSize ringHead = 0;
+		VkDeviceSize ringUsed = 0;
+		std::deque<Reservation> reservations;
+		uint64_t firstReservation = 0;
+
+		// Only accessed by the thread calling update
+		std::deque<Batch> batches;
+
+		// Textures requested but not yet handed out
+		std::mutex pendingMutex;
+		uint32_t pendingCount = 0;
+
+		VkDeviceSize align(VkDeviceSize size)
+		{
+			return (size + ringAlignment - 1) & ~(ringAlignment - 1);
+		}
+
+		// Reserve space in the staging ring, blocks until enough space has been released
+		// Returns false if the streamer is shutting down
+		bool reserve(VkDeviceSize size, VkDeviceSize *offset, uint64_t *reservation)
+		{
+			size = align(size);
+			assert(size <= ring.size);
+			std::unique_lock<std::mutex> lock(ringMutex);
+			VkDeviceSize waste = 0;
+			ringCondition.wait(lock, [&] {
+				if (ringUsed == 0)
+				{
+					ringHead = 0;
+				}
+				// Reservations are contiguous, the rest of the ring is skipped if the data doesn't fit in front of the wrap
+				waste = (ringHead + size > ring.size) ? ring.size - ringHead : 0;
+				return stopping || (ringUsed + waste + size <= ring.size);
+			});
+			if (stopping)
+			{
+				return false;
+			}
+			*offset = (waste > 0 || ringHead == ring.size) ? 0 : ringHead;
+			ringHead = *offset + size;
+			ringUsed += waste + size;
+			*reservation = firstReservation + reservations.size();
+			reservations.push_back({ waste + size, false });
+			return true;
+		}
+
+		void retire(uint64_t reservation)
+		{
+			std::lock_guard<std::mutex> lock(ringMutex);
+			reservations[reservation - firstReservation].retired = true;
+			while (!reservations.empty() && reservations.front().retired)
+			{
+				ringUsed -= reservations.front().size;
+				reservations.pop_front();
+				firstReservation++;
+			}
+			ringCondition.notify_all();
+		}
+
+		void finishPending(uint32_t count)
+		{
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			pendingCount -= count;
+		}
+
+		// Decode the texture and copy it into staging memory
+		void stage(const Request &request)
+		{
+			// DDS levels are copied from the mapped file straight into the staging memory
+			TextureFile file;
+#if defined(__ANDROID__)
+			file.assetManager = assetManager;
+#endif
+			if (!file.load(request.filename))
+			{
+				std::cerr << "Could not load texture \"" << request.filename << "\"" << std::endl;
+				finishPending(1);
+				return;
+			}
+			const std::vector<TextureFile::Level> &levels = file.getLevels();
+
+			// Levels above the requested base mip are skipped
+			StagedTexture texture;
+			texture.name = request.name;
+			texture.format = TextureTranscoder::selectFormat(vulkanDevice->physicalDevice, request.format, request.normalMap);
+			const bool transcode = (texture.format != request.format);
+			texture.fileWidth = levels[0].width;
+			texture.fileHeight = levels[0].height;
+			texture.fileMipLevels = static_cast<uint32_t>(levels.size());
+			texture.baseMip = std::min(request.baseMip, texture.fileMipLevels - 1);
+			texture.width = levels[texture.baseMip].width;
+			texture.height = levels[texture.baseMip].height;
+
+			// Size of each level in the upload format
+			std::vector<size_t> levelSizes;
+			size_t size = 0;
+			for (uint32_t i = texture.baseMip; i < texture.fileMipLevels; i++)
+			{
+				levelSizes.push_back(transcode ? TextureTranscoder::getTranscodedSize(texture.format, levels[i].width, levels[i].height) : levels[i].size);
+				size += levelSizes.back();
+			}
+
+			VkDeviceSize offset = 0;
+			uint8_t *data = nullptr;
+			if (align(size) <= ring.size)
+			{
+				if (!reserve(size, &offset, &texture.reservation))
+				{
+					return;
+				}
+				data = static_cast<uint8_t*>(ring.mapped) + offset;
+			}
+			else
+			{
+				// Larger than the whole ring, staged in a buffer from the device's pool
+				texture.reservation = UINT64_MAX;
+				texture.dedicatedStaging = vulkanDevice->stagingPool->acquire(size);
+				data = static_cast<uint8_t*>(texture.dedicatedStaging.mapped);
+			}
+
+			// Copy the data and setup buffer copy regions for each mip level
+			for (uint32_t i = texture.baseMip; i < texture.fileMipLevels; i++)
+			{
+				const size_t levelSize = levelSizes[i - texture.baseMip];
+				if (transcode)
+				{
+					TextureTranscoder::transcode(request.format, texture.format, levels[i].data, levels[i].width, levels[i].height, data);
+				}
+				else
+				{
+					memcpy(data, levels[i].data, levelSize);
+				}
+				data += levelSize;
+
+				VkBufferImageCopy bufferCopyRegion = {};
+				bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				bufferCopyRegion.imageSubresource.mipLevel = i - texture.baseMip;
+				bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+				bufferCopyRegion.imageSubresource.layerCount = 1;
+				bufferCopyRegion.imageExtent.width = levels[i].width;
+				bufferCopyRegion.imageExtent.height = levels[i].height;
+				bufferCopyRegion.imageExtent.depth = 1;
+				bufferCopyRegion.bufferOffset = offset;
+				texture.regions.push_back(bufferCopyRegion);
+				offset += levelSize;
+			}
+
+			std::lock_guard<std::mutex> lock(stagedMutex);
+			staged.push_back(std::move(texture));
+		}
+
+		void workerLoop()
+		{
+			CpuTrace::get().setThreadName("Texture streaming");
+			CpuTopology::get().setThreadRole(CpuTopology::THREAD_ROLE_BACKGROUND);
+			while (true)
+			{
+				Request request;
+				{
+					std::unique_lock<std::mutex> lock(requestMutex);
+					requestCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+					if (stopping)
+					{
+						return;
+					}
+					request = std::move(requests.front());
+					requests.pop_front();
+				}
+				TraceZone traceZone("Stage texture");
+				stage(request);
+			}
+		}
+
+		// Create the image for a staged texture and record its upload
+		void recordUpload(Batch &batch, StagedTexture &staged, VulkanTexture &texture)
+		{
+			texture = {};
+			texture.width = staged.width;
+			texture.height = staged.height;
+			texture.mipLevels = static_cast<uint32_t>(staged.regions.size());
+			texture.layerCount = 1;
+
+			VkImageCreateInfo imageCreateInfo = vkTools::initializers::imageCreateInfo();
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = staged.format;
+			imageCreateInfo.mipLevels = texture.mipLevels;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageCreateInfo.extent = { texture.width, texture.height, 1 };
+			imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageCreateInfo, nullptr, &texture.image));
+			VK_CHECK_RESULT(vulkanDevice->allocateImageMemory(texture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texture.allocation));
+			texture.deviceMemory = texture.allocation.memory;
+
+			VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1 };
+
+			// Transfer queue: copy all mip levels
+			VkImageMemoryBarrier imageBarrier = vkTools::initializers::imageMemoryBarrier();
+			imageBarrier.srcAccessMask = 0;
+			imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageBarrier.image = texture.image;
+			imageBarrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(batch.transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+			vkCmdCopyBufferToImage(
+				batch.transferCmd,
+				(staged.reservation != UINT64_MAX) ? ring.buffer : staged.dedicatedStaging.buffer,
+				texture.image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(staged.regions.size()),
+				staged.regions.data());
+
+			// Transition to shader read, split into release and acquire if the image changes queue families
+			texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageBarrier.newLayout = texture.imageLayout;
+			if (ownershipTransfer)
+			{
+				imageBarrier.srcQueueFamilyIndex = vulkanDevice->queueFamilyIndices.transfer;
+				imageBarrier.dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+				imageBarrier.dstAccessMask = 0;
+				vkCmdPipelineBarrier(batch.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+				imageBarrier.srcAccessMask = 0;
+				imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			}
+			vkCmdPipelineBarrier(batch.acquireCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+			// Shared sampler from the device's cache, the image view limits the sampled levels to the resident ones
+			texture.sampler = vulkanDevice->samplerCache->get(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+
+			// Create image view
+			VkImageViewCreateInfo view = vkTools::initializers::imageViewCreateInfo();
+			view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			view.format = staged.format;
+			view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+			view.subresourceRange = subresourceRange;
+			view.image = texture.image;
+			VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &view, nullptr, &texture.view));
+
+			texture.descriptor.imageLayout = texture.imageLayout;
+			texture.descriptor.imageView = texture.view;
+			texture.descriptor.sampler = texture.sampler;
+		}
+
+		// Release the staging memory and synchronization objects of a finished batch
+		void releaseBatch(Batch &batch)
+		{
+			for (auto& texture : batch.staged)
+			{
+				if (texture.reservation != UINT64_MAX)
+				{
+					retire(texture.reservation);
+				}
+				else
+				{
+					vulkanDevice->stagingPool->release(texture.dedicatedStaging);
+				}
+			}
+			vkFreeCommandBuffers(vulkanDevice->logicalDevice, transferPool, 1, &batch.transferCmd);
+			vkFreeCommandBuffers(vulkanDevice->logicalDevice, graphicsPool, 1, &batch.acquireCmd);
+			vkDestroySemaphore(vulkanDevice->logicalDevice, batch.semaphore, nullptr);
+			vkDestroyFence(vulkanDevice->logicalDevice, batch.fence, nullptr);
+		}
+
+		void destroyTexture(VulkanTexture &texture)
+		{
+			vkDestroyImageView(vulkanDevice->logicalDevice, texture.view, nullptr);
+			vkDestroyImage(vulkanDevice->logicalDevice, texture.image, nullptr);
+			vulkanDevice->freeMemory(texture.allocation);
+		}
+
+	public:
+#if defined(__ANDROID__)
+		AAssetManager* assetManager = nullptr;
+#endif
+
+		/**
+		* Default constructor
+		*
+		* @param vulkanDevice Pointer to a valid VulkanDevice
+		* @param transferQueue Queue the uploads are submitted to
+		* @param graphicsQueue Queue the textures are used on (ownership is transferred if it's from a different family than transferQueue)
+		* @param workerCount Number of threads decoding texture files
+		* @param stagingSize Size of the staging ring, textures larger than the ring get a dedicated staging buffer
+		*/
+		VulkanTextureStreamer(vk::VulkanDevice *vulkanDevice, VkQueue transferQueue, VkQueue graphicsQueue, uint32_t workerCount, VkDeviceSize stagingSize)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->transferQueue = transferQueue;
+			this->graphicsQueue = graphicsQueue;
+			ownershipTransfer = (vulkanDevice->queueFamilyIndices.transfer != vulkanDevice->queueFamilyIndices.graphics);
+			transferPool = vulkanDevice->createCommandPool(vulkanDevice->queueFamilyIndices.transfer, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+			graphicsPool = vulkanDevice->createCommandPool(vulkanDevice->queueFamilyIndices.graphics, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+			// Copy offsets must be a multiple of the texel block size (16 bytes for the block compressed formats)
+			ringAlignment = std::max<VkDeviceSize>(16, vulkanDevice->properties.limits.optimalBufferCopyOffsetAlignment);
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&ring,
+				stagingSize));
+			VK_CHECK_RESULT(ring.map());
+
+			for (uint32_t i = 0; i < workerCount; i++)
+			{
+				workers.push_back(std::thread(&VulkanTextureStreamer::workerLoop, this));
+			}
+		}
+
+		/**
+		* Default destructor
+		*
+		* @note Textures that have already been handed out by update are not freed
+		*/
+		~VulkanTextureStreamer()
+		{
+			{
+				std::lock_guard<std::mutex> requestLock(requestMutex);
+				std::lock_guard<std::mutex> ringLock(ringMutex);
+				stopping = true;
+			}
+			requestCondition.notify_all();
+			ringCondition.notify_all();
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+			for (auto& batch : batches)
+			{
+				VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+				for (auto& texture : batch.textures)
+				{
+					destroyTexture(texture);
+				}
+				releaseBatch(batch);
+			}
+			for (auto& texture : staged)
+			{
+				if (texture.reservation == UINT64_MAX)
+				{
+					vulkanDevice->stagingPool->release(texture.dedicatedStaging);
+				}
+			}
+			ring.destroy();
+			vkDestroyCommandPool(vulkanDevice->logicalDevice, transferPool, nullptr);
+			vkDestroyCommandPool(vulkanDevice->logicalDevice, graphicsPool, nullptr);
+		}
+
+		/**
+		* Queue a 2D texture for streaming, the texture is handed out by update once it has been uploaded
+		*
+		* @param name Name the texture is handed out with
+		* @param filename File to load
+		* @param format Vulkan format of the image data stored in the file, block compressed formats the device doesn't support are decoded to RGBA8
+		* @param (Optional) baseMip First level of the file's mip chain to load, larger levels are skipped (clamped to the smallest level)
+		* @param (Optional) normalMap Only keep x and y of the normals, see TextureTranscoder::selectFormat (defaults to false)
+		*
+		* @note Only supports .ktx and .dds
+		*/
+		void request(const std::string &name, const std::string &filename, VkFormat format, uint32_t baseMip = 0, bool normalMap = false)
+		{
+			{
+				std::lock_guard<std::mutex> lock(pendingMutex);
+				pendingCount++;
+			}
+			{
+				std::lock_guard<std::mutex> lock(requestMutex);
+				requests.push_back({ name, filename, format, baseMip, normalMap });
+			}
+			requestCondition.notify_one();
+		}
+
+		/**
+		* Submit the uploads of all staged textures and collect the textures whose upload has finished
+		*
+		* @param finished Textures that are ready to be used are appended to this list, the caller takes over ownership
+		*/
+		void update(std::vector<StreamedTexture> &finished)
+		{
+			// Finished batches (submitted in order, so stop at the first one still in flight)
+			uint32_t finishedCount = 0;
+			while (!batches.empty() && (vkGetFenceStatus(vulkanDevice->logicalDevice, batches.front().fence) == VK_SUCCESS))
+			{
+				Batch &batch = batches.front();
+				for (size_t i = 0; i < batch.textures.size(); i++)
+				{
+					const StagedTexture &staged = batch.staged[i];
+					finished.push_back({ staged.name, batch.textures[i], staged.baseMip, staged.fileWidth, staged.fileHeight, staged.fileMipLevels });
+				}
+				finishedCount += static_cast<uint32_t>(batch.textures.size());
+				releaseBatch(batch);
+				batches.pop_front();
+			}
+			if (finishedCount > 0)
+			{
+				finishPending(finishedCount);
+			}
+
+			// All textures staged since the last update go into one batch
+			Batch batch;
+			{
+				std::lock_guard<std::mutex> lock(stagedMutex);
+				batch.staged.swap(staged);
+			}
+			if (batch.staged.empty())
+			{
+				return;
+			}
+
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vkTools::initializers::commandBufferAllocateInfo(transferPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, &batch.transferCmd));
+			cmdBufAllocateInfo.commandPool = graphicsPool;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, &batch.acquireCmd));
+
+			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(batch.transferCmd, &cmdBufInfo));
+			VK_CHECK_RESULT(vkBeginCommandBuffer(batch.acquireCmd, &cmdBufInfo));
+			batch.textures.resize(batch.staged.size());
+			for (size_t i = 0; i < batch.staged.size(); i++)
+			{
+				recordUpload(batch, batch.staged[i], batch.textures[i]);
+			}
+			VK_CHECK_RESULT(vkEndCommandBuffer(batch.transferCmd));
+			VK_CHECK_RESULT(vkEndCommandBuffer(batch.acquireCmd));
+
+			VkSemaphoreCreateInfo semaphoreCreateInfo = vkTools::initializers::semaphoreCreateInfo();
+			VK_CHECK_RESULT(vkCreateSemaphore(vulkanDevice->logicalDevice, &semaphoreCreateInfo, nullptr, &batch.semaphore));
+			VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo();
+			VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceCreateInfo, nullptr, &batch.fence));
+
+			VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &batch.transferCmd;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &batch.semaphore;
+			VK_CHECK_RESULT(vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+			const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			submitInfo.pCommandBuffers = &batch.acquireCmd;
+			submitInfo.signalSemaphoreCount = 0;
+			submitInfo.pSignalSemaphores = nullptr;
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &batch.semaphore;
+			submitInfo.pWaitDstStageMask = &waitStageMask;
+			VK_CHECK_RESULT(vkQueueSubmit(graphicsQueue, 1, &submitInfo, batch.fence));
+
+			batches.push_back(std::move(batch));
+		}
+
+		/**
+		* @return Number of requested textures that have not been handed out yet
+		*/
+		uint32_t getPendingCount()
+		{
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			return pendingCount;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,571 @@
+/*
+* Vulkan device memory allocator
+*
+* Sub-allocates buffers and images from large device memory blocks instead of doing one vkAllocateMemory per resource
+* Every memory type has its own pool of blocks, linear and optimal resources never share a block
+* Empty blocks are released (keeping one per pool for later allocations) and sparse blocks can be evacuated by moving their resources
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "vulkantools.h"
+
+namespace vk
+{
+	class MemoryAllocator;
+
+	/**
+	* @brief Resource kinds that are kept in separate blocks
+	* @note Separating them means bufferImageGranularity never has to be taken into account
+	*/
+	enum AllocationType
+	{
+		/** @brief Buffers and linear tiled images */
+		ALLOCATION_TYPE_LINEAR = 0,
+		/** @brief Optimal tiled images */
+		ALLOCATION_TYPE_OPTIMAL = 1,
+		ALLOCATION_TYPE_COUNT = 2
+	};
+
+	/**
+	* @brief What the memory of an allocation is used for, usage is accounted per category
+	*/
+	enum MemoryCategory
+	{
+		MEMORY_CATEGORY_TEXTURES = 0,
+		/** @brief Vertex and index buffers */
+		MEMORY_CATEGORY_MESHES = 1,
+		/** @brief Render targets, including images written by compute passes */
+		MEMORY_CATEGORY_ATTACHMENTS = 2,
+		/** @brief Host visible buffers only used as transfer source */
+		MEMORY_CATEGORY_STAGING = 3,
+		MEMORY_CATEGORY_UNIFORMS = 4,
+		/** @brief Storage, indirect and all other buffers */
+		MEMORY_CATEGORY_OTHER = 5,
+		MEMORY_CATEGORY_COUNT = 6
+	};
+
+	inline const char* getMemoryCategoryName(MemoryCategory category)
+	{
+		switch (category)
+		{
+		case MEMORY_CATEGORY_TEXTURES:
+			return "textures";
+		case MEMORY_CATEGORY_MESHES:
+			return "meshes";
+		case MEMORY_CATEGORY_ATTACHMENTS:
+			return "attachments";
+		case MEMORY_CATEGORY_STAGING:
+			return "staging";
+		case MEMORY_CATEGORY_UNIFORMS:
+			return "uniforms";
+		default:
+			return "other";
+		}
+	}
+
+	/**
+	* @brief Range of device memory handed out by the MemoryAllocator
+	*/
+	struct Allocation
+	{
+		/** @brief Memory block the range was taken from, bind the resource at offset */
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		/** @brief Host address of the range, host visible blocks are mapped for their whole lifetime */
+		void* mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+		MemoryCategory category = MEMORY_CATEGORY_OTHER;
+		/** @brief Allocator to return the range to, null if the range has already been freed */
+		MemoryAllocator *allocator = nullptr;
+		void *block = nullptr;
+	};
+
+	/**
+	* @brief Block based device memory sub-allocator with one pool per memory type
+	* @note Requests larger than half a block get a dedicated block that is released as soon as it is freed
+	*/
+	class MemoryAllocator
+	{
+	public:
+		/** @brief Memory usage of a memory type or of all memory types */
+		struct Stats
+		{
+			/** @brief Number of device memory objects allocated from the driver */
+			uint32_t blockCount = 0;
+			/** @brief Number of live sub-allocations */
+			uint32_t allocationCount = 0;
+			/** @brief Bytes allocated from the driver */
+			VkDeviceSize blockBytes = 0;
+			/** @brief Bytes handed out to resources (excluding alignment padding) */
+			VkDeviceSize usedBytes = 0;
+		};
+
+	private:
+		struct Range
+		{
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		struct Block
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			void* mapped = nullptr;
+			bool dedicated = false;
+			uint32_t memoryTypeIndex = 0;
+			AllocationType type = ALLOCATION_TYPE_LINEAR;
+			uint32_t allocationCount = 0;
+			VkDeviceSize usedBytes = 0;
+			// Free ranges sorted by offset, neighbouring ranges are always merged
+			std::vector<Range> freeRanges;
+			// Marked by updateDefragmentation, no new allocations are placed in the block until its resources have been moved out
+			bool evacuating = false;
+			// Usage at the last defragmentation update and the number of updates since it last went down
+			VkDeviceSize lastUsedBytes = 0;
+			uint32_t stalledUpdates = 0;
+			// Usage at which an evacuation has been given up, the block isn't picked again until its usage changes
+			VkDeviceSize pinnedBytes = 0;
+		};
+
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize nonCoherentAtomSize;
+		VkDeviceSize blockSize;
+		std::vector<Block*> pools[VK_MAX_MEMORY_TYPES][ALLOCATION_TYPE_COUNT];
+		// Block counts and block bytes are only kept per memory type, the categories just count their allocations
+		Stats categoryStats[MEMORY_CATEGORY_COUNT];
+		// Resources may be created and destroyed from multiple threads
+		std::mutex mutex;
+		uint32_t evacuatingBlockCount = 0;
+		uint32_t releasedBlockCount = 0;
+		// Defragmentation updates an evacuation may go without progress before it's given up
+		static const uint32_t MAX_STALLED_UPDATES = 4;
+
+		void addCategoryUsage(const Allocation &allocation)
+		{
+			Stats &stats = categoryStats[allocation.category];
+			stats.allocationCount++;
+			stats.usedBytes += allocation.size;
+		}
+
+		static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		// First fit search over the free ranges of a block
+		bool allocateFromBlock(Block *block, VkDeviceSize size, VkDeviceSize alignment, Allocation *allocation)
+		{
+			for (size_t i = 0; i < block->freeRanges.size(); i++)
+			{
+				const Range range = block->freeRanges[i];
+				const VkDeviceSize offset = alignUp(range.offset, alignment);
+				if (offset + size > range.offset + range.size)
+				{
+					continue;
+				}
+				// Keep the alignment padding in front and the remainder behind the allocation as free ranges
+				const Range front = { range.offset, offset - range.offset };
+				const Range back = { offset + size, range.offset + range.size - offset - size };
+				block->freeRanges.erase(block->freeRanges.begin() + i);
+				if (back.size > 0)
+				{
+					block->freeRanges.insert(block->freeRanges.begin() + i, back);
+				}
+				if (front.size > 0)
+				{
+					block->freeRanges.insert(block->freeRanges.begin() + i, front);
+				}
+				block->allocationCount++;
+				block->usedBytes += size;
+				allocation->memory = block->memory;
+				allocation->offset = offset;
+				allocation->size = size;
+				allocation->mapped = block->mapped ? static_cast<uint8_t*>(block->mapped) + offset : nullptr;
+				allocation->block = block;
+				return true;
+			}
+			return false;
+		}
+
+		VkResult createBlock(uint32_t memoryTypeIndex, AllocationType type, VkDeviceSize size, bool dedicated, const void *pNext, Block **block)
+		{
+			VkMemoryAllocateInfo memAlloc = vkTools::initializers::memoryAllocateInfo();
+			memAlloc.pNext = pNext;
+			memAlloc.allocationSize = size;
+			memAlloc.memoryTypeIndex = memoryTypeIndex;
+			VkDeviceMemory memory;
+			VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, &memory);
+			if (result != VK_SUCCESS)
+			{
+				return result;
+			}
+			Block *newBlock = new Block();
+			newBlock->memory = memory;
+			newBlock->size = size;
+			newBlock->dedicated = dedicated;
+			newBlock->memoryTypeIndex = memoryTypeIndex;
+			newBlock->type = type;
+			newBlock->freeRanges.push_back({ 0, size });
+			if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+			{
+				result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &newBlock->mapped);
+				if (result != VK_SUCCESS)
+				{
+					vkFreeMemory(device, memory, nullptr);
+					delete newBlock;
+					return result;
+				}
+			}
+			*block = newBlock;
+			return VK_SUCCESS;
+		}
+
+		void destroyBlock(Block *block)
+		{
+			if (block->mapped)
+			{
+				vkUnmapMemory(device, block->memory);
+			}
+			vkFreeMemory(device, block->memory, nullptr);
+			delete block;
+		}
+
+	public:
+		/**
+		* Create an allocator for a logical device
+		*
+		* @param device Logical device to allocate memory from
+		* @param memoryProperties Memory types and heaps of the physical device
+		* @param limits Limits of the physical device
+		* @param (Optional) blockSize Size of the device memory blocks resources are sub-allocated from (defaults to 64 MB)
+		*/
+		MemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const VkPhysicalDeviceLimits &limits, VkDeviceSize blockSize = 64 * 1024 * 1024)
+		{
+			this->device = device;
+			this->memoryProperties = memoryProperties;
+			this->nonCoherentAtomSize = std::max(limits.nonCoherentAtomSize, (VkDeviceSize)1);
+			this->blockSize = blockSize;
+		}
+
+		/**
+		* Release all device memory blocks
+		*
+		* @note Resources still bound to memory of this allocator must have been destroyed
+		*/
+		~MemoryAllocator()
+		{
+			for (auto& pool : pools)
+			{
+				for (auto& blocks : pool)
+				{
+					for (auto block : blocks)
+					{
+						destroyBlock(block);
+					}
+				}
+			}
+		}
+
+		/**
+		* Sub-allocate a memory range for a resource
+		*
+		* @param memReqs Memory requirements of the resource (size and alignment)
+		* @param memoryTypeIndex Memory type to allocate from (must be allowed by memReqs.memoryTypeBits)
+		* @param type Kind of resource the memory is bound to
+		* @param allocation Pointer to the allocation that is filled on success
+		* @param (Optional) category What the memory is used for, only used for accounting
+		*
+		* @return VK_SUCCESS or the error returned by vkAllocateMemory / vkMapMemory if a new block was needed
+		*/
+		VkResult allocate(const VkMemoryRequirements &memReqs, uint32_t memoryTypeIndex, AllocationType type, Allocation *allocation, MemoryCategory category = MEMORY_CATEGORY_OTHER)
+		{
+			assert(memoryTypeIndex < memoryProperties.memoryTypeCount);
+			assert(memReqs.memoryTypeBits & (1 << memoryTypeIndex));
+
+			VkDeviceSize alignment = std::max(memReqs.alignment, (VkDeviceSize)1);
+			// Flushes and invalidates of non-coherent memory must start at a multiple of the atom size
+			const VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+			if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+			{
+				alignment = alignUp(alignment, nonCoherentAtomSize);
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			std::vector<Block*> &blocks = pools[memoryTypeIndex][type];
+			allocation->memoryTypeIndex = memoryTypeIndex;
+			allocation->category = category;
+			allocation->allocator = this;
+
+			const bool dedicated = memReqs.size > blockSize / 2;
+			if (!dedicated)
+			{
+				for (auto block : blocks)
+				{
+					if (!block->dedicated && !block->evacuating && allocateFromBlock(block, memReqs.size, alignment, allocation))
+					{
+						addCategoryUsage(*allocation);
+						return VK_SUCCESS;
+					}
+				}
+			}
+
+			Block *block;
+			VkResult result = createBlock(memoryTypeIndex, type, dedicated ? memReqs.size : blockSize, dedicated, nullptr, &block);
+			if (result != VK_SUCCESS)
+			{
+				allocation->allocator = nullptr;
+				return result;
+			}
+			blocks.push_back(block);
+			bool allocated = allocateFromBlock(block, memReqs.size, alignment, allocation);
+			assert(allocated);
+			addCategoryUsage(*allocation);
+			return VK_SUCCESS;
+		}
+
+		/**
+		* Allocate a block of its own for a single resource
+		*
+		* @param memReqs Memory requirements of the resource
+		* @param memoryTypeIndex Memory type to allocate from (must be allowed by memReqs.memoryTypeBits)
+		* @param pNext Extension structures chained to the VkMemoryAllocateInfo, e.g. a dedicated allocation request naming the resource
+		* @param allocation Pointer to the allocation that is filled on success, the resource is bound at offset 0
+		* @param (Optional) category What the memory is used for, only used for accounting
+		*/
+		VkResult allocateDedicated(const VkMemoryRequirements &memReqs, uint32_t memoryTypeIndex, const void *pNext, Allocation *allocation, MemoryCategory category = MEMORY_CATEGORY_OTHER)
+		{
+			assert(memoryTypeIndex < memoryProperties.memoryTypeCount);
+			assert(memReqs.memoryTypeBits & (1 << memoryTypeIndex));
+
+			std::lock_guard<std::mutex> lock(mutex);
+			allocation->memoryTypeIndex = memoryTypeIndex;
+			allocation->category = category;
+			allocation->allocator = this;
+
+			Block *block;
+			VkResult result = createBlock(memoryTypeIndex, ALLOCATION_TYPE_OPTIMAL, memReqs.size, true, pNext, &block);
+			if (result != VK_SUCCESS)
+			{
+				allocation->allocator = nullptr;
+				return result;
+			}
+			// Dedicated blocks are never searched, so the pool the block is kept in doesn't matter
+			pools[memoryTypeIndex][ALLOCATION_TYPE_OPTIMAL].push_back(block);
+			bool allocated = allocateFromBlock(block, memReqs.size, 1, allocation);
+			assert(allocated);
+			addCategoryUsage(*allocation);
+			return VK_SUCCESS;
+		}
+
+		/**
+		* Return a memory range to its block
+		*
+		* @note Dedicated blocks are released immediately, regular blocks once they're empty unless it's the only empty block of its pool
+		*/
+		void free(Allocation &allocation)
+		{
+			if (allocation.allocator == nullptr)
+			{
+				return;
+			}
+			assert(allocation.allocator == this);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			Block *block = static_cast<Block*>(allocation.block);
+			block->allocationCount--;
+			block->usedBytes -= allocation.size;
+			Stats &stats = categoryStats[allocation.category];
+			stats.allocationCount--;
+			stats.usedBytes -= allocation.size;
+
+			if (block->dedicated)
+			{
+				for (auto& pool : pools[allocation.memoryTypeIndex])
+				{
+					pool.erase(std::remove(pool.begin(), pool.end(), block), pool.end());
+				}
+				destroyBlock(block);
+			}
+			else
+			{
+				// Insert the range sorted by offset and merge it with its neighbours
+				std::vector<Range> &ranges = block->freeRanges;
+				auto next = std::lower_bound(ranges.begin(), ranges.end(), allocation.offset, [](const Range &range, VkDeviceSize offset) { return range.offset < offset; });
+				auto range = ranges.insert(next, { allocation.offset, allocation.size });
+				if ((range + 1) != ranges.end() && range->offset + range->size == (range + 1)->offset)
+				{
+					range->size += (range + 1)->size;
+					ranges.erase(range + 1);
+				}
+				if (range != ranges.begin() && (range - 1)->offset + (range - 1)->size == range->offset)
+				{
+					(range - 1)->size += range->size;
+					ranges.erase(range);
+				}
+				if (block->allocationCount == 0)
+				{
+					// One empty block is kept, so a resource that's freed and allocated again (e.g. a streamed texture) doesn't allocate a new one
+					std::vector<Block*> &blocks = pools[block->memoryTypeIndex][block->type];
+					const bool spare = std::any_of(blocks.begin(), blocks.end(), [block](const Block *other) { return (other != block) && !other->dedicated && (other->allocationCount == 0); });
+					if (block->evacuating || spare)
+					{
+						if (block->evacuating)
+						{
+							evacuatingBlockCount--;
+						}
+						blocks.erase(std::remove(blocks.begin(), blocks.end(), block), blocks.end());
+						destroyBlock(block);
+						releasedBlockCount++;
+					}
+				}
+			}
+
+			allocation = Allocation();
+		}
+
+		/**
+		* Pick the blocks to be emptied by moving their resources, should be called periodically (e.g. once per second)
+		*
+		* The sparsest block of each pool whose resources fit into the free space of its other blocks is marked for evacuation
+		* New allocations avoid it, so resources that are recreated once isEvacuating returns true for them end up in the other blocks
+		* and the block is released once it's empty. A block whose usage doesn't go down for a few updates holds resources that
+		* aren't moved, its evacuation is given up until its usage changes
+		*
+		* @param maxOccupancy Only blocks using less than this share of their size are evacuated
+		*/
+		void updateDefragmentation(float maxOccupancy = 0.5f)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& pool : pools)
+			{
+				for (auto& blocks : pool)
+				{
+					Block *candidate = nullptr;
+					bool evacuating = false;
+					VkDeviceSize freeBytes = 0;
+					for (auto block : blocks)
+					{
+						if (block->dedicated)
+						{
+							continue;
+						}
+						if (block->evacuating)
+						{
+							block->stalledUpdates = (block->usedBytes < block->lastUsedBytes) ? 0 : block->stalledUpdates + 1;
+							if (block->stalledUpdates > MAX_STALLED_UPDATES)
+							{
+								block->evacuating = false;
+								block->pinnedBytes = block->usedBytes;
+								evacuatingBlockCount--;
+							}
+						}
+						block->lastUsedBytes = block->usedBytes;
+						evacuating |= block->evacuating;
+						freeBytes += block->size - block->usedBytes;
+						if ((block->usedBytes > 0) && (block->usedBytes != block->pinnedBytes) && (block->usedBytes < block->size * maxOccupancy) && (!candidate || (block->usedBytes < candidate->usedBytes)))
+						{
+							candidate = block;
+						}
+					}
+					// Free ranges may be too small for the moved resources, so the others should have some room to spare
+					if (!evacuating && candidate && (candidate->usedBytes * 2 <= freeBytes - (candidate->size - candidate->usedBytes)))
+					{
+						candidate->evacuating = true;
+						candidate->stalledUpdates = 0;
+						candidate->pinnedBytes = 0;
+						evacuatingBlockCount++;
+					}
+				}
+			}
+		}
+
+		/** @brief True if the allocation is in a block that is being evacuated, its resource should be recreated to be moved out of it */
+		bool isEvacuating(const Allocation &allocation)
+		{
+			if (allocation.allocator != this)
+			{
+				return false;
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			return static_cast<Block*>(allocation.block)->evacuating;
+		}
+
+		/** @brief Number of blocks being evacuated */
+		uint32_t getEvacuatingBlockCount()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return evacuatingBlockCount;
+		}
+
+		/** @brief Number of empty blocks that have been released */
+		uint32_t getReleasedBlockCount()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return releasedBlockCount;
+		}
+
+		/**
+		* Get the memory usage of a single memory type
+		*/
+		Stats getStats(uint32_t memoryTypeIndex)
+		{
+			assert(memoryTypeIndex < VK_MAX_MEMORY_TYPES);
+			std::lock_guard<std::mutex> lock(mutex);
+			Stats stats;
+			for (auto& blocks : pools[memoryTypeIndex])
+			{
+				for (auto block : blocks)
+				{
+					stats.blockCount++;
+					stats.allocationCount += block->allocationCount;
+					stats.blockBytes += block->size;
+					stats.usedBytes += block->usedBytes;
+				}
+			}
+			return stats;
+		}
+
+		/**
+		* Get the number of allocations and the bytes used by a category, summed over all memory types
+		*
+		* @note Block counts and bytes are left at zero, blocks are shared by the categories
+		*/
+		Stats getCategoryStats(MemoryCategory category)
+		{
+			assert(category < MEMORY_CATEGORY_COUNT);
+			std::lock_guard<std::mutex> lock(mutex);
+			return categoryStats[category];
+		}
+
+		/**
+		* Get the memory usage summed over all memory types
+		*/
+		Stats getStats()
+		{
+			Stats total;
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+			{
+				Stats stats = getStats(i);
+				total.blockCount += stats.blockCount;
+				total.allocationCount += stats.allocationCount;
+				total.blockBytes += stats.blockBytes;
+				total.usedBytes += stats.usedBytes;
+			}
+			return total;
+		}
+	};
+}
\ No newline at end of file
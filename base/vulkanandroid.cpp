@@ -274,4 +274,34 @@ void freeVulkanLibrary()
 	dlclose(libVulkan);
 }
 
+typedef void* (*PFN_AThermal_acquireManager)();
+typedef int (*PFN_AThermal_getCurrentThermalStatus)(void *manager);
+
+int32_t getThermalStatus()
+{
+	// The manager is acquired on first use and kept for the lifetime of the process
+	static bool loaded = false;
+	static void *thermalManager = nullptr;
+	static PFN_AThermal_getCurrentThermalStatus getCurrentThermalStatus = nullptr;
+	if (!loaded)
+	{
+		loaded = true;
+		void *libAndroid = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+		if (libAndroid)
+		{
+			PFN_AThermal_acquireManager acquireManager = reinterpret_cast<PFN_AThermal_acquireManager>(dlsym(libAndroid, "AThermal_acquireManager"));
+			getCurrentThermalStatus = reinterpret_cast<PFN_AThermal_getCurrentThermalStatus>(dlsym(libAndroid, "AThermal_getCurrentThermalStatus"));
+			if (acquireManager && getCurrentThermalStatus)
+			{
+				thermalManager = acquireManager();
+			}
+		}
+		if (!thermalManager)
+		{
+			__android_log_print(ANDROID_LOG_INFO, "vulkanandroid", "Thermal status not available, requires API level 30\n");
+		}
+	}
+	return thermalManager ? getCurrentThermalStatus(thermalManager) : -1;
+}
+
 #endif
@@ -150,6 +150,10 @@ bool loadVulkanLibrary();
 void loadVulkanFunctions(VkInstance instance);
 void freeVulkanLibrary();
 
+// Thermal status of the device, one of the AThermalStatus values (0 = none up to 6 = shutdown)
+// The thermal API was added with API level 30 and is loaded at runtime, returns -1 if it isn't available
+int32_t getThermalStatus();
+
 #endif
 
 #endif // VULKANANDROID_HPP
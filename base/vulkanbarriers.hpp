@@ -0,0 +1,187 @@
+/*
+* Batched pipeline barriers
+*
+* Image layout transitions and buffer barriers are collected and recorded as a single vkCmdPipelineBarrier
+* The access and stage masks are derived from the layouts and accesses of the batched barriers,
+* so the barrier only waits for the stages that actually used the resources before it
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "vulkantools.h"
+
+namespace vkTools
+{
+	class BarrierBatch
+	{
+	private:
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		VkPipelineStageFlags srcStageMask = 0;
+		VkPipelineStageFlags dstStageMask = 0;
+		// Stages shader accesses are attributed to
+		VkPipelineStageFlags shaderStages;
+
+		static const VkAccessFlags writeAccessMask =
+			VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	public:
+		/**
+		* @param shaderStages Stages that read or write the resources in shaders, other stages than compute aren't supported on compute only queues
+		*/
+		BarrierBatch(VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+			: shaderStages(shaderStages) {}
+
+		/** @brief Accesses an image in a layout may be used with */
+		static VkAccessFlags getLayoutAccessMask(VkImageLayout layout)
+		{
+			switch (layout)
+			{
+			case VK_IMAGE_LAYOUT_PREINITIALIZED:
+				// Written on the host before the transition
+				return VK_ACCESS_HOST_WRITE_BIT;
+			case VK_IMAGE_LAYOUT_GENERAL:
+				return VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+				return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+				return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+				return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+			case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+				return VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+			case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+				return VK_ACCESS_TRANSFER_READ_BIT;
+			case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+				return VK_ACCESS_TRANSFER_WRITE_BIT;
+			default:
+				// Undefined contents, and presentation which is synchronized with semaphores
+				return 0;
+			}
+		}
+
+		/** @brief Pipeline stages performing the accesses */
+		VkPipelineStageFlags getAccessStageMask(VkAccessFlags accessMask)
+		{
+			VkPipelineStageFlags stageMask = 0;
+			if (accessMask & VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
+			{
+				stageMask |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+			}
+			if (accessMask & (VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT))
+			{
+				stageMask |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+			}
+			if (accessMask & (VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT))
+			{
+				stageMask |= shaderStages;
+			}
+			if (accessMask & VK_ACCESS_INPUT_ATTACHMENT_READ_BIT)
+			{
+				stageMask |= (shaderStages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+			}
+			if (accessMask & (VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT))
+			{
+				stageMask |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			}
+			if (accessMask & (VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT))
+			{
+				stageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			}
+			if (accessMask & (VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT))
+			{
+				stageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			}
+			if (accessMask & (VK_ACCESS_HOST_READ_BIT | VK_ACCESS_HOST_WRITE_BIT))
+			{
+				stageMask |= VK_PIPELINE_STAGE_HOST_BIT;
+			}
+			if (accessMask & (VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT))
+			{
+				stageMask |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			}
+			return stageMask;
+		}
+
+		/**
+		* Queue a layout transition of an image's sub resource range
+		* Waits for the accesses of the old layout, only the writes among them are made available
+		*/
+		void imageLayout(VkImage image, VkImageLayout oldImageLayout, VkImageLayout newImageLayout, const VkImageSubresourceRange &subresourceRange)
+		{
+			const VkAccessFlags oldAccessMask = getLayoutAccessMask(oldImageLayout);
+			VkImageMemoryBarrier imageBarrier = vkTools::initializers::imageMemoryBarrier();
+			imageBarrier.oldLayout = oldImageLayout;
+			imageBarrier.newLayout = newImageLayout;
+			imageBarrier.image = image;
+			imageBarrier.subresourceRange = subresourceRange;
+			imageBarrier.srcAccessMask = oldAccessMask & writeAccessMask;
+			imageBarrier.dstAccessMask = getLayoutAccessMask(newImageLayout);
+			imageBarriers.push_back(imageBarrier);
+			srcStageMask |= getAccessStageMask(oldAccessMask);
+			dstStageMask |= getAccessStageMask(imageBarrier.dstAccessMask);
+		}
+
+		/** @brief Queue a layout transition of the first mip level and layer of an image */
+		void imageLayout(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldImageLayout, VkImageLayout newImageLayout)
+		{
+			VkImageSubresourceRange subresourceRange = {};
+			subresourceRange.aspectMask = aspectMask;
+			subresourceRange.levelCount = 1;
+			subresourceRange.layerCount = 1;
+			imageLayout(image, oldImageLayout, newImageLayout, subresourceRange);
+		}
+
+		/** @brief Queue a barrier between accesses to a range of a buffer */
+		void buffer(VkBuffer buffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE)
+		{
+			VkBufferMemoryBarrier bufferBarrier = vkTools::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = srcAccessMask & writeAccessMask;
+			bufferBarrier.dstAccessMask = dstAccessMask;
+			bufferBarrier.buffer = buffer;
+			bufferBarrier.offset = offset;
+			bufferBarrier.size = size;
+			bufferBarriers.push_back(bufferBarrier);
+			srcStageMask |= getAccessStageMask(srcAccessMask);
+			dstStageMask |= getAccessStageMask(dstAccessMask);
+		}
+
+		bool empty()
+		{
+			return imageBarriers.empty() && bufferBarriers.empty();
+		}
+
+		/** @brief Record all queued barriers as a single pipeline barrier and clear the batch */
+		void flush(VkCommandBuffer cmdBuffer)
+		{
+			if (empty())
+			{
+				return;
+			}
+			// Nothing to wait for (e.g. transitions from undefined) or nothing waiting
+			const VkPipelineStageFlags srcStages = srcStageMask ? srcStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+			const VkPipelineStageFlags dstStages = dstStageMask ? dstStageMask : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+			vkCmdPipelineBarrier(
+				cmdBuffer,
+				srcStages,
+				dstStages,
+				0,
+				0, nullptr,
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+				static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+			imageBarriers.clear();
+			bufferBarriers.clear();
+			srcStageMask = 0;
+			dstStageMask = 0;
+		}
+	};
+}
@@ -0,0 +1,205 @@
+/*
+* GPU crash breadcrumbs for diagnosing device losses
+*
+* Small command buffers submitted around a frame's passes write markers into host visible memory with vkCmdFillBuffer
+* After a device loss the markers show which passes of the frames in flight had been started and finished by the GPU
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <algorithm>
+
+#include <vulkan/vulkan.h>
+
+#include "vulkantools.h"
+#include "vulkandevice.hpp"
+#include "vulkanbuffer.hpp"
+
+namespace vkTools
+{
+	/**
+	* @brief Records the progress of the GPU through a frame's passes
+	*
+	* Every pass of every frame in flight has a begin and an end marker, both are reset by the host before the frame is submitted
+	* The begin marker is written as soon as the GPU reaches the pass, the end marker waits for all previously submitted work to finish
+	*/
+	class VulkanBreadcrumbs
+	{
+	public:
+		enum Marker
+		{
+			MARKER_BEGIN = 0,
+			MARKER_END = 1,
+			MARKER_COUNT = 2
+		};
+
+	private:
+		VkDevice device;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		// Markers of all frames in flight, MARKER_COUNT values per pass
+		vk::Buffer markers;
+
+		struct Frame
+		{
+			// MARKER_COUNT command buffers per pass
+			std::vector<VkCommandBuffer> markerCmdBuffers;
+			// Passes in submission order
+			std::vector<uint32_t> submittedPasses;
+			uint64_t frameNumber = 0;
+			bool submitted = false;
+		};
+		std::vector<Frame> frames;
+		uint32_t currentFrame = 0;
+
+		std::vector<std::string> passNames;
+
+		uint32_t getMarkerIndex(uint32_t frame, uint32_t pass, Marker marker)
+		{
+			return (frame * getPassCount() + pass) * MARKER_COUNT + marker;
+		}
+
+		uint32_t getMarker(uint32_t frame, uint32_t pass, Marker marker)
+		{
+			return static_cast<volatile uint32_t*>(markers.mapped)[getMarkerIndex(frame, pass, marker)];
+		}
+
+	public:
+		/**
+		* Create the marker buffer and the marker command buffers for all frames in flight
+		*
+		* @param vulkanDevice Device to create the breadcrumbs on
+		* @param queueFamilyIndex Queue family the marker command buffers will be submitted to, must support transfers
+		* @param framesInFlight Number of frames in flight
+		* @param passNames Names of the passes that are tracked
+		*/
+		VulkanBreadcrumbs(vk::VulkanDevice *vulkanDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight, const std::vector<std::string> &passNames)
+		{
+			assert(!passNames.empty());
+
+			this->device = vulkanDevice->logicalDevice;
+			this->passNames = passNames;
+			frames.resize(framesInFlight);
+
+			const uint32_t markerCount = framesInFlight * getPassCount() * MARKER_COUNT;
+			// Coherent, so the markers written before a device loss are visible without invalidating the memory
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&markers,
+				markerCount * sizeof(uint32_t)));
+			VK_CHECK_RESULT(markers.map());
+			memset(markers.mapped, 0, markerCount * sizeof(uint32_t));
+
+			VkCommandPoolCreateInfo cmdPoolInfo = vkTools::initializers::commandPoolCreateInfo();
+			cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
+
+			// Markers are only reset by the host, so the command buffers always write the same values and are recorded once
+			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+			for (uint32_t f = 0; f < framesInFlight; f++)
+			{
+				Frame &frame = frames[f];
+				frame.markerCmdBuffers.resize(getPassCount() * MARKER_COUNT);
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo = vkTools::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(frame.markerCmdBuffers.size()));
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, frame.markerCmdBuffers.data()));
+
+				for (uint32_t pass = 0; pass < getPassCount(); pass++)
+				{
+					for (uint32_t m = 0; m < MARKER_COUNT; m++)
+					{
+						VkCommandBuffer cmdBuffer = frame.markerCmdBuffers[pass * MARKER_COUNT + m];
+						VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+						if (m == MARKER_END)
+						{
+							// Execution dependency only, the end marker must not be written before the pass' work has finished
+							vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+						}
+						vkCmdFillBuffer(cmdBuffer, markers.buffer, getMarkerIndex(f, pass, static_cast<Marker>(m)) * sizeof(uint32_t), sizeof(uint32_t), 1);
+						VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+					}
+				}
+			}
+		}
+
+		~VulkanBreadcrumbs()
+		{
+			vkDestroyCommandPool(device, commandPool, nullptr);
+			markers.destroy();
+		}
+
+		uint32_t getPassCount()
+		{
+			return static_cast<uint32_t>(passNames.size());
+		}
+
+		/**
+		* Reset the markers of a frame in flight and make it the frame marker command buffers are taken from
+		*
+		* @param frame Index of the frame in flight
+		* @param frameNumber Number of the frame, only used for the report
+		*
+		* @note Must only be called after the frame's fence has been signaled
+		*/
+		void beginFrame(uint32_t frame, uint64_t frameNumber)
+		{
+			currentFrame = frame;
+			Frame &f = frames[frame];
+			f.frameNumber = frameNumber;
+			f.submitted = true;
+			f.submittedPasses.clear();
+			memset(static_cast<uint32_t*>(markers.mapped) + getMarkerIndex(frame, 0, MARKER_BEGIN), 0, getPassCount() * MARKER_COUNT * sizeof(uint32_t));
+		}
+
+		/**
+		* Get the command buffer writing a marker of a pass in the current frame and remember the pass as submitted
+		*
+		* @return Primary command buffer to submit right before (MARKER_BEGIN) or after (MARKER_END) the pass' command buffers
+		*/
+		VkCommandBuffer getMarkerCmdBuffer(uint32_t pass, Marker marker)
+		{
+			assert(pass < getPassCount());
+			Frame &frame = frames[currentFrame];
+			if ((marker == MARKER_BEGIN) && (std::find(frame.submittedPasses.begin(), frame.submittedPasses.end(), pass) == frame.submittedPasses.end()))
+			{
+				frame.submittedPasses.push_back(pass);
+			}
+			return frame.markerCmdBuffers[pass * MARKER_COUNT + marker];
+		}
+
+		/**
+		* Write the state of the submitted passes of all frames in flight, oldest frame first
+		* Only reads host memory, so it can be called after the device has been lost
+		*/
+		void report(std::ostream &stream)
+		{
+			std::vector<uint32_t> order;
+			for (uint32_t f = 0; f < frames.size(); f++)
+			{
+				if (frames[f].submitted)
+				{
+					order.push_back(f);
+				}
+			}
+			std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return frames[a].frameNumber < frames[b].frameNumber; });
+
+			stream << "GPU breadcrumbs of the frames in flight:" << std::endl;
+			for (auto f : order)
+			{
+				stream << "  Frame " << frames[f].frameNumber << std::endl;
+				for (auto pass : frames[f].submittedPasses)
+				{
+					const bool begun = getMarker(f, pass, MARKER_BEGIN) != 0;
+					const bool ended = getMarker(f, pass, MARKER_END) != 0;
+					stream << "    " << passNames[pass] << ": " << (ended ? "finished" : (begun ? "STARTED, NOT FINISHED" : "not started")) << std::endl;
+				}
+			}
+		}
+	};
+}
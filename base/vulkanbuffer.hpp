@@ -14,6 +14,7 @@
 
 #include "vulkan/vulkan.h"
 #include "vulkantools.h"
+#include "vulkanallocator.hpp"
 
 namespace vk
 {	
@@ -30,6 +31,8 @@ namespace vk
 		VkDeviceSize size = 0;
 		VkDeviceSize alignment = 0;
 		void* mapped = nullptr;
+		/** @brief Range of a shared memory block if the buffer was sub-allocated, memory then is the block's memory */
+		vk::Allocation allocation;
 
 		/** @brief Usage flags to be filled by external source at buffer creation (to query at some later point) */
 		VkBufferUsageFlags usageFlags;
@@ -46,6 +49,13 @@ namespace vk
 		*/
 		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0)
 		{
+			if (allocation.allocator)
+			{
+				// Sub-allocated memory is mapped for the lifetime of its block
+				assert(allocation.mapped);
+				mapped = static_cast<uint8_t*>(allocation.mapped) + offset;
+				return VK_SUCCESS;
+			}
 			return vkMapMemory(device, memory, offset, size, 0, &mapped);
 		}
 
@@ -58,7 +68,10 @@ namespace vk
 		{
 			if (mapped)
 			{
-				vkUnmapMemory(device, memory);
+				if (!allocation.allocator)
+				{
+					vkUnmapMemory(device, memory);
+				}
 				mapped = nullptr;
 			}
 		}
@@ -72,7 +85,7 @@ namespace vk
 		*/
 		VkResult bind(VkDeviceSize offset = 0)
 		{
-			return vkBindBufferMemory(device, buffer, memory, offset);
+			return vkBindBufferMemory(device, buffer, memory, allocation.offset + offset);
 		}
 
 		/**
@@ -117,7 +130,7 @@ namespace vk
 			VkMappedMemoryRange mappedRange = {};
 			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 			mappedRange.memory = memory;
-			mappedRange.offset = offset;
+			mappedRange.offset = allocation.offset + offset;
 			mappedRange.size = size;
 			return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
 		}
@@ -137,7 +150,7 @@ namespace vk
 			VkMappedMemoryRange mappedRange = {};
 			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 			mappedRange.memory = memory;
-			mappedRange.offset = offset;
+			mappedRange.offset = allocation.offset + offset;
 			mappedRange.size = size;
 			return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 		}
@@ -151,11 +164,117 @@ namespace vk
 			{
 				vkDestroyBuffer(device, buffer, nullptr);
 			}
-			if (memory)
+			if (allocation.allocator)
+			{
+				allocation.allocator->free(allocation);
+				memory = VK_NULL_HANDLE;
+			}
+			else if (memory)
 			{
 				vkFreeMemory(device, memory, nullptr);
 			}
 		}
 
 	};
+
+	/**
+	* @brief Persistently mapped host visible buffer split into one slot per frame in flight
+	* @note Ranges are reserved once before creation and exist at the same offset in every slot
+	* @note Ranges are aligned, so they can be bound with dynamic uniform buffer offsets or used as transfer sources
+	*/
+	struct RingBuffer
+	{
+		Buffer buffer;
+		uint32_t slotCount = 0;
+		/** @brief Alignment of the ranges and slots, e.g. minUniformBufferOffsetAlignment */
+		VkDeviceSize alignment = 1;
+		/** @brief Size of a slot's reserved ranges */
+		VkDeviceSize reservedSize = 0;
+
+		/**
+		* Reserve a range in every slot, must be called before the buffer is created
+		*
+		* @param size Size of the range in machine units
+		*
+		* @return Byte offset of the range within a slot
+		*/
+		VkDeviceSize reserve(VkDeviceSize size)
+		{
+			VkDeviceSize offset = align(reservedSize);
+			reservedSize = offset + size;
+			return offset;
+		}
+
+		/** @brief Distance between consecutive slots */
+		VkDeviceSize slotSize() const
+		{
+			return align(reservedSize);
+		}
+
+		/** @brief Size of the buffer to create for all slots */
+		VkDeviceSize size() const
+		{
+			return slotCount * slotSize();
+		}
+
+		/**
+		* Get the offset of a range in a slot, to be used for buffer copies or as a dynamic offset
+		*
+		* @param slot Index of the slot (frame in flight)
+		* @param rangeOffset Offset of the range as returned by reserve
+		*/
+		VkDeviceSize offset(uint32_t slot, VkDeviceSize rangeOffset) const
+		{
+			assert(slot < slotCount);
+			return slot * slotSize() + rangeOffset;
+		}
+
+		/**
+		* Copy data into a range of a slot
+		*
+		* @note The buffer stays mapped, so this is a single memcpy without any driver calls
+		*/
+		void write(uint32_t slot, VkDeviceSize rangeOffset, const void* data, VkDeviceSize size)
+		{
+			assert(buffer.mapped);
+			memcpy(static_cast<uint8_t*>(buffer.mapped) + offset(slot, rangeOffset), data, size);
+		}
+
+		/**
+		* Get a descriptor for binding a range as VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+		*
+		* @param size Size of the range in machine units
+		*
+		* @note The descriptor starts at the beginning of the buffer, the range's offset in the frame's slot is passed as the dynamic offset
+		*/
+		VkDescriptorBufferInfo dynamicDescriptor(VkDeviceSize size) const
+		{
+			VkDescriptorBufferInfo descriptor = {};
+			descriptor.buffer = buffer.buffer;
+			descriptor.offset = 0;
+			descriptor.range = size;
+			return descriptor;
+		}
+
+		/** @brief Dynamic offset of a range in a slot, for descriptors returned by dynamicDescriptor */
+		uint32_t dynamicOffset(uint32_t slot, VkDeviceSize rangeOffset) const
+		{
+			return static_cast<uint32_t>(offset(slot, rangeOffset));
+		}
+
+		/**
+		* Unmap and release the buffer
+		*/
+		void destroy()
+		{
+			buffer.unmap();
+			buffer.destroy();
+		}
+
+	private:
+		VkDeviceSize align(VkDeviceSize offset) const
+		{
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+	};
 }
\ No newline at end of file
@@ -276,6 +276,22 @@ namespace vkDebug
 		{
 			setObjectName(device, (uint64_t)_event, VK_DEBUG_REPORT_OBJECT_TYPE_EVENT_EXT, name);
 		}
+
+		ScopedRegion::ScopedRegion(VkCommandBuffer cmdBuffer, const char *name, glm::vec4 color) : cmdBuffer(cmdBuffer), zone(name)
+		{
+			if (cmdBuffer != VK_NULL_HANDLE)
+			{
+				beginRegion(cmdBuffer, name, color);
+			}
+		}
+
+		ScopedRegion::~ScopedRegion()
+		{
+			if (cmdBuffer != VK_NULL_HANDLE)
+			{
+				endRegion(cmdBuffer);
+			}
+		}
 	};
 
 }
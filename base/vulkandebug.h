@@ -21,6 +21,8 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include "cputrace.hpp"
+
 namespace vkDebug
 {
 	// Default validation layers
@@ -94,6 +96,20 @@ namespace vkDebug
 		void setSemaphoreName(VkDevice device, VkSemaphore semaphore, const char * name);
 		void setFenceName(VkDevice device, VkFence fence, const char * name);
 		void setEventName(VkDevice device, VkEvent _event, const char * name);
+
+		// Debug marker region in a command buffer and CPU trace zone covering the lifetime of the object, e.g. the recording of a pass
+		// Only the trace zone is recorded if no command buffer is passed, the name must outlive the object
+		class ScopedRegion
+		{
+		private:
+			VkCommandBuffer cmdBuffer;
+			vkTools::TraceZone zone;
+		public:
+			ScopedRegion(VkCommandBuffer cmdBuffer, const char *name, glm::vec4 color = glm::vec4(1.0f));
+			~ScopedRegion();
+			ScopedRegion(const ScopedRegion&) = delete;
+			ScopedRegion& operator=(const ScopedRegion&) = delete;
+		};
 	};
 
 }
@@ -0,0 +1,168 @@
+/*
+* Vulkan descriptor set allocation and batched descriptor updates
+*
+* Descriptor sets are allocated from a growing list of pools, so no pool has to be sized for all sets up front
+* Sets are released all at once by resetting the pools, which is much cheaper than freeing them one by one
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "vulkantools.h"
+
+namespace vk
+{
+	class DescriptorAllocator
+	{
+	private:
+		VkDevice device;
+		uint32_t setsPerPool;
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		std::vector<VkDescriptorPool> pools;
+		// Pool sets are currently allocated from and the number of sets allocated from it
+		uint32_t currentPool = 0;
+		uint32_t currentPoolSets = 0;
+
+		// Continue in the next pool, creating it if all existing pools have been used
+		void nextPool()
+		{
+			if (!pools.empty())
+			{
+				currentPool++;
+			}
+			currentPoolSets = 0;
+			if (currentPool < pools.size())
+			{
+				return;
+			}
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vkTools::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), setsPerPool);
+			VkDescriptorPool pool;
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &pool));
+			pools.push_back(pool);
+		}
+
+	public:
+		/**
+		* @param device Logical device the pools are created on
+		* @param setsPerPool Maximum number of sets allocated from each pool
+		* @param poolSizes Number of descriptors of each type in each pool
+		*/
+		DescriptorAllocator(VkDevice device, uint32_t setsPerPool, const std::vector<VkDescriptorPoolSize> &poolSizes)
+			: device(device), setsPerPool(setsPerPool), poolSizes(poolSizes)
+		{
+			assert(setsPerPool > 0);
+		}
+
+		/** @brief Destroy all pools, which frees all sets allocated from them */
+		~DescriptorAllocator()
+		{
+			for (auto pool : pools)
+			{
+				vkDestroyDescriptorPool(device, pool, nullptr);
+			}
+		}
+
+		/**
+		* Allocate a descriptor set
+		* If the current pool has run out of sets or descriptors, the set is allocated from the next pool
+		*
+		* @param layout Layout of the set
+		* @param descriptorSet Pointer to the handle of the allocated set
+		*
+		* @return VK_SUCCESS if the set has been allocated
+		*/
+		VkResult allocate(VkDescriptorSetLayout layout, VkDescriptorSet *descriptorSet)
+		{
+			if (pools.empty() || (currentPoolSets == setsPerPool))
+			{
+				nextPool();
+			}
+			VkDescriptorSetAllocateInfo allocInfo = vkTools::initializers::descriptorSetAllocateInfo(pools[currentPool], &layout, 1);
+			VkResult result = vkAllocateDescriptorSets(device, &allocInfo, descriptorSet);
+			if (result != VK_SUCCESS)
+			{
+				// The pool's descriptors of a type have run out (or it has become fragmented), a fresh pool can always hold the set
+				nextPool();
+				allocInfo.descriptorPool = pools[currentPool];
+				result = vkAllocateDescriptorSets(device, &allocInfo, descriptorSet);
+			}
+			if (result == VK_SUCCESS)
+			{
+				currentPoolSets++;
+			}
+			return result;
+		}
+
+		/**
+		* Release all sets allocated so far, the pools are kept for the following allocations
+		* @note None of the sets may still be in use by the device
+		*/
+		void reset()
+		{
+			for (auto pool : pools)
+			{
+				VK_CHECK_RESULT(vkResetDescriptorPool(device, pool, 0));
+			}
+			currentPool = 0;
+			currentPoolSets = 0;
+		}
+
+		/** @brief Number of pools created so far */
+		uint32_t getPoolCount()
+		{
+			return static_cast<uint32_t>(pools.size());
+		}
+	};
+
+	/**
+	* Collects descriptor writes and applies all of them with a single vkUpdateDescriptorSets call
+	* The image and buffer infos are copied, so the caller's infos don't have to outlive the batch
+	*/
+	class DescriptorWriteBatch
+	{
+	private:
+		std::vector<VkWriteDescriptorSet> writes;
+		// Deques keep the infos the queued writes point to in place while more are added
+		std::deque<VkDescriptorImageInfo> imageInfos;
+		std::deque<VkDescriptorBufferInfo> bufferInfos;
+
+	public:
+		void write(VkDescriptorSet descriptorSet, VkDescriptorType type, uint32_t binding, const VkDescriptorImageInfo &imageInfo)
+		{
+			imageInfos.push_back(imageInfo);
+			writes.push_back(vkTools::initializers::writeDescriptorSet(descriptorSet, type, binding, &imageInfos.back()));
+		}
+
+		void write(VkDescriptorSet descriptorSet, VkDescriptorType type, uint32_t binding, const VkDescriptorBufferInfo &bufferInfo)
+		{
+			bufferInfos.push_back(bufferInfo);
+			writes.push_back(vkTools::initializers::writeDescriptorSet(descriptorSet, type, binding, &bufferInfos.back()));
+		}
+
+		/** @brief Number of queued writes */
+		size_t size()
+		{
+			return writes.size();
+		}
+
+		/** @brief Apply and clear the queued writes */
+		void flush(VkDevice device)
+		{
+			if (!writes.empty())
+			{
+				vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+			}
+			writes.clear();
+			imageInfos.clear();
+			bufferInfos.clear();
+		}
+	};
+}
@@ -13,9 +13,17 @@
 #include <exception>
 #include <assert.h>
 #include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <map>
 #include "vulkan/vulkan.h"
 #include "vulkantools.h"
 #include "vulkanbuffer.hpp"
+#include "vulkanallocator.hpp"
+#include "vulkansamplercache.hpp"
+#include "vulkanstagingpool.hpp"
+#include "vulkantimeline.hpp"
 
 namespace vk
 {	
@@ -29,6 +37,8 @@ namespace vk
 		VkPhysicalDeviceProperties properties;
 		/** @brief Features of the physical device that an application can use to check if a feature is supported */
 		VkPhysicalDeviceFeatures features;
+		/** @brief Features that have been enabled for the logical device */
+		VkPhysicalDeviceFeatures enabledFeatures = {};
 		/** @brief Memory types and heaps of the physical device */
 		VkPhysicalDeviceMemoryProperties memoryProperties;
 		/** @brief Queue family properties of the physical device */
@@ -36,12 +46,94 @@ namespace vk
 		/** @brief List of extensions supported by the device */
 		std::vector<std::string> supportedExtensions;
 
+		/** @brief Sub-allocator all buffers and images created through this device take their memory from */
+		vk::MemoryAllocator *memoryAllocator = nullptr;
+
+		/** @brief Shared samplers for all textures created through this device */
+		vk::SamplerCache *samplerCache = nullptr;
+
+		/** @brief Recycled host visible staging buffers shared by all uploads */
+		vk::StagingPool *stagingPool = nullptr;
+
 		/** @brief Default command pool for the graphics queue family index */
 		VkCommandPool commandPool = VK_NULL_HANDLE;
 
 		/** @brief Set to true when the debug marker extension is detected */
 		bool enableDebugMarkers = false;
 
+		/**
+		* @brief Optional capabilities of the device, renderer subsystems choose their fast paths from these instead of checking extensions themselves
+		* @note Filled by createLogicalDevice, extensions are only reported if they have been enabled for the logical device
+		*/
+		struct
+		{
+			/** @brief VK_NV_dedicated_allocation, large render targets get their own memory object */
+			bool dedicatedAllocation = false;
+			/** @brief VK_AMD_rasterization_order, pipelines that don't depend on primitive order can use relaxed rasterization order */
+			bool relaxedRasterizationOrder = false;
+			/** @brief VK_AMD_draw_indirect_count, indirect draws can read their draw count from a buffer */
+			bool drawIndirectCount = false;
+			PFN_vkCmdDrawIndexedIndirectCountAMD cmdDrawIndexedIndirectCount = nullptr;
+			/** @brief Dynamically indexed sampled image arrays (shaderSampledImageArrayDynamicIndexing has been enabled) */
+			bool descriptorIndexing = false;
+			/** @brief Number of sampled images a dynamically indexed array may hold in a single stage and set */
+			uint32_t maxIndexedSampledImages = 0;
+			/** @brief VK_AMD_gpu_shader_half_float, relaxed precision shading math is evaluated in fp16 */
+			bool shaderFloat16 = false;
+			/** @brief VK_AMD_shader_ballot, subgroup ballot and reduction operations */
+			bool subgroupBallot = false;
+			/** @brief VK_KHR_shader_draw_parameters, shaders can read the index of their draw within a multi draw */
+			bool shaderDrawParameters = false;
+			/** @brief VK_KHX_multiview is supported, not enabled as the headers lack its structures */
+			bool multiview = false;
+			/**
+			* @brief Device local memory the application may fill, the size of the largest device local heap
+			* @note The heap's current usage can't be queried without VK_EXT_memory_budget, which needs a Vulkan 1.1 instance, see getMemoryHeapUsage for the usage of the memory allocator
+			*/
+			VkDeviceSize memoryBudget = 0;
+		} capabilities;
+
+		/**
+		* @brief Device level entry points of the commands recorded every frame, fetched with vkGetDeviceProcAddr
+		* @note Calls through these go straight to the driver instead of through the loader's dispatch trampoline, filled by createLogicalDevice
+		*/
+		struct
+		{
+			PFN_vkBeginCommandBuffer beginCommandBuffer = nullptr;
+			PFN_vkEndCommandBuffer endCommandBuffer = nullptr;
+			PFN_vkQueueSubmit queueSubmit = nullptr;
+			PFN_vkCmdBeginRenderPass cmdBeginRenderPass = nullptr;
+			PFN_vkCmdNextSubpass cmdNextSubpass = nullptr;
+			PFN_vkCmdEndRenderPass cmdEndRenderPass = nullptr;
+			PFN_vkCmdExecuteCommands cmdExecuteCommands = nullptr;
+			PFN_vkCmdBindPipeline cmdBindPipeline = nullptr;
+			PFN_vkCmdBindDescriptorSets cmdBindDescriptorSets = nullptr;
+			PFN_vkCmdBindVertexBuffers cmdBindVertexBuffers = nullptr;
+			PFN_vkCmdBindIndexBuffer cmdBindIndexBuffer = nullptr;
+			PFN_vkCmdPushConstants cmdPushConstants = nullptr;
+			PFN_vkCmdSetViewport cmdSetViewport = nullptr;
+			PFN_vkCmdSetScissor cmdSetScissor = nullptr;
+			PFN_vkCmdSetDepthBias cmdSetDepthBias = nullptr;
+			PFN_vkCmdDraw cmdDraw = nullptr;
+			PFN_vkCmdDrawIndexed cmdDrawIndexed = nullptr;
+			PFN_vkCmdDrawIndirect cmdDrawIndirect = nullptr;
+			PFN_vkCmdDrawIndexedIndirect cmdDrawIndexedIndirect = nullptr;
+			PFN_vkCmdDispatch cmdDispatch = nullptr;
+			PFN_vkCmdPipelineBarrier cmdPipelineBarrier = nullptr;
+			PFN_vkCmdCopyBuffer cmdCopyBuffer = nullptr;
+		} dispatch;
+
+		/** @brief Number of the frame currently being recorded, resources retired now may be used by it and all earlier frames */
+		uint64_t frameNumber = 0;
+		/** @brief Retired resources with the number of the last frame that may use each, in retirement order */
+		std::deque<std::pair<uint64_t, std::function<void()>>> retiredResources;
+		/** @brief Guards retiredResources, resources may be retired from worker threads */
+		std::mutex retiredResourcesMutex;
+
+		/** @brief Submission timelines of the queues used for one-off submits, see getQueueTimeline */
+		std::map<VkQueue, vk::QueueTimeline*> queueTimelines;
+		std::mutex queueTimelinesMutex;
+
 		/** @brief Contains queue family indices */
 		struct
 		{
@@ -97,6 +189,24 @@ namespace vk
 		*/
 		~VulkanDevice()
 		{
+			// The device must be idle at this point, so all retired resources can be destroyed
+			releaseRetiredResources(UINT64_MAX);
+			for (auto& timeline : queueTimelines)
+			{
+				delete timeline.second;
+			}
+			if (stagingPool)
+			{
+				delete stagingPool;
+			}
+			if (samplerCache)
+			{
+				delete samplerCache;
+			}
+			if (memoryAllocator)
+			{
+				delete memoryAllocator;
+			}
 			if (commandPool)
 			{
 				vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
@@ -306,6 +416,7 @@ namespace vk
 			deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());;
 			deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 			deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
+			this->enabledFeatures = enabledFeatures;
 
 			// Enable the debug marker extension if it is present (likely meaning a debugging tool is present)
 			if (vkTools::checkDeviceExtensionPresent(physicalDevice, VK_EXT_DEBUG_MARKER_EXTENSION_NAME))
@@ -314,15 +425,24 @@ namespace vk
 				enableDebugMarkers = true;
 			}
 
-			if (extensionSupported(VK_NV_DEDICATED_ALLOCATION_EXTENSION_NAME))
-			{
-				deviceExtensions.push_back(VK_NV_DEDICATED_ALLOCATION_EXTENSION_NAME);
-			}
-
-			if (extensionSupported(VK_AMD_RASTERIZATION_ORDER_EXTENSION_NAME))
+			// Optional extensions backing the device's capabilities
+			auto enableOptionalExtension = [&](const char *extension)
 			{
-				deviceExtensions.push_back(VK_AMD_RASTERIZATION_ORDER_EXTENSION_NAME);
-			}
+				if (!extensionSupported(extension))
+				{
+					return false;
+				}
+				deviceExtensions.push_back(extension);
+				return true;
+			};
+			capabilities.dedicatedAllocation = enableOptionalExtension(VK_NV_DEDICATED_ALLOCATION_EXTENSION_NAME);
+			capabilities.relaxedRasterizationOrder = enableOptionalExtension(VK_AMD_RASTERIZATION_ORDER_EXTENSION_NAME);
+			capabilities.drawIndirectCount = enableOptionalExtension(VK_AMD_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			capabilities.shaderFloat16 = enableOptionalExtension(VK_AMD_GPU_SHADER_HALF_FLOAT_EXTENSION_NAME);
+			capabilities.subgroupBallot = enableOptionalExtension(VK_AMD_SHADER_BALLOT_EXTENSION_NAME);
+			// The headers predate the extension's name define
+			capabilities.shaderDrawParameters = enableOptionalExtension("VK_KHR_shader_draw_parameters");
+			capabilities.multiview = extensionSupported("VK_KHX_multiview");
 
 			if (deviceExtensions.size() > 0)
 			{
@@ -334,13 +454,93 @@ namespace vk
 
 			if (result == VK_SUCCESS)
 			{
+				memoryAllocator = new vk::MemoryAllocator(logicalDevice, memoryProperties, properties.limits);
+				samplerCache = new vk::SamplerCache(logicalDevice, properties.limits, enabledFeatures.samplerAnisotropy == VK_TRUE);
+				stagingPool = new vk::StagingPool([this](VkDeviceSize size, vk::Buffer *buffer)
+				{
+					VK_CHECK_RESULT(createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, size));
+					VK_CHECK_RESULT(buffer->map());
+				});
 				// Create a default command pool for graphics command buffers
 				commandPool = createCommandPool(queueFamilyIndices.graphics);
+				loadDispatchTable();
+				detectCapabilities();
 			}
 
 			return result;
 		}
 
+		/** @brief Accounting category of a buffer, derived from its usage */
+		static vk::MemoryCategory getBufferMemoryCategory(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags)
+		{
+			if (usageFlags & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+			{
+				return vk::MEMORY_CATEGORY_UNIFORMS;
+			}
+			if (usageFlags & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+			{
+				return vk::MEMORY_CATEGORY_MESHES;
+			}
+			if ((usageFlags == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+			{
+				return vk::MEMORY_CATEGORY_STAGING;
+			}
+			return vk::MEMORY_CATEGORY_OTHER;
+		}
+
+		/** @brief Fetch the device level entry points of the dispatch table */
+		void loadDispatchTable()
+		{
+#define GET_DISPATCH_PROC_ADDR(member, entrypoint) \
+			dispatch.member = reinterpret_cast<PFN_vk##entrypoint>(vkGetDeviceProcAddr(logicalDevice, "vk"#entrypoint)); \
+			assert(dispatch.member)
+			GET_DISPATCH_PROC_ADDR(beginCommandBuffer, BeginCommandBuffer);
+			GET_DISPATCH_PROC_ADDR(endCommandBuffer, EndCommandBuffer);
+			GET_DISPATCH_PROC_ADDR(queueSubmit, QueueSubmit);
+			GET_DISPATCH_PROC_ADDR(cmdBeginRenderPass, CmdBeginRenderPass);
+			GET_DISPATCH_PROC_ADDR(cmdNextSubpass, CmdNextSubpass);
+			GET_DISPATCH_PROC_ADDR(cmdEndRenderPass, CmdEndRenderPass);
+			GET_DISPATCH_PROC_ADDR(cmdExecuteCommands, CmdExecuteCommands);
+			GET_DISPATCH_PROC_ADDR(cmdBindPipeline, CmdBindPipeline);
+			GET_DISPATCH_PROC_ADDR(cmdBindDescriptorSets, CmdBindDescriptorSets);
+			GET_DISPATCH_PROC_ADDR(cmdBindVertexBuffers, CmdBindVertexBuffers);
+			GET_DISPATCH_PROC_ADDR(cmdBindIndexBuffer, CmdBindIndexBuffer);
+			GET_DISPATCH_PROC_ADDR(cmdPushConstants, CmdPushConstants);
+			GET_DISPATCH_PROC_ADDR(cmdSetViewport, CmdSetViewport);
+			GET_DISPATCH_PROC_ADDR(cmdSetScissor, CmdSetScissor);
+			GET_DISPATCH_PROC_ADDR(cmdSetDepthBias, CmdSetDepthBias);
+			GET_DISPATCH_PROC_ADDR(cmdDraw, CmdDraw);
+			GET_DISPATCH_PROC_ADDR(cmdDrawIndexed, CmdDrawIndexed);
+			GET_DISPATCH_PROC_ADDR(cmdDrawIndirect, CmdDrawIndirect);
+			GET_DISPATCH_PROC_ADDR(cmdDrawIndexedIndirect, CmdDrawIndexedIndirect);
+			GET_DISPATCH_PROC_ADDR(cmdDispatch, CmdDispatch);
+			GET_DISPATCH_PROC_ADDR(cmdPipelineBarrier, CmdPipelineBarrier);
+			GET_DISPATCH_PROC_ADDR(cmdCopyBuffer, CmdCopyBuffer);
+#undef GET_DISPATCH_PROC_ADDR
+		}
+
+		/** @brief Fill the capabilities that depend on the logical device or its enabled features */
+		void detectCapabilities()
+		{
+			if (capabilities.drawIndirectCount)
+			{
+				capabilities.cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountAMD>(vkGetDeviceProcAddr(logicalDevice, "vkCmdDrawIndexedIndirectCountAMD"));
+				capabilities.drawIndirectCount = (capabilities.cmdDrawIndexedIndirectCount != nullptr);
+			}
+
+			capabilities.descriptorIndexing = (enabledFeatures.shaderSampledImageArrayDynamicIndexing == VK_TRUE);
+			capabilities.maxIndexedSampledImages = capabilities.descriptorIndexing ? std::min(properties.limits.maxPerStageDescriptorSampledImages, properties.limits.maxDescriptorSetSampledImages) : 0;
+
+			capabilities.memoryBudget = 0;
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+			{
+				if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				{
+					capabilities.memoryBudget = std::max(capabilities.memoryBudget, memoryProperties.memoryHeaps[i].size);
+				}
+			}
+		}
+
 		/**
 		* Create a buffer on the device
 		*
@@ -403,17 +603,16 @@ namespace vk
 			VkBufferCreateInfo bufferCreateInfo = vkTools::initializers::bufferCreateInfo(usageFlags, size);
 			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
-			// Create the memory backing up the buffer handle
+			// Create the memory backing up the buffer handle, sub-allocated from one of the allocator's blocks
 			VkMemoryRequirements memReqs;
-			VkMemoryAllocateInfo memAlloc = vkTools::initializers::memoryAllocateInfo();
 			vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
 			// Find a memory type index that fits the properties of the buffer
-			memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-			VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+			const uint32_t memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memoryTypeIndex, vk::ALLOCATION_TYPE_LINEAR, &buffer->allocation, getBufferMemoryCategory(usageFlags, memoryPropertyFlags)));
+			buffer->memory = buffer->allocation.memory;
 
 			buffer->alignment = memReqs.alignment;
-			buffer->size = memAlloc.allocationSize;
+			buffer->size = memReqs.size;
 			buffer->usageFlags = usageFlags;
 			buffer->memoryPropertyFlags = memoryPropertyFlags;
 
@@ -432,6 +631,144 @@ namespace vk
 			return buffer->bind();
 		}
 
+		/**
+		* Create a buffer with memory sub-allocated from the device's memory allocator
+		*
+		* @param usageFlags Usage flag bitmask for the buffer (i.e. index, vertex, uniform buffer)
+		* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
+		* @param size Size of the buffer in byes
+		* @param buffer Pointer to the buffer handle acquired by the function
+		* @param allocation Pointer to the memory range acquired by the function, release with freeMemory
+		* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+		*
+		* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+		*/
+		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, vk::Allocation *allocation, void *data = nullptr)
+		{
+			VkBufferCreateInfo bufferCreateInfo = vkTools::initializers::bufferCreateInfo(usageFlags, size);
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
+
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(logicalDevice, *buffer, &memReqs);
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), vk::ALLOCATION_TYPE_LINEAR, allocation, getBufferMemoryCategory(usageFlags, memoryPropertyFlags)));
+
+			if (data != nullptr)
+			{
+				assert(allocation->mapped);
+				memcpy(allocation->mapped, data, size);
+			}
+
+			return vkBindBufferMemory(logicalDevice, *buffer, allocation->memory, allocation->offset);
+		}
+
+		/**
+		* Allocate and bind memory for an image from the device's memory allocator
+		*
+		* @param image Image to allocate the memory for
+		* @param memoryPropertyFlags Memory properties for the image (usually device local)
+		* @param allocation Pointer to the memory range acquired by the function, release with freeMemory
+		* @param (Optional) linearTiling Set for images created with VK_IMAGE_TILING_LINEAR (defaults to false)
+		* @param (Optional) category What the image is used for, only used for accounting (defaults to textures)
+		*
+		* @return VkResult of the memory binding
+		*/
+		VkResult allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vk::Allocation *allocation, bool linearTiling = false, vk::MemoryCategory category = vk::MEMORY_CATEGORY_TEXTURES)
+		{
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+			VK_CHECK_RESULT(memoryAllocator->allocate(
+				memReqs,
+				getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags),
+				linearTiling ? vk::ALLOCATION_TYPE_LINEAR : vk::ALLOCATION_TYPE_OPTIMAL,
+				allocation,
+				category));
+			return vkBindImageMemory(logicalDevice, image, allocation->memory, allocation->offset);
+		}
+
+		/**
+		* Return a memory range acquired from the device's memory allocator
+		*/
+		void freeMemory(vk::Allocation &allocation)
+		{
+			memoryAllocator->free(allocation);
+		}
+
+		/**
+		* Get the current memory usage of all sub-allocated resources
+		*
+		* @param (Optional) memoryTypeIndex Memory type to query, defaults to the sum over all memory types
+		*/
+		vk::MemoryAllocator::Stats getMemoryStats(uint32_t memoryTypeIndex = VK_MAX_MEMORY_TYPES)
+		{
+			return (memoryTypeIndex < VK_MAX_MEMORY_TYPES) ? memoryAllocator->getStats(memoryTypeIndex) : memoryAllocator->getStats();
+		}
+
+		/**
+		* Get the number of allocations and the bytes used by one category of resources, e.g. all textures
+		*/
+		vk::MemoryAllocator::Stats getCategoryMemoryStats(vk::MemoryCategory category)
+		{
+			return memoryAllocator->getCategoryStats(category);
+		}
+
+		/** @brief Usage and budget of a memory heap */
+		struct MemoryHeapUsage
+		{
+			/** @brief Bytes of all blocks the memory allocator took from the heap */
+			VkDeviceSize blockBytes = 0;
+			/** @brief Bytes of the blocks handed out to resources, free ranges of the blocks are reused before the heap grows */
+			VkDeviceSize usedBytes = 0;
+			/** @brief Bytes the application may use, the size of the heap as the budget can't be queried without VK_EXT_memory_budget */
+			VkDeviceSize budget = 0;
+			bool deviceLocal = false;
+		};
+
+		/**
+		* Get the usage of a memory heap
+		*
+		* @note Only memory taken through the memory allocator is counted, e.g. the swap chain images and other applications aren't
+		*/
+		MemoryHeapUsage getMemoryHeapUsage(uint32_t heapIndex)
+		{
+			assert(heapIndex < memoryProperties.memoryHeapCount);
+			MemoryHeapUsage heapUsage;
+			heapUsage.budget = memoryProperties.memoryHeaps[heapIndex].size;
+			heapUsage.deviceLocal = (memoryProperties.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+			{
+				if (memoryProperties.memoryTypes[i].heapIndex == heapIndex)
+				{
+					const vk::MemoryAllocator::Stats stats = memoryAllocator->getStats(i);
+					heapUsage.blockBytes += stats.blockBytes;
+					heapUsage.usedBytes += stats.usedBytes;
+				}
+			}
+			return heapUsage;
+		}
+
+		/**
+		* Get the number of bytes by which the resources in a device local heap exceed a fraction of its budget
+		*
+		* @param (Optional) threshold Fraction of the budget that may be used before the heap is under pressure (defaults to 0.9)
+		*
+		* @return Largest excess over all device local heaps, 0 if no heap is under pressure
+		*/
+		VkDeviceSize getMemoryPressure(float threshold = 0.9f)
+		{
+			VkDeviceSize pressure = 0;
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+			{
+				const MemoryHeapUsage heapUsage = getMemoryHeapUsage(i);
+				const VkDeviceSize limit = static_cast<VkDeviceSize>(heapUsage.budget * threshold);
+				if (heapUsage.deviceLocal && (heapUsage.usedBytes > limit))
+				{
+					pressure = std::max(pressure, heapUsage.usedBytes - limit);
+				}
+			}
+			return pressure;
+		}
+
 		/**
 		* Copy buffer data from src to dst using VkCmdCopyBuffer
 		* 
@@ -457,7 +794,7 @@ namespace vk
 				bufferCopy = *copyRegion;
 			}
 
-			vkCmdCopyBuffer(copyCmd, src->buffer, dst->buffer, 1, &bufferCopy);
+			dispatch.cmdCopyBuffer(copyCmd, src->buffer, dst->buffer, 1, &bufferCopy);
 
 			flushCommandBuffer(copyCmd, queue);
 		}
@@ -502,7 +839,7 @@ namespace vk
 			if (begin)
 			{
 				VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
-				VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+				VK_CHECK_RESULT(dispatch.beginCommandBuffer(cmdBuffer, &cmdBufInfo));
 			}
 
 			return cmdBuffer;
@@ -525,23 +862,15 @@ namespace vk
 				return;
 			}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+			VK_CHECK_RESULT(dispatch.endCommandBuffer(commandBuffer));
 
 			VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
 			submitInfo.commandBufferCount = 1;
 			submitInfo.pCommandBuffers = &commandBuffer;
 
-			// Create fence to ensure that the command buffer has finished executing
-			VkFenceCreateInfo fenceInfo = vkTools::initializers::fenceCreateInfo(VK_FLAGS_NONE);
-			VkFence fence;
-			VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
-			
-			// Submit to the queue
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-			// Wait for the fence to signal that command buffer has finished executing
-			VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
-
-			vkDestroyFence(logicalDevice, fence, nullptr);
+			// Wait for exactly this submission to finish, work submitted by others to the queue isn't waited for
+			vk::QueueTimeline *timeline = getQueueTimeline(queue);
+			VK_CHECK_RESULT(timeline->wait(timeline->submit(1, &submitInfo), DEFAULT_FENCE_TIMEOUT));
 
 			if (free)
 			{
@@ -549,6 +878,31 @@ namespace vk
 			}
 		}
 
+		/**
+		* Get the submission timeline of a queue, created on first use
+		* Submit through it to wait for or poll single submissions instead of waiting for the queue to become idle
+		*/
+		vk::QueueTimeline *getQueueTimeline(VkQueue queue)
+		{
+			std::lock_guard<std::mutex> lock(queueTimelinesMutex);
+			vk::QueueTimeline *&timeline = queueTimelines[queue];
+			if (!timeline)
+			{
+				timeline = new vk::QueueTimeline(logicalDevice, queue, dispatch.queueSubmit);
+			}
+			return timeline;
+		}
+
+		/**
+		* Check if timestamps can be written on a queue family
+		*
+		* @param queueFamilyIndex Queue family the timestamps will be written on
+		*/
+		bool timestampsSupported(uint32_t queueFamilyIndex) const
+		{
+			return (properties.limits.timestampPeriod > 0.0f) && (queueFamilyProperties[queueFamilyIndex].timestampValidBits != 0);
+		}
+
 		/** 
 		* Check if an extension is supported by the (physical device)
 		*
@@ -561,5 +915,108 @@ namespace vk
 			return (std::find(supportedExtensions.begin(), supportedExtensions.end(), extension) != supportedExtensions.end());
 		}
 
+		/**
+		* Destroy a resource once the frames that may still use it have been finished by the GPU, instead of waiting for the device to become idle
+		*
+		* @param destroy Function destroying the resource, must capture the handles by value as it may be called after their owner has been destroyed
+		*
+		* @note The resource is released by releaseRetiredResources once the fence of the current frame has signaled
+		*/
+		void retire(std::function<void()> destroy)
+		{
+			std::lock_guard<std::mutex> lock(retiredResourcesMutex);
+			retiredResources.push_back({ frameNumber, std::move(destroy) });
+		}
+
+		/** @brief Retire a buffer, including its (sub-allocated) memory */
+		void retireBuffer(vk::Buffer buffer)
+		{
+			retire([buffer]() mutable { buffer.destroy(); });
+		}
+
+		/** @brief Return a staging buffer to the pool once the frames that may still copy from it have finished */
+		void retireStagingBuffer(vk::Buffer buffer)
+		{
+			vk::StagingPool *pool = stagingPool;
+			retire([pool, buffer] { pool->release(buffer); });
+		}
+
+		/** @brief Retire an image with its view and dedicated memory, any of them may be VK_NULL_HANDLE */
+		void retireImage(VkImage image, VkImageView view, VkDeviceMemory memory)
+		{
+			VkDevice device = logicalDevice;
+			retire([device, image, view, memory] {
+				vkDestroyImageView(device, view, nullptr);
+				vkDestroyImage(device, image, nullptr);
+				vkFreeMemory(device, memory, nullptr);
+			});
+		}
+
+		/** @brief Retire a pipeline */
+		void retirePipeline(VkPipeline pipeline)
+		{
+			VkDevice device = logicalDevice;
+			retire([device, pipeline] { vkDestroyPipeline(device, pipeline, nullptr); });
+		}
+
+		/**
+		* Retire a descriptor set
+		*
+		* @note The pool must have been created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+		*/
+		void retireDescriptorSet(VkDescriptorPool pool, VkDescriptorSet descriptorSet)
+		{
+			VkDevice device = logicalDevice;
+			retire([device, pool, descriptorSet] { vkFreeDescriptorSets(device, pool, 1, &descriptorSet); });
+		}
+
+		/**
+		* Retire command buffers
+		*
+		* @note The command buffers' pool must only be used by the thread releasing the retired resources
+		*/
+		void retireCommandBuffers(VkCommandPool pool, const std::vector<VkCommandBuffer> &commandBuffers)
+		{
+			VkDevice device = logicalDevice;
+			retire([device, pool, commandBuffers] { vkFreeCommandBuffers(device, pool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data()); });
+		}
+
+		/**
+		* Start recording the next frame
+		*
+		* @param finishedFrame Number of the latest frame whose fence has been waited for, its retired resources are released
+		*/
+		void beginFrame(uint64_t finishedFrame)
+		{
+			{
+				std::lock_guard<std::mutex> lock(retiredResourcesMutex);
+				frameNumber++;
+			}
+			releaseRetiredResources(finishedFrame);
+		}
+
+		/**
+		* Destroy the retired resources of all frames up to and including the given one
+		*
+		* @param finishedFrame Number of a frame that has been finished by the GPU, UINT64_MAX if the device is idle
+		*/
+		void releaseRetiredResources(uint64_t finishedFrame)
+		{
+			std::deque<std::pair<uint64_t, std::function<void()>>> released;
+			{
+				std::lock_guard<std::mutex> lock(retiredResourcesMutex);
+				while (!retiredResources.empty() && (retiredResources.front().first <= finishedFrame))
+				{
+					released.push_back(std::move(retiredResources.front()));
+					retiredResources.pop_front();
+				}
+			}
+			// Destroy outside of the lock, the functions may retire further resources
+			for (auto& resource : released)
+			{
+				resource.second();
+			}
+		}
+
 	};
 }
@@ -8,8 +8,34 @@
 
 #include "vulkanexamplebase.h"
 
+#include <thread>
+#include <new>
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 std::vector<const char*> VulkanExampleBase::args;
 
+#if defined(COUNT_ALLOCATIONS)
+// Count all heap allocations, so examples can check that their frames don't allocate (see vkTools::heapAllocationCount)
+// The array and nothrow forms call these
+void* operator new(size_t size)
+{
+	vkTools::heapAllocationCount().fetch_add(1, std::memory_order_relaxed);
+	if (void *ptr = malloc(size ? size : 1))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+#endif
+
 VkResult VulkanExampleBase::createInstance(bool enableValidation)
 {
 	this->enableValidation = enableValidation;
@@ -20,18 +46,38 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	appInfo.pEngineName = name.c_str();
 	appInfo.apiVersion = VK_API_VERSION_1_0;
 
-	std::vector<const char*> enabledExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+	std::vector<const char*> enabledExtensions;
 
 	// Enable surface extensions depending on os
+	// Headless rendering doesn't need any, so it also works on systems without a window system integration
+	if (!headless)
+	{
+		enabledExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+	}
 #if defined(_WIN32)
-	enabledExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+	if (!headless)
+	{
+		enabledExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+	}
 #elif defined(__ANDROID__)
 	enabledExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
 #elif defined(_DIRECT2DISPLAY)
 	enabledExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	if (!headless)
+	{
+		enabledExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
+	}
 #elif defined(__linux__)
-	enabledExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+	if (!headless)
+	{
+		enabledExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+	}
 #endif
+	if (enableValidation)
+	{
+		enabledExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+	}
 
 	VkInstanceCreateInfo instanceCreateInfo = {};
 	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -39,10 +85,6 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	instanceCreateInfo.pApplicationInfo = &appInfo;
 	if (enabledExtensions.size() > 0)
 	{
-		if (enableValidation)
-		{
-			enabledExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
-		}
 		instanceCreateInfo.enabledExtensionCount = (uint32_t)enabledExtensions.size();
 		instanceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
 	}
@@ -140,8 +182,8 @@ void VulkanExampleBase::flushSetupCommandBuffer()
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &setupCmdBuffer;
 
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	vk::QueueTimeline *timeline = vulkanDevice->getQueueTimeline(queue);
+	VK_CHECK_RESULT(timeline->wait(timeline->submit(1, &submitInfo)));
 
 	vkFreeCommandBuffers(device, cmdPool, 1, &setupCmdBuffer);
 	setupCmdBuffer = VK_NULL_HANDLE; 
@@ -183,8 +225,8 @@ void VulkanExampleBase::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueu
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	vk::QueueTimeline *timeline = vulkanDevice->getQueueTimeline(queue);
+	VK_CHECK_RESULT(timeline->wait(timeline->submit(1, &submitInfo)));
 
 	if (free)
 	{
@@ -192,13 +234,110 @@ void VulkanExampleBase::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueu
 	}
 }
 
+const std::string VulkanExampleBase::getPipelineCachePath()
+{
+	// One file per device, so systems with multiple GPUs don't overwrite each other's caches
+	char fileName[64];
+	snprintf(fileName, sizeof(fileName), "pipelinecache_%04x_%04x.bin", deviceProperties.vendorID, deviceProperties.deviceID);
+#if defined(__ANDROID__)
+	// Assets are read only
+	return std::string(androidApp->activity->internalDataPath) + "/" + fileName;
+#else
+	return getAssetPath() + fileName;
+#endif
+}
+
 void VulkanExampleBase::createPipelineCache()
 {
+	// Load the pipeline cache data saved by a previous run
+	// The data is only passed to the driver if its header matches this device and driver
+	std::vector<char> cacheData;
+	std::ifstream file(getPipelineCachePath(), std::ios::binary | std::ios::ate);
+	if (file.is_open())
+	{
+		cacheData.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios::beg);
+		file.read(cacheData.data(), cacheData.size());
+		if (!file)
+		{
+			cacheData.clear();
+		}
+	}
+
+	struct PipelineCacheHeader
+	{
+		uint32_t headerLength;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	} header;
+	bool validCache = false;
+	if (cacheData.size() >= sizeof(PipelineCacheHeader))
+	{
+		memcpy(&header, cacheData.data(), sizeof(PipelineCacheHeader));
+		validCache =
+			(header.headerLength >= sizeof(PipelineCacheHeader)) &&
+			(header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+			(header.vendorID == deviceProperties.vendorID) &&
+			(header.deviceID == deviceProperties.deviceID) &&
+			(memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+	}
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	if (validCache)
+	{
+		pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+		pipelineCacheCreateInfo.pInitialData = cacheData.data();
+	}
+	else if (!cacheData.empty())
+	{
+		std::cout << "Pipeline cache was created by a different device or driver, ignoring it" << std::endl;
+	}
 	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
 }
 
+void VulkanExampleBase::savePipelineCache()
+{
+	size_t dataSize = 0;
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+	if (dataSize == 0)
+	{
+		return;
+	}
+	std::vector<char> cacheData(dataSize);
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, cacheData.data()));
+
+	// Write to a temporary file first and replace the old cache with it, so an interrupted write never leaves a truncated cache behind
+	const std::string fileName = getPipelineCachePath();
+	const std::string tempFileName = fileName + ".tmp";
+	{
+		std::ofstream file(tempFileName, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "Could not write pipeline cache \"" << tempFileName << "\"" << std::endl;
+			return;
+		}
+		file.write(cacheData.data(), dataSize);
+		file.close();
+		if (!file)
+		{
+			std::remove(tempFileName.c_str());
+			return;
+		}
+	}
+#if defined(_WIN32)
+	bool replaced = MoveFileExA(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool replaced = std::rename(tempFileName.c_str(), fileName.c_str()) == 0;
+#endif
+	if (!replaced)
+	{
+		std::remove(tempFileName.c_str());
+	}
+}
+
 void VulkanExampleBase::prepare()
 {
 	if (vulkanDevice->enableDebugMarkers)
@@ -235,10 +374,38 @@ void VulkanExampleBase::prepare()
 			depthFormat,
 			&width,
 			&height,
-			shaderStages
+			shaderStages,
+			swapChain.getPresentLayout(),
+			glm::mat2(getPreRotation())
 			);
 		updateTextOverlay();
 	}
+	// Enough slots to capture the swap chain and one render target in every frame in flight without waiting for the encoder, plus the video stream
+	frameCapture = new vkTools::VulkanFrameCapture(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, 3 * framesInFlight);
+	if (!capture.prefix.empty() && !canCaptureSwapChain())
+	{
+		std::cout << "Swap chain images can't be captured, only example render targets are written" << std::endl;
+	}
+	if (!stream.output.empty())
+	{
+		if (canCaptureSwapChain() && vkTools::VideoStream::formatSupported(swapChain.colorFormat))
+		{
+			// Frames waiting for the encoder add latency, so no more than a frame in flight's worth are queued
+			videoStream = new vkTools::VideoStream(stream.output, stream.codec, swapChain.colorFormat, width, height, stream.frameRate, framesInFlight);
+		}
+		else
+		{
+			std::cout << "Swap chain images can't be streamed" << std::endl;
+		}
+	}
+	if (!telemetry.destination.empty())
+	{
+		telemetryPublisher = new vkTools::TelemetryPublisher(telemetry.destination);
+		if (telemetryPublisher->isActive())
+		{
+			std::cout << "Sending telemetry to " << telemetry.destination << " " << telemetry.rate << " times per second" << std::endl;
+		}
+	}
 }
 
 VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileName, VkShaderStageFlagBits stage)
@@ -254,9 +421,57 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 	shaderStage.pName = "main"; // todo : make param
 	assert(shaderStage.module != NULL);
 	shaderModules.push_back(shaderStage.module);
+	shaderModuleFiles[shaderStage.module] = fileName;
 	return shaderStage;
 }
 
+void VulkanExampleBase::reloadShaderModules(const std::vector<std::string> &fileNames, std::unordered_map<VkShaderModule, VkShaderModule> &replacements)
+{
+	for (auto& fileName : fileNames)
+	{
+		// The file may be read while it's being rewritten, so it's validated instead of asserting like vkTools::loadShader does
+		std::vector<uint32_t> code;
+		std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+		if (file.is_open())
+		{
+			const size_t size = static_cast<size_t>(file.tellg());
+			if ((size > 0) && (size % sizeof(uint32_t) == 0))
+			{
+				code.resize(size / sizeof(uint32_t));
+				file.seekg(0, std::ios::beg);
+				file.read(reinterpret_cast<char*>(code.data()), size);
+			}
+		}
+		// SPIR-V magic number
+		if (code.empty() || (code[0] != 0x07230203))
+		{
+			std::cout << "Could not reload shader \"" << fileName << "\"" << std::endl;
+			continue;
+		}
+
+		VkShaderModuleCreateInfo moduleCreateInfo = {};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = code.size() * sizeof(uint32_t);
+		moduleCreateInfo.pCode = code.data();
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		{
+			std::cout << "Could not reload shader \"" << fileName << "\"" << std::endl;
+			continue;
+		}
+
+		for (auto& loaded : shaderModuleFiles)
+		{
+			if (loaded.second == fileName)
+			{
+				replacements[loaded.first] = shaderModule;
+			}
+		}
+		shaderModules.push_back(shaderModule);
+		shaderModuleFiles[shaderModule] = fileName;
+	}
+}
+
 VkBool32 VulkanExampleBase::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, void * data, VkBuffer * buffer, VkDeviceMemory * memory)
 {
 	VkMemoryRequirements memReqs;
@@ -329,14 +544,7 @@ void VulkanExampleBase::loadMesh(std::string filename, vkMeshLoader::MeshBuffer
 
 void VulkanExampleBase::loadMesh(std::string filename, vkMeshLoader::MeshBuffer * meshBuffer, std::vector<vkMeshLoader::VertexLayout> vertexLayout, vkMeshLoader::MeshCreateInfo *meshCreateInfo)
 {
-	VulkanMeshLoader *mesh = new VulkanMeshLoader(vulkanDevice);
-
-#if defined(__ANDROID__)
-	mesh->assetManager = androidApp->activity->assetManager;
-#endif
-
-	mesh->LoadMesh(filename);
-	assert(mesh->m_Entries.size() > 0);
+	VulkanMeshLoader *mesh = openMesh(filename);
 
 	VkCommandBuffer copyCmd = VulkanExampleBase::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
 
@@ -355,23 +563,55 @@ void VulkanExampleBase::loadMesh(std::string filename, vkMeshLoader::MeshBuffer
 	delete(mesh);
 }
 
+VulkanMeshLoader *VulkanExampleBase::openMesh(std::string filename)
+{
+	VulkanMeshLoader *mesh = new VulkanMeshLoader(vulkanDevice);
+
+#if defined(__ANDROID__)
+	mesh->assetManager = androidApp->activity->assetManager;
+#endif
+
+	mesh->LoadMesh(filename);
+	assert(mesh->m_Entries.size() > 0);
+
+	return mesh;
+}
+
 void VulkanExampleBase::renderLoop()
 {
 	destWidth = width;
 	destHeight = height;
+	if (benchmark.active)
+	{
+		runBenchmark();
+		return;
+	}
+	if (headless)
+	{
+		renderHeadless();
+		return;
+	}
 #if defined(_WIN32)
 	MSG msg;
 	while (TRUE)
 	{
+		paceFrame();
 		auto tStart = std::chrono::high_resolution_clock::now();
 		if (viewUpdated)
 		{
 			viewUpdated = false;
 			viewChanged();
+			requestRedraw();
 		}
 
+		// Messages are only delivered to the thread that created the window, so the render thread keeps pumping them
+		// Their age is taken from the time they were posted at, in milliseconds since the system has started
 		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
 		{
+			if (((msg.message >= WM_KEYFIRST) && (msg.message <= WM_KEYLAST)) || ((msg.message >= WM_MOUSEFIRST) && (msg.message <= WM_MOUSELAST)))
+			{
+				addInputEvent(std::chrono::high_resolution_clock::now() - std::chrono::milliseconds(GetTickCount() - msg.time));
+			}
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 		}
@@ -381,25 +621,15 @@ void VulkanExampleBase::renderLoop()
 			break;
 		}
 
-		render();
-		frameCounter++;
+		if (shouldRender())
+		{
+			render();
+			frameCounter++;
+		}
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = (float)tDiff / 1000.0f;
-		camera.update(frameTimer);
-		if (camera.moving())
-		{
-			viewUpdated = true;
-		}
-		// Convert to clamped timer value
-		if (!paused)
-		{
-			timer += timerSpeed * frameTimer;
-			if (timer > 1.0)
-			{
-				timer -= 1.0f;
-			}
-		}
+		updateSimulation(frameTimer);
 		fpsTimer += (float)tDiff;
 		if (fpsTimer > 1000.0f)
 		{
@@ -424,6 +654,7 @@ void VulkanExampleBase::renderLoop()
 
 		focused = true;
 
+		paceFrame();
 		while ((ident = ALooper_pollAll(focused ? 0 : -1, NULL, &events, (void**)&source)) >= 0)
 		{
 			if (source != NULL)
@@ -449,21 +680,20 @@ void VulkanExampleBase::renderLoop()
 		if (prepared)
 		{
 			auto tStart = std::chrono::high_resolution_clock::now();
-			render();
-			frameCounter++;
+			if (shouldRender())
+			{
+				render();
+				frameCounter++;
+			}
+			// The surface's transform doesn't match the pre-rotation anymore, the new size is taken from the surface
+			if (swapChainSuboptimal)
+			{
+				windowResize();
+			}
 			auto tEnd = std::chrono::high_resolution_clock::now();
 			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 			frameTimer = tDiff / 1000.0f;
-			camera.update(frameTimer);
-			// Convert to clamped timer value
-			if (!paused)
-			{
-				timer += timerSpeed * frameTimer;
-				if (timer > 1.0)
-				{
-					timer -= 1.0f;
-				}
-			}
+			updateSimulation(frameTimer);
 			fpsTimer += (float)tDiff;
 			if (fpsTimer > 1000.0f)
 			{
@@ -471,6 +701,7 @@ void VulkanExampleBase::renderLoop()
 				updateTextOverlay();
 				fpsTimer = 0.0f;
 				frameCounter = 0;
+				thermalStatus = getThermalStatus();
 			}
 			// Check gamepad state
 			const float deadZone = 0.0015f;
@@ -501,6 +732,7 @@ void VulkanExampleBase::renderLoop()
 				if (updateView)
 				{
 					viewChanged();
+					requestRedraw();
 				}
 			}
 			else
@@ -509,6 +741,7 @@ void VulkanExampleBase::renderLoop()
 				if (updateView)
 				{
 					viewChanged();
+					requestRedraw();
 				}
 			}
 		}
@@ -516,34 +749,65 @@ void VulkanExampleBase::renderLoop()
 #elif defined(_DIRECT2DISPLAY)
 	while (!quit)
 	{
+		paceFrame();
 		auto tStart = std::chrono::high_resolution_clock::now();
 		if (viewUpdated)
 		{
 			viewUpdated = false;
 			viewChanged();
+			requestRedraw();
+		}
+		if (shouldRender())
+		{
+			render();
+			updateDisplayTiming();
+			frameCounter++;
 		}
-		render();
-		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = tDiff / 1000.0f;
-		camera.update(frameTimer);
-		if (camera.moving())
+		updateSimulation(frameTimer);
+		fpsTimer += (float)tDiff;
+		if (fpsTimer > 1000.0f)
 		{
-			viewUpdated = true;
+			lastFPS = frameCounter;
+			displayTiming.lastMissed = displayTiming.missed;
+			displayTiming.missed = 0;
+			updateTextOverlay();
+			fpsTimer = 0.0f;
+			frameCounter = 0;
 		}
-		// Convert to clamped timer value
-		if (!paused)
+	}
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	while (!quit)
+	{
+		paceFrame();
+		auto tStart = std::chrono::high_resolution_clock::now();
+		if (viewUpdated)
 		{
-			timer += timerSpeed * frameTimer;
-			if (timer > 1.0)
-			{
-				timer -= 1.0f;
-			}
+			viewUpdated = false;
+			viewChanged();
+			requestRedraw();
+		}
+		// Dispatched after the pacing wait, so the frame uses the most recent input
+		dispatchWaylandEvents(false);
+		if (shouldRender())
+		{
+			requestFrameFeedback();
+			render();
+			frameCounter++;
 		}
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		frameTimer = tDiff / 1000.0f;
+		updateSimulation(frameTimer);
 		fpsTimer += (float)tDiff;
 		if (fpsTimer > 1000.0f)
 		{
+			if (!enableTextOverlay)
+			{
+				wl_shell_surface_set_title(shellSurface, getWindowTitle().c_str());
+			}
 			lastFPS = frameCounter;
 			updateTextOverlay();
 			fpsTimer = 0.0f;
@@ -552,39 +816,60 @@ void VulkanExampleBase::renderLoop()
 	}
 #elif defined(__linux__)
 	xcb_flush(connection);
+	if (enableInputThread)
+	{
+		startInputThread();
+	}
 	while (!quit)
 	{
+		paceFrame();
 		auto tStart = std::chrono::high_resolution_clock::now();
 		if (viewUpdated)
 		{
 			viewUpdated = false;
 			viewChanged();
+			requestRedraw();
 		}
-		xcb_generic_event_t *event;
-		while ((event = xcb_poll_for_event(connection)))
-		{
-			handleEvent(event);
-			free(event);
-		}
-		render();
-		frameCounter++;
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		frameTimer = tDiff / 1000.0f;
-		camera.update(frameTimer);
-		if (camera.moving())
+		// Handled after the pacing wait, so the frame uses the most recent input
+		auto isInputEvent = [](const xcb_generic_event_t *event) {
+			const uint8_t type = event->response_type & 0x7f;
+			return (type >= XCB_KEY_PRESS) && (type <= XCB_MOTION_NOTIFY);
+		};
+		if (inputThread.joinable())
 		{
-			viewUpdated = true;
+			vkTools::InputQueue<xcb_generic_event_t*, 1024>::Event input;
+			while (inputQueue.pop(input))
+			{
+				if (isInputEvent(input.event))
+				{
+					addInputEvent(input.timestamp);
+				}
+				handleEvent(input.event);
+				free(input.event);
+			}
 		}
-		// Convert to clamped timer value
-		if (!paused)
+		else
 		{
-			timer += timerSpeed * frameTimer;
-			if (timer > 1.0)
+			xcb_generic_event_t *event;
+			while ((event = xcb_poll_for_event(connection)))
 			{
-				timer -= 1.0f;
+				if (isInputEvent(event))
+				{
+					addInputEvent(std::chrono::high_resolution_clock::now());
+				}
+				handleEvent(event);
+				free(event);
 			}
 		}
+		if (shouldRender())
+		{
+			render();
+			frameCounter++;
+		}
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		frameTimer = tDiff / 1000.0f;
+		updateSimulation(frameTimer);
 		fpsTimer += (float)tDiff;
 		if (fpsTimer > 1000.0f)
 		{
@@ -601,40 +886,997 @@ void VulkanExampleBase::renderLoop()
 			frameCounter = 0;
 		}
 	}
+	stopInputThread();
 #endif
 	// Flush device to make sure all resources can be freed 
 	vkDeviceWaitIdle(device);
+	frameCapture->flush();
+	saveFrameRecording();
 }
 
-void VulkanExampleBase::updateTextOverlay()
+void VulkanExampleBase::runBenchmark()
 {
-	if (!enableTextOverlay)
-		return;
-
-	textOverlay->beginTextUpdate();
+	vkTools::CameraPath cameraPath;
+	if (benchmark.cameraPath.empty())
+	{
+		benchmark.cameraPath = getAssetPath() + "benchmark/camerapath.txt";
+	}
+	// A replay renders the recorded frames instead of following the camera path
+	bool replay = false;
+	if (!frameRecording.replayFile.empty())
+	{
+		replay = frameRecording.frames.load(frameRecording.replayFile) && (frameRecording.frames.getFrameCount() > 0);
+		if (replay)
+		{
+			benchmark.frameCount = frameRecording.frames.getFrameCount();
+			std::cout << "Replaying \"" << frameRecording.replayFile << "\"" << std::endl;
+		}
+		else
+		{
+			std::cout << "Could not load frame recording \"" << frameRecording.replayFile << "\", benchmarking the camera path" << std::endl;
+			frameRecording.replayFile.clear();
+		}
+	}
+	const bool followPath = !replay && cameraPath.load(benchmark.cameraPath);
+	if (!replay && !followPath)
+	{
+		std::cout << "Could not load camera path \"" << benchmark.cameraPath << "\", benchmarking from the start position" << std::endl;
+	}
+	std::cout << "Benchmarking " << benchmark.frameCount << " frames" << ((benchmark.runs > 1) ? " " + std::to_string(benchmark.runs) + " times" : "") << (headless ? " (headless)" : "") << std::endl;
+
+	// Camera and animations advance by a fixed time step, so every run renders the same frames
+	const float timeStep = 1.0f / 60.0f;
+	// All measured frames and those of the current run
+	vkTools::FrameTimeStats frameTimes;
+	vkTools::FrameTimeStats runFrameTimes;
+	// Metrics of each run, compared to the baseline
+	vkTools::BenchmarkBaseline runs;
+	// GPU times are read back frames in flight later, so the first frames of a run are partly added to the previous one
+	auto finishRun = [this, &runFrameTimes, &runs]()
+	{
+		runs.metrics["frameTime.avg"].push_back(runFrameTimes.getAverage());
+		runs.metrics["frameTime.p95"].push_back(runFrameTimes.getPercentile(95.0f));
+		runs.metrics["frameTime.p99"].push_back(runFrameTimes.getPercentile(99.0f));
+		runFrameTimes = vkTools::FrameTimeStats();
+		if (gpuProfiler)
+		{
+			for (uint32_t i = 0; i < gpuProfiler->getPassCount(); i++)
+			{
+				runs.metrics["gpuPasses." + gpuProfiler->getPassName(i)].push_back(gpuProfiler->getTotalAverage(i));
+			}
+			gpuProfiler->resetTotals();
+		}
+	};
 
-	textOverlay->addText(title, 5.0f, 5.0f, VulkanTextOverlay::alignLeft);
+#if defined(__linux__) && !defined(__ANDROID__) && !defined(_DIRECT2DISPLAY) && !defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	if (!headless)
+	{
+		xcb_flush(connection);
+	}
+#endif
 
-	std::stringstream ss;
-	ss << std::fixed << std::setprecision(3) << (frameTimer * 1000.0f) << "ms (" << lastFPS << " fps)";
-	textOverlay->addText(ss.str(), 5.0f, 25.0f, VulkanTextOverlay::alignLeft);
+	for (uint32_t i = 0; i < benchmark.warmupFrames + benchmark.frameCount * benchmark.runs; i++)
+	{
+		// Window events are discarded, but must still be processed to keep the window responsive
+#if defined(_WIN32)
+		MSG msg;
+		while (!headless && PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+		{
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+		// Input is dispatched as well, the camera path overwrites its changes to the camera
+		if (!headless)
+		{
+			dispatchWaylandEvents(false);
+		}
+#elif defined(__linux__) && !defined(__ANDROID__) && !defined(_DIRECT2DISPLAY)
+		xcb_generic_event_t *event;
+		while (!headless && (event = xcb_poll_for_event(connection)))
+		{
+			free(event);
+		}
+#endif
+		if (i == benchmark.warmupFrames && gpuProfiler)
+		{
+			gpuProfiler->resetTotals();
+		}
+		// Each run starts over at the first recorded frame or the start of the path, animations go on
+		const uint32_t measuredFrame = (i > benchmark.warmupFrames) ? (i - benchmark.warmupFrames) % benchmark.frameCount : 0;
+		if ((i > benchmark.warmupFrames) && (measuredFrame == 0))
+		{
+			finishRun();
+		}
 
-	textOverlay->addText(deviceProperties.deviceName, 5.0f, 45.0f, VulkanTextOverlay::alignLeft);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		float frameTimeStep = timeStep;
+		if (replay)
+		{
+			// Warm up frames render the first recorded frame, they are restored but not compared to the recording
+			const vkTools::FrameRecording::Frame &frame = frameRecording.frames.getFrame(measuredFrame);
+			camera.setTranslation(frame.cameraPosition);
+			camera.setRotation(frame.cameraRotation);
+			timer = frame.timer;
+			frameTimer = frame.frameTime;
+			frameTimeStep = frame.frameTime;
+			viewUpdated = true;
+			replayFrameState((i >= benchmark.warmupFrames) ? &frame : nullptr);
+		}
+		if (followPath)
+		{
+			// Warm up frames are rendered at the start of the path
+			const float time = cameraPath.getDuration() * measuredFrame / std::max(benchmark.frameCount - 1, 1u);
+			glm::vec3 position, rotation;
+			cameraPath.sample(time, position, rotation);
+			camera.setTranslation(position);
+			camera.setRotation(rotation);
+			viewUpdated = true;
+		}
+		if (viewUpdated)
+		{
+			viewUpdated = false;
+			viewChanged();
+		}
+		render();
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		if (i >= benchmark.warmupFrames)
+		{
+			const float frameTime = (float)std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+			frameTimes.add(frameTime);
+			runFrameTimes.add(frameTime);
+		}
+
+		frameTimer = frameTimeStep;
+		updateSimulation(frameTimeStep);
+	}
+	if (replay)
+	{
+		replayFrameState(nullptr);
+	}
+
+	vkDeviceWaitIdle(device);
+	if (gpuProfiler)
+	{
+		// Results of the last frames in flight haven't been read by prepareFrame yet
+		for (uint32_t i = 0; i < framesInFlight; i++)
+		{
+			gpuProfiler->collect(i);
+		}
+	}
+	finishRun();
+	swapChain.flushReadbacks();
+	frameCapture->flush();
+
+	writeBenchmarkResults(frameTimes, runs);
+	saveFrameRecording();
+}
+
+void VulkanExampleBase::recordFrame()
+{
+	// Replays aren't recorded again
+	if (frameRecording.recordFile.empty() || !frameRecording.replayFile.empty() || !prepared)
+	{
+		return;
+	}
+	vkTools::FrameRecording::Frame &frame = frameRecording.frames.addFrame();
+	frame.timer = timer;
+	frame.frameTime = frameTimer;
+	frame.cameraPosition = camera.position;
+	frame.cameraRotation = camera.rotation;
+	recordFrameState(frame);
+}
+
+void VulkanExampleBase::publishTelemetry()
+{
+	// Loading frames are presented before the example's statistics exist
+	if (!telemetryPublisher || !prepared)
+	{
+		return;
+	}
+	telemetry.timer += frameTimer;
+	if (telemetry.timer < 1.0f / telemetry.rate)
+	{
+		return;
+	}
+	telemetry.timer = 0.0f;
+
+	vkTools::TelemetryPublisher::Sample sample;
+	sample.frame = vulkanDevice->frameNumber;
+	sample.frameTime = frameTimer * 1000.0f;
+	sample.fps = lastFPS;
+	if (gpuProfiler)
+	{
+		for (uint32_t i = 0; i < gpuProfiler->getPassCount(); i++)
+		{
+			sample.addPass(gpuProfiler->getPassName(i), gpuProfiler->getLast(i));
+		}
+	}
+	for (uint32_t i = 0; i < vulkanDevice->memoryProperties.memoryHeapCount; i++)
+	{
+		const vk::VulkanDevice::MemoryHeapUsage heapUsage = vulkanDevice->getMemoryHeapUsage(i);
+		if (heapUsage.deviceLocal)
+		{
+			sample.memoryUsed += heapUsage.usedBytes;
+			sample.memoryBudget += heapUsage.budget;
+		}
+	}
+	getTelemetry(sample);
+	telemetryPublisher->publish(sample);
+}
+
+void VulkanExampleBase::saveFrameRecording()
+{
+	if (frameRecording.recordFile.empty() || !frameRecording.replayFile.empty())
+	{
+		return;
+	}
+	if (frameRecording.frames.save(frameRecording.recordFile))
+	{
+		std::cout << "Recorded " << frameRecording.frames.getFrameCount() << " frames to \"" << frameRecording.recordFile << "\"" << std::endl;
+	}
+	else
+	{
+		std::cout << "Could not write frame recording \"" << frameRecording.recordFile << "\"" << std::endl;
+	}
+}
+
+void VulkanExampleBase::renderHeadless()
+{
+	std::cout << "Rendering headless";
+	if (headlessFrameCount > 0)
+	{
+		std::cout << " (" << headlessFrameCount << " frames)";
+	}
+	std::cout << std::endl;
+
+	for (uint32_t i = 0; !quit && ((headlessFrameCount == 0) || (i < headlessFrameCount)); i++)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		if (viewUpdated)
+		{
+			viewUpdated = false;
+			viewChanged();
+		}
+		render();
+		frameCounter++;
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		frameTimer = tDiff / 1000.0f;
+		updateSimulation(frameTimer);
+		fpsTimer += (float)tDiff;
+		if (fpsTimer > 1000.0f)
+		{
+			lastFPS = frameCounter;
+			updateTextOverlay();
+			fpsTimer = 0.0f;
+			frameCounter = 0;
+		}
+	}
+
+	// Flush device to make sure all resources can be freed
+	vkDeviceWaitIdle(device);
+	swapChain.flushReadbacks();
+	frameCapture->flush();
+	saveFrameRecording();
+}
+
+bool VulkanExampleBase::canCaptureSwapChain()
+{
+	return (swapChain.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) && vkTools::VulkanFrameCapture::formatSupported(swapChain.colorFormat);
+}
+
+std::string VulkanExampleBase::getCaptureFileName(const std::string &target)
+{
+	std::stringstream fileName;
+	fileName << (capture.prefix.empty() ? "screenshot" : capture.prefix) << "_";
+	if (!target.empty())
+	{
+		fileName << target << "_";
+	}
+	fileName << std::setw(5) << std::setfill('0') << vulkanDevice->frameNumber;
+	return fileName.str();
+}
+
+void VulkanExampleBase::writeReadback(uint64_t frameIndex, const void *data, uint32_t width, uint32_t height)
+{
+	std::stringstream fileName;
+	fileName << readback.prefix << "_" << std::setw(5) << std::setfill('0') << frameIndex << ".ppm";
+	std::ofstream file(fileName.str(), std::ios::out | std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cerr << "Could not write readback file \"" << fileName.str() << "\"" << std::endl;
+		return;
+	}
+	file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
+	// Headless images are BGRA, PPM stores RGB
+	assert(swapChain.colorFormat == VK_FORMAT_B8G8R8A8_UNORM);
+	const uint8_t *pixels = static_cast<const uint8_t*>(data);
+	std::vector<uint8_t> row(width * 3);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint8_t *pixel = pixels + (y * width + x) * 4;
+			row[x * 3 + 0] = pixel[2];
+			row[x * 3 + 1] = pixel[1];
+			row[x * 3 + 2] = pixel[0];
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+}
+
+void VulkanExampleBase::writeBenchmarkResults(vkTools::FrameTimeStats &frameTimes, const vkTools::BenchmarkBaseline &runs)
+{
+	auto jsonString = [](const std::string &str) {
+		std::string escaped = "\"";
+		for (auto c : str)
+		{
+			if ((c == '"') || (c == '\\'))
+			{
+				escaped += '\\';
+			}
+			escaped += c;
+		}
+		return escaped + "\"";
+	};
+
+	std::ofstream file(benchmark.resultFile, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "Could not write benchmark results to \"" << benchmark.resultFile << "\"" << std::endl;
+		return;
+	}
+
+	file << std::fixed << std::setprecision(4);
+	file << "{" << std::endl;
+	file << "\t\"example\": " << jsonString(title) << "," << std::endl;
+	file << "\t\"device\": " << jsonString(deviceProperties.deviceName) << "," << std::endl;
+	file << "\t\"width\": " << width << "," << std::endl;
+	file << "\t\"height\": " << height << "," << std::endl;
+	file << "\t\"headless\": " << (headless ? "true" : "false") << "," << std::endl;
+	file << "\t\"cameraPath\": " << jsonString(benchmark.cameraPath) << "," << std::endl;
+	if (!frameRecording.replayFile.empty())
+	{
+		file << "\t\"replay\": { \"file\": " << jsonString(frameRecording.replayFile)
+			<< ", \"stateMismatches\": " << frameRecording.stateMismatches
+			<< ", \"passMismatches\": " << frameRecording.passMismatches << " }," << std::endl;
+	}
+	file << "\t\"warmupFrames\": " << benchmark.warmupFrames << "," << std::endl;
+	file << "\t\"frames\": " << frameTimes.getCount() << "," << std::endl;
+	file << "\t\"runs\": " << benchmark.runs << "," << std::endl;
+	// All times are in milliseconds
+	file << "\t\"frameTime\": {" << std::endl;
+	file << "\t\t\"min\": " << frameTimes.getMin() << "," << std::endl;
+	file << "\t\t\"avg\": " << frameTimes.getAverage() << "," << std::endl;
+	file << "\t\t\"p95\": " << frameTimes.getPercentile(95.0f) << "," << std::endl;
+	file << "\t\t\"p99\": " << frameTimes.getPercentile(99.0f) << "," << std::endl;
+	file << "\t\t\"max\": " << frameTimes.getMax() << std::endl;
+	file << "\t}";
+	if (gpuProfiler)
+	{
+		// Averages over all runs
+		file << "," << std::endl << "\t\"gpuPasses\": {" << std::endl;
+		float total = 0.0f;
+		for (uint32_t i = 0; i < gpuProfiler->getPassCount(); i++)
+		{
+			const std::vector<float> &passTimes = runs.metrics.at("gpuPasses." + gpuProfiler->getPassName(i));
+			float passTime = 0.0f;
+			for (auto time : passTimes)
+			{
+				passTime += time / passTimes.size();
+			}
+			file << "\t\t" << jsonString(gpuProfiler->getPassName(i)) << ": " << passTime << "," << std::endl;
+			total += passTime;
+		}
+		file << "\t\t\"total\": " << total << std::endl;
+		file << "\t}";
+	}
+	file << "," << std::endl << "\t\"memory\": ";
+	writeMemoryStats(file, "\t");
+	writeShaderStats(file, "\t");
+	const bool compared = !benchmark.baselineDirectory.empty() && compareBenchmarkBaseline(file, "\t", runs);
+	file << std::endl << "}" << std::endl;
+
+	std::cout << "Benchmark results written to \"" << benchmark.resultFile << "\": "
+		<< std::fixed << std::setprecision(3) << frameTimes.getAverage() << " ms avg, "
+		<< frameTimes.getPercentile(99.0f) << " ms p99" << std::endl;
+	if (!frameRecording.replayFile.empty())
+	{
+		std::cout << "Replayed frames differing from the recording: " << frameRecording.stateMismatches << " in their state, "
+			<< frameRecording.passMismatches << " in their passes" << std::endl;
+	}
+
+	if (!benchmark.baselineDirectory.empty() && !compared)
+	{
+		const std::string baselineFile = benchmark.baselineDirectory + "/" + vkTools::BenchmarkBaseline::getFileName(deviceProperties.deviceName, deviceProperties.driverVersion);
+		std::stringstream comment;
+		comment << "Benchmark baseline of " << deviceProperties.deviceName << ", driver version " << deviceProperties.driverVersion << ", " << benchmark.runs << " runs of " << benchmark.frameCount << " frames at " << width << "x" << height;
+		if (runs.save(baselineFile, comment.str()))
+		{
+			std::cout << "Benchmark baseline written to \"" << baselineFile << "\"" << std::endl;
+		}
+		else
+		{
+			std::cout << "Could not write benchmark baseline to \"" << baselineFile << "\"" << std::endl;
+		}
+	}
+}
+
+bool VulkanExampleBase::compareBenchmarkBaseline(std::ostream &file, const std::string &indent, const vkTools::BenchmarkBaseline &runs)
+{
+	const std::string baselineFile = benchmark.baselineDirectory + "/" + vkTools::BenchmarkBaseline::getFileName(deviceProperties.deviceName, deviceProperties.driverVersion);
+	vkTools::BenchmarkBaseline baseline;
+	if (benchmark.updateBaseline || !baseline.load(baselineFile))
+	{
+		return false;
+	}
+
+	std::string escapedFile;
+	for (auto c : baselineFile)
+	{
+		escapedFile += ((c == '"') || (c == '\\')) ? std::string("\\") + c : std::string(1, c);
+	}
+
+	// Metrics missing from either side (e.g. passes that have been added or removed) aren't compared
+	uint32_t regressions = 0;
+	file << "," << std::endl << indent << "\"regressions\": {" << std::endl;
+	file << indent << "\t\"baseline\": \"" << escapedFile << "\"," << std::endl;
+	file << indent << "\t\"threshold\": " << benchmark.regressionThreshold << "," << std::endl;
+	file << indent << "\t\"metrics\": {";
+	bool first = true;
+	for (auto& metric : runs.metrics)
+	{
+		auto baselineMetric = baseline.metrics.find(metric.first);
+		if (baselineMetric == baseline.metrics.end())
+		{
+			continue;
+		}
+		const vkTools::RegressionTest test(baselineMetric->second, metric.second, benchmark.regressionThreshold / 100.0f);
+		file << (first ? "" : ",") << std::endl << indent << "\t\t\"" << metric.first << "\": { "
+			<< "\"baseline\": " << test.baseline
+			<< ", \"current\": " << test.current
+			<< ", \"change\": " << test.change * 100.0f
+			<< ", \"baselineRuns\": " << test.baselineCount
+			<< ", \"currentRuns\": " << test.currentCount
+			<< ", \"significant\": " << (test.significant ? "true" : "false")
+			<< ", \"regressed\": " << (test.regressed ? "true" : "false") << " }";
+		first = false;
+		if (test.regressed)
+		{
+			std::cout << "Regression of " << metric.first << ": " << std::fixed << std::setprecision(3) << test.baseline << " ms -> " << test.current << " ms ("
+				<< std::showpos << std::setprecision(1) << test.change * 100.0f << std::noshowpos << "%)" << std::endl;
+			regressions++;
+		}
+	}
+	file << std::endl << indent << "\t}," << std::endl;
+	file << indent << "\t\"count\": " << regressions << std::endl;
+	file << indent << "}";
+
+	std::cout << "Compared to benchmark baseline \"" << baselineFile << "\": " << regressions << " regressions" << std::endl;
+	if (regressions > 0)
+	{
+		exitCode = 2;
+	}
+	return true;
+}
+
+void VulkanExampleBase::writeShaderStats(std::ostream &file, const std::string &indent)
+{
+	std::map<std::string, std::vector<VkShaderModule>> pipelines;
+	getPipelineShaders(pipelines);
+	if (pipelines.empty())
+	{
+		return;
+	}
+
+	// The drivers' register counts and occupancy can't be queried without VK_KHR_pipeline_executable_properties, so the SPIR-V is analyzed instead
+	// Paths are relative to the asset path, sorted like the pipelines so the results can be diffed
+	std::map<std::string, vkTools::ShaderStatistics> shaders;
+	auto getShaderName = [this](VkShaderModule module) {
+		auto loaded = shaderModuleFiles.find(module);
+		if (loaded == shaderModuleFiles.end())
+		{
+			return std::string();
+		}
+		const std::string assetPath = getAssetPath();
+		return (loaded->second.compare(0, assetPath.size(), assetPath) == 0) ? loaded->second.substr(assetPath.size()) : loaded->second;
+	};
+	for (auto& pipeline : pipelines)
+	{
+		for (auto module : pipeline.second)
+		{
+			const std::string name = getShaderName(module);
+			if (!name.empty() && (shaders.find(name) == shaders.end()) && !shaders[name].analyze(shaderModuleFiles[module]))
+			{
+				std::cout << "Could not analyze shader \"" << shaderModuleFiles[module] << "\"" << std::endl;
+				shaders.erase(name);
+			}
+		}
+	}
+
+	file << "," << std::endl << indent << "\"shaders\": {";
+	bool first = true;
+	for (auto& shader : shaders)
+	{
+		const vkTools::ShaderStatistics &stats = shader.second;
+		file << (first ? "" : ",") << std::endl << indent << "\t\"" << shader.first << "\": { "
+			<< "\"instructions\": " << stats.instructions
+			<< ", \"functions\": " << stats.functions
+			<< ", \"imageInstructions\": " << stats.imageInstructions
+			<< ", \"branches\": " << stats.branches
+			<< ", \"loops\": " << stats.loops
+			<< ", \"barriers\": " << stats.barriers
+			<< ", \"localVariables\": " << stats.localVariables
+			<< ", \"estimatedRegisters\": " << stats.estimatedRegisters << " }";
+		first = false;
+	}
+	file << std::endl << indent << "}," << std::endl;
+
+	file << indent << "\"pipelines\": {";
+	first = true;
+	for (auto& pipeline : pipelines)
+	{
+		file << (first ? "" : ",") << std::endl << indent << "\t\"" << pipeline.first << "\": [";
+		for (size_t i = 0; i < pipeline.second.size(); i++)
+		{
+			file << ((i > 0) ? ", " : " ") << "\"" << getShaderName(pipeline.second[i]) << "\"";
+		}
+		file << " ]";
+		first = false;
+	}
+	file << std::endl << indent << "}";
+}
+
+void VulkanExampleBase::writeMemoryStats(std::ostream &file, const std::string &indent)
+{
+	// All sizes are in bytes
+	file << "{" << std::endl;
+	file << indent << "\t\"heaps\": [" << std::endl;
+	for (uint32_t i = 0; i < vulkanDevice->memoryProperties.memoryHeapCount; i++)
+	{
+		const vk::VulkanDevice::MemoryHeapUsage heapUsage = vulkanDevice->getMemoryHeapUsage(i);
+		file << indent << "\t\t{ \"deviceLocal\": " << (heapUsage.deviceLocal ? "true" : "false")
+			<< ", \"budget\": " << heapUsage.budget
+			<< ", \"blockBytes\": " << heapUsage.blockBytes
+			<< ", \"usedBytes\": " << heapUsage.usedBytes << " }"
+			<< ((i + 1 < vulkanDevice->memoryProperties.memoryHeapCount) ? "," : "") << std::endl;
+	}
+	file << indent << "\t]," << std::endl;
+	file << indent << "\t\"categories\": {" << std::endl;
+	for (uint32_t i = 0; i < vk::MEMORY_CATEGORY_COUNT; i++)
+	{
+		const vk::MemoryCategory category = static_cast<vk::MemoryCategory>(i);
+		const vk::MemoryAllocator::Stats stats = vulkanDevice->getCategoryMemoryStats(category);
+		file << indent << "\t\t\"" << vk::getMemoryCategoryName(category) << "\": { \"allocations\": " << stats.allocationCount << ", \"usedBytes\": " << stats.usedBytes << " }"
+			<< ((i + 1 < vk::MEMORY_CATEGORY_COUNT) ? "," : "") << std::endl;
+	}
+	file << indent << "\t}" << std::endl;
+	file << indent << "}";
+}
+
+void VulkanExampleBase::writeMemoryReport()
+{
+	// Written to a temporary file first, so the report can be polled without reading a partially written file
+	const std::string tempFile = memoryReportFile + ".tmp";
+	{
+		std::ofstream file(tempFile, std::ios::out | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "Could not write memory report \"" << memoryReportFile << "\"" << std::endl;
+			memoryReportFile.clear();
+			return;
+		}
+		writeMemoryStats(file, "");
+		file << std::endl;
+	}
+#if defined(_WIN32)
+	// rename doesn't overwrite existing files on Windows
+	remove(memoryReportFile.c_str());
+#endif
+	rename(tempFile.c_str(), memoryReportFile.c_str());
+}
+
+void VulkanExampleBase::updateTextOverlay()
+{
+	if (!memoryReportFile.empty())
+	{
+		writeMemoryReport();
+	}
+
+	if (!enableTextOverlay)
+		return;
+
+	// Only the overlay's CPU side copy of the text is updated, frames in flight keep their text until their command buffer is submitted again
+	textOverlay->beginTextUpdate();
+	const VkExtent2D viewExtent = getViewExtent();
+
+	textOverlay->addText(title, 5.0f, 5.0f, VulkanTextOverlay::alignLeft);
+
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(3) << (frameTimer * 1000.0f) << "ms (" << lastFPS << " fps)";
+	if (lowLatency)
+	{
+		ss << ", latency " << frameLatency.average << "ms";
+	}
+	if (inputLatency.average > 0.0f)
+	{
+		ss << ", input " << inputLatency.average << "ms";
+	}
+	if (onDemand.enabled)
+	{
+		ss << ", on demand " << onDemand.lastRedrawRate << " redraws/s";
+	}
+	if (frameLimiter.targetRate > 0.0f)
+	{
+		ss << ", limited to " << std::setprecision(0) << frameLimiter.targetRate << " fps (" << std::setprecision(3) << frameLimiter.waitAverage << "ms wait)";
+	}
+#if defined(_DIRECT2DISPLAY)
+	if (swapChain.displayRefreshRate > 0.0f)
+	{
+		ss << ", " << swapChain.displayRefreshRate << " Hz display (" << displayTiming.interval << "ms, " << displayTiming.lastMissed << " missed)";
+	}
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	if (frameFeedback.interval > 0.0f)
+	{
+		ss << ", shown every " << frameFeedback.interval << "ms";
+	}
+#endif
+	textOverlay->addText(ss.str(), 5.0f, 25.0f, VulkanTextOverlay::alignLeft);
+
+	textOverlay->addText(deviceProperties.deviceName, 5.0f, 45.0f, VulkanTextOverlay::alignLeft);
+
+	if (gpuProfiler)
+	{
+		// Rolling GPU time averages of the example's passes in the upper right corner
+		float total = 0.0f;
+		for (uint32_t i = 0; i < gpuProfiler->getPassCount(); i++)
+		{
+			std::stringstream ss;
+			ss << std::fixed << std::setprecision(3) << gpuProfiler->getPassName(i) << ": " << gpuProfiler->getAverage(i) << "ms";
+			textOverlay->addText(ss.str(), (float)viewExtent.width - 5.0f, 5.0f + 20.0f * i, VulkanTextOverlay::alignRight);
+			total += gpuProfiler->getAverage(i);
+		}
+		std::stringstream ss;
+		// Share of the last second the GPU spent on the frames' passes, shows how much the frame limiter saves
+		ss << std::fixed << std::setprecision(3) << "GPU: " << total << "ms, " << std::setprecision(0) << std::min(total * lastFPS * 0.1f, 100.0f) << "% busy";
+		textOverlay->addText(ss.str(), (float)viewExtent.width - 5.0f, 5.0f + 20.0f * gpuProfiler->getPassCount(), VulkanTextOverlay::alignRight);
+	}
+
+	{
+		// Device memory below the GPU times, in MB
+		float y = gpuProfiler ? 5.0f + 20.0f * (gpuProfiler->getPassCount() + 1) : 5.0f;
+		for (uint32_t i = 0; i < vulkanDevice->memoryProperties.memoryHeapCount; i++)
+		{
+			const vk::VulkanDevice::MemoryHeapUsage heapUsage = vulkanDevice->getMemoryHeapUsage(i);
+			if (!heapUsage.deviceLocal)
+			{
+				continue;
+			}
+			std::stringstream ss;
+			ss << "Device memory: " << (heapUsage.usedBytes >> 20) << " (" << (heapUsage.blockBytes >> 20) << " allocated) of " << (heapUsage.budget >> 20) << " MB";
+			textOverlay->addText(ss.str(), (float)viewExtent.width - 5.0f, y, VulkanTextOverlay::alignRight);
+			y += 20.0f;
+		}
+		std::stringstream ss;
+		for (uint32_t i = 0; i < vk::MEMORY_CATEGORY_COUNT; i++)
+		{
+			const vk::MemoryCategory category = static_cast<vk::MemoryCategory>(i);
+			ss << ((i > 0) ? ", " : "") << vk::getMemoryCategoryName(category) << " " << (vulkanDevice->getCategoryMemoryStats(category).usedBytes >> 20);
+		}
+		textOverlay->addText(ss.str(), (float)viewExtent.width - 5.0f, y, VulkanTextOverlay::alignRight);
+	}
+
+	getOverlayText(textOverlay);
+
+	textOverlay->endTextUpdate();
+}
+
+void VulkanExampleBase::getOverlayText(VulkanTextOverlay *textOverlay)
+{
+	// Can be overriden in derived class
+}
+
+void VulkanExampleBase::prepareGpuProfiler(const std::vector<std::string> &passNames)
+{
+	if (!vkTools::VulkanGpuProfiler::supported(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics))
+	{
+		std::cout << "Graphics queue doesn't support timestamps, GPU pass timing disabled" << std::endl;
+		return;
+	}
+	gpuProfiler = new vkTools::VulkanGpuProfiler(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, framesInFlight, passNames);
+	if (!gpuProfilerLog.empty() && !gpuProfiler->openLog(gpuProfilerLog))
+	{
+		std::cout << "Could not open GPU profiler log \"" << gpuProfilerLog << "\"" << std::endl;
+	}
+}
+
+void VulkanExampleBase::addInputEvent(std::chrono::high_resolution_clock::time_point timestamp)
+{
+	if ((inputLatency.pendingEvent.time_since_epoch().count() == 0) || (timestamp < inputLatency.pendingEvent))
+	{
+		inputLatency.pendingEvent = timestamp;
+	}
+}
+
+void VulkanExampleBase::updateInputLatency()
+{
+	// Frames skipped when rendering on demand don't present, the events are counted for the next presented frame
+	if (inputLatency.pendingEvent.time_since_epoch().count() == 0)
+	{
+		return;
+	}
+	const float latency = (float)std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - inputLatency.pendingEvent).count();
+	inputLatency.average = (inputLatency.average == 0.0f) ? latency : glm::mix(inputLatency.average, latency, 0.05f);
+	inputLatency.pendingEvent = std::chrono::high_resolution_clock::time_point();
+}
+
+#if defined(_DIRECT2DISPLAY)
+void VulkanExampleBase::updateDisplayTiming()
+{
+	// With FIFO presentation the frames are held back by the display, so the interval between them is a multiple of the refresh interval
+	auto now = std::chrono::high_resolution_clock::now();
+	if ((displayTiming.lastPresent.time_since_epoch().count() != 0) && (swapChain.displayRefreshRate > 0.0f))
+	{
+		const float interval = (float)std::chrono::duration<double, std::milli>(now - displayTiming.lastPresent).count();
+		displayTiming.interval = (displayTiming.interval == 0.0f) ? interval : glm::mix(displayTiming.interval, interval, 0.05f);
+		const float refreshInterval = 1000.0f / swapChain.displayRefreshRate;
+		const uint32_t expected = std::max(displayTiming.limitDivisor, 1u);
+		const uint32_t refreshes = static_cast<uint32_t>(interval / refreshInterval + 0.5f);
+		if (refreshes > expected)
+		{
+			displayTiming.missed += refreshes - expected;
+		}
+	}
+	displayTiming.lastPresent = now;
+}
+#endif
+
+void VulkanExampleBase::limitFrameRate()
+{
+	auto now = std::chrono::high_resolution_clock::now();
+	const std::chrono::duration<double> interval(1.0 / frameLimiter.targetRate);
+	auto deadline = frameLimiter.deadline + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(interval);
+	// Frames that took longer than an interval restart the schedule, instead of rendering the missed frames as fast as possible
+	if (deadline < now)
+	{
+		frameLimiter.deadline = now;
+		frameLimiter.waitAverage = glm::mix(frameLimiter.waitAverage, 0.0f, 0.05f);
+		return;
+	}
+	const auto start = now;
+	const std::chrono::duration<double, std::milli> spinTime(frameLimiter.spinTime);
+	if (deadline - now > spinTime)
+	{
+		std::this_thread::sleep_for(deadline - now - std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(spinTime));
+	}
+	while ((now = std::chrono::high_resolution_clock::now()) < deadline)
+	{
+		std::this_thread::yield();
+	}
+	frameLimiter.deadline = deadline;
+	frameLimiter.waitAverage = glm::mix(frameLimiter.waitAverage, (float)std::chrono::duration<double, std::milli>(now - start).count(), 0.05f);
+}
+
+void VulkanExampleBase::paceFrame()
+{
+	if (!prepared)
+	{
+		return;
+	}
+	if (frameLimiter.targetRate > 0.0f)
+	{
+		limitFrameRate();
+	}
+#if defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	if (frameFeedback.throttle)
+	{
+		// Hidden surfaces don't get frame callbacks, the wait gives up on them after a while
+		auto start = std::chrono::high_resolution_clock::now();
+		while (frameFeedback.callback && (std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() < 100.0))
+		{
+			dispatchWaylandEvents(true);
+		}
+	}
+#endif
+	if (!lowLatency)
+	{
+		return;
+	}
+	// Waiting here instead of in prepareFrame makes the frame use the most recent input, the wait in prepareFrame then returns immediately
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &frameFences[currentFrame], VK_TRUE, UINT64_MAX));
+	// The fence has just been signaled for the frame last sampled in this slot, unless the GPU was idle before the wait
+	// Display scanout isn't included, so this is a lower bound for the input to photon latency
+	auto now = std::chrono::high_resolution_clock::now();
+	auto &sampleTime = frameLatency.sampleTimes[currentFrame];
+	if (sampleTime.time_since_epoch().count() != 0)
+	{
+		const float latency = (float)std::chrono::duration<double, std::milli>(now - sampleTime).count();
+		frameLatency.average = (frameLatency.average == 0.0f) ? latency : glm::mix(frameLatency.average, latency, 0.05f);
+	}
+	sampleTime = now;
+}
+
+bool VulkanExampleBase::shouldRender()
+{
+	if (!onDemand.enabled)
+	{
+		return true;
+	}
+	auto now = std::chrono::high_resolution_clock::now();
+	if (std::chrono::duration<double>(now - onDemand.rateStart).count() >= 1.0)
+	{
+		onDemand.lastRedrawRate = onDemand.redrawCount;
+		onDemand.lastSkipRate = onDemand.skipCount;
+		onDemand.redrawCount = 0;
+		onDemand.skipCount = 0;
+		onDemand.rateStart = now;
+	}
+	const bool changed = onDemand.redrawRequested || viewUpdated || camera.moving() || sceneAnimating();
+	onDemand.redrawRequested = false;
+	if (changed)
+	{
+		onDemand.settleCounter = onDemand.settleFrames;
+	}
+	const bool refresh = std::chrono::duration<double>(now - onDemand.lastRedraw).count() * onDemand.refreshRate >= 1.0;
+	if (changed || refresh || (onDemand.settleCounter > 0))
+	{
+		if (!changed && (onDemand.settleCounter > 0))
+		{
+			onDemand.settleCounter--;
+		}
+		onDemand.lastRedraw = now;
+		onDemand.redrawCount++;
+		return true;
+	}
+	onDemand.skipCount++;
+	// Nothing to render, sleep for a short time to stay responsive to input without spinning
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	return false;
+}
+
+void VulkanExampleBase::requestRedraw()
+{
+	onDemand.redrawRequested = true;
+}
+
+bool VulkanExampleBase::sceneAnimating()
+{
+	return !paused;
+}
+
+void VulkanExampleBase::recordFrameState(vkTools::FrameRecording::Frame &frame)
+{
+}
+
+void VulkanExampleBase::replayFrameState(const vkTools::FrameRecording::Frame *frame)
+{
+}
+
+void VulkanExampleBase::getTelemetry(vkTools::TelemetryPublisher::Sample &sample)
+{
+}
+
+void VulkanExampleBase::getPipelineShaders(std::map<std::string, std::vector<VkShaderModule>> &pipelines)
+{
+}
+
+void VulkanExampleBase::updateSimulation(float frameTime)
+{
+	auto advanceTimer = [this](float &value, float deltaTime)
+	{
+		// Convert to clamped timer value
+		if (!paused)
+		{
+			value += timerSpeed * deltaTime;
+			if (value > 1.0)
+			{
+				value -= 1.0f;
+			}
+		}
+	};
 
-	getOverlayText(textOverlay);
+	if (!simulation.enabled)
+	{
+		simulation.deltaTime = frameTime;
+		camera.update(frameTime);
+		advanceTimer(timer, frameTime);
+	}
+	else
+	{
+		// The frame time doesn't include the pacing and the on demand sleeps, which the simulation has to keep up with
+		// Benchmarks simulate the time step they pass in, so their results don't depend on the frame rate
+		auto now = std::chrono::high_resolution_clock::now();
+		float elapsed = frameTime;
+		if (simulation.started && !benchmark.active)
+		{
+			elapsed = (float)std::chrono::duration<double>(now - simulation.lastUpdate).count();
+		}
+		simulation.lastUpdate = now;
+		if (!simulation.started)
+		{
+			simulation.clock = vkTools::SimulationClock(simulation.rate);
+			simulation.timer = simulation.previousTimer = timer;
+			simulation.started = true;
+		}
 
-	textOverlay->endTextUpdate();
-}
+		const uint32_t steps = simulation.clock.advance(elapsed);
+		const float step = simulation.clock.getStep();
+		for (uint32_t i = 0; i < steps; i++)
+		{
+			simulation.previousTimer = simulation.timer;
+			camera.update(step);
+			advanceTimer(simulation.timer, step);
+		}
+		simulation.deltaTime = steps * step;
 
-void VulkanExampleBase::getOverlayText(VulkanTextOverlay *textOverlay)
-{
-	// Can be overriden in derived class
+		// Render between the last two states, the timer may have wrapped around in the last step
+		const float alpha = simulation.clock.getAlpha();
+		const float previousTimer = (simulation.previousTimer > simulation.timer) ? simulation.previousTimer - 1.0f : simulation.previousTimer;
+		timer = glm::mix(previousTimer, simulation.timer, alpha);
+		if (timer < 0.0f)
+		{
+			timer += 1.0f;
+		}
+		camera.interpolate(alpha);
+		if (camera.interpolating())
+		{
+			viewUpdated = true;
+		}
+	}
+	if (camera.moving())
+	{
+		viewUpdated = true;
+	}
 }
 
 void VulkanExampleBase::prepareFrame()
 {
+	// Wait until the GPU has finished the last frame that used this frame's resources
+	{
+		vkTools::TraceZone zone("Wait for frame");
+		VK_CHECK_RESULT(vkWaitForFences(device, 1, &frameFences[currentFrame], VK_TRUE, UINT64_MAX));
+	}
+	semaphores = frameSemaphores[currentFrame];
+	// The fence belongs to the frame prepared framesInFlight frames ago, all frames up to it have been finished
+	const uint64_t frameNumber = vulkanDevice->frameNumber + 1;
+	const uint64_t finishedFrame = (frameNumber >= framesInFlight) ? frameNumber - framesInFlight : 0;
+	vulkanDevice->beginFrame(finishedFrame);
+	// Copies submitted with the finished frames can be encoded now
+	frameCapture->update(finishedFrame);
+	capture.active = capture.requested || (!capture.prefix.empty() && (frameNumber % capture.interval == 0));
+	capture.requested = false;
+	// The frame's timestamps are available now, so reading them doesn't stall
+	if (gpuProfiler)
+	{
+		gpuProfiler->collect(currentFrame);
+	}
 	// Acquire the next image from the swap chaing
-	VK_CHECK_RESULT(swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer));
+	{
+		vkTools::TraceZone zone("Acquire image");
+		VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+#if defined(__ANDROID__)
+		// The image can still be presented, the swap chain is recreated after the frame
+		if (result == VK_SUBOPTIMAL_KHR)
+		{
+			swapChainSuboptimal = true;
+			result = VK_SUCCESS;
+		}
+#endif
+		VK_CHECK_RESULT(result);
+		// Images may be returned out of order, so an older frame in flight may still be rendering to it
+		if ((imageFences[currentBuffer] != VK_NULL_HANDLE) && (imageFences[currentBuffer] != frameFences[currentFrame]))
+		{
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &imageFences[currentBuffer], VK_TRUE, UINT64_MAX));
+		}
+	}
+	imageFences[currentBuffer] = frameFences[currentFrame];
+	VK_CHECK_RESULT(vkResetFences(device, 1, &frameFences[currentFrame]));
+	// The last frame that submitted the overlay's command buffer for this image has finished
+	if (enableTextOverlay)
+	{
+		textOverlay->updateFrame(currentBuffer);
+	}
 }
 
 void VulkanExampleBase::submitFrame()
@@ -671,16 +1913,127 @@ void VulkanExampleBase::submitFrame()
 		submitInfo.pSignalSemaphores = &semaphores.renderComplete;
 	}
 
-	VK_CHECK_RESULT(swapChain.queuePresent(queue, currentBuffer, submitTextOverlay ? semaphores.textOverlayComplete : semaphores.renderComplete));
+	// An empty submission signals the fence once all work previously submitted for this frame has completed
+	// This way examples don't need to know which of their submissions is the last one
+	if (gpuProfiler)
+	{
+		// The final timestamp ends the last pass, which includes the text overlay
+		VkCommandBuffer timestampCmdBuffer = gpuProfiler->getTimestampCmdBuffer(currentFrame, gpuProfiler->getPassCount());
+		VkSubmitInfo timestampSubmitInfo = vkTools::initializers::submitInfo();
+		timestampSubmitInfo.commandBufferCount = 1;
+		timestampSubmitInfo.pCommandBuffers = &timestampCmdBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &timestampSubmitInfo, frameFences[currentFrame]));
+		gpuProfiler->frameSubmitted(currentFrame);
+	}
+	else
+	{
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 0, nullptr, frameFences[currentFrame]));
+	}
+
+	{
+		vkTools::TraceZone zone("Present");
+		VkResult result = swapChain.queuePresent(queue, currentBuffer, submitTextOverlay ? semaphores.textOverlayComplete : semaphores.renderComplete);
+#if defined(__ANDROID__)
+		if (result == VK_SUBOPTIMAL_KHR)
+		{
+			swapChainSuboptimal = true;
+			result = VK_SUCCESS;
+		}
+#endif
+		VK_CHECK_RESULT(result);
+	}
+	updateInputLatency();
+	recordFrame();
+	publishTelemetry();
+
+	currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void VulkanExampleBase::getFrameEndCommandBuffers(vkTools::ArenaVector<VkCommandBuffer> &cmdBuffers)
+{
+	// Captured before the text overlay is drawn on top
+	if (capture.active && canCaptureSwapChain())
+	{
+		VkCommandBuffer captureCmdBuffer = frameCapture->capture(swapChain.images[currentBuffer], swapChain.colorFormat, width, height, swapChain.getPresentLayout(), getCaptureFileName(""), vulkanDevice->frameNumber, true);
+		if (captureCmdBuffer != VK_NULL_HANDLE)
+		{
+			cmdBuffers.push_back(captureCmdBuffer);
+		}
+	}
+	if (videoStream && videoStream->isActive())
+	{
+		VkCommandBuffer captureCmdBuffer = frameCapture->capture(swapChain.images[currentBuffer], swapChain.colorFormat, width, height, swapChain.getPresentLayout(),
+			[this](const void *data, uint32_t width, uint32_t height, VkFormat format) { videoStream->addFrame(data, width, height); }, vulkanDevice->frameNumber);
+		if (captureCmdBuffer != VK_NULL_HANDLE)
+		{
+			cmdBuffers.push_back(captureCmdBuffer);
+		}
+	}
+	// No semaphore is required between the example's command buffers and the overlay, the overlay's render pass synchronizes with prior color writes
+	if (enableTextOverlay && textOverlay->visible)
+	{
+		cmdBuffers.push_back(textOverlay->cmdBuffers[currentBuffer]);
+	}
+	if (gpuProfiler)
+	{
+		cmdBuffers.push_back(gpuProfiler->getTimestampCmdBuffer(currentFrame, gpuProfiler->getPassCount()));
+	}
+}
+
+VkFence VulkanExampleBase::getFrameFence()
+{
+	return frameFences[currentFrame];
+}
+
+void VulkanExampleBase::presentFrame()
+{
+	if (gpuProfiler)
+	{
+		gpuProfiler->frameSubmitted(currentFrame);
+	}
+
+	{
+		vkTools::TraceZone zone("Present");
+		VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+#if defined(__ANDROID__)
+		if (result == VK_SUBOPTIMAL_KHR)
+		{
+			swapChainSuboptimal = true;
+			result = VK_SUCCESS;
+		}
+#endif
+		VK_CHECK_RESULT(result);
+	}
+	updateInputLatency();
+	recordFrame();
+	publishTelemetry();
+
+	currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void VulkanExampleBase::retireResource(std::function<void()> destroy)
+{
+	vulkanDevice->retire(std::move(destroy));
+}
+
+void VulkanExampleBase::renewCommandBuffers()
+{
+	vulkanDevice->retireCommandBuffers(cmdPool, drawCmdBuffers);
+	createCommandBuffers();
+}
 
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+void VulkanExampleBase::waitForFramesInFlight()
+{
+	VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(frameFences.size()), frameFences.data(), VK_TRUE, UINT64_MAX));
+	vulkanDevice->releaseRetiredResources(vulkanDevice->frameNumber);
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation, PFN_GetEnabledFeatures enabledFeaturesFn)
 {
 	// Parse command line arguments
-	for (auto arg : args)
+	for (size_t i = 0; i < args.size(); i++)
 	{
+		std::string arg(args[i]);
 		if (arg == std::string("-validation"))
 		{
 			enableValidation = true;
@@ -689,6 +2042,200 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation, PFN_GetEnabledFeatur
 		{
 			enableVSync = true;
 		}
+		if (arg == std::string("-benchmark"))
+		{
+			benchmark.active = true;
+		}
+		if ((arg == std::string("-benchmarkframes")) && (i + 1 < args.size()))
+		{
+			benchmark.frameCount = std::max(atoi(args[++i]), 1);
+		}
+		if ((arg == std::string("-benchmarkpath")) && (i + 1 < args.size()))
+		{
+			benchmark.cameraPath = args[++i];
+		}
+		if ((arg == std::string("-record")) && (i + 1 < args.size()))
+		{
+			frameRecording.recordFile = args[++i];
+		}
+		if ((arg == std::string("-replay")) && (i + 1 < args.size()))
+		{
+			frameRecording.replayFile = args[++i];
+			benchmark.active = true;
+		}
+		if ((arg == std::string("-benchmarkresult")) && (i + 1 < args.size()))
+		{
+			benchmark.resultFile = args[++i];
+		}
+		if ((arg == std::string("-benchmarkruns")) && (i + 1 < args.size()))
+		{
+			benchmark.runs = std::max(atoi(args[++i]), 1);
+		}
+		if ((arg == std::string("-benchmarkbaseline")) && (i + 1 < args.size()))
+		{
+			benchmark.baselineDirectory = args[++i];
+		}
+		if (arg == std::string("-benchmarkupdatebaseline"))
+		{
+			benchmark.updateBaseline = true;
+		}
+		if ((arg == std::string("-benchmarkthreshold")) && (i + 1 < args.size()))
+		{
+			benchmark.regressionThreshold = std::max(static_cast<float>(atof(args[++i])), 0.0f);
+		}
+		if (arg == std::string("-headless"))
+		{
+			headless = true;
+		}
+		if ((arg == std::string("-headlessframes")) && (i + 1 < args.size()))
+		{
+			headlessFrameCount = static_cast<uint32_t>(std::max(atoi(args[++i]), 0));
+		}
+		if ((arg == std::string("-readback")) && (i + 1 < args.size()))
+		{
+			readback.prefix = args[++i];
+		}
+		if ((arg == std::string("-readbackinterval")) && (i + 1 < args.size()))
+		{
+			readback.interval = static_cast<uint32_t>(std::max(atoi(args[++i]), 1));
+		}
+		if ((arg == std::string("-capture")) && (i + 1 < args.size()))
+		{
+			capture.prefix = args[++i];
+		}
+		if ((arg == std::string("-captureinterval")) && (i + 1 < args.size()))
+		{
+			capture.interval = static_cast<uint32_t>(std::max(atoi(args[++i]), 1));
+		}
+		if ((arg == std::string("-videostream")) && (i + 1 < args.size()))
+		{
+			stream.output = args[++i];
+		}
+		if ((arg == std::string("-videocodec")) && (i + 1 < args.size()))
+		{
+			stream.codec = args[++i];
+		}
+		if ((arg == std::string("-videofps")) && (i + 1 < args.size()))
+		{
+			stream.frameRate = static_cast<uint32_t>(std::max(atoi(args[++i]), 1));
+		}
+		if ((arg == std::string("-telemetry")) && (i + 1 < args.size()))
+		{
+			telemetry.destination = args[++i];
+		}
+		if ((arg == std::string("-telemetryrate")) && (i + 1 < args.size()))
+		{
+			telemetry.rate = static_cast<uint32_t>(std::max(atoi(args[++i]), 1));
+		}
+		if ((arg == std::string("-gpu")) && (i + 1 < args.size()))
+		{
+			selectedGPU = static_cast<uint32_t>(std::max(atoi(args[++i]), 0));
+		}
+		if ((arg == std::string("-gpuprofilelog")) && (i + 1 < args.size()))
+		{
+			gpuProfilerLog = args[++i];
+		}
+		if ((arg == std::string("-memoryreport")) && (i + 1 < args.size()))
+		{
+			memoryReportFile = args[++i];
+		}
+		if ((arg == std::string("-trace")) && (i + 1 < args.size()))
+		{
+			traceFile = args[++i];
+		}
+		if (arg == std::string("-lowlatency"))
+		{
+			lowLatency = true;
+		}
+		if (arg == std::string("-nothreadaffinity"))
+		{
+			vkTools::CpuTopology::get().enabled = false;
+		}
+		if ((arg == std::string("-framelimit")) && (i + 1 < args.size()))
+		{
+			frameLimiter.targetRate = std::max(static_cast<float>(atof(args[++i])), 0.0f);
+		}
+		if ((arg == std::string("-framelimitspin")) && (i + 1 < args.size()))
+		{
+			frameLimiter.spinTime = std::max(static_cast<float>(atof(args[++i])), 0.0f);
+		}
+#if defined(_DIRECT2DISPLAY)
+		if ((arg == std::string("-d2ddisplay")) && (i + 1 < args.size()))
+		{
+			swapChain.requestedDisplay = static_cast<uint32_t>(std::max(atoi(args[++i]), 0));
+		}
+		if ((arg == std::string("-d2drefresh")) && (i + 1 < args.size()))
+		{
+			swapChain.requestedRefreshRate = static_cast<uint32_t>(std::max(atoi(args[++i]), 0));
+		}
+		if ((arg == std::string("-d2dlimit")) && (i + 1 < args.size()))
+		{
+			displayTiming.limitDivisor = static_cast<uint32_t>(std::max(atoi(args[++i]), 0));
+		}
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+		if (arg == std::string("-waylandthrottle"))
+		{
+			frameFeedback.throttle = true;
+		}
+#elif defined(__linux__) && !defined(__ANDROID__) && !defined(_DIRECT2DISPLAY)
+		if (arg == std::string("-noinputthread"))
+		{
+			enableInputThread = false;
+		}
+#endif
+		if (arg == std::string("-ondemand"))
+		{
+			onDemand.enabled = true;
+		}
+		if (arg == std::string("-fixedstep"))
+		{
+			simulation.enabled = true;
+		}
+		if ((arg == std::string("-fixedsteprate")) && (i + 1 < args.size()))
+		{
+			simulation.rate = std::max((float)atof(args[++i]), 1.0f);
+		}
+		if ((arg == std::string("-ondemandrefresh")) && (i + 1 < args.size()))
+		{
+			onDemand.refreshRate = std::max((float)atof(args[++i]), 0.1f);
+		}
+		if ((arg == std::string("-swapchainimages")) && (i + 1 < args.size()))
+		{
+			swapchainImageCount = static_cast<uint32_t>(std::max(atoi(args[++i]), 0));
+		}
+		if ((arg == std::string("-framesinflight")) && (i + 1 < args.size()))
+		{
+			// Clamp to 1..3, more frames only add latency
+			int32_t frameCount = atoi(args[++i]);
+			framesInFlight = static_cast<uint32_t>(std::max(1, std::min(frameCount, 3)));
+		}
+		if ((arg == std::string("-anisotropy")) && (i + 1 < args.size()))
+		{
+			int32_t tier = atoi(args[++i]);
+			anisotropyTier = static_cast<vk::AnisotropyTier>(std::max(0, std::min(tier, static_cast<int32_t>(vk::ANISOTROPY_TIER_ULTRA))));
+		}
+		if ((arg == std::string("-verbosity")) && (i + 1 < args.size()))
+		{
+			verbosity = static_cast<uint32_t>(std::max(0, std::min(atoi(args[++i]), 2)));
+		}
+	}
+	// Records and submits the frames
+	vkTools::CpuTopology::get().setThreadRole(vkTools::CpuTopology::THREAD_ROLE_LATENCY);
+	// Started right away so the trace covers loading
+	if (!traceFile.empty())
+	{
+		vkTools::CpuTrace::get().open(traceFile);
+		vkTools::CpuTrace::get().setThreadName("Main thread");
+	}
+	if (lowLatency)
+	{
+		// Every queued frame adds a display interval of latency
+		framesInFlight = 1;
+		if (swapchainImageCount == 0)
+		{
+			// Clamped to the surface's minimum image count
+			swapchainImageCount = 1;
+		}
 	}
 #if defined(__ANDROID__)
 	// Vulkan library is loaded dynamically on Android
@@ -696,8 +2243,17 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation, PFN_GetEnabledFeatur
 	assert(libLoaded);
 #elif defined(_DIRECT2DISPLAY)
 
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	if (!headless)
+	{
+		initWaylandConnection();
+	}
 #elif defined(__linux__)
-	initxcbConnection();
+	inputThreadStop = false;
+	if (!headless)
+	{
+		initxcbConnection();
+	}
 #endif
 
 	if (enabledFeaturesFn != nullptr)
@@ -722,6 +2278,21 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation, PFN_GetEnabledFeatur
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	if (!traceFile.empty())
+	{
+		if (vkTools::CpuTrace::get().close())
+		{
+			std::cout << "Trace written to \"" << traceFile << "\"" << std::endl;
+		}
+		else
+		{
+			std::cout << "Could not write trace \"" << traceFile << "\"" << std::endl;
+		}
+	}
+
+	// The device is idle once the render loop has been left
+	vulkanDevice->releaseRetiredResources(UINT64_MAX);
+
 	// Clean up Vulkan resources
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
@@ -748,6 +2319,7 @@ VulkanExampleBase::~VulkanExampleBase()
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.mem, nullptr);
 
+	savePipelineCache();
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
 	if (textureLoader)
@@ -757,15 +2329,41 @@ VulkanExampleBase::~VulkanExampleBase()
 
 	vkDestroyCommandPool(device, cmdPool, nullptr);
 
-	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.textOverlayComplete, nullptr);
+	for (uint32_t i = 0; i < framesInFlight; i++)
+	{
+		vkDestroySemaphore(device, frameSemaphores[i].presentComplete, nullptr);
+		vkDestroySemaphore(device, frameSemaphores[i].renderComplete, nullptr);
+		vkDestroySemaphore(device, frameSemaphores[i].textOverlayComplete, nullptr);
+		vkDestroyFence(device, frameFences[i], nullptr);
+	}
 
 	if (enableTextOverlay)
 	{
 		delete textOverlay;
 	}
 
+	if (gpuProfiler)
+	{
+		delete gpuProfiler;
+	}
+
+	// Pending captures may still be streamed
+	if (frameCapture)
+	{
+		delete frameCapture;
+	}
+
+	if (videoStream)
+	{
+		std::cout << "Video stream: " << videoStream->getStreamedCount() << " frames streamed, " << videoStream->getDroppedCount() << " dropped" << std::endl;
+		delete videoStream;
+	}
+
+	if (telemetryPublisher)
+	{
+		delete telemetryPublisher;
+	}
+
 	delete vulkanDevice;
 
 	if (enableValidation)
@@ -777,12 +2375,47 @@ VulkanExampleBase::~VulkanExampleBase()
 
 #if defined(_DIRECT2DISPLAY)
 
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	if (!headless)
+	{
+		if (frameFeedback.callback)
+		{
+			wl_callback_destroy(frameFeedback.callback);
+		}
+		if (pointer)
+		{
+			wl_pointer_destroy(pointer);
+		}
+		if (keyboard)
+		{
+			wl_keyboard_destroy(keyboard);
+		}
+		if (shellSurface)
+		{
+			wl_shell_surface_destroy(shellSurface);
+		}
+		if (surface)
+		{
+			wl_surface_destroy(surface);
+		}
+		if (seat)
+		{
+			wl_seat_destroy(seat);
+		}
+		wl_shell_destroy(shell);
+		wl_compositor_destroy(compositor);
+		wl_registry_destroy(registry);
+		wl_display_disconnect(display);
+	}
 #elif defined(__linux)
 #if defined(__ANDROID__)
 	// todo : android cleanup (if required)
 #else
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	if (!headless)
+	{
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #endif
 #endif
 }
@@ -825,18 +2458,49 @@ void VulkanExampleBase::initVulkan(bool enableValidation)
 		vkTools::exitFatal("Could not enumerate physical devices : \n" + vkTools::errorString(err), "Fatal error");
 	}
 
-	// Note :
-	// This example will always use the first physical device reported,
-	// change the vector index if you have multiple Vulkan devices installed
-	// and want to use another one
-	physicalDevice = physicalDevices[0];
+	// Systems with multiple GPUs run one instance per GPU, selected with -gpu
+	if (gpuCount > 1)
+	{
+		const char *deviceTypes[] = { "other", "integrated", "discrete", "virtual", "cpu" };
+		for (uint32_t i = 0; i < gpuCount; i++)
+		{
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(physicalDevices[i], &properties);
+			std::cout << "GPU " << i << ": " << properties.deviceName << " (" << deviceTypes[std::min<uint32_t>(properties.deviceType, 4)] << ")" << ((i == selectedGPU) ? " [selected]" : "") << std::endl;
+		}
+	}
+	if (selectedGPU >= gpuCount)
+	{
+		std::cout << "GPU " << selectedGPU << " is not available, using GPU 0" << std::endl;
+		selectedGPU = 0;
+	}
+	physicalDevice = physicalDevices[selectedGPU];
 
 	// Vulkan device creation
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
 	vulkanDevice = new vk::VulkanDevice(physicalDevice);
-	VK_CHECK_RESULT(vulkanDevice->createLogicalDevice(enabledFeatures));
+	// Optional features requested by the example that the device doesn't support are not enabled
+	// Examples check vulkanDevice->enabledFeatures before using them
+	const VkBool32 *supportedFeatures = reinterpret_cast<const VkBool32*>(&vulkanDevice->features);
+	VkBool32 *requestedFeatures = reinterpret_cast<VkBool32*>(&enabledFeatures);
+	for (size_t i = 0; i < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); i++)
+	{
+		requestedFeatures[i] = requestedFeatures[i] && supportedFeatures[i];
+	}
+	// Request a dedicated transfer queue for asynchronous uploads if the device has a transfer only queue family
+	VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+	for (auto& queueFamily : vulkanDevice->queueFamilyProperties)
+	{
+		if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			requestedQueueTypes |= VK_QUEUE_TRANSFER_BIT;
+		}
+	}
+	// The swap chain extension is not required for headless rendering, so devices without presentation support can be used
+	VK_CHECK_RESULT(vulkanDevice->createLogicalDevice(enabledFeatures, !headless, requestedQueueTypes));
 	device = vulkanDevice->logicalDevice;
+	vulkanDevice->samplerCache->setAnisotropyTier(anisotropyTier);
 
 	// todo: remove
 	// Store properties (including limits) and features of the phyiscal device
@@ -848,28 +2512,52 @@ void VulkanExampleBase::initVulkan(bool enableValidation)
 
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
+	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.transfer, 0, &transferQueue);
+	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.compute, 0, &computeQueue);
 
 	// Find a suitable depth format
 	VkBool32 validDepthFormat = vkTools::getSupportedDepthFormat(physicalDevice, &depthFormat);
 	assert(validDepthFormat);
 
+	if (headless)
+	{
+		swapChain.initHeadless(vulkanDevice, queue);
+		if (!readback.prefix.empty())
+		{
+			swapChain.enableReadback(readback.interval, [this](uint64_t frameIndex, const void *data, uint32_t width, uint32_t height)
+			{
+				writeReadback(frameIndex, data, width, height);
+			});
+		}
+	}
 	swapChain.connect(instance, physicalDevice, device);
 
-	// Create synchronization objects
+	// Create synchronization objects (one set per frame in flight)
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vkTools::initializers::semaphoreCreateInfo();
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queu
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been sumbitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands for the text overlay have been sumbitted and executed
-	// Will be inserted after the render complete semaphore if the text overlay is enabled
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.textOverlayComplete));
+	// Fences are created signaled so the first wait for each frame returns immediately
+	VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	frameSemaphores.resize(framesInFlight);
+	frameFences.resize(framesInFlight);
+	frameLatency.sampleTimes.resize(framesInFlight);
+	for (uint32_t i = 0; i < framesInFlight; i++)
+	{
+		// Create a semaphore used to synchronize image presentation
+		// Ensures that the image is displayed before we start submitting new commands to the queu
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frameSemaphores[i].presentComplete));
+		// Create a semaphore used to synchronize command submission
+		// Ensures that the image is not presented until all commands have been sumbitted and executed
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frameSemaphores[i].renderComplete));
+		// Create a semaphore used to synchronize command submission
+		// Ensures that the image is not presented until all commands for the text overlay have been sumbitted and executed
+		// Will be inserted after the render complete semaphore if the text overlay is enabled
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frameSemaphores[i].textOverlayComplete));
+		// Create a fence used to wait on the CPU until the GPU has finished the frame
+		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &frameFences[i]));
+	}
+	semaphores = frameSemaphores[currentFrame];
 
 	// Set up submit info structure
-	// Semaphores will stay the same during application lifetime
+	// The semaphores member is switched to the current frame's semaphores in prepareFrame
 	// Command buffer submission info is set by each example
 	submitInfo = vkTools::initializers::submitInfo();
 	submitInfo.pWaitDstStageMask = &submitPipelineStages;
@@ -894,6 +2582,11 @@ HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 {
 	this->windowInstance = hinstance;
 
+	if (headless)
+	{
+		return nullptr;
+	}
+
 	bool fullscreen = false;
 	for (auto arg : args)
 	{
@@ -1016,6 +2709,7 @@ HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 
 void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
+	requestRedraw();
 	switch (uMsg)
 	{
 	case WM_CLOSE:
@@ -1038,6 +2732,9 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 				textOverlay->visible = !textOverlay->visible;
 			}
 			break;
+		case KEY_F12:
+			capture.requested = true;
+			break;
 		case KEY_ESCAPE:
 			PostQuitMessage(0);
 			break;
@@ -1153,6 +2850,7 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 int32_t VulkanExampleBase::handleAppInput(struct android_app* app, AInputEvent* event)
 {
 	VulkanExampleBase* vulkanExample = reinterpret_cast<VulkanExampleBase*>(app->userData);
+	vulkanExample->requestRedraw();
 	if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_MOTION)
 	{
 		if (AInputEvent_getSource(event) == AINPUT_SOURCE_JOYSTICK)
@@ -1246,6 +2944,8 @@ void VulkanExampleBase::handleAppCommand(android_app * app, int32_t cmd)
 	case APP_CMD_GAINED_FOCUS:
 		LOGD("APP_CMD_GAINED_FOCUS");
 		vulkanExample->focused = true;
+		// The device may have heated up while the app was in the background
+		vulkanExample->thermalStatus = getThermalStatus();
 		break;
 	case APP_CMD_TERM_WINDOW:
 		// Window is hidden or closed, clean up resources
@@ -1255,10 +2955,383 @@ void VulkanExampleBase::handleAppCommand(android_app * app, int32_t cmd)
 	}
 }
 #elif defined(_DIRECT2DISPLAY)
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+// Connect to the compositor and bind the globals the example uses
+void VulkanExampleBase::initWaylandConnection()
+{
+	display = wl_display_connect(NULL);
+	if (benchmark.active && !display)
+	{
+		// Benchmarks can run without a window system
+		std::cout << "Could not connect to the Wayland compositor, running the benchmark headless" << std::endl;
+		headless = true;
+		return;
+	}
+	if (!display)
+	{
+		vkTools::exitFatal("Could not connect to the Wayland compositor", "Fatal error");
+	}
+
+	static const wl_registry_listener registryListener = { registryGlobal, registryGlobalRemove };
+	registry = wl_display_get_registry(display);
+	wl_registry_add_listener(registry, &registryListener, this);
+	// Globals are announced in the first roundtrip, the seat's capabilities in the second
+	wl_display_roundtrip(display);
+	wl_display_roundtrip(display);
+	if (!compositor || !shell)
+	{
+		vkTools::exitFatal("Wayland compositor doesn't support wl_compositor and wl_shell", "Fatal error");
+	}
+}
+
+// Set up a shell surface, the swap chain's images are attached to it by the Vulkan driver
+wl_shell_surface *VulkanExampleBase::setupWindow()
+{
+	if (headless)
+	{
+		return nullptr;
+	}
+
+	bool fullscreen = false;
+	for (auto arg : args)
+	{
+		if (arg == std::string("-fullscreen"))
+		{
+			fullscreen = true;
+		}
+	}
+
+	surface = wl_compositor_create_surface(compositor);
+	shellSurface = wl_shell_get_shell_surface(shell, surface);
+	static const wl_shell_surface_listener shellSurfaceListener = { shellSurfacePing, shellSurfaceConfigure, shellSurfacePopupDone };
+	wl_shell_surface_add_listener(shellSurface, &shellSurfaceListener, this);
+
+	// Opaque surfaces don't have to be blended with what's below them, so the compositor can scan their buffers out
+	// directly (or put them on an overlay plane) instead of copying them into its own frame
+	wl_region *region = wl_compositor_create_region(compositor);
+	wl_region_add(region, 0, 0, INT32_MAX, INT32_MAX);
+	wl_surface_set_opaque_region(surface, region);
+	wl_region_destroy(region);
+
+	if (fullscreen)
+	{
+		// Lets the compositor switch the output's mode to the surface's size, a fullscreen surface covering the output is scanned out as is
+		wl_shell_surface_set_fullscreen(shellSurface, WL_SHELL_SURFACE_FULLSCREEN_METHOD_DRIVER, 0, NULL);
+	}
+	else
+	{
+		wl_shell_surface_set_toplevel(shellSurface);
+	}
+	wl_shell_surface_set_title(shellSurface, getWindowTitle().c_str());
+	wl_display_flush(display);
+
+	return shellSurface;
+}
+
+void VulkanExampleBase::dispatchWaylandEvents(bool wait)
+{
+	// Fails while the events another reader (e.g. the driver's wsi) has read are still queued, these are dispatched first
+	while (wl_display_prepare_read(display) != 0)
+	{
+		wl_display_dispatch_pending(display);
+	}
+	wl_display_flush(display);
+	pollfd fd = { wl_display_get_fd(display), POLLIN, 0 };
+	if (poll(&fd, 1, wait ? 10 : 0) > 0)
+	{
+		wl_display_read_events(display);
+	}
+	else
+	{
+		wl_display_cancel_read(display);
+	}
+	if (wl_display_dispatch_pending(display) < 0)
+	{
+		// Connection to the compositor has been lost
+		quit = true;
+	}
+}
+
+void VulkanExampleBase::requestFrameFeedback()
+{
+	if (headless || frameFeedback.callback)
+	{
+		return;
+	}
+	// Frame callbacks are part of the surface's pending state, so this one is committed with the image presented next
+	static const wl_callback_listener frameListener = { frameCallbackDone };
+	frameFeedback.callback = wl_surface_frame(surface);
+	wl_callback_add_listener(frameFeedback.callback, &frameListener, this);
+}
+
+void VulkanExampleBase::frameFeedbackDone(uint32_t time)
+{
+	const uint32_t interval = time - frameFeedback.lastTime;
+	// Intervals of more than a second are pauses of the rendering (e.g. on demand), not of the compositor
+	if ((frameFeedback.lastTime != 0) && (interval < 1000))
+	{
+		frameFeedback.interval = (frameFeedback.interval == 0.0f) ? (float)interval : glm::mix(frameFeedback.interval, (float)interval, 0.05f);
+	}
+	frameFeedback.lastTime = time;
+}
+
+void VulkanExampleBase::pointerMoved(float x, float y)
+{
+	if (mouseButtons.left)
+	{
+		rotation.x += (mousePos.y - y) * 1.25f;
+		rotation.y -= (mousePos.x - x) * 1.25f;
+		camera.rotate(glm::vec3((mousePos.y - y) * camera.rotationSpeed, -(mousePos.x - x) * camera.rotationSpeed, 0.0f));
+		viewUpdated = true;
+	}
+	if (mouseButtons.right)
+	{
+		zoom += (mousePos.y - y) * .005f;
+		camera.translate(glm::vec3(-0.0f, 0.0f, (mousePos.y - y) * .005f * zoomSpeed));
+		viewUpdated = true;
+	}
+	if (mouseButtons.middle)
+	{
+		cameraPos.x -= (mousePos.x - x) * 0.01f;
+		cameraPos.y -= (mousePos.y - y) * 0.01f;
+		camera.translate(glm::vec3(-(mousePos.x - x) * 0.01f, -(mousePos.y - y) * 0.01f, 0.0f));
+		viewUpdated = true;
+	}
+	mousePos = glm::vec2(x, y);
+}
+
+void VulkanExampleBase::handlePointerButton(uint32_t button, bool pressed)
+{
+	// Linux input event codes (BTN_LEFT, BTN_RIGHT and BTN_MIDDLE of linux/input-event-codes.h)
+	switch (button)
+	{
+	case 0x110:
+		mouseButtons.left = pressed;
+		break;
+	case 0x111:
+		mouseButtons.right = pressed;
+		break;
+	case 0x112:
+		mouseButtons.middle = pressed;
+		break;
+	}
+}
+
+void VulkanExampleBase::handleKey(uint32_t key, bool pressed)
+{
+	// Wayland sends Linux input event codes, the key codes (see keycodes.hpp) are those of X11 which are offset by 8
+	const uint32_t keyCode = key + 8;
+	switch (keyCode)
+	{
+	case KEY_W:
+		camera.keys.up = pressed;
+		break;
+	case KEY_S:
+		camera.keys.down = pressed;
+		break;
+	case KEY_A:
+		camera.keys.left = pressed;
+		break;
+	case KEY_D:
+		camera.keys.right = pressed;
+		break;
+	}
+	if (pressed)
+	{
+		switch (keyCode)
+		{
+		case KEY_P:
+			paused = !paused;
+			break;
+		case KEY_F1:
+			if (enableTextOverlay)
+			{
+				textOverlay->visible = !textOverlay->visible;
+			}
+			break;
+		case KEY_F12:
+			capture.requested = true;
+			break;
+		}
+	}
+	else
+	{
+		if (keyCode == KEY_ESCAPE)
+		{
+			quit = true;
+		}
+		keyPressed(keyCode);
+	}
+}
+
+void VulkanExampleBase::registryGlobal(void *data, wl_registry *registry, uint32_t name, const char *interface, uint32_t version)
+{
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	if (strcmp(interface, "wl_compositor") == 0)
+	{
+		example->compositor = reinterpret_cast<wl_compositor*>(wl_registry_bind(registry, name, &wl_compositor_interface, 1));
+	}
+	else if (strcmp(interface, "wl_shell") == 0)
+	{
+		example->shell = reinterpret_cast<wl_shell*>(wl_registry_bind(registry, name, &wl_shell_interface, 1));
+	}
+	else if ((strcmp(interface, "wl_seat") == 0) && !example->seat)
+	{
+		static const wl_seat_listener seatListener = { seatCapabilities };
+		example->seat = reinterpret_cast<wl_seat*>(wl_registry_bind(registry, name, &wl_seat_interface, 1));
+		wl_seat_add_listener(example->seat, &seatListener, example);
+	}
+}
+
+void VulkanExampleBase::registryGlobalRemove(void *data, wl_registry *registry, uint32_t name)
+{
+}
+
+void VulkanExampleBase::seatCapabilities(void *data, wl_seat *seat, uint32_t caps)
+{
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	const bool hasPointer = (caps & WL_SEAT_CAPABILITY_POINTER) != 0;
+	if (hasPointer && !example->pointer)
+	{
+		static const wl_pointer_listener pointerListener = { pointerEnter, pointerLeave, pointerMotion, pointerButton, pointerAxis };
+		example->pointer = wl_seat_get_pointer(seat);
+		wl_pointer_add_listener(example->pointer, &pointerListener, example);
+	}
+	else if (!hasPointer && example->pointer)
+	{
+		wl_pointer_destroy(example->pointer);
+		example->pointer = nullptr;
+	}
+	const bool hasKeyboard = (caps & WL_SEAT_CAPABILITY_KEYBOARD) != 0;
+	if (hasKeyboard && !example->keyboard)
+	{
+		static const wl_keyboard_listener keyboardListener = { keyboardKeymap, keyboardEnter, keyboardLeave, keyboardKey, keyboardModifiers };
+		example->keyboard = wl_seat_get_keyboard(seat);
+		wl_keyboard_add_listener(example->keyboard, &keyboardListener, example);
+	}
+	else if (!hasKeyboard && example->keyboard)
+	{
+		wl_keyboard_destroy(example->keyboard);
+		example->keyboard = nullptr;
+	}
+}
+
+void VulkanExampleBase::pointerEnter(void *data, wl_pointer *pointer, uint32_t serial, wl_surface *surface, wl_fixed_t sx, wl_fixed_t sy)
+{
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	example->mousePos = glm::vec2((float)wl_fixed_to_double(sx), (float)wl_fixed_to_double(sy));
+}
+
+void VulkanExampleBase::pointerLeave(void *data, wl_pointer *pointer, uint32_t serial, wl_surface *surface)
+{
+	// Button releases outside of the surface aren't sent
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	example->mouseButtons.left = false;
+	example->mouseButtons.right = false;
+	example->mouseButtons.middle = false;
+}
+
+void VulkanExampleBase::pointerMotion(void *data, wl_pointer *pointer, uint32_t time, wl_fixed_t sx, wl_fixed_t sy)
+{
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	example->addInputEvent(std::chrono::high_resolution_clock::now());
+	example->requestRedraw();
+	example->pointerMoved((float)wl_fixed_to_double(sx), (float)wl_fixed_to_double(sy));
+}
+
+void VulkanExampleBase::pointerButton(void *data, wl_pointer *pointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state)
+{
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	example->addInputEvent(std::chrono::high_resolution_clock::now());
+	example->requestRedraw();
+	example->handlePointerButton(button, state == WL_POINTER_BUTTON_STATE_PRESSED);
+}
+
+void VulkanExampleBase::pointerAxis(void *data, wl_pointer *pointer, uint32_t time, uint32_t axis, wl_fixed_t value)
+{
+	if (axis != WL_POINTER_AXIS_VERTICAL_SCROLL)
+	{
+		return;
+	}
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	example->addInputEvent(std::chrono::high_resolution_clock::now());
+	example->requestRedraw();
+	// A wheel step scrolls by 10, scaled to the 120 of a Windows wheel step
+	const float wheelDelta = -(float)wl_fixed_to_double(value) * 12.0f;
+	example->zoom += wheelDelta * 0.005f * example->zoomSpeed;
+	example->camera.translate(glm::vec3(0.0f, 0.0f, wheelDelta * 0.005f * example->zoomSpeed));
+	example->viewUpdated = true;
+}
+
+void VulkanExampleBase::keyboardKeymap(void *data, wl_keyboard *keyboard, uint32_t format, int fd, uint32_t size)
+{
+	// Keys are handled by their codes, the keymap isn't needed
+	close(fd);
+}
+
+void VulkanExampleBase::keyboardEnter(void *data, wl_keyboard *keyboard, uint32_t serial, wl_surface *surface, wl_array *keys)
+{
+}
+
+void VulkanExampleBase::keyboardLeave(void *data, wl_keyboard *keyboard, uint32_t serial, wl_surface *surface)
+{
+	// Key releases while another surface has the focus aren't sent
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	example->camera.keys.up = false;
+	example->camera.keys.down = false;
+	example->camera.keys.left = false;
+	example->camera.keys.right = false;
+}
+
+void VulkanExampleBase::keyboardKey(void *data, wl_keyboard *keyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state)
+{
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	example->addInputEvent(std::chrono::high_resolution_clock::now());
+	example->requestRedraw();
+	example->handleKey(key, state == WL_KEYBOARD_KEY_STATE_PRESSED);
+}
+
+void VulkanExampleBase::keyboardModifiers(void *data, wl_keyboard *keyboard, uint32_t serial, uint32_t modsDepressed, uint32_t modsLatched, uint32_t modsLocked, uint32_t group)
+{
+}
+
+void VulkanExampleBase::shellSurfacePing(void *data, wl_shell_surface *shellSurface, uint32_t serial)
+{
+	wl_shell_surface_pong(shellSurface, serial);
+}
+
+void VulkanExampleBase::shellSurfaceConfigure(void *data, wl_shell_surface *shellSurface, uint32_t edges, int32_t width, int32_t height)
+{
+	// The surface's size is that of the swap chain's images, so resizes are requested by the compositor and applied by recreating the swap chain
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	if (example->prepared && (width > 0) && (height > 0) && (((uint32_t)width != example->width) || ((uint32_t)height != example->height)))
+	{
+		example->destWidth = width;
+		example->destHeight = height;
+		example->windowResize();
+	}
+}
+
+void VulkanExampleBase::shellSurfacePopupDone(void *data, wl_shell_surface *shellSurface)
+{
+}
+
+void VulkanExampleBase::frameCallbackDone(void *data, wl_callback *callback, uint32_t time)
+{
+	VulkanExampleBase *example = reinterpret_cast<VulkanExampleBase*>(data);
+	wl_callback_destroy(callback);
+	example->frameFeedback.callback = nullptr;
+	example->frameFeedbackDone(time);
+}
 #elif defined(__linux__)
 // Set up a window using XCB and request event types
 xcb_window_t VulkanExampleBase::setupWindow()
 {
+	if (headless)
+	{
+		return 0;
+	}
+
 	uint32_t value_mask, value_list[32];
 
 	window = xcb_generate_id(connection);
@@ -1313,6 +3386,15 @@ void VulkanExampleBase::initxcbConnection()
 	int scr;
 
 	connection = xcb_connect(NULL, &scr);
+	if (benchmark.active && xcb_connection_has_error(connection))
+	{
+		// Benchmarks can run without a window system
+		std::cout << "Could not connect to the X server, running the benchmark headless" << std::endl;
+		xcb_disconnect(connection);
+		connection = nullptr;
+		headless = true;
+		return;
+	}
 	if (connection == NULL) {
 		printf("Could not find a compatible Vulkan ICD!\n");
 		fflush(stdout);
@@ -1328,6 +3410,7 @@ void VulkanExampleBase::initxcbConnection()
 
 void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
 {
+	requestRedraw();
 	switch (event->response_type & 0x7f)
 	{
 	case XCB_CLIENT_MESSAGE:
@@ -1412,6 +3495,9 @@ void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
 					textOverlay->visible = !textOverlay->visible;
 				}
 				break;				
+			case KEY_F12:
+				capture.requested = true;
+				break;
 		}
 	}
 	break;	
@@ -1460,6 +3546,52 @@ void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
 		break;
 	}
 }
+
+void VulkanExampleBase::startInputThread()
+{
+	inputThreadStop = false;
+	inputThread = std::thread([this] {
+		// XCB connections can be shared between threads, the render thread keeps using it to change the window title
+		xcb_generic_event_t *event;
+		while ((event = xcb_wait_for_event(connection)))
+		{
+			const auto timestamp = std::chrono::high_resolution_clock::now();
+			// Waits for the render thread instead of dropping events, a lost key release would leave a key pressed
+			while (!inputThreadStop && !inputQueue.push(event, timestamp))
+			{
+				std::this_thread::yield();
+			}
+			if (inputThreadStop)
+			{
+				free(event);
+				break;
+			}
+		}
+	});
+}
+
+void VulkanExampleBase::stopInputThread()
+{
+	if (!inputThread.joinable())
+	{
+		return;
+	}
+	inputThreadStop = true;
+	// Wake up the thread waiting for the next event with a client message to the window, it's only sent to this connection
+	xcb_client_message_event_t wakeEvent = {};
+	wakeEvent.response_type = XCB_CLIENT_MESSAGE;
+	wakeEvent.format = 32;
+	wakeEvent.window = window;
+	wakeEvent.type = XCB_ATOM_NONE;
+	xcb_send_event(connection, 0, window, XCB_EVENT_MASK_NO_EVENT, reinterpret_cast<const char*>(&wakeEvent));
+	xcb_flush(connection);
+	inputThread.join();
+	vkTools::InputQueue<xcb_generic_event_t*, 1024>::Event input;
+	while (inputQueue.pop(input))
+	{
+		free(input.event);
+	}
+}
 #endif
 
 void VulkanExampleBase::viewChanged()
@@ -1570,7 +3702,7 @@ void VulkanExampleBase::setupRenderPass()
 	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachments[0].finalLayout = swapChain.getPresentLayout();
 	// Depth attachment
 	attachments[1].format = depthFormat;
 	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -1631,6 +3763,24 @@ void VulkanExampleBase::setupRenderPass()
 	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
 }
 
+void VulkanExampleBase::setVSync(bool enabled)
+{
+	if (enabled == enableVSync)
+	{
+		return;
+	}
+	enableVSync = enabled;
+	// Recreated at the current size, windowResize skips this until the example has been prepared
+	destWidth = width;
+	destHeight = height;
+	windowResize();
+}
+
+bool VulkanExampleBase::getVSync()
+{
+	return enableVSync;
+}
+
 void VulkanExampleBase::windowResize()
 {
 	if (!prepared)
@@ -1639,44 +3789,49 @@ void VulkanExampleBase::windowResize()
 	}
 	prepared = false;
 
-	// Recreate swap chain
+	// Frames in flight may still use the resources that are recreated
+	// Instead of waiting for the device to become idle, the old ones are retired and destroyed once these frames have finished
+	VkDevice device = this->device;
+
+	// Recreate swap chain, the old one is passed to the new one so presentation can continue
 	width = destWidth;
 	height = destHeight;
-	createSetupCommandBuffer();
 	setupSwapChain();
 
 	// Recreate the frame buffers
 
-	vkDestroyImageView(device, depthStencil.view, nullptr);
-	vkDestroyImage(device, depthStencil.image, nullptr);
-	vkFreeMemory(device, depthStencil.mem, nullptr);
+	auto oldDepthStencil = depthStencil;
+	retireResource([device, oldDepthStencil] {
+		vkDestroyImageView(device, oldDepthStencil.view, nullptr);
+		vkDestroyImage(device, oldDepthStencil.image, nullptr);
+		vkFreeMemory(device, oldDepthStencil.mem, nullptr);
+	});
 	setupDepthStencil();
-	
-	for (uint32_t i = 0; i < frameBuffers.size(); i++)
-	{
-		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
-	}
-	setupFrameBuffer();
 
-	flushSetupCommandBuffer();
+	std::vector<VkFramebuffer> oldFrameBuffers = frameBuffers;
+	retireResource([device, oldFrameBuffers] {
+		for (auto frameBuffer : oldFrameBuffers)
+		{
+			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+		}
+	});
+	setupFrameBuffer();
 
 	// Command buffers need to be recreated as they may store
 	// references to the recreated frame buffer
-	destroyCommandBuffers();
-	createCommandBuffers();
+	renewCommandBuffers();
 	buildCommandBuffers();
 
-	vkQueueWaitIdle(queue);
-	vkDeviceWaitIdle(device);
-
 	if (enableTextOverlay)
 	{
-		textOverlay->reallocateCommandBuffers();
+		VulkanTextOverlay *textOverlay = this->textOverlay;
+		textOverlay->setPreRotation(glm::mat2(getPreRotation()));
+		std::vector<VkCommandBuffer> oldOverlayCmdBuffers;
+		textOverlay->reallocateCommandBuffers(&oldOverlayCmdBuffers);
+		retireResource([textOverlay, oldOverlayCmdBuffers] { textOverlay->freeCommandBuffers(oldOverlayCmdBuffers); });
 		updateTextOverlay();
 	}
 
-	camera.updateAspectRatio((float)width / (float)height);
-
 	// Notify derived class
 	windowResized();
 	viewChanged();
@@ -1691,12 +3846,25 @@ void VulkanExampleBase::windowResized()
 
 void VulkanExampleBase::initSwapchain()
 {
+	if (headless)
+	{
+		// Offscreen images have been set up in initVulkan
+		return;
+	}
 #if defined(_WIN32)
 	swapChain.initSurface(windowInstance, window);
 #elif defined(__ANDROID__)	
 	swapChain.initSurface(androidApp->window);
 #elif defined(_DIRECT2DISPLAY)
 	swapChain.initSurface(width, height);
+	if ((displayTiming.limitDivisor > 0) && (swapChain.displayRefreshRate > 0.0f))
+	{
+		// The limiter makes every frame show for the same number of refresh intervals, instead of alternating when a frame misses one
+		frameLimiter.targetRate = swapChain.displayRefreshRate / displayTiming.limitDivisor;
+		std::cout << "Limiting to " << frameLimiter.targetRate << " fps, every " << displayTiming.limitDivisor << " refresh intervals" << std::endl;
+	}
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	swapChain.initSurface(display, surface);
 #elif defined(__linux__)
 	swapChain.initSurface(connection, window);
 #endif
@@ -1704,5 +3872,42 @@ void VulkanExampleBase::initSwapchain()
 
 void VulkanExampleBase::setupSwapChain()
 {
-	swapChain.create(&width, &height, enableVSync);
+	VulkanSwapChain::RetiredSwapChain retired;
+	swapChain.create(&width, &height, enableVSync, swapchainImageCount, &retired);
+	if (retired.swapChain != VK_NULL_HANDLE)
+	{
+		// Presentation of images of the old swap chain may still be pending
+		VulkanSwapChain *swapChain = &this->swapChain;
+		retireResource([swapChain, retired] { swapChain->destroyRetired(retired); });
+	}
+	// Image count may change with the swap chain, no frame is using any of the new images yet
+	imageFences.assign(swapChain.imageCount, VK_NULL_HANDLE);
+#if defined(__ANDROID__)
+	swapChainSuboptimal = false;
+#endif
+	// The scene is rendered in the orientation of the images, but keeps the aspect ratio of the view
+	VkExtent2D viewExtent = getViewExtent();
+	camera.setPreRotation(getPreRotation());
+	camera.updateAspectRatio((float)viewExtent.width / (float)viewExtent.height);
+}
+
+glm::mat4 VulkanExampleBase::getPreRotation()
+{
+	// The presentation engine rotates the images clockwise by the transform, so they're rendered rotated the other way
+	switch (swapChain.preTransform)
+	{
+	case VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR:
+		return glm::rotate(glm::mat4(), glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	case VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR:
+		return glm::rotate(glm::mat4(), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	case VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR:
+		return glm::rotate(glm::mat4(), glm::radians(270.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	default:
+		return glm::mat4();
+	}
+}
+
+VkExtent2D VulkanExampleBase::getViewExtent()
+{
+	return swapChain.swapsExtent() ? VkExtent2D{ height, width } : VkExtent2D{ width, height };
 }
@@ -10,6 +10,8 @@
 
 #ifdef _WIN32
 #pragma comment(linker, "/subsystem:windows")
+// Before windows.h, which would include the older winsock.h otherwise (see telemetry.hpp)
+#include <winsock2.h>
 #include <windows.h>
 #include <fcntl.h>
 #include <io.h>
@@ -18,18 +20,26 @@
 #include <android/asset_manager.h>
 #include <android_native_app_glue.h>
 #include "vulkanandroid.h"
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+#include <wayland-client.h>
 #elif defined(__linux__)
 #include <xcb/xcb.h>
 #endif
 
 #include <iostream>
 #include <chrono>
+#include <iomanip>
+#include <thread>
+#include <atomic>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <string>
 #include <array>
+#include <functional>
+#include <unordered_map>
+#include <map>
 
 #include "vulkan/vulkan.h"
 
@@ -42,7 +52,18 @@
 #include "vulkanTextureLoader.hpp"
 #include "vulkanMeshLoader.hpp"
 #include "vulkantextoverlay.hpp"
+#include "vulkanprofiler.hpp"
+#include "vulkanframecapture.hpp"
+#include "videostream.hpp"
+#include "benchmark.hpp"
+#include "framerecording.hpp"
+#include "telemetry.hpp"
+#include "cputopology.hpp"
+#include "shaderstatistics.hpp"
+#include "simulationclock.hpp"
+#include "lineararena.hpp"
 #include "camera.hpp"
+#include "inputqueue.hpp"
 
 // Function pointer for getting physical device fetures to be enabled
 typedef VkPhysicalDeviceFeatures (*PFN_GetEnabledFeatures)();
@@ -54,6 +75,70 @@ private:
 	bool enableValidation = false;
 	// Set to true if v-sync will be forced for the swapchain
 	bool enableVSync = false;
+	// Low latency presentation (set via -lowlatency)
+	// Uses a single frame in flight and the minimum number of swapchain images, and waits for the GPU before input is sampled
+	bool lowLatency = false;
+	// Number of swapchain images (set via -swapchainimages), 0 uses the surface's minimum + 1
+	uint32_t swapchainImageCount = 0;
+	// Input to frame completion latency, measured when low latency presentation is enabled
+	struct {
+		// Time the input for each frame in flight was sampled at
+		std::vector<std::chrono::high_resolution_clock::time_point> sampleTimes;
+		// Rolling average in milliseconds
+		float average = 0.0f;
+	} frameLatency;
+	// Time from an input event's arrival to the present of the first frame that has handled it
+	struct {
+		// Arrival of the oldest input event handled since the last present, zero if there is none
+		std::chrono::high_resolution_clock::time_point pendingEvent;
+		// Rolling average in milliseconds
+		float average = 0.0f;
+	} inputLatency;
+	// Called for each input event handled by the render thread
+	void addInputEvent(std::chrono::high_resolution_clock::time_point timestamp);
+	// Called after a frame has been presented
+	void updateInputLatency();
+	// Frame limiter (-framelimit <fps>), keeps the frames from running faster than the target rate without v-sync, e.g. to save power
+	struct {
+		// Frames per second, 0 disables the limiter
+		float targetRate = 0.0f;
+		// Last part of the wait in milliseconds that is spun instead of slept, covers the scheduler's wake up granularity (-framelimitspin)
+		float spinTime = 2.0f;
+		// Start of the next frame, advances by one frame interval per frame
+		std::chrono::high_resolution_clock::time_point deadline;
+		// Rolling average of the waited time in milliseconds
+		float waitAverage = 0.0f;
+	} frameLimiter;
+	// Wait until the frame limiter's next frame is due, sleeps for most of the wait and spins for the rest
+	void limitFrameRate();
+#if defined(_DIRECT2DISPLAY)
+	// Presentation without a compositor (-d2ddisplay <index>, -d2drefresh <hz> for the mode's refresh rate)
+	// The intervals between presented frames are measured against the display mode's refresh interval
+	struct {
+		std::chrono::high_resolution_clock::time_point lastPresent;
+		// Rolling average of the interval between presented frames in milliseconds
+		float interval = 0.0f;
+		// Refresh intervals the displayed image wasn't replaced in time, counting and of the last second
+		uint32_t missed = 0;
+		uint32_t lastMissed = 0;
+		// Limits the frame rate to the refresh rate divided by this (-d2dlimit <divisor>), 0 leaves the frame limiter as is
+		uint32_t limitDivisor = 0;
+	} displayTiming;
+	// Called after a frame has been presented
+	void updateDisplayTiming();
+#endif
+	// Wait for the frame limiter and for the current frame in flight (low latency presentation only) before the input for it is sampled
+	void paceFrame();
+	// Check if the next frame has to be rendered, always true unless rendering on demand
+	bool shouldRender();
+	// Index of the physical device the example runs on (set via -gpu), the available devices are listed if there's more than one
+	uint32_t selectedGPU = 0;
+	// CSV file the GPU pass times are written to (set via -gpuprofilelog)
+	std::string gpuProfilerLog;
+	// JSON file the device memory usage is written to once per second (set via -memoryreport)
+	std::string memoryReportFile;
+	// Chrome trace JSON file the CPU zones and GPU pass times are written to on exit (set via -trace)
+	std::string traceFile;
 	// Device features enabled by the example
 	// If not set, no additional features are enabled (may result in validation layer errors)
 	VkPhysicalDeviceFeatures enabledFeatures = {};
@@ -94,6 +179,20 @@ protected:
 	vk::VulkanDevice *vulkanDevice;
 	// Handle to the device graphics queue that command buffers are submitted to
 	VkQueue queue;
+	// Queue for asynchronous uploads, from a dedicated transfer queue family if the device has one (else same as queue)
+	VkQueue transferQueue;
+	// Queue for asynchronous compute work, from a compute only queue family if the device has one (else same as queue)
+	VkQueue computeQueue;
+	// GPU pass timing, only created if the example calls prepareGpuProfiler and the device supports timestamps
+	// The example submits the timestamps in front of each pass, the final one is added after the text overlay by submitFrame or getFrameEndCommandBuffers
+	vkTools::VulkanGpuProfiler *gpuProfiler = nullptr;
+	// Asynchronous image captures, the swap chain image is captured by getFrameEndCommandBuffers while capture.active is set
+	// Examples can add captures of their own render targets to the frame's command buffers
+	vkTools::VulkanFrameCapture *frameCapture = nullptr;
+	// Encoder the swap chain images are streamed to through the frame capture, only created if stream.output is set
+	vkTools::VideoStream *videoStream = nullptr;
+	// Sender of the live statistics, only created if telemetry.destination is set
+	vkTools::TelemetryPublisher *telemetryPublisher = nullptr;
 	// Color buffer format
 	VkFormat colorformat = VK_FORMAT_B8G8R8A8_UNORM;
 	// Depth buffer format
@@ -119,19 +218,37 @@ protected:
 	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 	// List of shader modules created (stored for cleanup)
 	std::vector<VkShaderModule> shaderModules;
+	// File each shader module has been loaded from, used to reload changed shader files
+	std::unordered_map<VkShaderModule, std::string> shaderModuleFiles;
 	// Pipeline cache object
 	VkPipelineCache pipelineCache;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
 	// Synchronization semaphores
-	struct {
+	struct Semaphores {
 		// Swap chain image presentation
 		VkSemaphore presentComplete;
 		// Command buffer submission and execution
 		VkSemaphore renderComplete;
 		// Text overlay submission and execution
 		VkSemaphore textOverlayComplete;
-	} semaphores;
+	};
+	// Semaphores of the frame currently being recorded (set by prepareFrame)
+	Semaphores semaphores;
+	// Number of frames the CPU may record ahead of the GPU (set via -framesinflight)
+	uint32_t framesInFlight = 2;
+	// Anisotropic filtering quality of the shared texture samplers (set via -anisotropy <0..4>, off to 16x)
+	vk::AnisotropyTier anisotropyTier = vk::ANISOTROPY_TIER_HIGH;
+	// Amount of asset loading output (set via -verbosity <0..2>), 0 only reports errors, 1 prints summaries, 2 prints every material
+	uint32_t verbosity = 1;
+	// Index of the frame in flight currently being recorded
+	uint32_t currentFrame = 0;
+	// Semaphores for each frame in flight
+	std::vector<Semaphores> frameSemaphores;
+	// Signaled once the GPU has finished all work submitted for a frame in flight
+	std::vector<VkFence> frameFences;
+	// Fence of the frame that last rendered to each swap chain image
+	std::vector<VkFence> imageFences;
 	// Simple texture loader
 	vkTools::VulkanTextureLoader *textureLoader = nullptr;
 	// Returns the base asset path (for shaders, models, textures) depending on the os
@@ -158,6 +275,116 @@ public:
 	bool enableTextOverlay = false;
 	VulkanTextOverlay *textOverlay;
 
+	// Benchmark mode (-benchmark), renders a fixed number of frames along a camera path and writes the frame statistics to a JSON file
+	struct {
+		bool active = false;
+		// Number of measured frames (-benchmarkframes)
+		uint32_t frameCount = 1000;
+		// Frames rendered at the start of the path before measuring, lets streaming and caches settle
+		uint32_t warmupFrames = 60;
+		// Camera path file (-benchmarkpath), defaults to benchmark/camerapath.txt in the asset folder
+		std::string cameraPath;
+		// JSON result file (-benchmarkresult)
+		std::string resultFile = "benchmark.json";
+		// Measured runs along the path (-benchmarkruns), the warm up is only rendered before the first one
+		uint32_t runs = 1;
+		// Directory of the baselines (-benchmarkbaseline), the results are compared to the baseline of the device and driver
+		// The first run on a device and driver saves its results as the baseline, a regression sets the exit code to 2
+		std::string baselineDirectory;
+		// Replace the baseline with the results instead of comparing them (-benchmarkupdatebaseline)
+		bool updateBaseline = false;
+		// Smallest slowdown in percent reported as a regression (-benchmarkthreshold)
+		float regressionThreshold = 3.0f;
+	} benchmark;
+	// Returned by main
+	int exitCode = 0;
+	// Frame recording (-record <file>) and deterministic replay (-replay <file>)
+	// A recording stores the camera, the global timer and the example's state of every presented frame (see recordFrameState)
+	// A replay renders the recorded frames as a benchmark with their time steps, so runs with different shaders or renderers only differ in GPU cost
+	struct {
+		std::string recordFile;
+		std::string replayFile;
+		vkTools::FrameRecording frames;
+		// Replayed frames whose example state or submitted passes differ from the recording, counted by the example
+		uint32_t stateMismatches = 0;
+		uint32_t passMismatches = 0;
+	} frameRecording;
+	// Render on demand (-ondemand), frames are only rendered if something has changed, idle frames sleep instead
+	struct {
+		bool enabled = false;
+		// Frames per second rendered while nothing changes (-ondemandrefresh), keeps the overlay statistics and streaming up to date
+		float refreshRate = 1.0f;
+		// Frames rendered after the last change, lets temporal effects (e.g. TAA) converge
+		uint32_t settleFrames = 16;
+		// Rendered and skipped frames of the last second
+		uint32_t lastRedrawRate = 0;
+		uint32_t lastSkipRate = 0;
+		// Internal state of shouldRender
+		bool redrawRequested = true;
+		uint32_t settleCounter = 0;
+		uint32_t redrawCount = 0;
+		uint32_t skipCount = 0;
+		std::chrono::high_resolution_clock::time_point lastRedraw;
+		std::chrono::high_resolution_clock::time_point rateStart;
+	} onDemand;
+	// Fixed step simulation (-fixedstep), the camera and the global timer advance in fixed steps independent of the frame rate
+	// Frames are rendered between the last two simulation states, see Camera::previousPosition
+	struct {
+		bool enabled = false;
+		// Steps per second (-fixedsteprate)
+		float rate = 60.0f;
+		vkTools::SimulationClock clock;
+		// Simulated time of the current frame in seconds, a multiple of the step with a fixed step and the frame time otherwise
+		float deltaTime = 0.0f;
+		// Global timer after the last step, timer is interpolated from it
+		float timer = 0.0f;
+		float previousTimer = 0.0f;
+		std::chrono::high_resolution_clock::time_point lastUpdate;
+		bool started = false;
+	} simulation;
+	// Render to offscreen images without a window (-headless)
+	// Also set if no window system is available in benchmark mode
+	bool headless = false;
+	// Number of frames rendered in headless mode outside of benchmarks (-headlessframes), 0 renders until quit is set
+	uint32_t headlessFrameCount = 0;
+	// Headless readback of the presented images
+	struct {
+		// Frames are written to <prefix>_<frame>.ppm (-readback), readback is disabled if empty
+		std::string prefix;
+		// Number of frames between two readbacks (-readbackinterval)
+		uint32_t interval = 1;
+	} readback;
+	// Captures of the presented images (and example defined render targets), written by a background thread
+	struct {
+		// Frames are captured to <prefix>_<frame> (-capture), periodic captures are disabled if empty
+		// F12 captures a single frame, to "screenshot_<frame>" if no prefix is set
+		std::string prefix;
+		// Number of frames between two periodic captures (-captureinterval)
+		uint32_t interval = 1;
+		// Capture the next frame
+		bool requested = false;
+		// Set by prepareFrame if the current frame is captured
+		bool active = false;
+	} capture;
+	// Video stream of the presented images (without the text overlay), encoded by an ffmpeg process
+	struct {
+		// File or URL (e.g. udp://host:port) the stream is written to (-videostream), streaming is disabled if empty
+		std::string output;
+		// ffmpeg encoder (-videocodec), e.g. hevc_nvenc, h264_amf, h264_qsv or libx264 if no hardware encoder is available
+		std::string codec = "h264_nvenc";
+		// Frame rate the stream is encoded with (-videofps)
+		uint32_t frameRate = 60;
+	} stream;
+	// Live statistics sent as UDP datagrams with one JSON object each, for monitoring outside of the application
+	struct {
+		// Host and port the statistics are sent to (-telemetry <host:port>), disabled if empty
+		std::string destination;
+		// Samples sent per second (-telemetryrate)
+		uint32_t rate = 10;
+		// Seconds since the last sample
+		float timer = 0.0f;
+	} telemetry;
+
 	// Use to adjust mouse rotation speed
 	float rotationSpeed = 1.0f;
 	// Use to adjust mouse zoom speed
@@ -194,6 +421,64 @@ public:
 	android_app* androidApp;
 	// true if application has focused, false if moved to background
 	bool focused = false;
+	// Thermal status of the device (see getThermalStatus), polled once per second and when the app regains focus
+	int32_t thermalStatus = -1;
+	// Set if presentation reported a suboptimal swap chain, e.g. after the device has been rotated
+	bool swapChainSuboptimal = false;
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	struct {
+		bool left = false;
+		bool right = false;
+		bool middle = false;
+	} mouseButtons;
+	bool quit = false;
+	wl_display *display = nullptr;
+	wl_registry *registry = nullptr;
+	wl_compositor *compositor = nullptr;
+	wl_shell *shell = nullptr;
+	wl_seat *seat = nullptr;
+	wl_pointer *pointer = nullptr;
+	wl_keyboard *keyboard = nullptr;
+	wl_surface *surface = nullptr;
+	wl_shell_surface *shellSurface = nullptr;
+	// Presentation feedback of the compositor, a frame callback is committed with every presented image and done once the compositor
+	// has shown it and is ready for the next one, its timestamps give the compositor's refresh interval
+	struct {
+		wl_callback *callback = nullptr;
+		// Compositor time of the last frame callback in milliseconds
+		uint32_t lastTime = 0;
+		// Rolling average of the interval between frame callbacks in milliseconds
+		float interval = 0.0f;
+		// Wait for the previous frame's callback before sampling the input of the next frame (-waylandthrottle)
+		// Keeps the frames in step with the compositor's repaints when presenting without v-sync, instead of replacing images it never shows
+		bool throttle = false;
+	} frameFeedback;
+	// Read and dispatch the events that arrived since the last call, waits up to 10ms for new ones if wait is set
+	void dispatchWaylandEvents(bool wait);
+	// Request a frame callback for the next presented image, unless the previous one is still pending
+	void requestFrameFeedback();
+	void frameFeedbackDone(uint32_t time);
+	void pointerMoved(float x, float y);
+	void handlePointerButton(uint32_t button, bool pressed);
+	void handleKey(uint32_t key, bool pressed);
+	// Listeners of the Wayland objects, called during the dispatch with the example as their data
+	static void registryGlobal(void *data, wl_registry *registry, uint32_t name, const char *interface, uint32_t version);
+	static void registryGlobalRemove(void *data, wl_registry *registry, uint32_t name);
+	static void seatCapabilities(void *data, wl_seat *seat, uint32_t caps);
+	static void pointerEnter(void *data, wl_pointer *pointer, uint32_t serial, wl_surface *surface, wl_fixed_t sx, wl_fixed_t sy);
+	static void pointerLeave(void *data, wl_pointer *pointer, uint32_t serial, wl_surface *surface);
+	static void pointerMotion(void *data, wl_pointer *pointer, uint32_t time, wl_fixed_t sx, wl_fixed_t sy);
+	static void pointerButton(void *data, wl_pointer *pointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state);
+	static void pointerAxis(void *data, wl_pointer *pointer, uint32_t time, uint32_t axis, wl_fixed_t value);
+	static void keyboardKeymap(void *data, wl_keyboard *keyboard, uint32_t format, int fd, uint32_t size);
+	static void keyboardEnter(void *data, wl_keyboard *keyboard, uint32_t serial, wl_surface *surface, wl_array *keys);
+	static void keyboardLeave(void *data, wl_keyboard *keyboard, uint32_t serial, wl_surface *surface);
+	static void keyboardKey(void *data, wl_keyboard *keyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state);
+	static void keyboardModifiers(void *data, wl_keyboard *keyboard, uint32_t serial, uint32_t modsDepressed, uint32_t modsLatched, uint32_t modsLocked, uint32_t group);
+	static void shellSurfacePing(void *data, wl_shell_surface *shellSurface, uint32_t serial);
+	static void shellSurfaceConfigure(void *data, wl_shell_surface *shellSurface, uint32_t edges, int32_t width, int32_t height);
+	static void shellSurfacePopupDone(void *data, wl_shell_surface *shellSurface);
+	static void frameCallbackDone(void *data, wl_callback *callback, uint32_t time);
 #elif defined(__linux__)
 	struct {
 		bool left = false;
@@ -205,6 +490,14 @@ public:
 	xcb_screen_t *screen;
 	xcb_window_t window;
 	xcb_intern_atom_reply_t *atom_wm_delete_window;
+	// Events are read and timestamped by a separate thread as they arrive, then handled by the render thread before it samples the frame's input
+	// Disabled with "-noinputthread", the render thread polls the connection itself then
+	bool enableInputThread = true;
+	std::thread inputThread;
+	std::atomic<bool> inputThreadStop;
+	vkTools::InputQueue<xcb_generic_event_t*, 1024> inputQueue;
+	void startInputThread();
+	void stopInputThread();
 #endif
 
 	// Default ctor
@@ -223,6 +516,9 @@ public:
 #elif defined(__ANDROID__)
 	static int32_t handleAppInput(struct android_app* app, AInputEvent* event);
 	static void handleAppCommand(android_app* app, int32_t cmd);
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	wl_shell_surface *setupWindow();
+	void initWaylandConnection();
 #elif defined(__linux__)
 	xcb_window_t setupWindow();
 	void initxcbConnection();
@@ -240,6 +536,29 @@ public:
 	// Called when the window has been resized
 	// Can be overriden in derived class to recreate or rebuild resources attached to the frame buffer / swapchain
 	virtual void windowResized();
+	// Called by the on demand rendering to check if the scene changes without input (animations, simulations, streaming)
+	// Can be overriden in derived class, the default only checks if the global timer is running
+	virtual bool sceneAnimating();
+	// Render the next frame when rendering on demand, e.g. after a setting has been changed
+	void requestRedraw();
+	// Called by presentFrame while recording, can be overriden in derived class to add its state and submitted passes to the frame
+	virtual void recordFrameState(vkTools::FrameRecording::Frame &frame);
+	// Called before a replayed frame is rendered, after its camera and timer have been restored, and with null after the replay
+	// Can be overriden in derived class to restore its state from the recorded one or to compare them
+	virtual void replayFrameState(const vkTools::FrameRecording::Frame *frame);
+	// Called by presentFrame when a telemetry sample is due, after the frame time, GPU passes and memory use have been added
+	// Can be overriden in derived class to add its draw, culling and streaming statistics
+	virtual void getTelemetry(vkTools::TelemetryPublisher::Sample &sample);
+	// Called when writing the benchmark results, can be overriden in derived class to add the shader modules of its pipelines by pipeline name
+	// The statistics of the modules' SPIR-V files are written alongside the GPU pass times
+	virtual void getPipelineShaders(std::map<std::string, std::vector<VkShaderModule>> &pipelines);
+	// Advance the camera and the global timer after a frame, runs the fixed simulation steps due if -fixedstep is set
+	// frameTime is the measured time of the frame in seconds, fixed steps use the wall clock time since the last call outside of benchmarks
+	void updateSimulation(float frameTime);
+	// Rotation of a pre-rotated swap chain's images in normalized device coordinates, to be applied after the projection
+	glm::mat4 getPreRotation();
+	// Size of the window as seen by the user, width and height are the swap chain's and swapped with a 90 or 270 degree pre-rotation
+	VkExtent2D getViewExtent();
 	// Pure virtual function to be overriden by the dervice class
 	// Called in case of an event where e.g. the framebuffer has to be rebuild and thus
 	// all command buffers that may reference this
@@ -281,13 +600,23 @@ public:
 	void flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free);
 
 	// Create a cache pool for rendering pipelines
+	// Initialized with the data saved by a previous run on the same device and driver
 	void createPipelineCache();
+	// Write the pipeline cache data to disk
+	void savePipelineCache();
+	// File the pipeline cache of the current device is saved to
+	const std::string getPipelineCachePath();
 
 	// Prepare commonly used Vulkan functions
 	virtual void prepare();
 
 	// Load a SPIR-V shader
 	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
+
+	// Create new modules for changed SPIR-V files and map every module loaded from one of these files to its replacement
+	// Files that can't be read or don't contain SPIR-V are skipped
+	// Replaced modules are kept until shutdown, as pipelines that fail to be recreated still reference them
+	void reloadShaderModules(const std::vector<std::string> &fileNames, std::unordered_map<VkShaderModule, VkShaderModule> &replacements);
 	
 	// Create a buffer, fill it with data (if != NULL) and bind buffer memory
 	VkBool32 createBuffer(
@@ -334,25 +663,108 @@ public:
 		std::vector<vkMeshLoader::VertexLayout> 
 		vertexLayout, 
 		vkMeshLoader::MeshCreateInfo *meshCreateInfo);
+	// Load a mesh with a vertex format known at compile time, the vertices are written straight into the staging buffer
+	template <vkMeshLoader::VertexLayout... Components>
+	void loadMesh(
+		std::string filename,
+		vkMeshLoader::MeshBuffer *meshBuffer,
+		vkMeshLoader::VertexFormat<Components...> vertexFormat,
+		float scale)
+	{
+		vkMeshLoader::MeshCreateInfo meshCreateInfo;
+		meshCreateInfo.scale = glm::vec3(scale);
+		meshCreateInfo.center = glm::vec3(0.0f);
+		meshCreateInfo.uvscale = glm::vec2(1.0f);
+
+		VulkanMeshLoader *mesh = openMesh(filename);
+		VkCommandBuffer copyCmd = createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+		mesh->createBuffers(meshBuffer, vertexFormat, &meshCreateInfo, true, copyCmd, queue);
+		vkFreeCommandBuffers(device, cmdPool, 1, &copyCmd);
+		meshBuffer->dim = mesh->dim.size;
+		delete(mesh);
+	}
+	// Load a mesh file with ASSIMP, the returned loader must be deleted by the caller
+	VulkanMeshLoader *openMesh(std::string filename);
 
 	// Start the main render loop
 	void renderLoop();
 
+	// Render the benchmark frames and write the results, called by renderLoop in benchmark mode
+	void runBenchmark();
+	void writeBenchmarkResults(vkTools::FrameTimeStats &frameTimes, const vkTools::BenchmarkBaseline &runs);
+	// Compare the runs' metrics to the baseline of the device and driver and write the regression tests as a JSON object, nested lines start with indent
+	// Returns false if there's no baseline to compare to
+	bool compareBenchmarkBaseline(std::ostream &file, const std::string &indent, const vkTools::BenchmarkBaseline &runs);
+	// Write the shader files used by the pipelines of getPipelineShaders and their statistics as JSON objects, nested lines start with indent
+	void writeShaderStats(std::ostream &file, const std::string &indent);
+	// Append the presented frame to the recording if -record is set
+	void recordFrame();
+	// Publish a telemetry sample if one is due
+	void publishTelemetry();
+	// Write the frames recorded with -record, called at the end of the render loop
+	void saveFrameRecording();
+	// Write the usage of the device's memory heaps and of each memory category as a JSON object, nested lines start with indent
+	void writeMemoryStats(std::ostream &file, const std::string &indent);
+	// Rewrite the memory report file, called with the once per second statistics update
+	void writeMemoryReport();
+
+	// Render without handling any window events, called by renderLoop in headless mode
+	void renderHeadless();
+	// Write a read back image as binary PPM
+	void writeReadback(uint64_t frameIndex, const void *data, uint32_t width, uint32_t height);
+
+	// Check if the swap chain images can be copied from and written by the frame capture
+	bool canCaptureSwapChain();
+	// File name (without extension) of a capture of the current frame, target names the captured image
+	std::string getCaptureFileName(const std::string &target);
+
 	void updateTextOverlay();
 
 	// Called when the text overlay is updating
 	// Can be overriden in derived class to add custom text to the overlay
 	virtual void getOverlayText(VulkanTextOverlay * textOverlay);
 
+	// Create the GPU profiler for the given passes, does nothing if the graphics queue doesn't support timestamps
+	void prepareGpuProfiler(const std::vector<std::string> &passNames);
+
 	// Prepare the frame for workload submission
+	// - Waits until the GPU has finished with the resources of the current frame in flight
 	// - Acquires the next image from the swap chain 
 	// - Sets the default wait and signal semaphores
 	void prepareFrame();
 
 	// Submit the frames' workload 
 	// - Submits the text overlay (if enabled)
+	// - Signals the frame's fence and advances to the next frame in flight
 	void submitFrame();
 
+	// Alternative to submitFrame for examples that submit all of a frame's work at once
+	// - Appends the text overlay (if enabled) and the final timestamp to the command buffers of the frame's last submission
+	// - The last submission must signal semaphores.renderComplete and the fence returned by getFrameFence
+	void getFrameEndCommandBuffers(vkTools::ArenaVector<VkCommandBuffer> &cmdBuffers);
+	VkFence getFrameFence();
+
+	// Present the frame submitted with the command buffers from getFrameEndCommandBuffers and advance to the next frame in flight
+	void presentFrame();
+
+	// Destroy a resource once no frame in flight uses it anymore, instead of waiting for the device to become idle
+	// Forwards to the device's deletion queue, see vk::VulkanDevice::retire
+	// The function is called from prepareFrame after the fence of the last frame that may use the resource has been waited for
+	void retireResource(std::function<void()> destroy);
+
+	// Retire the swap chain command buffers and allocate new ones, so they can be recorded without waiting for the frames in flight
+	void renewCommandBuffers();
+
+	// Wait for all frames in flight to finish on the GPU and destroy all retired resources
+	// Required before e.g. updating descriptor sets used by these frames, work submitted to other queues isn't waited for
+	// Must not be called between prepareFrame and the frame's submission
+	void waitForFramesInFlight();
+
+	// Switch v-sync on or off, the swap chain is recreated if the example has already been prepared
+	// Must not be called between prepareFrame and the frame's submission
+	void setVSync(bool enabled);
+	bool getVSync();
+
 };
 
 // OS specific macros for the example main entry points
@@ -376,8 +788,9 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLin
 	vulkanExample->initSwapchain();																	\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	const int exitCode = vulkanExample->exitCode;													\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }																									
 #elif defined(__ANDROID__)
 // Android entry point
@@ -397,7 +810,6 @@ void android_main(android_app* state)																\
 }
 #elif defined(_DIRECT2DISPLAY)
 // Linux entry point with direct to display wsi
-// todo: extract command line arguments
 #define VULKAN_EXAMPLE_MAIN()																		\
 VulkanExample *vulkanExample;																		\
 static void handleEvent()                                											\
@@ -405,12 +817,30 @@ static void handleEvent()                                											\
 }																									\
 int main(const int argc, const char *argv[])													    \
 {																									\
+	for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initSwapchain();																	\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	const int exitCode = vulkanExample->exitCode;													\
+	delete(vulkanExample);																			\
+	return exitCode;																				\
+}
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+// Linux entry point with Wayland wsi, events are handled by the listeners of the base class
+#define VULKAN_EXAMPLE_MAIN()																		\
+VulkanExample *vulkanExample;																		\
+int main(const int argc, const char *argv[])													    \
+{																									\
+	for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
+	vulkanExample = new VulkanExample();															\
+	vulkanExample->setupWindow();					 												\
+	vulkanExample->initSwapchain();																	\
+	vulkanExample->prepare();																		\
+	vulkanExample->renderLoop();																	\
+	const int exitCode = vulkanExample->exitCode;													\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #elif defined(__linux__)
 // Linux entry point
@@ -432,7 +862,8 @@ int main(const int argc, const char *argv[])													    \
 	vulkanExample->initSwapchain();																	\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
+	const int exitCode = vulkanExample->exitCode;													\
 	delete(vulkanExample);																			\
-	return 0;																						\
+	return exitCode;																				\
 }
 #endif
\ No newline at end of file
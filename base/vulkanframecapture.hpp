@@ -0,0 +1,611 @@
+/*
+* Asynchronous capture of images to PNG and EXR files, or to a consumer like a video stream
+*
+* Copies are recorded into small command buffers submitted with a frame, into host visible buffers from a ring of slots
+* A slot is handed to an encoding thread once the frame it was submitted with has been finished by the GPU, so capturing never waits for the GPU
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "vulkantools.h"
+#include "vulkandevice.hpp"
+#include "vulkanbuffer.hpp"
+#include "cputrace.hpp"
+#include "cputopology.hpp"
+
+namespace vkTools
+{
+	class VulkanFrameCapture
+	{
+	public:
+		/** @brief Receives the pixels of a capture on the encoding thread, the data is only valid during the call */
+		typedef std::function<void(const void *data, uint32_t width, uint32_t height, VkFormat format)> Consumer;
+
+	private:
+		enum ChannelType
+		{
+			CHANNEL_UNORM8,
+			CHANNEL_HALF,
+			CHANNEL_FLOAT,
+			CHANNEL_UINT
+		};
+
+		struct FormatInfo
+		{
+			uint32_t channelCount;
+			ChannelType channelType;
+			// Bytes per channel
+			uint32_t channelSize;
+			// Red and blue are swapped in memory
+			bool bgr;
+		};
+
+		struct Slot
+		{
+			enum State
+			{
+				FREE,
+				// Copy submitted with a frame that may not have been finished yet
+				COPYING,
+				// Queued for or being encoded on the encoding thread
+				ENCODING
+			};
+			State state = FREE;
+			vk::Buffer buffer;
+			VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+			uint64_t frameNumber = 0;
+			std::string fileName;
+			// Called instead of writing a file if set
+			Consumer consumer;
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			bool ignoreAlpha = false;
+		};
+
+		vk::VulkanDevice *vulkanDevice;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkMemoryPropertyFlags memoryPropertyFlags;
+		uint32_t maxSlots;
+
+		// Slots are only added, so pointers to them stay valid for the encoding thread
+		std::vector<std::unique_ptr<Slot>> slots;
+		std::deque<Slot*> encodeQueue;
+		std::mutex mutex;
+		// Signaled when a slot has been queued for encoding or has been encoded
+		std::condition_variable queueCondition;
+		std::condition_variable encodedCondition;
+		bool stopping = false;
+		std::thread encoder;
+
+		std::atomic<uint32_t> writtenCount;
+		std::atomic<uint32_t> failedCount;
+		uint32_t droppedCount = 0;
+
+		static bool getFormatInfo(VkFormat format, FormatInfo &info)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_R8_UNORM: case VK_FORMAT_R8_SRGB: info = { 1, CHANNEL_UNORM8, 1, false }; return true;
+			case VK_FORMAT_R8G8_UNORM: case VK_FORMAT_R8G8_SRGB: info = { 2, CHANNEL_UNORM8, 1, false }; return true;
+			case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SRGB: info = { 4, CHANNEL_UNORM8, 1, false }; return true;
+			case VK_FORMAT_B8G8R8A8_UNORM: case VK_FORMAT_B8G8R8A8_SRGB: info = { 4, CHANNEL_UNORM8, 1, true }; return true;
+			case VK_FORMAT_R16_SFLOAT: info = { 1, CHANNEL_HALF, 2, false }; return true;
+			case VK_FORMAT_R16G16_SFLOAT: info = { 2, CHANNEL_HALF, 2, false }; return true;
+			case VK_FORMAT_R16G16B16A16_SFLOAT: info = { 4, CHANNEL_HALF, 2, false }; return true;
+			case VK_FORMAT_R32_SFLOAT: info = { 1, CHANNEL_FLOAT, 4, false }; return true;
+			case VK_FORMAT_R32G32_SFLOAT: info = { 2, CHANNEL_FLOAT, 4, false }; return true;
+			case VK_FORMAT_R32G32B32A32_SFLOAT: info = { 4, CHANNEL_FLOAT, 4, false }; return true;
+			case VK_FORMAT_R32_UINT: info = { 1, CHANNEL_UINT, 4, false }; return true;
+			case VK_FORMAT_R32G32_UINT: info = { 2, CHANNEL_UINT, 4, false }; return true;
+			case VK_FORMAT_R32G32B32A32_UINT: info = { 4, CHANNEL_UINT, 4, false }; return true;
+			default: return false;
+			}
+		}
+
+		static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc)
+		{
+			static const std::vector<uint32_t> table = []
+			{
+				std::vector<uint32_t> t(256);
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					uint32_t c = i;
+					for (uint32_t k = 0; k < 8; k++)
+					{
+						c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+					}
+					t[i] = c;
+				}
+				return t;
+			}();
+			for (size_t i = 0; i < size; i++)
+			{
+				crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+			}
+			return crc;
+		}
+
+		static void appendBigEndian(std::vector<uint8_t> &data, uint32_t value)
+		{
+			for (int32_t shift = 24; shift >= 0; shift -= 8)
+			{
+				data.push_back(static_cast<uint8_t>(value >> shift));
+			}
+		}
+
+		template <typename T>
+		static void appendLittleEndian(std::vector<uint8_t> &data, T value)
+		{
+			const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+			data.insert(data.end(), bytes, bytes + sizeof(T));
+		}
+
+		static void appendString(std::vector<uint8_t> &data, const std::string &str)
+		{
+			data.insert(data.end(), str.begin(), str.end());
+			data.push_back(0);
+		}
+
+		static void writePngChunk(std::ofstream &file, const char *type, const std::vector<uint8_t> &data)
+		{
+			std::vector<uint8_t> chunk;
+			appendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+			chunk.insert(chunk.end(), type, type + 4);
+			chunk.insert(chunk.end(), data.begin(), data.end());
+			appendBigEndian(chunk, ~crc32(chunk.data() + 4, chunk.size() - 4, 0xFFFFFFFFu));
+			file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+		}
+
+		// 8 bit grey, grey + alpha, RGB or RGBA, stored in uncompressed deflate blocks as encoding speed matters more than size here
+		static bool writePng(const std::string &fileName, const uint8_t *pixels, const FormatInfo &format, uint32_t width, uint32_t height, bool ignoreAlpha)
+		{
+			const uint32_t outChannels = ((format.channelCount == 4) && ignoreAlpha) ? 3 : format.channelCount;
+			const uint8_t colorTypes[] = { 0, 0, 4, 2, 6 };
+
+			std::vector<uint8_t> header;
+			appendBigEndian(header, width);
+			appendBigEndian(header, height);
+			header.push_back(8);
+			header.push_back(colorTypes[outChannels]);
+			header.push_back(0);
+			header.push_back(0);
+			header.push_back(0);
+
+			// Every row starts with the filter type (none)
+			const size_t rowSize = 1 + static_cast<size_t>(width) * outChannels;
+			std::vector<uint8_t> raw(rowSize * height);
+			for (uint32_t y = 0; y < height; y++)
+			{
+				uint8_t *row = &raw[y * rowSize];
+				row[0] = 0;
+				const uint8_t *src = pixels + static_cast<size_t>(y) * width * format.channelCount;
+				for (uint32_t x = 0; x < width; x++)
+				{
+					uint8_t *dst = row + 1 + x * outChannels;
+					for (uint32_t c = 0; c < outChannels; c++)
+					{
+						const uint32_t srcChannel = (format.bgr && (c < 3)) ? 2 - c : c;
+						dst[c] = src[x * format.channelCount + srcChannel];
+					}
+				}
+			}
+
+			// zlib stream of stored blocks with an Adler-32 checksum
+			std::vector<uint8_t> compressed = { 0x78, 0x01 };
+			compressed.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+			size_t offset = 0;
+			do
+			{
+				const uint16_t blockSize = static_cast<uint16_t>(std::min<size_t>(raw.size() - offset, 65535));
+				compressed.push_back((offset + blockSize == raw.size()) ? 1 : 0);
+				appendLittleEndian<uint16_t>(compressed, blockSize);
+				appendLittleEndian<uint16_t>(compressed, static_cast<uint16_t>(~blockSize));
+				compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+				offset += blockSize;
+			} while (offset < raw.size());
+			uint32_t a = 1, b = 0;
+			for (auto byte : raw)
+			{
+				a = (a + byte) % 65521;
+				b = (b + a) % 65521;
+			}
+			appendBigEndian(compressed, (b << 16) | a);
+
+			std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			const uint8_t signature[] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+			file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+			writePngChunk(file, "IHDR", header);
+			writePngChunk(file, "IDAT", compressed);
+			writePngChunk(file, "IEND", {});
+			return file.good();
+		}
+
+		// Uncompressed scan line EXR with one line per block, channels keep their type (half, float or unsigned int)
+		static bool writeExr(const std::string &fileName, const uint8_t *pixels, const FormatInfo &format, uint32_t width, uint32_t height)
+		{
+			const char *channelNames[] = { "R", "G", "B", "A" };
+			const int32_t pixelTypes[] = { 0, 1, 2, 0 };
+			// Channels are stored in alphabetical order of their names
+			std::vector<uint32_t> channels;
+			for (uint32_t c = 0; c < format.channelCount; c++)
+			{
+				channels.push_back(c);
+			}
+			std::sort(channels.begin(), channels.end(), [&](uint32_t a, uint32_t b) { return std::string(channelNames[a]) < std::string(channelNames[b]); });
+
+			std::vector<uint8_t> data = { 0x76, 0x2F, 0x31, 0x01, 2, 0, 0, 0 };
+			auto addAttribute = [&](const std::string &name, const std::string &type, const std::vector<uint8_t> &value)
+			{
+				appendString(data, name);
+				appendString(data, type);
+				appendLittleEndian<int32_t>(data, static_cast<int32_t>(value.size()));
+				data.insert(data.end(), value.begin(), value.end());
+			};
+			std::vector<uint8_t> channelList;
+			for (auto c : channels)
+			{
+				appendString(channelList, channelNames[c]);
+				appendLittleEndian<int32_t>(channelList, pixelTypes[format.channelType]);
+				// pLinear and reserved bytes
+				appendLittleEndian<uint32_t>(channelList, 0);
+				appendLittleEndian<int32_t>(channelList, 1);
+				appendLittleEndian<int32_t>(channelList, 1);
+			}
+			channelList.push_back(0);
+			std::vector<uint8_t> window;
+			appendLittleEndian<int32_t>(window, 0);
+			appendLittleEndian<int32_t>(window, 0);
+			appendLittleEndian<int32_t>(window, static_cast<int32_t>(width) - 1);
+			appendLittleEndian<int32_t>(window, static_cast<int32_t>(height) - 1);
+			std::vector<uint8_t> one, center;
+			appendLittleEndian<float>(one, 1.0f);
+			appendLittleEndian<float>(center, 0.0f);
+			appendLittleEndian<float>(center, 0.0f);
+			addAttribute("channels", "chlist", channelList);
+			addAttribute("compression", "compression", { 0 });
+			addAttribute("dataWindow", "box2i", window);
+			addAttribute("displayWindow", "box2i", window);
+			addAttribute("lineOrder", "lineOrder", { 0 });
+			addAttribute("pixelAspectRatio", "float", one);
+			addAttribute("screenWindowCenter", "v2f", center);
+			addAttribute("screenWindowWidth", "float", one);
+			data.push_back(0);
+
+			const uint32_t lineSize = width * format.channelCount * format.channelSize;
+			const uint64_t firstLine = data.size() + static_cast<uint64_t>(height) * sizeof(uint64_t);
+			for (uint32_t y = 0; y < height; y++)
+			{
+				appendLittleEndian<uint64_t>(data, firstLine + static_cast<uint64_t>(y) * (lineSize + 2 * sizeof(int32_t)));
+			}
+			data.reserve(data.size() + static_cast<size_t>(height) * (lineSize + 2 * sizeof(int32_t)));
+			for (uint32_t y = 0; y < height; y++)
+			{
+				appendLittleEndian<int32_t>(data, static_cast<int32_t>(y));
+				appendLittleEndian<int32_t>(data, static_cast<int32_t>(lineSize));
+				const uint8_t *src = pixels + static_cast<size_t>(y) * lineSize;
+				for (auto c : channels)
+				{
+					for (uint32_t x = 0; x < width; x++)
+					{
+						const uint8_t *value = src + (x * format.channelCount + c) * format.channelSize;
+						data.insert(data.end(), value, value + format.channelSize);
+					}
+				}
+			}
+
+			std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(data.data()), data.size());
+			return file.good();
+		}
+
+		void encode(Slot &slot)
+		{
+			TraceZone traceZone("Encode capture");
+			FormatInfo format;
+			getFormatInfo(slot.format, format);
+			const uint8_t *pixels = static_cast<const uint8_t*>(slot.buffer.mapped);
+			if (slot.consumer)
+			{
+				slot.consumer(pixels, slot.width, slot.height, slot.format);
+				slot.consumer = nullptr;
+				return;
+			}
+			const bool written = (format.channelType == CHANNEL_UNORM8) ?
+				writePng(slot.fileName, pixels, format, slot.width, slot.height, slot.ignoreAlpha) :
+				writeExr(slot.fileName, pixels, format, slot.width, slot.height);
+			if (written)
+			{
+				writtenCount++;
+			}
+			else
+			{
+				failedCount++;
+				std::cout << "Could not write capture \"" << slot.fileName << "\"" << std::endl;
+			}
+		}
+
+		void encoderLoop()
+		{
+			CpuTrace::get().setThreadName("Frame capture");
+			CpuTopology::get().setThreadRole(CpuTopology::THREAD_ROLE_BACKGROUND);
+			while (true)
+			{
+				Slot *slot;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					queueCondition.wait(lock, [this] { return stopping || !encodeQueue.empty(); });
+					if (encodeQueue.empty())
+					{
+						return;
+					}
+					slot = encodeQueue.front();
+					encodeQueue.pop_front();
+				}
+				encode(*slot);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					slot->state = Slot::FREE;
+				}
+				encodedCondition.notify_all();
+			}
+		}
+
+		// Must be called with the mutex held, waits for the encoding thread if all slots are in use
+		Slot* acquireSlot(std::unique_lock<std::mutex> &lock)
+		{
+			while (true)
+			{
+				for (auto& slot : slots)
+				{
+					if (slot->state == Slot::FREE)
+					{
+						return slot.get();
+					}
+				}
+				if (slots.size() < maxSlots)
+				{
+					slots.push_back(std::unique_ptr<Slot>(new Slot()));
+					VkCommandBufferAllocateInfo cmdBufAllocateInfo = vkTools::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+					VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, &slots.back()->cmdBuffer));
+					return slots.back().get();
+				}
+				// Slots still being copied by the GPU can't be waited for without stalling
+				const bool encoding = std::any_of(slots.begin(), slots.end(), [](const std::unique_ptr<Slot> &slot) { return slot->state == Slot::ENCODING; });
+				if (!encoding)
+				{
+					return nullptr;
+				}
+				encodedCondition.wait(lock);
+			}
+		}
+
+		// Record the copy of an image into a free slot, the slot is either written to fileName or passed to consumer
+		VkCommandBuffer recordCapture(VkImage image, VkFormat format, uint32_t width, uint32_t height, VkImageLayout layout, const std::string &fileName, const Consumer &consumer, uint64_t frameNumber, bool ignoreAlpha)
+		{
+			FormatInfo info;
+			if (!getFormatInfo(format, info))
+			{
+				return VK_NULL_HANDLE;
+			}
+
+			std::unique_lock<std::mutex> lock(mutex);
+			Slot *slot = acquireSlot(lock);
+			if (!slot)
+			{
+				droppedCount++;
+				return VK_NULL_HANDLE;
+			}
+
+			// Buffers only grow, a free slot's buffer is no longer used by the GPU
+			const VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * info.channelCount * info.channelSize;
+			if (slot->buffer.size < size)
+			{
+				slot->buffer.destroy();
+				slot->buffer = vk::Buffer();
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryPropertyFlags, &slot->buffer, size));
+				VK_CHECK_RESULT(slot->buffer.map());
+			}
+			slot->state = Slot::COPYING;
+			slot->frameNumber = frameNumber;
+			slot->fileName = fileName;
+			slot->consumer = consumer;
+			slot->format = format;
+			slot->width = width;
+			slot->height = height;
+			slot->ignoreAlpha = ignoreAlpha;
+
+			VkCommandBuffer cmdBuffer = slot->cmdBuffer;
+			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+
+			VkImageMemoryBarrier imageBarrier = vkTools::initializers::imageMemoryBarrier();
+			imageBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+			imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			imageBarrier.oldLayout = layout;
+			imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			imageBarrier.image = image;
+			imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+			VkBufferImageCopy copyRegion = {};
+			copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copyRegion.imageExtent = { width, height, 1 };
+			vkCmdCopyImageToBuffer(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer.buffer, 1, &copyRegion);
+
+			// Later passes may write the image again, the copy has to finish first
+			imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			imageBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			imageBarrier.newLayout = layout;
+			VkBufferMemoryBarrier bufferBarrier = vkTools::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.buffer = slot->buffer.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 1, &imageBarrier);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+			return cmdBuffer;
+		}
+
+	public:
+		/** @brief Check if images of a format can be captured */
+		static bool formatSupported(VkFormat format)
+		{
+			FormatInfo info;
+			return getFormatInfo(format, info);
+		}
+
+		/** @brief File extension (including the dot) captures of a format are written with */
+		static std::string getFileExtension(VkFormat format)
+		{
+			FormatInfo info;
+			return (getFormatInfo(format, info) && (info.channelType == CHANNEL_UNORM8)) ? ".png" : ".exr";
+		}
+
+		/**
+		* @param vulkanDevice Device the readback buffers are created on
+		* @param queueFamilyIndex Queue family the capture command buffers will be submitted to
+		* @param maxSlots Maximum number of captures in flight (copying or encoding), captures beyond this wait for the encoding thread or are dropped
+		*/
+		VulkanFrameCapture(vk::VulkanDevice *vulkanDevice, uint32_t queueFamilyIndex, uint32_t maxSlots) : vulkanDevice(vulkanDevice), maxSlots(maxSlots), writtenCount(0), failedCount(0)
+		{
+			VkCommandPoolCreateInfo cmdPoolInfo = vkTools::initializers::commandPoolCreateInfo();
+			cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(vulkanDevice->logicalDevice, &cmdPoolInfo, nullptr, &commandPool));
+
+			// Cached memory makes reading the pixels on the host a lot faster
+			memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			for (uint32_t i = 0; i < vulkanDevice->memoryProperties.memoryTypeCount; i++)
+			{
+				if ((vulkanDevice->memoryProperties.memoryTypes[i].propertyFlags & (memoryPropertyFlags | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) == (memoryPropertyFlags | VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+				{
+					memoryPropertyFlags |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+					break;
+				}
+			}
+
+			encoder = std::thread(&VulkanFrameCapture::encoderLoop, this);
+		}
+
+		/** @note The device must be idle, pending copies are encoded before the encoding thread is stopped */
+		~VulkanFrameCapture()
+		{
+			flush();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			queueCondition.notify_all();
+			encoder.join();
+			for (auto& slot : slots)
+			{
+				slot->buffer.destroy();
+			}
+			vkDestroyCommandPool(vulkanDevice->logicalDevice, commandPool, nullptr);
+		}
+
+		/**
+		* Record the copy of an image into a free slot, to be written to a file
+		*
+		* @param image Image to capture, must have been created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+		* @param format Format of the image, see formatSupported
+		* @param width Width of the image
+		* @param height Height of the image
+		* @param layout Layout of the image when the command buffer is executed, it's restored after the copy
+		* @param fileName Name of the file without extension, 8 bit formats are written as PNG, all others as EXR
+		* @param frameNumber Number of the frame the command buffer is submitted with, see update
+		* @param (Optional) ignoreAlpha Write 8 bit four channel images without their alpha channel, e.g. for swap chain images
+		*
+		* @return Primary command buffer to submit with the frame after the image has been written, VK_NULL_HANDLE if the capture has been dropped
+		*/
+		VkCommandBuffer capture(VkImage image, VkFormat format, uint32_t width, uint32_t height, VkImageLayout layout, const std::string &fileName, uint64_t frameNumber, bool ignoreAlpha = false)
+		{
+			return recordCapture(image, format, width, height, layout, fileName + getFileExtension(format), nullptr, frameNumber, ignoreAlpha);
+		}
+
+		/**
+		* Record the copy of an image into a free slot, to be passed to a consumer on the encoding thread
+		* The consumer must not block for long, other captures wait for it
+		*
+		* @return Primary command buffer to submit with the frame after the image has been written, VK_NULL_HANDLE if the capture has been dropped
+		*/
+		VkCommandBuffer capture(VkImage image, VkFormat format, uint32_t width, uint32_t height, VkImageLayout layout, const Consumer &consumer, uint64_t frameNumber)
+		{
+			return recordCapture(image, format, width, height, layout, "", consumer, frameNumber, false);
+		}
+
+		/**
+		* Hand the copies of all frames up to a finished frame to the encoding thread
+		*
+		* @param finishedFrame Number of the latest frame whose fence has been waited for, UINT64_MAX if the device is idle
+		*/
+		void update(uint64_t finishedFrame)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (auto& slot : slots)
+				{
+					if ((slot->state == Slot::COPYING) && (slot->frameNumber <= finishedFrame))
+					{
+						slot->state = Slot::ENCODING;
+						encodeQueue.push_back(slot.get());
+					}
+				}
+			}
+			queueCondition.notify_all();
+		}
+
+		/** @brief Encode all pending captures and wait for them to be written, the device must be idle */
+		void flush()
+		{
+			update(UINT64_MAX);
+			std::unique_lock<std::mutex> lock(mutex);
+			encodedCondition.wait(lock, [this] { return std::none_of(slots.begin(), slots.end(), [](const std::unique_ptr<Slot> &slot) { return slot->state != Slot::FREE; }); });
+		}
+
+		/** @brief Number of captures written to files */
+		uint32_t getWrittenCount()
+		{
+			return writtenCount;
+		}
+
+		/** @brief Number of captures that couldn't be written or were dropped as all slots were being copied */
+		uint32_t getFailedCount()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return failedCount + droppedCount;
+		}
+	};
+}
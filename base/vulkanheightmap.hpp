@@ -1,30 +1,191 @@
 /*
 * Heightmap terrain generator
 *
+* The heights can either be turned into a fixed grid on the CPU (loadFromFile) or be sampled by tessellation shaders,
+* with a quadtree selecting the patches to draw per view (buildQuadtree and selectPatches)
+* Interpolated heights and normals for batches of positions are available with getHeights (4 wide SSE2 or NEON)
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
-#include <glm/glm.hpp>
+#pragma once
+
+#include <vector>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <gli/gli.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define HEIGHTMAP_SIMD_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HEIGHTMAP_SIMD_NEON
+#endif
+
 #include "vulkan/vulkan.h"
 #include "vulkandevice.hpp"
 #include "vulkanbuffer.hpp"
+#include "assetfile.hpp"
+#include "frustum.hpp"
+
+// Four wide float operations used by the batched height queries
+namespace heightmapSimd
+{
+#if defined(HEIGHTMAP_SIMD_SSE)
+	typedef __m128 float4;
+	inline float4 load(const float *p) { return _mm_loadu_ps(p); }
+	inline void store(float *p, float4 v) { _mm_storeu_ps(p, v); }
+	inline float4 set1(float f) { return _mm_set1_ps(f); }
+	inline float4 sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+	inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+	// a * b + c
+	inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	inline float4 clamp(float4 v, float4 low, float4 high) { return _mm_min_ps(_mm_max_ps(v, low), high); }
+	// Integer part of non negative values, stored as integer and returned as float
+	inline float4 truncate(float4 v, int32_t *p)
+	{
+		__m128i i = _mm_cvttps_epi32(v);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), i);
+		return _mm_cvtepi32_ps(i);
+	}
+	// Estimate refined with one Newton-Raphson step
+	inline float4 rsqrt(float4 v)
+	{
+		float4 r = _mm_rsqrt_ps(v);
+		return _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), v), _mm_mul_ps(r, r))));
+	}
+#elif defined(HEIGHTMAP_SIMD_NEON)
+	typedef float32x4_t float4;
+	inline float4 load(const float *p) { return vld1q_f32(p); }
+	inline void store(float *p, float4 v) { vst1q_f32(p, v); }
+	inline float4 set1(float f) { return vdupq_n_f32(f); }
+	inline float4 sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+	inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+	inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+	inline float4 clamp(float4 v, float4 low, float4 high) { return vminq_f32(vmaxq_f32(v, low), high); }
+	inline float4 truncate(float4 v, int32_t *p)
+	{
+		int32x4_t i = vcvtq_s32_f32(v);
+		vst1q_s32(p, i);
+		return vcvtq_f32_s32(i);
+	}
+	// Estimate refined with two Newton-Raphson steps, the NEON estimate is less precise than SSE's
+	inline float4 rsqrt(float4 v)
+	{
+		float4 r = vrsqrteq_f32(v);
+		r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(v, r), r));
+		return vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(v, r), r));
+	}
+#else
+	struct float4 { float v[4]; };
+	inline float4 load(const float *p) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+	inline void store(float *p, float4 v) { for (int i = 0; i < 4; i++) p[i] = v.v[i]; }
+	inline float4 set1(float f) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = f; return r; }
+	inline float4 sub(float4 a, float4 b) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] - b.v[i]; return r; }
+	inline float4 mul(float4 a, float4 b) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * b.v[i]; return r; }
+	inline float4 madd(float4 a, float4 b, float4 c) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * b.v[i] + c.v[i]; return r; }
+	inline float4 clamp(float4 v, float4 low, float4 high) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = std::min(std::max(v.v[i], low.v[i]), high.v[i]); return r; }
+	inline float4 truncate(float4 v, int32_t *p) { float4 r; for (int i = 0; i < 4; i++) { p[i] = static_cast<int32_t>(v.v[i]); r.v[i] = static_cast<float>(p[i]); } return r; }
+	inline float4 rsqrt(float4 v) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = 1.0f / sqrtf(v.v[i]); return r; }
+#endif
+}
 
 namespace vkTools 
 {
 	class HeightMap
 	{
+	public:
+		// Quadtree node selected for rendering, in normalized heightmap coordinates
+		// Layout matches the per instance attribute of terrain.vert
+		struct Patch {
+			glm::vec2 offset;
+			float size;
+			// Log2 of the size ratio to a coarser neighbour per edge (west, north, east, south), four bits each
+			float coarserEdges;
+		};
+
+		// Placement of the heightmap in the world, up is negative y
+		struct Placement {
+			// Position of the first texel at height zero
+			glm::vec3 origin;
+			// Size along x and z
+			glm::vec2 extent;
+		};
+
 	private:
-		uint16_t *heightdata;
-		uint32_t dim;
+		uint16_t *heightdata = nullptr;
+		uint32_t dim = 0;
 		uint32_t scale;
 
 		vk::VulkanDevice *device = nullptr;
 		VkQueue copyQueue = VK_NULL_HANDLE;
+
+		uint32_t quadtreeDepth = 0;
+		// Minimum and maximum normalized height of the quadtree's nodes, one level per depth with the root first
+		std::vector<std::vector<glm::vec2>> heightRanges;
+		// Depth of the selected patch covering each node of the deepest level, used to find coarser neighbours
+		std::vector<uint8_t> selectedDepths;
+
+		// Node selection state of selectPatches
+		struct Selection {
+			const vkTools::Frustum *frustum;
+			Placement placement;
+			glm::vec3 eye;
+			float splitDistance;
+			std::vector<Patch> *patches;
+			std::vector<uint8_t> levels;
+		};
+
+		// Mark the deepest level nodes covered by a node with the depth of the patch drawn for it
+		void markSelected(uint32_t level, uint32_t x, uint32_t y, uint8_t depth)
+		{
+			const uint32_t cells = 1 << (quadtreeDepth - level);
+			const uint32_t stride = 1 << quadtreeDepth;
+			for (uint32_t cy = y * cells; cy < (y + 1) * cells; cy++)
+			{
+				std::fill(selectedDepths.begin() + cy * stride + x * cells, selectedDepths.begin() + cy * stride + (x + 1) * cells, depth);
+			}
+		}
+
+		void selectNode(Selection &selection, uint32_t level, uint32_t x, uint32_t y, bool inside)
+		{
+			const Placement &placement = selection.placement;
+			const float size = 1.0f / (1 << level);
+			const glm::vec2 range = heightRanges[level][x + y * (1 << level)];
+			const glm::vec3 min = placement.origin + glm::vec3(x * size * placement.extent.x, -range.y * heightScale, y * size * placement.extent.y);
+			const glm::vec3 max = placement.origin + glm::vec3((x + 1) * size * placement.extent.x, -range.x * heightScale, (y + 1) * size * placement.extent.y);
+
+			if (!inside)
+			{
+				const vkTools::Frustum::Intersection intersection = selection.frustum->checkBox(min, max);
+				if (intersection == vkTools::Frustum::OUTSIDE)
+				{
+					markSelected(level, x, y, UINT8_MAX);
+					return;
+				}
+				// Children of a node inside the frustum are inside too
+				inside = (intersection == vkTools::Frustum::INSIDE);
+			}
+
+			// Split while the eye is close to the node's bounds compared to its size
+			const float distance = glm::length(selection.eye - glm::clamp(selection.eye, min, max));
+			if ((level < quadtreeDepth) && (distance < size * std::max(placement.extent.x, placement.extent.y) * selection.splitDistance))
+			{
+				for (uint32_t i = 0; i < 4; i++)
+				{
+					selectNode(selection, level + 1, x * 2 + (i & 1), y * 2 + (i >> 1), inside);
+				}
+				return;
+			}
+
+			markSelected(level, x, y, static_cast<uint8_t>(level));
+			selection.patches->push_back({ glm::vec2(x, y) * size, size, 0.0f });
+			selection.levels.push_back(static_cast<uint8_t>(level));
+		}
+
 	public:
 		enum Topology { topologyTriangles, topologyQuads };
 
@@ -57,6 +218,17 @@ namespace vkTools
 			delete[] heightdata;
 		}
 
+		uint32_t getDim()
+		{
+			return dim;
+		}
+
+		/** @brief Normalized 16 bit heights, dim * dim values */
+		const uint16_t* getHeightData()
+		{
+			return heightdata;
+		}
+
 		float getHeight(uint32_t x, uint32_t y)
 		{
 			glm::ivec2 rpos = glm::ivec2(x, y) * glm::ivec2(scale);
@@ -66,6 +238,227 @@ namespace vkTools
 			return *(heightdata + (rpos.x + rpos.y * dim) * scale) / 65535.0f * heightScale;
 		}
 
+		/**
+		* Load the heights without generating any geometry, e.g. for rendering with tessellation shaders sampling them
+		*
+		* @note The heightmap must be a square single channel 16 bit texture, only the first mip level is used
+		*/
+#if defined(__ANDROID__)
+		void loadHeights(const std::string filename, AAssetManager* assetManager)
+#else
+		void loadHeights(const std::string filename)
+#endif
+		{
+#if defined(__ANDROID__)
+			vkTools::AssetFile file(assetManager);
+#else
+			vkTools::AssetFile file;
+#endif
+			bool opened = file.open(filename);
+			assert(opened);
+			gli::texture2D heightTex(gli::load(static_cast<const char*>(file.data()), file.getSize()));
+			file.close();
+			assert(!heightTex.empty() && (heightTex.dimensions().x == heightTex.dimensions().y));
+			dim = static_cast<uint32_t>(heightTex.dimensions().x);
+			delete[] heightdata;
+			heightdata = new uint16_t[dim * dim];
+			memcpy(heightdata, heightTex[0].data(), dim * dim * sizeof(uint16_t));
+		}
+
+		/**
+		* Build the quadtree's height bounds used for culling the patches
+		*
+		* @param depth Depth of the finest patches, the heightmap is split into 4^depth of them
+		*/
+		void buildQuadtree(uint32_t depth)
+		{
+			assert(heightdata && (depth < 16));
+			quadtreeDepth = depth;
+			heightRanges.resize(depth + 1);
+
+			// Nodes include the next row and column of texels, which the filtering reaches on their far edges
+			const uint32_t leaves = 1 << depth;
+			heightRanges[depth].resize(leaves * leaves);
+			for (uint32_t y = 0; y < leaves; y++)
+			{
+				for (uint32_t x = 0; x < leaves; x++)
+				{
+					glm::uvec2 first = glm::uvec2(x, y) * dim / leaves;
+					glm::uvec2 last = glm::min(glm::uvec2(x + 1, y + 1) * dim / leaves, glm::uvec2(dim - 1));
+					uint16_t minHeight = UINT16_MAX;
+					uint16_t maxHeight = 0;
+					for (uint32_t ty = first.y; ty <= last.y; ty++)
+					{
+						for (uint32_t tx = first.x; tx <= last.x; tx++)
+						{
+							minHeight = std::min(minHeight, heightdata[tx + ty * dim]);
+							maxHeight = std::max(maxHeight, heightdata[tx + ty * dim]);
+						}
+					}
+					heightRanges[depth][x + y * leaves] = glm::vec2(minHeight, maxHeight) / 65535.0f;
+				}
+			}
+
+			for (int32_t level = depth - 1; level >= 0; level--)
+			{
+				const uint32_t nodes = 1 << level;
+				const std::vector<glm::vec2> &children = heightRanges[level + 1];
+				heightRanges[level].resize(nodes * nodes);
+				for (uint32_t y = 0; y < nodes; y++)
+				{
+					for (uint32_t x = 0; x < nodes; x++)
+					{
+						glm::vec2 range = children[x * 2 + y * 2 * nodes * 2];
+						for (uint32_t i = 1; i < 4; i++)
+						{
+							const glm::vec2 &child = children[x * 2 + (i & 1) + (y * 2 + (i >> 1)) * nodes * 2];
+							range = glm::vec2(std::min(range.x, child.x), std::max(range.y, child.y));
+						}
+						heightRanges[level][x + y * nodes] = range;
+					}
+				}
+			}
+
+			selectedDepths.resize(leaves * leaves);
+		}
+
+		/**
+		* Select the patches to draw for a view, nodes outside the frustum are culled and nodes are split
+		* while the eye is closer to them than their size times splitDistance
+		*
+		* @param frustum View frustum in world space
+		* @param eye Eye position in world space
+		* @param placement Position and size of the heightmap in the world, heights are scaled with heightScale
+		* @param patches Selected patches, replaces the contents, edges adjacent to coarser patches are marked
+		*/
+		void selectPatches(const vkTools::Frustum &frustum, const glm::vec3 &eye, const Placement &placement, float splitDistance, std::vector<Patch> &patches)
+		{
+			assert(!heightRanges.empty());
+			Selection selection;
+			selection.frustum = &frustum;
+			selection.placement = placement;
+			selection.eye = eye;
+			selection.splitDistance = splitDistance;
+			selection.patches = &patches;
+			patches.clear();
+			selectNode(selection, 0, 0, 0, false);
+
+			// A patch's edge next to a coarser one has to match the coarser patch's vertices, culled neighbours don't matter
+			const int32_t stride = 1 << quadtreeDepth;
+			for (size_t i = 0; i < patches.size(); i++)
+			{
+				const uint8_t level = selection.levels[i];
+				const int32_t cells = 1 << (quadtreeDepth - level);
+				const glm::ivec2 first = glm::ivec2(patches[i].offset * static_cast<float>(stride));
+				const glm::ivec2 neighbours[4] = {
+					glm::ivec2(first.x - 1, first.y),
+					glm::ivec2(first.x, first.y - 1),
+					glm::ivec2(first.x + cells, first.y),
+					glm::ivec2(first.x, first.y + cells),
+				};
+				uint32_t coarserEdges = 0;
+				for (uint32_t edge = 0; edge < 4; edge++)
+				{
+					const glm::ivec2 &cell = neighbours[edge];
+					if ((cell.x < 0) || (cell.y < 0) || (cell.x >= stride) || (cell.y >= stride))
+					{
+						continue;
+					}
+					const uint8_t neighbourLevel = selectedDepths[cell.x + cell.y * stride];
+					if (neighbourLevel < level)
+					{
+						coarserEdges |= std::min(level - neighbourLevel, 15) << (edge * 4);
+					}
+				}
+				patches[i].coarserEdges = static_cast<float>(coarserEdges);
+			}
+		}
+
+		/**
+		* Bilinearly interpolated heights and normals at a batch of world positions, four positions at a time
+		* Texel centers and clamped edges match the linear filtering of the height texture on the GPU
+		*
+		* @param placement Position and size of the heightmap in the world, as for selectPatches
+		* @param positions World positions, only x and z are used
+		* @param count Number of positions
+		* @param heights World space y of the terrain at the positions (up is negative y)
+		* @param normals Optional, unit normals pointing up from the interpolated surface
+		*/
+		void getHeights(const Placement &placement, const glm::vec3 *positions, size_t count, float *heights, glm::vec3 *normals = nullptr)
+		{
+			using namespace heightmapSimd;
+			assert(heightdata);
+			const glm::vec2 texelsPerUnit = glm::vec2(static_cast<float>(dim)) / placement.extent;
+			const float4 scaleX = set1(texelsPerUnit.x);
+			const float4 scaleZ = set1(texelsPerUnit.y);
+			const float4 biasX = set1(-placement.origin.x * texelsPerUnit.x - 0.5f);
+			const float4 biasZ = set1(-placement.origin.z * texelsPerUnit.y - 0.5f);
+			const float4 zero = set1(0.0f);
+			const float4 one = set1(1.0f);
+			const float4 lastTexel = set1(static_cast<float>(dim - 1));
+			const float4 originY = set1(placement.origin.y);
+			const float4 heightUnit = set1(heightScale / 65535.0f);
+			// World space slopes per texel height difference
+			const float4 slopeX = set1(heightScale / 65535.0f * texelsPerUnit.x);
+			const float4 slopeZ = set1(heightScale / 65535.0f * texelsPerUnit.y);
+
+			for (size_t first = 0; first < count; first += 4)
+			{
+				// The last batch is padded with its last position
+				const size_t batchSize = std::min<size_t>(count - first, 4);
+				float x[4], z[4];
+				for (size_t i = 0; i < 4; i++)
+				{
+					const glm::vec3 &position = positions[first + std::min(i, batchSize - 1)];
+					x[i] = position.x;
+					z[i] = position.z;
+				}
+				const float4 tx = clamp(madd(load(x), scaleX, biasX), zero, lastTexel);
+				const float4 tz = clamp(madd(load(z), scaleZ, biasZ), zero, lastTexel);
+				int32_t ix[4], iz[4];
+				const float4 fx = sub(tx, truncate(tx, ix));
+				const float4 fz = sub(tz, truncate(tz, iz));
+
+				// There are no gathers in SSE2 and NEON, the four texels of each position are fetched individually
+				float h00[4], h10[4], h01[4], h11[4];
+				for (size_t i = 0; i < 4; i++)
+				{
+					const uint32_t x1 = std::min(static_cast<uint32_t>(ix[i]) + 1, dim - 1);
+					const uint16_t *row0 = heightdata + iz[i] * dim;
+					const uint16_t *row1 = heightdata + std::min(static_cast<uint32_t>(iz[i]) + 1, dim - 1) * dim;
+					h00[i] = row0[ix[i]];
+					h10[i] = row0[x1];
+					h01[i] = row1[ix[i]];
+					h11[i] = row1[x1];
+				}
+				const float4 a = load(h00);
+				const float4 b = load(h10);
+				const float4 c = load(h01);
+				const float4 d = load(h11);
+				const float4 top = madd(sub(b, a), fx, a);
+				const float4 bottom = madd(sub(d, c), fx, c);
+				float result[4];
+				store(result, sub(originY, mul(madd(sub(bottom, top), fz, top), heightUnit)));
+				std::copy(result, result + batchSize, heights + first);
+
+				if (normals)
+				{
+					// Derivatives of the bilinear patch, the normal (-dx, -1, -dz) points up
+					const float4 dx = mul(madd(sub(sub(d, c), sub(b, a)), fz, sub(b, a)), slopeX);
+					const float4 dz = mul(madd(sub(sub(d, b), sub(c, a)), fx, sub(c, a)), slopeZ);
+					const float4 length = rsqrt(madd(dx, dx, madd(dz, dz, one)));
+					float nx[4], ny[4], nz[4];
+					store(nx, mul(sub(zero, dx), length));
+					store(ny, sub(zero, length));
+					store(nz, mul(sub(zero, dz), length));
+					for (size_t i = 0; i < batchSize; i++)
+					{
+						normals[first + i] = glm::vec3(nx[i], ny[i], nz[i]);
+					}
+				}
+			}
+		}
+
 #if defined(__ANDROID__)
 		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology, AAssetManager* assetManager)
 #else
@@ -76,21 +469,10 @@ namespace vkTools
 			assert(copyQueue != VK_NULL_HANDLE);
 
 #if defined(__ANDROID__)
-			AAsset* asset = AAssetManager_open(assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-			void *textureData = malloc(size);
-			AAsset_read(asset, textureData, size);
-			AAsset_close(asset);
-			gli::texture2D heightTex(gli::load((const char*)textureData, size));
-			free(textureData);
+			loadHeights(filename, assetManager);
 #else
-			gli::texture2D heightTex(gli::load(filename));
+			loadHeights(filename);
 #endif
-			dim = static_cast<uint32_t>(heightTex.dimensions().x);
-			heightdata = new uint16_t[dim * dim];
-			memcpy(heightdata, heightTex.data(), heightTex.size());
 			this->scale = dim / patchsize;
 			this->heightScale = scale.y;
 
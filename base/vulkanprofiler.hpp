@@ -0,0 +1,566 @@
+/*
+* GPU pass timing with Vulkan timestamp queries and pass statistics with pipeline statistics queries
+*
+* Timestamps are written by small command buffers submitted in between a frame's passes
+* This keeps pre-recorded command buffers that are reused across frames in flight unchanged
+* Every frame in flight has its own query pool, which is only read once the frame's fence has been signaled, so reading never stalls
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include <vulkan/vulkan.h>
+
+#include "vulkantools.h"
+#include "vulkandevice.hpp"
+#include "vulkanbuffer.hpp"
+#include "cputrace.hpp"
+
+namespace vkTools
+{
+	/**
+	* @brief Measures the GPU time of a frame's passes
+	*
+	* Timestamp i ends pass i - 1 and begins pass i, so a frame with n passes writes n + 1 timestamps
+	* All timestamps are written at the bottom of the pipe, a pass' time is the time between the completion of the work submitted before and after it
+	*/
+	class VulkanGpuProfiler
+	{
+	public:
+		/** @brief Number of frames the rolling averages are calculated over */
+		static const uint32_t SAMPLE_COUNT = 64;
+
+	private:
+		VkDevice device;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+
+		struct Frame
+		{
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			// One command buffer per timestamp, the first one also resets the query pool
+			std::vector<VkCommandBuffer> timestampCmdBuffers;
+			// Set once all of the frame's timestamps have been submitted
+			bool submitted = false;
+			// CPU trace time of the submission
+			double submitTime = 0.0;
+		};
+		std::vector<Frame> frames;
+
+		std::vector<std::string> passNames;
+		// Nanoseconds per timestamp tick
+		float timestampPeriod;
+		// Timestamps only contain timestampValidBits valid bits
+		uint64_t timestampMask;
+
+		// Rolling window of the pass times in milliseconds, SAMPLE_COUNT samples per pass
+		std::vector<float> samples;
+		uint32_t sampleCount = 0;
+		uint32_t sampleIndex = 0;
+
+		// Sum of the pass times since the last call to resetTotals, used for averages over whole benchmark runs
+		std::vector<double> totals;
+		uint64_t totalFrames = 0;
+
+		std::ofstream log;
+		uint64_t collectedFrames = 0;
+
+		// Track the pass times are added to if a CPU trace is recorded
+		uint32_t traceTrack = UINT32_MAX;
+
+	public:
+		/**
+		* Check if timestamps can be written on a queue family
+		*
+		* @param vulkanDevice Device to check
+		* @param queueFamilyIndex Queue family the timestamps will be written on
+		*
+		* @return True if the queue family supports timestamps
+		*/
+		static bool supported(vk::VulkanDevice *vulkanDevice, uint32_t queueFamilyIndex)
+		{
+			return vulkanDevice->timestampsSupported(queueFamilyIndex);
+		}
+
+		/**
+		* Create the query pools and the timestamp command buffers for all frames in flight
+		*
+		* @param vulkanDevice Device to create the profiler on
+		* @param queueFamilyIndex Queue family the timestamp command buffers will be submitted to
+		* @param framesInFlight Number of frames in flight
+		* @param passNames Names of the passes that are timed, in submission order
+		*/
+		VulkanGpuProfiler(vk::VulkanDevice *vulkanDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight, const std::vector<std::string> &passNames)
+		{
+			assert(supported(vulkanDevice, queueFamilyIndex));
+			assert(!passNames.empty());
+
+			this->device = vulkanDevice->logicalDevice;
+			this->passNames = passNames;
+			timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+			const uint32_t validBits = vulkanDevice->queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+			timestampMask = (validBits >= 64) ? UINT64_MAX : ((1ull << validBits) - 1);
+			samples.resize(passNames.size() * SAMPLE_COUNT, 0.0f);
+			totals.resize(passNames.size(), 0.0);
+
+			const uint32_t timestampCount = getTimestampCount();
+
+			VkCommandPoolCreateInfo cmdPoolInfo = vkTools::initializers::commandPoolCreateInfo();
+			cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
+
+			frames.resize(framesInFlight);
+			for (auto& frame : frames)
+			{
+				VkQueryPoolCreateInfo queryPoolInfo = {};
+				queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+				queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+				queryPoolInfo.queryCount = timestampCount;
+				VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &frame.queryPool));
+
+				frame.timestampCmdBuffers.resize(timestampCount);
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo = vkTools::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, timestampCount);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, frame.timestampCmdBuffers.data()));
+
+				// The command buffers only depend on the frame's query pool, so they are recorded once
+				VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+				for (uint32_t i = 0; i < timestampCount; i++)
+				{
+					VkCommandBuffer cmdBuffer = frame.timestampCmdBuffers[i];
+					VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+					if (i == 0)
+					{
+						vkCmdResetQueryPool(cmdBuffer, frame.queryPool, 0, timestampCount);
+					}
+					vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, i);
+					VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+				}
+			}
+		}
+
+		~VulkanGpuProfiler()
+		{
+			for (auto& frame : frames)
+			{
+				vkDestroyQueryPool(device, frame.queryPool, nullptr);
+			}
+			vkDestroyCommandPool(device, commandPool, nullptr);
+		}
+
+		/**
+		* Start writing the collected pass times to a CSV file, one line per frame
+		*
+		* @param filename Name of the CSV file
+		*
+		* @return True if the file could be opened
+		*/
+		bool openLog(const std::string &filename)
+		{
+			log.open(filename, std::ios::out | std::ios::trunc);
+			if (!log.is_open())
+			{
+				return false;
+			}
+			log << "frame";
+			for (auto& passName : passNames)
+			{
+				log << "," << passName;
+			}
+			log << ",total" << std::endl;
+			return true;
+		}
+
+		uint32_t getPassCount()
+		{
+			return static_cast<uint32_t>(passNames.size());
+		}
+
+		uint32_t getTimestampCount()
+		{
+			return getPassCount() + 1;
+		}
+
+		const std::string& getPassName(uint32_t pass)
+		{
+			return passNames[pass];
+		}
+
+		/**
+		* Get the command buffer writing a timestamp of a frame in flight
+		*
+		* @param frame Index of the frame in flight
+		* @param timestamp Index of the timestamp, the command buffer of timestamp 0 must be submitted first
+		*
+		* @return Primary command buffer to submit in between the passes
+		*/
+		VkCommandBuffer getTimestampCmdBuffer(uint32_t frame, uint32_t timestamp)
+		{
+			assert(timestamp < getTimestampCount());
+			return frames[frame].timestampCmdBuffers[timestamp];
+		}
+
+		/** @brief Flag a frame in flight as submitted with all of its timestamps, its results are read by the next call to collect for the frame */
+		void frameSubmitted(uint32_t frame)
+		{
+			frames[frame].submitted = true;
+			frames[frame].submitTime = CpuTrace::get().isActive() ? CpuTrace::get().now() : 0.0;
+		}
+
+		/**
+		* Read the timestamps of the last submission of a frame in flight and add them to the rolling averages
+		*
+		* @param frame Index of the frame in flight
+		*
+		* @note Must only be called after the frame's fence has been signaled, results that aren't available are skipped without waiting
+		*/
+		void collect(uint32_t frame)
+		{
+			if (!frames[frame].submitted)
+			{
+				return;
+			}
+			frames[frame].submitted = false;
+
+			std::vector<uint64_t> timestamps(getTimestampCount());
+			VkResult result = vkGetQueryPoolResults(
+				device,
+				frames[frame].queryPool,
+				0,
+				getTimestampCount(),
+				timestamps.size() * sizeof(uint64_t),
+				timestamps.data(),
+				sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT);
+			if (result != VK_SUCCESS)
+			{
+				return;
+			}
+
+			float total = 0.0f;
+			for (uint32_t pass = 0; pass < getPassCount(); pass++)
+			{
+				const uint64_t ticks = ((timestamps[pass + 1] & timestampMask) - (timestamps[pass] & timestampMask)) & timestampMask;
+				const float milliseconds = static_cast<float>(ticks) * timestampPeriod / 1000000.0f;
+				samples[pass * SAMPLE_COUNT + sampleIndex] = milliseconds;
+				totals[pass] += milliseconds;
+				total += milliseconds;
+			}
+			totalFrames++;
+			sampleIndex = (sampleIndex + 1) % SAMPLE_COUNT;
+			if (sampleCount < SAMPLE_COUNT)
+			{
+				sampleCount++;
+			}
+
+			// Timestamps aren't calibrated against the CPU clock, so the passes are placed on the trace's GPU track starting at the frame's submission
+			// The GPU can't start before that, so passes may appear earlier than they were executed but never before the CPU work feeding them
+			CpuTrace &trace = CpuTrace::get();
+			if (trace.isActive())
+			{
+				if (traceTrack == UINT32_MAX)
+				{
+					traceTrack = trace.addTrack("GPU");
+				}
+				for (uint32_t pass = 0; pass < getPassCount(); pass++)
+				{
+					const double start = frames[frame].submitTime + static_cast<double>(((timestamps[pass] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask) * timestampPeriod / 1000.0;
+					const double end = frames[frame].submitTime + static_cast<double>(((timestamps[pass + 1] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask) * timestampPeriod / 1000.0;
+					trace.addZone(passNames[pass], start, end, traceTrack);
+				}
+			}
+
+			if (log.is_open())
+			{
+				log << collectedFrames << std::fixed << std::setprecision(4);
+				for (uint32_t pass = 0; pass < getPassCount(); pass++)
+				{
+					log << "," << samples[pass * SAMPLE_COUNT + (sampleIndex + SAMPLE_COUNT - 1) % SAMPLE_COUNT];
+				}
+				log << "," << total << "\n";
+			}
+			collectedFrames++;
+		}
+
+		/** @brief GPU time of a pass in milliseconds in the last collected frame */
+		float getLast(uint32_t pass)
+		{
+			if (sampleCount == 0)
+			{
+				return 0.0f;
+			}
+			return samples[pass * SAMPLE_COUNT + (sampleIndex + SAMPLE_COUNT - 1) % SAMPLE_COUNT];
+		}
+
+		/** @brief Average GPU time of a pass in milliseconds over the last SAMPLE_COUNT collected frames */
+		float getAverage(uint32_t pass)
+		{
+			if (sampleCount == 0)
+			{
+				return 0.0f;
+			}
+			float sum = 0.0f;
+			for (uint32_t i = 0; i < sampleCount; i++)
+			{
+				sum += samples[pass * SAMPLE_COUNT + i];
+			}
+			return sum / static_cast<float>(sampleCount);
+		}
+
+		/** @brief Restart the averages returned by getTotalAverage */
+		void resetTotals()
+		{
+			std::fill(totals.begin(), totals.end(), 0.0);
+			totalFrames = 0;
+		}
+
+		/** @brief Average GPU time of a pass in milliseconds over all frames collected since the last call to resetTotals */
+		float getTotalAverage(uint32_t pass)
+		{
+			return (totalFrames > 0) ? static_cast<float>(totals[pass] / totalFrames) : 0.0f;
+		}
+	};
+	/**
+	* @brief Counts primitives and shader invocations of a frame's passes with pipeline statistics queries
+	*
+	* The passes begin and end their query in their own command buffers, all frames in flight share one query pool for this
+	* Each frame copies the results of its passes into its own host visible buffer and resets the queries right after the passes have been submitted
+	* The copies are ordered after the passes and before the next frame's passes on the queue, so the frames can't overwrite each others results
+	*/
+	class VulkanPipelineStatistics
+	{
+	public:
+		/** @brief Pipeline statistics counted for each pass, in the order of the members of Statistics */
+		static const VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+		/** @brief Results of one pass, counters are written in bit order of their flags */
+		struct Statistics
+		{
+			uint64_t inputAssemblyPrimitives = 0;
+			uint64_t vertexShaderInvocations = 0;
+			uint64_t clippingPrimitives = 0;
+			uint64_t fragmentShaderInvocations = 0;
+		};
+
+	private:
+		vk::VulkanDevice *vulkanDevice;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+
+		struct Frame
+		{
+			// Records the copy of the frame's results, re-recorded for the passes active in the frame
+			VkCommandBuffer copyCmdBuffer;
+			// Host visible copy of the frame's results
+			vk::Buffer results;
+			// Passes whose results have been copied by the frame's last submission
+			uint32_t passMask = 0;
+		};
+		std::vector<Frame> frames;
+
+		std::vector<std::string> passNames;
+		// Results of the last collected frame in which each pass was active
+		std::vector<Statistics> latest;
+		// Sum of all collected results for the averages
+		std::vector<Statistics> totals;
+		std::vector<uint64_t> collectedFrames;
+
+	public:
+		/**
+		* Check if pipeline statistics queries can be used
+		*
+		* @param vulkanDevice Device to check, the pipelineStatisticsQuery feature must have been enabled
+		*/
+		static bool supported(vk::VulkanDevice *vulkanDevice)
+		{
+			return vulkanDevice->enabledFeatures.pipelineStatisticsQuery == VK_TRUE;
+		}
+
+		/**
+		* Check if queries can be active while secondary command buffers are executed
+		*
+		* @note If this is not supported, passes executing secondary command buffers can't be counted
+		*/
+		static bool inheritedQueriesSupported(vk::VulkanDevice *vulkanDevice)
+		{
+			return vulkanDevice->enabledFeatures.inheritedQueries == VK_TRUE;
+		}
+
+		/**
+		* Create the shared query pool and the result buffers for all frames in flight
+		*
+		* @param vulkanDevice Device to create the queries on
+		* @param queue Queue (of the graphics family) used to reset the queries before their first use
+		* @param framesInFlight Number of frames in flight
+		* @param passNames Names of the passes that are counted
+		*/
+		VulkanPipelineStatistics(vk::VulkanDevice *vulkanDevice, VkQueue queue, uint32_t framesInFlight, const std::vector<std::string> &passNames)
+		{
+			assert(supported(vulkanDevice));
+			assert(passNames.size() <= 32);
+
+			this->vulkanDevice = vulkanDevice;
+			this->passNames = passNames;
+			latest.resize(passNames.size());
+			totals.resize(passNames.size());
+			collectedFrames.resize(passNames.size(), 0);
+
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			queryPoolInfo.queryCount = getPassCount();
+			queryPoolInfo.pipelineStatistics = STATISTIC_FLAGS;
+			VK_CHECK_RESULT(vkCreateQueryPool(vulkanDevice->logicalDevice, &queryPoolInfo, nullptr, &queryPool));
+
+			VkCommandPoolCreateInfo cmdPoolInfo = vkTools::initializers::commandPoolCreateInfo();
+			cmdPoolInfo.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(vulkanDevice->logicalDevice, &cmdPoolInfo, nullptr, &commandPool));
+
+			frames.resize(framesInFlight);
+			for (auto& frame : frames)
+			{
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo = vkTools::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, &frame.copyCmdBuffer));
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(
+					VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					&frame.results,
+					getPassCount() * sizeof(Statistics)));
+				VK_CHECK_RESULT(frame.results.map());
+			}
+
+			// Queries must be reset before they are used for the first time
+			VkCommandBuffer resetCmdBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			vkCmdResetQueryPool(resetCmdBuffer, queryPool, 0, getPassCount());
+			vulkanDevice->flushCommandBuffer(resetCmdBuffer, queue, true);
+		}
+
+		~VulkanPipelineStatistics()
+		{
+			for (auto& frame : frames)
+			{
+				frame.results.destroy();
+			}
+			vkDestroyCommandPool(vulkanDevice->logicalDevice, commandPool, nullptr);
+			vkDestroyQueryPool(vulkanDevice->logicalDevice, queryPool, nullptr);
+		}
+
+		uint32_t getPassCount()
+		{
+			return static_cast<uint32_t>(passNames.size());
+		}
+
+		const std::string& getPassName(uint32_t pass)
+		{
+			return passNames[pass];
+		}
+
+		/** @brief Start counting a pass, must be recorded outside of a render pass */
+		void beginPass(VkCommandBuffer cmdBuffer, uint32_t pass)
+		{
+			vkCmdBeginQuery(cmdBuffer, queryPool, pass, 0);
+		}
+
+		/** @brief Stop counting a pass, must be recorded outside of a render pass */
+		void endPass(VkCommandBuffer cmdBuffer, uint32_t pass)
+		{
+			vkCmdEndQuery(cmdBuffer, queryPool, pass);
+		}
+
+		/**
+		* Record the copy of the results of a frame's passes
+		*
+		* @param frame Index of the frame in flight, the frame's previous submission must have finished
+		* @param passMask Bit mask of the passes that have been counted in this frame
+		*
+		* @return Command buffer to submit after the frame's passes, both copies the results and resets the queries for the next frame
+		*/
+		VkCommandBuffer getCopyCmdBuffer(uint32_t frame, uint32_t passMask)
+		{
+			Frame &f = frames[frame];
+			f.passMask = passMask;
+
+			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(f.copyCmdBuffer, &cmdBufInfo));
+			for (uint32_t pass = 0; pass < getPassCount(); pass++)
+			{
+				if (passMask & (1 << pass))
+				{
+					vkCmdCopyQueryPoolResults(f.copyCmdBuffer, queryPool, pass, 1, f.results.buffer, pass * sizeof(Statistics), sizeof(Statistics), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+					vkCmdResetQueryPool(f.copyCmdBuffer, queryPool, pass, 1);
+				}
+			}
+			// Make the copied results visible to the host once the frame's fence has been signaled
+			VkMemoryBarrier memoryBarrier = vkTools::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(f.copyCmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			VK_CHECK_RESULT(vkEndCommandBuffer(f.copyCmdBuffer));
+			return f.copyCmdBuffer;
+		}
+
+		/**
+		* Read the results copied by the last submission of a frame in flight
+		*
+		* @note Must only be called after the frame's fence has been signaled
+		*/
+		void collect(uint32_t frame)
+		{
+			Frame &f = frames[frame];
+			const Statistics *results = static_cast<const Statistics*>(f.results.mapped);
+			for (uint32_t pass = 0; pass < getPassCount(); pass++)
+			{
+				if (f.passMask & (1 << pass))
+				{
+					latest[pass] = results[pass];
+					totals[pass].inputAssemblyPrimitives += results[pass].inputAssemblyPrimitives;
+					totals[pass].vertexShaderInvocations += results[pass].vertexShaderInvocations;
+					totals[pass].clippingPrimitives += results[pass].clippingPrimitives;
+					totals[pass].fragmentShaderInvocations += results[pass].fragmentShaderInvocations;
+					collectedFrames[pass]++;
+				}
+			}
+			f.passMask = 0;
+		}
+
+		/** @brief Results of the last collected frame in which the pass was counted */
+		const Statistics& getLatest(uint32_t pass)
+		{
+			return latest[pass];
+		}
+
+		/** @brief Average results per frame of all collected frames in which the pass was counted */
+		Statistics getAverage(uint32_t pass)
+		{
+			Statistics average;
+			const uint64_t count = collectedFrames[pass];
+			if (count > 0)
+			{
+				average.inputAssemblyPrimitives = totals[pass].inputAssemblyPrimitives / count;
+				average.vertexShaderInvocations = totals[pass].vertexShaderInvocations / count;
+				average.clippingPrimitives = totals[pass].clippingPrimitives / count;
+				average.fragmentShaderInvocations = totals[pass].fragmentShaderInvocations / count;
+			}
+			return average;
+		}
+
+		/** @brief Number of collected frames in which the pass was counted */
+		uint64_t getCollectedFrames(uint32_t pass)
+		{
+			return collectedFrames[pass];
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+/*
+* Vulkan sampler cache
+*
+* Samplers are shared by all textures that use the same filtering, addressing, LOD range and anisotropy
+* so only a handful of sampler objects exist, well below maxSamplerAllocationCount
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "vulkantools.h"
+
+namespace vk
+{
+	/**
+	* @brief Quality tiers for anisotropic filtering, higher tiers cost more texture bandwidth
+	*/
+	enum AnisotropyTier
+	{
+		/** @brief Trilinear filtering only */
+		ANISOTROPY_TIER_OFF = 0,
+		/** @brief 2x anisotropic filtering */
+		ANISOTROPY_TIER_LOW = 1,
+		/** @brief 4x anisotropic filtering */
+		ANISOTROPY_TIER_MEDIUM = 2,
+		/** @brief 8x anisotropic filtering */
+		ANISOTROPY_TIER_HIGH = 3,
+		/** @brief 16x anisotropic filtering */
+		ANISOTROPY_TIER_ULTRA = 4
+	};
+
+	/**
+	* @brief Hands out shared samplers, the samplers are owned by the cache and destroyed with it
+	*/
+	class SamplerCache
+	{
+	private:
+		struct Key
+		{
+			VkFilter filter;
+			VkSamplerAddressMode addressMode;
+			float minLod;
+			float maxLod;
+			float anisotropy;
+
+			bool operator<(const Key &other) const
+			{
+				if (filter != other.filter) return filter < other.filter;
+				if (addressMode != other.addressMode) return addressMode < other.addressMode;
+				if (minLod != other.minLod) return minLod < other.minLod;
+				if (maxLod != other.maxLod) return maxLod < other.maxLod;
+				return anisotropy < other.anisotropy;
+			}
+		};
+
+		VkDevice device;
+		VkPhysicalDeviceLimits limits;
+		bool anisotropySupported;
+		AnisotropyTier anisotropyTier = ANISOTROPY_TIER_HIGH;
+		std::map<Key, VkSampler> samplers;
+		std::mutex mutex;
+
+		// Anisotropy level of the current tier, 1 means anisotropic filtering is disabled
+		float getMaxAnisotropy()
+		{
+			if (!anisotropySupported)
+			{
+				return 1.0f;
+			}
+			return std::min(static_cast<float>(1 << anisotropyTier), limits.maxSamplerAnisotropy);
+		}
+
+	public:
+		/**
+		* @param device Logical device the samplers are created on
+		* @param limits Limits of the physical device
+		* @param anisotropySupported True if the samplerAnisotropy feature has been enabled
+		*/
+		SamplerCache(VkDevice device, const VkPhysicalDeviceLimits &limits, bool anisotropySupported)
+		{
+			this->device = device;
+			this->limits = limits;
+			this->anisotropySupported = anisotropySupported;
+		}
+
+		~SamplerCache()
+		{
+			for (auto& sampler : samplers)
+			{
+				vkDestroySampler(device, sampler.second, nullptr);
+			}
+		}
+
+		/**
+		* Set the anisotropic filtering quality
+		*
+		* @note Only affects samplers requested afterwards, descriptors already using a sampler keep it
+		*/
+		void setAnisotropyTier(AnisotropyTier tier)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			anisotropyTier = tier;
+		}
+
+		AnisotropyTier getAnisotropyTier()
+		{
+			return anisotropyTier;
+		}
+
+		/**
+		* Get a sampler, it's created on first use
+		*
+		* @param filter Minification and magnification filter, also selects the mipmap mode
+		* @param addressMode Address mode for all coordinates
+		* @param (Optional) maxLod Highest LOD that may be sampled (defaults to no clamping, the image view limits the mip range)
+		* @param (Optional) anisotropic Use the anisotropic filtering level of the current tier (defaults to true, ignored for nearest filtering)
+		* @param (Optional) minLod Lowest LOD that may be sampled (defaults to 0)
+		*
+		* @return Shared sampler owned by the cache, must not be destroyed by the caller
+		*/
+		VkSampler get(VkFilter filter, VkSamplerAddressMode addressMode, float maxLod = VK_LOD_CLAMP_NONE, bool anisotropic = true, float minLod = 0.0f)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Key key;
+			key.filter = filter;
+			key.addressMode = addressMode;
+			key.minLod = minLod;
+			key.maxLod = maxLod;
+			key.anisotropy = (anisotropic && (filter == VK_FILTER_LINEAR)) ? getMaxAnisotropy() : 1.0f;
+
+			auto it = samplers.find(key);
+			if (it != samplers.end())
+			{
+				return it->second;
+			}
+
+			assert(samplers.size() < limits.maxSamplerAllocationCount);
+
+			VkSamplerCreateInfo samplerInfo = vkTools::initializers::samplerCreateInfo();
+			samplerInfo.magFilter = filter;
+			samplerInfo.minFilter = filter;
+			samplerInfo.mipmapMode = (filter == VK_FILTER_LINEAR) ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			samplerInfo.addressModeU = addressMode;
+			samplerInfo.addressModeV = addressMode;
+			samplerInfo.addressModeW = addressMode;
+			samplerInfo.mipLodBias = 0.0f;
+			samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+			samplerInfo.minLod = minLod;
+			samplerInfo.maxLod = maxLod;
+			samplerInfo.anisotropyEnable = (key.anisotropy > 1.0f) ? VK_TRUE : VK_FALSE;
+			samplerInfo.maxAnisotropy = key.anisotropy;
+			samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+			VkSampler sampler;
+			VK_CHECK_RESULT(vkCreateSampler(device, &samplerInfo, nullptr, &sampler));
+			samplers[key] = sampler;
+			return sampler;
+		}
+
+		/** @brief Number of sampler objects created by the cache */
+		size_t getCount()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return samplers.size();
+		}
+	};
+}
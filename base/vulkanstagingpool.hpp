@@ -0,0 +1,135 @@
+/*
+* Vulkan staging buffer pool
+*
+* Host visible staging buffers are shared by all uploads and recycled once the copies reading them have finished,
+* so loading and streaming don't create and destroy a buffer (and its memory) for every upload
+* The buffers are sub-allocated from host visible blocks and stay mapped for their whole lifetime
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "vulkantools.h"
+#include "vulkanbuffer.hpp"
+
+namespace vk
+{
+	class StagingPool
+	{
+	public:
+		struct Stats
+		{
+			/** @brief Staging buffers acquired by uploads */
+			uint32_t acquireCount = 0;
+			/** @brief Acquisitions that had to create a new buffer */
+			uint32_t createCount = 0;
+			/** @brief Buffers destroyed because they exceeded the retained size */
+			uint32_t destroyCount = 0;
+			/** @brief Buffers currently handed out */
+			uint32_t activeCount = 0;
+			/** @brief Size of the idle buffers kept for reuse */
+			VkDeviceSize retainedSize = 0;
+		};
+
+	private:
+		// Creates a mapped host visible transfer source buffer of at least the given size
+		std::function<void(VkDeviceSize, vk::Buffer*)> createBuffer;
+		VkDeviceSize minBufferSize;
+		VkDeviceSize maxRetainedSize;
+		// Idle buffers ordered by size
+		std::vector<vk::Buffer> freeBuffers;
+		Stats stats;
+		// Uploads may run on worker threads
+		std::mutex mutex;
+
+	public:
+		/**
+		* @param createBuffer Function creating a mapped host visible buffer usable as a transfer source
+		* @param minBufferSize Smallest buffer created, small uploads are rounded up so their buffers can be reused by others
+		* @param maxRetainedSize Total size of the idle buffers kept for reuse, released buffers beyond it are destroyed
+		*/
+		StagingPool(std::function<void(VkDeviceSize, vk::Buffer*)> createBuffer, VkDeviceSize minBufferSize = 256 * 1024, VkDeviceSize maxRetainedSize = 64 * 1024 * 1024)
+			: createBuffer(createBuffer), minBufferSize(minBufferSize), maxRetainedSize(maxRetainedSize) {}
+
+		/** @brief Destroy the idle buffers, all acquired buffers must have been released */
+		~StagingPool()
+		{
+			assert(stats.activeCount == 0);
+			for (auto &buffer : freeBuffers)
+			{
+				buffer.destroy();
+			}
+		}
+
+		/**
+		* Get a mapped staging buffer with room for at least size bytes
+		* The smallest idle buffer that fits is reused, otherwise a new buffer is created
+		*
+		* @note The buffer's size may be larger than requested, copies must use the requested size
+		*/
+		vk::Buffer acquire(VkDeviceSize size)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stats.acquireCount++;
+			stats.activeCount++;
+			auto it = std::lower_bound(freeBuffers.begin(), freeBuffers.end(), size, [](const vk::Buffer &buffer, VkDeviceSize size) { return buffer.size < size; });
+			if (it != freeBuffers.end())
+			{
+				vk::Buffer buffer = *it;
+				freeBuffers.erase(it);
+				stats.retainedSize -= buffer.size;
+				return buffer;
+			}
+			stats.createCount++;
+			lock.unlock();
+			// Round up to a power of two so buffers of similar uploads can be exchanged
+			VkDeviceSize bufferSize = minBufferSize;
+			while (bufferSize < size)
+			{
+				bufferSize *= 2;
+			}
+			vk::Buffer buffer;
+			createBuffer(bufferSize, &buffer);
+			assert(buffer.mapped);
+			return buffer;
+		}
+
+		/**
+		* Return a buffer for reuse
+		*
+		* @note The device must have finished all copies reading the buffer, use VulkanDevice::retireStagingBuffer otherwise
+		*/
+		void release(vk::Buffer buffer)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			assert(stats.activeCount > 0);
+			stats.activeCount--;
+			if (stats.retainedSize + buffer.size > maxRetainedSize)
+			{
+				stats.destroyCount++;
+				lock.unlock();
+				buffer.destroy();
+				return;
+			}
+			auto it = std::lower_bound(freeBuffers.begin(), freeBuffers.end(), buffer.size, [](const vk::Buffer &buffer, VkDeviceSize size) { return buffer.size < size; });
+			freeBuffers.insert(it, buffer);
+			stats.retainedSize += buffer.size;
+		}
+
+		Stats getStats()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return stats;
+		}
+	};
+}
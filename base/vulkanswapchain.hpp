@@ -12,10 +12,13 @@
 
 #include <stdlib.h>
 #include <string>
+#include <iostream>
 #include <fstream>
 #include <assert.h>
 #include <stdio.h>
 #include <vector>
+#include <algorithm>
+#include <functional>
 #ifdef _WIN32
 #include <windows.h>
 #include <fcntl.h>
@@ -25,6 +28,7 @@
 
 #include <vulkan/vulkan.h>
 #include "vulkantools.h"
+#include "vulkandevice.hpp"
 
 #ifdef __ANDROID__
 #include "vulkanandroid.h"
@@ -57,11 +61,52 @@ typedef struct _SwapChainBuffers {
 
 class VulkanSwapChain
 {
+public:
+	/**
+	* Called with the pixels of a presented image once its readback has finished
+	*
+	* @param frameIndex Number of the presented frame, starting at 1
+	* @param data Tightly packed pixels in colorFormat
+	* @param width Width of the image
+	* @param height Height of the image
+	*/
+	typedef std::function<void(uint64_t frameIndex, const void *data, uint32_t width, uint32_t height)> ReadbackCallback;
+
+	// Swap chain replaced by create, along with the views of its images
+	struct RetiredSwapChain
+	{
+		VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+		std::vector<VkImageView> views;
+	};
 private: 
 	VkInstance instance;
 	VkDevice device;
 	VkPhysicalDevice physicalDevice;
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	// Headless mode renders to offscreen images instead of presenting them, used for benchmarks without a window
+	bool headless = false;
+	vk::VulkanDevice *headlessDevice = nullptr;
+	VkQueue headlessQueue = VK_NULL_HANDLE;
+	std::vector<VkDeviceMemory> headlessMemory;
+	uint32_t headlessImageIndex = 0;
+	uint32_t headlessWidth = 0;
+	uint32_t headlessHeight = 0;
+	uint64_t headlessFrameIndex = 0;
+	// Optional copies of the presented images into host visible buffers
+	struct HeadlessReadback
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void *mapped = nullptr;
+		VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		bool pending = false;
+		uint64_t frameIndex = 0;
+	};
+	std::vector<HeadlessReadback> headlessReadbacks;
+	VkCommandPool headlessCommandPool = VK_NULL_HANDLE;
+	uint32_t readbackInterval = 0;
+	ReadbackCallback readbackCallback;
 	// Function pointers
 	PFN_vkGetPhysicalDeviceSurfaceSupportKHR fpGetPhysicalDeviceSurfaceSupportKHR;
 	PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR fpGetPhysicalDeviceSurfaceCapabilitiesKHR; 
@@ -79,10 +124,21 @@ public:
 	VkSwapchainKHR swapChain = VK_NULL_HANDLE;	
 	uint32_t imageCount;
 	std::vector<VkImage> images;
+	/** @brief Usage the images have been created with, images can only be copied from if it contains VK_IMAGE_USAGE_TRANSFER_SRC_BIT */
+	VkImageUsageFlags imageUsage = 0;
+	/** @brief Transform the presentation engine applies to the images, anything but the identity has to be applied by the renderer instead */
+	VkSurfaceTransformFlagBitsKHR preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
 	std::vector<SwapChainBuffer> buffers;
 	// Index of the deteced graphics and presenting device queue
 	/** @brief Queue family index of the detected graphics and presenting device queue */
 	uint32_t queueNodeIndex = UINT32_MAX;
+#if defined(_DIRECT2DISPLAY)
+	/** @brief Display to present to and the refresh rate in Hz its mode should be closest to, 0 selects the highest, set before initSurface */
+	uint32_t requestedDisplay = 0;
+	uint32_t requestedRefreshRate = 0;
+	/** @brief Refresh rate of the selected display mode in Hz */
+	float displayRefreshRate = 0.0f;
+#endif
 
 	// Creates an os specific surface
 	/**
@@ -98,7 +154,10 @@ public:
 	* @pre Linux (XCB)
 	* @param connection xcb connection to the X Server
 	* @param window The xcb window to create the surface for
-	* @note Targets other than XCB ar not yet supported
+	*
+	* @pre Linux (Wayland)
+	* @param display Connection to the Wayland compositor
+	* @param window The Wayland surface to create the Vulkan surface for
 	*/
 	void initSurface(
 #ifdef _WIN32
@@ -109,6 +168,8 @@ public:
 #else
 #ifdef _DIRECT2DISPLAY
 	uint32_t width, uint32_t height
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+	wl_display* display, wl_surface* window
 #else
 	xcb_connection_t* connection, xcb_window_t window
 #endif
@@ -134,6 +195,12 @@ public:
 #else
 #if defined(_DIRECT2DISPLAY)
 		createDirect2DisplaySurface(width, height);
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+		VkWaylandSurfaceCreateInfoKHR surfaceCreateInfo = {};
+		surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR;
+		surfaceCreateInfo.display = display;
+		surfaceCreateInfo.surface = window;
+		err = vkCreateWaylandSurfaceKHR(instance, &surfaceCreateInfo, nullptr, &surface);
 #else
 		VkXcbSurfaceCreateInfoKHR surfaceCreateInfo = {};
 		surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
@@ -245,11 +312,74 @@ public:
 	* @param device Logical representation of the device to create the swapchain for
 	*
 	*/
+	/**
+	* Use offscreen images instead of a surface, nothing is presented
+	*
+	* @param vulkanDevice Device the offscreen images are allocated from, its graphics queue family is used
+	* @param queue Graphics queue the image acquisition and presentation semaphores are signaled and waited on
+	*
+	* @note Must be called instead of initSurface
+	*/
+	void initHeadless(vk::VulkanDevice *vulkanDevice, VkQueue queue)
+	{
+		headless = true;
+		headlessDevice = vulkanDevice;
+		headlessQueue = queue;
+		queueNodeIndex = vulkanDevice->queueFamilyIndices.graphics;
+		colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+		colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+	}
+
+	/**
+	* Copy every n-th presented image to host memory in headless mode
+	*
+	* The copy is recorded into the present submission and the callback is invoked once it has finished,
+	* at the latest when the image is acquired again, so reading back does not stall the frame that is presented
+	*
+	* @param interval Number of presented frames between two readbacks, 0 disables readback
+	* @param callback Function that receives the pixels
+	*
+	* @note Must be called before create
+	*/
+	void enableReadback(uint32_t interval, ReadbackCallback callback)
+	{
+		assert(headless);
+		readbackInterval = interval;
+		readbackCallback = callback;
+	}
+
+	/** @brief True if the images are rotated by 90 or 270 degrees, so their width and height are swapped compared to the window */
+	bool swapsExtent()
+	{
+		return (preTransform & (VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR | VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR)) != 0;
+	}
+
+	/** @brief Returns the layout the images are left in by the final render pass */
+	VkImageLayout getPresentLayout()
+	{
+		// Offscreen images stay ready to be copied from
+		return headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	}
+
+	/** @brief Wait for all outstanding readbacks and pass them to the callback */
+	void flushReadbacks()
+	{
+		for (uint32_t i = 0; i < headlessReadbacks.size(); i++)
+		{
+			finishReadback(i, true);
+		}
+	}
+
 	void connect(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device)
 	{
 		this->instance = instance;
 		this->physicalDevice = physicalDevice;
 		this->device = device;
+		if (headless)
+		{
+			// No surface or swap chain functions are required, the device may not even support presenting
+			return;
+		}
 		GET_INSTANCE_PROC_ADDR(instance, GetPhysicalDeviceSurfaceSupportKHR);
 		GET_INSTANCE_PROC_ADDR(instance, GetPhysicalDeviceSurfaceCapabilitiesKHR);
 		GET_INSTANCE_PROC_ADDR(instance, GetPhysicalDeviceSurfaceFormatsKHR);
@@ -267,9 +397,17 @@ public:
 	* @param width Pointer to the width of the swapchain (may be adjusted to fit the requirements of the swapchain)
 	* @param height Pointer to the height of the swapchain (may be adjusted to fit the requirements of the swapchain)
 	* @param vsync (Optional) Can be used to force vsync'd rendering (by using VK_PRESENT_MODE_FIFO_KHR as presentation mode)
+	* @param desiredImageCount (Optional) Number of swapchain images, clamped to the limits of the surface (defaults to the surface's minimum + 1)
+	* @param retired (Optional) Receives an existing swap chain and its image views instead of destroying them, they have to be destroyed with destroyRetired once no frame in flight uses them
 	*/
-	void create(uint32_t *width, uint32_t *height, bool vsync = false)
+	void create(uint32_t *width, uint32_t *height, bool vsync = false, uint32_t desiredImageCount = 0, RetiredSwapChain *retired = nullptr)
 	{
+		if (headless)
+		{
+			createHeadless(*width, *height);
+			return;
+		}
+
 		VkResult err;
 		VkSwapchainKHR oldSwapchain = swapChain;
 
@@ -332,22 +470,36 @@ public:
 		}
 
 		// Determine the number of images
-		uint32_t desiredNumberOfSwapchainImages = surfCaps.minImageCount + 1;
+		// Fewer images reduce the number of frames queued for presentation and with it the latency
+		uint32_t desiredNumberOfSwapchainImages = (desiredImageCount > 0) ? std::max(desiredImageCount, surfCaps.minImageCount) : surfCaps.minImageCount + 1;
 		if ((surfCaps.maxImageCount > 0) && (desiredNumberOfSwapchainImages > surfCaps.maxImageCount))
 		{
 			desiredNumberOfSwapchainImages = surfCaps.maxImageCount;
 		}
 
 		// Find the transformation of the surface
-		VkSurfaceTransformFlagsKHR preTransform;
-		if (surfCaps.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
+#if defined(__ANDROID__)
+		// Rotated devices would otherwise have the compositor rotate every presented image in an extra pass
+		// The images are rendered in the display's native orientation instead, see swapsExtent
+		const bool preRotate = (surfCaps.currentTransform & (VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR | VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR | VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR)) != 0;
+#else
+		const bool preRotate = false;
+#endif
+		if (preRotate || !(surfCaps.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR))
+		{
+			preTransform = surfCaps.currentTransform;
+		}
+		else
 		{
 			// We prefer a non-rotated transform
 			preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
 		}
-		else 
+		// The current extent is the rotated one, the images have the size of the display's native orientation
+		if (swapsExtent() && (surfCaps.currentExtent.width != (uint32_t)-1))
 		{
-			preTransform = surfCaps.currentTransform;
+			std::swap(swapchainExtent.width, swapchainExtent.height);
+			*width = swapchainExtent.width;
+			*height = swapchainExtent.height;
 		}
 
 		VkSwapchainCreateInfoKHR swapchainCI = {};
@@ -359,7 +511,13 @@ public:
 		swapchainCI.imageColorSpace = colorSpace;
 		swapchainCI.imageExtent = { swapchainExtent.width, swapchainExtent.height };
 		swapchainCI.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-		swapchainCI.preTransform = (VkSurfaceTransformFlagBitsKHR)preTransform;
+		// Allows capturing the presented images if the surface supports it
+		if (surfCaps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+		{
+			swapchainCI.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
+		imageUsage = swapchainCI.imageUsage;
+		swapchainCI.preTransform = preTransform;
 		swapchainCI.imageArrayLayers = 1;
 		swapchainCI.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		swapchainCI.queueFamilyIndexCount = 0;
@@ -377,11 +535,20 @@ public:
 		// This also cleans up all the presentable images
 		if (oldSwapchain != VK_NULL_HANDLE) 
 		{ 
+			RetiredSwapChain old;
+			old.swapChain = oldSwapchain;
 			for (uint32_t i = 0; i < imageCount; i++)
 			{
-				vkDestroyImageView(device, buffers[i].view, nullptr);
+				old.views.push_back(buffers[i].view);
+			}
+			if (retired)
+			{
+				*retired = old;
+			}
+			else
+			{
+				destroyRetired(old);
 			}
-			fpDestroySwapchainKHR(device, oldSwapchain, nullptr);
 		}
 
 		err = fpGetSwapchainImagesKHR(device, swapChain, &imageCount, NULL);
@@ -392,7 +559,24 @@ public:
 		err = fpGetSwapchainImagesKHR(device, swapChain, &imageCount, images.data());
 		assert(!err);
 
-		// Get the swap chain buffers containing the image and imageview
+		createImageViews();
+	}
+
+	/**
+	* Destroy a swap chain replaced by create
+	*/
+	void destroyRetired(const RetiredSwapChain &retired)
+	{
+		for (auto view : retired.views)
+		{
+			vkDestroyImageView(device, view, nullptr);
+		}
+		fpDestroySwapchainKHR(device, retired.swapChain, nullptr);
+	}
+
+	// Get the swap chain buffers containing the image and imageview
+	void createImageViews()
+	{
 		buffers.resize(imageCount);
 		for (uint32_t i = 0; i < imageCount; i++)
 		{
@@ -418,11 +602,170 @@ public:
 
 			colorAttachmentView.image = buffers[i].image;
 
-			err = vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view);
+			VkResult err = vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view);
 			assert(!err);
 		}
 	}
 
+	// Pass a finished readback to the callback, returns false if the copy is still in flight and wait is not set
+	bool finishReadback(uint32_t index, bool wait)
+	{
+		HeadlessReadback &readback = headlessReadbacks[index];
+		if (!readback.pending)
+		{
+			return true;
+		}
+		if (wait)
+		{
+			VK_CHECK_RESULT(vkWaitForFences(device, 1, &readback.fence, VK_TRUE, UINT64_MAX));
+		}
+		else if (vkGetFenceStatus(device, readback.fence) != VK_SUCCESS)
+		{
+			return false;
+		}
+		VK_CHECK_RESULT(vkResetFences(device, 1, &readback.fence));
+		readback.pending = false;
+		if (readbackCallback)
+		{
+			readbackCallback(readback.frameIndex, readback.mapped, headlessWidth, headlessHeight);
+		}
+		return true;
+	}
+
+	void destroyHeadlessReadbacks()
+	{
+		flushReadbacks();
+		for (auto& readback : headlessReadbacks)
+		{
+			vkDestroyFence(device, readback.fence, nullptr);
+			vkFreeCommandBuffers(device, headlessCommandPool, 1, &readback.cmdBuffer);
+			vkDestroyBuffer(device, readback.buffer, nullptr);
+			vkFreeMemory(device, readback.memory, nullptr);
+		}
+		headlessReadbacks.clear();
+		if (headlessCommandPool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(device, headlessCommandPool, nullptr);
+			headlessCommandPool = VK_NULL_HANDLE;
+		}
+	}
+
+	// Create a host visible buffer per image and pre-record the commands that copy the image into it
+	void createHeadlessReadbacks()
+	{
+		VkCommandPoolCreateInfo cmdPoolInfo = vkTools::initializers::commandPoolCreateInfo();
+		cmdPoolInfo.queueFamilyIndex = queueNodeIndex;
+		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &headlessCommandPool));
+
+		const VkDeviceSize bufferSize = (VkDeviceSize)headlessWidth * headlessHeight * 4;
+		headlessReadbacks.resize(imageCount);
+		for (uint32_t i = 0; i < imageCount; i++)
+		{
+			HeadlessReadback &readback = headlessReadbacks[i];
+
+			VkBufferCreateInfo bufferCreateInfo = vkTools::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_DST_BIT, bufferSize);
+			VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &readback.buffer));
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(device, readback.buffer, &memReqs);
+			VkMemoryAllocateInfo memAlloc = vkTools::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = headlessDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &readback.memory));
+			VK_CHECK_RESULT(vkBindBufferMemory(device, readback.buffer, readback.memory, 0));
+			VK_CHECK_RESULT(vkMapMemory(device, readback.memory, 0, VK_WHOLE_SIZE, 0, &readback.mapped));
+
+			VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo(0);
+			VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &readback.fence));
+
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vkTools::initializers::commandBufferAllocateInfo(headlessCommandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &readback.cmdBuffer));
+			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(readback.cmdBuffer, &cmdBufInfo));
+
+			// The final render pass already left the image in transfer source layout, only the writes need to be made visible
+			VkImageMemoryBarrier imageBarrier = vkTools::initializers::imageMemoryBarrier();
+			imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			imageBarrier.image = images[i];
+			imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			vkCmdPipelineBarrier(readback.cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+			VkBufferImageCopy copyRegion = {};
+			copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copyRegion.imageExtent = { headlessWidth, headlessHeight, 1 };
+			vkCmdCopyImageToBuffer(readback.cmdBuffer, images[i], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &copyRegion);
+
+			VkBufferMemoryBarrier bufferBarrier = vkTools::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.buffer = readback.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(readback.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(readback.cmdBuffer));
+		}
+	}
+
+	// Destroy the offscreen images used in headless mode
+	void destroyHeadlessImages()
+	{
+		destroyHeadlessReadbacks();
+		for (uint32_t i = 0; i < images.size(); i++)
+		{
+			vkDestroyImageView(device, buffers[i].view, nullptr);
+			vkDestroyImage(device, images[i], nullptr);
+			vkFreeMemory(device, headlessMemory[i], nullptr);
+		}
+		images.clear();
+		buffers.clear();
+		headlessMemory.clear();
+	}
+
+	// Create offscreen images in place of the swap chain images
+	void createHeadless(uint32_t width, uint32_t height)
+	{
+		destroyHeadlessImages();
+		headlessWidth = width;
+		headlessHeight = height;
+
+		// Same number of images as a typical swap chain, so frames in flight behave the same as with a window
+		imageCount = 3;
+		images.resize(imageCount);
+		imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		headlessMemory.resize(imageCount);
+		for (uint32_t i = 0; i < imageCount; i++)
+		{
+			VkImageCreateInfo imageCreateInfo = vkTools::initializers::imageCreateInfo();
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = colorFormat;
+			imageCreateInfo.extent = { width, height, 1 };
+			imageCreateInfo.mipLevels = 1;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.usage = imageUsage;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &images[i]));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, images[i], &memReqs);
+			VkMemoryAllocateInfo memAlloc = vkTools::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = headlessDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &headlessMemory[i]));
+			VK_CHECK_RESULT(vkBindImageMemory(device, images[i], headlessMemory[i], 0));
+		}
+
+		createImageViews();
+
+		if (readbackInterval > 0)
+		{
+			createHeadlessReadbacks();
+		}
+	}
+
 	/** 
 	* Acquires the next image in the swap chain
 	*
@@ -435,6 +778,21 @@ public:
 	*/
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t *imageIndex)
 	{
+		if (headless)
+		{
+			// Images are used round robin, the semaphore is signaled right away as nothing is presented
+			*imageIndex = headlessImageIndex;
+			headlessImageIndex = (headlessImageIndex + 1) % imageCount;
+			// Hand finished readbacks to the callback without blocking, only the buffer of the acquired image has to be free
+			for (uint32_t i = 0; i < headlessReadbacks.size(); i++)
+			{
+				finishReadback(i, i == *imageIndex);
+			}
+			VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
+			submitInfo.signalSemaphoreCount = (presentCompleteSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+			submitInfo.pSignalSemaphores = &presentCompleteSemaphore;
+			return vkQueueSubmit(headlessQueue, 1, &submitInfo, VK_NULL_HANDLE);
+		}
 		// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 		// With that we don't have to handle VK_NOT_READY
 		return fpAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, imageIndex);
@@ -451,6 +809,33 @@ public:
 	*/
 	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE)
 	{
+		if (headless)
+		{
+			// Nothing is presented, but the semaphore still has to be waited on so it can be signaled again
+			headlessFrameIndex++;
+			const bool readback = !headlessReadbacks.empty() && (headlessFrameIndex % readbackInterval == 0);
+			if ((waitSemaphore == VK_NULL_HANDLE) && !readback)
+			{
+				return VK_SUCCESS;
+			}
+			VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			VkSubmitInfo submitInfo = vkTools::initializers::submitInfo();
+			submitInfo.waitSemaphoreCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStageMask;
+			VkFence fence = VK_NULL_HANDLE;
+			if (readback)
+			{
+				HeadlessReadback &imageReadback = headlessReadbacks[imageIndex];
+				assert(!imageReadback.pending);
+				imageReadback.pending = true;
+				imageReadback.frameIndex = headlessFrameIndex;
+				submitInfo.commandBufferCount = 1;
+				submitInfo.pCommandBuffers = &imageReadback.cmdBuffer;
+				fence = imageReadback.fence;
+			}
+			return vkQueueSubmit(queue, 1, &submitInfo, fence);
+		}
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.pNext = NULL;
@@ -472,6 +857,11 @@ public:
 	*/
 	void cleanup()
 	{
+		if (headless)
+		{
+			destroyHeadlessImages();
+			return;
+		}
 		if (swapChain != VK_NULL_HANDLE)
 		{
 			for (uint32_t i = 0; i < imageCount; i++)
@@ -491,87 +881,101 @@ public:
 #if defined(_DIRECT2DISPLAY)
 	/**
 	* Create direct to display surface
+	*
+	* Selects a mode of the requested display with the given size whose refresh rate is closest to requestedRefreshRate (the highest if it's 0),
+	* or the largest mode if there's none of that size, and an opaque plane of that display, so the images are scanned out as they are
 	*/	
 	void createDirect2DisplaySurface(uint32_t width, uint32_t height)
 	{
 		uint32_t displayPropertyCount;
-		
-		// Get display property
 		vkGetPhysicalDeviceDisplayPropertiesKHR(physicalDevice, &displayPropertyCount, NULL);
-		VkDisplayPropertiesKHR* pDisplayProperties = new VkDisplayPropertiesKHR[displayPropertyCount];
-		vkGetPhysicalDeviceDisplayPropertiesKHR(physicalDevice, &displayPropertyCount, pDisplayProperties);
+		std::vector<VkDisplayPropertiesKHR> displayProperties(displayPropertyCount);
+		vkGetPhysicalDeviceDisplayPropertiesKHR(physicalDevice, &displayPropertyCount, displayProperties.data());
+		if (displayPropertyCount == 0)
+		{
+			vkTools::exitFatal("Can't find a display!", "Fatal error");
+			return;
+		}
+		if (requestedDisplay >= displayPropertyCount)
+		{
+			std::cout << "Display " << requestedDisplay << " not found, using display 0" << std::endl;
+			requestedDisplay = 0;
+		}
+		VkDisplayKHR display = displayProperties[requestedDisplay].display;
 
-		// Get plane property
 		uint32_t planePropertyCount;
 		vkGetPhysicalDeviceDisplayPlanePropertiesKHR(physicalDevice, &planePropertyCount, NULL);
-		VkDisplayPlanePropertiesKHR* pPlaneProperties = new VkDisplayPlanePropertiesKHR[planePropertyCount];
-		vkGetPhysicalDeviceDisplayPlanePropertiesKHR(physicalDevice, &planePropertyCount, pPlaneProperties);
-
-		VkDisplayKHR display = VK_NULL_HANDLE;
-		VkDisplayModeKHR displayMode;
-		VkDisplayModePropertiesKHR* pModeProperties;
-		bool foundMode = false;
-
-	   	for(uint32_t i = 0; i < displayPropertyCount;++i)
-	   	{
-			display = pDisplayProperties[i].display;
-			uint32_t modeCount;
-			vkGetDisplayModePropertiesKHR(physicalDevice, display, &modeCount, NULL);
-			pModeProperties = new VkDisplayModePropertiesKHR[modeCount];
-			vkGetDisplayModePropertiesKHR(physicalDevice, display, &modeCount, pModeProperties);
-
-			for (uint32_t j = 0; j < modeCount; ++j)
-			{
-				const VkDisplayModePropertiesKHR* mode = &pModeProperties[j];
+		std::vector<VkDisplayPlanePropertiesKHR> planeProperties(planePropertyCount);
+		vkGetPhysicalDeviceDisplayPlanePropertiesKHR(physicalDevice, &planePropertyCount, planeProperties.data());
+
+		uint32_t modeCount;
+		vkGetDisplayModePropertiesKHR(physicalDevice, display, &modeCount, NULL);
+		std::vector<VkDisplayModePropertiesKHR> modeProperties(modeCount);
+		vkGetDisplayModePropertiesKHR(physicalDevice, display, &modeCount, modeProperties.data());
 
-				if (mode->parameters.visibleRegion.width == width && mode->parameters.visibleRegion.height == height)
+		// Refresh rates are in millihertz
+		const VkDisplayModePropertiesKHR *selectedMode = nullptr;
+		auto refreshDistance = [this](const VkDisplayModePropertiesKHR *mode) {
+			return (requestedRefreshRate > 0) ? std::abs((int64_t)mode->parameters.refreshRate - (int64_t)requestedRefreshRate * 1000) : -(int64_t)mode->parameters.refreshRate;
+		};
+		for (auto& mode : modeProperties)
+		{
+			if ((mode.parameters.visibleRegion.width == width) && (mode.parameters.visibleRegion.height == height) && (!selectedMode || (refreshDistance(&mode) < refreshDistance(selectedMode))))
+			{
+				selectedMode = &mode;
+			}
+		}
+		if (!selectedMode)
+		{
+			for (auto& mode : modeProperties)
+			{
+				const uint64_t area = (uint64_t)mode.parameters.visibleRegion.width * mode.parameters.visibleRegion.height;
+				const uint64_t selectedArea = selectedMode ? (uint64_t)selectedMode->parameters.visibleRegion.width * selectedMode->parameters.visibleRegion.height : 0;
+				if (!selectedMode || (area > selectedArea) || ((area == selectedArea) && (refreshDistance(&mode) < refreshDistance(selectedMode))))
 				{
-					displayMode = mode->displayMode;
-					foundMode = true;
-					break;
+					selectedMode = &mode;
 				}
 			}
-			if (foundMode)
+			if (!selectedMode)
 			{
-				break;
+				vkTools::exitFatal("Can't find a display mode!", "Fatal error");
+				return;
 			}
-			delete [] pModeProperties;
+			std::cout << "No " << width << "x" << height << " display mode, using " << selectedMode->parameters.visibleRegion.width << "x" << selectedMode->parameters.visibleRegion.height << std::endl;
+			width = selectedMode->parameters.visibleRegion.width;
+			height = selectedMode->parameters.visibleRegion.height;
 		}
+		VkDisplayModeKHR displayMode = selectedMode->displayMode;
+		displayRefreshRate = selectedMode->parameters.refreshRate / 1000.0f;
+		std::cout << "Display mode " << width << "x" << height << " at " << displayRefreshRate << " Hz" << std::endl;
 
-		if(!foundMode)
-		{
-			vkTools::exitFatal("Can't find a display and a display mode!", "Fatal error");
-			return;
-		}
-
-		// Search for a best plane we can use
+		// Search for a plane of the display, planes that show nothing yet and support opaque images are preferred
+		// An opaque plane is scanned out without being blended with the planes below it
 		uint32_t bestPlaneIndex = UINT32_MAX;
-		VkDisplayKHR* pDisplays = NULL;
-		for(uint32_t i = 0; i < planePropertyCount; i++)
+		bool bestPlaneOpaque = false;
+		VkDisplayPlaneCapabilitiesKHR planeCap = {};
+		for (uint32_t i = 0; i < planePropertyCount; i++)
 		{
-			uint32_t planeIndex=i;
-			uint32_t displayCount;
-			vkGetDisplayPlaneSupportedDisplaysKHR(physicalDevice, planeIndex, &displayCount, NULL);
-			if (pDisplays)
+			if ((planeProperties[i].currentDisplay != VK_NULL_HANDLE) && (planeProperties[i].currentDisplay != display))
 			{
-				delete [] pDisplays;
+				continue;
 			}
-			pDisplays = new VkDisplayKHR[displayCount];
-			vkGetDisplayPlaneSupportedDisplaysKHR(physicalDevice, planeIndex, &displayCount, pDisplays);
-
-			// Find a display that matches the current plane
-			bestPlaneIndex = UINT32_MAX;
-			for(uint32_t j = 0; j < displayCount; j++)
+			uint32_t displayCount;
+			vkGetDisplayPlaneSupportedDisplaysKHR(physicalDevice, i, &displayCount, NULL);
+			std::vector<VkDisplayKHR> displays(displayCount);
+			vkGetDisplayPlaneSupportedDisplaysKHR(physicalDevice, i, &displayCount, displays.data());
+			if (std::find(displays.begin(), displays.end(), display) == displays.end())
 			{
-				if(display == pDisplays[j])
-				{
-					bestPlaneIndex = i;
-					break;
-				}
+				continue;
 			}
-			if(bestPlaneIndex != UINT32_MAX)
+			VkDisplayPlaneCapabilitiesKHR capabilities;
+			vkGetDisplayPlaneCapabilitiesKHR(physicalDevice, displayMode, i, &capabilities);
+			const bool opaque = (capabilities.supportedAlpha & VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR) != 0;
+			if ((bestPlaneIndex == UINT32_MAX) || (opaque && !bestPlaneOpaque))
 			{
-				break;
+				bestPlaneIndex = i;
+				bestPlaneOpaque = opaque;
+				planeCap = capabilities;
 			}
 		}
 
@@ -581,22 +985,23 @@ public:
 			return;
 		}
 
-		VkDisplayPlaneCapabilitiesKHR planeCap;
-		vkGetDisplayPlaneCapabilitiesKHR(physicalDevice, displayMode, bestPlaneIndex, &planeCap);
 		VkDisplayPlaneAlphaFlagBitsKHR alphaMode;
-
-		if (planeCap.supportedAlpha & VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR)
+		if (planeCap.supportedAlpha & VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR)
 		{
-			alphaMode = VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR;
+			alphaMode = VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR;
 		}
-		else if (planeCap.supportedAlpha & VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR)
+		else if (planeCap.supportedAlpha & VK_DISPLAY_PLANE_ALPHA_GLOBAL_BIT_KHR)
 		{
-
-			alphaMode = VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR;
+			// A global alpha of 1 doesn't show the planes below either
+			alphaMode = VK_DISPLAY_PLANE_ALPHA_GLOBAL_BIT_KHR;
+		}
+		else if (planeCap.supportedAlpha & VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR)
+		{
+			alphaMode = VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR;
 		}
 		else
 		{
-			alphaMode = VK_DISPLAY_PLANE_ALPHA_GLOBAL_BIT_KHR;
+			alphaMode = VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR;
 		}
 
 		VkDisplaySurfaceCreateInfoKHR surfaceInfo{};
@@ -605,7 +1010,7 @@ public:
 		surfaceInfo.flags = 0;
 		surfaceInfo.displayMode = displayMode;
 		surfaceInfo.planeIndex = bestPlaneIndex;
-		surfaceInfo.planeStackIndex = pPlaneProperties[bestPlaneIndex].currentStackIndex;
+		surfaceInfo.planeStackIndex = planeProperties[bestPlaneIndex].currentStackIndex;
 		surfaceInfo.transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
 		surfaceInfo.globalAlpha = 1.0;
 		surfaceInfo.alphaMode = alphaMode;
@@ -617,11 +1022,6 @@ public:
 		{
 			vkTools::exitFatal("Failed to create surface!", "Fatal error");
 		}
-
-		delete[] pDisplays;
-		delete[] pModeProperties;
-		delete[] pDisplayProperties;
-		delete[] pPlaneProperties;
 	}
 #endif 
 };
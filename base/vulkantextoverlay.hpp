@@ -12,9 +12,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <float.h>
 #include <vector>
 #include <sstream>
 #include <iomanip>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
 
 #include <vulkan/vulkan.h>
 #include "vulkantools.h"
@@ -32,9 +36,14 @@
 #define STB_FIRST_CHAR STB_FONT_consolas_24_latin1_FIRST_CHAR
 #define STB_NUM_CHARS STB_FONT_consolas_24_latin1_NUM_CHARS
 
-// Max. number of chars the text overlay buffer can hold
+// Number of chars the text overlay buffer initially holds, it grows for longer text
 #define MAX_CHAR_COUNT 1024
 
+// Texels of the signed distance field atlas per font pixel, power of two, its mip chain goes down to the font's resolution
+#define SDF_FONT_UPSCALE 4
+// Distance in texels of the atlas' first level that covers half the range of its values on either side of the edge
+#define SDF_FONT_SPREAD 8.0f
+
 /**
 * @brief Mostly self-contained text overlay class
 * @note Will only work with compatible render passes
@@ -47,14 +56,37 @@ private:
 	VkQueue queue;
 	VkFormat colorFormat;
 	VkFormat depthFormat;
+	VkImageLayout finalLayout;
 
 	uint32_t *frameBufferWidth;
 	uint32_t *frameBufferHeight;
+	// Rotation of the frame buffers' contents for pre-rotated swap chains, text is laid out in the unrotated window
+	glm::mat2 preRotation;
+
+	struct PushConstants
+	{
+		// Size of a font pixel in normalized device coordinates
+		glm::vec2 charScale;
+		glm::mat2 preRotation;
+	};
+
+	// Size of the window the text is laid out in
+	glm::vec2 getTextAreaSize()
+	{
+		const bool swapped = fabs(preRotation[0][0]) < 0.5f;
+		return swapped ? glm::vec2((float)*frameBufferHeight, (float)*frameBufferWidth) : glm::vec2((float)*frameBufferWidth, (float)*frameBufferHeight);
+	}
 
 	VkSampler sampler;
 	VkImage image;
 	VkImageView view;
-	vk::Buffer vertexBuffer;
+	// One range per command buffer, starting with the indirect draw followed by the glyph instances
+	// so text can be updated without waiting for other frames in flight
+	vk::Buffer glyphBuffer;
+	// Number of glyph instances a range can hold
+	uint32_t glyphCapacity = MAX_CHAR_COUNT;
+	// Position and texture coordinates of all glyphs of the font, read by the vertex shader
+	vk::Buffer glyphTable;
 	VkDeviceMemory imageMemory;
 	VkDescriptorPool descriptorPool;
 	VkDescriptorSetLayout descriptorSetLayout;
@@ -66,13 +98,242 @@ private:
 	VkCommandPool commandPool;
 	std::vector<VkFramebuffer*> frameBuffers;
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
-	VkFence fence;
 
-	// Used during text updates
-	glm::vec4 *mappedLocal = nullptr;
+	// One instance per glyph, the vertex shader expands it to a quad
+	struct GlyphInstance
+	{
+		// Pen position in normalized device coordinates
+		glm::vec2 position;
+		uint32_t glyph;
+		// Size relative to the font's
+		float scale;
+	};
+
+	// Glyphs of a string relative to its start, reused as long as the string is added in consecutive updates
+	struct TextLayout
+	{
+		std::vector<uint32_t> glyphs;
+		// Pen offsets in font pixels
+		std::vector<float> offsets;
+		float width;
+		uint32_t lastUpdate;
+	};
+	std::unordered_map<std::string, TextLayout> textLayouts;
+	uint32_t textUpdate = 0;
+
+	// Glyphs of the last update, copied to a command buffer's range before it is submitted again
+	std::vector<GlyphInstance> glyphs;
+	uint32_t textVersion = 0;
+	std::vector<uint32_t> rangeVersions;
 
 	stb_fontchar stbFontData[STB_NUM_CHARS];
-	uint32_t numLetters;
+
+	static uint32_t getAtlasLevelCount()
+	{
+		uint32_t levels = 1;
+		while ((1u << levels) <= SDF_FONT_UPSCALE)
+		{
+			levels++;
+		}
+		return levels;
+	}
+
+	// Squared euclidean distances to the closest feature along a row or column of squared distances, in place
+	// Lower envelope of parabolas (Felzenszwalb and Huttenlocher, Distance Transforms of Sampled Functions)
+	static void distanceTransform(float *f, uint32_t n, uint32_t stride, std::vector<float> &d, std::vector<uint32_t> &v, std::vector<float> &z)
+	{
+		auto intersection = [&](uint32_t q, uint32_t p) {
+			return ((f[q * stride] + float(q * q)) - (f[p * stride] + float(p * p))) / (2.0f * float(q) - 2.0f * float(p));
+		};
+		uint32_t k = 0;
+		v[0] = 0;
+		z[0] = -FLT_MAX;
+		z[1] = FLT_MAX;
+		for (uint32_t q = 1; q < n; q++)
+		{
+			float s = intersection(q, v[k]);
+			while (s <= z[k])
+			{
+				k--;
+				s = intersection(q, v[k]);
+			}
+			k++;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = FLT_MAX;
+		}
+		k = 0;
+		for (uint32_t q = 0; q < n; q++)
+		{
+			while (z[k + 1] < float(q))
+			{
+				k++;
+			}
+			const float offset = float(q) - float(v[k]);
+			d[q] = offset * offset + f[v[k] * stride];
+		}
+		for (uint32_t q = 0; q < n; q++)
+		{
+			f[q * stride] = d[q];
+		}
+	}
+
+	// Signed distance field of the font bitmap at SDF_FONT_UPSCALE times its resolution, followed by its mip levels
+	// Positive distances are inside the glyphs, the edge is at 0.5
+	static std::vector<uint8_t> generateDistanceFieldAtlas(const unsigned char *pixels)
+	{
+		const uint32_t width = STB_FONT_WIDTH * SDF_FONT_UPSCALE;
+		const uint32_t height = STB_FONT_HEIGHT * SDF_FONT_UPSCALE;
+		// Squared distances to the closest texel inside and outside of the glyphs, far away texels start at a large finite value
+		const float far = 1.0e20f;
+		std::vector<float> toInside(width * height);
+		std::vector<float> toOutside(width * height);
+		std::vector<uint8_t> inside(width * height);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				// The font's coverage is upsampled bilinearly, texels more than half covered are inside
+				const float sx = std::max((x + 0.5f) / SDF_FONT_UPSCALE - 0.5f, 0.0f);
+				const float sy = std::max((y + 0.5f) / SDF_FONT_UPSCALE - 0.5f, 0.0f);
+				const uint32_t x0 = std::min(static_cast<uint32_t>(sx), static_cast<uint32_t>(STB_FONT_WIDTH - 1));
+				const uint32_t y0 = std::min(static_cast<uint32_t>(sy), static_cast<uint32_t>(STB_FONT_HEIGHT - 1));
+				const uint32_t x1 = std::min(x0 + 1, static_cast<uint32_t>(STB_FONT_WIDTH - 1));
+				const uint32_t y1 = std::min(y0 + 1, static_cast<uint32_t>(STB_FONT_HEIGHT - 1));
+				const float fx = sx - float(x0);
+				const float fy = sy - float(y0);
+				const float top = pixels[y0 * STB_FONT_WIDTH + x0] * (1.0f - fx) + pixels[y0 * STB_FONT_WIDTH + x1] * fx;
+				const float bottom = pixels[y1 * STB_FONT_WIDTH + x0] * (1.0f - fx) + pixels[y1 * STB_FONT_WIDTH + x1] * fx;
+				const uint32_t index = y * width + x;
+				inside[index] = (top * (1.0f - fy) + bottom * fy) > 127.5f;
+				toInside[index] = inside[index] ? 0.0f : far;
+				toOutside[index] = inside[index] ? far : 0.0f;
+			}
+		}
+
+		// Separable, columns first
+		std::vector<float> d(std::max(width, height));
+		std::vector<uint32_t> v(std::max(width, height));
+		std::vector<float> z(std::max(width, height) + 1);
+		for (float *field : { toInside.data(), toOutside.data() })
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				distanceTransform(field + x, height, width, d, v, z);
+			}
+			for (uint32_t y = 0; y < height; y++)
+			{
+				distanceTransform(field + y * width, width, 1, d, v, z);
+			}
+		}
+
+		// Distances are measured between texel centers, the edge lies half a texel between an inside and an outside texel
+		std::vector<uint8_t> atlas(width * height);
+		for (uint32_t i = 0; i < width * height; i++)
+		{
+			const float distance = inside[i] ? std::sqrt(toOutside[i]) - 0.5f : 0.5f - std::sqrt(toInside[i]);
+			atlas[i] = static_cast<uint8_t>(std::min(std::max(0.5f + distance / (2.0f * SDF_FONT_SPREAD), 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+
+		// Distance fields can be box filtered
+		uint32_t levelOffset = 0;
+		uint32_t levelWidth = width;
+		uint32_t levelHeight = height;
+		for (uint32_t level = 1; level < getAtlasLevelCount(); level++)
+		{
+			const uint32_t nextOffset = levelOffset + levelWidth * levelHeight;
+			const uint32_t nextWidth = levelWidth / 2;
+			const uint32_t nextHeight = levelHeight / 2;
+			atlas.resize(nextOffset + nextWidth * nextHeight);
+			for (uint32_t y = 0; y < nextHeight; y++)
+			{
+				for (uint32_t x = 0; x < nextWidth; x++)
+				{
+					const uint8_t *source = &atlas[levelOffset + (y * 2) * levelWidth + x * 2];
+					atlas[nextOffset + y * nextWidth + x] = static_cast<uint8_t>((source[0] + source[1] + source[levelWidth] + source[levelWidth + 1] + 2) / 4);
+				}
+			}
+			levelOffset = nextOffset;
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+		}
+		return atlas;
+	}
+
+	// The atlas only depends on the font, so it's generated by the first overlay and shared with later ones
+	static const std::vector<uint8_t> &getDistanceFieldAtlas(const unsigned char *pixels)
+	{
+		static const std::vector<uint8_t> atlas = generateDistanceFieldAtlas(pixels);
+		return atlas;
+	}
+
+	VkDeviceSize getRangeSize()
+	{
+		return sizeof(VkDrawIndirectCommand) + glyphCapacity * sizeof(GlyphInstance);
+	}
+
+	void createGlyphBuffer()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&glyphBuffer,
+			getRangeSize() * cmdBuffers.size()));
+		// Map persistent
+		glyphBuffer.map();
+	}
+
+	// Copy the glyphs of the last update to a command buffer's range
+	void writeRange(uint32_t bufferindex)
+	{
+		uint8_t *range = static_cast<uint8_t*>(glyphBuffer.mapped) + getRangeSize() * bufferindex;
+
+		VkDrawIndirectCommand drawCommand = {};
+		drawCommand.vertexCount = 4;
+		drawCommand.instanceCount = static_cast<uint32_t>(glyphs.size());
+		memcpy(range, &drawCommand, sizeof(drawCommand));
+		memcpy(range + sizeof(drawCommand), glyphs.data(), glyphs.size() * sizeof(GlyphInstance));
+
+		rangeVersions[bufferindex] = textVersion;
+	}
+
+	// Replace the glyph buffer with one that holds the current text
+	// The old buffer and the command buffers referencing it may still be in use by frames in flight, so they are retired
+	void growGlyphBuffer()
+	{
+		while (glyphCapacity < glyphs.size())
+		{
+			glyphCapacity *= 2;
+		}
+		vulkanDevice->retireBuffer(glyphBuffer);
+		createGlyphBuffer();
+		std::vector<VkCommandBuffer> retired;
+		reallocateCommandBuffers(&retired);
+		vulkanDevice->retireCommandBuffers(commandPool, retired);
+		// No frame uses the new buffer yet, so all ranges can be written
+		for (uint32_t i = 0; i < static_cast<uint32_t>(cmdBuffers.size()); i++)
+		{
+			writeRange(i);
+		}
+	}
+
+	const TextLayout& getTextLayout(const std::string &text)
+	{
+		TextLayout &layout = textLayouts[text];
+		if (layout.glyphs.empty() && !text.empty())
+		{
+			layout.width = 0.0f;
+			for (auto letter : text)
+			{
+				const uint32_t glyph = (uint32_t)letter - STB_FIRST_CHAR;
+				layout.glyphs.push_back(glyph);
+				layout.offsets.push_back(layout.width);
+				layout.width += stbFontData[glyph].advance;
+			}
+		}
+		layout.lastUpdate = textUpdate;
+		return layout;
+	}
 
 public:
 
@@ -87,6 +348,7 @@ public:
 	* Default constructor
 	*
 	* @param vulkanDevice Pointer to a valid VulkanDevice
+	* @param finalLayout (Optional) Layout the color attachment is transitioned to, set if the images are not presented
 	*/
 	VulkanTextOverlay(
 		vk::VulkanDevice *vulkanDevice,
@@ -96,12 +358,15 @@ public:
 		VkFormat depthformat,
 		uint32_t *framebufferwidth,
 		uint32_t *framebufferheight,
-		std::vector<VkPipelineShaderStageCreateInfo> shaderstages)
+		std::vector<VkPipelineShaderStageCreateInfo> shaderstages,
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		glm::mat2 preRotation = glm::mat2())
 	{
 		this->vulkanDevice = vulkanDevice;
 		this->queue = queue;
 		this->colorFormat = colorformat;
 		this->depthFormat = depthformat;
+		this->finalLayout = finalLayout;
 
 		this->frameBuffers.resize(framebuffers.size());
 		for (uint32_t i = 0; i < framebuffers.size(); i++)
@@ -113,11 +378,14 @@ public:
 
 		this->frameBufferWidth = framebufferwidth;
 		this->frameBufferHeight = framebufferheight;
+		this->preRotation = preRotation;
 
 		cmdBuffers.resize(framebuffers.size());
+		rangeVersions.assign(framebuffers.size(), textVersion);
 		prepareResources();
 		prepareRenderPass();
 		preparePipeline();
+		updateCommandBuffers();
 	}
 
 	/**
@@ -126,7 +394,8 @@ public:
 	~VulkanTextOverlay()
 	{
 		// Free up all Vulkan resources requested by the text overlay
-		vertexBuffer.destroy();
+		glyphBuffer.destroy();
+		glyphTable.destroy();
 		vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
 		vkDestroyImage(vulkanDevice->logicalDevice, image, nullptr);
 		vkDestroyImageView(vulkanDevice->logicalDevice, view, nullptr);
@@ -139,7 +408,6 @@ public:
 		vkDestroyRenderPass(vulkanDevice->logicalDevice, renderPass, nullptr);
 		vkFreeCommandBuffers(vulkanDevice->logicalDevice, commandPool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
 		vkDestroyCommandPool(vulkanDevice->logicalDevice, commandPool, nullptr);
-		vkDestroyFence(vulkanDevice->logicalDevice, fence, nullptr);
 	}
 
 	/**
@@ -168,24 +436,41 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, cmdBuffers.data()));
 
-		// Vertex buffer
+		// Glyph instances
+		// The glyph count is passed through the indirect draws, so the command buffers don't need to be recorded again for new text
+		createGlyphBuffer();
+		for (uint32_t i = 0; i < static_cast<uint32_t>(cmdBuffers.size()); i++)
+		{
+			writeRange(i);
+		}
+
+		// Glyph table, matches the layout of the uniform block in the vertex shader
+		std::vector<glm::vec4> glyphData;
+		glyphData.reserve(STB_NUM_CHARS * 2);
+		for (uint32_t i = 0; i < STB_NUM_CHARS; i++)
+		{
+			const stb_fontchar &charData = stbFontData[i];
+			glyphData.push_back(glm::vec4((float)charData.x0, (float)charData.y0, (float)charData.x1, (float)charData.y1));
+			glyphData.push_back(glm::vec4(charData.s0, charData.t0, charData.s1, charData.t1));
+		}
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&vertexBuffer,
-			MAX_CHAR_COUNT * sizeof(glm::vec4)));
-
-		// Map persistent
-		vertexBuffer.map();
-
-		// Font texture
+			&glyphTable,
+			glyphData.size() * sizeof(glm::vec4),
+			glyphData.data()));
+		glyphTable.descriptor = { glyphTable.buffer, 0, glyphTable.size };
+
+		// Font texture, the glyphs' signed distances so text can be drawn at any size
+		const std::vector<uint8_t> &atlas = getDistanceFieldAtlas(&font24pixels[0][0]);
+		const uint32_t atlasLevels = getAtlasLevelCount();
 		VkImageCreateInfo imageInfo = vkTools::initializers::imageCreateInfo();
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
 		imageInfo.format = VK_FORMAT_R8_UNORM;
-		imageInfo.extent.width = STB_FONT_WIDTH;
-		imageInfo.extent.height = STB_FONT_HEIGHT;
+		imageInfo.extent.width = STB_FONT_WIDTH * SDF_FONT_UPSCALE;
+		imageInfo.extent.height = STB_FONT_HEIGHT * SDF_FONT_UPSCALE;
 		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
+		imageInfo.mipLevels = atlasLevels;
 		imageInfo.arrayLayers = 1;
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -209,10 +494,10 @@ public:
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&stagingBuffer,
-			allocInfo.allocationSize));
+			atlas.size()));
 
 		stagingBuffer.map();
-		memcpy(stagingBuffer.mapped, &font24pixels[0][0], STB_FONT_WIDTH * STB_FONT_HEIGHT);	// Only one channel, so data size = W * H (*R8)
+		memcpy(stagingBuffer.mapped, atlas.data(), atlas.size());	// Only one channel, so data size = W * H (*R8) for each level
 		stagingBuffer.unmap();
 
 		// Copy to image
@@ -223,29 +508,42 @@ public:
 		VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
 		VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
 
+		const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, atlasLevels, 0, 1 };
+
 		// Prepare for transfer
 		vkTools::setImageLayout(
 			copyCmd,
 			image,
 			VK_IMAGE_ASPECT_COLOR_BIT,
 			VK_IMAGE_LAYOUT_PREINITIALIZED,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			subresourceRange);
 
-		VkBufferImageCopy bufferCopyRegion = {};
-		bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		bufferCopyRegion.imageSubresource.mipLevel = 0;
-		bufferCopyRegion.imageSubresource.layerCount = 1;
-		bufferCopyRegion.imageExtent.width = STB_FONT_WIDTH;
-		bufferCopyRegion.imageExtent.height = STB_FONT_HEIGHT;
-		bufferCopyRegion.imageExtent.depth = 1;
+		// Levels are stored one after the other
+		std::vector<VkBufferImageCopy> bufferCopyRegions(atlasLevels);
+		VkDeviceSize levelOffset = 0;
+		for (uint32_t level = 0; level < atlasLevels; level++)
+		{
+			VkBufferImageCopy &bufferCopyRegion = bufferCopyRegions[level];
+			bufferCopyRegion = {};
+			bufferCopyRegion.bufferOffset = levelOffset;
+			bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			bufferCopyRegion.imageSubresource.mipLevel = level;
+			bufferCopyRegion.imageSubresource.layerCount = 1;
+			bufferCopyRegion.imageExtent.width = imageInfo.extent.width >> level;
+			bufferCopyRegion.imageExtent.height = imageInfo.extent.height >> level;
+			bufferCopyRegion.imageExtent.depth = 1;
+			levelOffset += bufferCopyRegion.imageExtent.width * bufferCopyRegion.imageExtent.height;
+		}
+		assert(levelOffset == atlas.size());
 
 		vkCmdCopyBufferToImage(
 			copyCmd,
 			stagingBuffer.buffer,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&bufferCopyRegion
+			static_cast<uint32_t>(bufferCopyRegions.size()),
+			bufferCopyRegions.data()
 			);
 
 		// Prepare for shader read
@@ -254,7 +552,8 @@ public:
 			image,
 			VK_IMAGE_ASPECT_COLOR_BIT,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			subresourceRange);
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
 
@@ -262,8 +561,8 @@ public:
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &copyCmd;
 
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		vk::QueueTimeline *timeline = vulkanDevice->getQueueTimeline(queue);
+		VK_CHECK_RESULT(timeline->wait(timeline->submit(1, &submitInfo)));
 
 		stagingBuffer.destroy();
 
@@ -274,7 +573,7 @@ public:
 		imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 		imageViewInfo.format = imageInfo.format;
 		imageViewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B,	VK_COMPONENT_SWIZZLE_A };
-		imageViewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		imageViewInfo.subresourceRange = subresourceRange;
 		VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &imageViewInfo, nullptr, &view));
 
 		// Sampler
@@ -288,14 +587,15 @@ public:
 		samplerInfo.mipLodBias = 0.0f;
 		samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
 		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 1.0f;
+		samplerInfo.maxLod = (float)atlasLevels;
 		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 		VK_CHECK_RESULT(vkCreateSampler(vulkanDevice->logicalDevice, &samplerInfo, nullptr, &sampler));
 
 		// Descriptor
 		// Font uses a separate descriptor pool
-		std::array<VkDescriptorPoolSize, 1> poolSizes;
+		std::array<VkDescriptorPoolSize, 2> poolSizes;
 		poolSizes[0] = vkTools::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1);
+		poolSizes[1] = vkTools::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1);
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vkTools::initializers::descriptorPoolCreateInfo(
@@ -306,8 +606,9 @@ public:
 		VK_CHECK_RESULT(vkCreateDescriptorPool(vulkanDevice->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 		// Descriptor set layout
-		std::array<VkDescriptorSetLayoutBinding, 1> setLayoutBindings;
+		std::array<VkDescriptorSetLayoutBinding, 2> setLayoutBindings;
 		setLayoutBindings[0] = vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+		setLayoutBindings[1] = vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1);
 
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo =
 			vkTools::initializers::descriptorSetLayoutCreateInfo(
@@ -322,6 +623,10 @@ public:
 				&descriptorSetLayout,
 				1);
 
+		VkPushConstantRange pushConstantRange = vkTools::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(PushConstants), 0);
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
 		VK_CHECK_RESULT(vkCreatePipelineLayout(vulkanDevice->logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout));
 
 		// Descriptor set
@@ -339,18 +644,15 @@ public:
 				view,
 				VK_IMAGE_LAYOUT_GENERAL);
 
-		std::array<VkWriteDescriptorSet, 1> writeDescriptorSets;
+		std::array<VkWriteDescriptorSet, 2> writeDescriptorSets;
 		writeDescriptorSets[0] = vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &texDescriptor);
+		writeDescriptorSets[1] = vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &glyphTable.descriptor);
 		vkUpdateDescriptorSets(vulkanDevice->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
 		// Pipeline cache
 		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 		VK_CHECK_RESULT(vkCreatePipelineCache(vulkanDevice->logicalDevice, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
-
-		// Command buffer execution fence
-		VkFenceCreateInfo fenceCreateInfo = vkTools::initializers::fenceCreateInfo();
-		VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceCreateInfo, nullptr, &fence));
 	}
 
 	/**
@@ -413,15 +715,16 @@ public:
 				static_cast<uint32_t>(dynamicStateEnables.size()),
 				0);
 
-		std::array<VkVertexInputBindingDescription, 2> vertexBindings = {};
-		vertexBindings[0] = vkTools::initializers::vertexInputBindingDescription(0, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX);
-		vertexBindings[1] = vkTools::initializers::vertexInputBindingDescription(1, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX);
+		std::array<VkVertexInputBindingDescription, 1> vertexBindings = {};
+		vertexBindings[0] = vkTools::initializers::vertexInputBindingDescription(0, sizeof(GlyphInstance), VK_VERTEX_INPUT_RATE_INSTANCE);
 
-		std::array<VkVertexInputAttributeDescription, 2> vertexAttribs = {};
+		std::array<VkVertexInputAttributeDescription, 3> vertexAttribs = {};
 		// Position
-		vertexAttribs[0] = vkTools::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32_SFLOAT, 0);
-		// UV
-		vertexAttribs[1] = vkTools::initializers::vertexInputAttributeDescription(1, 1, VK_FORMAT_R32G32_SFLOAT, sizeof(glm::vec2));
+		vertexAttribs[0] = vkTools::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(GlyphInstance, position));
+		// Glyph index
+		vertexAttribs[1] = vkTools::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32_UINT, offsetof(GlyphInstance, glyph));
+		// Scale
+		vertexAttribs[2] = vkTools::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32_SFLOAT, offsetof(GlyphInstance, scale));
 
 		VkPipelineVertexInputStateCreateInfo inputState = vkTools::initializers::pipelineVertexInputStateCreateInfo();
 		inputState.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexBindings.size());
@@ -464,8 +767,9 @@ public:
 		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		// The example's render pass leaves the image in the same layout, loading from undefined would discard its contents
+		attachments[0].initialLayout = finalLayout;
+		attachments[0].finalLayout = finalLayout;
 
 		// Depth attachment
 		attachments[1].format = depthFormat;
@@ -490,9 +794,10 @@ public:
 		// Transition from final to initial (VK_SUBPASS_EXTERNAL refers to all commmands executed outside of the actual renderpass)
 		subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		subpassDependencies[0].dstSubpass = 0;
-		subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		// The overlay may be submitted together with the example's command buffers, so it has to wait for their color writes
+		subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		subpassDependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		subpassDependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
@@ -531,12 +836,12 @@ public:
 	}
 
 	/**
-	* Maps the buffer, resets letter count
+	* Resets the glyph count
 	*/
 	void beginTextUpdate()
 	{
-		mappedLocal = (glm::vec4*)vertexBuffer.mapped;
-		numLetters = 0;
+		glyphs.clear();
+		textUpdate++;
 	}
 
 	/**
@@ -546,84 +851,95 @@ public:
 	* @param x x position of the text to add in window coordinate space
 	* @param y y position of the text to add in window coordinate space
 	* @param align Alignment for the new text (left, right, center)
+	* @param scale (Optional) Size of the text relative to the font's 24 pixels, the glyphs are drawn from a distance field and stay sharp at any size
+	*
+	* @note The glyphs and the width of a string are cached as long as it's added in each update
 	*/
-	void addText(std::string text, float x, float y, TextAlign align)
+	void addText(std::string text, float x, float y, TextAlign align, float scale = 1.0f)
 	{
-		assert(vertexBuffer.mapped != nullptr);
+		const glm::vec2 areaSize = getTextAreaSize();
+		const float charW = 1.5f * scale / areaSize.x;
 
-		const float charW = 1.5f / *frameBufferWidth;
-		const float charH = 1.5f / *frameBufferHeight;
+		x = (x / areaSize.x * 2.0f) - 1.0f;
+		y = (y / areaSize.y * 2.0f) - 1.0f;
 
-		float fbW = (float)*frameBufferWidth;
-		float fbH = (float)*frameBufferHeight;
-		x = (x / fbW * 2.0f) - 1.0f;
-		y = (y / fbH * 2.0f) - 1.0f;
-
-		// Calculate text width
-		float textWidth = 0;
-		for (auto letter : text)
-		{
-			stb_fontchar *charData = &stbFontData[(uint32_t)letter - STB_FIRST_CHAR];
-			textWidth += charData->advance * charW;
-		}
+		const TextLayout &layout = getTextLayout(text);
 
 		switch (align)
 		{
 		case alignRight:
-			x -= textWidth;
+			x -= layout.width * charW;
 			break;
 		case alignCenter:
-			x -= textWidth / 2.0f;
+			x -= layout.width * charW / 2.0f;
 			break;
 		case alignLeft:
 			break;
 		}
 
-		// Generate a uv mapped quad per char in the new text
-		for (auto letter : text)
+		for (size_t i = 0; i < layout.glyphs.size(); i++)
 		{
-			stb_fontchar *charData = &stbFontData[(uint32_t)letter - STB_FIRST_CHAR];
-
-			mappedLocal->x = (x + (float)charData->x0 * charW);
-			mappedLocal->y = (y + (float)charData->y0 * charH);
-			mappedLocal->z = charData->s0;
-			mappedLocal->w = charData->t0;
-			mappedLocal++;
-
-			mappedLocal->x = (x + (float)charData->x1 * charW);
-			mappedLocal->y = (y + (float)charData->y0 * charH);
-			mappedLocal->z = charData->s1;
-			mappedLocal->w = charData->t0;
-			mappedLocal++;
-
-			mappedLocal->x = (x + (float)charData->x0 * charW);
-			mappedLocal->y = (y + (float)charData->y1 * charH);
-			mappedLocal->z = charData->s0;
-			mappedLocal->w = charData->t1;
-			mappedLocal++;
-
-			mappedLocal->x = (x + (float)charData->x1 * charW);
-			mappedLocal->y = (y + (float)charData->y1 * charH);
-			mappedLocal->z = charData->s1;
-			mappedLocal->w = charData->t1;
-			mappedLocal++;
-
-			x += charData->advance * charW;
-
-			numLetters++;
+			GlyphInstance instance = {};
+			instance.position = glm::vec2(x + layout.offsets[i] * charW, y);
+			instance.glyph = layout.glyphs[i];
+			instance.scale = scale;
+			glyphs.push_back(instance);
 		}
 	}
 
 	/**
-	* Unmap buffer and update command buffers
+	* Set the rotation of the frame buffers' contents, takes effect with the next updateCommandBuffers
+	*
+	* @note Texts added before have been laid out for the previous rotation
+	*/
+	void setPreRotation(const glm::mat2 &rotation)
+	{
+		preRotation = rotation;
+	}
+
+	/**
+	* Finish the text update, the new text is copied to each command buffer's range by updateFrame
 	*/
 	void endTextUpdate()
 	{
-		updateCommandBuffers();
+		// Drop the layouts of strings that haven't been added in this update
+		for (auto layout = textLayouts.begin(); layout != textLayouts.end();)
+		{
+			if (layout->second.lastUpdate != textUpdate)
+			{
+				layout = textLayouts.erase(layout);
+			}
+			else
+			{
+				++layout;
+			}
+		}
+		textVersion++;
+	}
+
+	/**
+	* Copy the glyphs of the last update to the range of a command buffer, if they haven't been copied yet
+	*
+	* @param bufferindex Index of the command buffer that is submitted next, it must not be pending execution
+	*/
+	void updateFrame(uint32_t bufferindex)
+	{
+		if (rangeVersions[bufferindex] == textVersion)
+		{
+			return;
+		}
+		if (glyphs.size() > glyphCapacity)
+		{
+			growGlyphBuffer();
+			return;
+		}
+		writeRange(bufferindex);
 	}
 
 	/**
-	* Update the command buffers to reflect text changes
+	* Record the command buffers, only required if the frame buffers or their size changed
+	*
+	* @note Text changes are picked up through the ranges written by updateFrame
 	*/
 	void updateCommandBuffers()
 	{
@@ -661,13 +977,15 @@ public:
 			vkCmdBindPipeline(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 			vkCmdBindDescriptorSets(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
-			VkDeviceSize offsets = 0;
-			vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, &vertexBuffer.buffer, &offsets);
-			vkCmdBindVertexBuffers(cmdBuffers[i], 1, 1, &vertexBuffer.buffer, &offsets);
-			for (uint32_t j = 0; j < numLetters; j++)
-			{
-				vkCmdDraw(cmdBuffers[i], 4, 1, j * 4, 0);
-			}
+			PushConstants pushConstants;
+			pushConstants.charScale = glm::vec2(1.5f) / getTextAreaSize();
+			pushConstants.preRotation = preRotation;
+			vkCmdPushConstants(cmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+			const VkDeviceSize rangeOffset = getRangeSize() * i;
+			VkDeviceSize offsets = rangeOffset + sizeof(VkDrawIndirectCommand);
+			vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, &glyphBuffer.buffer, &offsets);
+			vkCmdDrawIndirect(cmdBuffers[i], glyphBuffer.buffer, rangeOffset, 1, sizeof(VkDrawIndirectCommand));
 
 			vkCmdEndRenderPass(cmdBuffers[i]);
 
@@ -693,19 +1011,27 @@ public:
 		submitInfo.pCommandBuffers = &cmdBuffers[bufferindex];
 		submitInfo.commandBufferCount = 1;
 
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-
-		VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX));
-		VK_CHECK_RESULT(vkResetFences(vulkanDevice->logicalDevice, 1, &fence));
+		// Completion is tracked by the frame's fence, waiting here would stall the frames in flight
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 	}
 
 	/**
 	* Reallocate command buffers for the text overlay
-	* @note Frees the existing command buffers
+	*
+	* @param retired (Optional) Receives the existing command buffers instead of freeing them, if they may still be pending execution
+	* @note Frees the existing command buffers if retired is not set
+	* @note The new command buffers are recorded for the current frame buffers
 	*/
-	void reallocateCommandBuffers()
+	void reallocateCommandBuffers(std::vector<VkCommandBuffer> *retired = nullptr)
 	{
-		vkFreeCommandBuffers(vulkanDevice->logicalDevice, commandPool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
+		if (retired)
+		{
+			*retired = cmdBuffers;
+		}
+		else
+		{
+			freeCommandBuffers(cmdBuffers);
+		}
 
 		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
 			vkTools::initializers::commandBufferAllocateInfo(
@@ -714,6 +1040,15 @@ public:
 				static_cast<uint32_t>(cmdBuffers.size()));
 
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, cmdBuffers.data()));
+		updateCommandBuffers();
+	}
+
+	/**
+	* Free command buffers retired by reallocateCommandBuffers
+	*/
+	void freeCommandBuffers(const std::vector<VkCommandBuffer> &buffers)
+	{
+		vkFreeCommandBuffers(vulkanDevice->logicalDevice, commandPool, static_cast<uint32_t>(buffers.size()), buffers.data());
 	}
 
 };
\ No newline at end of file
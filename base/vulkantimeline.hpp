@@ -0,0 +1,176 @@
+/*
+* Vulkan queue timeline
+*
+* Tracks the progress of a queue with a monotonically increasing value per submission, so the host can wait for
+* or poll an exact submission instead of waiting for the whole queue to become idle
+* The values are backed by a pool of recycled fences, as the headers predate VK_KHR_timeline_semaphore
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "vulkantools.h"
+
+namespace vk
+{
+	class QueueTimeline
+	{
+	private:
+		VkDevice device;
+		VkQueue queue;
+		PFN_vkQueueSubmit queueSubmit;
+
+		// Submissions that may not have finished yet with the value they signal, in submission order
+		std::deque<std::pair<uint64_t, VkFence>> pending;
+		// Signaled fences that can't be reset while the host is waiting on fences of this timeline
+		std::vector<VkFence> signaledFences;
+		std::vector<VkFence> freeFences;
+		uint64_t submittedValue = 0;
+		uint64_t completedValue = 0;
+		uint32_t waiterCount = 0;
+		// Guards the state above, queue submissions must be externally synchronized anyway
+		std::mutex mutex;
+
+		// Move finished submissions out of the pending list, mutex must be locked
+		void update()
+		{
+			while (!pending.empty() && (vkGetFenceStatus(device, pending.front().second) == VK_SUCCESS))
+			{
+				completedValue = pending.front().first;
+				signaledFences.push_back(pending.front().second);
+				pending.pop_front();
+			}
+			if ((waiterCount == 0) && !signaledFences.empty())
+			{
+				VK_CHECK_RESULT(vkResetFences(device, static_cast<uint32_t>(signaledFences.size()), signaledFences.data()));
+				freeFences.insert(freeFences.end(), signaledFences.begin(), signaledFences.end());
+				signaledFences.clear();
+			}
+		}
+
+	public:
+		/**
+		* @param device Logical device the fences are created on
+		* @param queue Queue whose submissions are tracked
+		* @param queueSubmit Function used for the submissions, e.g. from the device's dispatch table
+		*/
+		QueueTimeline(VkDevice device, VkQueue queue, PFN_vkQueueSubmit queueSubmit = vkQueueSubmit)
+			: device(device), queue(queue), queueSubmit(queueSubmit) {}
+
+		/** @brief Destroy the fences, the tracked submissions must have finished */
+		~QueueTimeline()
+		{
+			for (auto& submission : pending)
+			{
+				vkDestroyFence(device, submission.second, nullptr);
+			}
+			for (auto fence : signaledFences)
+			{
+				vkDestroyFence(device, fence, nullptr);
+			}
+			for (auto fence : freeFences)
+			{
+				vkDestroyFence(device, fence, nullptr);
+			}
+		}
+
+		/**
+		* Submit work to the queue
+		*
+		* @return Timeline value that is reached once the submitted work has finished
+		*/
+		uint64_t submit(uint32_t submitCount, const VkSubmitInfo *submits)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			update();
+			VkFence fence;
+			if (!freeFences.empty())
+			{
+				fence = freeFences.back();
+				freeFences.pop_back();
+			}
+			else
+			{
+				VkFenceCreateInfo fenceInfo = vkTools::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+				VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+			}
+			VK_CHECK_RESULT(queueSubmit(queue, submitCount, submits, fence));
+			submittedValue++;
+			pending.push_back({ submittedValue, fence });
+			return submittedValue;
+		}
+
+		/** @brief Latest value whose work has finished, polls without blocking */
+		uint64_t getCompletedValue()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			update();
+			return completedValue;
+		}
+
+		/** @brief Value of the latest submission */
+		uint64_t getSubmittedValue()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return submittedValue;
+		}
+
+		bool isComplete(uint64_t value)
+		{
+			return getCompletedValue() >= value;
+		}
+
+		/**
+		* Block until the work of a value has finished, work submitted after it isn't waited for
+		*
+		* @return VK_SUCCESS or VK_TIMEOUT
+		*/
+		VkResult wait(uint64_t value, uint64_t timeout = UINT64_MAX)
+		{
+			VkFence fence = VK_NULL_HANDLE;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				assert(value <= submittedValue);
+				update();
+				if (value <= completedValue)
+				{
+					return VK_SUCCESS;
+				}
+				// Submissions finish in order, so the first one reaching the value is enough
+				for (auto& submission : pending)
+				{
+					if (submission.first >= value)
+					{
+						fence = submission.second;
+						break;
+					}
+				}
+				waiterCount++;
+			}
+			VkResult result = vkWaitForFences(device, 1, &fence, VK_TRUE, timeout);
+			std::lock_guard<std::mutex> lock(mutex);
+			waiterCount--;
+			update();
+			return result;
+		}
+
+		/** @brief Block until all submitted work has finished */
+		void waitIdle()
+		{
+			const uint64_t value = getSubmittedValue();
+			if (value > 0)
+			{
+				VK_CHECK_RESULT(wait(value));
+			}
+		}
+	};
+}
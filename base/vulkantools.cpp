@@ -7,6 +7,10 @@
 */
 
 #include "vulkantools.h"
+#include "vulkanbarriers.hpp"
+#include "assetfile.hpp"
+
+#include <atomic>
 
 namespace vkTools
 {
@@ -79,6 +83,24 @@ namespace vkTools
 		}
 	}
 
+	std::function<void()> deviceLostHandler;
+	std::atomic<bool> deviceLostHandled(false);
+
+	void setDeviceLostHandler(std::function<void()> handler)
+	{
+		deviceLostHandler = handler;
+		deviceLostHandled = false;
+	}
+
+	void deviceLost()
+	{
+		// Every call failing after the loss ends up here, the handler only reports the first one
+		if (deviceLostHandler && !deviceLostHandled.exchange(true))
+		{
+			deviceLostHandler();
+		}
+	}
+
 	VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat)
 	{
 		// Since all depth formats may be optional, we need to find a suitable depth format to use
@@ -109,6 +131,7 @@ namespace vkTools
 	// Create an image memory barrier for changing the layout of
 	// an image and put it into an active command buffer
 	// See chapter 11.4 "Image Layout" for details
+	// The access and stage masks are derived from the layouts, see BarrierBatch, which also batches several transitions into one barrier
 
 	void setImageLayout(
 		VkCommandBuffer cmdbuffer, 
@@ -118,117 +141,9 @@ namespace vkTools
 		VkImageLayout newImageLayout,
 		VkImageSubresourceRange subresourceRange)
 	{
-		// Create an image barrier object
-		VkImageMemoryBarrier imageMemoryBarrier = vkTools::initializers::imageMemoryBarrier();
-		imageMemoryBarrier.oldLayout = oldImageLayout;
-		imageMemoryBarrier.newLayout = newImageLayout;
-		imageMemoryBarrier.image = image;
-		imageMemoryBarrier.subresourceRange = subresourceRange;
-
-		// Source layouts (old)
-		// Source access mask controls actions that have to be finished on the old layout
-		// before it will be transitioned to the new layout
-		switch (oldImageLayout)
-		{
-		case VK_IMAGE_LAYOUT_UNDEFINED:
-				// Image layout is undefined (or does not matter)
-				// Only valid as initial layout
-				// No flags required, listed only for completeness
-				imageMemoryBarrier.srcAccessMask = 0;
-				break;
-
-		case VK_IMAGE_LAYOUT_PREINITIALIZED:
-				// Image is preinitialized
-				// Only valid as initial layout for linear images, preserves memory contents
-				// Make sure host writes have been finished
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-				break;
-
-		case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-				// Image is a color attachment
-				// Make sure any writes to the color buffer have been finished
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-				break;
-
-		case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-				// Image is a depth/stencil attachment
-				// Make sure any writes to the depth/stencil buffer have been finished
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-				break;
-
-		case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-				// Image is a transfer source 
-				// Make sure any reads from the image have been finished
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-				break;
-
-		case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-				// Image is a transfer destination
-				// Make sure any writes to the image have been finished
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-				break;
-
-		case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-				// Image is read by a shader
-				// Make sure any shader reads from the image have been finished
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-				break;
-		}
-
-		// Target layouts (new)
-		// Destination access mask controls the dependency for the new image layout
-		switch (newImageLayout)
-		{
-		case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-			// Image will be used as a transfer destination
-			// Make sure any writes to the image have been finished
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			break;
-
-		case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-			// Image will be used as a transfer source
-			// Make sure any reads from and writes to the image have been finished
-			imageMemoryBarrier.srcAccessMask = imageMemoryBarrier.srcAccessMask | VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			break;
-
-		case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-			// Image will be used as a color attachment
-			// Make sure any writes to the color buffer have been finished
-			imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			break;
-
-		case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-			// Image layout will be used as a depth/stencil attachment
-			// Make sure any writes to depth/stencil buffer have been finished
-			imageMemoryBarrier.dstAccessMask = imageMemoryBarrier.dstAccessMask | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-			break;
-
-		case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-			// Image will be read in a shader (sampler, input attachment)
-			// Make sure any writes to the image have been finished
-			if (imageMemoryBarrier.srcAccessMask == 0)
-			{
-				imageMemoryBarrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
-			}
-			imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-			break;
-		}
-
-		// Put barrier on top
-		VkPipelineStageFlags srcStageFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		VkPipelineStageFlags destStageFlags = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-
-		// Put barrier inside setup command buffer
-		vkCmdPipelineBarrier(
-			cmdbuffer, 
-			srcStageFlags, 
-			destStageFlags, 
-			0, 
-			0, nullptr,
-			0, nullptr,
-			1, &imageMemoryBarrier);
+		BarrierBatch barriers;
+		barriers.imageLayout(image, oldImageLayout, newImageLayout, subresourceRange);
+		barriers.flush(cmdbuffer);
 	}
 
 	// Fixed sub resource on first mip level and layer
@@ -247,6 +162,94 @@ namespace vkTools
 		setImageLayout(cmdbuffer, image, aspectMask, oldImageLayout, newImageLayout, subresourceRange);
 	}
 
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t levels = 1;
+		uint32_t size = std::max(width, height);
+		while (size > 1)
+		{
+			size >>= 1;
+			levels++;
+		}
+		return levels;
+	}
+
+	VkBool32 formatSupportsMipmapBlit(VkPhysicalDevice physicalDevice, VkFormat format)
+	{
+		VkFormatProperties formatProps;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProps);
+		const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		return (formatProps.optimalTilingFeatures & required) == required;
+	}
+
+	void generateMipmaps(
+		VkCommandBuffer cmdbuffer,
+		VkImage image,
+		uint32_t width,
+		uint32_t height,
+		uint32_t mipLevels,
+		uint32_t layerCount,
+		VkImageLayout oldImageLayout,
+		VkImageLayout newImageLayout)
+	{
+		VkImageMemoryBarrier barriers[2];
+
+		// Level 0 becomes the source of the first blit, the remaining levels are blit destinations
+		barriers[0] = vkTools::initializers::imageMemoryBarrier();
+		barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[0].oldLayout = oldImageLayout;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[0].image = image;
+		barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layerCount };
+
+		barriers[1] = barriers[0];
+		barriers[1].srcAccessMask = 0;
+		barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels - 1, 0, layerCount };
+
+		vkCmdPipelineBarrier(
+			cmdbuffer,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			(mipLevels > 1) ? 2 : 1, barriers);
+
+		for (uint32_t i = 1; i < mipLevels; i++)
+		{
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, layerCount };
+			blit.srcOffsets[1] = { std::max(int32_t(width >> (i - 1)), 1), std::max(int32_t(height >> (i - 1)), 1), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, layerCount };
+			blit.dstOffsets[1] = { std::max(int32_t(width >> i), 1), std::max(int32_t(height >> i), 1), 1 };
+			vkCmdBlitImage(cmdbuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+			// The level that has just been written is the source for the next one
+			VkImageMemoryBarrier barrier = vkTools::initializers::imageMemoryBarrier();
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.image = image;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, layerCount };
+			vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		// All levels are now in the transfer source layout
+		VkImageMemoryBarrier barrier = vkTools::initializers::imageMemoryBarrier();
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = newImageLayout;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, layerCount };
+		vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
 	void exitFatal(std::string message, std::string caption)
 	{
 #ifdef _WIN32
@@ -280,28 +283,21 @@ namespace vkTools
 	// So they need to be loaded via the asset manager
 	VkShaderModule loadShader(AAssetManager* assetManager, const char *fileName, VkDevice device, VkShaderStageFlagBits stage)
 	{
-		// Load shader from compressed asset
-		AAsset* asset = AAssetManager_open(assetManager, fileName, AASSET_MODE_STREAMING);
-		assert(asset);
-		size_t size = AAsset_getLength(asset);
-		assert(size > 0);
-
-		char *shaderCode = new char[size];
-		AAsset_read(asset, shaderCode, size);
-		AAsset_close(asset);
+		// The module is created straight from the asset's buffer
+		AssetFile file(assetManager);
+		bool opened = file.open(fileName);
+		assert(opened);
 
 		VkShaderModule shaderModule;
 		VkShaderModuleCreateInfo moduleCreateInfo;
 		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		moduleCreateInfo.pNext = NULL;
-		moduleCreateInfo.codeSize = size;
-		moduleCreateInfo.pCode = (uint32_t*)shaderCode;
+		moduleCreateInfo.codeSize = file.getSize();
+		moduleCreateInfo.pCode = static_cast<const uint32_t*>(file.data());
 		moduleCreateInfo.flags = 0;
 
 		VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
 
-		delete[] shaderCode;
-
 		return shaderModule;
 	}
 #else
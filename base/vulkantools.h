@@ -18,8 +18,10 @@
 #include <assert.h>
 #include <stdio.h>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
+#include <functional>
 #if defined(_WIN32)
 #include <windows.h>
 #include <fcntl.h>
@@ -41,6 +43,10 @@
 	if (res != VK_SUCCESS)																				\
 	{																									\
 		std::cout << "Fatal : VkResult is \"" << vkTools::errorString(res) << "\" in " << __FILE__ << " at line " << __LINE__ << std::endl; \
+		if (res == VK_ERROR_DEVICE_LOST)																\
+		{																								\
+			vkTools::deviceLost();																		\
+		}																								\
 		assert(res == VK_SUCCESS);																		\
 	}																									\
 }																										\
@@ -54,6 +60,11 @@ namespace vkTools
 	// Return string representation of a vulkan error string
 	std::string errorString(VkResult errorCode);
 
+	// Set a function called by VK_CHECK_RESULT when the device has been lost, e.g. to report diagnostics before the check fails
+	void setDeviceLostHandler(std::function<void()> handler);
+	// Call the device lost handler, only the first call after setting it has an effect
+	void deviceLost();
+
 	// Selected a suitable supported depth format starting with 32 bit down to 16 bit
 	// Returns false if none of the depth formats in the list is supported by the device
 	VkBool32 getSupportedDepthFormat(VkPhysicalDevice physicalDevice, VkFormat *depthFormat);
@@ -74,6 +85,24 @@ namespace vkTools
 		VkImageLayout oldImageLayout, 
 		VkImageLayout newImageLayout);
 
+	// Number of mip levels of a full chain down to 1x1 for the given dimensions
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+	// Check if the format supports generating mip levels with linear filtered blits in optimal tiling
+	VkBool32 formatSupportsMipmapBlit(VkPhysicalDevice physicalDevice, VkFormat format);
+	// Fill mip levels 1 to mipLevels - 1 of all layers by blitting each level from the previous one
+	// Level 0 must be in oldImageLayout, the contents of the other levels are discarded
+	// All levels are transitioned to newImageLayout afterwards
+	// The image needs transfer source and destination usage
+	void generateMipmaps(
+		VkCommandBuffer cmdbuffer,
+		VkImage image,
+		uint32_t width,
+		uint32_t height,
+		uint32_t mipLevels,
+		uint32_t layerCount,
+		VkImageLayout oldImageLayout,
+		VkImageLayout newImageLayout);
+
 	// Display error message and exit on fatal error
 	void exitFatal(std::string message, std::string caption);
 	// Load a text file (e.g. GLGL shader) into a std::string
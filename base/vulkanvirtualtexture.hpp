@@ -0,0 +1,581 @@
+/*
+* Virtual texturing for Vulkan
+*
+* Pages of block compressed textures are loaded from a tiled page file into a physical page cache image of fixed size (see VirtualTexture)
+* The G-Buffer pass sets a feedback bit for each page its fragments want, which is read back once the frame has finished
+* A worker thread copies the requested pages from the mapped page file into staging memory, and the copies into the cache are
+* recorded together with the page table update into a command buffer submitted in front of each frame's passes
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+#include <vulkan/vulkan.h>
+
+#include "vulkandevice.hpp"
+#include "vulkanbuffer.hpp"
+#include "vulkanTextureLoader.hpp"
+#include "virtualtexture.hpp"
+#include "texturefile.hpp"
+#include "cputrace.hpp"
+#include "cputopology.hpp"
+
+#if defined(__ANDROID__)
+#include <android/asset_manager.h>
+#endif
+
+namespace vkTools
+{
+	/**
+	* @brief Virtual texture whose pages are streamed into a physical cache image
+	*
+	* @note All functions must be called from the thread that submits to the graphics queue
+	*/
+	class VulkanVirtualTexture
+	{
+	private:
+		// Page copied into a staging slot by the worker
+		struct Load
+		{
+			uint32_t page;
+			uint32_t slot;
+			uint32_t staging;
+		};
+
+		// Resources of a frame in flight
+		struct Frame
+		{
+			// Read back of the feedback written by the frame before this one
+			vk::Buffer feedback;
+			// Host copy of the page table, uploaded if it has changed
+			vk::Buffer table;
+			// Staging slots copied into the cache by the frame, free again once it has finished
+			std::vector<uint32_t> staging;
+			VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+		};
+
+		vk::VulkanDevice *vulkanDevice;
+		VkQueue queue;
+		VkCommandPool commandPool;
+
+		// Pages are stored as BC2, like all material textures
+		const VkFormat format = VK_FORMAT_BC2_UNORM_BLOCK;
+		const uint32_t blockSize = 16;
+		uint32_t slotsPerRow;
+		uint32_t maxLoadsPerFrame;
+
+		VirtualTexture pages;
+		VirtualTextureFile file;
+		std::vector<std::string> fileNames;
+		std::unordered_map<std::string, uint32_t> textureIndices;
+		size_t pageBytes;
+
+		VulkanTexture cache = {};
+		vk::Buffer textureInfo;
+		vk::Buffer pageTable;
+		vk::Buffer feedback;
+		std::vector<Frame> frames;
+		bool prepared = false;
+
+		// Staging slots of one page each, filled by the worker
+		vk::Buffer staging;
+		std::vector<uint32_t> freeStaging;
+
+		std::thread worker;
+		bool stopping = false;
+		std::mutex loadMutex;
+		std::condition_variable loadCondition;
+		std::deque<Load> loads;
+		std::vector<Load> loaded;
+
+		// Scratch storage of update, kept to not allocate every frame
+		std::vector<Load> finished;
+		std::vector<VirtualTexture::Request> requests;
+		std::vector<VkBufferImageCopy> regions;
+
+		static uint64_t hashData(const void *data, size_t size, uint64_t hash)
+		{
+			const uint8_t *bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+		VkBufferImageCopy getSlotRegion(uint32_t slot, VkDeviceSize bufferOffset)
+		{
+			VkBufferImageCopy region = {};
+			region.bufferOffset = bufferOffset;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.imageOffset = { static_cast<int32_t>((slot % slotsPerRow) * VirtualTexture::SLOT_SIZE), static_cast<int32_t>((slot / slotsPerRow) * VirtualTexture::SLOT_SIZE), 0 };
+			region.imageExtent = { VirtualTexture::SLOT_SIZE, VirtualTexture::SLOT_SIZE, 1 };
+			return region;
+		}
+
+		void workerLoop()
+		{
+			CpuTrace::get().setThreadName("Virtual texture pages");
+			CpuTopology::get().setThreadRole(CpuTopology::THREAD_ROLE_BACKGROUND);
+			while (true)
+			{
+				Load load;
+				{
+					std::unique_lock<std::mutex> lock(loadMutex);
+					loadCondition.wait(lock, [this] { return stopping || !loads.empty(); });
+					if (stopping)
+					{
+						return;
+					}
+					load = loads.front();
+					loads.pop_front();
+				}
+				TraceZone traceZone("Load page");
+				// Reading the mapped page file faults the page in from disk on this thread
+				memcpy(static_cast<uint8_t*>(staging.mapped) + load.staging * pageBytes, file.getPage(load.page), pageBytes);
+				std::lock_guard<std::mutex> lock(loadMutex);
+				loaded.push_back(load);
+			}
+		}
+
+		// Cook the page file from the texture files, returns false if a file can't be loaded or the page file can't be written
+		bool cookPageFile(const std::string &pageFileName, uint64_t hash)
+		{
+			std::cout << "Cooking virtual texture page file \"" << pageFileName << "\" (" << pages.getPageCount() << " pages)" << std::endl;
+			std::vector<std::unique_ptr<TextureFile>> textureFiles;
+			std::vector<const TextureFile*> levels;
+			for (auto& fileName : fileNames)
+			{
+				textureFiles.push_back(std::unique_ptr<TextureFile>(new TextureFile()));
+#if defined(__ANDROID__)
+				textureFiles.back()->assetManager = assetManager;
+#endif
+				if (!textureFiles.back()->load(fileName))
+				{
+					std::cerr << "Could not load texture \"" << fileName << "\"" << std::endl;
+					return false;
+				}
+				levels.push_back(textureFiles.back().get());
+			}
+			return VirtualTextureFile::write(pageFileName, hash, pages, levels, blockSize);
+		}
+
+		// Copy the resident last levels and the initial page table, and clear the feedback
+		void uploadInitialPages()
+		{
+			const std::vector<VirtualTexture::Request> &pinned = pages.getPinnedPages();
+			const std::vector<uint32_t> &table = pages.getTable();
+			const VkDeviceSize tableOffset = pinned.size() * pageBytes;
+			const VkDeviceSize tableSize = table.size() * sizeof(uint32_t);
+			vk::Buffer upload = vulkanDevice->stagingPool->acquire(tableOffset + tableSize);
+			regions.clear();
+			for (size_t i = 0; i < pinned.size(); i++)
+			{
+				memcpy(static_cast<uint8_t*>(upload.mapped) + i * pageBytes, file.getPage(pinned[i].page), pageBytes);
+				regions.push_back(getSlotRegion(pinned[i].slot, i * pageBytes));
+			}
+			memcpy(static_cast<uint8_t*>(upload.mapped) + tableOffset, table.data(), tableSize);
+			pages.tableChanged();
+
+			VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			VkImageMemoryBarrier imageBarrier = vkTools::initializers::imageMemoryBarrier();
+			imageBarrier.srcAccessMask = 0;
+			imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageBarrier.image = cache.image;
+			imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+			vkCmdCopyBufferToImage(copyCmd, upload.buffer, cache.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+			VkBufferCopy copyRegion = { tableOffset, 0, tableSize };
+			vkCmdCopyBuffer(copyCmd, upload.buffer, pageTable.buffer, 1, &copyRegion);
+			vkCmdFillBuffer(copyCmd, feedback.buffer, 0, VK_WHOLE_SIZE, 0);
+
+			imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageBarrier.newLayout = cache.imageLayout;
+			VkMemoryBarrier memoryBarrier = vkTools::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 1, &imageBarrier);
+			vulkanDevice->flushCommandBuffer(copyCmd, queue);
+			vulkanDevice->stagingPool->release(upload);
+		}
+
+	public:
+#if defined(__ANDROID__)
+		AAssetManager* assetManager = nullptr;
+#endif
+
+		/**
+		* Default constructor
+		*
+		* @param vulkanDevice Pointer to a valid VulkanDevice
+		* @param queue Graphics queue the frames using the virtual texture are submitted to
+		* @param framesInFlight Number of frames that may be in flight at once
+		* @param slotsPerRow Edge length of the physical cache in page slots, its memory is fixed by this
+		* @param maxLoadsPerFrame Maximum number of pages requested per frame
+		*/
+		VulkanVirtualTexture(vk::VulkanDevice *vulkanDevice, VkQueue queue, uint32_t framesInFlight, uint32_t slotsPerRow = 30, uint32_t maxLoadsPerFrame = 16) :
+			vulkanDevice(vulkanDevice), queue(queue), slotsPerRow(slotsPerRow), maxLoadsPerFrame(maxLoadsPerFrame), pages(slotsPerRow * slotsPerRow)
+		{
+			pageBytes = VirtualTextureFile::getPageBytes(blockSize);
+			commandPool = vulkanDevice->createCommandPool(vulkanDevice->queueFamilyIndices.graphics);
+			frames.resize(framesInFlight);
+
+			// The cache has a single level, pages are mip mapped by the page table
+			cache.width = slotsPerRow * VirtualTexture::SLOT_SIZE;
+			cache.height = cache.width;
+			cache.mipLevels = 1;
+			cache.layerCount = 1;
+			VkImageCreateInfo imageCreateInfo = vkTools::initializers::imageCreateInfo();
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = format;
+			imageCreateInfo.mipLevels = 1;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageCreateInfo.extent = { cache.width, cache.height, 1 };
+			imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageCreateInfo, nullptr, &cache.image));
+			VK_CHECK_RESULT(vulkanDevice->allocateImageMemory(cache.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cache.allocation));
+			cache.deviceMemory = cache.allocation.memory;
+			cache.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			VkImageViewCreateInfo view = vkTools::initializers::imageViewCreateInfo();
+			view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			view.format = format;
+			view.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+			view.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			view.image = cache.image;
+			VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->logicalDevice, &view, nullptr, &cache.view));
+			// Filtering stays within the level of the slot, the borders cover the bilinear footprint
+			cache.sampler = vulkanDevice->samplerCache->get(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 0.0f, false);
+			cache.descriptor.imageLayout = cache.imageLayout;
+			cache.descriptor.imageView = cache.view;
+			cache.descriptor.sampler = cache.sampler;
+
+			// Two frames worth of loads can be staged while the earlier ones are copied
+			const uint32_t stagingSlots = maxLoadsPerFrame * (framesInFlight + 2);
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&staging,
+				stagingSlots * pageBytes));
+			VK_CHECK_RESULT(staging.map());
+			for (uint32_t i = stagingSlots; i > 0; i--)
+			{
+				freeStaging.push_back(i - 1);
+			}
+		}
+
+		/**
+		* Default destructor
+		*
+		* @note The device must have finished using the virtual texture
+		*/
+		~VulkanVirtualTexture()
+		{
+			if (worker.joinable())
+			{
+				{
+					std::lock_guard<std::mutex> lock(loadMutex);
+					stopping = true;
+				}
+				loadCondition.notify_all();
+				worker.join();
+			}
+			for (auto& frame : frames)
+			{
+				frame.feedback.destroy();
+				frame.table.destroy();
+			}
+			textureInfo.destroy();
+			pageTable.destroy();
+			feedback.destroy();
+			staging.destroy();
+			vkDestroyImageView(vulkanDevice->logicalDevice, cache.view, nullptr);
+			vkDestroyImage(vulkanDevice->logicalDevice, cache.image, nullptr);
+			vulkanDevice->freeMemory(cache.allocation);
+			// Also frees the frames' command buffers
+			vkDestroyCommandPool(vulkanDevice->logicalDevice, commandPool, nullptr);
+		}
+
+		/**
+		* Add a texture, textures used several times are only added once
+		*
+		* @param filename Texture file with a full mip chain stored as BC2 (or DXT3)
+		*
+		* @return Index of the texture for the shaders, UINT32_MAX if it can't be loaded, isn't BC2 or doesn't fit into the cache
+		*
+		* @note Must be called before prepare
+		*/
+		uint32_t addTexture(const std::string &filename)
+		{
+			assert(!prepared);
+			auto existing = textureIndices.find(filename);
+			if (existing != textureIndices.end())
+			{
+				return existing->second;
+			}
+			// Only the header is read, the levels point into the mapped file
+			TextureFile textureFile;
+#if defined(__ANDROID__)
+			textureFile.assetManager = assetManager;
+#endif
+			uint32_t index = UINT32_MAX;
+			if (textureFile.load(filename))
+			{
+				const TextureFile::Level &level = textureFile.getLevels()[0];
+				const bool blocks = (level.size == static_cast<size_t>((level.width + 3) / 4) * ((level.height + 3) / 4) * blockSize);
+				if (blocks)
+				{
+					index = pages.addTexture(level.width, level.height, static_cast<uint32_t>(textureFile.getLevels().size()));
+				}
+			}
+			if (index == UINT32_MAX)
+			{
+				std::cerr << "Texture \"" << filename << "\" can't be paged" << std::endl;
+			}
+			else
+			{
+				assert(index == fileNames.size());
+				fileNames.push_back(filename);
+			}
+			textureIndices[filename] = index;
+			return index;
+		}
+
+		/**
+		* Map the page file, cooking it first if it's missing or out of date, create the buffers and load the resident last levels
+		*
+		* @param pageFileName Page file of the textures that have been added
+		*
+		* @return False if the page file can't be cooked
+		*/
+		bool prepare(const std::string &pageFileName)
+		{
+			assert(!prepared && !fileNames.empty());
+			// The file is out of date if any of the textures have changed in name, size or mip chain
+			uint64_t hash = 14695981039346656037ULL;
+			for (size_t i = 0; i < fileNames.size(); i++)
+			{
+				hash = hashData(fileNames[i].data(), fileNames[i].size(), hash);
+				hash = hashData(&pages.getTextures()[i], sizeof(VirtualTexture::TextureInfo), hash);
+			}
+			if (!file.open(pageFileName, hash, pages.getPageCount(), blockSize))
+			{
+				if (!cookPageFile(pageFileName, hash) || !file.open(pageFileName, hash, pages.getPageCount(), blockSize))
+				{
+					std::cerr << "Could not cook virtual texture page file \"" << pageFileName << "\"" << std::endl;
+					return false;
+				}
+			}
+
+			const std::vector<VirtualTexture::TextureInfo> &textures = pages.getTextures();
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&textureInfo,
+				textures.size() * sizeof(VirtualTexture::TextureInfo),
+				const_cast<VirtualTexture::TextureInfo*>(textures.data())));
+			const VkDeviceSize tableSize = pages.getPageCount() * sizeof(uint32_t);
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&pageTable,
+				tableSize));
+			const VkDeviceSize feedbackSize = pages.getFeedbackWords() * sizeof(uint32_t);
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&feedback,
+				feedbackSize));
+			for (auto& frame : frames)
+			{
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(
+					VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					&frame.feedback,
+					feedbackSize));
+				VK_CHECK_RESULT(frame.feedback.map());
+				// Nothing has been read back before the frame's first submission
+				memset(frame.feedback.mapped, 0, feedbackSize);
+				VK_CHECK_RESULT(vulkanDevice->createBuffer(
+					VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					&frame.table,
+					tableSize));
+				VK_CHECK_RESULT(frame.table.map());
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo = vkTools::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, &frame.cmdBuffer));
+			}
+
+			uploadInitialPages();
+			worker = std::thread(&VulkanVirtualTexture::workerLoop, this);
+			prepared = true;
+			return true;
+		}
+
+		/**
+		* Process the feedback of the frame that last used the frame's resources, request the missing pages and record the frame's
+		* copies of the pages that have been loaded since
+		*
+		* @param frameIndex Frame in flight whose previous submission has finished
+		* @param committed (Optional) Set to true if pages have been committed, so the G-Buffer's contents change
+		*
+		* @return Command buffer to submit before the frame's first pass that samples the virtual texture
+		*/
+		VkCommandBuffer update(uint32_t frameIndex, bool *committed = nullptr)
+		{
+			assert(prepared);
+			Frame &frame = frames[frameIndex];
+			freeStaging.insert(freeStaging.end(), frame.staging.begin(), frame.staging.end());
+			frame.staging.clear();
+
+			pages.processFeedback(static_cast<const uint32_t*>(frame.feedback.mapped));
+
+			// Loads the worker has finished are copied by this frame
+			{
+				std::lock_guard<std::mutex> lock(loadMutex);
+				finished.swap(loaded);
+			}
+			regions.clear();
+			for (auto& load : finished)
+			{
+				regions.push_back(getSlotRegion(load.slot, load.staging * pageBytes));
+				pages.commit(load.page);
+				frame.staging.push_back(load.staging);
+			}
+			finished.clear();
+			if (committed)
+			{
+				*committed = !regions.empty();
+			}
+
+			// New loads, limited by the free staging slots
+			requests.clear();
+			pages.getRequests(std::min(maxLoadsPerFrame, static_cast<uint32_t>(freeStaging.size())), requests);
+			if (!requests.empty())
+			{
+				{
+					std::lock_guard<std::mutex> lock(loadMutex);
+					for (auto& request : requests)
+					{
+						loads.push_back({ request.page, request.slot, freeStaging.back() });
+						freeStaging.pop_back();
+					}
+				}
+				loadCondition.notify_one();
+			}
+
+			VkCommandBufferBeginInfo cmdBufInfo = vkTools::initializers::commandBufferBeginInfo();
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(frame.cmdBuffer, &cmdBufInfo));
+
+			// The previous frame's G-Buffer pass must be done with the feedback, the cache and the page table
+			VkMemoryBarrier memoryBarrier = vkTools::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			VkImageMemoryBarrier imageBarrier = vkTools::initializers::imageMemoryBarrier();
+			imageBarrier.srcAccessMask = 0;
+			imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageBarrier.oldLayout = cache.imageLayout;
+			imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageBarrier.image = cache.image;
+			imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			vkCmdPipelineBarrier(frame.cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, regions.empty() ? 0 : 1, &imageBarrier);
+
+			VkBufferCopy copyRegion = { 0, 0, feedback.size };
+			vkCmdCopyBuffer(frame.cmdBuffer, feedback.buffer, frame.feedback.buffer, 1, &copyRegion);
+			vkCmdFillBuffer(frame.cmdBuffer, feedback.buffer, 0, VK_WHOLE_SIZE, 0);
+			if (!regions.empty())
+			{
+				vkCmdCopyBufferToImage(frame.cmdBuffer, staging.buffer, cache.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+			}
+			if (pages.tableChanged())
+			{
+				const std::vector<uint32_t> &table = pages.getTable();
+				memcpy(frame.table.mapped, table.data(), table.size() * sizeof(uint32_t));
+				copyRegion.size = pageTable.size;
+				vkCmdCopyBuffer(frame.cmdBuffer, frame.table.buffer, pageTable.buffer, 1, &copyRegion);
+			}
+
+			// This frame's G-Buffer pass samples the new pages and writes the next feedback, the read back is for the host
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageBarrier.newLayout = cache.imageLayout;
+			vkCmdPipelineBarrier(frame.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, regions.empty() ? 0 : 1, &imageBarrier);
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(frame.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(frame.cmdBuffer));
+			return frame.cmdBuffer;
+		}
+
+		/** @brief Physical page cache, sampled at the slots the page table points to */
+		VkDescriptorImageInfo& getCacheDescriptor()
+		{
+			return cache.descriptor;
+		}
+
+		/** @brief Per texture page layout, see VirtualTexture::TextureInfo */
+		VkDescriptorBufferInfo& getTextureInfoDescriptor()
+		{
+			return textureInfo.descriptor;
+		}
+
+		/** @brief Page table entry of each page, see VirtualTexture::makeEntry */
+		VkDescriptorBufferInfo& getPageTableDescriptor()
+		{
+			return pageTable.descriptor;
+		}
+
+		/** @brief One bit per page, set by the fragments sampling it */
+		VkDescriptorBufferInfo& getFeedbackDescriptor()
+		{
+			return feedback.descriptor;
+		}
+
+		/** @brief Memory of the physical page cache, fixed regardless of the number of textures */
+		VkDeviceSize getCacheSize() const
+		{
+			return static_cast<VkDeviceSize>(cache.width / 4) * (cache.height / 4) * blockSize;
+		}
+
+		uint32_t getSlotCount() const
+		{
+			return pages.getSlotCount();
+		}
+
+		uint32_t getUsedSlotCount() const
+		{
+			return pages.getUsedSlotCount();
+		}
+
+		uint32_t getPageCount() const
+		{
+			return pages.getPageCount();
+		}
+	};
+}
@@ -0,0 +1,388 @@
+/*
+* Micro benchmarks for the framework's components, run headless
+*
+* Every benchmark is timed over a number of iterations after a warmup run, the results are written as JSON (-benchresult <file>)
+* so runs of different commits can be diffed, times are in milliseconds per iteration
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <algorithm>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vulkan/vulkan.h>
+#include "vulkanexamplebase.h"
+#include "frustum.hpp"
+#include "threadpool.hpp"
+#include "benchmark.hpp"
+
+// Same vertex layout as the renderer
+typedef vkMeshLoader::VertexFormat<
+	vkMeshLoader::VERTEX_LAYOUT_POSITION,
+	vkMeshLoader::VERTEX_LAYOUT_UV,
+	vkMeshLoader::VERTEX_LAYOUT_COLOR,
+	vkMeshLoader::VERTEX_LAYOUT_NORMAL,
+	vkMeshLoader::VERTEX_LAYOUT_TANGENT> VertexFormat;
+
+// Bounding spheres culled per iteration, about the number of meshes in a large scene
+#define BENCH_SPHERE_COUNT 16384
+// Jobs added per iteration of the thread pool's throughput benchmark
+#define BENCH_JOB_COUNT 4096
+
+VkPhysicalDeviceFeatures getEnabledFeatures()
+{
+	VkPhysicalDeviceFeatures enabledFeatures = {};
+	// The scene's textures are BC2, they are only loaded if the device supports it
+	enabledFeatures.textureCompressionBC = VK_TRUE;
+	return enabledFeatures;
+}
+
+// Results of the benchmarks are kept from being optimized away by adding them up
+static volatile uint32_t benchSink = 0;
+
+class VulkanSponzaBench final : public VulkanExampleBase
+{
+private:
+	struct Result
+	{
+		std::string name;
+		// What is processed by every iteration, the throughput is given in these per second
+		std::string unit;
+		double itemsPerIteration;
+		vkTools::FrameTimeStats times;
+	};
+	std::vector<Result> results;
+	std::string resultFile = "bench.json";
+
+	/**
+	* Time a function over a number of iterations, the first call isn't counted
+	*
+	* @param name Name of the benchmark in the results
+	* @param unit Items processed by every call
+	* @param itemsPerIteration Number of items processed by every call
+	* @param iterations Number of timed calls
+	* @param function Function to benchmark, gets the iteration's index
+	*/
+	template <typename Function>
+	void measure(const std::string &name, const std::string &unit, double itemsPerIteration, uint32_t iterations, Function function)
+	{
+		Result result;
+		result.name = name;
+		result.unit = unit;
+		result.itemsPerIteration = itemsPerIteration;
+		function(0);
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			auto tStart = std::chrono::high_resolution_clock::now();
+			function(i + 1);
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			result.times.add(std::chrono::duration<float, std::milli>(tEnd - tStart).count());
+		}
+		std::cout << name << ": " << result.times.getAverage() << " ms" << std::endl;
+		results.push_back(result);
+	}
+
+	static size_t fileSize(const std::string &filename)
+	{
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		return file.is_open() ? static_cast<size_t>(file.tellg()) : 0;
+	}
+
+	// Spheres spread over a box around the camera, so about a sixth of them is visible
+	void benchFrustum()
+	{
+		std::default_random_engine rndEngine(0);
+		std::uniform_real_distribution<float> rndPos(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> rndRadius(0.5f, 5.0f);
+		std::vector<glm::vec4> spheres(BENCH_SPHERE_COUNT);
+		for (auto &sphere : spheres)
+		{
+			sphere = glm::vec4(rndPos(rndEngine), rndPos(rndEngine), rndPos(rndEngine), rndRadius(rndEngine));
+		}
+		vkTools::SphereBatch batch;
+		batch.assign(spheres);
+
+		vkTools::Frustum frustum;
+		const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 1.0f, 512.0f);
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		frustum.update(projection * view);
+
+		measure("frustum.checkSphere", "spheres", BENCH_SPHERE_COUNT, 200, [&](uint32_t)
+		{
+			uint32_t visible = 0;
+			for (const auto &sphere : spheres)
+			{
+				visible += frustum.checkSphere(glm::vec3(sphere), sphere.w) ? 1 : 0;
+			}
+			benchSink += visible;
+		});
+
+		std::vector<uint32_t> visible(batch.x.size());
+		measure("frustum.cullSpheres", "spheres", BENCH_SPHERE_COUNT, 200, [&](uint32_t)
+		{
+			benchSink += frustum.cullSpheres(batch, 0, batch.count, visible.data());
+		});
+	}
+
+	// Loads the scene's mesh once, the interleaving writes into host visible buffers so no transfers are timed
+	void benchMeshes()
+	{
+		const std::string filename = getAssetPath() + "sponza_pbr.obj";
+		VulkanMeshLoader *mesh = nullptr;
+		size_t vertexCount = 0;
+		measure("mesh.load", "bytes", static_cast<double>(fileSize(filename)), 3, [&](uint32_t)
+		{
+			delete mesh;
+			mesh = new VulkanMeshLoader(vulkanDevice);
+			bool loaded = mesh->LoadMesh(filename);
+			assert(loaded);
+		});
+		for (const auto &entry : mesh->m_Entries)
+		{
+			vertexCount += entry.Vertices.size();
+		}
+
+		vkMeshLoader::MeshCreateInfo createInfo;
+		createInfo.center = glm::vec3(0.0f);
+		createInfo.scale = glm::vec3(1.0f);
+		createInfo.uvscale = glm::vec2(1.0f);
+		measure("mesh.createBuffers", "vertices", static_cast<double>(vertexCount), 20, [&](uint32_t)
+		{
+			vkMeshLoader::MeshBuffer meshBuffer;
+			mesh->createBuffers(&meshBuffer, VertexFormat(), &createInfo, false, VK_NULL_HANDLE, VK_NULL_HANDLE);
+			vkMeshLoader::freeMeshBufferResources(device, &meshBuffer);
+		});
+
+		// Same components, interleaved by walking the layout at runtime
+		const std::vector<vkMeshLoader::VertexLayout> layout = {
+			vkMeshLoader::VERTEX_LAYOUT_POSITION,
+			vkMeshLoader::VERTEX_LAYOUT_UV,
+			vkMeshLoader::VERTEX_LAYOUT_COLOR,
+			vkMeshLoader::VERTEX_LAYOUT_NORMAL,
+			vkMeshLoader::VERTEX_LAYOUT_TANGENT,
+		};
+		measure("mesh.createBuffers.layout", "vertices", static_cast<double>(vertexCount), 20, [&](uint32_t)
+		{
+			vkMeshLoader::MeshBuffer meshBuffer;
+			mesh->createBuffers(&meshBuffer, layout, &createInfo, false, VK_NULL_HANDLE, VK_NULL_HANDLE);
+			vkMeshLoader::freeMeshBufferResources(device, &meshBuffer);
+		});
+		delete mesh;
+	}
+
+	void benchThreadPool()
+	{
+		vkTools::ThreadPool threadPool;
+		const uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+		threadPool.setThreadCount(threadCount);
+		std::vector<uint32_t> counts(threadCount);
+
+		// Small jobs spread over all threads, mostly measures the cost of queueing and running them
+		measure("threadpool.throughput", "jobs", BENCH_JOB_COUNT, 100, [&](uint32_t)
+		{
+			for (uint32_t i = 0; i < BENCH_JOB_COUNT; i++)
+			{
+				uint32_t *count = &counts[i % threadCount];
+				threadPool.threads[i % threadCount]->addJob([count] { (*count)++; });
+			}
+			threadPool.wait();
+		});
+
+		// Round trip of a single job from submission until the waiting thread has seen it finish
+		measure("threadpool.latency", "jobs", 1, 1000, [&](uint32_t)
+		{
+			threadPool.threads[0]->addJob([&counts] { counts[0]++; });
+			threadPool.threads[0]->wait();
+		});
+
+		for (auto count : counts)
+		{
+			benchSink += count;
+		}
+	}
+
+	// Like the renderer's overlay, most lines stay the same and a few change every update
+	void benchTextOverlay()
+	{
+		const std::vector<std::string> staticLines = {
+			title,
+			deviceProperties.deviceName,
+			"Press \"1\" to toggle the debug display",
+			"Press \"p\" to pause the simulation",
+		};
+		const uint32_t lineCount = static_cast<uint32_t>(staticLines.size()) + 4;
+		measure("textoverlay.addText", "lines", lineCount, 1000, [&](uint32_t iteration)
+		{
+			textOverlay->beginTextUpdate();
+			float y = 5.0f;
+			for (const auto &line : staticLines)
+			{
+				textOverlay->addText(line, 5.0f, y, VulkanTextOverlay::alignLeft);
+				y += 20.0f;
+			}
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				textOverlay->addText(std::to_string(iteration * 4 + i) + " ms", 5.0f, y, VulkanTextOverlay::alignLeft);
+				y += 20.0f;
+			}
+			textOverlay->endTextUpdate();
+		});
+	}
+
+	// Texture uploads include the file reads, the throughput is given in bytes of the files
+	void benchTextures()
+	{
+		const std::string textureArray = getAssetPath() + "textures/particle_fire.ktx";
+		std::vector<std::string> textures = {
+			getAssetPath() + "textures/particle_smoke.ktx",
+			getAssetPath() + "textures/skysphere_night.ktx",
+		};
+		std::vector<std::string> compressedTextures;
+		if (vulkanDevice->enabledFeatures.textureCompressionBC)
+		{
+			compressedTextures = {
+				getAssetPath() + "sponza/background.dds",
+				getAssetPath() + "sponza/lion.dds",
+				getAssetPath() + "sponza/chain_texture.dds",
+			};
+		}
+		else
+		{
+			std::cout << "BC compressed textures not supported, skipping the scene's textures" << std::endl;
+		}
+
+		size_t bytes = fileSize(textureArray);
+		for (const auto &filename : textures)
+		{
+			bytes += fileSize(filename);
+		}
+		for (const auto &filename : compressedTextures)
+		{
+			bytes += fileSize(filename);
+		}
+
+		measure("texture.load", "bytes", static_cast<double>(bytes), 10, [&](uint32_t)
+		{
+			vkTools::VulkanTexture texture;
+			for (const auto &filename : textures)
+			{
+				textureLoader->loadTexture(filename, VK_FORMAT_R8G8B8A8_UNORM, &texture);
+				textureLoader->destroyTexture(texture);
+			}
+			for (const auto &filename : compressedTextures)
+			{
+				textureLoader->loadTexture(filename, VK_FORMAT_BC2_UNORM_BLOCK, &texture);
+				textureLoader->destroyTexture(texture);
+			}
+			textureLoader->loadTextureArray(textureArray, VK_FORMAT_R8G8B8A8_UNORM, &texture);
+			textureLoader->destroyTexture(texture);
+		});
+	}
+
+	void writeResults()
+	{
+		auto jsonString = [](const std::string &s)
+		{
+			std::string escaped = "\"";
+			for (char c : s)
+			{
+				if ((c == '"') || (c == '\\'))
+				{
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped + "\"";
+		};
+
+		std::ofstream file(resultFile, std::ios::out | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "Could not write benchmark results to \"" << resultFile << "\"" << std::endl;
+			return;
+		}
+
+		file << std::fixed << std::setprecision(4);
+		file << "{" << std::endl;
+		file << "\t\"device\": " << jsonString(deviceProperties.deviceName) << "," << std::endl;
+		file << "\t\"threads\": " << std::thread::hardware_concurrency() << "," << std::endl;
+		file << "\t\"benchmarks\": {" << std::endl;
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			Result &result = results[i];
+			const float avg = result.times.getAverage();
+			file << "\t\t" << jsonString(result.name) << ": {" << std::endl;
+			file << "\t\t\t\"iterations\": " << result.times.getCount() << "," << std::endl;
+			file << "\t\t\t\"min\": " << result.times.getMin() << "," << std::endl;
+			file << "\t\t\t\"avg\": " << avg << "," << std::endl;
+			file << "\t\t\t\"p95\": " << result.times.getPercentile(95.0f) << "," << std::endl;
+			file << "\t\t\t\"max\": " << result.times.getMax() << "," << std::endl;
+			file << "\t\t\t\"unit\": " << jsonString(result.unit) << "," << std::endl;
+			file << "\t\t\t\"perSecond\": " << ((avg > 0.0f) ? result.itemsPerIteration * 1000.0 / avg : 0.0) << std::endl;
+			file << "\t\t}" << ((i + 1 < results.size()) ? "," : "") << std::endl;
+		}
+		file << "\t}" << std::endl;
+		file << "}" << std::endl;
+		std::cout << "Benchmark results written to \"" << resultFile << "\"" << std::endl;
+	}
+
+public:
+	VulkanSponzaBench() : VulkanExampleBase(false, getEnabledFeatures)
+	{
+		enableTextOverlay = true;
+		title = "Vulkan Sponza - Micro benchmarks";
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			if ((std::string(args[i]) == "-benchresult") && (i + 1 < args.size()))
+			{
+				resultFile = args[++i];
+			}
+		}
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		benchFrustum();
+		benchMeshes();
+		benchThreadPool();
+		benchTextOverlay();
+		benchTextures();
+		writeResults();
+	}
+
+	// Nothing is rendered, the benchmarks run in prepare
+	void render() {}
+};
+
+int main(const int argc, const char *argv[])
+{
+	for (int i = 0; i < argc; i++)
+	{
+		VulkanSponzaBench::args.push_back(argv[i]);
+	}
+	// The benchmarks don't need a window
+	VulkanSponzaBench::args.push_back("-headless");
+	VulkanSponzaBench *bench = new VulkanSponzaBench();
+	bench->initSwapchain();
+	bench->prepare();
+	delete bench;
+	return 0;
+}
@@ -6,8 +6,12 @@ layout (binding = 0) uniform sampler2D samplerFont;
 
 layout (location = 0) out vec4 outFragColor;
 
+// Signed distance to the glyph's edge, at 0.5 with positive distances inside (see VulkanTextOverlay::generateDistanceFieldAtlas)
 void main(void)
 {
-	float color = texture(samplerFont, inUV).r;
+	float distance = texture(samplerFont, inUV).r;
+	// The edge is antialiased over about a pixel at any size
+	float width = max(fwidth(distance) * 0.5, 1.0 / 255.0);
+	float color = smoothstep(0.5 - width, 0.5 + width, distance);
 	outFragColor = vec4(vec3(color), 1.0);
 }
@@ -1,7 +1,31 @@
 #version 450 core
 
+// One instance per glyph, drawn as a four vertex triangle strip
 layout (location = 0) in vec2 inPos;
-layout (location = 1) in vec2 inUV;
+layout (location = 1) in uint inGlyph;
+// Size relative to the font's
+layout (location = 2) in float inScale;
+
+struct Glyph
+{
+	// Quad corners in font pixels relative to the pen position
+	vec4 rect;
+	vec4 uv;
+};
+
+layout (binding = 1) uniform UBO 
+{
+	// STB_NUM_CHARS of the font
+	Glyph glyphs[224];
+} ubo;
+
+layout (push_constant) uniform PushConsts 
+{
+	// Size of a font pixel in normalized device coordinates
+	vec2 charScale;
+	// Rotation of a pre-rotated swap chain's images
+	mat2 preRotation;
+} pushConsts;
 
 layout (location = 0) out vec2 outUV;
 
@@ -12,6 +36,8 @@ out gl_PerVertex
 
 void main(void)
 {
-	gl_Position = vec4(inPos, 0.0, 1.0);
-	outUV = inUV;
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	Glyph glyph = ubo.glyphs[inGlyph];
+	gl_Position = vec4(pushConsts.preRotation * (inPos + mix(glyph.rect.xy, glyph.rect.zw, corner) * pushConsts.charScale * inScale), 0.0, 1.0);
+	outUV = mix(glyph.uv.xy, glyph.uv.zw, corner);
 }
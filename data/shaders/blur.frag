@@ -4,25 +4,60 @@
 #extension GL_ARB_shading_language_420pack : enable
 
 layout (binding = 0) uniform sampler2D samplerSSAO;
+layout (binding = 1) uniform sampler2D samplerPositionDepth;
+
+layout (binding = 2) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec2 viewportDim;
+	// Part of the G-Buffer and occlusion targets covered by the screen with dynamic resolution
+	vec2 renderScale;
+} ubo;
+
+// Separable blur, run once horizontally and once vertically
+layout (constant_id = 0) const int BLUR_HORIZONTAL = 1;
+// Linear depth is stored in the first channel of the compact G-Buffer
+layout (constant_id = 1) const int COMPACT_GBUFFER = 0;
 
 layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out float outFragColor;
 
+// Higher values keep depth edges sharper
+#define DEPTH_SHARPNESS 32.0
+#define EPS 0.0001
+
+float linearDepth(vec2 uv)
+{
+	vec4 positionDepth = texture(samplerPositionDepth, uv);
+	return (COMPACT_GBUFFER == 1) ? positionDepth.r : positionDepth.w;
+}
+
 void main() 
 {
-	const int blurRange = 2;
-	int n = 0;
+	const int blurRange = 4;
+	const float sigma = float(blurRange) * 0.5;
 	vec2 texelSize = 1.0 / vec2(textureSize(samplerSSAO, 0));
+	vec2 direction = (BLUR_HORIZONTAL == 1) ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);
+
+	// Taps are clamped to the rendered part of the targets
+	vec2 uvMax = ubo.renderScale - texelSize * 0.5;
+	vec2 centerUV = inUV * ubo.renderScale;
+	float centerDepth = linearDepth(centerUV);
+
 	float result = 0.0;
-	for (int x = -blurRange; x < blurRange; x++) 
+	float weightSum = 0.0;
+	for (int i = -blurRange; i <= blurRange; i++) 
 	{
-		for (int y = -blurRange; y < blurRange; y++) 
-		{
-			vec2 offset = vec2(float(x), float(y)) * texelSize;
-			result += texture(samplerSSAO, inUV + offset).r;
-			n++;
-		}
+		vec2 uv = min(centerUV + direction * float(i), uvMax);
+		// Bilateral weight: gaussian falloff, damped by the relative depth difference
+		float sampleDepth = linearDepth(uv);
+		float depthDelta = abs(centerDepth - sampleDepth) / max(centerDepth, EPS);
+		float weight = exp(-float(i * i) / (2.0 * sigma * sigma)) * exp(-depthDelta * DEPTH_SHARPNESS);
+		result += texture(samplerSSAO, uv).r * weight;
+		weightSum += weight;
 	}
-	outFragColor = result / (float(n));
+	outFragColor = result / max(weightSum, EPS);
 }
\ No newline at end of file
@@ -3,227 +3,1156 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
+// Compiled with SUBPASS_INPUT defined for the composition subpass of the merged render pass
+// The G-Buffer is then read from the previous subpass at the current fragment
+// Compiled with LIGHT_VOLUME defined for the spot light volumes, which only add the light of their spot light
+// Compiled with HALF_PRECISION defined for the relaxed precision variant, see the h* types below
+// Compiled with FORWARD defined for the Forward+ shading of the scene's meshes, see forward.frag.spv
+// The surface is then read from the material textures like in mrt.frag and the lighting bindings move to the third set
+// Compiled with SHADING_RATE defined for the composition reading the blocks of coarse tiles from the coarse pass, see shadingrate.comp
+// Compiled with COARSE_SHADING defined for that pass, which lights one pixel per block of the coarse tiles into a half resolution target
+// Compiled with REFLECTIONS defined (also together with the two above) for the variants blending in the screen space reflections of ssr.comp
+// Compiled with VOLUMETRIC_FOG defined (also together with SHADING_RATE and REFLECTIONS) for the variants applying the fog of volumetricintegrate.comp
+// Compiled as a compute shader with TILED_COMPUTE defined (also together with REFLECTIONS, VOLUMETRIC_FOG and HALF_PRECISION) for the tiled composition
+// Each work group lights a tile of the screen, culls the point lights against the tile's depth range into shared memory and writes the HDR scene color
+#ifdef FORWARD
+#define COMPOSITION_SET 2
+#else
+#define COMPOSITION_SET 0
+#endif
+
+#if defined(SUBPASS_INPUT)
+layout (input_attachment_index = 0, binding = 1) uniform subpassInput inputPosition;
+layout (input_attachment_index = 1, binding = 2) uniform subpassInput inputNormal;
+layout (input_attachment_index = 2, binding = 3) uniform usubpassInput inputAlbedo;
+#elif !defined(FORWARD)
 layout (binding = 1) uniform sampler2D samplerPosition;
 layout (binding = 2) uniform sampler2D samplerNormal;
 layout (binding = 3) uniform usampler2D samplerAlbedo;
+#endif
 
 layout (constant_id = 0) const int SSAO_ENABLED = 1;
+// Scale of the image based ambient lighting
 layout (constant_id = 1) const float AMBIENT_FACTOR = 0.0;
+// Compact G-Buffer: linear depth, octahedral normals and 8 bit albedo, roughness and metalness
+layout (constant_id = 2) const int COMPACT_GBUFFER = 0;
+// Number of shadow map fetches per axis, each fetch compares and filters 2x2 texels in hardware
+layout (constant_id = 3) const int SHADOW_PCF_SIZE = 2;
+// Size of a shadow map texel in texture coordinates (1 / 2048)
+layout (constant_id = 4) const float SHADOW_TEXEL_SIZE = 0.00048828125;
+// Spot lights are drawn as light volumes and skipped by the full screen composition
+layout (constant_id = 5) const int SPOT_LIGHT_VOLUMES = 0;
+// Only output the unlit sky color, used for the pixels the G-Buffer subpass didn't mark as geometry in the stencil buffer
+layout (constant_id = 6) const int SKY_ONLY = 0;
+// Spot lights and cascades are filtered from exponential variance shadow maps with a single fetch instead of the PCF kernel
+layout (constant_id = 7) const int SHADOW_MOMENTS = 0;
+#ifdef FORWARD
+// Discard by alpha for transparent objects, see mrt.frag
+layout (constant_id = 8) const int ENABLE_DISCARD = 0;
+const int TRACED_SHADOWS = 0;
+#else
+// Spot lights and the sun are shadowed by the rays of shadowrays.comp instead of the shadow maps
+layout (constant_id = 8) const int TRACED_SHADOWS = 0;
+// Decals of the fragment's light cluster are stamped onto the surface before it's lit, not in the composition subpass
+layout (constant_id = 9) const int DECALS = 0;
+#endif
+
+#ifdef LIGHT_VOLUME
+layout (location = 0) in vec4 inClipPos;
+layout (location = 1) flat in int inLightIndex;
+// Screen coordinates of the fragment, rebuilt from the clip space position of the volume
+vec2 inUV;
+#elif defined(FORWARD)
+// Outputs of mrt.vert
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inTexCoord;
+layout (location = 3) in vec3 inWorldPos;
+layout (location = 4) in vec3 inTangent;
+// Screen coordinates of the fragment, taken from its window position
+vec2 inUV;
+
+#ifdef BINDLESS_MATERIALS
+// Must match SCENE_MAX_MATERIAL_TEXTURES
+#define MAX_MATERIAL_TEXTURES 256
+
+struct Material
+{
+	uint diffuse;
+	uint roughness;
+	uint normal;
+	uint metaliness;
+};
+
+layout (binding = 1) uniform sampler samplerMaterial;
+layout (binding = 2) uniform texture2D materialTextures[MAX_MATERIAL_TEXTURES];
+layout (binding = 3, std430) readonly buffer MaterialTable
+{
+	Material materials[];
+};
+
+layout (location = 6) flat in uint inMaterial;
 
+#define samplerColor sampler2D(materialTextures[materials[inMaterial].diffuse], samplerMaterial)
+#define samplerRoughness sampler2D(materialTextures[materials[inMaterial].roughness], samplerMaterial)
+#define samplerNormal sampler2D(materialTextures[materials[inMaterial].normal], samplerMaterial)
+#define samplerMetaliness sampler2D(materialTextures[materials[inMaterial].metaliness], samplerMaterial)
+#else
+layout (binding = 1) uniform sampler2D samplerColor;
+layout (binding = 2) uniform sampler2D samplerRoughness;
+layout (binding = 3) uniform sampler2D samplerNormal;
+layout (binding = 4) uniform sampler2D samplerMetaliness;
+#endif
+
+// Per draw data of the batch, see SceneDrawData
+layout (set = 1, binding = 0) uniform DrawData
+{
+	vec4 colorFactor;
+	vec4 materialFactors;
+} drawData;
+#elif defined(COARSE_SHADING)
+// Screen coordinates of the first pixel of the fragment's block
+vec2 inUV;
+#elif defined(TILED_COMPUTE)
+// Screen coordinates of the invocation's pixel
+vec2 inUV;
+#else
 layout (location = 0) in vec2 inUV;
+#endif
+
+#ifdef TILED_COMPUTE
+// Must match TILED_COMPOSITION_TILE_SIZE
+#define TILE_SIZE 16
+// Must match MAX_LIGHTS_PER_CLUSTER, a tile's depth range is usually shorter than a cluster's
+#define MAX_LIGHTS_PER_TILE 64
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+// HDR scene color, each invocation writes its pixel
+layout (binding = 18, rgba16f) uniform writeonly image2D outputColor;
+
+layout (push_constant) uniform PushConstants
+{
+	// Size of the composition in pixels
+	uvec2 extent;
+} pushConstants;
 
+// Written by the shading instead of a fragment output and stored by main
+vec4 outFragcolor;
+#else
 layout (location = 0) out vec4 outFragcolor;
+#endif
 
 struct Light {
 	vec4 position;
 	vec4 dir;
 	vec4 color;
-	vec4 lightParams; // x - light type, y - radius for point lights, cone sector for spot lights
+	vec4 lightParams; // x - light type, y - radius for point lights, range for spot lights, z/w - cosine of the inner and outer cone angle for spot lights
 	mat4 lightSpace;
+	vec4 atlasRect; // xy - offset, zw - scale of the light's tile in the shadow atlas
 };
 
-#define NUM_LIGHTS 3
+#define SHADOW_LIGHT_COUNT 3
+#define SHADOW_CASCADE_COUNT 4
 
-layout (binding = 4) uniform UBO 
+layout (set = COMPOSITION_SET, binding = 4) uniform UBO 
 {
-	Light lights[NUM_LIGHTS];
+	Light lights[SHADOW_LIGHT_COUNT];
 	vec4 viewPos;
 	mat4 view;
 	mat4 model;
+	mat4 projection;
+	// Inverse of view * model, used to rebuild world space positions from depth
+	mat4 inverseView;
+	// x - near, y - far, z - slices per log unit of depth
+	vec4 clusterDepthRange;
+	uint pointLightCount;
+	uint sunEnabled;
+	// Set if the shading rates written by the previous frame can be used
+	uint coarseShading;
+	// Set if this frame's screen space reflections have been traced
+	uint reflections;
+	// xyz - direction the sun light travels in
+	vec4 sunDirection;
+	// rgb - color, a - intensity
+	vec4 sunColor;
+	// View space depth at which each cascade ends
+	vec4 cascadeSplits;
+	mat4 cascadeViewProj[SHADOW_CASCADE_COUNT];
+	// Part of the G-Buffer covered by the screen with dynamic resolution
+	vec2 renderScale;
+	// Size of the rendered part in pixels
+	vec2 renderExtent;
+	// Point light shadowed by each slot of the point shadow maps, -1 if the slot isn't in use
+	ivec4 pointShadowLights;
+	// x - near, y - slices per log unit of depth of the fog's froxels, z - set if this frame's fog has been integrated
+	vec4 fogDepthRange;
+	// Prepared once per frame on the CPU, so the lights aren't transformed for every pixel
+	// View * model
+	mat4 modelView;
+	// Camera position in view space
+	vec4 cameraViewPos;
+	// Direction towards the sun in view space
+	vec4 sunViewDirection;
+	// View space position of each shadow slot's light and the direction from its target towards it
+	vec4 lightViewPositions[SHADOW_LIGHT_COUNT];
+	vec4 lightViewDirections[SHADOW_LIGHT_COUNT];
+	// Shadow slots of the visible shadowed lights, in the order of the light index array
+	ivec4 lightOrder;
+	// x - number of visible shadowed spot lights, y - number of visible spot lights in the light index array
+	uvec4 lightRanges;
+	// xyz - world space position of the first probe of the irradiance volume, w - set if the probes have been baked
+	vec4 irradianceVolumeOrigin;
+	// xyz - probes per unit of distance, w - distance surfaces are moved along their normal before the lookup
+	vec4 irradianceVolumeScale;
 } ubo;
 
-// TODO: texture array or deffered shadows
-layout (binding = 5) uniform sampler2D samplerShadowMapLight0;
-layout (binding = 6) uniform sampler2D samplerShadowMapLight1;
-layout (binding = 7) uniform sampler2D samplerShadowMapLight2;
+// The spot lights' atlas followed by the sun's cascades
+// The sampler compares against the stored depth, a fetch returns the filtered share of lit texels
+layout (set = COMPOSITION_SET, binding = 5) uniform sampler2DArrayShadow samplerShadowMap;
+
+// Blurred and mipmapped moments of the shadow map layers, written by shadowfilter.comp
+layout (set = COMPOSITION_SET, binding = 12) uniform sampler2DArray samplerShadowMoments;
+// Must match EVSM_EXPONENTS in shadowfilter.comp
+#define EVSM_EXPONENTS vec2(5.54, 5.54)
+#define EVSM_MIN_VARIANCE 0.0001
+// Share of the upper bound cut off to reduce light bleeding at overlapping occluders
+#define EVSM_BLEED_REDUCTION 0.3
+
+// Blurred half resolution ambient occlusion
+// Not available in the composition subpass, as it needs to sample the stored G-Buffer, nor in the forward pass that has no G-Buffer
+#if !defined(SUBPASS_INPUT) && !defined(FORWARD)
+layout (binding = 6) uniform sampler2D samplerSSAO;
+#endif
+
+#if defined(SHADING_RATE) || defined(COARSE_SHADING)
+// Rate of each tile of the G-Buffer picked by shadingrate.comp, 0 - every pixel, 1 - per 2x2 block, 2 - per 4x4 block
+layout (binding = 13) uniform usampler2D samplerShadingRate;
+// Must match SHADING_RATE_TILE_SIZE
+#define SHADING_RATE_TILE 8
+#endif
+#ifdef SHADING_RATE
+// Lit blocks of the coarse tiles, one texel per 2x2 G-Buffer pixels
+layout (binding = 14) uniform sampler2D samplerCoarseShading;
+// Pixels whose depth differs by more than this share from their block's first pixel are lit by themselves
+#define COARSE_DEPTH_TOLERANCE 0.02
+#endif
+
+#ifdef REFLECTIONS
+// Half resolution screen space reflections, one texel per 2x2 G-Buffer pixels
+// rgb - reflected light weighted by a, a - share of the prefiltered sky it replaces
+layout (binding = 15) uniform sampler2D samplerReflections;
+#endif
+
+#ifdef VOLUMETRIC_FOG
+// Froxels of the view frustum, light scattered towards the camera (rgb) and transmittance (a) up to the far side of each depth slice
+layout (binding = 16) uniform sampler3D samplerVolumetricFog;
+#endif
+
+// Half resolution traced shadows, one texel per 2x2 G-Buffer pixels
+// rgb - visibility of the spot lights, a - visibility of the sun
+#if !defined(SUBPASS_INPUT) && !defined(FORWARD)
+layout (binding = 19) uniform sampler2D samplerShadowRays;
+// Texels whose depth differs by more than this share from the pixel's barely contribute to its upsampled visibility
+#define TRACED_SHADOW_DEPTH_TOLERANCE 0.02
+#endif
+// Upsampled visibility of the pixel, set by main with traced shadows
+vec4 tracedVisibility = vec4(1.0);
+
+// Point lights, binned into view space clusters by the light culling compute shader
+#define LIGHT_CLUSTER_X 16
+#define LIGHT_CLUSTER_Y 9
+#define LIGHT_CLUSTER_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z)
+#define MAX_LIGHTS_PER_CLUSTER 64
+
+struct PointLight {
+	vec4 position;	// xyz - world position, w - radius
+	vec4 color;		// rgb - color, a - intensity
+};
+
+layout (set = COMPOSITION_SET, binding = 7, std430) readonly buffer PointLights
+{
+	PointLight pointLights[];
+};
+
+layout (set = COMPOSITION_SET, binding = 8, std430) readonly buffer LightClusters
+{
+	uint clusterLightCounts[LIGHT_CLUSTER_COUNT];
+	uint clusterLightIndices[];
+};
+
+// Must match SpotLight, the shadowed ones are copied into the shadow slots of the uniform buffer
+struct SpotLight {
+	vec4 viewPosition;
+	vec4 viewDirection;	// From the light's target towards the light
+	vec4 color;
+	vec4 lightParams;	// Same as Light::lightParams
+	ivec4 shadow;		// x - shadow slot, -1 if the light isn't shadowed
+};
+
+layout (set = COMPOSITION_SET, binding = 22, std430) readonly buffer SpotLights
+{
+	SpotLight spotLights[];
+};
+
+// Visible spot lights, the first lightRanges.x of them have a shadow slot
+layout (set = COMPOSITION_SET, binding = 23, std430) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
+
+#if !defined(SUBPASS_INPUT) && !defined(FORWARD)
+// Decals, binned into the same clusters as the point lights, their lists follow the light lists in the cluster buffer
+// Must match MAX_DECALS_PER_CLUSTER
+#define MAX_DECALS_PER_CLUSTER 16
+#define DECAL_COUNTS_OFFSET (LIGHT_CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER)
+#define DECAL_INDICES_OFFSET (DECAL_COUNTS_OFFSET + LIGHT_CLUSTER_COUNT)
+
+// Must match Decal
+struct Decal {
+	mat4 worldToDecal;	// World space into the decal's box, which spans -1 to 1 on each axis
+	vec4 center;		// xyz - world space center of the box
+	vec4 extent;		// xyz - world space half size of the box's bounds
+	vec4 normal;		// xyz - world space direction the decal is projected against
+	vec4 atlasRect;		// xy - offset, zw - scale of the decal's tile in the atlas
+	vec4 params;		// x - opacity, y - roughness of the stamped surface
+};
+
+layout (binding = 20, std430) readonly buffer Decals
+{
+	// x - number of decals
+	uvec4 decalCount;
+	Decal decals[];
+};
+
+// Tiles of the decals' colors (rgb) and coverage (a), mipmapped
+layout (binding = 21) uniform sampler2D samplerDecals;
+#endif
+
+// Image based ambient lighting, convolved from the sky at load time and oriented like the sky sphere
+// Irradiance (divided by pi) for diffuse and GGX prefiltered radiance with the roughness growing with the level for specular
+layout (set = COMPOSITION_SET, binding = 9) uniform samplerCube samplerIrradiance;
+layout (set = COMPOSITION_SET, binding = 10) uniform samplerCube samplerPrefiltered;
+
+// Diffuse light baked into a grid of probes over the scene as L1 spherical harmonics, divided by pi like the sky's irradiance
+// Each channel's coefficients (L0, L1 x, y, z) fill one grid, the red, green and blue grids are stacked along z
+layout (set = COMPOSITION_SET, binding = 17) uniform sampler3D samplerIrradianceVolume;
+
+// Six faces per point light shadow slot in the order of the cube map layers, see pointshadow.geom
+// Sampled as layers of an array, so no cube map array support is needed
+layout (set = COMPOSITION_SET, binding = 11) uniform sampler2DArrayShadow samplerPointShadows;
+#define POINT_SHADOW_COUNT 4
+// Must match pointshadow.geom
+#define POINT_SHADOW_NEAR 0.05
+
+// Shading terms that tolerate half precision: normalized directions, colors, roughness and the BRDF
+// They are mediump in the HALF_PRECISION variant, which mobile GPUs evaluate in fp16
+// Positions, depths and shadow map coordinates always stay at full precision
+#ifdef HALF_PRECISION
+#define hfloat mediump float
+#define hvec2 mediump vec2
+#define hvec3 mediump vec3
+#define hvec4 mediump vec4
+#else
+#define hfloat float
+#define hvec2 vec2
+#define hvec3 vec3
+#define hvec4 vec4
+#endif
 
 #define PI 3.14159265358979f
+#ifdef HALF_PRECISION
+// Smallest normal half float is 6.1e-5
+#define EPS 0.0001f
+#else
 #define EPS 0.00000001f
+#endif
+
+// Octahedral normal decoding for the compact G-Buffer
+vec3 decodeNormal(vec2 f)
+{
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.y += (n.y >= 0.0) ? -t : t;
+	return normalize(n);
+}
+
+// Rebuild the view space position from the linear depth of the compact G-Buffer
+vec3 viewPositionFromDepth(vec2 uv, float depth)
+{
+	vec2 ndc = uv * 2.0 - 1.0;
+	// The projection's upper 2x2 also contains the pre-rotation of the swap chain
+	return vec3(inverse(mat2(ubo.projection)) * ndc * depth, -depth);
+}
 
-float DTerm_GGX(float roughness, float NdotH)
+hfloat DTerm_GGX(hfloat roughness, hfloat NdotH)
 {
+#ifdef HALF_PRECISION
+	// v * v underflows in fp16 for smooth surfaces, so the division is split up and roughness is kept above the underflow
+	hfloat roughness2 = max(roughness * roughness, 0.002);
+	hfloat v = (NdotH * NdotH * (roughness2 - 1) + 1);
+	hfloat a = roughness2 / v;
+	return a * a / (PI * roughness2);
+#else
 	float roughness2 = roughness * roughness;
 	float v = (NdotH * NdotH * (roughness2 - 1) + 1);
 	return roughness2 / (PI * v * v);
+#endif
 }
 
-float G1(vec3 n, vec3 v, float k)
+hfloat G1(hvec3 n, hvec3 v, hfloat k)
 {
-	const float NdotV = clamp(dot(n, v), 0.f, 1.f);
+	const hfloat NdotV = clamp(dot(n, v), 0.f, 1.f);
 	return NdotV / (NdotV * (1 - k) + k);
 }
 
-float GTerm(float roughness, vec3 n, vec3 v, vec3 l)
+hfloat GTerm(hfloat roughness, hvec3 n, hvec3 v, hvec3 l)
 {
-	const float t = roughness + 1;
-	const float k = t * t / 8.f;
+	const hfloat t = roughness + 1;
+	const hfloat k = t * t / 8.f;
 
 	return G1(n, v, k) * G1(n, l, k);
 }
 
-float FTerm(float F0, vec3 v, vec3 h)
+hfloat FTerm(hfloat F0, hvec3 v, hvec3 h)
 {
-	const float VdotH = clamp(dot(v, h), 0.f, 1.f);
-	float p = (-5.55473 * VdotH - 6.98316) * VdotH;
+	const hfloat VdotH = clamp(dot(v, h), 0.f, 1.f);
+	hfloat p = (-5.55473 * VdotH - 6.98316) * VdotH;
 
 	return F0 + (1 - F0) * pow(2.f, p);
 }
 
 // Schlick approximation
-vec3 FTerm(vec3 specularColor, vec3 h, vec3 v)
+hvec3 FTerm(hvec3 specularColor, hvec3 h, hvec3 v)
 {
-	const float VdotH = clamp(dot(v, h), 0.f, 1.f);
+	const hfloat VdotH = clamp(dot(v, h), 0.f, 1.f);
     return (specularColor + (1.0f - specularColor) * pow(1.0f - VdotH, 5));
 }
 
-float textureProj(int lightIdx, vec4 P, vec2 offset)
+// Cook-Torrance, GGX distribution, Schlick Fresnel approximation
+hvec3 BRDF(hvec3 N, hvec3 V, hvec3 L, hfloat NdotV, hfloat roughness, hvec3 realSpecularColor, hvec3 realAlbedo)
+{
+	hvec3 H = normalize(L + N);
+	hfloat NdotH = clamp(dot(N, H), 0.f, 1.f);
+	hfloat NdotL = clamp(dot(N, L), 0.f, 1.f);
+
+	hfloat 	Dterm = DTerm_GGX(roughness, NdotH);
+	hfloat 	Gterm = GTerm(roughness, N, V, L);
+	hvec3	Fterm = FTerm(realSpecularColor, H, V);
+	hvec3 diffuse = NdotL * realAlbedo;
+	hvec3 specular = ( Dterm * Gterm * Fterm ) / (4.0f * NdotL * NdotV + EPS);
+	return diffuse + specular;
+}
+
+// Index of the light cluster containing the fragment
+uint lightCluster(vec2 uv, float depth)
+{
+	uvec2 tile = min(uvec2(uv * vec2(LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y)), uvec2(LIGHT_CLUSTER_X - 1, LIGHT_CLUSTER_Y - 1));
+	float slice = log(max(depth, ubo.clusterDepthRange.x) / ubo.clusterDepthRange.x) * ubo.clusterDepthRange.z;
+	uint z = min(uint(slice), uint(LIGHT_CLUSTER_Z - 1));
+	return tile.x + (tile.y + z * LIGHT_CLUSTER_Y) * LIGHT_CLUSTER_X;
+}
+
+#if !defined(SUBPASS_INPUT) && !defined(FORWARD)
+// Blend the decals of the fragment's cluster into its color and roughness in the order of their indices
+// They fade out on surfaces turning away from them and towards the ends of their box along the projection
+void applyDecals(vec2 uv, vec3 wPos, float depth, hvec3 normal, inout hvec4 color, inout hfloat roughness)
+{
+	uint cluster = lightCluster(uv, depth);
+	uint count = clusterLightIndices[DECAL_COUNTS_OFFSET + cluster];
+	// Size of a pixel in world units at this depth selects the atlas level, the tiled composition has no derivatives
+	float pixelSize = 2.0 * depth / (length(ubo.projection[1].xy) * ubo.renderExtent.y);
+	vec2 atlasSize = vec2(textureSize(samplerDecals, 0));
+	for (uint i = 0; i < count; ++i)
+	{
+		Decal decal = decals[clusterLightIndices[DECAL_INDICES_OFFSET + cluster * MAX_DECALS_PER_CLUSTER + i]];
+		vec3 p = (decal.worldToDecal * vec4(wPos, 1.0)).xyz;
+		hfloat facing = dot(normal, normalize(mat3(ubo.modelView) * decal.normal.xyz));
+		if (any(greaterThan(abs(p), vec3(1.0))) || (facing <= 0.0))
+		{
+			continue;
+		}
+		vec2 atlasUV = decal.atlasRect.xy + (p.xy * 0.5 + 0.5) * decal.atlasRect.zw;
+		// Texels of the tile per world unit along the box's x axis
+		float texelsPerUnit = length(vec3(decal.worldToDecal[0].x, decal.worldToDecal[1].x, decal.worldToDecal[2].x)) * 0.5 * decal.atlasRect.z * atlasSize.x;
+		hvec4 texel = textureLod(samplerDecals, atlasUV, log2(max(pixelSize * texelsPerUnit, 1.0)));
+		hfloat alpha = texel.a * decal.params.x * smoothstep(0.0, 0.5, facing) * (1.0 - smoothstep(0.75, 1.0, abs(p.z)));
+		color.rgb = mix(color.rgb, texel.rgb, alpha);
+		roughness = mix(roughness, decal.params.y, alpha);
+	}
+}
+#endif
+
+float textureProj(int layer, vec4 shadowCoord, vec2 offset)
+{
+	float lit = texture(samplerShadowMap, vec4(shadowCoord.st + offset, layer, shadowCoord.z));
+	return mix(0.3, 1.0, lit);
+}
+
+// The spot lights share the first layer as an atlas, rect is the offset (xy) and scale (zw) of the light's tile in it
+float filterPCF(int layer, vec4 P, vec4 rect)
 {
-	float shadow = 1.0;
 	vec4 shadowCoord = P / P.w;
 	shadowCoord.st = shadowCoord.st * 0.5 + 0.5;
-	
-	if (shadowCoord.z > -1.0 && shadowCoord.z < 1.0) 
+
+	if (shadowCoord.z <= -1.0 || shadowCoord.z >= 1.0)
 	{
-		float dist = 0.f;
+		return 1.0;
+	}
 
-		// TODO: deferred shadows or texture array?
-		switch(lightIdx)
-		{
-			case 0 : dist = texture(samplerShadowMapLight0, vec2(shadowCoord.st + offset)).r; break;
-			case 1 : dist = texture(samplerShadowMapLight1, vec2(shadowCoord.st + offset)).r; break;
-			case 2 : dist = texture(samplerShadowMapLight2, vec2(shadowCoord.st + offset)).r; break;
-		};
+	// Keep the filter's footprint inside of the tile
+	vec2 margin = vec2(float(SHADOW_PCF_SIZE) * SHADOW_TEXEL_SIZE) / rect.zw;
+	shadowCoord.st = clamp(shadowCoord.st, margin, 1.0 - margin) * rect.zw + rect.xy;
 
-		if (shadowCoord.w > 0.0 && dist < shadowCoord.z) 
+	// Fetches are two texels apart, so their 2x2 footprints don't overlap
+	float center = 0.5 * float(SHADOW_PCF_SIZE - 1);
+	float shadowFactor = 0.0;
+	for (int x = 0; x < SHADOW_PCF_SIZE; x++)
+	{
+		for (int y = 0; y < SHADOW_PCF_SIZE; y++)
 		{
-			shadow = 0.3;
+			shadowFactor += textureProj(layer, shadowCoord, (vec2(x, y) - center) * 2.0 * SHADOW_TEXEL_SIZE);
 		}
 	}
-	return shadow;
+	return shadowFactor / float(SHADOW_PCF_SIZE * SHADOW_PCF_SIZE);
 }
 
-float filterPCF(int lightIdx, vec4 sc)
+// Upper bound of the lit share from the first two moments of the occluders' warped depth
+float chebyshev(vec2 moments, float depth, float minVariance)
 {
-	ivec2 texDim = textureSize(samplerShadowMapLight0, 0).xy;
-	float scale = 1.5;
-	float dx = scale * 1.0 / float(texDim.x);
-	float dy = scale * 1.0 / float(texDim.y);
+	if (depth <= moments.x)
+	{
+		return 1.0;
+	}
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float d = depth - moments.x;
+	float lit = variance / (variance + d * d);
+	return clamp((lit - EVSM_BLEED_REDUCTION) / (1.0 - EVSM_BLEED_REDUCTION), 0.0, 1.0);
+}
 
-	float shadowFactor = 0.0;
-	int count = 0;
-	int range = 1;
-	
-	for (int x = -range; x <= range; x++)
+// Screen space derivatives of the world position, taken in main while all fragments of a quad are still active
+vec3 wPosDx;
+vec3 wPosDy;
+
+vec2 shadowMapUV(mat4 viewProj, vec3 wPos, vec4 rect)
+{
+	vec4 P = viewProj * vec4(wPos, 1.0);
+	return (P.xy / P.w * 0.5 + 0.5) * rect.zw + rect.xy;
+}
+
+// Same tiles and attenuation as filterPCF, a single trilinear fetch of the prefiltered moments
+float filterEVSM(int layer, mat4 viewProj, vec3 wPos, vec4 rect)
+{
+	vec4 shadowCoord = viewProj * vec4(wPos, 1.0);
+	shadowCoord /= shadowCoord.w;
+
+	if (shadowCoord.z <= -1.0 || shadowCoord.z >= 1.0)
+	{
+		return 1.0;
+	}
+
+	// The level is picked from the pixel's footprint in the shadow map
+	// The shorter axis is used as the footprint is stretched across depth discontinuities
+	vec2 uv = shadowMapUV(viewProj, wPos, rect);
+	vec2 uvDx = shadowMapUV(viewProj, wPos + wPosDx, rect) - uv;
+	vec2 uvDy = shadowMapUV(viewProj, wPos + wPosDy, rect) - uv;
+	float footprint = min(length(uvDx), length(uvDy)) / SHADOW_TEXEL_SIZE;
+	float lod = clamp(log2(max(footprint, 1.0)), 0.0, float(textureQueryLevels(samplerShadowMoments) - 1));
+
+	// The fetch's footprint grows with the level, it's kept inside the tile so neighbouring tiles don't bleed in
+	vec2 margin = vec2(0.5 * exp2(ceil(lod)) * SHADOW_TEXEL_SIZE);
+	uv = clamp(uv, rect.xy + margin, rect.xy + rect.zw - margin);
+	vec4 moments = textureLod(samplerShadowMoments, vec3(uv, layer), lod);
+
+	float depth = 2.0 * shadowCoord.z - 1.0;
+	vec2 warped = vec2(exp(EVSM_EXPONENTS.x * depth), -exp(-EVSM_EXPONENTS.y * depth));
+	// The minimum variance is scaled by the warp's slope, so it's about the same for all depths
+	vec2 slope = EVSM_EXPONENTS * abs(warped);
+	float positive = chebyshev(moments.xy, warped.x, EVSM_MIN_VARIANCE * slope.x * slope.x);
+	float negative = chebyshev(moments.zw, warped.y, EVSM_MIN_VARIANCE * slope.y * slope.y);
+	return mix(0.3, 1.0, min(positive, negative));
+}
+
+float filterShadow(int layer, mat4 viewProj, vec3 wPos, vec4 rect)
+{
+	return (SHADOW_MOMENTS == 1) ? filterEVSM(layer, viewProj, wPos, rect) : filterPCF(layer, viewProj * vec4(wPos, 1.0), rect);
+}
+
+// Share of a point light's light reaching the world position at lightVec from it
+// The face and its coordinates are selected like the sampling of a cube map would
+float pointShadow(int slot, vec3 lightVec, float radius)
+{
+	vec3 absVec = abs(lightVec);
+	float major;
+	vec2 st;
+	int face;
+	if ((absVec.x >= absVec.y) && (absVec.x >= absVec.z))
+	{
+		major = absVec.x;
+		face = (lightVec.x > 0.0) ? 0 : 1;
+		st = vec2((lightVec.x > 0.0) ? -lightVec.z : lightVec.z, -lightVec.y);
+	}
+	else if (absVec.y >= absVec.z)
+	{
+		major = absVec.y;
+		face = (lightVec.y > 0.0) ? 2 : 3;
+		st = vec2(lightVec.x, (lightVec.y > 0.0) ? lightVec.z : -lightVec.z);
+	}
+	else
+	{
+		major = absVec.z;
+		face = (lightVec.z > 0.0) ? 4 : 5;
+		st = vec2((lightVec.z > 0.0) ? lightVec.x : -lightVec.x, -lightVec.y);
+	}
+	// Depth of the face's projection in pointshadow.geom
+	float depth = radius / (radius - POINT_SHADOW_NEAR) * (1.0 - POINT_SHADOW_NEAR / major);
+	return texture(samplerPointShadows, vec4(st / major * 0.5 + 0.5, slot * 6 + face, depth));
+}
+
+// Light of a shadowed spot light reaching the fragment
+hvec3 spotLight(int i, vec3 wPos, vec3 fragPos, hvec3 N, hvec3 V, hfloat NdotV, hfloat roughness, hvec3 realSpecularColor, hvec3 realAlbedo)
+{
+	vec3 L = ubo.lightViewPositions[i].xyz - fragPos;
+	float dist = length(L);
+	L = L / dist;
+
+	float spotEffect = smoothstep(ubo.lights[i].lightParams.w, ubo.lights[i].lightParams.z, dot(ubo.lightViewDirections[i].xyz, L));
+	float heightAttenuation = smoothstep(ubo.lights[i].lightParams.y, 0.0f, dist);
+	float atten = spotEffect * heightAttenuation;
+
+	// Fragments outside of the cone don't need the shadow map
+	if (atten <= 0.0)
+	{
+		return vec3(0.0);
+	}
+	atten *= (TRACED_SHADOWS == 1) ? mix(0.3, 1.0, tracedVisibility[i]) : filterShadow(0, ubo.lights[i].lightSpace, wPos, ubo.lights[i].atlasRect);
+
+	return ubo.lights[i].color.rgb * atten * BRDF(N, V, L, NdotV, roughness, realSpecularColor, realAlbedo);
+}
+
+// Light of a spot light without a shadow slot reaching the fragment
+hvec3 unshadowedSpotLight(uint i, vec3 fragPos, hvec3 N, hvec3 V, hfloat NdotV, hfloat roughness, hvec3 realSpecularColor, hvec3 realAlbedo)
+{
+	vec3 L = spotLights[i].viewPosition.xyz - fragPos;
+	float dist = length(L);
+	L = L / dist;
+
+	vec4 lightParams = spotLights[i].lightParams;
+	float atten = smoothstep(lightParams.w, lightParams.z, dot(spotLights[i].viewDirection.xyz, L)) * smoothstep(lightParams.y, 0.0f, dist);
+	if (atten <= 0.0)
+	{
+		return vec3(0.0);
+	}
+	return spotLights[i].color.rgb * atten * BRDF(N, V, L, NdotV, roughness, realSpecularColor, realAlbedo);
+}
+
+#ifndef FORWARD
+// G-Buffer coordinates of the fragment, the screen is upscaled from a part of the G-Buffer with dynamic resolution
+vec2 gBufferUV;
+
+#ifdef TILED_COMPUTE
+// Fetched once by main for the tile's depth range
+vec4 pixelPosition;
+#endif
+
+vec4 gBufferPosition()
+{
+#ifdef SUBPASS_INPUT
+	return subpassLoad(inputPosition);
+#elif defined(TILED_COMPUTE)
+	return pixelPosition;
+#else
+	return texture(samplerPosition, gBufferUV);
+#endif
+}
+
+vec4 gBufferNormal()
+{
+#ifdef SUBPASS_INPUT
+	return subpassLoad(inputNormal);
+#else
+	return texture(samplerNormal, gBufferUV);
+#endif
+}
+
+uvec4 gBufferAlbedo()
+{
+#ifdef SUBPASS_INPUT
+	return subpassLoad(inputAlbedo);
+#else
+	ivec2 texDim = textureSize(samplerAlbedo, 0);
+	return texelFetch(samplerAlbedo, ivec2(gBufferUV * texDim ), 0);
+#endif
+}
+
+#ifndef SUBPASS_INPUT
+// Joint bilateral upsample of the traced shadows, the four nearest texels are weighted bilinearly and by how close the depth of their
+// G-Buffer pixel is to the pixel's depth, so shadows don't bleed across depth discontinuities
+vec4 upsampleTracedShadows(float depth)
+{
+	ivec2 maxPixel = max(ivec2(ubo.renderExtent), ivec2(1)) - 1;
+	ivec2 maxTexel = maxPixel / 2;
+	vec2 texelPos = gBufferUV * vec2(textureSize(samplerPosition, 0)) * 0.5 - 0.5;
+	ivec2 base = ivec2(floor(texelPos));
+	vec2 f = texelPos - vec2(base);
+	vec4 visibility = vec4(0.0);
+	float weightSum = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(base + offset, ivec2(0), maxTexel);
+		vec4 texelPosition = texelFetch(samplerPosition, min(texel * 2, maxPixel), 0);
+		float texelDepth = (COMPACT_GBUFFER == 1) ? texelPosition.r : texelPosition.a;
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		// A small share of the bilinear weight remains, so pixels unlike all of their texels still get their neighbourhood's visibility
+		float weight = bilinear.x * bilinear.y * (exp(-abs(depth - texelDepth) / (depth * TRACED_SHADOW_DEPTH_TOLERANCE)) + 1.0e-3);
+		visibility += texelFetch(samplerShadowRays, texel, 0) * weight;
+		weightSum += weight;
+	}
+	return visibility / max(weightSum, 1.0e-6);
+}
+#endif
+#endif
+
+// Analytic fit of the split sum's environment BRDF (Karis), saves a lookup table
+hvec3 environmentBRDF(hvec3 specularColor, hfloat roughness, hfloat NdotV)
+{
+	const hvec4 c0 = vec4(-1.0, -0.0275, -0.572, 0.022);
+	const hvec4 c1 = vec4(1.0, 0.0425, 1.04, -0.04);
+	hvec4 r = roughness * c0 + c1;
+	hfloat a004 = min(r.x * r.x, exp2(-9.28 * NdotV)) * r.x + r.y;
+	hvec2 AB = vec2(-1.04, 1.04) * a004 + r.zw;
+	return specularColor * AB.x + AB.y;
+}
+
+// Irradiance (divided by pi) from the probes around a world space position with a world space normal, negative outside of the volume
+// The lookups are clamped to the centers of each grid's outer texels, so the channels' grids don't bleed into each other
+vec3 irradianceVolume(vec3 wPos, vec3 n)
+{
+	ivec3 size = textureSize(samplerIrradianceVolume, 0);
+	vec3 probeCount = vec3(size.xy, size.z / 3);
+	// Moved off the surface, so probes behind it don't darken it as much
+	vec3 gridPos = (wPos + n * ubo.irradianceVolumeScale.w - ubo.irradianceVolumeOrigin.xyz) * ubo.irradianceVolumeScale.xyz;
+	if (any(lessThan(gridPos, vec3(0.0))) || any(greaterThan(gridPos, probeCount - 1.0)))
+	{
+		return vec3(-1.0);
+	}
+	vec3 uvw = (gridPos + 0.5) / vec3(size);
+	vec4 basis = vec4(1.0, n);
+	vec3 irradiance;
+	for (int channel = 0; channel < 3; channel++)
+	{
+		uvw.z = (float(channel) * probeCount.z + gridPos.z + 0.5) / float(size.z);
+		irradiance[channel] = dot(textureLod(samplerIrradianceVolume, uvw, 0.0), basis);
+	}
+	return max(irradiance, vec3(0.0));
+}
+
+hvec3 ambientLight(vec3 wPos, hvec3 N, hvec3 V, hfloat NdotV, hfloat roughness, hvec3 realSpecularColor, hvec3 realAlbedo)
+{
+	// Shading is done in view space, the maps are in the sky sphere's model space
+	mat3 viewToModel = mat3(ubo.inverseView);
+	vec3 n = normalize(viewToModel * N);
+	vec3 r = normalize(viewToModel * reflect(-V, N));
+	// The probes have seen the lit scene and the sky through its openings, so they aren't scaled like the sky
+	hvec3 diffuse = texture(samplerIrradiance, n).rgb * realAlbedo * AMBIENT_FACTOR;
+	if (ubo.irradianceVolumeOrigin.w == 1.0)
 	{
-		for (int y = -range; y <= range; y++)
+		vec3 irradiance = irradianceVolume(wPos, n);
+		if (irradiance.r >= 0.0)
 		{
-			shadowFactor += textureProj(lightIdx, sc, vec2(dx*x, dy*y));
-			count++;
+			diffuse = irradiance * realAlbedo;
 		}
-	
 	}
-	return shadowFactor / count;
+	float lod = roughness * float(textureQueryLevels(samplerPrefiltered) - 1);
+	hvec3 specular = textureLod(samplerPrefiltered, r, lod).rgb * AMBIENT_FACTOR;
+#ifdef REFLECTIONS
+	// The reflected scene is already lit, so it isn't scaled like the sky, where rays miss the sky remains
+	if (ubo.reflections == 1)
+	{
+		vec2 reflectionUV = gBufferUV * vec2(textureSize(samplerPosition, 0)) / (2.0 * vec2(textureSize(samplerReflections, 0)));
+		hvec4 reflection = textureLod(samplerReflections, reflectionUV, 0.0);
+		specular = specular * (1.0 - reflection.a) + reflection.rgb;
+	}
+#endif
+	return diffuse + specular * environmentBRDF(realSpecularColor, roughness, NdotV);
+}
+
+// The fog in front of a surface at the view space depth
+hvec3 applyFog(hvec3 color, vec2 uv, float depth)
+{
+#ifdef VOLUMETRIC_FOG
+	if (ubo.fogDepthRange.z == 1.0)
+	{
+		// Texel centers hold the fog up to the far side of their slice
+		float slice = log(max(depth, ubo.fogDepthRange.x) / ubo.fogDepthRange.x) * ubo.fogDepthRange.y;
+		vec4 fog = textureLod(samplerVolumetricFog, vec3(uv, (slice - 0.5) / float(textureSize(samplerVolumetricFog, 0).z)), 0.0);
+		return color * fog.a + fog.rgb;
+	}
+#endif
+	return color;
+}
+
+float ambientOcclusion()
+{
+#if defined(SUBPASS_INPUT) || defined(FORWARD)
+	return 1.0;
+#else
+	return (SSAO_ENABLED == 1) ? texture(samplerSSAO, gBufferUV).r : 1.0;
+#endif
 }
 
+#ifdef TILED_COMPUTE
+// Shared by the invocations of a tile
+shared uint tileDepthMin;
+shared uint tileDepthMax;
+shared uint tileLightCount;
+shared uint tileLightIndices[MAX_LIGHTS_PER_TILE];
+// World positions of the tile's pixels, the screen space derivatives are taken from them
+shared vec3 tileWorldPositions[TILE_SIZE][TILE_SIZE];
+
+void shadePixel()
+#else
 void main() 
+#endif
 {
+#ifdef LIGHT_VOLUME
+	inUV = inClipPos.xy / inClipPos.w * 0.5 + 0.5;
+#endif
+#ifdef COARSE_SHADING
+	// Each fragment covers a 2x2 block of the G-Buffer, of the 4x4 tiles only every second one in each direction is lit
+	ivec2 coarseTexel = ivec2(gl_FragCoord.xy);
+	ivec2 blockPixel = coarseTexel * 2;
+	uint rate = (ubo.coarseShading == 1) ? texelFetch(samplerShadingRate, blockPixel / SHADING_RATE_TILE, 0).r : 0;
+	if ((rate == 0) || ((rate == 2) && (((coarseTexel.x | coarseTexel.y) & 1) != 0)))
+	{
+		discard;
+	}
+	inUV = (vec2(blockPixel) + 0.5) / ubo.renderExtent;
+#endif
+#if !defined(SUBPASS_INPUT) && !defined(FORWARD)
+	// Clamped to the rendered texels, so filtering doesn't blend in texels outside of it
+	gBufferUV = min(inUV * ubo.renderScale, ubo.renderScale - 0.5 / vec2(textureSize(samplerPosition, 0)));
+#endif
+
 	// Get G-Buffer values
-	vec3 wPos = texture(samplerPosition, inUV).rgb;
-	vec3 fragPos = (ubo.view * ubo.model * vec4(wPos, 1.f)).rgb;
+	vec3 wPos;
+	vec3 fragPos;
+	hvec3 normal;
+	hvec4 color;
+	hfloat roughness;
+	hfloat metallic;
+
+#ifdef FORWARD
+	// The pass covers the same part of its target as the G-Buffer pass with dynamic resolution
+	inUV = gl_FragCoord.xy / ubo.renderExtent;
 
-	vec3 normal = texture(samplerNormal, inUV).rgb * 2.0 - 1.0;
+	// Surface of mrt.frag
+	color = texture(samplerColor, inTexCoord) * drawData.colorFactor;
+	if (ENABLE_DISCARD == 0)
+	{
+		hvec3 N = normalize(inNormal);
+		hvec3 T = normalize(inTangent);
+		hvec3 B = cross(N, T);
+		mat3 TBN = mat3(T, B, N);
+		// Normal maps only store x and y, see mrt.frag
+		hvec3 nm;
+		nm.xy = texture(samplerNormal, inTexCoord).xy * 2.0 - vec2(1.0);
+		nm.z = sqrt(max(1.0 - dot(nm.xy, nm.xy), 0.0));
+		normal = TBN * normalize(nm);
+	}
+	else
+	{
+		normal = normalize(inNormal);
+		if (color.a < 0.5)
+		{
+			discard;
+		}
+	}
+	roughness = texture(samplerRoughness, inTexCoord).r * drawData.materialFactors.x;
+	metallic = texture(samplerMetaliness, inTexCoord).r * drawData.materialFactors.y;
 
+	wPos = inWorldPos;
+	fragPos = (ubo.modelView * vec4(wPos, 1.f)).rgb;
+#else
 	// unpack
-	ivec2 texDim = textureSize(samplerAlbedo, 0);
-	uvec4 albedo = texelFetch(samplerAlbedo, ivec2(inUV.st * texDim ), 0);
+	uvec4 albedo = gBufferAlbedo();
 
-	vec4 color;
-	color.rg = unpackHalf2x16(albedo.r);
-	color.ba = unpackHalf2x16(albedo.g);
+	// skysphere.frag clears the position to zero, so the sky has a linear depth of zero in both G-Buffer layouts (r in the compact one, a in the full one)
+	// Sky pixels only output their color from the albedo target and skip the normal fetch and the lighting
+	// The compact layout packs the sky color into 8 bit unorm like the albedo of the scene, the full layout keeps it as half floats
+	vec4 position = (SKY_ONLY == 1) ? vec4(0.0) : gBufferPosition();
+	if ((COMPACT_GBUFFER == 1 ? position.r : position.a) == 0.0)
+	{
+#ifdef LIGHT_VOLUME
+		discard;
+#else
+		vec4 skyColor;
+		if (COMPACT_GBUFFER == 1)
+		{
+			skyColor = unpackUnorm4x8(albedo.r);
+		}
+		else
+		{
+			skyColor.rg = unpackHalf2x16(albedo.r);
+			skyColor.ba = unpackHalf2x16(albedo.g);
+		}
+		outFragcolor = vec4(applyFog(skyColor.rgb, inUV, ubo.clusterDepthRange.y), 1.0);
+		return;
+#endif
+	}
+
+#ifdef SHADING_RATE
+	// Pixels of coarse tiles take the light of their block's first pixel if it's on the same surface
+	if (ubo.coarseShading == 1)
+	{
+		ivec2 pixel = ivec2(gBufferUV * vec2(textureSize(samplerPosition, 0)));
+		uint rate = texelFetch(samplerShadingRate, pixel / SHADING_RATE_TILE, 0).r;
+		if (rate > 0)
+		{
+			ivec2 coarseTexel = (rate == 1) ? pixel / 2 : (pixel / 4) * 2;
+			vec4 blockPosition = texelFetch(samplerPosition, coarseTexel * 2, 0);
+			float depth = (COMPACT_GBUFFER == 1) ? position.r : position.a;
+			float blockDepth = (COMPACT_GBUFFER == 1) ? blockPosition.r : blockPosition.a;
+			if (abs(depth - blockDepth) < depth * COARSE_DEPTH_TOLERANCE)
+			{
+				outFragcolor = vec4(applyFog(texelFetch(samplerCoarseShading, coarseTexel, 0).rgb, inUV, depth), 1.0);
+				return;
+			}
+		}
+	}
+#endif
 
-	float roughness = unpackHalf2x16(albedo.b).r;
-	float metallic = unpackHalf2x16(albedo.a).r;
+	if (COMPACT_GBUFFER == 1)
+	{
+		float depth = position.r;
+		fragPos = viewPositionFromDepth(inUV, depth);
+		wPos = (ubo.inverseView * vec4(fragPos, 1.f)).xyz;
+		normal = decodeNormal(gBufferNormal().rg);
+
+		color = unpackUnorm4x8(albedo.r);
+		vec4 material = unpackUnorm4x8(albedo.g);
+		roughness = material.r;
+		metallic = material.g;
+	}
+	else
+	{
+		wPos = position.rgb;
+		fragPos = (ubo.modelView * vec4(wPos, 1.f)).rgb;
+		normal = gBufferNormal().rgb * 2.0 - 1.0;
+
+		color.rg = unpackHalf2x16(albedo.r);
+		color.ba = unpackHalf2x16(albedo.g);
+
+		roughness = unpackHalf2x16(albedo.b).r;
+		metallic = unpackHalf2x16(albedo.a).r;
+	}
 
-	vec3 fragcolor = vec3(0.f, 0.f, 0.f);
+#ifndef SUBPASS_INPUT
+	if (TRACED_SHADOWS == 1)
+	{
+		tracedVisibility = upsampleTracedShadows((COMPACT_GBUFFER == 1) ? position.r : position.a);
+	}
+	if (DECALS == 1)
+	{
+		applyDecals(inUV, wPos, -fragPos.z, normal, color, roughness);
+	}
+#endif
+#endif
+
+	hvec3 fragcolor = vec3(0.f, 0.f, 0.f);
+
+#ifndef TILED_COMPUTE
+	if (SHADOW_MOMENTS == 1)
+	{
+		wPosDx = dFdx(wPos);
+		wPosDy = dFdy(wPos);
+	}
+#endif
 	
 	// 0.03 - default specular value for dielectric.
-	vec3 realSpecularColor = mix( vec3(0.03f), color.rgb, metallic);
-	vec4 realAlbedo = clamp( color - color * metallic, vec4(0.f), vec4(1.0f) );
+	hvec3 realSpecularColor = mix( vec3(0.03f), color.rgb, metallic);
+	hvec4 realAlbedo = clamp( color - color * metallic, vec4(0.f), vec4(1.0f) );
 	
-	vec3 N = normalize(normal);
-	vec3 viewPos = vec3(ubo.view * ubo.model * vec4(ubo.viewPos.xyz, 1.0));
-	vec3 V = normalize(viewPos - fragPos);
+	hvec3 N = normalize(normal);
+	hvec3 V = normalize(ubo.cameraViewPos.xyz - fragPos);
 
-	fragcolor += color.rgb * 0.05f;
+#ifdef LIGHT_VOLUME
+	// Everything but the light of this volume has already been written by the composition
+	outFragcolor = vec4(spotLight(inLightIndex, wPos, fragPos, N, V, clamp(dot(N, V), 0.f, 1.f), roughness, realSpecularColor, realAlbedo.rgb), 1.0);
+	return;
+#endif
 
-	if (length(fragPos) == 0.0)
+	hfloat NdotV = clamp(dot(N, V), 0.f, 1.f);
+
+	// Ambient occlusion only attenuates the ambient term
+	hfloat ao = ambientOcclusion();
+	fragcolor += ambientLight(wPos, N, V, NdotV, roughness, realSpecularColor, realAlbedo.rgb) * ao;
+	
+	// Lights that don't reach into the view have been culled on the CPU and left out of the light index array
+	// The shadowed lights are drawn as light volumes instead if those are enabled
+	if (SPOT_LIGHT_VOLUMES == 0)
+	{
+		for (uint j = 0; j < ubo.lightRanges.x; ++j)
+		{
+			fragcolor += spotLight(spotLights[lightIndices[j]].shadow.x, wPos, fragPos, N, V, NdotV, roughness, realSpecularColor, realAlbedo.rgb);
+		}
+	}
+	for (uint j = ubo.lightRanges.x; j < ubo.lightRanges.y; ++j)
 	{
-		roughness = 0.f;
-		metallic = 0.f;
-		fragcolor = color.rgb;
+		fragcolor += unshadowedSpotLight(lightIndices[j], fragPos, N, V, NdotV, roughness, realSpecularColor, realAlbedo.rgb);
 	}
-	else
-	{	
-		float lightCosInnerAngle = cos(radians(15.0));
-		float lightCosOuterAngle = cos(radians(25.0));
-		float NdotV = clamp(dot(N, V), 0.f, 1.f);
-		
-		for(int i = 0; i < NUM_LIGHTS; ++i)
+
+	// Directional sun light, shadowed by the cascade containing the fragment
+	if (ubo.sunEnabled == 1)
+	{
+		float depth = -fragPos.z;
+		int cascade = SHADOW_CASCADE_COUNT - 1;
+		for (int i = 0; i < SHADOW_CASCADE_COUNT - 1; ++i)
 		{
-			vec3 lightPos = vec3(ubo.view * ubo.model * vec4(ubo.lights[i].position.xyz, 1.0));
-			vec3 L = lightPos - fragPos;
-			
-			float dist = length(L);
-			L = L / dist;
+			if (depth <= ubo.cascadeSplits[i])
+			{
+				cascade = i;
+				break;
+			}
+		}
 
-			vec3 H = normalize(L + N);
+		float shadowFactor = 1.0;
+		if (TRACED_SHADOWS == 1)
+		{
+			shadowFactor = mix(0.3, 1.0, tracedVisibility.a);
+		}
+		else if (depth <= ubo.cascadeSplits[SHADOW_CASCADE_COUNT - 1])
+		{
+			shadowFactor = filterShadow(1 + cascade, ubo.cascadeViewProj[cascade], wPos, vec4(0.0, 0.0, 1.0, 1.0));
+		}
 
-			float NdotH = clamp(dot(N, H), 0.f, 1.f);
-			float NdotL = clamp(dot(N, L), 0.f, 1.f);
+		hvec3 L = ubo.sunViewDirection.xyz;
+		fragcolor += ubo.sunColor.rgb * ubo.sunColor.a * shadowFactor * BRDF(N, V, L, NdotV, roughness, realSpecularColor, realAlbedo.rgb);
+	}
 
-			// TODO: optimize
-			bool isPointLight 	= ubo.lights[i].lightParams.x == 0.f;
-			float radius 		= ubo.lights[i].lightParams.y;
-			mat4 lightViewProj 	= ubo.lights[i].lightSpace;
+	// Only the point lights overlapping this fragment's cluster (or tile) are evaluated
+	if (ubo.pointLightCount > 0)
+	{
+#ifdef TILED_COMPUTE
+		uint clusterLights = min(tileLightCount, uint(MAX_LIGHTS_PER_TILE));
+#else
+		uint cluster = lightCluster(inUV, -fragPos.z);
+		uint clusterLights = clusterLightCounts[cluster];
+#endif
+		for (uint i = 0; i < clusterLights; ++i)
+		{
+#ifdef TILED_COMPUTE
+			uint lightIndex = tileLightIndices[i];
+#else
+			uint lightIndex = clusterLightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + i];
+#endif
+			PointLight light = pointLights[lightIndex];
+			vec3 lightPos = vec3(ubo.modelView * vec4(light.position.xyz, 1.0));
+			vec3 L = lightPos - fragPos;
+			float dist = length(L);
+			L = L / dist;
 
-			float atten = 1.0f;
+			// Inverse square falloff, windowed to reach zero at the light's radius
+			float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+			float atten = light.color.a * window * window / (dist * dist + 1.0);
 
-			if (isPointLight)
+			// The point lights closest to the camera are shadowed
+			for (int slot = 0; slot < POINT_SHADOW_COUNT; slot++)
 			{
-				atten = radius / (pow(dist, 2.0) + 1.0);
+				if (ubo.pointShadowLights[slot] == int(lightIndex))
+				{
+					atten *= pointShadow(slot, wPos - light.position.xyz, light.position.w);
+					break;
+				}
 			}
-			else
-			{
-				vec4 shadowPosCS = lightViewProj * vec4(wPos, 1.f);
-				
-				float shadowFactor = filterPCF(i, shadowPosCS);
 
-				vec3 spotDir = vec3(ubo.view * ubo.model * vec4(normalize(-ubo.lights[i].dir.xyz), 0.0));
-				spotDir = normalize(spotDir);
+			fragcolor += light.color.rgb * atten * BRDF(N, V, L, NdotV, roughness, realSpecularColor, realAlbedo.rgb);
+		}
+	}
+
+	outFragcolor = vec4(applyFog(fragcolor, inUV, -fragPos.z), 1.0f);
+}
+
+#ifdef TILED_COMPUTE
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 local = ivec2(gl_LocalInvocationID.xy);
+	bool inside = all(lessThan(gl_GlobalInvocationID.xy, pushConstants.extent));
 
-				float dist = length(L);
-				
-				L = L / dist;
+	if (gl_LocalInvocationIndex == 0)
+	{
+		// Largest finite float
+		tileDepthMin = 0x7f7fffffu;
+		tileDepthMax = 0u;
+		tileLightCount = 0u;
+	}
 
-				float cosDir = dot(spotDir, L);
+	// Invocations outside of the composition fetch its last row or column, they only take part in the tile's shared work
+	inUV = (vec2(min(pixel, ivec2(pushConstants.extent) - 1)) + 0.5) / vec2(pushConstants.extent);
+	gBufferUV = min(inUV * ubo.renderScale, ubo.renderScale - 0.5 / vec2(textureSize(samplerPosition, 0)));
+	pixelPosition = textureLod(samplerPosition, gBufferUV, 0.0);
+	float depth = (COMPACT_GBUFFER == 1) ? pixelPosition.r : pixelPosition.a;
+	if (SHADOW_MOMENTS == 1)
+	{
+		tileWorldPositions[local.y][local.x] = (COMPACT_GBUFFER == 1) ? (ubo.inverseView * vec4(viewPositionFromDepth(inUV, depth), 1.0)).xyz : pixelPosition.rgb;
+	}
+	barrier();
 
-				float spotEffect = smoothstep(lightCosOuterAngle, lightCosInnerAngle, cosDir);
-				float lightRange = 10000.0;
-				float heightAttenuation = smoothstep(lightRange, 0.0f, dist);
+	// Linear depths are positive, so their bits sort like the floats, the sky (zero) doesn't extend the range
+	if (inside && (depth > 0.0))
+	{
+		atomicMin(tileDepthMin, floatBitsToUint(depth));
+		atomicMax(tileDepthMax, floatBitsToUint(depth));
+	}
+	barrier();
 
-				atten = shadowFactor * spotEffect * heightAttenuation;		
+	// Each invocation tests a share of the point lights against the tile's view space bounding box, like the light culling does for a cluster
+	float depthMin = uintBitsToFloat(tileDepthMin);
+	float depthMax = uintBitsToFloat(tileDepthMax);
+	if (depthMin <= depthMax)
+	{
+		vec2 uvMin = vec2(gl_WorkGroupID.xy * TILE_SIZE) / vec2(pushConstants.extent);
+		vec2 uvMax = vec2((gl_WorkGroupID.xy + 1) * TILE_SIZE) / vec2(pushConstants.extent);
+		vec3 p0 = viewPositionFromDepth(uvMin, depthMin);
+		vec3 p1 = viewPositionFromDepth(uvMax, depthMin);
+		vec3 p2 = viewPositionFromDepth(uvMin, depthMax);
+		vec3 p3 = viewPositionFromDepth(uvMax, depthMax);
+		vec3 aabbMin = min(min(p0, p1), min(p2, p3));
+		vec3 aabbMax = max(max(p0, p1), max(p2, p3));
+		for (uint i = gl_LocalInvocationIndex; i < ubo.pointLightCount; i += TILE_SIZE * TILE_SIZE)
+		{
+			vec3 center = (ubo.modelView * vec4(pointLights[i].position.xyz, 1.0)).xyz;
+			float radius = pointLights[i].position.w;
+			vec3 d = center - clamp(center, aabbMin, aabbMax);
+			if (dot(d, d) <= radius * radius)
+			{
+				uint slot = atomicAdd(tileLightCount, 1u);
+				if (slot < MAX_LIGHTS_PER_TILE)
+				{
+					tileLightIndices[slot] = i;
+				}
 			}
+		}
+	}
+	barrier();
+
+	if (!inside)
+	{
+		return;
+	}
 
-			const float F0 = 1.1f;
-			// Cook-Torrance, GGX distribution, Schlick Fresnel approximation
-			float 	Dterm = DTerm_GGX(roughness, NdotH);
-			float 	Gterm = GTerm(roughness, N, V, L);
-			vec3	Fterm = FTerm(realSpecularColor, H, V);
-			vec3 diffuse = NdotL * realAlbedo.rgb;
-			vec3 specular = ( Dterm * Gterm * Fterm ) / (4.0f * NdotL * NdotV + EPS);
-			fragcolor += ubo.lights[i].color.rgb * atten * (diffuse + specular);	
-		}    	
+	// Differences within the pixel's 2x2 quad, like the coarse derivatives of the fragment shader
+	if (SHADOW_MOMENTS == 1)
+	{
+		ivec2 quad = local & ~1;
+		wPosDx = tileWorldPositions[quad.y][quad.x + 1] - tileWorldPositions[quad.y][quad.x];
+		wPosDy = tileWorldPositions[quad.y + 1][quad.x] - tileWorldPositions[quad.y][quad.x];
 	}
 
-	outFragcolor = vec4(fragcolor, 1.0f);
-}
\ No newline at end of file
+	shadePixel();
+	imageStore(outputColor, pixel, outFragcolor);
+}
+#endif
@@ -6,26 +6,47 @@
 layout (binding = 1) uniform sampler2D samplerPosition;
 layout (binding = 2) uniform sampler2D samplerNormal;
 layout (binding = 3) uniform usampler2D samplerAlbedo;
-layout (binding = 4) uniform sampler2D samplerSSAO;
+layout (binding = 6) uniform sampler2D samplerSSAO;
 
 layout (location = 0) in vec3 inUV;
 
 layout (location = 0) out vec4 outFragColor;
 
+layout (constant_id = 0) const int COMPACT_GBUFFER = 0;
+
+// Octahedral normal decoding for the compact G-Buffer
+vec3 decodeNormal(vec2 f)
+{
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.y += (n.y >= 0.0) ? -t : t;
+	return normalize(n);
+}
+
 void main() 
 {
 	vec3 components[3];
 	//components[0] = texture(samplerPosition, inUV.st).rgb;  
-	components[1] = texture(samplerNormal, inUV.st).rgb;  
 	ivec2 texDim = textureSize(samplerAlbedo, 0);
 	uvec4 albedo = texelFetch(samplerAlbedo, ivec2(inUV.st * texDim ), 0);
 //	uvec4 albedo = texture(samplerAlbedo, inUV.st, 0);
 
 	vec4 color;
-	color.rg = unpackHalf2x16(albedo.r);
-	color.ba = unpackHalf2x16(albedo.g);
 	vec4 spec;
-	spec.rg = unpackHalf2x16(albedo.b);
+	if (COMPACT_GBUFFER == 1)
+	{
+		components[1] = decodeNormal(texture(samplerNormal, inUV.st).rg) * 0.5 + 0.5;
+		color = unpackUnorm4x8(albedo.r);
+		spec = unpackUnorm4x8(albedo.g);
+	}
+	else
+	{
+		components[1] = texture(samplerNormal, inUV.st).rgb;  
+		color.rg = unpackHalf2x16(albedo.r);
+		color.ba = unpackHalf2x16(albedo.g);
+		spec.rg = unpackHalf2x16(albedo.b);
+	}
 	vec4 ssao = texture(samplerSSAO, inUV.st);
 
 	//components[2] = vec3(spec.r);
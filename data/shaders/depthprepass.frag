@@ -0,0 +1,44 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Depth prepass of the alpha tested scene meshes, discards with the same threshold as the G-Buffer pass
+
+#ifdef BINDLESS_MATERIALS
+// Must match SCENE_MAX_MATERIAL_TEXTURES
+#define MAX_MATERIAL_TEXTURES 256
+
+struct Material
+{
+	uint diffuse;
+	uint roughness;
+	uint normal;
+	uint metaliness;
+};
+
+// Textures of all materials, indexed through the material table
+layout (binding = 1) uniform sampler samplerMaterial;
+layout (binding = 2) uniform texture2D materialTextures[MAX_MATERIAL_TEXTURES];
+layout (binding = 3, std430) readonly buffer MaterialTable
+{
+	Material materials[];
+};
+
+// Constant for all fragments of a draw
+layout (location = 6) flat in uint inMaterial;
+
+#define samplerColor sampler2D(materialTextures[materials[inMaterial].diffuse], samplerMaterial)
+#else
+layout (binding = 1) uniform sampler2D samplerColor;
+#endif
+
+layout (location = 1) in vec2 inUV;
+
+void main() 
+{
+	if (texture(samplerColor, inUV).a < 0.5)
+	{
+		discard;
+	}
+}
\ No newline at end of file
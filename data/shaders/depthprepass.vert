@@ -0,0 +1,65 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Depth prepass of the opaque scene meshes, position stream only
+
+#ifdef VERTEX_PULLING
+// Must match SceneInstance
+struct Instance
+{
+	mat4 transform;
+	uint material;
+	uint vertexOffset;
+	uint pad0;
+	uint pad1;
+};
+
+// Vertices of the bound mesh buffers, pulled by gl_VertexIndex which already includes the draw's vertex offset
+layout (set = 2, binding = 0, std430) readonly buffer Positions
+{
+	float positions[];
+};
+layout (set = 2, binding = 2, std430) readonly buffer Instances
+{
+	Instance instances[];
+};
+#else
+layout (location = 0) in vec4 inPos;
+// Placement of the mesh instance
+layout (location = 5) in mat4 inInstanceTransform;
+#endif
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec2 viewportDim;
+	vec2 renderScale;
+	// Precomputed on the CPU once per frame
+	mat4 modelViewProjection;
+	mat4 modelView;
+	mat4 normalMatrix;
+} ubo;
+
+// Must match the depth of the G-Buffer pass exactly, as that one tests for equal depth
+invariant gl_Position;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+#ifdef VERTEX_PULLING
+	uint vertex = gl_VertexIndex;
+	vec4 inPos = vec4(positions[vertex * 3], positions[vertex * 3 + 1], positions[vertex * 3 + 2], 1.0);
+	mat4 inInstanceTransform = instances[gl_InstanceIndex].transform;
+#endif
+
+	vec4 pos = inInstanceTransform * inPos;
+	gl_Position = ubo.modelViewProjection * pos;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Lit and resolved output of the Forward+ pass, copied into the frame in place of the composition
+layout (binding = 0) uniform sampler2D samplerForward;
+
+layout (binding = 1) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec2 viewportDim;
+	// Part of the forward target covered by the screen with dynamic resolution
+	vec2 renderScale;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	// Clamped to the rendered texels, so filtering doesn't blend in texels outside of it
+	vec2 uv = min(inUV * ubo.renderScale, ubo.renderScale - 0.5 / vec2(textureSize(samplerForward, 0)));
+	outFragColor = vec4(texture(samplerForward, uv).rgb, 1.0);
+}
@@ -3,4 +3,105 @@ glslangvalidator -V mrt.frag -o mrt.frag.spv
 glslangvalidator -V composition.frag -o composition.frag.spv
 
 glslangvalidator -V offscreen.vert -o offscreen.vert.spv
-glslangvalidator -V offscreen.frag -o offscreen.frag.spv
\ No newline at end of file
+glslangvalidator -V offscreen.frag -o offscreen.frag.spv
+glslangvalidator -V pointshadow.vert -o pointshadow.vert.spv
+glslangvalidator -V pointshadow.geom -o pointshadow.geom.spv
+glslangvalidator -V depthprepass.vert -o depthprepass.vert.spv
+glslangvalidator -V depthprepass.frag -o depthprepass.frag.spv
+glslangvalidator -V mrt.vert -DBINDLESS_MATERIALS -o mrt.bindless.vert.spv
+glslangvalidator -V mrt.vert -DVERTEX_PULLING -o mrt.pulling.vert.spv
+glslangvalidator -V mrt.vert -DBINDLESS_MATERIALS -DVERTEX_PULLING -o mrt.bindless.pulling.vert.spv
+glslangvalidator -V depthprepass.vert -DVERTEX_PULLING -o depthprepass.pulling.vert.spv
+glslangvalidator -V offscreen.vert -DVERTEX_PULLING -o offscreen.pulling.vert.spv
+glslangvalidator -V mrt.frag -DBINDLESS_MATERIALS -o mrt.bindless.frag.spv
+glslangvalidator -V depthprepass.frag -DBINDLESS_MATERIALS -o depthprepass.bindless.frag.spv
+glslangvalidator -V visbuffer.vert -o visbuffer.vert.spv
+glslangvalidator -V visbuffer.frag -o visbuffer.frag.spv
+glslangvalidator -V visbuffer.resolve.frag -o visbuffer.resolve.frag.spv
+
+glslangvalidator -V fullscreen.vert -o fullscreen.vert.spv
+glslangvalidator -V ssao.frag -o ssao.frag.spv
+glslangvalidator -V blur.frag -o blur.frag.spv
+glslangvalidator -V gtaoupsample.frag -o gtaoupsample.frag.spv
+glslangvalidator -V debug.vert -o debug.vert.spv
+glslangvalidator -V debug.frag -o debug.frag.spv
+glslangvalidator -V taa.frag -o taa.frag.spv
+
+glslangvalidator -V cull.comp -o cull.comp.spv
+glslangvalidator -V hiz.comp -o hiz.comp.spv
+glslangvalidator -V shadowfilter.comp -o shadowfilter.comp.spv
+glslangvalidator -V composition.frag -DSUBPASS_INPUT -o composition.subpass.frag.spv
+glslangvalidator -V lightvolume.vert -o lightvolume.vert.spv
+glslangvalidator -V composition.frag -DLIGHT_VOLUME -o lightvolume.frag.spv
+glslangvalidator -V composition.frag -DHALF_PRECISION -o composition.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DSHADING_RATE -o composition.shadingrate.frag.spv
+glslangvalidator -V composition.frag -DSHADING_RATE -DHALF_PRECISION -o composition.shadingrate.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DCOARSE_SHADING -o composition.coarse.frag.spv
+glslangvalidator -V composition.frag -DCOARSE_SHADING -DHALF_PRECISION -o composition.coarse.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DREFLECTIONS -o composition.ssr.frag.spv
+glslangvalidator -V composition.frag -DREFLECTIONS -DHALF_PRECISION -o composition.ssr.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DSHADING_RATE -DREFLECTIONS -o composition.shadingrate.ssr.frag.spv
+glslangvalidator -V composition.frag -DSHADING_RATE -DREFLECTIONS -DHALF_PRECISION -o composition.shadingrate.ssr.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DCOARSE_SHADING -DREFLECTIONS -o composition.coarse.ssr.frag.spv
+glslangvalidator -V composition.frag -DCOARSE_SHADING -DREFLECTIONS -DHALF_PRECISION -o composition.coarse.ssr.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DVOLUMETRIC_FOG -o composition.fog.frag.spv
+glslangvalidator -V composition.frag -DVOLUMETRIC_FOG -DHALF_PRECISION -o composition.fog.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DREFLECTIONS -DVOLUMETRIC_FOG -o composition.ssr.fog.frag.spv
+glslangvalidator -V composition.frag -DREFLECTIONS -DVOLUMETRIC_FOG -DHALF_PRECISION -o composition.ssr.fog.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DSHADING_RATE -DVOLUMETRIC_FOG -o composition.shadingrate.fog.frag.spv
+glslangvalidator -V composition.frag -DSHADING_RATE -DVOLUMETRIC_FOG -DHALF_PRECISION -o composition.shadingrate.fog.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DSHADING_RATE -DREFLECTIONS -DVOLUMETRIC_FOG -o composition.shadingrate.ssr.fog.frag.spv
+glslangvalidator -V composition.frag -DSHADING_RATE -DREFLECTIONS -DVOLUMETRIC_FOG -DHALF_PRECISION -o composition.shadingrate.ssr.fog.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DSUBPASS_INPUT -DHALF_PRECISION -o composition.subpass.halfprecision.frag.spv
+glslangvalidator -V -S comp composition.frag -DTILED_COMPUTE -o composition.tiled.comp.spv
+glslangvalidator -V -S comp composition.frag -DTILED_COMPUTE -DHALF_PRECISION -o composition.tiled.halfprecision.comp.spv
+glslangvalidator -V -S comp composition.frag -DTILED_COMPUTE -DVOLUMETRIC_FOG -o composition.tiled.fog.comp.spv
+glslangvalidator -V -S comp composition.frag -DTILED_COMPUTE -DVOLUMETRIC_FOG -DHALF_PRECISION -o composition.tiled.fog.halfprecision.comp.spv
+glslangvalidator -V -S comp composition.frag -DTILED_COMPUTE -DREFLECTIONS -o composition.tiled.ssr.comp.spv
+glslangvalidator -V -S comp composition.frag -DTILED_COMPUTE -DREFLECTIONS -DHALF_PRECISION -o composition.tiled.ssr.halfprecision.comp.spv
+glslangvalidator -V -S comp composition.frag -DTILED_COMPUTE -DREFLECTIONS -DVOLUMETRIC_FOG -o composition.tiled.ssr.fog.comp.spv
+glslangvalidator -V -S comp composition.frag -DTILED_COMPUTE -DREFLECTIONS -DVOLUMETRIC_FOG -DHALF_PRECISION -o composition.tiled.ssr.fog.halfprecision.comp.spv
+glslangvalidator -V mrt.frag -DHALF_PRECISION -o mrt.halfprecision.frag.spv
+glslangvalidator -V mrt.frag -DBINDLESS_MATERIALS -DHALF_PRECISION -o mrt.bindless.halfprecision.frag.spv
+glslangvalidator -V mrt.frag -DBINDLESS_MATERIALS -DVIRTUAL_TEXTURING -o mrt.bindless.virtual.frag.spv
+glslangvalidator -V mrt.frag -DBINDLESS_MATERIALS -DVIRTUAL_TEXTURING -DHALF_PRECISION -o mrt.bindless.virtual.halfprecision.frag.spv
+glslangvalidator -V lightcull.comp -o lightcull.comp.spv
+glslangvalidator -V particle.comp -o particle.comp.spv
+glslangvalidator -V particlesort.comp -o particlesort.comp.spv
+glslangvalidator -V particle.vert -o particle.vert.spv
+glslangvalidator -V particle.frag -o particle.frag.spv
+glslangvalidator -V particle.frag -DWEIGHTED_OIT -o particle.oit.frag.spv
+glslangvalidator -V oitcomposite.frag -o oitcomposite.frag.spv
+glslangvalidator -V bloom.comp -o bloom.comp.spv
+glslangvalidator -V tonemap.frag -o tonemap.frag.spv
+glslangvalidator -V exposure.comp -o exposure.comp.spv
+glslangvalidator -V ibl.comp -o ibl.comp.spv
+glslangvalidator -V ibl.comp -DSCENE_PROBE -o ibl.probe.comp.spv
+glslangvalidator -V reflectionprobe.vert -o reflectionprobe.vert.spv
+glslangvalidator -V reflectionprobe.frag -o reflectionprobe.frag.spv
+glslangvalidator -V reflectionprobe.vert -DBINDLESS_MATERIALS -o reflectionprobe.bindless.vert.spv
+glslangvalidator -V reflectionprobe.frag -DBINDLESS_MATERIALS -o reflectionprobe.bindless.frag.spv
+glslangvalidator -V lightingcache.frag -o lightingcache.frag.spv
+glslangvalidator -V composition.frag -DFORWARD -o forward.frag.spv
+glslangvalidator -V composition.frag -DFORWARD -DBINDLESS_MATERIALS -o forward.bindless.frag.spv
+glslangvalidator -V composition.frag -DFORWARD -DHALF_PRECISION -o forward.halfprecision.frag.spv
+glslangvalidator -V composition.frag -DFORWARD -DBINDLESS_MATERIALS -DHALF_PRECISION -o forward.bindless.halfprecision.frag.spv
+glslangvalidator -V skysphere.vert -o skysphere.vert.spv
+glslangvalidator -V skysphere.frag -o skysphere.frag.spv
+glslangvalidator -V skysphere.frag -DFORWARD -o skysphere.forward.frag.spv
+glslangvalidator -V forwardcopy.frag -o forwardcopy.frag.spv
+glslangvalidator -V shadingrate.comp -o shadingrate.comp.spv
+glslangvalidator -V ssr.comp -o ssr.comp.spv
+glslangvalidator -V shadowrays.comp -o shadowrays.comp.spv
+glslangvalidator -V irradianceprobes.comp -o irradianceprobes.comp.spv
+glslangvalidator -V gtaodepth.comp -o gtaodepth.comp.spv
+glslangvalidator -V gtao.comp -o gtao.comp.spv
+glslangvalidator -V volumetricfog.comp -o volumetricfog.comp.spv
+glslangvalidator -V volumetricintegrate.comp -o volumetricintegrate.comp.spv
+glslangvalidator -V terrain.vert -o terrain.vert.spv
+glslangvalidator -V terrain.tesc -o terrain.tesc.spv
+glslangvalidator -V terrain.tese -o terrain.tese.spv
+glslangvalidator -V terrain.frag -o terrain.frag.spv
+glslangvalidator -V impostor.vert -o impostor.vert.spv
+glslangvalidator -V impostor.frag -o impostor.frag.spv
+glslangvalidator -V skinning.comp -o skinning.comp.spv
\ No newline at end of file
@@ -0,0 +1,74 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Upsamples the half resolution occlusion of gtao.comp to the G-Buffer's resolution
+// The half resolution texels hold the G-Buffer pixels with even coordinates, the four nearest ones are weighted bilinearly
+// and by how close their depth is to the pixel's, so the occlusion doesn't bleed across depth edges
+
+// Accumulated occlusion and the linear depth it has been found at
+layout (binding = 0) uniform sampler2D samplerOcclusion;
+layout (binding = 1) uniform sampler2D samplerDepth;
+layout (binding = 2) uniform sampler2D samplerPosition;
+
+layout (binding = 3) uniform UBO
+{
+	mat4 projection;
+	mat4 view;
+	mat4 inverseView;
+	mat4 previousViewProjection;
+	vec2 renderScale;
+	uint frameIndex;
+	uint historyValid;
+} ubo;
+
+// Compact G-Buffer: linear depth instead of positions
+layout (constant_id = 0) const int COMPACT_GBUFFER = 0;
+
+layout (location = 0) out float outFragColor;
+
+// Higher values keep depth edges sharper
+#define DEPTH_SHARPNESS 32.0
+
+void main()
+{
+	// Drawn over the rendered part of the G-Buffer, which the target shares
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec4 position = texelFetch(samplerPosition, pixel, 0);
+	float depth;
+	if (COMPACT_GBUFFER == 1)
+	{
+		depth = position.r;
+	}
+	else
+	{
+		depth = (position.w > 0.0) ? -(ubo.view * vec4(position.xyz, 1.0)).z : 0.0;
+	}
+	if (depth <= 0.0)
+	{
+		outFragColor = 1.0;
+		return;
+	}
+
+	vec2 renderExtent = vec2(textureSize(samplerPosition, 0)) * ubo.renderScale;
+	ivec2 extent = (max(ivec2(ceil(renderExtent)), ivec2(1)) + 1) / 2;
+	vec2 texelPos = vec2(pixel) * 0.5;
+	ivec2 baseTexel = ivec2(texelPos);
+	vec2 f = texelPos - vec2(baseTexel);
+
+	float result = 0.0;
+	float weightSum = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = min(baseTexel + offset, extent - 1);
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		float sampleDepth = texelFetch(samplerDepth, texel, 0).r;
+		float weight = (bilinear.x * bilinear.y + 1.0e-3) * exp(-abs(sampleDepth - depth) / depth * DEPTH_SHARPNESS);
+		result += texelFetch(samplerOcclusion, texel, 0).r * weight;
+		weightSum += weight;
+	}
+	// None of the texels is at the pixel's depth, thin geometry missed by the half resolution
+	outFragColor = (weightSum > 1.0e-4) ? result / weightSum : texelFetch(samplerOcclusion, min(baseTexel, extent - 1), 0).r;
+}
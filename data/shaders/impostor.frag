@@ -0,0 +1,103 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec2 viewportDim;
+	vec2 renderScale;
+	mat4 modelViewProjection;
+	mat4 modelView;
+	mat4 normalMatrix;
+} ubo;
+
+// Albedo and metalness
+layout (binding = 1) uniform sampler2D samplerAlbedo;
+// Octahedral encoded world space normal, roughness and the depth code along the view's direction, 0 where the prop isn't baked
+layout (binding = 2) uniform sampler2D samplerNormalDepth;
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec3 inWorldPos;
+layout (location = 2) flat in vec3 inForward;
+layout (location = 3) flat in float inRadius;
+layout (location = 4) flat in float inFade;
+
+layout (location = 0) out vec4 outPosition;
+layout (location = 1) out vec4 outNormal;
+layout (location = 2) out uvec4 outAlbedo;
+
+// Same as mrt.frag
+layout (constant_id = 3) const int COMPACT_GBUFFER = 0;
+
+// The depth is pushed back by this share of the radius, so the meshes win where both are drawn during the fade
+#define DEPTH_BIAS 0.05
+
+vec2 signNotZero(vec2 v)
+{
+	return vec2((v.x >= 0.0) ? 1.0 : -1.0, (v.y >= 0.0) ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n)
+{
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	return (n.z >= 0.0) ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+}
+
+vec3 octDecode(vec2 e)
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+	{
+		v.xy = (1.0 - abs(v.yx)) * signNotZero(v.xy);
+	}
+	return normalize(v);
+}
+
+void main() 
+{
+	vec4 normalDepth = texture(samplerNormalDepth, inUV);
+	if (normalDepth.a == 0.0)
+	{
+		discard;
+	}
+	// Ordered dither of the fade in, the G-Buffer can't blend
+	const float bayer[16] = float[](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+	ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+	if (inFade <= (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0)
+	{
+		discard;
+	}
+
+	// Codes 1 to 255 span the bounding sphere along the view's direction
+	float depth = ((normalDepth.a * 255.0 - 1.0) / 254.0) * 2.0 - 1.0;
+	vec4 pos = vec4(inWorldPos + inForward * depth * inRadius, 1.0);
+	vec4 clipPos = ubo.modelViewProjection * vec4(pos.xyz - inForward * inRadius * DEPTH_BIAS, 1.0);
+	gl_FragDepth = clipPos.z / clipPos.w;
+	float viewDepth = -(ubo.modelView * pos).z;
+
+	vec4 albedo = texture(samplerAlbedo, inUV);
+	vec4 color = vec4(albedo.rgb, 1.0);
+	float roughness = normalDepth.b;
+	float metaliness = albedo.a;
+	vec3 normal = normalize(mat3(ubo.normalMatrix) * octDecode(normalDepth.xy * 2.0 - 1.0));
+
+	if (COMPACT_GBUFFER == 1)
+	{
+		outPosition = vec4(viewDepth);
+		outNormal = vec4(encodeNormal(normal), 0.0, 0.0);
+		outAlbedo = uvec4(packUnorm4x8(color), packUnorm4x8(vec4(roughness, metaliness, 0.0, 0.0)), 0, 0);
+	}
+	else
+	{
+		outPosition = vec4(pos.xyz, viewDepth);
+		outNormal = vec4(normal * 0.5 + 0.5, 0.0);
+		outAlbedo.r = packHalf2x16(color.rg);
+		outAlbedo.g = packHalf2x16(color.ba);
+		outAlbedo.b = packHalf2x16(vec2(roughness, 0.0));
+		outAlbedo.a = packHalf2x16(vec2(metaliness, 0.0));
+	}
+}
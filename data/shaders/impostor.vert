@@ -0,0 +1,73 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Must match IMPOSTOR_GRID_SIZE, IMPOSTOR_VIEW_SIZE and IMPOSTOR_ATLAS_COLUMNS
+#define GRID_SIZE 8
+#define VIEW_SIZE 32
+#define ATLAS_COLUMNS 8
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec2 viewportDim;
+	vec2 renderScale;
+	mat4 modelViewProjection;
+	mat4 modelView;
+	mat4 normalMatrix;
+} ubo;
+
+layout (binding = 1) uniform sampler2D samplerAlbedo;
+
+// Must match ImpostorInstance
+layout (location = 0) in vec4 inSphere;
+// x - tile in the atlases, y - view of the tile facing the camera, z - opacity of the dithered fade in
+layout (location = 1) in vec4 inParams;
+
+layout (location = 0) out vec2 outUV;
+layout (location = 1) out vec3 outWorldPos;
+layout (location = 2) flat out vec3 outForward;
+layout (location = 3) flat out float outRadius;
+layout (location = 4) flat out float outFade;
+
+// Same as decodeOctahedral on the CPU side
+vec3 octDecode(vec2 e)
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+	{
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(v);
+}
+
+void main() 
+{
+	// Triangle strip of a quad, covering the bounding sphere as seen from the baked view's direction
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+	uint tile = uint(inParams.x);
+	uint view = uint(inParams.y);
+	vec2 cell = vec2(view % GRID_SIZE, view / GRID_SIZE);
+
+	// Same basis as getImpostorViewBasis and the bake's look at matrix
+	vec3 forward = octDecode((cell + 0.5) / float(GRID_SIZE) * 2.0 - 1.0);
+	vec3 upReference = (abs(forward.y) > 0.999) ? vec3(0.0, 0.0, 1.0) : vec3(0.0, -1.0, 0.0);
+	vec3 right = normalize(cross(upReference, forward));
+	vec3 up = cross(forward, right);
+
+	vec3 worldPos = inSphere.xyz + (right * corner.x + up * corner.y) * inSphere.w;
+	gl_Position = ubo.modelViewProjection * vec4(worldPos, 1.0);
+
+	// Texel centers of the view's cell, the bake's rows run along its up vector like the framebuffer's y axis
+	vec2 tileOrigin = vec2(tile % ATLAS_COLUMNS, tile / ATLAS_COLUMNS) * float(GRID_SIZE * VIEW_SIZE);
+	vec2 viewUV = corner * 0.5 + 0.5;
+	outUV = (tileOrigin + cell * float(VIEW_SIZE) + 0.5 + viewUV * float(VIEW_SIZE - 1)) / vec2(textureSize(samplerAlbedo, 0));
+
+	outWorldPos = worldPos;
+	outForward = forward;
+	outRadius = inSphere.w;
+	outFade = inParams.z;
+}
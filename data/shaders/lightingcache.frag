@@ -0,0 +1,15 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Composition and light volumes of the last frame whose lighting inputs changed
+// Same size and format as the frame, so texels are copied without filtering
+layout (binding = 0) uniform sampler2D samplerLighting;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	outFragColor = texelFetch(samplerLighting, ivec2(gl_FragCoord.xy), 0);
+}
@@ -0,0 +1,91 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Cone shaped proxy geometry of a shadowed spot light, one instance per shadow slot
+// The vertices are generated from the light's parameters, no vertex buffer is bound
+
+struct Light {
+	vec4 position;
+	vec4 dir;
+	vec4 color;
+	vec4 lightParams; // x - light type, y - radius for point lights, range for spot lights, z/w - cosine of the inner and outer cone angle for spot lights
+	mat4 lightSpace;
+	vec4 atlasRect; // xy - offset, zw - scale of the light's tile in the shadow atlas
+};
+
+#define SHADOW_LIGHT_COUNT 3
+
+// Segments of the cone, the proxy has 2 * CONE_SEGMENTS triangles (side and cap)
+#define CONE_SEGMENTS 16
+
+#define PI 3.14159265358979f
+
+// Same uniform buffer as the composition's fragment shader, only the members in front of the ones used are declared
+layout (binding = 4) uniform UBO 
+{
+	Light lights[SHADOW_LIGHT_COUNT];
+	vec4 viewPos;
+	mat4 view;
+	mat4 model;
+	mat4 projection;
+} ubo;
+
+layout (location = 0) out vec4 outClipPos;
+layout (location = 1) flat out int outLightIndex;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+	Light light = ubo.lights[gl_InstanceIndex];
+	outLightIndex = gl_InstanceIndex;
+
+	// Cone along the light's direction with the outer cone angle and the light's range, in view space
+	mat4 modelView = ubo.view * ubo.model;
+	vec3 apex = vec3(modelView * vec4(light.position.xyz, 1.0));
+	vec3 axis = normalize(vec3(modelView * vec4(light.dir.xyz, 0.0)));
+	vec3 u = normalize(cross(axis, (abs(axis.y) < 0.99) ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+	vec3 v = cross(axis, u);
+	float range = light.lightParams.y;
+	float cosOuter = light.lightParams.w;
+	// The polygon circumscribes the circle at the end of the cone
+	float radius = range * sqrt(1.0 - cosOuter * cosOuter) / cosOuter / cos(PI / CONE_SEGMENTS);
+	vec3 baseCenter = apex + axis * range;
+
+	// Triangles 0 to CONE_SEGMENTS - 1 form the side, the remaining ones the cap
+	int triangle = gl_VertexIndex / 3;
+	int segment = triangle % CONE_SEGMENTS;
+	float angle0 = 2.0 * PI * float(segment) / CONE_SEGMENTS;
+	float angle1 = 2.0 * PI * float(segment + 1) / CONE_SEGMENTS;
+	vec3 rim0 = baseCenter + radius * (cos(angle0) * u + sin(angle0) * v);
+	vec3 rim1 = baseCenter + radius * (cos(angle1) * u + sin(angle1) * v);
+	vec3 corners[3];
+	corners[0] = (triangle < CONE_SEGMENTS) ? apex : baseCenter;
+	corners[1] = rim0;
+	corners[2] = rim1;
+
+	// Only triangles facing away from the camera (at the origin) are rasterized, so every covered pixel is shaded once, even from inside the volume
+	// The facing is derived from the outward normal instead of the winding, the other triangles are collapsed to a point
+	vec3 normal = cross(corners[1] - corners[0], corners[2] - corners[0]);
+	if (dot(normal, corners[0] - (apex + axis * range * 0.75)) < 0.0)
+	{
+		normal = -normal;
+	}
+	bool backFacing = dot(normal, corners[0]) > 0.0;
+
+	// Point lights aren't bounded by a volume and stay in the full screen composition, negative types are lights culled on the CPU
+	if (!backFacing || (light.lightParams.x <= 0.0))
+	{
+		outClipPos = vec4(2.0, 2.0, 2.0, 1.0);
+	}
+	else
+	{
+		outClipPos = ubo.projection * vec4(corners[gl_VertexIndex % 3], 1.0);
+	}
+	gl_Position = outClipPos;
+}
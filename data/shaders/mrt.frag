@@ -3,63 +3,251 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
+// Compiled with HALF_PRECISION defined for the relaxed precision variant
+// The tangent space normal mapping is then mediump, which mobile GPUs evaluate in fp16
+#ifdef HALF_PRECISION
+#define hvec3 mediump vec3
+#define hmat3 mediump mat3
+#else
+#define hvec3 vec3
+#define hmat3 mat3
+#endif
+
+#ifdef BINDLESS_MATERIALS
+// Must match SCENE_MAX_MATERIAL_TEXTURES
+#define MAX_MATERIAL_TEXTURES 256
+
+struct Material
+{
+	uint diffuse;
+	uint roughness;
+	uint normal;
+	uint metaliness;
+};
+
+// Textures of all materials, indexed through the material table
+layout (binding = 1) uniform sampler samplerMaterial;
+layout (binding = 2) uniform texture2D materialTextures[MAX_MATERIAL_TEXTURES];
+layout (binding = 3, std430) readonly buffer MaterialTable
+{
+	Material materials[];
+};
+
+// Constant for all fragments of a draw
+layout (location = 6) flat in uint inMaterial;
+
+#define samplerColor sampler2D(materialTextures[materials[inMaterial].diffuse], samplerMaterial)
+#define samplerRoughness sampler2D(materialTextures[materials[inMaterial].roughness], samplerMaterial)
+#define samplerNormal sampler2D(materialTextures[materials[inMaterial].normal], samplerMaterial)
+#define samplerMetaliness sampler2D(materialTextures[materials[inMaterial].metaliness], samplerMaterial)
+
+#ifdef VIRTUAL_TEXTURING
+// Must match VirtualTexture's page layout
+#define PAGE_SIZE 128
+#define PAGE_BORDER 4
+#define SLOT_SIZE (PAGE_SIZE + 2 * PAGE_BORDER)
+#define MAX_LEVELS 16
+
+struct VirtualTexture
+{
+	uint firstPage;
+	uint width;
+	uint height;
+	uint levelCount;
+};
+
+// Textures of each material in the virtual texture, in the order of the material table
+layout (binding = 4, std430) readonly buffer VirtualMaterialTable
+{
+	uvec4 virtualMaterials[];
+};
+layout (binding = 5, std430) readonly buffer VirtualTextures
+{
+	VirtualTexture virtualTextures[];
+};
+// Slot of each page in the low 16 bits, the level of the page stored in the slot above
+layout (binding = 6, std430) readonly buffer PageTable
+{
+	uint pageTable[];
+};
+layout (binding = 7) uniform sampler2D samplerPageCache;
+// One bit per page wanted by this frame, read back to load the missing ones
+layout (binding = 8, std430) buffer Feedback
+{
+	uint feedback[];
+};
+
+vec4 sampleVirtualTexture(uint index, vec2 uv)
+{
+	VirtualTexture vt = virtualTextures[index];
+	uvec2 size = uvec2(vt.width, vt.height);
+
+	// Level with about one texel per pixel
+	vec2 dx = dFdx(uv * vec2(size));
+	vec2 dy = dFdy(uv * vec2(size));
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+	uint level = min(uint(max(lod + 0.5, 0.0)), vt.levelCount - 1);
+
+	// Page of that level, the pages are stored level by level
+	vec2 wrapped = fract(uv);
+	uint page = vt.firstPage;
+	for (uint i = 0; i < MAX_LEVELS; i++)
+	{
+		uvec2 pages = (max(size >> i, uvec2(1)) + PAGE_SIZE - 1) / PAGE_SIZE;
+		if (i == level)
+		{
+			uvec2 pageCoord = min(uvec2(wrapped * vec2(max(size >> i, uvec2(1)))) / PAGE_SIZE, pages - 1);
+			page += pageCoord.y * pages.x + pageCoord.x;
+			break;
+		}
+		page += pages.x * pages.y;
+	}
+
+	// A pixel of each 4 x 4 block reports the pages it wants, the last level is always resident
+	if ((level + 1 < vt.levelCount) && (((uint(gl_FragCoord.x) | uint(gl_FragCoord.y)) & 3) == 0))
+	{
+		uint bit = 1u << (page & 31);
+		if ((feedback[page >> 5] & bit) == 0)
+		{
+			atomicOr(feedback[page >> 5], bit);
+		}
+	}
+
+	// Until the page has been loaded the entry points at the closest resident ancestor
+	uint entry = pageTable[page];
+	uint slot = entry & 0xFFFF;
+	vec2 texel = wrapped * vec2(max(size >> (entry >> 16), uvec2(1)));
+	vec2 pageTexel = mod(texel, float(PAGE_SIZE));
+	uint slotsPerRow = uint(textureSize(samplerPageCache, 0).x) / SLOT_SIZE;
+	vec2 cacheTexel = vec2(slot % slotsPerRow, slot / slotsPerRow) * SLOT_SIZE + PAGE_BORDER + pageTexel;
+	return textureLod(samplerPageCache, cacheTexel / vec2(textureSize(samplerPageCache, 0)), 0.0);
+}
+
+#define sampleMaterial(materialSampler, channel, uv) sampleVirtualTexture(virtualMaterials[inMaterial].channel, uv)
+#endif
+#else
 layout (binding = 1) uniform sampler2D samplerColor;
 layout (binding = 2) uniform sampler2D samplerRoughness;
 layout (binding = 3) uniform sampler2D samplerNormal;
 layout (binding = 4) uniform sampler2D samplerMetaliness;
+#endif
+
+// Material textures are sampled directly or through the virtual texture, channel selects the texture of the virtual material table
+#ifndef VIRTUAL_TEXTURING
+#define sampleMaterial(materialSampler, channel, uv) texture(materialSampler, uv)
+// The smallest level holds the texture's average, all fragments read the same texel so it stays in the texture cache
+#define sampleMaterialAverage(materialSampler, channel, uv) textureLod(materialSampler, vec2(0.5), 16.0)
+#else
+// Pages of the virtual texture are selected by the derivatives of the coordinates, which a constant one doesn't have
+#define sampleMaterialAverage(materialSampler, channel, uv) sampleMaterial(materialSampler, channel, uv)
+#endif
+
+// Per draw data of the batch, see SceneDrawData
+layout (set = 1, binding = 0) uniform DrawData
+{
+	vec4 colorFactor;
+	vec4 materialFactors;
+} drawData;
 
 layout (location = 0) in vec3 inNormal;
 layout (location = 1) in vec2 inUV;
 layout (location = 2) in vec3 inColor;
 layout (location = 3) in vec3 inWorldPos;
 layout (location = 4) in vec3 inTangent;
+layout (location = 5) in float inViewDepth;
 
 layout (location = 0) out vec4 outPosition;
 layout (location = 1) out vec4 outNormal;
 layout (location = 2) out uvec4 outAlbedo;
 
-layout (constant_id = 0) const float NEAR_PLANE = 0.1f;
-layout (constant_id = 1) const float FAR_PLANE = 64.0f;
 layout (constant_id = 2) const int ENABLE_DISCARD = 0;
+// Compact G-Buffer: linear depth, octahedral normals and 8 bit albedo, roughness and metalness
+layout (constant_id = 3) const int COMPACT_GBUFFER = 0;
+// Material LOD of draws that are small on screen: no normal mapping, roughness and metalness are the averages of their textures
+layout (constant_id = 4) const int MATERIAL_LOD = 0;
+
+// Octahedral normal encoding, maps the unit sphere to [-1..1]
+vec2 signNotZero(vec2 v)
+{
+	return vec2((v.x >= 0.0) ? 1.0 : -1.0, (v.y >= 0.0) ? 1.0 : -1.0);
+}
 
-float linearDepth(float depth)
+vec2 encodeNormal(vec3 n)
 {
-	float z = depth * 2.0f - 1.0f; 
-	return (2.0f * NEAR_PLANE * FAR_PLANE) / (FAR_PLANE + NEAR_PLANE - z * (FAR_PLANE - NEAR_PLANE));	
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	return (n.z >= 0.0) ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
 }
 
 void main() 
 {
-	outPosition = vec4(inWorldPos, linearDepth(gl_FragCoord.z));
+	// The view space depth is linear whichever way the projection maps the depth buffer
+	if (COMPACT_GBUFFER == 1)
+	{
+		// Positions are rebuilt from the depth
+		outPosition = vec4(inViewDepth);
+	}
+	else
+	{
+		outPosition = vec4(inWorldPos, inViewDepth);
+	}
 
-	vec4 color = texture(samplerColor, inUV);
+	vec4 color = sampleMaterial(samplerColor, x, inUV) * drawData.colorFactor;
 
 	// Discard by alpha for transparent objects if enabled via specialization constant
-	if (ENABLE_DISCARD == 0)
+	hvec3 normal;
+	if ((ENABLE_DISCARD == 0) && (MATERIAL_LOD == 0))
 	{
-		vec3 N = normalize(inNormal);
-		vec3 T = normalize(inTangent);
-		vec3 B = cross(N, T);
-		mat3 TBN = mat3(T, B, N);
-		vec3 nm = texture(samplerNormal, inUV).xyz * 2.0 - vec3(1.0);
-		nm = TBN * normalize(nm);
-		outNormal = vec4(nm * 0.5 + 0.5, 0.0);
+		hvec3 N = normalize(inNormal);
+		hvec3 T = normalize(inTangent);
+		hvec3 B = cross(N, T);
+		hmat3 TBN = mat3(T, B, N);
+		// Normal maps only store x and y (BC5 or RG8), z of the unit length tangent space normal is always positive
+		hvec3 nm;
+		nm.xy = sampleMaterial(samplerNormal, z, inUV).xy * 2.0 - vec2(1.0);
+		nm.z = sqrt(max(1.0 - dot(nm.xy, nm.xy), 0.0));
+		normal = TBN * normalize(nm);
 	}
 	else
 	{
-		outNormal = vec4(normalize(inNormal) * 0.5 + 0.5, 0.0);
-		if (color.a < 0.5)
+		normal = normalize(inNormal);
+		if ((ENABLE_DISCARD == 1) && (color.a < 0.5))
 		{
 			discard;
 		}
 	}
 
+	if (COMPACT_GBUFFER == 1)
+	{
+		outNormal = vec4(encodeNormal(normalize(normal)), 0.0, 0.0);
+	}
+	else
+	{
+		outNormal = vec4(normal * 0.5 + 0.5, 0.0);
+	}
+
 	// Pack
-	float roughness = texture(samplerRoughness, inUV).r;
-	float metaliness = texture(samplerMetaliness, inUV).r;
+	float roughness;
+	float metaliness;
+	if (MATERIAL_LOD == 0)
+	{
+		roughness = sampleMaterial(samplerRoughness, y, inUV).r * drawData.materialFactors.x;
+		metaliness = sampleMaterial(samplerMetaliness, w, inUV).r * drawData.materialFactors.y;
+	}
+	else
+	{
+		roughness = sampleMaterialAverage(samplerRoughness, y, inUV).r * drawData.materialFactors.x;
+		metaliness = sampleMaterialAverage(samplerMetaliness, w, inUV).r * drawData.materialFactors.y;
+	}
 
-	outAlbedo.r = packHalf2x16(color.rg);
-	outAlbedo.g = packHalf2x16(color.ba);
-	outAlbedo.b = packHalf2x16(vec2(roughness, 0.0));
-	outAlbedo.a = packHalf2x16(vec2(metaliness, 0.0));
+	if (COMPACT_GBUFFER == 1)
+	{
+		outAlbedo = uvec4(packUnorm4x8(color), packUnorm4x8(vec4(roughness, metaliness, 0.0, 0.0)), 0, 0);
+	}
+	else
+	{
+		outAlbedo.r = packHalf2x16(color.rg);
+		outAlbedo.g = packHalf2x16(color.ba);
+		outAlbedo.b = packHalf2x16(vec2(roughness, 0.0));
+		outAlbedo.a = packHalf2x16(vec2(metaliness, 0.0));
+	}
 }
\ No newline at end of file
@@ -3,17 +3,55 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
+#ifdef VERTEX_PULLING
+// Must match SceneInstance
+struct Instance
+{
+	mat4 transform;
+	uint material;
+	uint vertexOffset;
+	uint pad0;
+	uint pad1;
+};
+
+// Vertices of the bound mesh buffers, pulled by gl_VertexIndex which already includes the draw's vertex offset
+layout (set = 2, binding = 0, std430) readonly buffer Positions
+{
+	float positions[];
+};
+// Packed attributes (see PackedVertex), three words per vertex
+layout (set = 2, binding = 1, std430) readonly buffer Attributes
+{
+	uint attributes[];
+};
+layout (set = 2, binding = 2, std430) readonly buffer Instances
+{
+	Instance instances[];
+};
+#else
 layout (location = 0) in vec4 inPos;
 layout (location = 1) in vec2 inUV;
-layout (location = 2) in vec3 inColor;
-layout (location = 3) in vec3 inNormal;
-layout (location = 4) in vec3 inTangent;
+// Octahedral encoded unit vectors
+layout (location = 3) in vec2 inNormal;
+layout (location = 4) in vec2 inTangent;
+// Placement of the mesh instance
+layout (location = 5) in mat4 inInstanceTransform;
+#ifdef BINDLESS_MATERIALS
+layout (location = 9) in uint inInstanceMaterial;
+#endif
+#endif
 
 layout (binding = 0) uniform UBO 
 {
 	mat4 projection;
 	mat4 model;
 	mat4 view;
+	vec2 viewportDim;
+	vec2 renderScale;
+	// Precomputed on the CPU once per frame
+	mat4 modelViewProjection;
+	mat4 modelView;
+	mat4 normalMatrix;
 } ubo;
 
 layout (location = 0) out vec3 outNormal;
@@ -21,27 +59,62 @@ layout (location = 1) out vec2 outUV;
 layout (location = 2) out vec3 outColor;
 layout (location = 3) out vec3 outWorldPos;
 layout (location = 4) out vec3 outTangent;
+layout (location = 5) out float outViewDepth;
+#ifdef BINDLESS_MATERIALS
+layout (location = 6) flat out uint outMaterial;
+#endif
+
+// Must match the depth prepass (depthprepass.vert) exactly
+invariant gl_Position;
+
+// Inverse of packOctahedral on the CPU side
+vec3 octDecode(vec2 e)
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+	{
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(v);
+}
 
 void main() 
 {
-	gl_Position = ubo.projection * ubo.view * ubo.model * inPos;
+#ifdef VERTEX_PULLING
+	// Same values the vertex input would fetch from the scene layout
+	uint vertex = gl_VertexIndex;
+	vec4 inPos = vec4(positions[vertex * 3], positions[vertex * 3 + 1], positions[vertex * 3 + 2], 1.0);
+	vec2 inUV = unpackHalf2x16(attributes[vertex * 3]);
+	vec2 inNormal = unpackSnorm2x16(attributes[vertex * 3 + 1]);
+	vec2 inTangent = unpackSnorm2x16(attributes[vertex * 3 + 2]);
+	mat4 inInstanceTransform = instances[gl_InstanceIndex].transform;
+	uint inInstanceMaterial = instances[gl_InstanceIndex].material;
+#endif
+
+	vec4 pos = inInstanceTransform * inPos;
+	gl_Position = ubo.modelViewProjection * pos;
 	
 	outUV = inUV;
 	outUV.t = 1.0 - outUV.t;
 
 	// Vertex position in world space
-	outWorldPos = inPos.xyz;
+	outWorldPos = pos.xyz;
+
+	// Linear view space depth for the compact G-Buffer
+	outViewDepth = -(ubo.modelView * pos).z;
 	
-	// Normal in world space
-	mat3 mNormal = transpose(inverse(mat3(ubo.model)));
-	outNormal = mNormal * normalize(inNormal);	
+	vec3 normal = octDecode(inNormal);
+	vec3 tangent = octDecode(inTangent);
 
-	// Normal in view space
-	mat3 normalMatrix = transpose(inverse(mat3(ubo.view * ubo.model)));
-	outNormal = normalMatrix * inNormal;
+	// Normal and tangent in view space, the G-Buffer stores view space normals
+	mat3 normalMatrix = mat3(ubo.normalMatrix) * mat3(inInstanceTransform);
+	outNormal = normalMatrix * normal;
+	outTangent = normalMatrix * tangent;
 
-	outTangent = mNormal * normalize(inTangent);
+	// Vertex color is not stored in the packed vertex format
+	outColor = vec3(1.0);
 
-	// Currently just vertex color
-	outColor = inColor;
+#ifdef BINDLESS_MATERIALS
+	outMaterial = inInstanceMaterial;
+#endif
 }
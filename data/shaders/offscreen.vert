@@ -3,13 +3,40 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
-#define NUM_LIGHTS 3
+#define SHADOW_LIGHT_COUNT 3
+#define SHADOW_CASCADE_COUNT 4
+// Spot lights followed by the sun's cascades
+#define SHADOW_VIEW_COUNT (SHADOW_LIGHT_COUNT + SHADOW_CASCADE_COUNT)
 
+#ifdef VERTEX_PULLING
+// Must match SceneInstance
+struct Instance
+{
+	mat4 transform;
+	uint material;
+	uint vertexOffset;
+	uint pad0;
+	uint pad1;
+};
+
+// Vertices of the bound mesh buffers, pulled by gl_VertexIndex which already includes the draw's vertex offset
+layout (set = 1, binding = 0, std430) readonly buffer Positions
+{
+	float positions[];
+};
+layout (set = 1, binding = 2, std430) readonly buffer Instances
+{
+	Instance instances[];
+};
+#else
 layout (location = 0) in vec3 inPos;
+// Placement of the mesh instance
+layout (location = 5) in mat4 inInstanceTransform;
+#endif
 
 layout (binding = 0) uniform UBO 
 {
-	mat4 depthMVP[NUM_LIGHTS];
+	mat4 depthMVP[SHADOW_VIEW_COUNT];
 } ubo;
 
 layout(push_constant) uniform PushConsts {
@@ -24,5 +51,11 @@ out gl_PerVertex
  
 void main()
 {
-	gl_Position =  ubo.depthMVP[pushConsts.lightIdx] * vec4(inPos, 1.0);
+#ifdef VERTEX_PULLING
+	uint vertex = gl_VertexIndex;
+	vec3 inPos = vec3(positions[vertex * 3], positions[vertex * 3 + 1], positions[vertex * 3 + 2]);
+	mat4 inInstanceTransform = instances[gl_InstanceIndex].transform;
+#endif
+
+	gl_Position =  ubo.depthMVP[pushConsts.lightIdx] * inInstanceTransform * vec4(inPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,32 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Resolves the weighted blended transparency targets over the frame
+// The accumulated colors are averaged by their weights and blended in with the revealage, the share of the frame left visible
+layout (binding = 0) uniform sampler2D samplerAccumulation;
+layout (binding = 1) uniform sampler2D samplerRevealage;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	// Same size as the frame
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float revealage = texelFetch(samplerRevealage, texel, 0).r;
+	// Nothing transparent has been drawn to the pixel
+	if (revealage >= 1.0)
+	{
+		discard;
+	}
+	vec4 accumulation = texelFetch(samplerAccumulation, texel, 0);
+	// Sums overflowing the half floats would turn the average into infinity
+	if (isinf(max(max(abs(accumulation.r), abs(accumulation.g)), max(abs(accumulation.b), accumulation.a))))
+	{
+		accumulation.rgb = vec3(accumulation.a);
+	}
+	vec3 averageColor = accumulation.rgb / clamp(accumulation.a, 1.0e-4, 5.0e4);
+	// Blended as averageColor * (1 - revealage) + frame * revealage
+	outFragColor = vec4(averageColor, revealage);
+}
@@ -14,27 +14,47 @@ layout (location = 3) in flat int inType;
 layout (location = 4) in float inRotation;
 layout (location = 5) in vec2 inViewportDim;
 layout (location = 6) in float inArrayPos;
+layout (location = 7) in float inViewDepth;
+layout (location = 8) in vec3 inLight;
 
+#ifdef WEIGHTED_OIT
+// Weighted blended order independent transparency (McGuire and Bavoil), the particles are drawn unsorted
+// The weighted sum of the premultiplied colors and coverages is added up, the revealage multiplies the transmittances of all layers
+layout (location = 0) out vec4 outAccumulation;
+layout (location = 1) out float outRevealage;
+vec4 outColor;
+#else
 layout (location = 0) out vec4 outColor;
+#endif
 
-layout (constant_id = 0) const float NEAR_PLANE = 1.0f;
+// Depth the sky is treated to be at
 layout (constant_id = 1) const float FAR_PLANE = 512.0f;
+// Compact G-Buffer: the view space depth in the first channel instead of the last
+layout (constant_id = 2) const int COMPACT_GBUFFER = 0;
 
-float linearDepth(float depth)
-{
-	float z = depth * 2.0f - 1.0f; 
-	return (2.0f * NEAR_PLANE * FAR_PLANE) / (FAR_PLANE + NEAR_PLANE - z * (FAR_PLANE - NEAR_PLANE));	
-}
+// Distance over which particles fade out in front of the scene's surfaces
+#define SOFT_PARTICLE_DISTANCE 2.0
+// Light the smoke receives from the rest of the scene, in place of the ambient lighting of the opaque surfaces
+#define SMOKE_AMBIENT 0.25
 
 void main () 
 {
 	// Sample depth from deferred depth buffer and discard if obscured
 	vec2 ndcPos = gl_FragCoord.xy / inViewportDim.xy; 
-	float depth = texture(samplerPositionDepth, ndcPos).w;
-	if (linearDepth(gl_FragCoord.z) > depth)
+	vec4 positionDepth = texture(samplerPositionDepth, ndcPos);
+	float depth = (COMPACT_GBUFFER == 1) ? positionDepth.r : positionDepth.w;
+	// The sky doesn't write a depth
+	if (depth <= 0.0)
+	{
+		depth = FAR_PLANE;
+	}
+	float particleDepth = inViewDepth;
+	if (particleDepth > depth)
 	{
 		discard;
 	};
+	// Soft particles, fade out close to the geometry behind instead of cutting hard edges into it
+	float softFade = clamp((depth - particleDepth) / SOFT_PARTICLE_DISTANCE, 0.0, 1.0);
 
 	vec4 color;
 	float alpha = (inAlpha <= 1.0) ? inAlpha : 2.0 - inAlpha;
@@ -60,7 +80,20 @@ void main ()
 		// Smoke
 		color = texture(samplerSmoke, rotUV);
 		outColor.a = color.a * alpha;
+		// Lit by the point lights of its cluster, which include the torches it rises from
+		color.rgb *= SMOKE_AMBIENT + inLight;
 	}
 
 	outColor.rgb = color.rgb * inColor.rgb * alpha;
+	// Premultiplied, so fading scales all channels
+	outColor *= softFade;
+
+#ifdef WEIGHTED_OIT
+	// Additive flames have no coverage of their own, they hide the background by their brightness instead
+	float coverage = (inType == 0) ? clamp(max(max(outColor.r, outColor.g), outColor.b), 0.0, 1.0) : outColor.a;
+	// Nearer layers dominate the average, the weight falls off with the view space distance
+	float weight = coverage * clamp(10.0 / (1.0e-5 + pow(particleDepth / 5.0, 2.0) + pow(particleDepth / 200.0, 6.0)), 1.0e-2, 3.0e3);
+	outAccumulation = vec4(outColor.rgb, coverage) * weight;
+	outRevealage = coverage;
+#endif
 }
@@ -17,15 +17,102 @@ layout (location = 3) out flat int outType;
 layout (location = 4) out float outRotation;
 layout (location = 5) out vec2 outViewportDim;
 layout (location = 6) out float outArrayPos;
+layout (location = 7) out float outViewDepth;
+// Point light reaching the particle, lit per vertex since a sprite is small and mostly translucent
+layout (location = 8) out vec3 outLight;
 
 layout (binding = 0) uniform UBO 
 {
 	mat4 projection;
-	mat4 view;
 	mat4 model;
+	mat4 view;
 	vec2 viewportDim;
+	vec2 renderScale;
 } ubo;
 
+struct Light {
+	vec4 position;
+	vec4 dir;
+	vec4 color;
+	vec4 lightParams;
+	mat4 lightSpace;
+	vec4 atlasRect;
+};
+
+#define SHADOW_LIGHT_COUNT 3
+
+// The composition's lights, up to the point light count
+layout (binding = 4) uniform LightsUBO
+{
+	Light lights[SHADOW_LIGHT_COUNT];
+	vec4 viewPos;
+	mat4 view;
+	mat4 model;
+	mat4 projection;
+	mat4 inverseView;
+	// x - near, y - far, z - slices per log unit of depth
+	vec4 clusterDepthRange;
+	uint pointLightCount;
+} lightsUbo;
+
+// Same point lights and light clusters as the composition, see lightcull.comp
+#define LIGHT_CLUSTER_X 16
+#define LIGHT_CLUSTER_Y 9
+#define LIGHT_CLUSTER_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z)
+#define MAX_LIGHTS_PER_CLUSTER 64
+
+struct PointLight {
+	vec4 position;	// xyz - world position, w - radius
+	vec4 color;		// rgb - color, a - intensity
+};
+
+layout (binding = 5, std430) readonly buffer PointLights
+{
+	PointLight pointLights[];
+};
+
+layout (binding = 6, std430) readonly buffer LightClusters
+{
+	uint clusterLightCounts[LIGHT_CLUSTER_COUNT];
+	uint clusterLightIndices[];
+};
+
+#define PI 3.1415926535897932384626433832795
+
+// Index of the light cluster containing the point, see composition.frag
+uint lightCluster(vec2 uv, float depth)
+{
+	uvec2 tile = min(uvec2(clamp(uv, 0.0, 1.0) * vec2(LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y)), uvec2(LIGHT_CLUSTER_X - 1, LIGHT_CLUSTER_Y - 1));
+	float slice = log(max(depth, lightsUbo.clusterDepthRange.x) / lightsUbo.clusterDepthRange.x) * lightsUbo.clusterDepthRange.z;
+	uint z = min(uint(slice), uint(LIGHT_CLUSTER_Z - 1));
+	return tile.x + (tile.y + z * LIGHT_CLUSTER_Y) * LIGHT_CLUSTER_X;
+}
+
+// Light scattered by the particle from the point lights of its cluster, isotropic so it doesn't need a normal
+vec3 pointLighting(vec3 pos, vec4 clipPos, float depth)
+{
+	vec3 light = vec3(0.0);
+	if ((lightsUbo.pointLightCount == 0) || (clipPos.w <= 0.0))
+	{
+		return light;
+	}
+	// The clusters are laid out on the screen through the same (pre-rotated) projection
+	vec2 uv = clipPos.xy / clipPos.w * 0.5 + 0.5;
+	uint cluster = lightCluster(uv, depth);
+	uint clusterLights = clusterLightCounts[cluster];
+	for (uint i = 0; i < clusterLights; ++i)
+	{
+		PointLight pointLight = pointLights[clusterLightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+		float dist = length(pointLight.position.xyz - pos);
+		// Same falloff as the composition
+		float window = clamp(1.0 - pow(dist / pointLight.position.w, 4.0), 0.0, 1.0);
+		float atten = pointLight.color.a * window * window / (dist * dist + 1.0);
+		light += pointLight.color.rgb * atten;
+	}
+	return light / PI;
+}
+
 void main () 
 {
 	gl_PointSize = 8.0;
@@ -33,13 +120,17 @@ void main ()
 	outAlpha = inAlpha;
 	outType = inType;
 	outRotation = inRotation;
-	outViewportDim = ubo.viewportDim;
+	// Size of the whole G-Buffer in screen pixels, dynamic resolution only renders to a part of it
+	outViewportDim = ubo.viewportDim / ubo.renderScale;
 	  
 	vec4 eyePos = ubo.view * ubo.model * vec4(inPos.xyz, 1.0);
+	// Linear view space depth, compared against the compact G-Buffer
+	outViewDepth = -eyePos.z;
 	vec4 projVoxel = ubo.projection * vec4(gl_PointSize, gl_PointSize, eyePos.z, eyePos.w);
 	vec2 projSize = ubo.viewportDim * projVoxel.xy / projVoxel.w;
 
-	outPointSize = inSize * 0.25 * (projSize.x + projSize.y);
+	// The axes may be swapped and flipped by the swap chain's pre-rotation
+	outPointSize = inSize * 0.25 * (abs(projSize.x) + abs(projSize.y));
 	
 	gl_PointSize = outPointSize;
 		
@@ -51,4 +142,7 @@ void main ()
 	gl_PointSize = (((inSize * 1024.0 * viewportAR) / pointDist) * viewportAR);	
 
 	outArrayPos = inPos.w;	
+
+	// Flames are emissive
+	outLight = (inType == 0) ? vec3(0.0) : pointLighting(inPos.xyz, gl_Position, outViewDepth);
 }
\ No newline at end of file
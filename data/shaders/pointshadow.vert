@@ -0,0 +1,19 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (location = 0) in vec3 inPos;
+// Placement of the mesh instance
+layout (location = 5) in mat4 inInstanceTransform;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+
+void main()
+{
+	// Projected to each cube face by the geometry shader
+	gl_Position = inInstanceTransform * vec4(inPos, 1.0);
+}
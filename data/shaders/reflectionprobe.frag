@@ -0,0 +1,172 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Cheap forward shading of the scene into a face of the reflection probe, see updateReflectionProbe
+// Diffuse only, lit by the sun and the spot lights with a single shadow map fetch and by the irradiance of the current ambient light
+// The point lights aren't added, the probe's faces are small enough for the missing highlights not to matter
+// rgb - radiance seen by the probe, a - coverage, the convolution (ibl.comp) shows the sky where it's zero
+
+#ifdef BINDLESS_MATERIALS
+// Must match SCENE_MAX_MATERIAL_TEXTURES
+#define MAX_MATERIAL_TEXTURES 256
+
+struct Material
+{
+	uint diffuse;
+	uint roughness;
+	uint normal;
+	uint metaliness;
+};
+
+// Textures of all materials, indexed through the material table
+layout (binding = 1) uniform sampler samplerMaterial;
+layout (binding = 2) uniform texture2D materialTextures[MAX_MATERIAL_TEXTURES];
+layout (binding = 3, std430) readonly buffer MaterialTable
+{
+	Material materials[];
+};
+
+// Constant for all fragments of a draw
+layout (location = 6) flat in uint inMaterial;
+
+#define samplerColor sampler2D(materialTextures[materials[inMaterial].diffuse], samplerMaterial)
+#define samplerMetaliness sampler2D(materialTextures[materials[inMaterial].metaliness], samplerMaterial)
+#else
+layout (binding = 1) uniform sampler2D samplerColor;
+layout (binding = 4) uniform sampler2D samplerMetaliness;
+#endif
+
+// Per draw data of the batch, see SceneDrawData
+layout (set = 1, binding = 0) uniform DrawData
+{
+	vec4 colorFactor;
+	vec4 materialFactors;
+} drawData;
+
+struct Light {
+	vec4 position;
+	vec4 dir;
+	vec4 color;
+	vec4 lightParams; // x - light type, y - radius for point lights, range for spot lights, z/w - cosine of the inner and outer cone angle for spot lights
+	mat4 lightSpace;
+	vec4 atlasRect; // xy - offset, zw - scale of the light's tile in the shadow atlas
+};
+
+#define SHADOW_LIGHT_COUNT 3
+#define SHADOW_CASCADE_COUNT 4
+
+// The composition's lights
+layout (set = 2, binding = 1) uniform UBO
+{
+	Light lights[SHADOW_LIGHT_COUNT];
+	vec4 viewPos;
+	mat4 view;
+	mat4 model;
+	mat4 projection;
+	mat4 inverseView;
+	vec4 clusterDepthRange;
+	uint pointLightCount;
+	uint sunEnabled;
+	uint coarseShading;
+	uint reflections;
+	vec4 sunDirection;
+	vec4 sunColor;
+	vec4 cascadeSplits;
+	mat4 cascadeViewProj[SHADOW_CASCADE_COUNT];
+} ubo;
+
+// The spot lights' atlas followed by the sun's cascades
+layout (set = 2, binding = 2) uniform sampler2DArrayShadow samplerShadowMap;
+// Diffuse ambient light, the previous refresh of the probe once it has been convolved
+layout (set = 2, binding = 3) uniform samplerCube samplerIrradiance;
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec2 inUV;
+layout (location = 3) in vec3 inWorldPos;
+
+layout (location = 0) out vec4 outColor;
+
+layout (constant_id = 0) const int ENABLE_DISCARD = 0;
+
+// Must match the composition's
+#define AMBIENT_FACTOR 0.5
+
+// Single comparison fetch with the composition's shadow darkness, positions outside of the shadow map are lit
+float shadowMap(int layer, mat4 viewProj, vec3 wPos, vec4 rect)
+{
+	vec4 shadowCoord = viewProj * vec4(wPos, 1.0);
+	shadowCoord /= shadowCoord.w;
+	vec2 uv = shadowCoord.st * 0.5 + 0.5;
+	if (shadowCoord.z <= -1.0 || shadowCoord.z >= 1.0 || any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+	{
+		return 1.0;
+	}
+	return mix(0.3, 1.0, texture(samplerShadowMap, vec4(uv * rect.zw + rect.xy, layer, shadowCoord.z)));
+}
+
+void main()
+{
+	vec4 color = texture(samplerColor, inUV) * drawData.colorFactor;
+	if ((ENABLE_DISCARD == 1) && (color.a < 0.5))
+	{
+		discard;
+	}
+	// Metals have no diffuse reflection
+	float metaliness = texture(samplerMetaliness, inUV).r * drawData.materialFactors.y;
+	vec3 albedo = color.rgb * (1.0 - metaliness);
+	vec3 N = normalize(inNormal);
+	// Alpha tested meshes are drawn without culling, their back faces are lit from the side they're seen from
+	if (!gl_FrontFacing)
+	{
+		N = -N;
+	}
+
+	vec3 light = vec3(0.0);
+
+	// The sun's cascades follow the camera, only the widest one is likely to contain what the probe sees
+	if (ubo.sunEnabled == 1)
+	{
+		vec3 L = normalize(-ubo.sunDirection.xyz);
+		float NdotL = max(dot(N, L), 0.0);
+		if (NdotL > 0.0)
+		{
+			float shadowFactor = shadowMap(SHADOW_CASCADE_COUNT, ubo.cascadeViewProj[SHADOW_CASCADE_COUNT - 1], inWorldPos, vec4(0.0, 0.0, 1.0, 1.0));
+			light += ubo.sunColor.rgb * ubo.sunColor.a * NdotL * shadowFactor;
+		}
+	}
+
+	for (int i = 0; i < SHADOW_LIGHT_COUNT; ++i)
+	{
+		// Light doesn't reach into the camera's view, culled on the CPU
+		if (ubo.lights[i].lightParams.x < 0.0)
+		{
+			continue;
+		}
+		vec3 L = ubo.lights[i].position.xyz - inWorldPos;
+		float dist = length(L);
+		L = L / dist;
+		float NdotL = max(dot(N, L), 0.0);
+		float atten;
+		if (ubo.lights[i].lightParams.x == 0.0)
+		{
+			atten = ubo.lights[i].lightParams.y / (dist * dist + 1.0);
+		}
+		else
+		{
+			float spotEffect = smoothstep(ubo.lights[i].lightParams.w, ubo.lights[i].lightParams.z, dot(normalize(-ubo.lights[i].dir.xyz), L));
+			atten = spotEffect * smoothstep(ubo.lights[i].lightParams.y, 0.0, dist);
+			if ((atten <= 0.0) || (NdotL <= 0.0))
+			{
+				continue;
+			}
+			atten *= shadowMap(0, ubo.lights[i].lightSpace, inWorldPos, ubo.lights[i].atlasRect);
+		}
+		light += ubo.lights[i].color.rgb * atten * NdotL;
+	}
+
+	// Same diffuse terms as the composition's BRDF and ambient light
+	vec3 radiance = albedo * light + albedo * textureLod(samplerIrradiance, N, 0.0).rgb * AMBIENT_FACTOR;
+	outColor = vec4(radiance, 1.0);
+}
@@ -0,0 +1,57 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Scene meshes as seen from the reflection probe through one of its cube faces, see updateReflectionProbe
+// Same vertex streams as the G-Buffer pass (mrt.vert), the material set 0 and draw data set 1 are the scene's
+
+layout (location = 0) in vec4 inPos;
+layout (location = 1) in vec2 inUV;
+// Octahedral encoded unit vectors
+layout (location = 3) in vec2 inNormal;
+// Placement of the mesh instance
+layout (location = 5) in mat4 inInstanceTransform;
+#ifdef BINDLESS_MATERIALS
+layout (location = 9) in uint inInstanceMaterial;
+#endif
+
+layout (set = 2, binding = 0) uniform FaceUBO
+{
+	// Maps world space to the clip space of the face, the texels' directions match the cube map's faces
+	mat4 viewProjection;
+} face;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec2 outUV;
+layout (location = 3) out vec3 outWorldPos;
+#ifdef BINDLESS_MATERIALS
+layout (location = 6) flat out uint outMaterial;
+#endif
+
+// Inverse of packOctahedral on the CPU side
+vec3 octDecode(vec2 e)
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+	{
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(v);
+}
+
+void main()
+{
+	vec4 pos = inInstanceTransform * inPos;
+	gl_Position = face.viewProjection * pos;
+
+	outUV = inUV;
+	outUV.t = 1.0 - outUV.t;
+	outWorldPos = pos.xyz;
+	// The scene's model matrix is the identity, so the world space normal only needs the instance's rotation
+	outNormal = mat3(inInstanceTransform) * octDecode(inNormal);
+
+#ifdef BINDLESS_MATERIALS
+	outMaterial = inInstanceMaterial;
+#endif
+}
@@ -7,18 +7,37 @@ layout (binding = 1) uniform sampler2D samplerSky;
 
 layout (location = 0) in vec2 inUV;
 
+// Compiled with FORWARD defined for the Forward+ pass, which only has a color target and doesn't light the sky either
+#ifdef FORWARD
+layout (location = 0) out vec4 outFragColor;
+#else
 layout (location = 0) out vec4 outPosition;
 layout (location = 1) out vec4 outNormal;
 layout (location = 2) out uvec4 outAlbedo;
+#endif
+
+layout (constant_id = 0) const int COMPACT_GBUFFER = 0;
 
 void main() 
 {
 	vec4 color = texture(samplerSky, inUV);
 
-	outAlbedo.r = packHalf2x16(color.rg);
-	outAlbedo.g = packHalf2x16(color.ba);
-	outAlbedo.b = 0;
+#ifdef FORWARD
+	outFragColor = vec4(color.rgb, 1.0);
+#else
+
+	if (COMPACT_GBUFFER == 1)
+	{
+		outAlbedo = uvec4(packUnorm4x8(color), 0, 0, 0);
+	}
+	else
+	{
+		outAlbedo.r = packHalf2x16(color.rg);
+		outAlbedo.g = packHalf2x16(color.ba);
+		outAlbedo.b = 0;
+	}
 
 	outNormal = vec4(0.0);
 	outPosition = vec4(0.0);
+#endif
 }
\ No newline at end of file
@@ -15,6 +15,9 @@ layout (binding = 0) uniform UBO
 
 layout (location = 0) out vec2 outUV;
 
+// Depth buffer value of the far plane, 0 with a reversed depth
+layout (constant_id = 0) const float FAR_DEPTH = 1.0;
+
 out gl_PerVertex 
 {
 	vec4 gl_Position;
@@ -24,5 +27,7 @@ void main()
 {
 	outUV = inUV;
 	outUV.y *= -1.0;
-	gl_Position = ubo.projection * mat4(mat3(ubo.view)) * mat4(mat3(ubo.model)) * vec4(inPos.xyz, 1.0);
+	// Depth is kept at the far plane, so the sky only passes the depth test where no geometry has been drawn
+	gl_Position = (ubo.projection * mat4(mat3(ubo.view)) * mat4(mat3(ubo.model)) * vec4(inPos.xyz, 1.0)).xyww;
+	gl_Position.z *= FAR_DEPTH;
 }
@@ -10,6 +10,8 @@ layout (binding = 2) uniform sampler2D ssaoNoise;
 layout (constant_id = 0) const int SSAO_KERNEL_SIZE = 64;
 layout (constant_id = 1) const float SSAO_RADIUS = 0.5;
 layout (constant_id = 2) const float SSAO_POWER = 1.0;
+// Compact G-Buffer: linear depth and octahedral normals
+layout (constant_id = 3) const int COMPACT_GBUFFER = 0;
 
 layout (binding = 3) uniform UBOSSAOKernel
 {
@@ -19,22 +21,59 @@ layout (binding = 3) uniform UBOSSAOKernel
 layout (binding = 4) uniform UBO 
 {
 	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec2 viewportDim;
+	// Part of the G-Buffer covered by the screen with dynamic resolution
+	vec2 renderScale;
 } ubo;
 
 layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out float outFragColor;
 
+// Octahedral normal decoding for the compact G-Buffer
+vec3 decodeNormal(vec2 f)
+{
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.y += (n.y >= 0.0) ? -t : t;
+	return normalize(n);
+}
+
+// Rebuild the view space position from the linear depth of the compact G-Buffer
+vec3 viewPositionFromDepth(vec2 uv, float depth)
+{
+	vec2 ndc = uv * 2.0 - 1.0;
+	// The projection's upper 2x2 also contains the pre-rotation of the swap chain
+	return vec3(inverse(mat2(ubo.projection)) * ndc * depth, -depth);
+}
+
 void main() 
 {
 	// Get G-Buffer values
-	vec3 fragPos = texture(samplerPositionDepth, inUV).rgb;
-	vec3 normal = normalize(texture(samplerNormal, inUV).rgb * 2.0 - 1.0);
-
-	// Get a random vector using a noise lookup
+	// Rendered at a lower resolution, so fetch the nearest texel instead of blending positions across edges
 	ivec2 texDim = textureSize(samplerPositionDepth, 0); 
+	ivec2 texel = ivec2(inUV * ubo.renderScale * vec2(texDim));
+	vec3 fragPos;
+	vec3 normal;
+	if (COMPACT_GBUFFER == 1)
+	{
+		vec2 texelUV = (vec2(texel) + 0.5) / (vec2(texDim) * ubo.renderScale);
+		fragPos = viewPositionFromDepth(texelUV, texelFetch(samplerPositionDepth, texel, 0).r);
+		normal = decodeNormal(texelFetch(samplerNormal, texel, 0).rg);
+	}
+	else
+	{
+		vec3 worldPos = texelFetch(samplerPositionDepth, texel, 0).rgb;
+		fragPos = (ubo.view * ubo.model * vec4(worldPos, 1.0)).xyz;
+		normal = normalize(texelFetch(samplerNormal, texel, 0).rgb * 2.0 - 1.0);
+	}
+
+	// Get a random vector using a noise lookup, tiled over the target
 	ivec2 noiseDim = textureSize(ssaoNoise, 0);
-	const vec2 noiseUV = vec2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;  
+	const vec2 noiseUV = gl_FragCoord.xy / vec2(noiseDim);  
 	vec3 randomVec = texture(ssaoNoise, noiseUV).xyz * 2.0 - 1.0;
 	
 	// Create TBN matrix
@@ -55,7 +94,8 @@ void main()
 		offset.xyz /= offset.w; 
 		offset.xyz = offset.xyz * 0.5f + 0.5f; 
 		
-		float sampleDepth = -texture(samplerPositionDepth, offset.xy).w; 
+		vec4 samplePositionDepth = texture(samplerPositionDepth, min(offset.xy, 1.0) * ubo.renderScale);
+		float sampleDepth = -((COMPACT_GBUFFER == 1) ? samplePositionDepth.r : samplePositionDepth.w); 
 
 #define RANGE_CHECK 1
 #ifdef RANGE_CHECK
@@ -71,4 +111,3 @@ void main()
 	  
 	outFragColor = occlusion;
 }
-
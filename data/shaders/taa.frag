@@ -0,0 +1,198 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (binding = 0) uniform sampler2D samplerSceneColor;
+layout (binding = 1) uniform sampler2D samplerHistory;
+layout (binding = 2) uniform sampler2D samplerPositionDepth;
+
+layout (binding = 3) uniform UBO 
+{
+	// Unjittered projection * view * model of this and the previous frame
+	mat4 viewProjection;
+	mat4 previousViewProjection;
+	// Inverse of view * model
+	mat4 inverseView;
+	// x, y - scale of the unjittered projection, z - far plane, w - weight of the current frame
+	vec4 params;
+	// Offset of the projection in normalized device coordinates
+	vec2 jitter;
+	// Part of the G-Buffer covered by the screen with dynamic resolution
+	vec2 renderScale;
+	// Part of the scene color and history targets covered by the screen, they keep their size if the window shrinks
+	vec2 targetScale;
+	// Cosine and sine of the swap chain's pre-rotation, which the projection includes
+	vec2 preRotation;
+	// Rendered part of the scene color in pixels when it's upscaled
+	vec2 inputExtent;
+	// Set if the scene color has been rendered at the G-Buffer's resolution and is reconstructed at the screen's
+	uint upscaling;
+} ubo;
+
+// Linear depth is stored in the first channel of the compact G-Buffer
+layout (constant_id = 0) const int COMPACT_GBUFFER = 0;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+// rgb - resolved color, a - linear depth of the surface the upscaling tests the reprojection against
+layout (location = 1) out vec4 outHistory;
+
+// Reprojected history whose depth differs by more than this share from the surface's is treated as disoccluded by the upscaling
+#define DISOCCLUSION_THRESHOLD 0.05
+
+// Linear depth of a G-Buffer texel, the sky has none and is put on the far plane
+float texelDepth(vec4 gBuffer)
+{
+	float depth = (COMPACT_GBUFFER == 1) ? gBuffer.r : gBuffer.w;
+	return (depth > 0.0) ? depth : ubo.params.z;
+}
+
+// Position of the pixel's surface in the space of the scene's vertices
+// The sky has no position in the G-Buffer and is put on the far plane, so it only moves with the camera's rotation
+// With upscaling the nearest surface of the 3x3 G-Buffer texels around the pixel is taken, so the edges of the foreground
+// follow its motion instead of the background's where the lower resolution doesn't resolve them
+vec3 surfacePosition()
+{
+	ivec2 texDim = textureSize(samplerPositionDepth, 0);
+	ivec2 texMax = ivec2(vec2(texDim) * ubo.renderScale) - 1;
+	ivec2 texel = min(ivec2(inUV * ubo.renderScale * vec2(texDim)), texMax);
+	vec4 gBuffer = texelFetch(samplerPositionDepth, texel, 0);
+	if (ubo.upscaling == 1)
+	{
+		float nearestDepth = texelDepth(gBuffer);
+		for (int y = -1; y <= 1; y++)
+		{
+			for (int x = -1; x <= 1; x++)
+			{
+				vec4 neighbor = texelFetch(samplerPositionDepth, clamp(texel + ivec2(x, y), ivec2(0), texMax), 0);
+				float neighborDepth = texelDepth(neighbor);
+				if (neighborDepth < nearestDepth)
+				{
+					nearestDepth = neighborDepth;
+					gBuffer = neighbor;
+				}
+			}
+		}
+	}
+	float depth = gBuffer.r;
+	if (COMPACT_GBUFFER == 0)
+	{
+		// World positions with the linear depth in w, which is zero for the sky
+		if (gBuffer.w > 0.0)
+		{
+			return gBuffer.xyz;
+		}
+		depth = 0.0;
+	}
+	if (depth <= 0.0)
+	{
+		depth = ubo.params.z;
+	}
+	// The G-Buffer has been rendered with the jittered projection
+	vec2 ndc = inUV * 2.0 - 1.0 - ubo.jitter;
+	ndc = mat2(ubo.preRotation.x, -ubo.preRotation.y, ubo.preRotation.y, ubo.preRotation.x) * ndc;
+	vec3 viewPos = vec3(ndc.x * depth / ubo.params.x, ndc.y * depth / ubo.params.y, -depth);
+	return (ubo.inverseView * vec4(viewPos, 1.0)).xyz;
+}
+
+void main() 
+{
+	vec3 color;
+	vec3 neighborhoodMin;
+	vec3 neighborhoodMax;
+	// Share of the current frame's reconstruction, lower where none of its samples is close to the pixel
+	float sampleWeight = 1.0;
+	if (ubo.upscaling == 1)
+	{
+		// Each texel of the scene color has been shaded at its center moved by the jitter, the pixel is reconstructed from the
+		// 3x3 samples around it weighted by their distance (a gaussian close to the Lanczos filter within a texel)
+		vec2 inputPos = inUV * ubo.inputExtent + ubo.jitter * 0.5 * ubo.inputExtent;
+		ivec2 inputTexel = ivec2(inputPos);
+		ivec2 texMax = ivec2(ubo.inputExtent) - 1;
+		vec3 colorSum = vec3(0.0);
+		float weightSum = 0.0;
+		sampleWeight = 0.0;
+		neighborhoodMin = vec3(1.0e30);
+		neighborhoodMax = vec3(-1.0e30);
+		for (int y = -1; y <= 1; y++)
+		{
+			for (int x = -1; x <= 1; x++)
+			{
+				ivec2 texel = clamp(inputTexel + ivec2(x, y), ivec2(0), texMax);
+				vec3 neighbor = texelFetch(samplerSceneColor, texel, 0).rgb;
+				vec2 offset = vec2(texel) + 0.5 - inputPos;
+				float weight = exp(-2.29 * dot(offset, offset));
+				colorSum += neighbor * weight;
+				weightSum += weight;
+				sampleWeight = max(sampleWeight, weight);
+				neighborhoodMin = min(neighborhoodMin, neighbor);
+				neighborhoodMax = max(neighborhoodMax, neighbor);
+			}
+		}
+		color = colorSum / weightSum;
+	}
+	else
+	{
+		ivec2 texel = ivec2(gl_FragCoord.xy);
+		ivec2 texMax = ivec2(vec2(textureSize(samplerSceneColor, 0)) * ubo.targetScale + 0.5) - 1;
+		color = texelFetch(samplerSceneColor, texel, 0).rgb;
+
+		// History is clamped to the range of the 3x3 neighborhood, which rejects most of the disoccluded and changed pixels
+		neighborhoodMin = color;
+		neighborhoodMax = color;
+		for (int y = -1; y <= 1; y++)
+		{
+			for (int x = -1; x <= 1; x++)
+			{
+				vec3 neighbor = texelFetch(samplerSceneColor, clamp(texel + ivec2(x, y), ivec2(0), texMax), 0).rgb;
+				neighborhoodMin = min(neighborhoodMin, neighbor);
+				neighborhoodMax = max(neighborhoodMax, neighbor);
+			}
+		}
+	}
+
+	// Reproject the surface into the previous frame
+	vec3 position = surfacePosition();
+	vec4 current = ubo.viewProjection * vec4(position, 1.0);
+	vec4 previous = ubo.previousViewProjection * vec4(position, 1.0);
+	float feedback = ubo.params.w;
+	vec2 historyUV = inUV;
+	if (previous.w > 0.0)
+	{
+		historyUV -= (current.xy / current.w - previous.xy / previous.w) * 0.5;
+	}
+	else
+	{
+		feedback = 1.0;
+	}
+	if (any(lessThan(historyUV, vec2(0.0))) || any(greaterThan(historyUV, vec2(1.0))))
+	{
+		// Off screen in the previous frame
+		feedback = 1.0;
+	}
+
+	// Filtering must not pick up texels of the history target outside of the screen
+	vec2 historyTexelUV = min(historyUV * ubo.targetScale, ubo.targetScale - 0.5 / vec2(textureSize(samplerHistory, 0)));
+	vec4 history = texture(samplerHistory, historyTexelUV);
+	if ((ubo.upscaling == 1) && (feedback < 1.0))
+	{
+		// The neighborhood of the lower resolution samples is too coarse to reject everything that was hidden in the previous frame,
+		// the history is dropped where the previous frame's nearest surface isn't this one
+		float historyDepth = texelFetch(samplerHistory, ivec2(historyTexelUV * vec2(textureSize(samplerHistory, 0))), 0).a;
+		if (abs(historyDepth - previous.w) > DISOCCLUSION_THRESHOLD * previous.w)
+		{
+			feedback = 1.0;
+		}
+		else
+		{
+			// Pixels without a close sample this frame keep more of their history
+			feedback *= sampleWeight;
+		}
+	}
+	vec3 result = mix(clamp(history.rgb, neighborhoodMin, neighborhoodMax), color, feedback);
+
+	outFragColor = vec4(result, 1.0);
+	outHistory = vec4(result, current.w);
+}
@@ -0,0 +1,53 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inWorldNormal;
+layout (location = 2) in vec3 inWorldPos;
+layout (location = 3) in float inViewDepth;
+
+layout (location = 0) out vec4 outPosition;
+layout (location = 1) out vec4 outNormal;
+layout (location = 2) out uvec4 outAlbedo;
+
+// Same as mrt.frag
+layout (constant_id = 3) const int COMPACT_GBUFFER = 0;
+
+vec2 signNotZero(vec2 v)
+{
+	return vec2((v.x >= 0.0) ? 1.0 : -1.0, (v.y >= 0.0) ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n)
+{
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	return (n.z >= 0.0) ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+}
+
+void main() 
+{
+	// There is no terrain material, grass on flat ground and rock on steep slopes
+	float flatness = smoothstep(0.75, 0.9, -normalize(inWorldNormal).y);
+	vec4 color = vec4(mix(vec3(0.3, 0.28, 0.25), vec3(0.18, 0.24, 0.1), flatness), 1.0);
+	float roughness = 0.9;
+	float metaliness = 0.0;
+	vec3 normal = normalize(inNormal);
+
+	if (COMPACT_GBUFFER == 1)
+	{
+		outPosition = vec4(inViewDepth);
+		outNormal = vec4(encodeNormal(normal), 0.0, 0.0);
+		outAlbedo = uvec4(packUnorm4x8(color), packUnorm4x8(vec4(roughness, metaliness, 0.0, 0.0)), 0, 0);
+	}
+	else
+	{
+		outPosition = vec4(inWorldPos, inViewDepth);
+		outNormal = vec4(normal * 0.5 + 0.5, 0.0);
+		outAlbedo.r = packHalf2x16(color.rg);
+		outAlbedo.g = packHalf2x16(color.ba);
+		outAlbedo.b = packHalf2x16(vec2(roughness, 0.0));
+		outAlbedo.a = packHalf2x16(vec2(metaliness, 0.0));
+	}
+}
@@ -0,0 +1,15 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Quadtree patch (see HeightMap::Patch), one single vertex patch per instance
+// xy: offset, z: size in normalized heightmap coordinates, w: coarser neighbour edges
+layout (location = 0) in vec4 inPatch;
+
+layout (location = 0) out vec4 outPatch;
+
+void main() 
+{
+	outPatch = inPatch;
+}
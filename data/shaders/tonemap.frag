@@ -0,0 +1,61 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Scene color (or the resolved history with temporal anti-aliasing) in linear HDR
+layout (binding = 0) uniform sampler2D samplerSceneColor;
+// First level of the bloom chain, which has all lower levels added to it
+layout (binding = 1) uniform sampler2D samplerBloom;
+
+#define HISTOGRAM_BINS 256
+
+// Written by the automatic exposure (see exposure.comp), stays at one if it's disabled
+layout (binding = 2) readonly buffer Exposure
+{
+	uint histogram[HISTOGRAM_BINS];
+	float exposure;
+	float averageLuminance;
+} exposureBuffer;
+
+// Swap chain formats that convert to sRGB on write don't need the gamma curve applied
+layout (constant_id = 0) const int GAMMA_CORRECT = 1;
+
+layout (push_constant) uniform PushConsts {
+	// Part of the bloom level covered by the screen
+	vec2 bloomScale;
+	// Exposure compensation on top of the automatic exposure
+	float exposure;
+	float bloomIntensity;
+} pushConsts;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+// Fitted ACES filmic curve (Krzysztof Narkowicz)
+vec3 tonemapACES(vec3 color)
+{
+	const float a = 2.51;
+	const float b = 0.03;
+	const float c = 2.43;
+	const float d = 0.59;
+	const float e = 0.14;
+	return clamp((color * (a * color + b)) / (color * (c * color + d) + e), 0.0, 1.0);
+}
+
+void main() 
+{
+	vec3 color = texelFetch(samplerSceneColor, ivec2(gl_FragCoord.xy), 0).rgb;
+
+	// Filtering must not pick up texels of the bloom level outside of the screen
+	vec2 bloomUV = min(inUV * pushConsts.bloomScale, pushConsts.bloomScale - 0.5 / vec2(textureSize(samplerBloom, 0)));
+	color += texture(samplerBloom, bloomUV).rgb * pushConsts.bloomIntensity;
+
+	color = tonemapACES(color * pushConsts.exposure * exposureBuffer.exposure);
+	if (GAMMA_CORRECT == 1)
+	{
+		color = pow(color, vec3(1.0 / 2.2));
+	}
+	outFragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,45 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Visibility buffer pass, stores the triangle's index in the scene's index buffer and the instance with its material
+// Alpha tested meshes discard with the same threshold as the depth prepass
+
+// Must match SCENE_MAX_MATERIAL_TEXTURES
+#define MAX_MATERIAL_TEXTURES 256
+
+struct Material
+{
+	uint diffuse;
+	uint roughness;
+	uint normal;
+	uint metaliness;
+};
+
+// Textures of all materials, indexed through the material table
+layout (binding = 1) uniform sampler samplerMaterial;
+layout (binding = 2) uniform texture2D materialTextures[MAX_MATERIAL_TEXTURES];
+layout (binding = 3, std430) readonly buffer MaterialTable
+{
+	Material materials[];
+};
+
+layout (location = 1) in vec2 inUV;
+layout (location = 6) flat in uint inMaterial;
+layout (location = 7) flat in uint inFirstTriangle;
+layout (location = 8) flat in uint inInstance;
+
+layout (location = 0) out uvec2 outVisibility;
+
+layout (constant_id = 0) const int ENABLE_DISCARD = 0;
+
+void main() 
+{
+	if ((ENABLE_DISCARD == 1) && (texture(sampler2D(materialTextures[materials[inMaterial].diffuse], samplerMaterial), inUV).a < 0.5))
+	{
+		discard;
+	}
+	// The material goes into the upper 8 bits, so the resolve's draw of each material can reject the other pixels without further reads
+	outVisibility = uvec2(inFirstTriangle + uint(gl_PrimitiveID), inInstance | (inMaterial << 24));
+}
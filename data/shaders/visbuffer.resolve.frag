@@ -0,0 +1,275 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Resolve of the visibility buffer into the G-Buffer, drawn once per material over the whole screen
+// The attributes of each pixel's triangle are rebuilt from the scene's vertex and index buffers, so the textures are only sampled
+// once per pixel however often the scene overdraws it
+// Each draw only shades the pixels of its material, which keeps the texture array index dynamically uniform
+
+// Must match SCENE_MAX_MATERIAL_TEXTURES
+#define MAX_MATERIAL_TEXTURES 256
+
+struct Material
+{
+	uint diffuse;
+	uint roughness;
+	uint normal;
+	uint metaliness;
+};
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec2 viewportDim;
+	vec2 renderScale;
+	// Precomputed on the CPU once per frame
+	mat4 modelViewProjection;
+	mat4 modelView;
+	mat4 normalMatrix;
+} ubo;
+
+// Textures of all materials, indexed through the material table
+layout (binding = 1) uniform sampler samplerMaterial;
+layout (binding = 2) uniform texture2D materialTextures[MAX_MATERIAL_TEXTURES];
+layout (binding = 3, std430) readonly buffer MaterialTable
+{
+	Material materials[];
+};
+
+// Must match SceneInstance
+struct Instance
+{
+	mat4 transform;
+	uint material;
+	uint vertexOffset;
+	uint pad0;
+	uint pad1;
+};
+
+// Positions of all vertices followed by their packed attributes (see PackedVertex) at attributeOffset
+layout (set = 1, binding = 0, std430) readonly buffer Vertices
+{
+	uint vertexData[];
+};
+// 16 bit indices are stored two per word
+layout (set = 1, binding = 1, std430) readonly buffer Indices
+{
+	uint indices[];
+};
+layout (set = 1, binding = 2, std430) readonly buffer Instances
+{
+	Instance instances[];
+};
+// Per draw data of all batches, see SceneDrawData
+layout (set = 1, binding = 5, std430) readonly buffer DrawData
+{
+	vec4 drawData[];
+};
+layout (input_attachment_index = 0, set = 1, binding = 6) uniform usubpassInput inputVisibility;
+
+layout (push_constant) uniform PushConsts
+{
+	uint batch;
+	uint firstCommand;
+	uint culledCommands;
+	uint attributeOffset;
+	uint material;
+	uint alphaTested;
+	uint drawDataStride;
+	// Scene indices are 16 bit, decided when the scene is loaded
+	uint index16Bit;
+	vec2 renderExtent;
+} pushConsts;
+
+layout (location = 0) out vec4 outPosition;
+layout (location = 1) out vec4 outNormal;
+layout (location = 2) out uvec4 outAlbedo;
+
+// Compact G-Buffer: linear depth, octahedral normals and 8 bit albedo, roughness and metalness
+layout (constant_id = 0) const int COMPACT_GBUFFER = 0;
+
+// Inverse of packOctahedral on the CPU side
+vec3 octDecode(vec2 e)
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+	{
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(v);
+}
+
+// Octahedral normal encoding, maps the unit sphere to [-1..1]
+vec2 signNotZero(vec2 v)
+{
+	return vec2((v.x >= 0.0) ? 1.0 : -1.0, (v.y >= 0.0) ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n)
+{
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	return (n.z >= 0.0) ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+}
+
+uint loadIndex(uint index)
+{
+	if (pushConsts.index16Bit == 1)
+	{
+		uint word = indices[index >> 1];
+		return ((index & 1) == 1) ? (word >> 16) : (word & 0xFFFF);
+	}
+	return indices[index];
+}
+
+vec3 loadPosition(uint vertex)
+{
+	return uintBitsToFloat(uvec3(vertexData[vertex * 3], vertexData[vertex * 3 + 1], vertexData[vertex * 3 + 2]));
+}
+
+// Perspective correct barycentrics of the pixel in a triangle and their screen space derivatives, from the corners' clip space positions
+// The derivatives of the interpolated attributes select the texture mip levels like the rasterizer's do
+struct Barycentrics
+{
+	vec3 lambda;
+	vec3 ddx;
+	vec3 ddy;
+};
+
+Barycentrics computeBarycentrics(vec4 p0, vec4 p1, vec4 p2, vec2 ndc)
+{
+	Barycentrics result;
+	vec3 invW = 1.0 / vec3(p0.w, p1.w, p2.w);
+	vec2 ndc0 = p0.xy * invW.x;
+	vec2 ndc1 = p1.xy * invW.y;
+	vec2 ndc2 = p2.xy * invW.z;
+
+	// Screen space barycentrics divided by w are linear in normalized device coordinates
+	float invDet = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+	vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+	vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+	float ddxSum = dot(ddx, vec3(1.0));
+	float ddySum = dot(ddy, vec3(1.0));
+
+	vec2 delta = ndc - ndc0;
+	float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+	float interpW = 1.0 / interpInvW;
+	result.lambda = interpW * (vec3(invW.x, 0.0, 0.0) + delta.x * ddx + delta.y * ddy);
+
+	// One pixel steps in normalized device coordinates
+	vec2 pixelSize = 2.0 / pushConsts.renderExtent;
+	ddx *= pixelSize.x;
+	ddy *= pixelSize.y;
+	ddxSum *= pixelSize.x;
+	ddySum *= pixelSize.y;
+	result.ddx = (1.0 / (interpInvW + ddxSum)) * (result.lambda * interpInvW + ddx) - result.lambda;
+	result.ddy = (1.0 / (interpInvW + ddySum)) * (result.lambda * interpInvW + ddy) - result.lambda;
+	return result;
+}
+
+vec2 interpolate(vec3 weights, vec2 a, vec2 b, vec2 c)
+{
+	return a * weights.x + b * weights.y + c * weights.z;
+}
+
+vec3 interpolate(vec3 weights, vec3 a, vec3 b, vec3 c)
+{
+	return a * weights.x + b * weights.y + c * weights.z;
+}
+
+void main() 
+{
+	uvec2 visibility = subpassLoad(inputVisibility).xy;
+	// Pixels without a triangle keep the cleared ID and are left to the terrain and the sky sphere
+	if ((visibility.x == 0xFFFFFFFF) || ((visibility.y >> 24) != pushConsts.material))
+	{
+		discard;
+	}
+	Instance instance = instances[visibility.y & 0xFFFFFF];
+
+	vec3 positions[3];
+	vec4 clipPositions[3];
+	vec2 uvs[3];
+	vec3 normals[3];
+	vec3 tangents[3];
+	for (uint i = 0; i < 3; i++)
+	{
+		uint vertex = loadIndex(visibility.x * 3 + i) + instance.vertexOffset;
+		positions[i] = (instance.transform * vec4(loadPosition(vertex), 1.0)).xyz;
+		clipPositions[i] = ubo.modelViewProjection * vec4(positions[i], 1.0);
+		uint attributes = pushConsts.attributeOffset + vertex * 3;
+		uvs[i] = unpackHalf2x16(vertexData[attributes]);
+		uvs[i].t = 1.0 - uvs[i].t;
+		normals[i] = octDecode(unpackSnorm2x16(vertexData[attributes + 1]));
+		tangents[i] = octDecode(unpackSnorm2x16(vertexData[attributes + 2]));
+	}
+
+	vec2 ndc = (gl_FragCoord.xy / pushConsts.renderExtent) * 2.0 - 1.0;
+	Barycentrics barycentrics = computeBarycentrics(clipPositions[0], clipPositions[1], clipPositions[2], ndc);
+
+	vec3 worldPos = interpolate(barycentrics.lambda, positions[0], positions[1], positions[2]);
+	vec2 uv = interpolate(barycentrics.lambda, uvs[0], uvs[1], uvs[2]);
+	vec2 uvDx = interpolate(barycentrics.ddx, uvs[0], uvs[1], uvs[2]);
+	vec2 uvDy = interpolate(barycentrics.ddy, uvs[0], uvs[1], uvs[2]);
+
+	// Linear view space depth, equal to the linearized depth of the G-Buffer pass
+	float viewDepth = -(ubo.modelView * vec4(worldPos, 1.0)).z;
+	if (COMPACT_GBUFFER == 1)
+	{
+		outPosition = vec4(viewDepth);
+	}
+	else
+	{
+		outPosition = vec4(worldPos, viewDepth);
+	}
+
+	Material material = materials[pushConsts.material];
+	vec4 colorFactor = drawData[pushConsts.batch * pushConsts.drawDataStride];
+	vec4 materialFactors = drawData[pushConsts.batch * pushConsts.drawDataStride + 1];
+	vec4 color = textureGrad(sampler2D(materialTextures[material.diffuse], samplerMaterial), uv, uvDx, uvDy) * colorFactor;
+
+	// Normal and tangent in view space, the G-Buffer stores view space normals
+	mat3 normalMatrix = mat3(ubo.normalMatrix) * mat3(instance.transform);
+	vec3 N = normalize(normalMatrix * interpolate(barycentrics.lambda, normals[0], normals[1], normals[2]));
+	vec3 normal = N;
+	// Alpha tested materials aren't normal mapped, like in the G-Buffer pass
+	if (pushConsts.alphaTested == 0)
+	{
+		vec3 T = normalize(normalMatrix * interpolate(barycentrics.lambda, tangents[0], tangents[1], tangents[2]));
+		vec3 B = cross(N, T);
+		mat3 TBN = mat3(T, B, N);
+		// Normal maps only store x and y, see mrt.frag
+		vec3 nm;
+		nm.xy = textureGrad(sampler2D(materialTextures[material.normal], samplerMaterial), uv, uvDx, uvDy).xy * 2.0 - vec2(1.0);
+		nm.z = sqrt(max(1.0 - dot(nm.xy, nm.xy), 0.0));
+		normal = TBN * normalize(nm);
+	}
+
+	if (COMPACT_GBUFFER == 1)
+	{
+		outNormal = vec4(encodeNormal(normalize(normal)), 0.0, 0.0);
+	}
+	else
+	{
+		outNormal = vec4(normal * 0.5 + 0.5, 0.0);
+	}
+
+	// Pack
+	float roughness = textureGrad(sampler2D(materialTextures[material.roughness], samplerMaterial), uv, uvDx, uvDy).r * materialFactors.x;
+	float metaliness = textureGrad(sampler2D(materialTextures[material.metaliness], samplerMaterial), uv, uvDx, uvDy).r * materialFactors.y;
+
+	if (COMPACT_GBUFFER == 1)
+	{
+		outAlbedo = uvec4(packUnorm4x8(color), packUnorm4x8(vec4(roughness, metaliness, 0.0, 0.0)), 0, 0);
+	}
+	else
+	{
+		outAlbedo.r = packHalf2x16(color.rg);
+		outAlbedo.g = packHalf2x16(color.ba);
+		outAlbedo.b = packHalf2x16(vec2(roughness, 0.0));
+		outAlbedo.a = packHalf2x16(vec2(metaliness, 0.0));
+	}
+}
@@ -0,0 +1,85 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+#extension GL_ARB_shader_draw_parameters : enable
+
+// Visibility buffer pass, the scene is only transformed and each pixel stores the ID of its triangle and instance
+// The texture coordinates are passed on for the alpha test of alpha tested meshes
+
+layout (location = 0) in vec4 inPos;
+layout (location = 1) in vec2 inUV;
+// Placement of the mesh instance
+layout (location = 5) in mat4 inInstanceTransform;
+layout (location = 9) in uint inInstanceMaterial;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec2 viewportDim;
+	vec2 renderScale;
+	// Precomputed on the CPU once per frame
+	mat4 modelViewProjection;
+	mat4 modelView;
+	mat4 normalMatrix;
+} ubo;
+
+struct IndexedIndirectCommand 
+{
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+// The scene's static commands and the commands written by the culling, see VisibilityPushConstants
+layout (set = 1, binding = 3, std430) readonly buffer SceneCommands
+{
+	IndexedIndirectCommand sceneCommands[];
+};
+layout (set = 1, binding = 4, std430) readonly buffer CulledCommands
+{
+	IndexedIndirectCommand culledCommands[];
+};
+
+layout (push_constant) uniform PushConsts
+{
+	uint batch;
+	uint firstCommand;
+	uint culledCommands;
+	uint attributeOffset;
+	uint material;
+	uint alphaTested;
+	uint drawDataStride;
+	// Scene indices are 16 bit, decided when the scene is loaded
+	uint index16Bit;
+	vec2 renderExtent;
+} pushConsts;
+
+layout (location = 1) out vec2 outUV;
+layout (location = 6) flat out uint outMaterial;
+layout (location = 7) flat out uint outFirstTriangle;
+layout (location = 8) flat out uint outInstance;
+
+// Must match the resolve's reconstruction from the same matrix
+invariant gl_Position;
+
+void main() 
+{
+	vec4 pos = inInstanceTransform * inPos;
+	gl_Position = ubo.modelViewProjection * pos;
+
+	outUV = inUV;
+	outUV.t = 1.0 - outUV.t;
+	outMaterial = inInstanceMaterial;
+
+	// Primitive IDs restart at zero for every command of a multi draw, so the command's first index is added to them
+	uint command = pushConsts.firstCommand + gl_DrawIDARB;
+	uint firstIndex = (pushConsts.culledCommands == 1) ? culledCommands[command].firstIndex : sceneCommands[command].firstIndex;
+	outFirstTriangle = firstIndex / 3;
+	// Includes the command's first instance
+	outInstance = gl_InstanceIndex;
+}
@@ -1,7 +1,16 @@
 /*
 * Vulkan playground for rendering Crytek's Sponza model (deferred renderer)
 *
-* CPU-based particle system
+* GPU-based particle system
+*
+* Particles are simulated by a compute shader in device local storage buffers that are also used as the vertex buffer
+* Emitters are uploaded once, every particle carries its own random number state, so no data is uploaded per frame
+* Particles are sorted back to front by a bitonic sort in a second compute shader, the sorted order is used as the index buffer
+* The simulation collides the particles with the surfaces in the G-Buffer and, off screen, with a coarse distance field of the scene
+*
+* Devices without compute support on the graphics queue use a CPU path instead
+* It keeps the simulation state as structure of arrays updated with 4 wide SIMD (SSE2 or NEON) in batches on the job system,
+* only the vertex data and the sorted indices are uploaded per frame
 *
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
@@ -11,6 +20,16 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define PARTICLE_SIMD_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PARTICLE_SIMD_NEON
+#endif
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -22,178 +41,364 @@
 #include "vulkandevice.hpp"
 #include "vulkanbuffer.hpp"
 #include "vulkantools.h"
+#include "jobsystem.hpp"
 
 #define PARTICLE_TYPE_FLAME 0
 #define PARTICLE_TYPE_SMOKE 1
 #define FLAME_RADIUS 1.0f
-
+// Must match the local size of the particle compute shader
+#define PARTICLE_WORKGROUP_SIZE 256
+// Must match the block size of the particle sort compute shader, the sort is padded to a multiple of this
+#define PARTICLE_SORT_BLOCK_SIZE 512
+// Number of particles updated by a single job of the CPU path, must be a multiple of the SIMD width
+#define PARTICLE_CPU_BATCH_SIZE 1024
+
+// Four wide float operations used by the CPU particle update
+namespace particleSimd
+{
+#if defined(PARTICLE_SIMD_SSE)
+	typedef __m128 float4;
+	inline float4 load(const float *p) { return _mm_loadu_ps(p); }
+	inline void store(float *p, float4 v) { _mm_storeu_ps(p, v); }
+	inline float4 set1(float f) { return _mm_set1_ps(f); }
+	// a * b + c
+	inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	inline bool anyGreater(float4 a, float4 b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)) != 0; }
+#elif defined(PARTICLE_SIMD_NEON)
+	typedef float32x4_t float4;
+	inline float4 load(const float *p) { return vld1q_f32(p); }
+	inline void store(float *p, float4 v) { vst1q_f32(p, v); }
+	inline float4 set1(float f) { return vdupq_n_f32(f); }
+	inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+	inline bool anyGreater(float4 a, float4 b)
+	{
+		uint32x4_t mask = vcgtq_f32(a, b);
+		uint32x2_t lanes = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+		return (vget_lane_u32(lanes, 0) | vget_lane_u32(lanes, 1)) != 0;
+	}
+#else
+	struct float4 { float v[4]; };
+	inline float4 load(const float *p) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+	inline void store(float *p, float4 v) { for (int i = 0; i < 4; i++) p[i] = v.v[i]; }
+	inline float4 set1(float f) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = f; return r; }
+	inline float4 madd(float4 a, float4 b, float4 c) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * b.v[i] + c.v[i]; return r; }
+	inline bool anyGreater(float4 a, float4 b) { return (a.v[0] > b.v[0]) || (a.v[1] > b.v[1]) || (a.v[2] > b.v[2]) || (a.v[3] > b.v[3]); }
+#endif
+}
+
+// A single emitter, its particles are a range of the holder's buffers
 class ParticleSystem
 {
-private:
-	vk::VulkanDevice *device;
 public:
-	struct Particle
-	{
-		glm::vec4 pos;
-		glm::vec4 color;
-		float alpha;
-		float size;
-		float rotation;
-		uint32_t type;
-		// Attributes not used in shader
-		glm::vec4 vel;
-		float rotationSpeed;
-	};
-
-	struct UniformData
-	{
-		glm::mat4 projection;
-		glm::mat4 model;
-		glm::mat4 view;
-		glm::vec2 viewportDim;
-	} uniformData;
-
-	std::vector<Particle> particles;
 	uint32_t particleCount;
+	// Index of the emitter's first particle in the holder's buffers
+	uint32_t firstParticle;
 
 	glm::vec3 position;
 	glm::vec3 minVel;
 	glm::vec3 maxVel;
 
-	vk::Buffer buffer;
-	vk::Buffer uniformBuffer;
-
-	ParticleSystem(vk::VulkanDevice *vkdevice, uint32_t particlecount, glm::vec3 pos, glm::vec3 minvel, glm::vec3 maxvel) :
-		device(vkdevice),
+	ParticleSystem(uint32_t particlecount, uint32_t firstparticle, glm::vec3 pos, glm::vec3 minvel, glm::vec3 maxvel) :
 		particleCount(particlecount),
+		firstParticle(firstparticle),
 		position(pos),
 		minVel(minvel),
 		maxVel(maxvel)
 	{
-		// Create buffer
-		particles.resize(particlecount);
-
-		for (auto& particle : particles)
-		{
-			initParticle(&particle, position);
-		}
-
-		size_t bufferSize = particles.size() * sizeof(Particle);
+	};
+};
 
-		device->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
-			&buffer,
-			bufferSize,
-			particles.data());
+class ParticleSystemHolder
+{
+private:
+	vk::VulkanDevice *device;
 
-		buffer.map();
+	// Emitter as read by the compute shader (std430)
+	struct Emitter
+	{
+		glm::vec4 position;
+		glm::vec4 minVel;
+		glm::vec4 maxVel;
+		uint32_t firstParticle;
+		uint32_t particleCount;
+		uint32_t pad[2];
 	};
 
-	~ParticleSystem()
+	struct PushConstants
 	{
-		buffer.destroy();
-	}
-
-	inline float rnd(float range)
+		float deltaT;
+		uint32_t particleCount;
+		uint32_t emitterCount;
+		// Set for the first dispatch, which spawns all particles
+		uint32_t reset;
+		// See screenCollision and fieldCollision
+		uint32_t screenCollision;
+		uint32_t fieldCollision;
+		uint32_t pad[2];
+		// Maps world space positions to the distance field's texture coordinates, w is the field's voxel size
+		glm::vec4 fieldOrigin;
+		glm::vec4 fieldScale;
+	} pushConstants;
+
+	// Modes of the particle sort compute shader
+	enum SortMode
 	{
-		return range * (rand() / double(RAND_MAX));
-	}
+		SORT_MODE_KEYS = 0,
+		SORT_MODE_LOCAL_SORT = 1,
+		SORT_MODE_LOCAL_MERGE = 2,
+		SORT_MODE_GLOBAL_STEP = 3
+	};
 
-	void initParticle(Particle *particle, glm::vec3 emitterPos)
+	struct SortPushConstants
 	{
-		particle->vel = glm::vec4(0.0f, minVel.y + rnd(maxVel.y - minVel.y), 0.0f, 0.0f);
-		particle->alpha = rnd(0.75f);
-		particle->size = 1.0f + rnd(0.5f);
-		particle->size *= 0.5f;
-		particle->color = glm::vec4(1.0f);
-		particle->type = PARTICLE_TYPE_FLAME;
-		particle->rotation = rnd(2.0f * M_PI);
-		particle->rotationSpeed = rnd(2.0f) - rnd(2.0f);
+		uint32_t mode;
+		// Compare distance and size of the bitonic sequences of the current step
+		uint32_t j;
+		uint32_t k;
+		uint32_t particleCount;
+		uint32_t sortCount;
+	} sortPushConstants;
+
+	// Number of sorted elements, a power of two of at least the sort block size
+	uint32_t sortCount = 0;
+
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	// Shared by the simulation and the sort pipeline
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkPipeline sortPipeline = VK_NULL_HANDLE;
+
+	// Simulation state of the CPU path as structure of arrays, padded to the SIMD width
+	// Velocities and rates are premultiplied with the per type speed factors the compute shader applies
+	struct ParticleStorage
+	{
+		std::vector<float> posX, posY, posZ, layer;
+		std::vector<float> velX, velY, velZ;
+		std::vector<float> alpha, alphaRate;
+		std::vector<float> size, sizeRate;
+		std::vector<float> color, colorRate;
+		std::vector<float> rotation, rotationSpeed;
+		// View space depth, sort key
+		std::vector<float> depth;
+		std::vector<uint32_t> type, emitter, seed;
+		std::vector<uint32_t> order;
+		uint32_t count = 0;
+
+		void resize(uint32_t particleCount)
+		{
+			count = (particleCount + 3) & ~3u;
+			for (auto v : { &posX, &posY, &posZ, &layer, &velX, &velY, &velZ, &alpha, &alphaRate, &size, &sizeRate, &color, &colorRate, &rotation, &rotationSpeed, &depth })
+			{
+				v->assign(count, 0.0f);
+			}
+			type.assign(count, PARTICLE_TYPE_FLAME);
+			emitter.assign(count, 0);
+			seed.assign(count, 0);
+			order.resize(particleCount);
+		}
+	} storage;
 
-		// Get random sphere point
-		float theta = rnd(2 * M_PI);
-		float phi = rnd(M_PI) - M_PI / 2;
-		float r = rnd(FLAME_RADIUS);
+	// Host copies of the vertices and sorted indices, one slot per frame in flight (CPU path)
+	vk::RingBuffer upload;
+	VkDeviceSize uploadVertices = 0;
+	VkDeviceSize uploadIndices = 0;
 
-		particle->pos.x = r * cos(theta) * cos(phi);
-		particle->pos.y = r * sin(phi);
-		particle->pos.z = r * sin(theta) * cos(phi);
+	// Same random number generator as the compute shader (xorshift)
+	static float rnd(uint32_t &seed, float range)
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return range * (float(seed & 0x00FFFFFFu) / float(0x00FFFFFF));
+	}
 
-		particle->pos += glm::vec4(emitterPos, 0.0f);
+	static uint32_t hash(uint32_t x)
+	{
+		x = ((x >> 16) ^ x) * 0x45d9f3bu;
+		x = ((x >> 16) ^ x) * 0x45d9f3bu;
+		return ((x >> 16) ^ x) | 1u;
+	}
 
-		particle->pos.w = rnd(16.0f);
+	void initParticle(uint32_t i)
+	{
+		const ParticleSystem *particleSystem = particleSystems[storage.emitter[i]];
+		uint32_t &seed = storage.seed[i];
+		const float pi = 3.14159265359f;
+		// Flames only rise, 0.45 * 3.5 is the flame's speed factor of the compute shader
+		storage.velX[i] = 0.0f;
+		storage.velY[i] = (particleSystem->minVel.y + rnd(seed, particleSystem->maxVel.y - particleSystem->minVel.y)) * 0.45f * 3.5f;
+		storage.velZ[i] = 0.0f;
+		storage.alpha[i] = rnd(seed, 0.75f);
+		storage.alphaRate[i] = 0.45f * 2.5f;
+		storage.size[i] = (1.0f + rnd(seed, 0.5f)) * 0.5f;
+		storage.sizeRate[i] = 0.45f * -0.5f;
+		storage.color[i] = 1.0f;
+		storage.colorRate[i] = 0.0f;
+		storage.type[i] = PARTICLE_TYPE_FLAME;
+		storage.rotation[i] = rnd(seed, 2.0f * pi);
+		storage.rotationSpeed[i] = (rnd(seed, 2.0f) - rnd(seed, 2.0f)) * 0.45f;
+
+		// Random point in a sphere around the emitter
+		float theta = rnd(seed, 2.0f * pi);
+		float phi = rnd(seed, pi) - pi / 2.0f;
+		float r = rnd(seed, FLAME_RADIUS);
+		storage.posX[i] = particleSystem->position.x + r * cos(theta) * cos(phi);
+		storage.posY[i] = particleSystem->position.y + r * sin(phi);
+		storage.posZ[i] = particleSystem->position.z + r * sin(theta) * cos(phi);
+		storage.layer[i] = rnd(seed, 16.0f);
 	}
 
-	void transitionParticle(Particle *particle)
+	// Flame particles have a chance of turning into smoke, smoke respawns at the end of its life
+	void transitionParticle(uint32_t i)
 	{
-		switch (particle->type)
+		const ParticleSystem *particleSystem = particleSystems[storage.emitter[i]];
+		uint32_t &seed = storage.seed[i];
+		if ((storage.type[i] == PARTICLE_TYPE_FLAME) && (rnd(seed, 1.0f) < 0.015f))
 		{
-		case PARTICLE_TYPE_FLAME:
-			// Flame particles have a chance of turning into smoke
-			if (rnd(1.0f) < 0.015f)
-			{
-				particle->alpha = 0.0f;
-				particle->color = glm::vec4(0.15f + rnd(0.25f));
-				particle->pos.x = position.x + (particle->pos.x - position.x) * 0.5f;
-				particle->pos.z = position.z + (particle->pos.z - position.z) * 0.5f;
-				particle->pos.w = rnd(16.0f);
-				particle->vel = glm::vec4(rnd(1.0f) - rnd(1.0f), (minVel.y * 2) + rnd(maxVel.y - minVel.y), rnd(1.0f) - rnd(1.0f), 0.0f);
-				particle->size = 1.0f + rnd(0.5f);
-				particle->rotationSpeed = rnd(1.0f) - rnd(1.0f);
-				particle->type = PARTICLE_TYPE_SMOKE;
-			}
-			else
-			{
-				initParticle(particle, position);
-			}
-			break;
-		case PARTICLE_TYPE_SMOKE:
-			// Respawn at end of life
-			initParticle(particle, position);
-			break;
+			storage.alpha[i] = 0.0f;
+			storage.alphaRate[i] = 0.45f * 1.25f;
+			storage.color[i] = 0.15f + rnd(seed, 0.25f);
+			storage.colorRate[i] = 0.45f * -0.05f;
+			storage.posX[i] = particleSystem->position.x + (storage.posX[i] - particleSystem->position.x) * 0.5f;
+			storage.posZ[i] = particleSystem->position.z + (storage.posZ[i] - particleSystem->position.z) * 0.5f;
+			storage.layer[i] = rnd(seed, 16.0f);
+			storage.velX[i] = rnd(seed, 1.0f) - rnd(seed, 1.0f);
+			storage.velY[i] = (particleSystem->minVel.y * 2.0f) + rnd(seed, particleSystem->maxVel.y - particleSystem->minVel.y);
+			storage.velZ[i] = rnd(seed, 1.0f) - rnd(seed, 1.0f);
+			storage.size[i] = 1.0f + rnd(seed, 0.5f);
+			storage.sizeRate[i] = 0.45f * 0.125f;
+			storage.rotationSpeed[i] = (rnd(seed, 1.0f) - rnd(seed, 1.0f)) * 0.45f;
+			storage.type[i] = PARTICLE_TYPE_SMOKE;
+		}
+		else
+		{
+			initParticle(i);
 		}
 	}
 
-	void updateParticles(float deltaT)
+	// Step the particles [first, last) and compute their sort keys, first and last are multiples of the SIMD width
+	void updateBatch(uint32_t first, uint32_t last, float deltaT, const glm::mat4 &view)
 	{
-		float particleTimer = deltaT * 0.45f;
-		for (auto& particle : particles)
+		using namespace particleSimd;
+		const float4 dt = set1(deltaT);
+		const float4 negDt = set1(-deltaT);
+		const float4 maxAlpha = set1(2.0f);
+		// Third row of the view matrix, as sort keys only need the view space z
+		const float4 viewX = set1(view[0][2]);
+		const float4 viewY = set1(view[1][2]);
+		const float4 viewZ = set1(view[2][2]);
+		const float4 viewW = set1(view[3][2]);
+		ParticleStorage &p = storage;
+		for (uint32_t i = first; i < last; i += 4)
 		{
-			switch (particle.type)
+			// Up is negative y
+			store(&p.posX[i], madd(load(&p.velX[i]), negDt, load(&p.posX[i])));
+			store(&p.posY[i], madd(load(&p.velY[i]), negDt, load(&p.posY[i])));
+			store(&p.posZ[i], madd(load(&p.velZ[i]), negDt, load(&p.posZ[i])));
+			float4 alpha = madd(load(&p.alphaRate[i]), dt, load(&p.alpha[i]));
+			store(&p.alpha[i], alpha);
+			store(&p.size[i], madd(load(&p.sizeRate[i]), dt, load(&p.size[i])));
+			store(&p.color[i], madd(load(&p.colorRate[i]), dt, load(&p.color[i])));
+			store(&p.rotation[i], madd(load(&p.rotationSpeed[i]), dt, load(&p.rotation[i])));
+			if (anyGreater(alpha, maxAlpha))
 			{
-			case PARTICLE_TYPE_FLAME:
-				particle.pos.y -= particle.vel.y * particleTimer * 3.5f;
-				particle.alpha += particleTimer * 2.5f;
-				particle.size -= particleTimer * 0.5f;
-				break;
-			case PARTICLE_TYPE_SMOKE:
-				particle.pos -= particle.vel * deltaT * 1.0f;
-				particle.alpha += particleTimer * 1.25f;
-				particle.size += particleTimer * 0.125f;
-				particle.color -= particleTimer * 0.05f;
-				break;
-			}
-			particle.rotation += particleTimer * particle.rotationSpeed;
-			// Transition particle state
-			if (particle.alpha > 2.0f)
-			{
-				transitionParticle(&particle);
+				for (uint32_t j = i; j < i + 4; j++)
+				{
+					if ((j < particleCount) && (p.alpha[j] > 2.0f))
+					{
+						transitionParticle(j);
+					}
+				}
 			}
+			float4 depth = madd(load(&p.posX[i]), viewX, viewW);
+			depth = madd(load(&p.posY[i]), viewY, depth);
+			depth = madd(load(&p.posZ[i]), viewZ, depth);
+			store(&p.depth[i], depth);
 		}
-		size_t size = particles.size() * sizeof(Particle);
-		buffer.copyTo(particles.data(), size);
-		// todo: Better synchronization
 	}
 
-};
+	// Make the results of the previous dispatch visible to the next one
+	void computeBarrier(VkCommandBuffer cmdBuffer)
+	{
+		VkMemoryBarrier memoryBarrier = vkTools::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	void dispatchSort(VkCommandBuffer cmdBuffer, SortMode mode, uint32_t j, uint32_t k, uint32_t groupCount)
+	{
+		sortPushConstants.mode = mode;
+		sortPushConstants.j = j;
+		sortPushConstants.k = k;
+		vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SortPushConstants), &sortPushConstants);
+		vkCmdDispatch(cmdBuffer, groupCount, 1, 1);
+	}
 
-class ParticleSystemHolder
-{
-private:
-	vk::VulkanDevice *device;
 public:
+	// Vertex data consumed by the particle shaders (std430)
+	struct Particle
+	{
+		glm::vec4 pos;
+		glm::vec4 color;
+		float alpha;
+		float size;
+		float rotation;
+		uint32_t type;
+	};
+
+	// Simulation only state, kept in a separate buffer so the vertex stream stays tightly packed (std430)
+	struct ParticleState
+	{
+		glm::vec4 vel;
+		float rotationSpeed;
+		uint32_t emitter;
+		// Random number generator state of the particle
+		uint32_t seed;
+		uint32_t pad;
+	};
+
+	// Scene the GPU simulation collides the particles with
+	struct Collision
+	{
+		// Position (or compact depth) and normal attachments of the G-Buffer the particles are projected into
+		VkDescriptorImageInfo position;
+		VkDescriptorImageInfo normal;
+		// Unsigned distance to the scene's surfaces in a 3D texture covering the box from fieldOrigin to fieldOrigin + fieldExtent
+		VkDescriptorImageInfo distanceField;
+		glm::vec3 fieldOrigin;
+		glm::vec3 fieldExtent;
+		float voxelSize;
+	};
+
 	std::vector<ParticleSystem*> particleSystems;
+	uint32_t particleCount = 0;
+	// Collide with the surfaces stored in the G-Buffer, must only be set if the G-Buffer has been rendered for the current view
+	bool screenCollision = true;
+	// Collide with the distance field where the G-Buffer doesn't show the surroundings of a particle
+	bool fieldCollision = true;
+	// Simulated and sorted on the CPU (prepareCPU) instead of by compute shaders (prepare)
+	bool cpuSimulation = false;
+	// Only blending in order needs the sorted indices, without them the particles are drawn in storage order and neither path sorts
+	bool sorted = true;
+
+	// Device local particle vertices, written by the compute shader and bound as vertex buffer
+	vk::Buffer buffer;
+	vk::Buffer states;
+	vk::Buffer emitters;
+	// View space depth of the sorted elements
+	vk::Buffer sortKeys;
+	// Particle indices sorted back to front, used as the index buffer of the particle draw
+	vk::Buffer sortedIndices;
 
 	VkPipelineVertexInputStateCreateInfo inputState;
 	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
@@ -203,18 +408,18 @@ public:
 	{
 		// Vertex inputs
 		bindingDescriptions = {
-			vkTools::initializers::vertexInputBindingDescription(0, sizeof(ParticleSystem::Particle), VK_VERTEX_INPUT_RATE_VERTEX),
+			vkTools::initializers::vertexInputBindingDescription(0, sizeof(Particle), VK_VERTEX_INPUT_RATE_VERTEX),
 		};
 
 		// Attribute descriptions
 		// Location 0 : Position
 		attributeDescriptions = {
-			vkTools::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(ParticleSystem::Particle, pos)),
-			vkTools::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(ParticleSystem::Particle, color)),
-			vkTools::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32_SFLOAT, offsetof(ParticleSystem::Particle, alpha)),
-			vkTools::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32_SFLOAT, offsetof(ParticleSystem::Particle, size)),
-			vkTools::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32_SFLOAT, offsetof(ParticleSystem::Particle, rotation)),
-			vkTools::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32_SINT, offsetof(ParticleSystem::Particle, type)),
+			vkTools::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Particle, pos)),
+			vkTools::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT,	offsetof(Particle, color)),
+			vkTools::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32_SFLOAT, offsetof(Particle, alpha)),
+			vkTools::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32_SFLOAT, offsetof(Particle, size)),
+			vkTools::initializers::vertexInputAttributeDescription(0, 4, VK_FORMAT_R32_SFLOAT, offsetof(Particle, rotation)),
+			vkTools::initializers::vertexInputAttributeDescription(0, 5, VK_FORMAT_R32_SINT, offsetof(Particle, type)),
 		};
 
 		inputState = vkTools::initializers::pipelineVertexInputStateCreateInfo();
@@ -230,24 +435,423 @@ public:
 		{
 			delete particleSystem;
 		}
+		VkDevice logicalDevice = device->logicalDevice;
+		if (pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+			vkDestroyPipeline(logicalDevice, sortPipeline, nullptr);
+			vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+		}
+		buffer.destroy();
+		states.destroy();
+		emitters.destroy();
+		sortKeys.destroy();
+		sortedIndices.destroy();
+		upload.destroy();
 	}
 
+	// Add an emitter, all emitters must be added before prepare is called
 	ParticleSystem *add(uint32_t particlecount, glm::vec3 pos, glm::vec3 minvel, glm::vec3 maxvel)
 	{
-		ParticleSystem *particleSystem;
-		particleSystem = new ParticleSystem(device, particlecount, pos, minvel, maxvel);
+		assert((pipeline == VK_NULL_HANDLE) && (storage.count == 0));
+		ParticleSystem *particleSystem = new ParticleSystem(particlecount, particleCount, pos, minvel, maxvel);
 		particleSystems.push_back(particleSystem);
+		particleCount += particlecount;
 		return particleSystem;
 	}
 
-	void update(float deltaT)
+	/**
+	* Create the particle and emitter buffers and the simulation and sort pipelines
+	*
+	* @param queue Queue the emitters are uploaded with
+	* @param pipelineCache Cache used for creating the compute pipelines
+	* @param shaderStage Particle simulation compute shader (particle.comp)
+	* @param sortShaderStage Particle sort compute shader (particlesort.comp)
+	* @param sceneMatrices Uniform buffer with the projection, model and view matrices the particles are sorted and collided for
+	* @param collision G-Buffer and distance field the particles collide with
+	*/
+	void prepare(VkQueue queue, VkPipelineCache pipelineCache, VkPipelineShaderStageCreateInfo shaderStage, VkPipelineShaderStageCreateInfo sortShaderStage, VkDescriptorBufferInfo *sceneMatrices, Collision collision)
 	{
+		assert(particleCount > 0);
+		VkDevice logicalDevice = device->logicalDevice;
+
+		// Particles are spawned by the first dispatch, so only the emitters have to be uploaded
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&buffer,
+			particleCount * sizeof(Particle)));
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&states,
+			particleCount * sizeof(ParticleState)));
+
+		std::vector<Emitter> emitterData;
 		for (auto& particleSystem : particleSystems)
 		{
-			particleSystem->updateParticles(deltaT);
+			Emitter emitter = {};
+			emitter.position = glm::vec4(particleSystem->position, 0.0f);
+			emitter.minVel = glm::vec4(particleSystem->minVel, 0.0f);
+			emitter.maxVel = glm::vec4(particleSystem->maxVel, 0.0f);
+			emitter.firstParticle = particleSystem->firstParticle;
+			emitter.particleCount = particleSystem->particleCount;
+			emitterData.push_back(emitter);
+		}
+		const VkDeviceSize emitterSize = emitterData.size() * sizeof(Emitter);
+		vk::Buffer staging;
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&staging,
+			emitterSize,
+			emitterData.data()));
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&emitters,
+			emitterSize));
+		device->copyBuffer(&staging, &emitters, queue);
+		staging.destroy();
+
+		// The bitonic sort works on a power of two, elements past the particle count are padding sorted to the end
+		sortCount = PARTICLE_SORT_BLOCK_SIZE;
+		while (sortCount < particleCount)
+		{
+			sortCount <<= 1;
 		}
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&sortKeys,
+			sortCount * sizeof(float)));
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&sortedIndices,
+			sortCount * sizeof(uint32_t)));
+
+		// Descriptors
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vkTools::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
+			vkTools::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vkTools::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vkTools::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),		// Particles
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),		// Particle states
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),		// Emitters
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),		// Scene matrices
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),		// Sort keys
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),		// Sorted indices
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 6),	// G-Buffer position + depth
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 7),	// G-Buffer normals
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 8),	// Distance field
+		};
+		VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = vkTools::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &setLayoutCreateInfo, nullptr, &descriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo descriptorAllocInfo = vkTools::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(logicalDevice, &descriptorAllocInfo, &descriptorSet));
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &buffer.descriptor),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &states.descriptor),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &emitters.descriptor),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, sceneMatrices),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &sortKeys.descriptor),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &sortedIndices.descriptor),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &collision.position),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7, &collision.normal),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8, &collision.distanceField),
+		};
+		vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		pushConstants.fieldOrigin = glm::vec4(collision.fieldOrigin, collision.voxelSize);
+		pushConstants.fieldScale = glm::vec4(1.0f / collision.fieldExtent, 0.0f);
+
+		// Pipelines
+		VkPushConstantRange pushConstantRange = vkTools::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, static_cast<uint32_t>(std::max(sizeof(PushConstants), sizeof(SortPushConstants))), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vkTools::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vkTools::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCreateInfo.stage = shaderStage;
+		VK_CHECK_RESULT(vkCreateComputePipelines(logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+		computePipelineCreateInfo.stage = sortShaderStage;
+		VK_CHECK_RESULT(vkCreateComputePipelines(logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &sortPipeline));
+
+		pushConstants.particleCount = particleCount;
+		pushConstants.emitterCount = static_cast<uint32_t>(particleSystems.size());
+		pushConstants.reset = 1;
+		sortPushConstants.particleCount = particleCount;
+		sortPushConstants.sortCount = sortCount;
 	}
 
-};
+	/**
+	* Point the simulation at a new G-Buffer, e.g. after it has been resized
+	*
+	* @param position G-Buffer position (or compact depth) attachment
+	* @param normal G-Buffer normal attachment
+	*
+	* @note Must not be called while a recorded simulation step is pending
+	*/
+	void updateCollisionTargets(VkDescriptorImageInfo position, VkDescriptorImageInfo normal)
+	{
+		assert(descriptorSet != VK_NULL_HANDLE);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &position),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7, &normal),
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	/**
+	* Create the particle buffers for the CPU path, used instead of prepare if compute is not available
+	*
+	* @param frameCount Number of frames in flight, every frame has its own host copy of the vertices and indices
+	*/
+	void prepareCPU(uint32_t frameCount)
+	{
+		assert(particleCount > 0);
+		cpuSimulation = true;
 
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&buffer,
+			particleCount * sizeof(Particle)));
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&sortedIndices,
+			particleCount * sizeof(uint32_t)));
+
+		upload.slotCount = frameCount;
+		upload.alignment = 16;
+		uploadVertices = upload.reserve(particleCount * sizeof(Particle));
+		uploadIndices = upload.reserve(particleCount * sizeof(uint32_t));
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&upload.buffer,
+			upload.size()));
+		VK_CHECK_RESULT(upload.buffer.map());
+
+		storage.resize(particleCount);
+		for (uint32_t e = 0; e < static_cast<uint32_t>(particleSystems.size()); e++)
+		{
+			const ParticleSystem *particleSystem = particleSystems[e];
+			for (uint32_t i = particleSystem->firstParticle; i < particleSystem->firstParticle + particleSystem->particleCount; i++)
+			{
+				storage.emitter[i] = e;
+				storage.seed[i] = hash(i);
+				initParticle(i);
+			}
+		}
+	}
+
+	/**
+	* Simulate a time step on the CPU and write the vertices and back to front sorted indices into a frame's host copy
+	*
+	* @param frame Frame in flight, its previous upload must have finished
+	* @param deltaT Time step in seconds
+	* @param view View matrix the particles are sorted for
+	* @param jobSystem (Optional) Job system the particle batches are spread across
+	*/
+	void updateCPU(uint32_t frame, float deltaT, const glm::mat4 &view, vkTools::JobSystem *jobSystem = nullptr)
+	{
+		assert(cpuSimulation);
+		Particle *vertices = reinterpret_cast<Particle*>(static_cast<uint8_t*>(upload.buffer.mapped) + upload.offset(frame, uploadVertices));
+		auto updateRange = [&](uint32_t first, uint32_t last) {
+			updateBatch(first, last, deltaT, view);
+			// Only the fields read by the vertex shader are written to the upload buffer
+			last = std::min(last, particleCount);
+			for (uint32_t i = first; i < last; i++)
+			{
+				Particle &vertex = vertices[i];
+				vertex.pos = glm::vec4(storage.posX[i], storage.posY[i], storage.posZ[i], storage.layer[i]);
+				vertex.color = glm::vec4(storage.color[i]);
+				vertex.alpha = storage.alpha[i];
+				vertex.size = storage.size[i];
+				vertex.rotation = storage.rotation[i];
+				vertex.type = storage.type[i];
+			}
+		};
+		if (jobSystem)
+		{
+			jobSystem->parallelFor(storage.count, PARTICLE_CPU_BATCH_SIZE, updateRange);
+		}
+		else
+		{
+			updateRange(0, storage.count);
+		}
+
+		if (!sorted)
+		{
+			return;
+		}
+		// Farthest particles have the smallest view space z and are drawn first
+		for (uint32_t i = 0; i < particleCount; i++)
+		{
+			storage.order[i] = i;
+		}
+		const std::vector<float> &depth = storage.depth;
+		std::sort(storage.order.begin(), storage.order.end(), [&depth](uint32_t a, uint32_t b) { return depth[a] < depth[b]; });
+		upload.write(frame, uploadIndices, storage.order.data(), particleCount * sizeof(uint32_t));
+	}
+
+	/**
+	* Record the upload of a frame's vertices and sorted indices written by updateCPU
+	*
+	* @param cmdBuffer Command buffer to record to, must be outside of a render pass
+	* @param frame Frame in flight the host copy has been written for
+	*/
+	void recordUpload(VkCommandBuffer cmdBuffer, uint32_t frame)
+	{
+		assert(cpuSimulation);
+
+		// Previous draws must be done reading the vertices and indices before they are overwritten
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			0, nullptr);
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.srcOffset = upload.offset(frame, uploadVertices);
+		copyRegion.size = particleCount * sizeof(Particle);
+		vkCmdCopyBuffer(cmdBuffer, upload.buffer.buffer, buffer.buffer, 1, &copyRegion);
+		if (sorted)
+		{
+			copyRegion.srcOffset = upload.offset(frame, uploadIndices);
+			copyRegion.size = particleCount * sizeof(uint32_t);
+			vkCmdCopyBuffer(cmdBuffer, upload.buffer.buffer, sortedIndices.buffer, 1, &copyRegion);
+		}
+
+		VkMemoryBarrier memoryBarrier = vkTools::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	/**
+	* Record the simulation of a time step into a command buffer
+	*
+	* @param cmdBuffer Command buffer to record to, must be outside of a render pass
+	* @param deltaT Time step in seconds
+	*
+	* @note The first recorded step spawns all particles
+	*/
+	void recordUpdate(VkCommandBuffer cmdBuffer, float deltaT)
+	{
+		assert(pipeline != VK_NULL_HANDLE);
+
+		// Previous draws must be done reading the vertices and the previous step writing the particles before they are updated
+		// The collision reads the G-Buffer, which has been rendered earlier in the same queue
+		VkMemoryBarrier memoryBarrier = vkTools::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		pushConstants.deltaT = deltaT;
+		pushConstants.screenCollision = screenCollision ? 1 : 0;
+		pushConstants.fieldCollision = fieldCollision ? 1 : 0;
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		vkCmdDispatch(cmdBuffer, (particleCount + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE, 1, 1);
+		pushConstants.reset = 0;
+
+		// Make the new vertices visible to the particle draws
+		VkBufferMemoryBarrier bufferBarrier = vkTools::initializers::bufferMemoryBarrier();
+		bufferBarrier.buffer = buffer.buffer;
+		bufferBarrier.offset = 0;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0,
+			0, nullptr,
+			1, &bufferBarrier,
+			0, nullptr);
+	}
+
+	/**
+	* Record the back to front sort of the particles into a command buffer
+	*
+	* @param cmdBuffer Command buffer to record to, must be outside of a render pass and after the simulation step
+	*
+	* @note Sequences of up to the sort block size are sorted and merged in shared memory, only larger merge steps go through device memory
+	*/
+	void recordSort(VkCommandBuffer cmdBuffer)
+	{
+		assert(sortPipeline != VK_NULL_HANDLE);
+
+		// The keys are computed from the positions written by the simulation
+		computeBarrier(cmdBuffer);
+
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, sortPipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+		// Every thread of the merge steps compares one pair of elements
+		const uint32_t blockCount = sortCount / PARTICLE_SORT_BLOCK_SIZE;
+		const uint32_t pairGroupCount = (sortCount / 2 + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE;
+
+		dispatchSort(cmdBuffer, SORT_MODE_KEYS, 0, 0, sortCount / PARTICLE_WORKGROUP_SIZE);
+		computeBarrier(cmdBuffer);
+		dispatchSort(cmdBuffer, SORT_MODE_LOCAL_SORT, 0, 0, blockCount);
+		for (uint32_t k = PARTICLE_SORT_BLOCK_SIZE * 2; k <= sortCount; k <<= 1)
+		{
+			computeBarrier(cmdBuffer);
+			for (uint32_t j = k / 2; j >= PARTICLE_SORT_BLOCK_SIZE; j >>= 1)
+			{
+				dispatchSort(cmdBuffer, SORT_MODE_GLOBAL_STEP, j, k, pairGroupCount);
+				computeBarrier(cmdBuffer);
+			}
+			dispatchSort(cmdBuffer, SORT_MODE_LOCAL_MERGE, 0, k, blockCount);
+		}
+
+		// Sorted indices are read by the particle draw
+		VkBufferMemoryBarrier bufferBarrier = vkTools::initializers::bufferMemoryBarrier();
+		bufferBarrier.buffer = sortedIndices.buffer;
+		bufferBarrier.offset = 0;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0,
+			0, nullptr,
+			1, &bufferBarrier,
+			0, nullptr);
+	}
 
+};
\ No newline at end of file
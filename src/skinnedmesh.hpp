@@ -0,0 +1,765 @@
+/*
+* Vulkan playground for rendering Crytek's Sponza model (deferred renderer)
+*
+* Animated skinned meshes
+*
+* A model's bind pose, bone hierarchy and node animations are imported with Assimp (without pre-transforming the vertices)
+* Bone palettes of all instances are sampled on the CPU with 4 wide SIMD (SSE2 or NEON), one job per instance on the job system
+* A compute shader then skins every vertex once per frame into a vertex buffer laid out like the scene's,
+* the positions of all vertices followed by their packed attributes, so the G-Buffer and all shadow passes draw it with the scene's pipelines
+*
+* Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define SKINNING_SIMD_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SKINNING_SIMD_NEON
+#endif
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <assimp/scene.h>
+
+#include <vulkan/vulkan.h>
+#include "vulkandevice.hpp"
+#include "vulkanbuffer.hpp"
+#include "vulkantools.h"
+#include "jobsystem.hpp"
+
+// Must match the local size of the skinning compute shader
+#define SKINNING_WORKGROUP_SIZE 64
+// Bone influences per vertex, their indices and weights are packed into 8 bits each
+#define SKINNING_MAX_INFLUENCES 4
+#define SKINNING_MAX_BONES 256
+
+// Four wide float operations used by the palette sampling
+namespace skinningSimd
+{
+#if defined(SKINNING_SIMD_SSE)
+	typedef __m128 float4;
+	inline float4 load(const float *p) { return _mm_loadu_ps(p); }
+	inline void store(float *p, float4 v) { _mm_storeu_ps(p, v); }
+	inline float4 set1(float f) { return _mm_set1_ps(f); }
+	inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+	// a * b + c
+	inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#elif defined(SKINNING_SIMD_NEON)
+	typedef float32x4_t float4;
+	inline float4 load(const float *p) { return vld1q_f32(p); }
+	inline void store(float *p, float4 v) { vst1q_f32(p, v); }
+	inline float4 set1(float f) { return vdupq_n_f32(f); }
+	inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+	inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+#else
+	struct float4 { float v[4]; };
+	inline float4 load(const float *p) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+	inline void store(float *p, float4 v) { for (int i = 0; i < 4; i++) p[i] = v.v[i]; }
+	inline float4 set1(float f) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = f; return r; }
+	inline float4 mul(float4 a, float4 b) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * b.v[i]; return r; }
+	inline float4 madd(float4 a, float4 b, float4 c) { float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * b.v[i] + c.v[i]; return r; }
+#endif
+
+	// result = a * b for column major matrices, each column of the result combines the columns of a
+	// All of a is loaded and each column of b is read before its column of the result is written, so result may alias either
+	inline void multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &result)
+	{
+		const float4 a0 = load(&a[0][0]);
+		const float4 a1 = load(&a[1][0]);
+		const float4 a2 = load(&a[2][0]);
+		const float4 a3 = load(&a[3][0]);
+		for (int c = 0; c < 4; c++)
+		{
+			float4 column = mul(a0, set1(b[c][0]));
+			column = madd(a1, set1(b[c][1]), column);
+			column = madd(a2, set1(b[c][2]), column);
+			column = madd(a3, set1(b[c][3]), column);
+			store(&result[c][0], column);
+		}
+	}
+}
+
+class SkinnedMeshHolder
+{
+private:
+	vk::VulkanDevice *device;
+
+	// Nodes are stored with every parent in front of its children
+	struct Node
+	{
+		int32_t parent;
+		glm::mat4 transform;
+	};
+
+	// Keys of a node's animation, times are in seconds
+	struct Channel
+	{
+		std::vector<float> positionTimes;
+		std::vector<glm::vec3> positions;
+		std::vector<float> rotationTimes;
+		std::vector<glm::quat> rotations;
+		std::vector<float> scaleTimes;
+		std::vector<glm::vec3> scales;
+	};
+
+	struct Animation
+	{
+		std::string name;
+		float duration;
+		std::vector<Channel> channels;
+		// Channel animating each node, -1 if the node keeps its transform
+		std::vector<int32_t> nodeChannels;
+	};
+
+	// Bind pose vertex as read by the compute shader (std430)
+	struct SourceVertex
+	{
+		glm::vec3 pos;
+		// Half float texture coordinates
+		uint32_t uv;
+		glm::vec3 normal;
+		// Four 8 bit bone indices, the first one has the largest weight
+		uint32_t boneIndices;
+		glm::vec3 tangent;
+		// Four 8 bit unorm weights adding up to one
+		uint32_t boneWeights;
+	};
+
+	struct PushConstants
+	{
+		uint32_t vertexCount;
+		uint32_t boneCount;
+		// Offset of the packed attributes in the output buffer, in uints
+		uint32_t attributeOffset;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Animation> animations;
+	// Node moving each bone and the bone's transform from mesh space to the node's space
+	std::vector<int32_t> boneNodes;
+	std::vector<glm::mat4> boneOffsets;
+	// Inverse of the root node's transform, the model's meshes are in the root's space
+	glm::mat4 rootInverse;
+	// Largest distance of a bind pose vertex from the joint of its strongest bone in mesh space, pads the bounds around the joints
+	float boundsMargin = 0.0f;
+
+	std::vector<SourceVertex> sourceVertices;
+	std::vector<uint32_t> sourceIndices;
+
+	// Global transforms of the nodes, one array per instance so the instances can be sampled in parallel
+	std::vector<std::vector<glm::mat4>> globalTransforms;
+
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	vk::Buffer sourceBuffer;
+	// Device local palettes of all instances, read by the compute shader
+	vk::Buffer palettes;
+	// Host copies of the palettes, one slot per frame in flight
+	vk::RingBuffer upload;
+	VkDeviceSize uploadPalettes = 0;
+
+	// Assimp's types are packed, so their members are copied instead of being read through a pointer
+	static glm::mat4 toGlm(const aiMatrix4x4 &m)
+	{
+		// Assimp's matrices are row major
+		return glm::mat4(
+			m.a1, m.b1, m.c1, m.d1,
+			m.a2, m.b2, m.c2, m.d2,
+			m.a3, m.b3, m.c3, m.d3,
+			m.a4, m.b4, m.c4, m.d4);
+	}
+
+	static glm::vec3 toGlm(const aiVector3D &v)
+	{
+		return glm::vec3(v.x, v.y, v.z);
+	}
+
+	// Value at a time between the keys, the first and last key are held outside of the keys' range
+	template <typename T, typename Interpolate>
+	static T sampleKeys(const std::vector<float> &times, const std::vector<T> &values, float time, Interpolate interpolate)
+	{
+		if ((values.size() == 1) || (time <= times.front()))
+		{
+			return values.front();
+		}
+		if (time >= times.back())
+		{
+			return values.back();
+		}
+		const size_t next = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+		const float t = (time - times[next - 1]) / (times[next] - times[next - 1]);
+		return interpolate(values[next - 1], values[next], t);
+	}
+
+	static glm::vec3 lerp(const glm::vec3 &a, const glm::vec3 &b, float t)
+	{
+		return a + (b - a) * t;
+	}
+
+	// Normalized linear interpolation along the shorter arc, close enough to slerp for the small steps between keys
+	static glm::quat nlerp(const glm::quat &a, const glm::quat &b, float t)
+	{
+		const glm::quat target = (glm::dot(a, b) < 0.0f) ? -b : b;
+		return glm::normalize(a * (1.0f - t) + target * t);
+	}
+
+	// Add a node and its children with every parent in front of its children
+	void addNode(const aiNode *aNode, int32_t parent, std::unordered_map<std::string, int32_t> &nodeIndices, std::vector<int32_t> &meshNodes)
+	{
+		const int32_t index = static_cast<int32_t>(nodes.size());
+		Node node;
+		node.parent = parent;
+		node.transform = toGlm(aNode->mTransformation);
+		nodes.push_back(node);
+		nodeIndices[aNode->mName.C_Str()] = index;
+		for (uint32_t i = 0; i < aNode->mNumMeshes; i++)
+		{
+			if (meshNodes[aNode->mMeshes[i]] < 0)
+			{
+				meshNodes[aNode->mMeshes[i]] = index;
+			}
+		}
+		for (uint32_t i = 0; i < aNode->mNumChildren; i++)
+		{
+			addNode(aNode->mChildren[i], index, nodeIndices, meshNodes);
+		}
+	}
+
+	// Index of a bone, added on first use
+	uint32_t getBone(int32_t node, const glm::mat4 &offset, std::unordered_map<int32_t, uint32_t> &nodeBones)
+	{
+		auto bone = nodeBones.find(node);
+		if (bone != nodeBones.end())
+		{
+			return bone->second;
+		}
+		const uint32_t index = static_cast<uint32_t>(boneNodes.size());
+		boneNodes.push_back(node);
+		boneOffsets.push_back(offset);
+		nodeBones[node] = index;
+		return index;
+	}
+
+	// Sample an instance's animation and write its palette
+	// Only touches the instance and its global transforms, so instances can be sampled in parallel
+	void sampleInstance(uint32_t index, glm::mat4 *palette)
+	{
+		Instance &instance = instances[index];
+		std::vector<glm::mat4> &globals = globalTransforms[index];
+		const Animation *animation = (instance.animation < animations.size()) ? &animations[instance.animation] : nullptr;
+
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			const Node &node = nodes[i];
+			glm::mat4 local = node.transform;
+			const int32_t channel = animation ? animation->nodeChannels[i] : -1;
+			if (channel >= 0)
+			{
+				const Channel &keys = animation->channels[channel];
+				const glm::vec3 position = sampleKeys(keys.positionTimes, keys.positions, instance.time, lerp);
+				const glm::quat rotation = sampleKeys(keys.rotationTimes, keys.rotations, instance.time, nlerp);
+				const glm::vec3 scale = sampleKeys(keys.scaleTimes, keys.scales, instance.time, lerp);
+				local = glm::mat4_cast(rotation);
+				local[0] *= scale.x;
+				local[1] *= scale.y;
+				local[2] *= scale.z;
+				local[3] = glm::vec4(position, 1.0f);
+			}
+			if (node.parent >= 0)
+			{
+				skinningSimd::multiply(globals[node.parent], local, globals[i]);
+			}
+			else
+			{
+				globals[i] = local;
+			}
+		}
+
+		// The placement mirrors the model along y like the scene's vertices
+		glm::mat4 placement = glm::scale(instance.transform, glm::vec3(1.0f, -1.0f, 1.0f));
+		skinningSimd::multiply(placement, rootInverse, placement);
+		glm::vec3 jointsMin(FLT_MAX);
+		glm::vec3 jointsMax(-FLT_MAX);
+		float maxScale = 0.0f;
+		for (size_t b = 0; b < boneNodes.size(); b++)
+		{
+			glm::mat4 &bone = palette[b];
+			skinningSimd::multiply(placement, globals[boneNodes[b]], bone);
+			const glm::vec3 joint(bone[3]);
+			jointsMin = glm::min(jointsMin, joint);
+			jointsMax = glm::max(jointsMax, joint);
+			skinningSimd::multiply(bone, boneOffsets[b], bone);
+			maxScale = std::max(maxScale, glm::length(glm::vec3(bone[0])));
+		}
+		instance.center = (jointsMin + jointsMax) * 0.5f;
+		instance.radius = glm::length(jointsMax - jointsMin) * 0.5f + boundsMargin * maxScale;
+	}
+
+public:
+	// A part of the model drawn with a single material, indices are relative to its first vertex
+	struct Submesh
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t vertexBase;
+		uint32_t vertexCount;
+		std::string material;
+	};
+
+	struct Instance
+	{
+		// Placement in the scene
+		glm::mat4 transform;
+		// Animation played in a loop, the bind pose if there is no animation with this index
+		uint32_t animation;
+		// Seconds into the animation
+		float time;
+		float speed;
+		// Bounding sphere of the skinned vertices at the last update, in world space
+		glm::vec3 center;
+		float radius;
+	};
+
+	std::vector<Submesh> submeshes;
+	std::vector<Instance> instances;
+	// Vertices of the model, every instance has its own range of this many vertices in the skinned buffer
+	uint32_t vertexCount = 0;
+
+	// Skinned vertices of all instances, the positions (glm::vec3) are followed by the packed attributes at attributeOffset
+	vk::Buffer vertices;
+	VkDeviceSize attributeOffset = 0;
+	// Indices of all submeshes (32 bit)
+	vk::Buffer indices;
+
+	SkinnedMeshHolder(vk::VulkanDevice *vkdevice) : device(vkdevice)
+	{
+	}
+
+	~SkinnedMeshHolder()
+	{
+		VkDevice logicalDevice = device->logicalDevice;
+		if (pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+			vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+		}
+		sourceBuffer.destroy();
+		palettes.destroy();
+		vertices.destroy();
+		indices.destroy();
+		upload.destroy();
+	}
+
+	/**
+	* Import the bind pose, bones and animations of a model
+	*
+	* @param aScene Scene imported without aiProcess_PreTransformVertices, triangulated and with normals and tangents
+	*
+	* @return False if the model has no meshes or more than SKINNING_MAX_BONES bones
+	*
+	* @note Meshes without bones are attached to the node they're referenced by
+	*/
+	bool load(const aiScene *aScene)
+	{
+		assert(sourceVertices.empty());
+		if (aScene->mNumMeshes == 0)
+		{
+			return false;
+		}
+
+		std::unordered_map<std::string, int32_t> nodeIndices;
+		std::vector<int32_t> meshNodes(aScene->mNumMeshes, -1);
+		addNode(aScene->mRootNode, -1, nodeIndices, meshNodes);
+		rootInverse = glm::inverse(nodes[0].transform);
+
+		// Bones of meshes with bones and of meshes attached to their node are kept apart, as their offsets differ
+		std::unordered_map<int32_t, uint32_t> nodeBones;
+		std::unordered_map<int32_t, uint32_t> rigidBones;
+		for (uint32_t m = 0; m < aScene->mNumMeshes; m++)
+		{
+			const aiMesh *aMesh = aScene->mMeshes[m];
+			Submesh submesh;
+			submesh.firstIndex = static_cast<uint32_t>(sourceIndices.size());
+			submesh.indexCount = aMesh->mNumFaces * 3;
+			submesh.vertexBase = static_cast<uint32_t>(sourceVertices.size());
+			submesh.vertexCount = aMesh->mNumVertices;
+			aiString materialName;
+			aScene->mMaterials[aMesh->mMaterialIndex]->Get(AI_MATKEY_NAME, materialName);
+			submesh.material = materialName.C_Str();
+
+			// Strongest influences of each vertex, sorted by weight
+			std::vector<std::array<std::pair<float, uint32_t>, SKINNING_MAX_INFLUENCES>> influences(aMesh->mNumVertices);
+			for (auto &vertexInfluences : influences)
+			{
+				vertexInfluences.fill(std::make_pair(0.0f, 0u));
+			}
+			if (aMesh->mNumBones == 0)
+			{
+				// Rigidly attached to its node, its vertices are in the node's space
+				const uint32_t bone = getBone(std::max(meshNodes[m], 0), glm::mat4(1.0f), rigidBones);
+				for (auto &vertexInfluences : influences)
+				{
+					vertexInfluences[0] = std::make_pair(1.0f, bone);
+				}
+			}
+			for (uint32_t b = 0; b < aMesh->mNumBones; b++)
+			{
+				const aiBone *aBone = aMesh->mBones[b];
+				auto node = nodeIndices.find(aBone->mName.C_Str());
+				if (node == nodeIndices.end())
+				{
+					continue;
+				}
+				const uint32_t bone = getBone(node->second, toGlm(aBone->mOffsetMatrix), nodeBones);
+				for (uint32_t w = 0; w < aBone->mNumWeights; w++)
+				{
+					const aiVertexWeight &weight = aBone->mWeights[w];
+					auto &vertexInfluences = influences[weight.mVertexId];
+					// Insert in order, dropping the weakest influence
+					std::pair<float, uint32_t> influence(weight.mWeight, bone);
+					for (auto &slot : vertexInfluences)
+					{
+						if (influence.first > slot.first)
+						{
+							std::swap(influence, slot);
+						}
+					}
+				}
+			}
+			if (boneNodes.size() > SKINNING_MAX_BONES)
+			{
+				return false;
+			}
+
+			const bool hasUV = aMesh->HasTextureCoords(0);
+			const bool hasTangent = aMesh->HasTangentsAndBitangents();
+			for (uint32_t v = 0; v < aMesh->mNumVertices; v++)
+			{
+				SourceVertex vertex;
+				vertex.pos = toGlm(aMesh->mVertices[v]);
+				vertex.uv = glm::packHalf2x16(hasUV ? glm::vec2(toGlm(aMesh->mTextureCoords[0][v])) : glm::vec2(0.0f));
+				vertex.normal = toGlm(aMesh->mNormals[v]);
+				vertex.tangent = hasTangent ? toGlm(aMesh->mTangents[v]) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+				// Weights are renormalized to the kept influences, the rounding error goes to the strongest one
+				const auto &vertexInfluences = influences[v];
+				float weightSum = 0.0f;
+				for (auto &influence : vertexInfluences)
+				{
+					weightSum += influence.first;
+				}
+				uint32_t quantized[SKINNING_MAX_INFLUENCES];
+				uint32_t quantizedSum = 0;
+				vertex.boneIndices = 0;
+				for (uint32_t i = 0; i < SKINNING_MAX_INFLUENCES; i++)
+				{
+					quantized[i] = (weightSum > 0.0f) ? static_cast<uint32_t>(vertexInfluences[i].first / weightSum * 255.0f + 0.5f) : 0;
+					quantizedSum += quantized[i];
+					vertex.boneIndices |= vertexInfluences[i].second << (i * 8);
+				}
+				quantized[0] = static_cast<uint32_t>(std::max(static_cast<int32_t>(quantized[0]) + 255 - static_cast<int32_t>(quantizedSum), 0));
+				vertex.boneWeights = quantized[0] | (quantized[1] << 8) | (quantized[2] << 16) | (quantized[3] << 24);
+
+				const glm::vec3 joint(glm::inverse(boneOffsets[vertexInfluences[0].second])[3]);
+				boundsMargin = std::max(boundsMargin, glm::length(vertex.pos - joint));
+				sourceVertices.push_back(vertex);
+			}
+
+			for (uint32_t f = 0; f < aMesh->mNumFaces; f++)
+			{
+				// Assume mesh is triangulated
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					sourceIndices.push_back(aMesh->mFaces[f].mIndices[i]);
+				}
+			}
+			submeshes.push_back(submesh);
+		}
+		vertexCount = static_cast<uint32_t>(sourceVertices.size());
+
+		for (uint32_t a = 0; a < aScene->mNumAnimations; a++)
+		{
+			const aiAnimation *aAnimation = aScene->mAnimations[a];
+			const float ticksPerSecond = (aAnimation->mTicksPerSecond > 0.0) ? static_cast<float>(aAnimation->mTicksPerSecond) : 25.0f;
+			Animation animation;
+			animation.name = aAnimation->mName.C_Str();
+			animation.duration = static_cast<float>(aAnimation->mDuration) / ticksPerSecond;
+			animation.nodeChannels.assign(nodes.size(), -1);
+			for (uint32_t c = 0; c < aAnimation->mNumChannels; c++)
+			{
+				const aiNodeAnim *aChannel = aAnimation->mChannels[c];
+				auto node = nodeIndices.find(aChannel->mNodeName.C_Str());
+				if ((node == nodeIndices.end()) || (aChannel->mNumPositionKeys == 0) || (aChannel->mNumRotationKeys == 0) || (aChannel->mNumScalingKeys == 0))
+				{
+					continue;
+				}
+				Channel channel;
+				for (uint32_t k = 0; k < aChannel->mNumPositionKeys; k++)
+				{
+					channel.positionTimes.push_back(static_cast<float>(aChannel->mPositionKeys[k].mTime) / ticksPerSecond);
+					channel.positions.push_back(toGlm(aChannel->mPositionKeys[k].mValue));
+				}
+				for (uint32_t k = 0; k < aChannel->mNumRotationKeys; k++)
+				{
+					const aiQuaternion &q = aChannel->mRotationKeys[k].mValue;
+					channel.rotationTimes.push_back(static_cast<float>(aChannel->mRotationKeys[k].mTime) / ticksPerSecond);
+					channel.rotations.push_back(glm::quat(q.w, q.x, q.y, q.z));
+				}
+				for (uint32_t k = 0; k < aChannel->mNumScalingKeys; k++)
+				{
+					channel.scaleTimes.push_back(static_cast<float>(aChannel->mScalingKeys[k].mTime) / ticksPerSecond);
+					channel.scales.push_back(toGlm(aChannel->mScalingKeys[k].mValue));
+				}
+				animation.nodeChannels[node->second] = static_cast<int32_t>(animation.channels.size());
+				animation.channels.push_back(channel);
+			}
+			animations.push_back(animation);
+		}
+		return true;
+	}
+
+	uint32_t getAnimationCount() const
+	{
+		return static_cast<uint32_t>(animations.size());
+	}
+
+	uint32_t getBoneCount() const
+	{
+		return static_cast<uint32_t>(boneNodes.size());
+	}
+
+	// Add an instance, all instances must be added before prepare is called
+	void add(const glm::mat4 &transform, uint32_t animation, float time, float speed)
+	{
+		assert(pipeline == VK_NULL_HANDLE);
+		Instance instance;
+		instance.transform = transform;
+		instance.animation = animation;
+		instance.time = time;
+		instance.speed = speed;
+		instance.center = glm::vec3(transform[3]);
+		instance.radius = 0.0f;
+		instances.push_back(instance);
+	}
+
+	/**
+	* Create the bind pose, palette and skinned vertex buffers and the skinning pipeline
+	*
+	* @param queue Queue the bind pose and indices are uploaded with
+	* @param pipelineCache Cache used for creating the compute pipeline
+	* @param shaderStage Skinning compute shader (skinning.comp)
+	* @param frameCount Number of frames in flight, every frame has its own host copy of the palettes
+	*/
+	void prepare(VkQueue queue, VkPipelineCache pipelineCache, VkPipelineShaderStageCreateInfo shaderStage, uint32_t frameCount)
+	{
+		assert((vertexCount > 0) && !instances.empty());
+		VkDevice logicalDevice = device->logicalDevice;
+
+		// The bind pose and the indices never change
+		auto uploadBuffer = [&](VkBufferUsageFlags usage, vk::Buffer *buffer, VkDeviceSize size, void *data)
+		{
+			vk::Buffer staging;
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&staging,
+				size,
+				data));
+			VK_CHECK_RESULT(device->createBuffer(
+				usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				buffer,
+				size));
+			device->copyBuffer(&staging, buffer, queue);
+			staging.destroy();
+		};
+		uploadBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &sourceBuffer, sourceVertices.size() * sizeof(SourceVertex), sourceVertices.data());
+		uploadBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indices, sourceIndices.size() * sizeof(uint32_t), sourceIndices.data());
+
+		const uint32_t skinnedVertexCount = vertexCount * static_cast<uint32_t>(instances.size());
+		// Aligned so the attributes can be bound as a storage buffer range of their own
+		const VkDeviceSize storageAlignment = device->properties.limits.minStorageBufferOffsetAlignment;
+		attributeOffset = (skinnedVertexCount * sizeof(glm::vec3) + storageAlignment - 1) / storageAlignment * storageAlignment;
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&vertices,
+			attributeOffset + skinnedVertexCount * 3 * sizeof(uint32_t)));
+
+		const VkDeviceSize paletteSize = instances.size() * boneNodes.size() * sizeof(glm::mat4);
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&palettes,
+			paletteSize));
+		upload.slotCount = frameCount;
+		upload.alignment = 16;
+		uploadPalettes = upload.reserve(paletteSize);
+		VK_CHECK_RESULT(device->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&upload.buffer,
+			upload.size()));
+		VK_CHECK_RESULT(upload.buffer.map());
+
+		globalTransforms.assign(instances.size(), std::vector<glm::mat4>(nodes.size()));
+
+		// Descriptors
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vkTools::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vkTools::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),		// Bind pose vertices
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),		// Palettes
+			vkTools::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),		// Skinned vertices
+		};
+		VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = vkTools::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &setLayoutCreateInfo, nullptr, &descriptorSetLayout));
+
+		VkDescriptorSetAllocateInfo descriptorAllocInfo = vkTools::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(logicalDevice, &descriptorAllocInfo, &descriptorSet));
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &sourceBuffer.descriptor),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &palettes.descriptor),
+			vkTools::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &vertices.descriptor),
+		};
+		vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// Pipeline
+		VkPushConstantRange pushConstantRange = vkTools::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstants), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vkTools::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vkTools::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCreateInfo.stage = shaderStage;
+		VK_CHECK_RESULT(vkCreateComputePipelines(logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+	}
+
+	/**
+	* Advance the instances' animations and write their palettes into a frame's host copy
+	*
+	* @param frame Frame in flight, its previous upload must have finished
+	* @param deltaT Time step in seconds
+	* @param jobSystem (Optional) Job system the instances are spread across
+	*/
+	void update(uint32_t frame, float deltaT, vkTools::JobSystem *jobSystem = nullptr)
+	{
+		glm::mat4 *framePalettes = reinterpret_cast<glm::mat4*>(static_cast<uint8_t*>(upload.buffer.mapped) + upload.offset(frame, uploadPalettes));
+		const uint32_t boneCount = getBoneCount();
+		auto updateRange = [&](uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++)
+			{
+				Instance &instance = instances[i];
+				if (instance.animation < animations.size())
+				{
+					const float duration = animations[instance.animation].duration;
+					instance.time = (duration > 0.0f) ? fmod(instance.time + deltaT * instance.speed, duration) : 0.0f;
+				}
+				sampleInstance(i, framePalettes + i * boneCount);
+			}
+		};
+		if (jobSystem)
+		{
+			jobSystem->parallelFor(static_cast<uint32_t>(instances.size()), 1, updateRange);
+		}
+		else
+		{
+			updateRange(0, static_cast<uint32_t>(instances.size()));
+		}
+	}
+
+	/**
+	* Record the upload of a frame's palettes written by update and the skinning of all instances' vertices
+	*
+	* @param cmdBuffer Command buffer to record to, must be outside of a render pass
+	* @param frame Frame in flight the host copy has been written for
+	*/
+	void recordUpdate(VkCommandBuffer cmdBuffer, uint32_t frame)
+	{
+		assert(pipeline != VK_NULL_HANDLE);
+
+		// Previous draws must be done reading the skinned vertices and the previous dispatch reading the palettes before either is overwritten
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			0, nullptr);
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.srcOffset = upload.offset(frame, uploadPalettes);
+		copyRegion.size = palettes.size;
+		vkCmdCopyBuffer(cmdBuffer, upload.buffer.buffer, palettes.buffer, 1, &copyRegion);
+
+		VkMemoryBarrier memoryBarrier = vkTools::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		PushConstants pushConstants;
+		pushConstants.vertexCount = vertexCount;
+		pushConstants.boneCount = getBoneCount();
+		pushConstants.attributeOffset = static_cast<uint32_t>(attributeOffset / sizeof(uint32_t));
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		// One row of work groups per instance
+		vkCmdDispatch(cmdBuffer, (vertexCount + SKINNING_WORKGROUP_SIZE - 1) / SKINNING_WORKGROUP_SIZE, static_cast<uint32_t>(instances.size()), 1);
+
+		// Make the skinned vertices visible to the G-Buffer and shadow passes, read as vertex attributes or by the vertex pulling shaders
+		VkBufferMemoryBarrier bufferBarrier = vkTools::initializers::bufferMemoryBarrier();
+		bufferBarrier.buffer = vertices.buffer;
+		bufferBarrier.offset = 0;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			0,
+			0, nullptr,
+			1, &bufferBarrier,
+			0, nullptr);
+	}
+};